@@ -143,6 +143,40 @@ from the FreeRTOSIPConfig.h configuration header file. */
 		#define	ipconfigTCP_WIN_SEG_COUNT		( 256 )
 	#endif
 
+	/* The default delays of outgoing ACK's.  The short delay is used after
+	receiving a small segment, or when the Rx buffer is filling up.  They can
+	be changed per socket with the FREERTOS_SO_TCP_DELAYED_ACK option. */
+	#ifndef ipconfigTCP_DELAYED_ACK_SHORT_DELAY_MS
+		#define ipconfigTCP_DELAYED_ACK_SHORT_DELAY_MS	( 2 )
+	#endif
+
+	#ifndef ipconfigTCP_DELAYED_ACK_LONGER_DELAY_MS
+		#define ipconfigTCP_DELAYED_ACK_LONGER_DELAY_MS	( 20 )
+	#endif
+
+	/* When non-zero, a TCP socket that has the FREERTOS_SO_TCP_RX_LOAN option
+	set will keep in-order segments in the network buffers in which they were
+	received, and loan those buffers to the application through
+	FreeRTOS_recv_loan(), instead of copying the payload into the Rx stream. */
+	#ifndef ipconfigTCP_RX_BUFFER_LOANING
+		#define ipconfigTCP_RX_BUFFER_LOANING	( 0 )
+	#endif
+
+	/* The maximum number of network buffers that a single TCP socket may hold,
+	queued or on loan to the application.  Further segments are copied into the
+	Rx stream until the application returns some of the buffers. */
+	#ifndef ipconfigTCP_RX_LOAN_MAX_BUFFERS
+		#define ipconfigTCP_RX_LOAN_MAX_BUFFERS	( 8 )
+	#endif
+
+	/* A segment is only loaned when this number of network buffers remains
+	free afterwards, so that slow readers can not starve the driver and the
+	other sockets of network buffers.  Otherwise it is copied into the Rx
+	stream. */
+	#ifndef ipconfigTCP_RX_LOAN_MIN_FREE_BUFFERS
+		#define ipconfigTCP_RX_LOAN_MIN_FREE_BUFFERS	( 4 )
+	#endif
+
 	#ifndef ipconfigIGNORE_UNKNOWN_PACKETS
 		/* When non-zero, TCP will not send RST packets in reply to
 		TCP packets which are unknown, or out-of-order. */
@@ -321,6 +355,15 @@ from the FreeRTOSIPConfig.h configuration header file. */
 	#define ipconfigUDP_MAX_RX_PACKETS		0u
 #endif
 
+#ifndef ipconfigUDP_DIRECT_SEND
+	/* When non-zero, FreeRTOS_sendto() transmits a UDP packet from the context
+	 * of the calling task when the MAC address of the destination is found in
+	 * the ARP cache, instead of passing it to the IP-task.  Calls to
+	 * xNetworkInterfaceOutput() are then serialised with a mutex.
+	 */
+	#define ipconfigUDP_DIRECT_SEND			0
+#endif
+
 #ifndef ipconfigUSE_DHCP
 	#define ipconfigUSE_DHCP				1
 #endif
@@ -338,7 +381,36 @@ from the FreeRTOSIPConfig.h configuration header file. */
 	#define ipconfigDHCP_FALL_BACK_AUTO_IP		( 0 )
 #endif
 
-#if( ipconfigDHCP_FALL_BACK_AUTO_IP != 0 )
+#ifndef ipconfigDHCP_FAST_RECONNECT
+	/*
+	 * Only applicable when DHCP is in use:
+	 * Remember the last lease through xApplicationDHCPLeaseLoad() and
+	 * vApplicationDHCPLeaseStore(), and confirm it with a single REQUEST
+	 * (INIT-REBOOT) after a reset or a link flap, instead of a full
+	 * DISCOVER / OFFER / REQUEST / ACK cycle.
+	 */
+	#define ipconfigDHCP_FAST_RECONNECT			( 0 )
+#endif
+
+#ifndef ipconfigDHCP_INIT_REBOOT_TIMEOUT
+	/* The time after which an unanswered INIT-REBOOT request is given up, and
+	a DISCOVER is sent. */
+	#define ipconfigDHCP_INIT_REBOOT_TIMEOUT	( pdMS_TO_TICKS( 2000 ) )
+#endif
+
+#ifndef ipconfigDHCP_USE_RAPID_COMMIT
+	/* Include the Rapid Commit option (RFC 4039) in a DISCOVER, and accept an
+	ACK in reply to it, which saves one round trip. */
+	#define ipconfigDHCP_USE_RAPID_COMMIT		( 0 )
+#endif
+
+#ifndef ipconfigDHCP_ARP_PROBE
+	/* Probe the offered address with ARP while the REQUEST is outstanding, and
+	decline it when another device replies. */
+	#define ipconfigDHCP_ARP_PROBE				( 0 )
+#endif
+
+#if( ipconfigDHCP_FALL_BACK_AUTO_IP != 0 ) || ( ipconfigDHCP_ARP_PROBE != 0 )
 	#define ipconfigARP_USE_CLASH_DETECTION		1
 #endif
 
@@ -74,6 +74,14 @@ void vARPRefreshCacheEntry( const MACAddress_t * pxMACAddress, const uint32_t ul
 	extern BaseType_t xARPHadIPClash;
 	/* MAC-address of the other device containing the same IP-address. */
 	extern MACAddress_t xARPClashMacAddress;
+
+	/*
+	 * Send an ARP probe as described in RFC 5227: an ARP request for
+	 * ulIPAddress with a sender IP-address of zero.  xARPHadIPClash is cleared,
+	 * and it becomes non-zero when a reply for ulIPAddress is received.  Call
+	 * it with a zero address to stop the probing.
+	 */
+	void vARPSendProbe( uint32_t ulIPAddress );
 #endif /* ipconfigARP_USE_CLASH_DETECTION */
 
 #if( ipconfigUSE_ARP_REMOVE_ENTRY != 0 )
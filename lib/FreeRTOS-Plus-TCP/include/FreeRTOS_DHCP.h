@@ -67,6 +67,34 @@ http://www.FreeRTOS.org/FreeRTOS-Plus/FreeRTOS_Plus_TCP/TCP_IP_Configuration.htm
 */
 eDHCPCallbackAnswer_t xApplicationDHCPHook( eDHCPCallbackPhase_t eDHCPPhase, uint32_t ulIPAddress );
 
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	/* A lease as acknowledged by a DHCP server.  All addresses are stored in
+	network byte order. */
+	typedef struct xDHCP_LEASE
+	{
+		uint32_t ulIPAddress;
+		uint32_t ulNetMask;
+		uint32_t ulGatewayAddress;
+		uint32_t ulDNSServerAddress;
+		uint32_t ulServerAddress;
+		uint32_t ulLeaseSeconds;
+	} DHCPLease_t;
+
+	/* Hooks that must be provided by the application if
+	ipconfigDHCP_FAST_RECONNECT is set to 1.  xApplicationDHCPLeaseLoad() is
+	called once, before the first DHCP transaction, and returns pdTRUE if a
+	lease was found in non-volatile storage.  vApplicationDHCPLeaseStore() is
+	called each time a lease is acknowledged, and with a NULL pointer when the
+	stored lease must be erased. */
+	BaseType_t xApplicationDHCPLeaseLoad( DHCPLease_t *pxLease );
+	void vApplicationDHCPLeaseStore( const DHCPLease_t *pxLease );
+
+	/* Forget the lease, both the copy held by the DHCP client and the stored
+	one, so that the next DHCP transaction starts with a DISCOVER instead of an
+	INIT-REBOOT request. */
+	void vDHCPForgetLease( void );
+#endif /* ipconfigDHCP_FAST_RECONNECT */
+
 #ifdef __cplusplus
 }	/* extern "C" */
 #endif
@@ -254,6 +254,7 @@ typedef enum
 	eSocketCloseEvent,		/* 9: Send a message to the IP-task to close a socket. */
 	eSocketSelectEvent,		/*10: Send a message to the IP-task for select(). */
 	eSocketSignalEvent,		/*11: A socket must be signalled. */
+	eTCPSendEvent,			/*12: A socket with FREERTOS_SO_TCP_NODELAY has new data to send. */
 } eIPEvent_t;
 
 typedef struct IP_TASK_COMMANDS
@@ -531,7 +532,10 @@ BaseType_t xIPIsNetworkTaskReady( void );
 				bFinLast : 1,		/* The last ACK (after FIN and FIN+ACK) has been sent or will be sent by the peer */
 				bRxStopped : 1,		/* Application asked to temporarily stop reception */
 				bMallocError : 1,	/* There was an error allocating a stream */
-				bWinScaling : 1;	/* A TCP-Window Scaling option was offered and accepted in the SYN phase. */
+				bWinScaling : 1,	/* A TCP-Window Scaling option was offered and accepted in the SYN phase. */
+				bNoDelay : 1,		/* FREERTOS_SO_TCP_NODELAY: send new data immediately, piggy-back pending ACK's */
+				bCorked : 1,		/* FREERTOS_SO_TCP_CORK: only send full-size packets until the socket is uncorked */
+				bRxLoan : 1;		/* FREERTOS_SO_TCP_RX_LOAN: keep in-order segments in their network buffers */
 		} bits;
 		uint32_t ulHighestRxAllowed;
 								/* The highest sequence number that we can receive at any moment */
@@ -558,8 +562,16 @@ BaseType_t xIPIsNetworkTaskReady( void );
 		size_t uxTxStreamSize;
 		StreamBuffer_t *rxStream;
 		StreamBuffer_t *txStream;
+		#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+			List_t xRxLoanQueue;	/* Received network buffers, waiting to be read by the application */
+			List_t xRxLoanedList;	/* Network buffers which are on loan to the application */
+			size_t uxRxQueuedBytes;	/* Payload stored in xRxLoanQueue */
+			size_t uxRxLoanBytes;	/* Payload stored in both lists, it occupies Rx window space */
+		#endif /* ipconfigTCP_RX_BUFFER_LOANING */
 		#if( ipconfigUSE_TCP_WIN == 1 )
 			NetworkBufferDescriptor_t *pxAckMessage;
+			uint16_t usAckShortDelayMS;	/* Delayed ACK after a small segment, see FREERTOS_SO_TCP_DELAYED_ACK */
+			uint16_t usAckLongDelayMS;	/* Delayed ACK after a full-size segment */
 		#endif /* ipconfigUSE_TCP_WIN */
 		/* Buffer space to store the last TCP header received. */
 		LastTCPPacket_t xPacket;
@@ -674,6 +686,26 @@ FreeRTOS_Socket_t *pxUDPSocketLookup( UBaseType_t uxLocalPort );
  */
 void vProcessGeneratedUDPPacket( NetworkBufferDescriptor_t * const pxNetworkBuffer );
 
+#if( ipconfigUDP_DIRECT_SEND != 0 )
+	/*
+	 * Called by FreeRTOS_sendto() to transmit a UDP packet from the context of
+	 * the calling task.  Returns pdTRUE when the packet has been passed to the
+	 * network interface.  Returns pdFALSE, leaving the buffer untouched, when
+	 * the MAC address of the destination is not in the ARP cache: the packet
+	 * must then be passed to the IP-task.
+	 */
+	BaseType_t xSendUDPPacketDirect( NetworkBufferDescriptor_t * const pxNetworkBuffer );
+
+	/*
+	 * Now that xNetworkInterfaceOutput() may be called from other tasks than
+	 * the IP-task, all calls are made through this function which serialises
+	 * access to the network interface.
+	 */
+	BaseType_t xIPNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer, BaseType_t xReleaseAfterSend );
+#else
+	#define xIPNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend )	xNetworkInterfaceOutput( ( pxNetworkBuffer ), ( xReleaseAfterSend ) )
+#endif /* ipconfigUDP_DIRECT_SEND */
+
 /*
  * Calculate the upper-layer checksum
  * Works both for UDP, ICMP and TCP packages
@@ -706,6 +738,21 @@ BaseType_t vSocketBind( FreeRTOS_Socket_t *pxSocket, struct freertos_sockaddr *
  */
 int32_t lTCPAddRxdata(FreeRTOS_Socket_t *pxSocket, size_t uxOffset, const uint8_t *pcData, uint32_t ulByteCount);
 
+#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+	/*
+	 * Internal function to queue a received network buffer to a TCP socket
+	 * instead of copying its payload to the rxStream.  The payload starts at
+	 * uxOffset bytes from pucEthernetBuffer.  Buffers which are queued or on loan
+	 * take space from the Rx window, see ipTCP_RX_SPACE_MINUS_LOANS().
+	 */
+	void vTCPAddRxLoan( FreeRTOS_Socket_t *pxSocket, NetworkBufferDescriptor_t *pxNetworkBuffer, size_t uxOffset, uint32_t ulByteCount );
+
+	#define ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxSpace ) \
+		( ( ( size_t ) ( uxSpace ) > ( pxSocket )->u.xTCP.uxRxLoanBytes ) ? ( ( size_t ) ( uxSpace ) - ( pxSocket )->u.xTCP.uxRxLoanBytes ) : ( size_t ) 0u )
+#else
+	#define ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxSpace )		( uxSpace )
+#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
 /*
  * Currently called for any important event.
  */
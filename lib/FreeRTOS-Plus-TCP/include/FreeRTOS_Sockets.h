@@ -130,6 +130,17 @@ FreeRTOS_setsockopt(). */
 	#define FREERTOS_SO_WAKEUP_CALLBACK	( 17 )
 #endif
 
+#define FREERTOS_SO_TCP_NODELAY			( 18 )		/* Transmit new data as soon as FreeRTOS_send() is called, parameter is pointer to BaseType_t */
+#define FREERTOS_SO_TCP_CORK			( 19 )		/* Hold back small segments until the option is cleared again, parameter is pointer to BaseType_t */
+
+#if( ipconfigUSE_TCP_WIN == 1 )
+	#define FREERTOS_SO_TCP_DELAYED_ACK	( 20 )		/* Set the delays of outgoing ACK's, parameter is pointer to DelayedAckProperties_t */
+#endif
+
+#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+	#define FREERTOS_SO_TCP_RX_LOAN		( 21 )		/* Loan received network buffers to the application, see FreeRTOS_recv_loan(), parameter is pointer to BaseType_t */
+#endif
+
 
 #define FREERTOS_NOT_LAST_IN_FRAGMENTED_PACKET 	( 0x80 )  /* For internal use only, but also part of an 8-bit bitwise value. */
 #define FREERTOS_FRAGMENTED_PACKET				( 0x40 )  /* For internal use only, but also part of an 8-bit bitwise value. */
@@ -155,6 +166,14 @@ typedef struct xWIN_PROPS {
 	int32_t lRxWinSize;	/* Unit: MSS */
 } WinProperties_t;
 
+typedef struct xDELAYED_ACK_PROPS {
+	/* Delay used when a small segment was received, or when the Rx buffer is
+	getting full. */
+	uint16_t usShortDelayMS;	/* Unit: ms */
+	/* Delay used after receiving a full-size segment. */
+	uint16_t usLongDelayMS;		/* Unit: ms */
+} DelayedAckProperties_t;	/* A delay of zero: send the ACK immediately. */
+
 /* For compatibility with the expected Berkeley sockets naming. */
 #define socklen_t uint32_t
 
@@ -237,6 +256,17 @@ BaseType_t FreeRTOS_send( Socket_t xSocket, const void *pvBuffer, size_t uxDataL
 Socket_t FreeRTOS_accept( Socket_t xServerSocket, struct freertos_sockaddr *pxAddress, socklen_t *pxAddressLength );
 BaseType_t FreeRTOS_shutdown (Socket_t xSocket, BaseType_t xHow);
 
+#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+	/* For sockets with the FREERTOS_SO_TCP_RX_LOAN option: obtain a pointer to
+	the payload of the next received segment, which stays in its network buffer.
+	Returns the number of bytes available at *ppucBuffer, or a negative errno
+	value, just like FreeRTOS_recv().  The Rx window shrinks while buffers are
+	on loan, so each one must be returned with FreeRTOS_release_loan().  Loans
+	become invalid when the socket is closed. */
+	BaseType_t FreeRTOS_recv_loan( Socket_t xSocket, uint8_t **ppucBuffer, BaseType_t xFlags );
+	BaseType_t FreeRTOS_release_loan( Socket_t xSocket, const uint8_t *pucBuffer );
+#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
 #if( ipconfigSUPPORT_SIGNALS != 0 )
 	/* Send a signal to the task which is waiting for a given socket. */
 	BaseType_t FreeRTOS_SignalSocket( Socket_t xSocket );
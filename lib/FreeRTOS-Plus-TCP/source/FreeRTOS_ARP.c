@@ -52,6 +52,17 @@ to zero, so this is an old entry) an ARP request will be sent to see if the
 entry is still valid and can therefore be refreshed. */
 #define arpMAX_ARP_AGE_BEFORE_NEW_ARP_REQUEST		( 3 )
 
+/* When ipconfigUDP_DIRECT_SEND is defined, tasks calling FreeRTOS_sendto() read
+the ARP cache from within a critical section.  The IP-task must then change the
+contents of a row within a critical section as well. */
+#if( ipconfigUDP_DIRECT_SEND != 0 )
+	#define arpENTER_CRITICAL()		taskENTER_CRITICAL()
+	#define arpEXIT_CRITICAL()		taskEXIT_CRITICAL()
+#else
+	#define arpENTER_CRITICAL()
+	#define arpEXIT_CRITICAL()
+#endif
+
 /* The time between gratuitous ARPs. */
 #ifndef arpGRATUITOUS_ARP_PERIOD
 	#define arpGRATUITOUS_ARP_PERIOD					( pdMS_TO_TICKS( 20000 ) )
@@ -83,6 +94,8 @@ static TickType_t xLastGratuitousARPTime = ( TickType_t ) 0;
 	BaseType_t xARPHadIPClash;
 	/* MAC-address of the other device containing the same IP-address. */
 	MACAddress_t xARPClashMacAddress;
+	/* The address being probed by vARPSendProbe(), or zero. */
+	static uint32_t ulARPProbeAddress = 0UL;
 #endif /* ipconfigARP_USE_CLASH_DETECTION */
 
 /* Part of the Ethernet and ARP headers are always constant when sending an IPv4
@@ -120,7 +133,21 @@ uint32_t ulTargetProtocolAddress, ulSenderProtocolAddress;
 
 	traceARP_PACKET_RECEIVED();
 
-	/* Don't do anything if the local IP address is zero because
+	#if( ipconfigARP_USE_CLASH_DETECTION != 0 )
+	{
+		/* The local IP address is still zero while an offered address is
+		probed, so a reply to the probe is looked at before the test below. */
+		if( ( pxARPHeader->usOperation == ( uint16_t ) ipARP_REPLY ) &&
+			( ulARPProbeAddress != 0UL ) &&
+			( ulSenderProtocolAddress == ulARPProbeAddress ) )
+		{
+			xARPHadIPClash = pdTRUE;
+			memcpy( xARPClashMacAddress.ucBytes, pxARPHeader->xSenderHardwareAddress.ucBytes, sizeof( xARPClashMacAddress.ucBytes ) );
+		}
+	}
+	#endif /* ipconfigARP_USE_CLASH_DETECTION */
+
+	/* Don't do anything else if the local IP address is zero because
 	that means a DHCP request has not completed. */
 	if( *ipLOCAL_IP_ADDRESS_POINTER != 0UL )
 	{
@@ -198,7 +225,11 @@ uint32_t ulTargetProtocolAddress, ulSenderProtocolAddress;
 			if( ( memcmp( xARPCache[ x ].xMACAddress.ucBytes, pxMACAddress->ucBytes, sizeof( pxMACAddress->ucBytes ) ) == 0 ) )
 			{
 				lResult = xARPCache[ x ].ulIPAddress;
-				memset( &xARPCache[ x ], '\0', sizeof( xARPCache[ x ] ) );
+				arpENTER_CRITICAL();
+				{
+					memset( &xARPCache[ x ], '\0', sizeof( xARPCache[ x ] ) );
+				}
+				arpEXIT_CRITICAL();
 				break;
 			}
 		}
@@ -304,41 +335,45 @@ uint8_t ucMinAgeFound = 0U;
 			}
 		}
 
-		if( xMacEntry >= 0 )
+		arpENTER_CRITICAL();
 		{
-			xUseEntry = xMacEntry;
+			if( xMacEntry >= 0 )
+			{
+				xUseEntry = xMacEntry;
 
-			if( xIpEntry >= 0 )
+				if( xIpEntry >= 0 )
+				{
+					/* Both the MAC address as well as the IP address were found in
+					different locations: clear the entry which matches the
+					IP-address */
+					memset( &xARPCache[ xIpEntry ], '\0', sizeof( xARPCache[ xIpEntry ] ) );
+				}
+			}
+			else if( xIpEntry >= 0 )
 			{
-				/* Both the MAC address as well as the IP address were found in
-				different locations: clear the entry which matches the
-				IP-address */
-				memset( &xARPCache[ xIpEntry ], '\0', sizeof( xARPCache[ xIpEntry ] ) );
+				/* An entry containing the IP-address was found, but it had a different MAC address */
+				xUseEntry = xIpEntry;
 			}
-		}
-		else if( xIpEntry >= 0 )
-		{
-			/* An entry containing the IP-address was found, but it had a different MAC address */
-			xUseEntry = xIpEntry;
-		}
 
-		/* If the entry was not found, we use the oldest entry and set the IPaddress */
-		xARPCache[ xUseEntry ].ulIPAddress = ulIPAddress;
+			/* If the entry was not found, we use the oldest entry and set the IPaddress */
+			xARPCache[ xUseEntry ].ulIPAddress = ulIPAddress;
 
-		if( pxMACAddress != NULL )
-		{
-			memcpy( xARPCache[ xUseEntry ].xMACAddress.ucBytes, pxMACAddress->ucBytes, sizeof( pxMACAddress->ucBytes ) );
+			if( pxMACAddress != NULL )
+			{
+				memcpy( xARPCache[ xUseEntry ].xMACAddress.ucBytes, pxMACAddress->ucBytes, sizeof( pxMACAddress->ucBytes ) );
 
-			iptraceARP_TABLE_ENTRY_CREATED( ulIPAddress, (*pxMACAddress) );
-			/* And this entry does not need immediate attention */
-			xARPCache[ xUseEntry ].ucAge = ( uint8_t ) ipconfigMAX_ARP_AGE;
-			xARPCache[ xUseEntry ].ucValid = ( uint8_t ) pdTRUE;
-		}
-		else if( xIpEntry < 0 )
-		{
-			xARPCache[ xUseEntry ].ucAge = ( uint8_t ) ipconfigMAX_ARP_RETRANSMISSIONS;
-			xARPCache[ xUseEntry ].ucValid = ( uint8_t ) pdFALSE;
+				iptraceARP_TABLE_ENTRY_CREATED( ulIPAddress, (*pxMACAddress) );
+				/* And this entry does not need immediate attention */
+				xARPCache[ xUseEntry ].ucAge = ( uint8_t ) ipconfigMAX_ARP_AGE;
+				xARPCache[ xUseEntry ].ucValid = ( uint8_t ) pdTRUE;
+			}
+			else if( xIpEntry < 0 )
+			{
+				xARPCache[ xUseEntry ].ucAge = ( uint8_t ) ipconfigMAX_ARP_RETRANSMISSIONS;
+				xARPCache[ xUseEntry ].ucValid = ( uint8_t ) pdFALSE;
+			}
 		}
+		arpEXIT_CRITICAL();
 	}
 }
 /*-----------------------------------------------------------*/
@@ -553,6 +588,25 @@ void vARPSendGratuitous( void )
 }
 
 /*-----------------------------------------------------------*/
+
+#if( ipconfigARP_USE_CLASH_DETECTION != 0 )
+
+	void vARPSendProbe( uint32_t ulIPAddress )
+	{
+		ulARPProbeAddress = ulIPAddress;
+		xARPHadIPClash = pdFALSE;
+
+		/* The local IP-address is zero while the address is being probed, so
+		the request goes out with a sender IP-address of zero. */
+		if( ( ulIPAddress != 0UL ) && ( *ipLOCAL_IP_ADDRESS_POINTER == 0UL ) )
+		{
+			FreeRTOS_OutputARPRequest( ulIPAddress );
+		}
+	}
+
+#endif /* ipconfigARP_USE_CLASH_DETECTION */
+/*-----------------------------------------------------------*/
+
 void FreeRTOS_OutputARPRequest( uint32_t ulIPAddress )
 {
 NetworkBufferDescriptor_t *pxNetworkBuffer;
@@ -581,7 +635,7 @@ NetworkBufferDescriptor_t *pxNetworkBuffer;
 		}
 		#endif
 
-		xNetworkInterfaceOutput( pxNetworkBuffer, pdTRUE );
+		xIPNetworkInterfaceOutput( pxNetworkBuffer, pdTRUE );
 	}
 }
 
@@ -617,7 +671,11 @@ ARPPacket_t *pxARPPacket;
 
 void FreeRTOS_ClearARP( void )
 {
-	memset( xARPCache, '\0', sizeof( xARPCache ) );
+	arpENTER_CRITICAL();
+	{
+		memset( xARPCache, '\0', sizeof( xARPCache ) );
+	}
+	arpEXIT_CRITICAL();
 }
 /*-----------------------------------------------------------*/
 
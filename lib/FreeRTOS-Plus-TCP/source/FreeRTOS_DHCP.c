@@ -74,11 +74,13 @@
 #define dhcpSERVER_IP_ADDRESS_OPTION_CODE		( 54u )
 #define dhcpPARAMETER_REQUEST_OPTION_CODE		( 55u )
 #define dhcpCLIENT_IDENTIFIER_OPTION_CODE		( 61u )
+#define dhcpRAPID_COMMIT_OPTION_CODE			( 80u )
 
 /* The four DHCP message types of interest. */
 #define dhcpMESSAGE_TYPE_DISCOVER				( 1 )
 #define dhcpMESSAGE_TYPE_OFFER					( 2 )
 #define dhcpMESSAGE_TYPE_REQUEST				( 3 )
+#define dhcpMESSAGE_TYPE_DECLINE				( 4 )
 #define dhcpMESSAGE_TYPE_ACK					( 5 )
 #define dhcpMESSAGE_TYPE_NACK					( 6 )
 
@@ -101,6 +103,11 @@ are located. */
 /* Don't allow the lease time to be too short. */
 #define dhcpMINIMUM_LEASE_TIME					( pdMS_TO_TICKS( 60000UL ) )	/* 60 seconds in ticks. */
 
+/* The first retransmission period of an INIT-REBOOT request.  The period
+doubles, but the last one is shortened so that the request is given up
+ipconfigDHCP_INIT_REBOOT_TIMEOUT after it was first sent. */
+#define dhcpINIT_REBOOT_TX_PERIOD				( ( TickType_t ) ( ipconfigDHCP_INIT_REBOOT_TIMEOUT / 4U ) )
+
 /* Marks the end of the variable length options field in the DHCP packet. */
 #define dhcpOPTION_END_BYTE 0xffu
 
@@ -178,6 +185,23 @@ struct xDHCP_DATA
 	eDHCPState_t eDHCPState;
 	/* The UDP socket used for all incoming and outgoing DHCP traffic. */
 	Socket_t xDHCPSocket;
+	/* The lease time in seconds, as granted by the server. */
+	uint32_t ulLeaseSeconds;
+	#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+		/* The last lease that was acknowledged, used for INIT-REBOOT. */
+		DHCPLease_t xLease;
+		BaseType_t xHasLease;
+		/* xApplicationDHCPLeaseLoad() is only called once. */
+		BaseType_t xLeaseLoaded;
+		/* The REQUEST confirms a previous lease, no server is selected. */
+		BaseType_t xInitReboot;
+		/* When the first INIT-REBOOT request was sent. */
+		TickType_t xInitRebootTime;
+	#endif
+	#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+		/* The server answered the DISCOVER with an ACK, RFC 4039. */
+		BaseType_t xRapidCommit;
+	#endif
 };
 
 typedef struct xDHCP_DATA DHCPData_t;
@@ -236,6 +260,26 @@ static void prvCreateDHCPSocket( void );
 	static void prvPrepareLinkLayerIPLookUp( void );
 #endif
 
+/*
+ * An ACK has been received: start using the leased address.
+ */
+static void prvDHCPBound( void );
+
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	/*
+	 * Send a REQUEST for the last leased address, without selecting a server,
+	 * as described for the INIT-REBOOT state in RFC 2131, section 3.2.
+	 */
+	static void prvSendDHCPInitReboot( void );
+#endif
+
+#if( ipconfigDHCP_ARP_PROBE != 0 )
+	/*
+	 * Tell the server that the offered address is in use by another device.
+	 */
+	static void prvSendDHCPDecline( void );
+#endif
+
 /*-----------------------------------------------------------*/
 
 /* The next DHCP transaction Id to be used. */
@@ -266,6 +310,9 @@ BaseType_t xGivingUp = pdFALSE;
 #if( ipconfigUSE_DHCP_HOOK != 0 )
 	eDHCPCallbackAnswer_t eAnswer;
 #endif	/* ipconfigUSE_DHCP_HOOK */
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	TickType_t xElapsed;
+#endif	/* ipconfigDHCP_FAST_RECONNECT */
 
 	/* Is DHCP starting over? */
 	if( xReset != pdFALSE )
@@ -295,6 +342,29 @@ BaseType_t xGivingUp = pdFALSE;
 
 				*ipLOCAL_IP_ADDRESS_POINTER = 0UL;
 
+				#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+				{
+					if( xDHCPData.xLeaseLoaded == pdFALSE )
+					{
+						/* Only after a reset: see if a lease was stored. */
+						xDHCPData.xLeaseLoaded = pdTRUE;
+						if( xApplicationDHCPLeaseLoad( &( xDHCPData.xLease ) ) != pdFALSE )
+						{
+							xDHCPData.xHasLease = ( xDHCPData.xLease.ulIPAddress != 0UL );
+						}
+					}
+
+					if( xDHCPData.xHasLease != pdFALSE )
+					{
+						/* Ask the server to confirm the previous lease.  If it
+						does not answer in time, a DISCOVER will be sent. */
+						xDHCPData.xHasLease = pdFALSE;
+						prvSendDHCPInitReboot();
+						break;
+					}
+				}
+				#endif /* ipconfigDHCP_FAST_RECONNECT */
+
 				/* Send the first discover request. */
 				if( xDHCPData.xDHCPSocket != NULL )
 				{
@@ -324,6 +394,16 @@ BaseType_t xGivingUp = pdFALSE;
 			/* Look for offers coming in. */
 			if( prvProcessDHCPReplies( dhcpMESSAGE_TYPE_OFFER ) == pdPASS )
 			{
+			#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+				if( xDHCPData.xRapidCommit != pdFALSE )
+				{
+					/* The server has committed the address already, there will
+					be no REQUEST and ACK. */
+					prvDHCPBound();
+					break;
+				}
+			#endif /* ipconfigDHCP_USE_RAPID_COMMIT */
+
 			#if( ipconfigUSE_DHCP_HOOK != 0 )
 				/* Ask the user if a DHCP request is required. */
 				eAnswer = xApplicationDHCPHook( eDHCPPhasePreRequest, xDHCPData.ulOfferedIPAddress );
@@ -337,6 +417,14 @@ BaseType_t xGivingUp = pdFALSE;
 					xDHCPData.xDHCPTxPeriod = dhcpINITIAL_DHCP_TX_PERIOD;
 					prvSendDHCPRequest( );
 					xDHCPData.eDHCPState = eWaitingAcknowledge;
+
+					#if( ipconfigDHCP_ARP_PROBE != 0 )
+					{
+						/* Probe the offered address while waiting for the ACK,
+						rather than after it. */
+						vARPSendProbe( xDHCPData.ulOfferedIPAddress );
+					}
+					#endif
 					break;
 				}
 
@@ -403,63 +491,76 @@ BaseType_t xGivingUp = pdFALSE;
 			/* Look for acks coming in. */
 			if( prvProcessDHCPReplies( dhcpMESSAGE_TYPE_ACK ) == pdPASS )
 			{
-				FreeRTOS_debug_printf( ( "vDHCPProcess: acked %lxip\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
-
-				/* DHCP completed.  The IP address can now be used, and the
-				timer set to the lease timeout time. */
-				*ipLOCAL_IP_ADDRESS_POINTER = xDHCPData.ulOfferedIPAddress;
-
-				/* Setting the 'local' broadcast address, something like
-				'192.168.1.255'. */
-				xNetworkAddressing.ulBroadcastAddress = ( xDHCPData.ulOfferedIPAddress & xNetworkAddressing.ulNetMask ) |  ~xNetworkAddressing.ulNetMask;
-				xDHCPData.eDHCPState = eLeasedAddress;
-
-				iptraceDHCP_SUCCEDEED( xDHCPData.ulOfferedIPAddress );
-
-				/* DHCP failed, the default configured IP-address will be used
-				Now call vIPNetworkUpCalls() to send the network-up event and
-				start the ARP timer. */
-				vIPNetworkUpCalls( );
-
-				/* Close socket to ensure packets don't queue on it. */
-				vSocketClose( xDHCPData.xDHCPSocket );
-				xDHCPData.xDHCPSocket = NULL;
-
-				if( xDHCPData.ulLeaseTime == 0UL )
-				{
-					xDHCPData.ulLeaseTime = dhcpDEFAULT_LEASE_TIME;
-				}
-				else if( xDHCPData.ulLeaseTime < dhcpMINIMUM_LEASE_TIME )
+			#if( ipconfigDHCP_ARP_PROBE != 0 )
+				if( xARPHadIPClash != pdFALSE )
 				{
-					xDHCPData.ulLeaseTime = dhcpMINIMUM_LEASE_TIME;
+					/* Another device answered the ARP probe: the address is
+					in use already. */
+					FreeRTOS_printf( ( "vDHCPProcess: %lxip is in use, declined\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
+					prvSendDHCPDecline();
+					vARPSendProbe( 0UL );
+					#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+					{
+						vApplicationDHCPLeaseStore( NULL );
+					}
+					#endif
+					xDHCPData.eDHCPState = eWaitingSendFirstDiscover;
 				}
 				else
+			#endif /* ipconfigDHCP_ARP_PROBE */
 				{
-					/* The lease time is already valid. */
+					prvDHCPBound();
 				}
-
-				/* Check for clashes. */
-				vARPSendGratuitous();
-				vIPReloadDHCPTimer( xDHCPData.ulLeaseTime );
 			}
 			else
 			{
 				/* Is it time to send another Discover? */
 				if( ( xTaskGetTickCount() - xDHCPData.xDHCPTxTime ) > xDHCPData.xDHCPTxPeriod )
 				{
-					/* Increase the time period, and if it has not got to the
-					point of giving up - send another request. */
-					xDHCPData.xDHCPTxPeriod <<= 1;
-
-					if( xDHCPData.xDHCPTxPeriod <= ipconfigMAXIMUM_DISCOVER_TX_PERIOD )
+				#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+					if( xDHCPData.xInitReboot != pdFALSE )
 					{
-						xDHCPData.xDHCPTxTime = xTaskGetTickCount();
-						prvSendDHCPRequest( );
+						/* An INIT-REBOOT request is given up once
+						ipconfigDHCP_INIT_REBOOT_TIMEOUT has passed since it
+						was first sent, so the doubled period is clamped to
+						the time left. */
+						xElapsed = xTaskGetTickCount() - xDHCPData.xInitRebootTime;
+
+						if( xElapsed < ( TickType_t ) ipconfigDHCP_INIT_REBOOT_TIMEOUT )
+						{
+							xDHCPData.xDHCPTxPeriod <<= 1;
+
+							if( xDHCPData.xDHCPTxPeriod > ( ( TickType_t ) ipconfigDHCP_INIT_REBOOT_TIMEOUT - xElapsed ) )
+							{
+								xDHCPData.xDHCPTxPeriod = ( TickType_t ) ipconfigDHCP_INIT_REBOOT_TIMEOUT - xElapsed;
+							}
+
+							xDHCPData.xDHCPTxTime = xTaskGetTickCount();
+							prvSendDHCPRequest( );
+						}
+						else
+						{
+							/* Give up, start again with a DISCOVER. */
+							xDHCPData.eDHCPState = eWaitingSendFirstDiscover;
+						}
 					}
 					else
+				#endif /* ipconfigDHCP_FAST_RECONNECT */
 					{
-						/* Give up, start again. */
-						xDHCPData.eDHCPState = eWaitingSendFirstDiscover;
+						/* Increase the time period, and if it has not got to the
+						point of giving up - send another request. */
+						xDHCPData.xDHCPTxPeriod <<= 1;
+
+						if( xDHCPData.xDHCPTxPeriod <= ipconfigMAXIMUM_DISCOVER_TX_PERIOD )
+						{
+							xDHCPData.xDHCPTxTime = xTaskGetTickCount();
+							prvSendDHCPRequest( );
+						}
+						else
+						{
+							/* Give up, start again. */
+							xDHCPData.eDHCPState = eWaitingSendFirstDiscover;
+						}
 					}
 				}
 			}
@@ -552,6 +653,72 @@ BaseType_t xGivingUp = pdFALSE;
 }
 /*-----------------------------------------------------------*/
 
+static void prvDHCPBound( void )
+{
+	FreeRTOS_debug_printf( ( "vDHCPProcess: acked %lxip\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
+
+	/* DHCP completed.  The IP address can now be used, and the
+	timer set to the lease timeout time. */
+	*ipLOCAL_IP_ADDRESS_POINTER = xDHCPData.ulOfferedIPAddress;
+
+	/* Setting the 'local' broadcast address, something like
+	'192.168.1.255'. */
+	xNetworkAddressing.ulBroadcastAddress = ( xDHCPData.ulOfferedIPAddress & xNetworkAddressing.ulNetMask ) |  ~xNetworkAddressing.ulNetMask;
+	xDHCPData.eDHCPState = eLeasedAddress;
+
+	iptraceDHCP_SUCCEDEED( xDHCPData.ulOfferedIPAddress );
+
+	/* DHCP failed, the default configured IP-address will be used
+	Now call vIPNetworkUpCalls() to send the network-up event and
+	start the ARP timer. */
+	vIPNetworkUpCalls( );
+
+	/* Close socket to ensure packets don't queue on it. */
+	vSocketClose( xDHCPData.xDHCPSocket );
+	xDHCPData.xDHCPSocket = NULL;
+
+	if( xDHCPData.ulLeaseTime == 0UL )
+	{
+		xDHCPData.ulLeaseTime = dhcpDEFAULT_LEASE_TIME;
+	}
+	else if( xDHCPData.ulLeaseTime < dhcpMINIMUM_LEASE_TIME )
+	{
+		xDHCPData.ulLeaseTime = dhcpMINIMUM_LEASE_TIME;
+	}
+	else
+	{
+		/* The lease time is already valid. */
+	}
+
+	/* Check for clashes. */
+	vARPSendGratuitous();
+	vIPReloadDHCPTimer( xDHCPData.ulLeaseTime );
+
+	#if( ipconfigDHCP_ARP_PROBE != 0 )
+	{
+		/* The probe has ended. */
+		vARPSendProbe( 0UL );
+	}
+	#endif
+
+	#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	{
+		/* Remember the lease, so that it can be confirmed quickly after a
+		link flap or a reset. */
+		xDHCPData.xInitReboot = pdFALSE;
+		xDHCPData.xLease.ulIPAddress = xDHCPData.ulOfferedIPAddress;
+		xDHCPData.xLease.ulNetMask = xNetworkAddressing.ulNetMask;
+		xDHCPData.xLease.ulGatewayAddress = xNetworkAddressing.ulGatewayAddress;
+		xDHCPData.xLease.ulDNSServerAddress = xNetworkAddressing.ulDNSServerAddress;
+		xDHCPData.xLease.ulServerAddress = xDHCPData.ulDHCPServerAddress;
+		xDHCPData.xLease.ulLeaseSeconds = xDHCPData.ulLeaseSeconds;
+		xDHCPData.xHasLease = pdTRUE;
+		vApplicationDHCPLeaseStore( &( xDHCPData.xLease ) );
+	}
+	#endif /* ipconfigDHCP_FAST_RECONNECT */
+}
+/*-----------------------------------------------------------*/
+
 static void prvCreateDHCPSocket( void )
 {
 struct freertos_sockaddr xAddress;
@@ -603,6 +770,17 @@ static void prvInitialiseDHCP( void )
 		xDHCPData.ulOfferedIPAddress = 0UL;
 		xDHCPData.ulDHCPServerAddress = 0UL;
 		xDHCPData.xDHCPTxPeriod = dhcpINITIAL_DHCP_TX_PERIOD;
+		xDHCPData.ulLeaseSeconds = 0UL;
+		#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+		{
+			xDHCPData.xInitReboot = pdFALSE;
+		}
+		#endif
+		#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+		{
+			xDHCPData.xRapidCommit = pdFALSE;
+		}
+		#endif
 
 		/* Create the DHCP socket if it has not already been created. */
 		prvCreateDHCPSocket();
@@ -623,6 +801,9 @@ uint8_t *pucByte, ucOptionCode, ucLength;
 uint32_t ulProcessed, ulParameter;
 BaseType_t xReturn = pdFALSE;
 const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct DHCP message type must be present in the options. */
+#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+	BaseType_t xRapidAck = pdFALSE, xRapidCommitOption = pdFALSE;
+#endif
 
 	lBytes = FreeRTOS_recvfrom( xDHCPData.xDHCPSocket, ( void * ) &pucUDPPayload, 0ul, FREERTOS_ZERO_COPY, &xClient, &xClientLength );
 
@@ -705,12 +886,35 @@ const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct
 								state machine is expecting. */
 								ulProcessed++;
 							}
+						#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+							else if( ( *pucByte == ( uint8_t ) dhcpMESSAGE_TYPE_ACK ) &&
+									 ( xExpectedMessageType == ( BaseType_t ) dhcpMESSAGE_TYPE_OFFER ) )
+							{
+								/* An ACK in reply to a DISCOVER is only valid
+								together with the Rapid Commit option. */
+								xRapidAck = pdTRUE;
+							}
+						#endif /* ipconfigDHCP_USE_RAPID_COMMIT */
 							else if( *pucByte == ( uint8_t ) dhcpMESSAGE_TYPE_NACK )
 							{
 								if( xExpectedMessageType == ( BaseType_t ) dhcpMESSAGE_TYPE_ACK )
 								{
 									/* Start again. */
 									xDHCPData.eDHCPState = eWaitingSendFirstDiscover;
+
+									#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+									{
+										/* The stored lease is not valid any more. */
+										if( xDHCPData.xInitReboot != pdFALSE )
+										{
+											vApplicationDHCPLeaseStore( NULL );
+										}
+									}
+									#endif
+
+									/* Don't wait for the DHCP timer to send the
+									DISCOVER. */
+									xSendEventToIPTask( eDHCPEvent );
 								}
 							}
 							else
@@ -749,9 +953,11 @@ const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct
 
 							if( ucLength == sizeof( uint32_t ) )
 							{
-								if( xExpectedMessageType == ( BaseType_t ) dhcpMESSAGE_TYPE_OFFER )
+								if( ( xExpectedMessageType == ( BaseType_t ) dhcpMESSAGE_TYPE_OFFER ) ||
+									( xDHCPData.ulDHCPServerAddress == 0UL ) )
 								{
-									/* Offers state the replying server. */
+									/* Offers state the replying server, and so does
+									the ACK to an INIT-REBOOT request. */
 									ulProcessed++;
 									xDHCPData.ulDHCPServerAddress = ulParameter;
 								}
@@ -775,6 +981,7 @@ const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct
 								/* The DHCP parameter is in seconds, convert
 								to host-endian format. */
 								xDHCPData.ulLeaseTime = FreeRTOS_ntohl( ulParameter );
+								xDHCPData.ulLeaseSeconds = xDHCPData.ulLeaseTime;
 
 								/* Divide the lease time by two to ensure a
 								renew request is sent before the lease actually
@@ -787,6 +994,13 @@ const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct
 							}
 							break;
 
+					#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+						case dhcpRAPID_COMMIT_OPTION_CODE :
+
+							xRapidCommitOption = pdTRUE;
+							break;
+					#endif /* ipconfigDHCP_USE_RAPID_COMMIT */
+
 						default :
 
 							/* Not interested in this field. */
@@ -794,20 +1008,29 @@ const uint32_t ulMandatoryOptions = 2ul; /* DHCP server address, and the correct
 							break;
 					}
 
-					/* Jump over the data to find the next option code. */
-					if( ucLength == 0u )
-					{
-						break;
-					}
-					else
+					/* Jump over the data to find the next option code.  Some
+					options, like Rapid Commit, have no data at all. */
+					pucByte += ucLength;
+				}
+
+				#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+				{
+					if( ( xRapidAck != pdFALSE ) && ( xRapidCommitOption != pdFALSE ) )
 					{
-						pucByte += ucLength;
+						ulProcessed++;
 					}
 				}
+				#endif /* ipconfigDHCP_USE_RAPID_COMMIT */
 
 				/* Were all the mandatory options received? */
 				if( ulProcessed >= ulMandatoryOptions )
 				{
+					#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+					{
+						xDHCPData.xRapidCommit = xRapidAck;
+					}
+					#endif
+
 					/* HT:endian: used to be network order */
 					xDHCPData.ulOfferedIPAddress = pxDHCPMessage->ulYourIPAddress_yiaddr;
 					FreeRTOS_printf( ( "vDHCPProcess: offer %lxip\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
@@ -911,18 +1134,38 @@ static const uint8_t ucDHCPRequestOptions[] =
 	dhcpSERVER_IP_ADDRESS_OPTION_CODE, 4, 0, 0, 0, 0,				/* The IP address of the DHCP server. */
 	dhcpOPTION_END_BYTE
 };
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	/* In the INIT-REBOOT state, the server identifier must not be sent. */
+	static const uint8_t ucDHCPInitRebootOptions[] =
+	{
+		dhcpMESSAGE_TYPE_OPTION_CODE, 1, dhcpMESSAGE_TYPE_REQUEST,		/* Message type option. */
+		dhcpCLIENT_IDENTIFIER_OPTION_CODE, 6, 0, 0, 0, 0, 0, 0,			/* Client identifier. */
+		dhcpREQUEST_IP_ADDRESS_OPTION_CODE, 4, 0, 0, 0, 0,				/* The IP address being requested. */
+		dhcpOPTION_END_BYTE
+	};
+#endif
 size_t xOptionsLength = sizeof( ucDHCPRequestOptions );
 
-	pucUDPPayloadBuffer = prvCreatePartDHCPMessage( &xAddress, dhcpREQUEST_OPCODE, ucDHCPRequestOptions, &xOptionsLength );
+	#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+	if( xDHCPData.xInitReboot != pdFALSE )
+	{
+		xOptionsLength = sizeof( ucDHCPInitRebootOptions );
+		pucUDPPayloadBuffer = prvCreatePartDHCPMessage( &xAddress, dhcpREQUEST_OPCODE, ucDHCPInitRebootOptions, &xOptionsLength );
+	}
+	else
+	#endif /* ipconfigDHCP_FAST_RECONNECT */
+	{
+		pucUDPPayloadBuffer = prvCreatePartDHCPMessage( &xAddress, dhcpREQUEST_OPCODE, ucDHCPRequestOptions, &xOptionsLength );
+
+		/* Copy in the address of the DHCP server being used. */
+		memcpy( ( void * ) &( pucUDPPayloadBuffer[ dhcpFIRST_OPTION_BYTE_OFFSET + dhcpDHCP_SERVER_IP_ADDRESS_OFFSET ] ),
+			( void * ) &( xDHCPData.ulDHCPServerAddress ), sizeof( xDHCPData.ulDHCPServerAddress ) );
+	}
 
 	/* Copy in the IP address being requested. */
 	memcpy( ( void * ) &( pucUDPPayloadBuffer[ dhcpFIRST_OPTION_BYTE_OFFSET + dhcpREQUESTED_IP_ADDRESS_OFFSET ] ),
 		( void * ) &( xDHCPData.ulOfferedIPAddress ), sizeof( xDHCPData.ulOfferedIPAddress ) );
 
-	/* Copy in the address of the DHCP server being used. */
-	memcpy( ( void * ) &( pucUDPPayloadBuffer[ dhcpFIRST_OPTION_BYTE_OFFSET + dhcpDHCP_SERVER_IP_ADDRESS_OFFSET ] ),
-		( void * ) &( xDHCPData.ulDHCPServerAddress ), sizeof( xDHCPData.ulDHCPServerAddress ) );
-
 	FreeRTOS_debug_printf( ( "vDHCPProcess: reply %lxip\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
 	iptraceSENDING_DHCP_REQUEST();
 
@@ -945,6 +1188,9 @@ static const uint8_t ucDHCPDiscoverOptions[] =
 	dhcpMESSAGE_TYPE_OPTION_CODE, 1, dhcpMESSAGE_TYPE_DISCOVER,					/* Message type option. */
 	dhcpCLIENT_IDENTIFIER_OPTION_CODE, 6, 0, 0, 0, 0, 0, 0,						/* Client identifier. */
 	dhcpPARAMETER_REQUEST_OPTION_CODE, 3, dhcpSUBNET_MASK_OPTION_CODE, dhcpGATEWAY_OPTION_CODE, dhcpDNS_SERVER_OPTIONS_CODE,	/* Parameter request option. */
+#if( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+	dhcpRAPID_COMMIT_OPTION_CODE, 0,												/* Rapid Commit, RFC 4039. */
+#endif
 	dhcpOPTION_END_BYTE
 };
 size_t xOptionsLength = sizeof( ucDHCPDiscoverOptions );
@@ -963,6 +1209,89 @@ size_t xOptionsLength = sizeof( ucDHCPDiscoverOptions );
 }
 /*-----------------------------------------------------------*/
 
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+
+	void vDHCPForgetLease( void )
+	{
+		taskENTER_CRITICAL();
+		{
+			/* Don't load the stored lease either, it is erased below. */
+			xDHCPData.xHasLease = pdFALSE;
+			xDHCPData.xLeaseLoaded = pdTRUE;
+		}
+		taskEXIT_CRITICAL();
+
+		vApplicationDHCPLeaseStore( NULL );
+	}
+
+#endif /* ipconfigDHCP_FAST_RECONNECT */
+/*-----------------------------------------------------------*/
+
+#if( ipconfigDHCP_FAST_RECONNECT != 0 )
+
+	static void prvSendDHCPInitReboot( void )
+	{
+		/* Use the stored lease until the ACK provides new values. */
+		xDHCPData.ulOfferedIPAddress = xDHCPData.xLease.ulIPAddress;
+		xDHCPData.ulDHCPServerAddress = 0UL;
+		xNetworkAddressing.ulNetMask = xDHCPData.xLease.ulNetMask;
+		xNetworkAddressing.ulGatewayAddress = xDHCPData.xLease.ulGatewayAddress;
+		xNetworkAddressing.ulDNSServerAddress = xDHCPData.xLease.ulDNSServerAddress;
+
+		FreeRTOS_debug_printf( ( "vDHCPProcess: init-reboot %lxip\n", FreeRTOS_ntohl( xDHCPData.ulOfferedIPAddress ) ) );
+
+		xDHCPData.xInitReboot = pdTRUE;
+		xDHCPData.xDHCPTxTime = xTaskGetTickCount();
+		xDHCPData.xInitRebootTime = xDHCPData.xDHCPTxTime;
+		xDHCPData.xDHCPTxPeriod = dhcpINIT_REBOOT_TX_PERIOD;
+		prvSendDHCPRequest( );
+		xDHCPData.eDHCPState = eWaitingAcknowledge;
+
+		#if( ipconfigDHCP_ARP_PROBE != 0 )
+		{
+			vARPSendProbe( xDHCPData.ulOfferedIPAddress );
+		}
+		#endif
+	}
+
+#endif /* ipconfigDHCP_FAST_RECONNECT */
+/*-----------------------------------------------------------*/
+
+#if( ipconfigDHCP_ARP_PROBE != 0 )
+
+	static void prvSendDHCPDecline( void )
+	{
+	uint8_t *pucUDPPayloadBuffer;
+	struct freertos_sockaddr xAddress;
+	static const uint8_t ucDHCPDeclineOptions[] =
+	{
+		/* Same layout as the options of a DHCP request. */
+		dhcpMESSAGE_TYPE_OPTION_CODE, 1, dhcpMESSAGE_TYPE_DECLINE,		/* Message type option. */
+		dhcpCLIENT_IDENTIFIER_OPTION_CODE, 6, 0, 0, 0, 0, 0, 0,			/* Client identifier. */
+		dhcpREQUEST_IP_ADDRESS_OPTION_CODE, 4, 0, 0, 0, 0,				/* The IP address being declined. */
+		dhcpSERVER_IP_ADDRESS_OPTION_CODE, 4, 0, 0, 0, 0,				/* The IP address of the DHCP server. */
+		dhcpOPTION_END_BYTE
+	};
+	size_t xOptionsLength = sizeof( ucDHCPDeclineOptions );
+
+		pucUDPPayloadBuffer = prvCreatePartDHCPMessage( &xAddress, dhcpREQUEST_OPCODE, ucDHCPDeclineOptions, &xOptionsLength );
+
+		memcpy( ( void * ) &( pucUDPPayloadBuffer[ dhcpFIRST_OPTION_BYTE_OFFSET + dhcpREQUESTED_IP_ADDRESS_OFFSET ] ),
+			( void * ) &( xDHCPData.ulOfferedIPAddress ), sizeof( xDHCPData.ulOfferedIPAddress ) );
+		memcpy( ( void * ) &( pucUDPPayloadBuffer[ dhcpFIRST_OPTION_BYTE_OFFSET + dhcpDHCP_SERVER_IP_ADDRESS_OFFSET ] ),
+			( void * ) &( xDHCPData.ulDHCPServerAddress ), sizeof( xDHCPData.ulDHCPServerAddress ) );
+
+		if( FreeRTOS_sendto( xDHCPData.xDHCPSocket, pucUDPPayloadBuffer, ( sizeof( DHCPMessage_t ) + xOptionsLength ), FREERTOS_ZERO_COPY, &xAddress, sizeof( xAddress ) ) == 0 )
+		{
+			/* The packet was not successfully queued for sending and must be
+			returned to the stack. */
+			FreeRTOS_ReleaseUDPPayloadBuffer( pucUDPPayloadBuffer );
+		}
+	}
+
+#endif /* ipconfigDHCP_ARP_PROBE */
+/*-----------------------------------------------------------*/
+
 #if( ipconfigDHCP_FALL_BACK_AUTO_IP != 0 )
 
 	static void prvPrepareLinkLayerIPLookUp( void )
@@ -247,6 +247,12 @@ static eFrameProcessingResult_t prvAllowIPPacket( const IPPacket_t * const pxIPP
 /* The queue used to pass events into the IP-task for processing. */
 QueueHandle_t xNetworkEventQueue = NULL;
 
+#if( ipconfigUDP_DIRECT_SEND != 0 )
+	/* Serialises the calls to xNetworkInterfaceOutput() made by the IP-task
+	and by tasks that send UDP packets directly. */
+	static SemaphoreHandle_t xNetworkOutputMutex = NULL;
+#endif
+
 /*_RB_ Requires comment. */
 uint16_t usPacketIdentifier = 0U;
 
@@ -473,6 +479,19 @@ struct freertos_sockaddr xAddress;
 				#endif /* ipconfigUSE_TCP */
 				break;
 
+			case eTCPSendEvent :
+				#if( ipconfigUSE_TCP == 1 )
+				{
+					/* FreeRTOS_send() was called for a socket that has the
+					option FREERTOS_SO_TCP_NODELAY set.  Transmit the new data
+					now, rather than waiting for the next TCP timer check. */
+					pxSocket = ( FreeRTOS_Socket_t * ) ( xReceivedEvent.pvData );
+					pxSocket->u.xTCP.usTimeout = 0u;
+					( void ) xTCPSocketCheck( pxSocket );
+				}
+				#endif /* ipconfigUSE_TCP */
+				break;
+
 			case eTCPAcceptEvent:
 				/* The API FreeRTOS_accept() was called, the IP-task will now
 				check if the listening socket (communicated in pvData) actually
@@ -997,6 +1016,21 @@ BaseType_t xReturn = pdFALSE;
 			/* Prepare the sockets interface. */
 			xReturn = vNetworkSocketsInit();
 
+			#if( ipconfigUDP_DIRECT_SEND != 0 )
+			{
+				if( pdTRUE == xReturn )
+				{
+					xNetworkOutputMutex = xSemaphoreCreateMutex();
+					configASSERT( xNetworkOutputMutex );
+
+					if( xNetworkOutputMutex == NULL )
+					{
+						xReturn = pdFALSE;
+					}
+				}
+			}
+			#endif /* ipconfigUDP_DIRECT_SEND */
+
 			if( pdTRUE == xReturn )
 			{
 				/* Create the task that processes Ethernet and stack events. */
@@ -2189,11 +2223,29 @@ EthernetHeader_t *pxEthernetHeader;
 		memcpy( ( void * ) &( pxEthernetHeader->xSourceAddress) , ( void * ) ipLOCAL_MAC_ADDRESS, ( size_t ) ipMAC_ADDRESS_LENGTH_BYTES );
 
 		/* Send! */
-		xNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
+		xIPNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
 	}
 }
 /*-----------------------------------------------------------*/
 
+#if( ipconfigUDP_DIRECT_SEND != 0 )
+
+	BaseType_t xIPNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer, BaseType_t xReleaseAfterSend )
+	{
+	BaseType_t xReturn;
+
+		/* The IP-task is not the only user of the network interface, tasks
+		calling FreeRTOS_sendto() may transmit directly. */
+		( void ) xSemaphoreTake( xNetworkOutputMutex, portMAX_DELAY );
+		xReturn = xNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
+		( void ) xSemaphoreGive( xNetworkOutputMutex );
+
+		return xReturn;
+	}
+
+#endif /* ipconfigUDP_DIRECT_SEND */
+/*-----------------------------------------------------------*/
+
 uint32_t FreeRTOS_GetIPAddress( void )
 {
 	/* Returns the IP address of the NIC. */
@@ -342,6 +342,18 @@ Socket_t xReturn;
 						pxSocket->u.xTCP.uxTxWinSize  = 1u;
 					}
 					#endif
+					#if ( ipconfigUSE_TCP_WIN == 1 )
+					{
+						pxSocket->u.xTCP.usAckShortDelayMS = ( uint16_t ) ipconfigTCP_DELAYED_ACK_SHORT_DELAY_MS;
+						pxSocket->u.xTCP.usAckLongDelayMS = ( uint16_t ) ipconfigTCP_DELAYED_ACK_LONGER_DELAY_MS;
+					}
+					#endif
+					#if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+					{
+						vListInitialise( &( pxSocket->u.xTCP.xRxLoanQueue ) );
+						vListInitialise( &( pxSocket->u.xTCP.xRxLoanedList ) );
+					}
+					#endif
 					/* The above values are just defaults, and can be overridden by
 					calling FreeRTOS_setsockopt().  No buffers will be allocated until a
 					socket is connected and data is exchanged. */
@@ -759,6 +771,7 @@ NetworkBufferDescriptor_t *pxNetworkBuffer;
 IPStackEvent_t xStackTxEvent = { eStackTxEvent, NULL };
 TimeOut_t xTimeOut;
 TickType_t xTicksToWait;
+BaseType_t xSent;
 int32_t lReturn = 0;
 FreeRTOS_Socket_t *pxSocket;
 
@@ -840,8 +853,23 @@ FreeRTOS_Socket_t *pxSocket;
 				/* Tell the networking task that the packet needs sending. */
 				xStackTxEvent.pvData = pxNetworkBuffer;
 
-				/* Ask the IP-task to send this packet */
-				if( xSendEventStructToIPTask( &xStackTxEvent, xTicksToWait ) == pdPASS )
+				#if( ipconfigUDP_DIRECT_SEND != 0 )
+					/* Try to transmit the packet from the context of this task.
+					This fails when the MAC address of the destination is not
+					known yet, then the IP-task will take care of it. */
+					if( ( xIsCallingFromIPTask() == pdFALSE ) &&
+						( xSendUDPPacketDirect( pxNetworkBuffer ) != pdFALSE ) )
+					{
+						xSent = pdPASS;
+					}
+					else
+				#endif /* ipconfigUDP_DIRECT_SEND */
+				{
+					/* Ask the IP-task to send this packet */
+					xSent = xSendEventStructToIPTask( &xStackTxEvent, xTicksToWait );
+				}
+
+				if( xSent == pdPASS )
 				{
 					/* The packet was successfully sent to the IP task. */
 					lReturn = ( int32_t ) xTotalDataLength;
@@ -1154,6 +1182,25 @@ NetworkBufferDescriptor_t *pxNetworkBuffer;
 			}
 			#endif /* ipconfigUSE_TCP_WIN */
 
+			#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+			{
+				/* Buffers which are still on loan become invalid now. */
+				while( listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanQueue ) ) > 0U )
+				{
+					pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &( pxSocket->u.xTCP.xRxLoanQueue ) );
+					uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+					vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+				}
+
+				while( listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanedList ) ) > 0U )
+				{
+					pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &( pxSocket->u.xTCP.xRxLoanedList ) );
+					uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+					vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+				}
+			}
+			#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
 			/* Free the input and output streams */
 			if( pxSocket->u.xTCP.rxStream != NULL )
 			{
@@ -1571,6 +1618,98 @@ FreeRTOS_Socket_t *pxSocket;
 				xReturn = 0;
 				break;
 
+			case FREERTOS_SO_TCP_NODELAY:	/* Send new data immediately */
+				{
+					if( pxSocket->ucProtocol != ( uint8_t ) FREERTOS_IPPROTO_TCP )
+					{
+						break;	/* will return -pdFREERTOS_ERRNO_EINVAL */
+					}
+
+					if( *( ( BaseType_t * ) pvOptionValue ) != 0 )
+					{
+						pxSocket->u.xTCP.bits.bNoDelay = pdTRUE_UNSIGNED;
+					}
+					else
+					{
+						pxSocket->u.xTCP.bits.bNoDelay = pdFALSE_UNSIGNED;
+					}
+				}
+				xReturn = 0;
+				break;
+
+			case FREERTOS_SO_TCP_CORK:		/* Only send full-size packets until uncorked */
+				{
+					if( pxSocket->ucProtocol != ( uint8_t ) FREERTOS_IPPROTO_TCP )
+					{
+						break;	/* will return -pdFREERTOS_ERRNO_EINVAL */
+					}
+
+					if( *( ( BaseType_t * ) pvOptionValue ) != 0 )
+					{
+						pxSocket->u.xTCP.bits.bCorked = pdTRUE_UNSIGNED;
+					}
+					else
+					{
+						pxSocket->u.xTCP.bits.bCorked = pdFALSE_UNSIGNED;
+					}
+
+					/* Corking uses the same mechanism as FREERTOS_SO_SET_FULL_SIZE,
+					but the setting survives the creation of the TCP window. */
+					pxSocket->u.xTCP.xTCPWindow.u.bits.bSendFullSize = pxSocket->u.xTCP.bits.bCorked;
+
+					if( ( pxSocket->u.xTCP.bits.bCorked == pdFALSE_UNSIGNED ) &&
+						( pxSocket->u.xTCP.ucTCPState >= eESTABLISHED ) &&
+						( FreeRTOS_outstanding( pxSocket ) != 0 ) )
+					{
+						/* Flush the remaining partial segment. */
+						pxSocket->u.xTCP.usTimeout = 1u;
+						xSendEventToIPTask( eTCPTimerEvent );
+					}
+				}
+				xReturn = 0;
+				break;
+
+			#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+				case FREERTOS_SO_TCP_RX_LOAN:	/* Loan received network buffers to the application */
+					{
+						if( pxSocket->ucProtocol != ( uint8_t ) FREERTOS_IPPROTO_TCP )
+						{
+							break;	/* will return -pdFREERTOS_ERRNO_EINVAL */
+						}
+
+						/* Buffers which are queued already will still be
+						passed to the application when the option is cleared. */
+						if( *( ( BaseType_t * ) pvOptionValue ) != 0 )
+						{
+							pxSocket->u.xTCP.bits.bRxLoan = pdTRUE_UNSIGNED;
+						}
+						else
+						{
+							pxSocket->u.xTCP.bits.bRxLoan = pdFALSE_UNSIGNED;
+						}
+					}
+					xReturn = 0;
+					break;
+			#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
+			#if( ipconfigUSE_TCP_WIN == 1 )
+				case FREERTOS_SO_TCP_DELAYED_ACK:	/* Set the delays of outgoing ACK's */
+					{
+					DelayedAckProperties_t *pxProps;
+
+						if( pxSocket->ucProtocol != ( uint8_t ) FREERTOS_IPPROTO_TCP )
+						{
+							break;	/* will return -pdFREERTOS_ERRNO_EINVAL */
+						}
+
+						pxProps = ( DelayedAckProperties_t * ) pvOptionValue;
+						pxSocket->u.xTCP.usAckShortDelayMS = pxProps->usShortDelayMS;
+						pxSocket->u.xTCP.usAckLongDelayMS = pxProps->usLongDelayMS;
+					}
+					xReturn = 0;
+					break;
+			#endif /* ipconfigUSE_TCP_WIN */
+
 			case FREERTOS_SO_STOP_RX:		/* Refuse to receive more packts */
 				{
 					if( pxSocket->ucProtocol != ( uint8_t ) FREERTOS_IPPROTO_TCP )
@@ -2196,134 +2335,273 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 #if( ipconfigUSE_TCP == 1 )
 
 	/*
-	 * Read incoming data from a TCP socket
-	 * Only after the last byte has been read, a close error might be returned
+	 * The number of bytes which can be read from a TCP socket: the contents of
+	 * the rxStream plus the received buffers which have not been loaned yet.
 	 */
-	BaseType_t FreeRTOS_recv( Socket_t xSocket, void *pvBuffer, size_t xBufferLength, BaseType_t xFlags )
+	static BaseType_t prvTCPRxCount( const FreeRTOS_Socket_t *pxSocket )
+	{
+	BaseType_t xCount = 0;
+
+		if( pxSocket->u.xTCP.rxStream != NULL )
+		{
+			xCount = ( BaseType_t ) uxStreamBufferGetSize( pxSocket->u.xTCP.rxStream );
+		}
+
+		#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+		{
+			xCount += ( BaseType_t ) pxSocket->u.xTCP.uxRxQueuedBytes;
+		}
+		#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
+		return xCount;
+	}
+	/*-----------------------------------------------------------*/
+
+	/*
+	 * Wait until data can be read from a TCP socket.  Returns the number of
+	 * bytes available, zero after a time-out, or a negative errno value.
+	 */
+	static BaseType_t prvTCPRecvWait( FreeRTOS_Socket_t *pxSocket, BaseType_t xFlags )
 	{
 	BaseType_t xByteCount;
-	FreeRTOS_Socket_t *pxSocket = ( FreeRTOS_Socket_t * ) xSocket;
 	TickType_t xRemainingTime;
 	BaseType_t xTimed = pdFALSE;
 	TimeOut_t xTimeOut;
 	EventBits_t xEventBits = ( EventBits_t ) 0;
 
-		/* Check if the socket is valid, has type TCP and if it is bound to a
-		port. */
-		if( prvValidSocket( pxSocket, FREERTOS_IPPROTO_TCP, pdTRUE ) == pdFALSE )
-		{
-			xByteCount = -pdFREERTOS_ERRNO_EINVAL;
-		}
-		else
+		xByteCount = prvTCPRxCount( pxSocket );
+
+		while( xByteCount == 0 )
 		{
-			if( pxSocket->u.xTCP.rxStream != NULL )
+			switch( pxSocket->u.xTCP.ucTCPState )
 			{
-				xByteCount = ( BaseType_t )uxStreamBufferGetSize ( pxSocket->u.xTCP.rxStream );
-			}
-			else
-			{
-				xByteCount = 0;
+			case eCLOSED:
+			case eCLOSE_WAIT:	/* (server + client) waiting for a connection termination request from the local user. */
+			case eCLOSING:		/* (server + client) waiting for a connection termination request acknowledgement from the remote TCP. */
+				if( pxSocket->u.xTCP.bits.bMallocError != pdFALSE_UNSIGNED )
+				{
+					/* The no-memory error has priority above the non-connected error.
+					Both are fatal and will elad to closing the socket. */
+					xByteCount = -pdFREERTOS_ERRNO_ENOMEM;
+				}
+				else
+				{
+					xByteCount = -pdFREERTOS_ERRNO_ENOTCONN;
+				}
+				/* Call continue to break out of the switch and also the while
+				loop. */
+				continue;
+			default:
+				break;
 			}
 
-			while( xByteCount == 0 )
+			if( xTimed == pdFALSE )
 			{
-				switch( pxSocket->u.xTCP.ucTCPState )
+				/* Only in the first round, check for non-blocking. */
+				xRemainingTime = pxSocket->xReceiveBlockTime;
+
+				if( xRemainingTime == ( TickType_t ) 0 )
 				{
-				case eCLOSED:
-				case eCLOSE_WAIT:	/* (server + client) waiting for a connection termination request from the local user. */
-				case eCLOSING:		/* (server + client) waiting for a connection termination request acknowledgement from the remote TCP. */
-					if( pxSocket->u.xTCP.bits.bMallocError != pdFALSE_UNSIGNED )
-					{
-						/* The no-memory error has priority above the non-connected error.
-						Both are fatal and will elad to closing the socket. */
-						xByteCount = -pdFREERTOS_ERRNO_ENOMEM;
-					}
-					else
+					#if( ipconfigSUPPORT_SIGNALS != 0 )
 					{
-						xByteCount = -pdFREERTOS_ERRNO_ENOTCONN;
+						/* Just check for the interrupt flag. */
+						xEventBits = xEventGroupWaitBits( pxSocket->xEventGroup, eSOCKET_INTR,
+							pdTRUE /*xClearOnExit*/, pdFALSE /*xWaitAllBits*/, socketDONT_BLOCK );
 					}
-					/* Call continue to break out of the switch and also the while
-					loop. */
-					continue;
-				default:
+					#endif /* ipconfigSUPPORT_SIGNALS */
 					break;
 				}
 
-				if( xTimed == pdFALSE )
+				if( ( xFlags & FREERTOS_MSG_DONTWAIT ) != 0 )
 				{
-					/* Only in the first round, check for non-blocking. */
-					xRemainingTime = pxSocket->xReceiveBlockTime;
+					break;
+				}
 
-					if( xRemainingTime == ( TickType_t ) 0 )
-					{
-						#if( ipconfigSUPPORT_SIGNALS != 0 )
-						{
-							/* Just check for the interrupt flag. */
-							xEventBits = xEventGroupWaitBits( pxSocket->xEventGroup, eSOCKET_INTR,
-								pdTRUE /*xClearOnExit*/, pdFALSE /*xWaitAllBits*/, socketDONT_BLOCK );
-						}
-						#endif /* ipconfigSUPPORT_SIGNALS */
-						break;
-					}
+				/* Don't get here a second time. */
+				xTimed = pdTRUE;
 
-					if( ( xFlags & FREERTOS_MSG_DONTWAIT ) != 0 )
-					{
-						break;
-					}
+				/* Fetch the current time. */
+				vTaskSetTimeOutState( &xTimeOut );
+			}
 
-					/* Don't get here a second time. */
-					xTimed = pdTRUE;
+			/* Has the timeout been reached? */
+			if( xTaskCheckForTimeOut( &xTimeOut, &xRemainingTime ) != pdFALSE )
+			{
+				break;
+			}
 
-					/* Fetch the current time. */
-					vTaskSetTimeOutState( &xTimeOut );
+			/* Block until there is a down-stream event. */
+			xEventBits = xEventGroupWaitBits( pxSocket->xEventGroup,
+				eSOCKET_RECEIVE | eSOCKET_CLOSED | eSOCKET_INTR,
+				pdTRUE /*xClearOnExit*/, pdFALSE /*xWaitAllBits*/, xRemainingTime );
+			#if( ipconfigSUPPORT_SIGNALS != 0 )
+			{
+				if( ( xEventBits & eSOCKET_INTR ) != 0u )
+				{
+					break;
 				}
+			}
+			#else
+			{
+				( void ) xEventBits;
+			}
+			#endif /* ipconfigSUPPORT_SIGNALS */
 
-				/* Has the timeout been reached? */
-				if( xTaskCheckForTimeOut( &xTimeOut, &xRemainingTime ) != pdFALSE )
+			xByteCount = prvTCPRxCount( pxSocket );
+		}
+
+	#if( ipconfigSUPPORT_SIGNALS != 0 )
+		if( ( xEventBits & eSOCKET_INTR ) != 0 )
+		{
+			if( ( xEventBits & ( eSOCKET_RECEIVE | eSOCKET_CLOSED ) ) != 0 )
+			{
+				/* Shouldn't have cleared other flags. */
+				xEventBits &= ~eSOCKET_INTR;
+				xEventGroupSetBits( pxSocket->xEventGroup, xEventBits );
+			}
+			xByteCount = -pdFREERTOS_ERRNO_EINTR;
+		}
+	#endif /* ipconfigSUPPORT_SIGNALS */
+
+		return xByteCount;
+	}
+	/*-----------------------------------------------------------*/
+
+	#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+
+		/*
+		 * Account for loaned bytes which have been returned by the user.  When
+		 * the socket had reached the low-water mark, see if the flag can be
+		 * cleared, just like after reading from the rxStream.
+		 */
+		static void prvTCPRxLoanReturned( FreeRTOS_Socket_t *pxSocket, size_t uxQueuedCount, size_t uxLoanCount )
+		{
+		size_t uxFrontSpace;
+
+			vTaskSuspendAll();
+			{
+				pxSocket->u.xTCP.uxRxQueuedBytes -= uxQueuedCount;
+				pxSocket->u.xTCP.uxRxLoanBytes -= uxLoanCount;
+			}
+			xTaskResumeAll();
+
+			if( pxSocket->u.xTCP.bits.bLowWater != pdFALSE_UNSIGNED )
+			{
+				if( pxSocket->u.xTCP.rxStream != NULL )
 				{
-					break;
+					uxFrontSpace = uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream );
+				}
+				else
+				{
+					uxFrontSpace = pxSocket->u.xTCP.uxRxStreamSize;
 				}
+				uxFrontSpace = ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxFrontSpace );
 
-				/* Block until there is a down-stream event. */
-				xEventBits = xEventGroupWaitBits( pxSocket->xEventGroup,
-					eSOCKET_RECEIVE | eSOCKET_CLOSED | eSOCKET_INTR,
-					pdTRUE /*xClearOnExit*/, pdFALSE /*xWaitAllBits*/, xRemainingTime );
-				#if( ipconfigSUPPORT_SIGNALS != 0 )
+				if( uxFrontSpace >= pxSocket->u.xTCP.uxEnoughSpace )
 				{
-					if( ( xEventBits & eSOCKET_INTR ) != 0u )
+					pxSocket->u.xTCP.bits.bLowWater = pdFALSE_UNSIGNED;
+					pxSocket->u.xTCP.bits.bWinChange = pdTRUE_UNSIGNED;
+					pxSocket->u.xTCP.usTimeout = 1u; /* because bLowWater is cleared. */
+					xSendEventToIPTask( eTCPTimerEvent );
+				}
+			}
+		}
+		/*-----------------------------------------------------------*/
+
+		/*
+		 * FreeRTOS_recv() on a socket which has queued network buffers: copy
+		 * their payload and release the buffers which have been read entirely.
+		 */
+		static BaseType_t prvTCPRxLoanCopy( FreeRTOS_Socket_t *pxSocket, uint8_t *pucBuffer, size_t uxBufferLength )
+		{
+		NetworkBufferDescriptor_t *pxNetworkBuffer;
+		size_t uxCopied = 0u;
+		size_t uxCount;
+
+			while( uxCopied < uxBufferLength )
+			{
+				pxNetworkBuffer = NULL;
+
+				vTaskSuspendAll();
+				{
+					if( listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanQueue ) ) > 0U )
 					{
-						break;
+						pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &( pxSocket->u.xTCP.xRxLoanQueue ) );
 					}
 				}
-				#else
+				xTaskResumeAll();
+
+				if( pxNetworkBuffer == NULL )
 				{
-					( void ) xEventBits;
+					break;
 				}
-				#endif /* ipconfigSUPPORT_SIGNALS */
 
-				if( pxSocket->u.xTCP.rxStream != NULL )
+				/* The IP-task only appends to the queue, so the head entry can be
+				read without suspending the scheduler. */
+				uxCount = FreeRTOS_min_uint32( ( uint32_t ) ( uxBufferLength - uxCopied ), ( uint32_t ) pxNetworkBuffer->xDataLength );
+				memcpy( pucBuffer + uxCopied, pxNetworkBuffer->pucEthernetBuffer + pxNetworkBuffer->usPort, uxCount );
+				uxCopied += uxCount;
+
+				if( uxCount < pxNetworkBuffer->xDataLength )
 				{
-					xByteCount = ( BaseType_t ) uxStreamBufferGetSize ( pxSocket->u.xTCP.rxStream );
+					/* The buffer has been read partially. */
+					pxNetworkBuffer->usPort += ( uint16_t ) uxCount;
+					pxNetworkBuffer->xDataLength -= uxCount;
 				}
 				else
 				{
-					xByteCount = 0;
+					vTaskSuspendAll();
+					{
+						uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+					}
+					xTaskResumeAll();
+					vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
 				}
 			}
 
-		#if( ipconfigSUPPORT_SIGNALS != 0 )
-			if( ( xEventBits & eSOCKET_INTR ) != 0 )
+			prvTCPRxLoanReturned( pxSocket, uxCopied, uxCopied );
+
+			return ( BaseType_t ) uxCopied;
+		}
+		/*-----------------------------------------------------------*/
+
+	#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
+	/*
+	 * Read incoming data from a TCP socket
+	 * Only after the last byte has been read, a close error might be returned
+	 */
+	BaseType_t FreeRTOS_recv( Socket_t xSocket, void *pvBuffer, size_t xBufferLength, BaseType_t xFlags )
+	{
+	BaseType_t xByteCount;
+	FreeRTOS_Socket_t *pxSocket = ( FreeRTOS_Socket_t * ) xSocket;
+
+		/* Check if the socket is valid, has type TCP and if it is bound to a
+		port. */
+		if( prvValidSocket( pxSocket, FREERTOS_IPPROTO_TCP, pdTRUE ) == pdFALSE )
+		{
+			xByteCount = -pdFREERTOS_ERRNO_EINVAL;
+		}
+		else
+		{
+			xByteCount = prvTCPRecvWait( pxSocket, xFlags );
+
+		#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+			if( ( xByteCount > 0 ) && ( pxSocket->u.xTCP.uxRxQueuedBytes != 0u ) )
 			{
-				if( ( xEventBits & ( eSOCKET_RECEIVE | eSOCKET_CLOSED ) ) != 0 )
+				/* The oldest data is stored in loanable buffers, which can not
+				be peeked at or passed as a pointer into the rxStream. */
+				if( ( xFlags & ( FREERTOS_ZERO_COPY | FREERTOS_MSG_PEEK ) ) != 0 )
 				{
-					/* Shouldn't have cleared other flags. */
-					xEventBits &= ~eSOCKET_INTR;
-					xEventGroupSetBits( pxSocket->xEventGroup, xEventBits );
+					xByteCount = -pdFREERTOS_ERRNO_EINVAL;
+				}
+				else
+				{
+					xByteCount = prvTCPRxLoanCopy( pxSocket, ( uint8_t * ) pvBuffer, xBufferLength );
 				}
-				xByteCount = -pdFREERTOS_ERRNO_EINTR;
 			}
 			else
-		#endif /* ipconfigSUPPORT_SIGNALS */
+		#endif /* ipconfigTCP_RX_BUFFER_LOANING */
 			if( xByteCount > 0 )
 			{
 				if( ( xFlags & FREERTOS_ZERO_COPY ) == 0 )
@@ -2333,7 +2611,7 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 					{
 						/* We had reached the low-water mark, now see if the flag
 						can be cleared */
-						size_t uxFrontSpace = uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream );
+						size_t uxFrontSpace = ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream ) );
 
 						if( uxFrontSpace >= pxSocket->u.xTCP.uxEnoughSpace )
 						{
@@ -2358,6 +2636,130 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 #endif /* ipconfigUSE_TCP */
 /*-----------------------------------------------------------*/
 
+#if( ( ipconfigUSE_TCP == 1 ) && ( ipconfigTCP_RX_BUFFER_LOANING != 0 ) )
+
+	BaseType_t FreeRTOS_recv_loan( Socket_t xSocket, uint8_t **ppucBuffer, BaseType_t xFlags )
+	{
+	BaseType_t xByteCount;
+	FreeRTOS_Socket_t *pxSocket = ( FreeRTOS_Socket_t * ) xSocket;
+	NetworkBufferDescriptor_t *pxNetworkBuffer = NULL;
+
+		if( ( prvValidSocket( pxSocket, FREERTOS_IPPROTO_TCP, pdTRUE ) == pdFALSE ) || ( ppucBuffer == NULL ) )
+		{
+			xByteCount = -pdFREERTOS_ERRNO_EINVAL;
+		}
+		else
+		{
+			xByteCount = prvTCPRecvWait( pxSocket, xFlags );
+
+			if( xByteCount > 0 )
+			{
+				/* Move the oldest queued buffer to the list of loaned buffers. */
+				vTaskSuspendAll();
+				{
+					if( listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanQueue ) ) > 0U )
+					{
+						pxNetworkBuffer = ( NetworkBufferDescriptor_t * ) listGET_OWNER_OF_HEAD_ENTRY( &( pxSocket->u.xTCP.xRxLoanQueue ) );
+						uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+						vListInsertEnd( &( pxSocket->u.xTCP.xRxLoanedList ), &( pxNetworkBuffer->xBufferListItem ) );
+						pxSocket->u.xTCP.uxRxQueuedBytes -= pxNetworkBuffer->xDataLength;
+					}
+				}
+				xTaskResumeAll();
+
+				if( pxNetworkBuffer == NULL )
+				{
+					/* The data was stored in the rxStream, e.g. because it arrived
+					out-of-order.  Copy at most one segment to a network buffer,
+					so that it can be loaned just the same. */
+					xByteCount = ( BaseType_t ) FreeRTOS_min_uint32( ( uint32_t ) xByteCount, ( uint32_t ) pxSocket->u.xTCP.usCurMSS );
+					pxNetworkBuffer = pxGetNetworkBufferWithDescriptor( ( size_t ) xByteCount, 0u );
+
+					if( pxNetworkBuffer == NULL )
+					{
+						xByteCount = -pdFREERTOS_ERRNO_ENOMEM;
+					}
+					else
+					{
+						/* The space in the rxStream is exchanged for loaned space,
+						the size of the Rx window does not change. */
+						vTaskSuspendAll();
+						{
+							xByteCount = ( BaseType_t ) uxStreamBufferGet( pxSocket->u.xTCP.rxStream, 0ul, pxNetworkBuffer->pucEthernetBuffer, ( size_t ) xByteCount, pdFALSE );
+							pxNetworkBuffer->usPort = 0u;
+							pxNetworkBuffer->xDataLength = ( size_t ) xByteCount;
+							vListInsertEnd( &( pxSocket->u.xTCP.xRxLoanedList ), &( pxNetworkBuffer->xBufferListItem ) );
+							pxSocket->u.xTCP.uxRxLoanBytes += ( size_t ) xByteCount;
+						}
+						xTaskResumeAll();
+					}
+				}
+
+				if( pxNetworkBuffer != NULL )
+				{
+					*ppucBuffer = pxNetworkBuffer->pucEthernetBuffer + pxNetworkBuffer->usPort;
+					xByteCount = ( BaseType_t ) pxNetworkBuffer->xDataLength;
+				}
+			}
+		}
+
+		return xByteCount;
+	}
+	/*-----------------------------------------------------------*/
+
+	BaseType_t FreeRTOS_release_loan( Socket_t xSocket, const uint8_t *pucBuffer )
+	{
+	FreeRTOS_Socket_t *pxSocket = ( FreeRTOS_Socket_t * ) xSocket;
+	NetworkBufferDescriptor_t *pxNetworkBuffer = NULL;
+	const ListItem_t *pxIterator;
+	const MiniListItem_t *pxEnd;
+	BaseType_t xResult;
+
+		if( ( prvValidSocket( pxSocket, FREERTOS_IPPROTO_TCP, pdFALSE ) == pdFALSE ) || ( pucBuffer == NULL ) )
+		{
+			xResult = -pdFREERTOS_ERRNO_EINVAL;
+		}
+		else
+		{
+			/* Look up the buffer by the pointer that was handed out. */
+			vTaskSuspendAll();
+			{
+				pxEnd = ( const MiniListItem_t * ) listGET_END_MARKER( &( pxSocket->u.xTCP.xRxLoanedList ) );
+
+				for( pxIterator = listGET_NEXT( pxEnd );
+					 pxIterator != ( const ListItem_t * ) pxEnd;
+					 pxIterator = listGET_NEXT( pxIterator ) )
+				{
+					NetworkBufferDescriptor_t *pxCandidate = ( NetworkBufferDescriptor_t * ) listGET_LIST_ITEM_OWNER( pxIterator );
+
+					if( pxCandidate->pucEthernetBuffer + pxCandidate->usPort == pucBuffer )
+					{
+						pxNetworkBuffer = pxCandidate;
+						uxListRemove( &( pxNetworkBuffer->xBufferListItem ) );
+						break;
+					}
+				}
+			}
+			xTaskResumeAll();
+
+			if( pxNetworkBuffer == NULL )
+			{
+				xResult = -pdFREERTOS_ERRNO_EINVAL;
+			}
+			else
+			{
+				prvTCPRxLoanReturned( pxSocket, 0u, pxNetworkBuffer->xDataLength );
+				vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+				xResult = 0;
+			}
+		}
+
+		return xResult;
+	}
+
+#endif /* ( ipconfigUSE_TCP == 1 ) && ( ipconfigTCP_RX_BUFFER_LOANING != 0 ) */
+/*-----------------------------------------------------------*/
+
 #if( ipconfigUSE_TCP == 1 )
 
 	static int32_t prvTCPSendCheck( FreeRTOS_Socket_t *pxSocket, size_t xDataLength )
@@ -2522,7 +2924,25 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 					{
 						/* Only send a TCP timer event when not called from the
 						IP-task. */
-						xSendEventToIPTask( eTCPTimerEvent );
+						if( pxSocket->u.xTCP.bits.bNoDelay != pdFALSE_UNSIGNED )
+						{
+						IPStackEvent_t xSendEvent;
+
+							/* FREERTOS_SO_TCP_NODELAY: ask the IP-task to handle
+							this socket right away.  Unlike the TCP timer event,
+							this message is also posted when the queue is not
+							empty. */
+							xSendEvent.eEventType = eTCPSendEvent;
+							xSendEvent.pvData = ( void * ) pxSocket;
+							if( xSendEventStructToIPTask( &xSendEvent, ( TickType_t ) 0 ) == pdFAIL )
+							{
+								xSendEventToIPTask( eTCPTimerEvent );
+							}
+						}
+						else
+						{
+							xSendEventToIPTask( eTCPTimerEvent );
+						}
 					}
 
 					xBytesLeft -= xByteCount;
@@ -3038,7 +3458,7 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 				/* See if running out of space. */
 				if( pxSocket->u.xTCP.bits.bLowWater == pdFALSE_UNSIGNED )
 				{
-					size_t uxFrontSpace = uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream );
+					size_t uxFrontSpace = ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream ) );
 					if( uxFrontSpace <= pxSocket->u.xTCP.uxLittleSpace  )
 					{
 						pxSocket->u.xTCP.bits.bLowWater = pdTRUE_UNSIGNED;
@@ -3071,6 +3491,67 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 #endif /* ipconfigUSE_TCP */
 /*-----------------------------------------------------------*/
 
+#if( ( ipconfigUSE_TCP == 1 ) && ( ipconfigTCP_RX_BUFFER_LOANING != 0 ) )
+
+	/* Called by the IP-task: queue a received network buffer to the socket. */
+	void vTCPAddRxLoan( FreeRTOS_Socket_t *pxSocket, NetworkBufferDescriptor_t *pxNetworkBuffer, size_t uxOffset, uint32_t ulByteCount )
+	{
+	size_t uxFrontSpace;
+
+		/* While the buffer is queued or on loan, 'usPort' holds the offset of
+		the unread payload and 'xDataLength' its length. */
+		pxNetworkBuffer->usPort = ( uint16_t ) uxOffset;
+		pxNetworkBuffer->xDataLength = ( size_t ) ulByteCount;
+
+		/* The user task may be reading from the same list. */
+		vTaskSuspendAll();
+		{
+			vListInsertEnd( &( pxSocket->u.xTCP.xRxLoanQueue ), &( pxNetworkBuffer->xBufferListItem ) );
+			pxSocket->u.xTCP.uxRxQueuedBytes += ( size_t ) ulByteCount;
+			pxSocket->u.xTCP.uxRxLoanBytes += ( size_t ) ulByteCount;
+		}
+		xTaskResumeAll();
+
+		/* See if running out of space. */
+		if( pxSocket->u.xTCP.bits.bLowWater == pdFALSE_UNSIGNED )
+		{
+			if( pxSocket->u.xTCP.rxStream != NULL )
+			{
+				uxFrontSpace = uxStreamBufferFrontSpace( pxSocket->u.xTCP.rxStream );
+			}
+			else
+			{
+				uxFrontSpace = pxSocket->u.xTCP.uxRxStreamSize;
+			}
+			uxFrontSpace = ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, uxFrontSpace );
+
+			if( uxFrontSpace <= pxSocket->u.xTCP.uxLittleSpace )
+			{
+				pxSocket->u.xTCP.bits.bLowWater = pdTRUE_UNSIGNED;
+				pxSocket->u.xTCP.bits.bWinChange = pdTRUE_UNSIGNED;
+
+				/* bLowWater was reached, send the changed window size. */
+				pxSocket->u.xTCP.usTimeout = 1u;
+				xSendEventToIPTask( eTCPTimerEvent );
+			}
+		}
+
+		/* New incoming data is available, wake up the user. */
+		pxSocket->xEventBits |= eSOCKET_RECEIVE;
+
+		#if ipconfigSUPPORT_SELECT_FUNCTION == 1
+		{
+			if( ( pxSocket->xSelectBits & eSELECT_READ ) != 0 )
+			{
+				pxSocket->xEventBits |= ( eSELECT_READ << SOCKET_EVENT_BIT_COUNT );
+			}
+		}
+		#endif
+	}
+
+#endif /* ( ipconfigUSE_TCP == 1 ) && ( ipconfigTCP_RX_BUFFER_LOANING != 0 ) */
+/*-----------------------------------------------------------*/
+
 #if( ipconfigUSE_TCP == 1 )
 
 	/* Function to get the remote address and IP port */
@@ -3293,13 +3774,9 @@ void vSocketWakeUpUser( FreeRTOS_Socket_t *pxSocket )
 		{
 			xReturn = -pdFREERTOS_ERRNO_EINVAL;
 		}
-		else if( pxSocket->u.xTCP.rxStream != NULL )
-		{
-			xReturn = ( BaseType_t ) uxStreamBufferGetSize( pxSocket->u.xTCP.rxStream );
-		}
 		else
 		{
-			xReturn = 0;
+			xReturn = prvTCPRxCount( pxSocket );
 		}
 
 		return xReturn;
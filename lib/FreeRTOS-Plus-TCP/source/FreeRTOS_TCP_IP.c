@@ -122,14 +122,6 @@ the defined MTU size can contain at least a complete TCP packet. */
  */
 #define VALID_BITS_IN_TCP_OFFSET_BYTE		( 0xF0u )
 
-/*
- * Acknowledgements to TCP data packets may be delayed as long as more is being expected.
- * A normal delay would be 200ms.  Here a much shorter delay of 20 ms is being used to
- * gain performance.
- */
-#define DELAYED_ACK_SHORT_DELAY_MS			( 2 )
-#define DELAYED_ACK_LONGER_DELAY_MS			( 20 )
-
 /*
  * The MSS (Maximum Segment Size) will be taken as large as possible. However, packets with
  * an MSS of 1460 bytes won't be transported through the internet.  The MSS will be reduced
@@ -270,10 +262,21 @@ static BaseType_t prvCheckRxData( NetworkBufferDescriptor_t *pxNetworkBuffer, ui
 
 /*
  * Called from prvTCPHandleState().  Check if the payload data may be accepted.
- * If so, it will be added to the socket's reception queue.
+ * If so, it will be added to the socket's reception queue.  When the network
+ * buffer itself is loaned to the socket, *ppxNetworkBuffer will be replaced
+ * by a buffer that holds a copy of the headers.
  */
 static BaseType_t prvStoreRxData( FreeRTOS_Socket_t *pxSocket, uint8_t *pucRecvData,
-	NetworkBufferDescriptor_t *pxNetworkBuffer, uint32_t ulReceiveLength );
+	NetworkBufferDescriptor_t **ppxNetworkBuffer, uint32_t ulReceiveLength );
+
+#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+	/*
+	 * Called from prvStoreRxData() for in-order data.  Queue the network buffer
+	 * to the socket instead of copying the payload to the rxStream, if possible.
+	 */
+	static BaseType_t prvTCPRxLoan( FreeRTOS_Socket_t *pxSocket, NetworkBufferDescriptor_t **ppxNetworkBuffer,
+		const uint8_t *pucRecvData, uint32_t ulReceiveLength );
+#endif
 
 /*
  * Set the TCP options (if any) for the outgoing packet.
@@ -476,6 +479,23 @@ BaseType_t xReady = pdFALSE;
 
 	#if ipconfigUSE_TCP_WIN == 1
 	{
+	TickType_t ulDelayMs;
+
+		if( ( pxSocket->u.xTCP.pxAckMessage != NULL ) &&
+			( pxSocket->u.xTCP.bits.bNoDelay != pdFALSE_UNSIGNED ) &&
+			( pxSocket->u.xTCP.ucTCPState == eESTABLISHED ) )
+		{
+			/* FREERTOS_SO_TCP_NODELAY is set.  When new data can be sent right
+			away, do not send the delayed ACK on its own: the ACK will be
+			piggy-backed on the data packet sent by prvTCPSendPacket(). */
+			if( ( xTCPWindowTxHasData( &pxSocket->u.xTCP.xTCPWindow, pxSocket->u.xTCP.ulWindowSize, &ulDelayMs ) != pdFALSE ) &&
+				( ulDelayMs == 0u ) )
+			{
+				vReleaseNetworkBufferAndDescriptor( pxSocket->u.xTCP.pxAckMessage );
+				pxSocket->u.xTCP.pxAckMessage = NULL;
+			}
+		}
+
 		if( pxSocket->u.xTCP.pxAckMessage != NULL )
 		{
 			/* The first task of this regular socket check is to send-out delayed
@@ -737,6 +757,9 @@ NetworkBufferDescriptor_t xTempBuffer;
 				ulFrontSpace = ( uint32_t ) pxSocket->u.xTCP.uxRxStreamSize;
 			}
 
+			/* Received buffers which are queued or on loan take space as well. */
+			ulFrontSpace = ( uint32_t ) ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, ulFrontSpace );
+
 			/* Take the minimum of the RX buffer space and the RX window size. */
 			ulSpace = FreeRTOS_min_uint32( pxSocket->u.xTCP.ulRxCurWinSize, pxTCPWindow->xSize.ulRxWindowLength );
 
@@ -925,7 +948,7 @@ NetworkBufferDescriptor_t xTempBuffer;
 		#endif
 
 		/* Send! */
-		xNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
+		xIPNetworkInterfaceOutput( pxNetworkBuffer, xReleaseAfterSend );
 
 		if( xReleaseAfterSend == pdFALSE )
 		{
@@ -964,6 +987,9 @@ static void prvTCPCreateWindow( FreeRTOS_Socket_t *pxSocket )
 		pxSocket->u.xTCP.xTCPWindow.rx.ulCurrentSequenceNumber,
 		pxSocket->u.xTCP.xTCPWindow.ulOurSequenceNumber,
 		( uint32_t ) pxSocket->u.xTCP.usInitMSS );
+
+	/* FREERTOS_SO_TCP_CORK may have been set before the connection was made. */
+	pxSocket->u.xTCP.xTCPWindow.u.bits.bSendFullSize = pxSocket->u.xTCP.bits.bCorked;
 }
 /*-----------------------------------------------------------*/
 
@@ -2121,8 +2147,9 @@ int32_t lLength, lTCPHeaderLength, lReceiveLength, lUrgentLength;
  * If so, they will be added to the reception queue.
  */
 static BaseType_t prvStoreRxData( FreeRTOS_Socket_t *pxSocket, uint8_t *pucRecvData,
-	NetworkBufferDescriptor_t *pxNetworkBuffer, uint32_t ulReceiveLength )
+	NetworkBufferDescriptor_t **ppxNetworkBuffer, uint32_t ulReceiveLength )
 {
+NetworkBufferDescriptor_t *pxNetworkBuffer = *ppxNetworkBuffer;
 TCPPacket_t *pxTCPPacket = ( TCPPacket_t * ) ( pxNetworkBuffer->pucEthernetBuffer );
 TCPHeader_t *pxTCPHeader = &pxTCPPacket->xTCPHeader;
 TCPWindow_t *pxTCPWindow = &pxSocket->u.xTCP.xTCPWindow;
@@ -2149,9 +2176,19 @@ BaseType_t xResult = 0;
 		{
 			ulSpace = ( uint32_t )pxSocket->u.xTCP.uxRxStreamSize;
 		}
+		ulSpace = ( uint32_t ) ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, ulSpace );
 
 		lOffset = lTCPWindowRxCheck( pxTCPWindow, ulSequenceNumber, ulReceiveLength, ulSpace );
 
+		#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+		if( ( lOffset == 0 ) && ( prvTCPRxLoan( pxSocket, ppxNetworkBuffer, pucRecvData, ulReceiveLength ) != pdFALSE ) )
+		{
+			/* The network buffer has been queued to the socket as it is.  The
+			reply will be built in the copy of the headers, which is now in
+			*ppxNetworkBuffer. */
+		}
+		else
+		#endif /* ipconfigTCP_RX_BUFFER_LOANING */
 		if( lOffset >= 0 )
 		{
 			/* New data has arrived and may be made available to the user.  See
@@ -2196,6 +2233,97 @@ BaseType_t xResult = 0;
 }
 /*-----------------------------------------------------------*/
 
+#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+
+	static BaseType_t prvTCPRxLoan( FreeRTOS_Socket_t *pxSocket, NetworkBufferDescriptor_t **ppxNetworkBuffer,
+		const uint8_t *pucRecvData, uint32_t ulReceiveLength )
+	{
+	NetworkBufferDescriptor_t *pxNetworkBuffer = *ppxNetworkBuffer;
+	NetworkBufferDescriptor_t *pxReplyBuffer;
+	StreamBuffer_t *pxStream = pxSocket->u.xTCP.rxStream;
+	size_t uxHeaderLength = ( size_t ) ( pucRecvData - pxNetworkBuffer->pucEthernetBuffer );
+	size_t uxReplyLength;
+	BaseType_t xCanLoan = pdTRUE;
+
+		/* Only data that can be passed to the user immediately is loaned.  The
+		order of the data must be preserved, so the rxStream must be empty,
+		also of out-of-order data stored in front of its head. */
+		if( ( pxSocket->u.xTCP.bits.bRxLoan == pdFALSE_UNSIGNED ) ||
+			( pxSocket->u.xTCP.ucTCPState != eESTABLISHED ) ||
+			( pxSocket->u.xTCP.bits.bRxStopped != pdFALSE_UNSIGNED ) )
+		{
+			xCanLoan = pdFALSE;
+		}
+		else if( ( pxStream != NULL ) &&
+			( ( uxStreamBufferGetSize( pxStream ) != 0u ) || ( pxStream->uxFront != pxStream->uxHead ) ) )
+		{
+			xCanLoan = pdFALSE;
+		}
+		else if( ( listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanQueue ) ) +
+			listCURRENT_LIST_LENGTH( &( pxSocket->u.xTCP.xRxLoanedList ) ) ) >= ( UBaseType_t ) ipconfigTCP_RX_LOAN_MAX_BUFFERS )
+		{
+			/* The socket holds as many network buffers as it may.  Copying
+			the payload frees this buffer as soon as the packet is handled. */
+			xCanLoan = pdFALSE;
+		}
+		else if( uxGetNumberOfFreeNetworkBuffers() <= ( UBaseType_t ) ipconfigTCP_RX_LOAN_MIN_FREE_BUFFERS )
+		{
+			/* The reply buffer taken below would leave fewer free network
+			buffers than the reserve. */
+			xCanLoan = pdFALSE;
+		}
+		else
+		{
+			#if( ipconfigUSE_TCP_WIN == 1 )
+			{
+				if( pxSocket->u.xTCP.xTCPWindow.ulUserDataLength != 0u )
+				{
+					xCanLoan = pdFALSE;
+				}
+			}
+			#endif /* ipconfigUSE_TCP_WIN */
+
+			#if( ipconfigUSE_CALLBACKS == 1 )
+			{
+				/* A receive handler gets the data through its call-back. */
+				if( ipconfigIS_VALID_PROG_ADDRESS( pxSocket->u.xTCP.pxHandleReceive ) )
+				{
+					xCanLoan = pdFALSE;
+				}
+			}
+			#endif /* ipconfigUSE_CALLBACKS */
+		}
+
+		if( xCanLoan != pdFALSE )
+		{
+			/* The reply to this packet will be built in a new buffer which holds
+			a copy of the headers.  Do not block: when no buffer is available,
+			the payload will be copied to the rxStream as usual. */
+			uxReplyLength = FreeRTOS_max_uint32( ( uint32_t ) sizeof( pxSocket->u.xTCP.xPacket.u.ucLastPacket ), ( uint32_t ) uxHeaderLength );
+			pxReplyBuffer = pxGetNetworkBufferWithDescriptor( uxReplyLength, 0u );
+
+			if( pxReplyBuffer == NULL )
+			{
+				xCanLoan = pdFALSE;
+			}
+			else
+			{
+				memcpy( pxReplyBuffer->pucEthernetBuffer, pxNetworkBuffer->pucEthernetBuffer, uxHeaderLength );
+				pxReplyBuffer->xDataLength = uxReplyLength;
+				pxReplyBuffer->ulIPAddress = pxNetworkBuffer->ulIPAddress;
+				pxReplyBuffer->usPort = pxNetworkBuffer->usPort;
+
+				vTCPAddRxLoan( pxSocket, pxNetworkBuffer, uxHeaderLength, ulReceiveLength );
+				*ppxNetworkBuffer = pxReplyBuffer;
+			}
+		}
+
+		return xCanLoan;
+	}
+
+#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+/*-----------------------------------------------------------*/
+
 /* Set the TCP options (if any) for the outgoing packet. */
 static UBaseType_t prvSetOptions( FreeRTOS_Socket_t *pxSocket, NetworkBufferDescriptor_t *pxNetworkBuffer )
 {
@@ -2529,6 +2657,7 @@ int32_t lRxSpace;
 	#else
 		int32_t lMinLength;
 	#endif
+	uint16_t usAckDelayMS;
 #endif
 	pxSocket->u.xTCP.ulRxCurWinSize = pxTCPWindow->xSize.ulRxWindowLength -
 									 ( pxTCPWindow->rx.ulHighestSequenceNumber - pxTCPWindow->rx.ulCurrentSequenceNumber );
@@ -2542,6 +2671,7 @@ int32_t lRxSpace;
 	{
 		ulFrontSpace = ( uint32_t ) pxSocket->u.xTCP.uxRxStreamSize;
 	}
+	ulFrontSpace = ( uint32_t ) ipTCP_RX_SPACE_MINUS_LOANS( pxSocket, ulFrontSpace );
 
 	pxSocket->u.xTCP.ulRxCurWinSize = FreeRTOS_min_uint32( ulFrontSpace, pxSocket->u.xTCP.ulRxCurWinSize );
 
@@ -2557,9 +2687,25 @@ int32_t lRxSpace;
 		}
 		#endif /* ipconfigTCP_ACK_EARLIER_PACKET */
 
+		/* Acknowledgements to TCP data packets may be delayed as long as more
+		is being expected.  A normal delay would be 200ms.  Here much shorter
+		delays are being used to gain performance.  The delays can be set per
+		socket with FREERTOS_SO_TCP_DELAYED_ACK. */
+		if( ( ulReceiveLength < ( uint32_t ) pxSocket->u.xTCP.usCurMSS ) ||	/* Received a small message. */
+			( lRxSpace < ( int32_t ) ( 2U * pxSocket->u.xTCP.usCurMSS ) ) )	/* There are less than 2 x MSS space in the Rx buffer. */
+		{
+			usAckDelayMS = pxSocket->u.xTCP.usAckShortDelayMS;
+		}
+		else
+		{
+			/* A slow ACK for full-size message. */
+			usAckDelayMS = pxSocket->u.xTCP.usAckLongDelayMS;
+		}
+
 		/* In case we're receiving data continuously, we might postpone sending
 		an ACK to gain performance. */
 		if( ( ulReceiveLength > 0 ) &&							/* Data was sent to this socket. */
+			( usAckDelayMS != 0u ) &&							/* The socket allows delayed ACK's. */
 			( lRxSpace >= lMinLength ) &&						/* There is Rx space for more data. */
 			( pxSocket->u.xTCP.bits.bFinSent == pdFALSE_UNSIGNED ) &&	/* Not in a closure phase. */
 			( xSendLength == ( ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_TCP_HEADER ) ) && /* No Tx data or options to be sent. */
@@ -2576,18 +2722,7 @@ int32_t lRxSpace;
 
 				pxSocket->u.xTCP.pxAckMessage = *ppxNetworkBuffer;
 			}
-			if( ( ulReceiveLength < ( uint32_t ) pxSocket->u.xTCP.usCurMSS ) ||	/* Received a small message. */
-				( lRxSpace < ( int32_t ) ( 2U * pxSocket->u.xTCP.usCurMSS ) ) )	/* There are less than 2 x MSS space in the Rx buffer. */
-			{
-				pxSocket->u.xTCP.usTimeout = ( uint16_t ) pdMS_TO_MIN_TICKS( DELAYED_ACK_SHORT_DELAY_MS );
-			}
-			else
-			{
-				/* Normally a delayed ACK should wait 200 ms for a next incoming
-				packet.  Only wait 20 ms here to gain performance.  A slow ACK
-				for full-size message. */
-				pxSocket->u.xTCP.usTimeout = ( uint16_t ) pdMS_TO_MIN_TICKS( DELAYED_ACK_LONGER_DELAY_MS );
-			}
+			pxSocket->u.xTCP.usTimeout = ( uint16_t ) pdMS_TO_MIN_TICKS( usAckDelayMS );
 
 			if( ( xTCPWindowLoggingLevel > 1 ) && ( ipconfigTCP_MAY_LOG_PORT( pxSocket->usLocalPort ) != pdFALSE ) )
 			{
@@ -2708,12 +2843,20 @@ TCPWindow_t *pxTCPWindow = &( pxSocket->u.xTCP.xTCPWindow );
 	}
 
 	/* Storing data may result in a fatal error if malloc() fails. */
-	if( prvStoreRxData( pxSocket, pucRecvData, *ppxNetworkBuffer, ulReceiveLength ) < 0 )
+	if( prvStoreRxData( pxSocket, pucRecvData, ppxNetworkBuffer, ulReceiveLength ) < 0 )
 	{
 		xSendLength = -1;
 	}
 	else
 	{
+		#if( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+		{
+			/* The received buffer may have been loaned to the socket. */
+			pxTCPPacket = ( TCPPacket_t * ) ( (*ppxNetworkBuffer)->pucEthernetBuffer );
+			pxTCPHeader = &( pxTCPPacket->xTCPHeader );
+		}
+		#endif /* ipconfigTCP_RX_BUFFER_LOANING */
+
 		uxOptionsLength = prvSetOptions( pxSocket, *ppxNetworkBuffer );
 
 		if( ( pxSocket->u.xTCP.ucTCPState == eSYN_RECEIVED ) && ( ( ucTCPFlags & ipTCP_FLAG_CTRL ) == ipTCP_FLAG_SYN ) )
@@ -3175,6 +3318,16 @@ struct freertos_sockaddr xAddress;
 	pxNewSocket->u.xTCP.uxEnoughSpace = pxSocket->u.xTCP.uxEnoughSpace;
 	pxNewSocket->u.xTCP.uxRxWinSize  = pxSocket->u.xTCP.uxRxWinSize;
 	pxNewSocket->u.xTCP.uxTxWinSize  = pxSocket->u.xTCP.uxTxWinSize;
+	pxNewSocket->u.xTCP.bits.bNoDelay = pxSocket->u.xTCP.bits.bNoDelay;
+	pxNewSocket->u.xTCP.bits.bCorked = pxSocket->u.xTCP.bits.bCorked;
+	pxNewSocket->u.xTCP.bits.bRxLoan = pxSocket->u.xTCP.bits.bRxLoan;
+
+	#if( ipconfigUSE_TCP_WIN == 1 )
+	{
+		pxNewSocket->u.xTCP.usAckShortDelayMS = pxSocket->u.xTCP.usAckShortDelayMS;
+		pxNewSocket->u.xTCP.usAckLongDelayMS = pxSocket->u.xTCP.usAckLongDelayMS;
+	}
+	#endif /* ipconfigUSE_TCP_WIN */
 
 	#if( ipconfigSOCKET_HAS_USER_SEMAPHORE == 1 )
 	{
@@ -72,118 +72,157 @@ UDPPacketHeader_t xDefaultPartUDPPacketHeader =
 };
 /*-----------------------------------------------------------*/
 
-void vProcessGeneratedUDPPacket( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+/*
+ * Fill in the Ethernet, IP and UDP headers of a packet for which the MAC
+ * address of the destination has been found in the ARP cache.
+ */
+static void prvPrepareUDPPacket( NetworkBufferDescriptor_t * const pxNetworkBuffer )
 {
 UDPPacket_t *pxUDPPacket;
 IPHeader_t *pxIPHeader;
-eARPLookupResult_t eReturned;
-uint32_t ulIPAddress = pxNetworkBuffer->ulIPAddress;
+#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+	uint8_t ucSocketOptions;
+#endif
 
-	/* Map the UDP packet onto the start of the frame. */
+	iptraceSENDING_UDP_PACKET( pxNetworkBuffer->ulIPAddress );
+
+	/* Create short cuts to the data within the packet. */
 	pxUDPPacket = ( UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
+	pxIPHeader = &( pxUDPPacket->xIPHeader );
 
-	/* Determine the ARP cache status for the requested IP address. */
-	eReturned = eARPGetCacheEntry( &( ulIPAddress ), &( pxUDPPacket->xEthernetHeader.xDestinationAddress ) );
+#if ( ipconfigSUPPORT_OUTGOING_PINGS == 1 )
+	/* Is it possible that the packet is not actually a UDP packet
+	after all, but an ICMP packet. */
+	if( pxNetworkBuffer->usPort != ipPACKET_CONTAINS_ICMP_DATA )
+#endif /* ipconfigSUPPORT_OUTGOING_PINGS */
+	{
+	UDPHeader_t *pxUDPHeader;
 
-	if( eReturned != eCantSendPacket )
+		pxUDPHeader = &( pxUDPPacket->xUDPHeader );
+
+		pxUDPHeader->usDestinationPort = pxNetworkBuffer->usPort;
+		pxUDPHeader->usSourcePort = pxNetworkBuffer->usBoundPort;
+		pxUDPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( UDPHeader_t ) );
+		pxUDPHeader->usLength = FreeRTOS_htons( pxUDPHeader->usLength );
+		pxUDPHeader->usChecksum = 0u;
+	}
+
+	/* memcpy() the constant parts of the header information into
+	the	correct location within the packet.  This fills in:
+		xEthernetHeader.xSourceAddress
+		xEthernetHeader.usFrameType
+		xIPHeader.ucVersionHeaderLength
+		xIPHeader.ucDifferentiatedServicesCode
+		xIPHeader.usLength
+		xIPHeader.usIdentification
+		xIPHeader.usFragmentOffset
+		xIPHeader.ucTimeToLive
+		xIPHeader.ucProtocol
+	and
+		xIPHeader.usHeaderChecksum
+	*/
+	/* Save options now, as they will be overwritten by memcpy */
+	#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+		ucSocketOptions = pxNetworkBuffer->pucEthernetBuffer[ ipSOCKET_OPTIONS_OFFSET ];
+	#endif
+	/*
+	 * Offset the memcpy by the size of a MAC address to start at the packet's
+	 * Ethernet header 'source' MAC address; the preceding 'destination' should not be altered.
+	 */
+	char *pxUdpSrcAddrOffset = ( char *) pxUDPPacket + sizeof( MACAddress_t );
+	memcpy( pxUdpSrcAddrOffset, xDefaultPartUDPPacketHeader.ucBytes, sizeof( xDefaultPartUDPPacketHeader ) );
+
+#if ipconfigSUPPORT_OUTGOING_PINGS == 1
+	if( pxNetworkBuffer->usPort == ipPACKET_CONTAINS_ICMP_DATA )
 	{
-		if( eReturned == eARPCacheHit )
-		{
-			#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
-				uint8_t ucSocketOptions;
-			#endif
-			iptraceSENDING_UDP_PACKET( pxNetworkBuffer->ulIPAddress );
+		pxIPHeader->ucProtocol = ipPROTOCOL_ICMP;
+		pxIPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( IPHeader_t ) );
+	}
+	else
+#endif /* ipconfigSUPPORT_OUTGOING_PINGS */
+	{
+		pxIPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( IPHeader_t ) + sizeof( UDPHeader_t ) );
+	}
 
-			/* Create short cuts to the data within the packet. */
-			pxIPHeader = &( pxUDPPacket->xIPHeader );
+	/* The total transmit size adds on the Ethernet header. */
+	pxNetworkBuffer->xDataLength = pxIPHeader->usLength + sizeof( EthernetHeader_t );
+	pxIPHeader->usLength = FreeRTOS_htons( pxIPHeader->usLength );
+	/* HT:endian: changed back to network endian */
+	pxIPHeader->ulDestinationIPAddress = pxNetworkBuffer->ulIPAddress;
 
-		#if ( ipconfigSUPPORT_OUTGOING_PINGS == 1 )
-			/* Is it possible that the packet is not actually a UDP packet
-			after all, but an ICMP packet. */
-			if( pxNetworkBuffer->usPort != ipPACKET_CONTAINS_ICMP_DATA )
-		#endif /* ipconfigSUPPORT_OUTGOING_PINGS */
-			{
-			UDPHeader_t *pxUDPHeader;
+	#if( ipconfigUSE_LLMNR == 1 )
+	{
+		/* LLMNR messages are typically used on a LAN and they're
+		 * not supposed to cross routers */
+		if( pxNetworkBuffer->ulIPAddress == ipLLMNR_IP_ADDR )
+		{
+			pxIPHeader->ucTimeToLive = 0x01;
+		}
+	}
+	#endif
 
-				pxUDPHeader = &( pxUDPPacket->xUDPHeader );
+	#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
+	{
+		pxIPHeader->usHeaderChecksum = 0u;
+		pxIPHeader->usHeaderChecksum = usGenerateChecksum( 0UL, ( uint8_t * ) &( pxIPHeader->ucVersionHeaderLength ), ipSIZE_OF_IPv4_HEADER );
+		pxIPHeader->usHeaderChecksum = ~FreeRTOS_htons( pxIPHeader->usHeaderChecksum );
 
-				pxUDPHeader->usDestinationPort = pxNetworkBuffer->usPort;
-				pxUDPHeader->usSourcePort = pxNetworkBuffer->usBoundPort;
-				pxUDPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( UDPHeader_t ) );
-				pxUDPHeader->usLength = FreeRTOS_htons( pxUDPHeader->usLength );
-				pxUDPHeader->usChecksum = 0u;
-			}
+		if( ( ucSocketOptions & ( uint8_t ) FREERTOS_SO_UDPCKSUM_OUT ) != 0u )
+		{
+			usGenerateProtocolChecksum( (uint8_t*)pxUDPPacket, pxNetworkBuffer->xDataLength, pdTRUE );
+		}
+		else
+		{
+			pxUDPPacket->xUDPHeader.usChecksum = 0u;
+		}
+	}
+	#endif
+}
+/*-----------------------------------------------------------*/
 
-			/* memcpy() the constant parts of the header information into
-			the	correct location within the packet.  This fills in:
-				xEthernetHeader.xSourceAddress
-				xEthernetHeader.usFrameType
-				xIPHeader.ucVersionHeaderLength
-				xIPHeader.ucDifferentiatedServicesCode
-				xIPHeader.usLength
-				xIPHeader.usIdentification
-				xIPHeader.usFragmentOffset
-				xIPHeader.ucTimeToLive
-				xIPHeader.ucProtocol
-			and
-				xIPHeader.usHeaderChecksum
-			*/
-			/* Save options now, as they will be overwritten by memcpy */
-			#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
-				ucSocketOptions = pxNetworkBuffer->pucEthernetBuffer[ ipSOCKET_OPTIONS_OFFSET ];
-			#endif
-			/*
-			 * Offset the memcpy by the size of a MAC address to start at the packet's
-			 * Ethernet header 'source' MAC address; the preceding 'destination' should not be altered.
-			 */
-			char *pxUdpSrcAddrOffset = ( char *) pxUDPPacket + sizeof( MACAddress_t );
-			memcpy( pxUdpSrcAddrOffset, xDefaultPartUDPPacketHeader.ucBytes, sizeof( xDefaultPartUDPPacketHeader ) );
-
-		#if ipconfigSUPPORT_OUTGOING_PINGS == 1
-			if( pxNetworkBuffer->usPort == ipPACKET_CONTAINS_ICMP_DATA )
-			{
-				pxIPHeader->ucProtocol = ipPROTOCOL_ICMP;
-				pxIPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( IPHeader_t ) );
-			}
-			else
-		#endif /* ipconfigSUPPORT_OUTGOING_PINGS */
+/*
+ * Pass a complete UDP (or ICMP) packet to the network interface.  The network
+ * driver is responsible for freeing the network buffer after the packet has
+ * been sent.
+ */
+static void prvTransmitUDPPacket( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+	#if defined( ipconfigETHERNET_MINIMUM_PACKET_BYTES )
+	{
+		if( pxNetworkBuffer->xDataLength < ( size_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES )
+		{
+		BaseType_t xIndex;
+
+			for( xIndex = ( BaseType_t ) pxNetworkBuffer->xDataLength; xIndex < ( BaseType_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES; xIndex++ )
 			{
-				pxIPHeader->usLength = ( uint16_t ) ( pxNetworkBuffer->xDataLength + sizeof( IPHeader_t ) + sizeof( UDPHeader_t ) );
+				pxNetworkBuffer->pucEthernetBuffer[ xIndex ] = 0u;
 			}
+			pxNetworkBuffer->xDataLength = ( size_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES;
+		}
+	}
+	#endif
 
-			/* The total transmit size adds on the Ethernet header. */
-			pxNetworkBuffer->xDataLength = pxIPHeader->usLength + sizeof( EthernetHeader_t );
-			pxIPHeader->usLength = FreeRTOS_htons( pxIPHeader->usLength );
-			/* HT:endian: changed back to network endian */
-			pxIPHeader->ulDestinationIPAddress = pxNetworkBuffer->ulIPAddress;
+	xIPNetworkInterfaceOutput( pxNetworkBuffer, pdTRUE );
+}
+/*-----------------------------------------------------------*/
 
-			#if( ipconfigUSE_LLMNR == 1 )
-			{
-				/* LLMNR messages are typically used on a LAN and they're
-				 * not supposed to cross routers */
-				if( pxNetworkBuffer->ulIPAddress == ipLLMNR_IP_ADDR )
-				{
-					pxIPHeader->ucTimeToLive = 0x01;
-				}
-			}
-			#endif
+void vProcessGeneratedUDPPacket( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+UDPPacket_t *pxUDPPacket;
+eARPLookupResult_t eReturned;
+uint32_t ulIPAddress = pxNetworkBuffer->ulIPAddress;
 
-			#if( ipconfigDRIVER_INCLUDED_TX_IP_CHECKSUM == 0 )
-			{
-				pxIPHeader->usHeaderChecksum = 0u;
-				pxIPHeader->usHeaderChecksum = usGenerateChecksum( 0UL, ( uint8_t * ) &( pxIPHeader->ucVersionHeaderLength ), ipSIZE_OF_IPv4_HEADER );
-				pxIPHeader->usHeaderChecksum = ~FreeRTOS_htons( pxIPHeader->usHeaderChecksum );
+	/* Map the UDP packet onto the start of the frame. */
+	pxUDPPacket = ( UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
 
-				if( ( ucSocketOptions & ( uint8_t ) FREERTOS_SO_UDPCKSUM_OUT ) != 0u )
-				{
-					usGenerateProtocolChecksum( (uint8_t*)pxUDPPacket, pxNetworkBuffer->xDataLength, pdTRUE );
-				}
-				else
-				{
-					pxUDPPacket->xUDPHeader.usChecksum = 0u;
-				}
-			}
-			#endif
+	/* Determine the ARP cache status for the requested IP address. */
+	eReturned = eARPGetCacheEntry( &( ulIPAddress ), &( pxUDPPacket->xEthernetHeader.xDestinationAddress ) );
+
+	if( eReturned != eCantSendPacket )
+	{
+		if( eReturned == eARPCacheHit )
+		{
+			prvPrepareUDPPacket( pxNetworkBuffer );
 		}
 		else if( eReturned == eARPCacheMiss )
 		{
@@ -207,25 +246,7 @@ uint32_t ulIPAddress = pxNetworkBuffer->ulIPAddress;
 
 	if( eReturned != eCantSendPacket )
 	{
-		/* The network driver is responsible for freeing the network buffer
-		after the packet has been sent. */
-
-		#if defined( ipconfigETHERNET_MINIMUM_PACKET_BYTES )
-		{
-			if( pxNetworkBuffer->xDataLength < ( size_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES )
-			{
-			BaseType_t xIndex;
-
-				for( xIndex = ( BaseType_t ) pxNetworkBuffer->xDataLength; xIndex < ( BaseType_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES; xIndex++ )
-				{
-					pxNetworkBuffer->pucEthernetBuffer[ xIndex ] = 0u;
-				}
-				pxNetworkBuffer->xDataLength = ( size_t ) ipconfigETHERNET_MINIMUM_PACKET_BYTES;
-			}
-		}
-		#endif
-
-		xNetworkInterfaceOutput( pxNetworkBuffer, pdTRUE );
+		prvTransmitUDPPacket( pxNetworkBuffer );
 	}
 	else
 	{
@@ -236,6 +257,43 @@ uint32_t ulIPAddress = pxNetworkBuffer->ulIPAddress;
 }
 /*-----------------------------------------------------------*/
 
+#if( ipconfigUDP_DIRECT_SEND != 0 )
+
+	BaseType_t xSendUDPPacketDirect( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+	{
+	uint32_t ulIPAddress = pxNetworkBuffer->ulIPAddress;
+	MACAddress_t xMACAddress;
+	eARPLookupResult_t eReturned;
+	BaseType_t xReturn = pdFALSE;
+
+		/* The ARP cache is owned by the IP-task, which updates rows within a
+		critical section when ipconfigUDP_DIRECT_SEND is defined. */
+		taskENTER_CRITICAL();
+		{
+			eReturned = eARPGetCacheEntry( &( ulIPAddress ), &( xMACAddress ) );
+		}
+		taskEXIT_CRITICAL();
+
+		if( eReturned == eARPCacheHit )
+		{
+			memcpy( ( void * ) &( ( ( UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer )->xEthernetHeader.xDestinationAddress ),
+				( void * ) &( xMACAddress ), sizeof( xMACAddress ) );
+			prvPrepareUDPPacket( pxNetworkBuffer );
+			prvTransmitUDPPacket( pxNetworkBuffer );
+			xReturn = pdTRUE;
+		}
+		else
+		{
+			/* Either an ARP request must be sent, or the packet must be
+			dropped.  Leave both to the IP-task. */
+		}
+
+		return xReturn;
+	}
+
+#endif /* ipconfigUDP_DIRECT_SEND */
+/*-----------------------------------------------------------*/
+
 BaseType_t xProcessReceivedUDPPacket( NetworkBufferDescriptor_t *pxNetworkBuffer, uint16_t usPort )
 {
 BaseType_t xReturn = pdPASS;
@@ -0,0 +1,910 @@
+/*
+FreeRTOS+TCP V2.0.10
+Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ http://aws.amazon.com/freertos
+ http://www.FreeRTOS.org
+*/
+
+/* Standard includes. */
+#include <stdint.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* FreeRTOS+TCP includes. */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_IP_Private.h"
+#include "FreeRTOS_ARP.h"
+#include "NetworkBufferManagement.h"
+#include "NetworkInterface.h"
+
+#include "SimLink.h"
+
+/* This driver does not filter frames, all reflected frames are passed to the
+IP-task. */
+
+/* Size of a single buffer when BufferAllocation_1.c is used. */
+#define niBUFFER_1_PACKET_SIZE		1536
+
+#define niMICROSECONDS_PER_TICK		( ( uint64_t ) portTICK_PERIOD_MS * 1000ULL )
+#define niMICROSECONDS_PER_MS		( 1000ULL )
+#define niPPM_RANGE					( 1000000UL )
+
+#if( ipconfigUSE_DHCP != 0 )
+	/* The well-known DHCP ports. */
+	#define niDHCP_SERVER_PORT			( 67u )
+	#define niDHCP_CLIENT_PORT			( 68u )
+
+	/* Offsets within a BOOTP/DHCP message. */
+	#define niDHCP_OPCODE_OFFSET		( 0u )
+	#define niDHCP_CLIENT_IP_OFFSET		( 12u )
+	#define niDHCP_YOUR_IP_OFFSET		( 16u )
+	#define niDHCP_SERVER_IP_OFFSET		( 20u )
+	#define niDHCP_COOKIE_OFFSET		( 236u )
+	#define niDHCP_OPTIONS_OFFSET		( 240u )
+
+	/* Room for the options that the virtual server sends. */
+	#define niDHCP_MAX_OPTIONS_LENGTH	( 48u )
+
+	#define niDHCP_REPLY_OPCODE			( 2u )
+
+	/* The option codes and message types that the server understands. */
+	#define niDHCP_OPTION_PAD			( 0u )
+	#define niDHCP_OPTION_SUBNET_MASK	( 1u )
+	#define niDHCP_OPTION_GATEWAY		( 3u )
+	#define niDHCP_OPTION_DNS_SERVER	( 6u )
+	#define niDHCP_OPTION_REQUESTED_IP	( 50u )
+	#define niDHCP_OPTION_LEASE_TIME	( 51u )
+	#define niDHCP_OPTION_MESSAGE_TYPE	( 53u )
+	#define niDHCP_OPTION_SERVER_ID		( 54u )
+	#define niDHCP_OPTION_RAPID_COMMIT	( 80u )
+	#define niDHCP_OPTION_END			( 255u )
+
+	#define niDHCP_DISCOVER				( 1u )
+	#define niDHCP_OFFER				( 2u )
+	#define niDHCP_REQUEST				( 3u )
+	#define niDHCP_DECLINE				( 4u )
+	#define niDHCP_ACK					( 5u )
+	#define niDHCP_NAK					( 6u )
+#endif /* ipconfigUSE_DHCP */
+
+/*-----------------------------------------------------------*/
+
+/* A frame that is travelling through the emulated cable. */
+typedef struct xSIM_LINK_SLOT
+{
+	NetworkBufferDescriptor_t *pxBuffer;	/* NULL when the slot is free. */
+	uint64_t ullDueTimeUS;					/* When the frame arrives at the other end. */
+	uint32_t ulSequence;					/* Keeps frames with equal due times in order. */
+	eSimLinkDirection_t eDirection;
+} SimLinkSlot_t;
+
+/* One direction of the emulated cable. */
+typedef struct xSIM_LINK_PIPE
+{
+	SimLinkParameters_t xParameters;
+	SimLinkStatistics_t xStatistics;
+	uint64_t ullBusyUntilUS;	/* The time at which the last frame was completely serialised. */
+	uint32_t ulRandom;			/* State of the xorshift generator. */
+	uint32_t ulInFlight;
+} SimLinkPipe_t;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The task that hands frames back to the IP-task once their delay has passed.
+ */
+static void prvSimLinkTask( void *pvParameters );
+
+/*
+ * Turn a frame that was sent by the IP-stack into the frame that the virtual
+ * peer would send back.  Returns pdFALSE when the peer has no answer.
+ */
+static BaseType_t prvReflectFrame( NetworkBufferDescriptor_t * const pxNetworkBuffer );
+
+/*
+ * Decide which pipe a frame travels through.
+ */
+static eSimLinkDirection_t prvGetDirection( const NetworkBufferDescriptor_t * const pxNetworkBuffer );
+
+/*
+ * Place a frame in the emulated cable, or drop it.
+ */
+static void prvEnqueueFrame( NetworkBufferDescriptor_t * const pxNetworkBuffer, eSimLinkDirection_t eDirection );
+
+/*
+ * The current time in micro seconds, with a 64-bit range.
+ */
+static uint64_t prvGetTimeUS( void );
+
+/*
+ * A simple and fast pseudo random generator that gives the same sequence on
+ * every platform.
+ */
+static uint32_t prvNextRandom( SimLinkPipe_t *pxPipe );
+
+#if( ipconfigUSE_DHCP != 0 )
+	/*
+	 * Returns pdTRUE if the frame is a message from a DHCP client.
+	 */
+	static BaseType_t prvIsDHCPRequest( const NetworkBufferDescriptor_t * const pxNetworkBuffer );
+
+	/*
+	 * The virtual DHCP server: answer a message from a DHCP client that has
+	 * travelled through the eSimLinkClientToServer pipe.  The request is
+	 * released, an answer is placed in the eSimLinkServerToClient pipe.
+	 */
+	static void prvDHCPServerReply( NetworkBufferDescriptor_t * const pxRequest );
+#endif /* ipconfigUSE_DHCP */
+
+/*-----------------------------------------------------------*/
+
+/* The MAC address of the virtual peer. */
+static const MACAddress_t xSimPeerMACAddress = { { 0x02, 0x53, 0x49, 0x4d, 0x4c, 0x4b } };
+
+static SimLinkPipe_t xPipes[ eSimLinkDirections ];
+static SimLinkSlot_t xSlots[ ipconfigSIM_LINK_QUEUE_LENGTH ];
+static uint32_t ulNextSequence = 0UL;
+
+static TaskHandle_t xSimLinkTaskHandle = NULL;
+
+/* Used by prvGetTimeUS() to extend the tick count to 64-bits. */
+static TickType_t xLastTickCount = 0;
+static uint64_t ullTickOverflows = 0ULL;
+
+#if( ipconfigUSE_DHCP != 0 )
+	static SimLinkDHCPServer_t xDHCPServer;
+	static BaseType_t xDHCPServerConfigured = pdFALSE;
+	static SimLinkDHCPStatistics_t xDHCPStatistics;
+#endif
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceInitialise( void )
+{
+BaseType_t xReturn = pdPASS;
+
+	if( xSimLinkTaskHandle == NULL )
+	{
+		vSimLinkReset( ipconfigSIM_LINK_DEFAULT_SEED );
+
+		#if( ipconfigUSE_DHCP != 0 )
+		{
+			if( xDHCPServerConfigured == pdFALSE )
+			{
+				/* By default the server hands out the configured static
+				address, and the gateway acts as the server. */
+				xDHCPServer.xEnabled = pdTRUE;
+				xDHCPServer.xRapidCommit = pdFALSE;
+				xDHCPServer.ulServerAddress = xDefaultAddressing.ulGatewayAddress;
+				xDHCPServer.ulOfferedAddress = xDefaultAddressing.ulDefaultIPAddress;
+				xDHCPServer.ulNetMask = xDefaultAddressing.ulNetMask;
+				xDHCPServer.ulGatewayAddress = xDefaultAddressing.ulGatewayAddress;
+				xDHCPServer.ulDNSServerAddress = xDefaultAddressing.ulDNSServerAddress;
+				xDHCPServer.ulLeaseSeconds = ipconfigSIM_LINK_DHCP_LEASE_SECONDS;
+				xDHCPServer.ulAddressInUse = 0UL;
+				xDHCPServerConfigured = pdTRUE;
+			}
+		}
+		#endif /* ipconfigUSE_DHCP */
+
+		if( xTaskCreate( prvSimLinkTask, "SimLink", ipconfigSIM_LINK_TASK_STACK_SIZE_WORDS, NULL,
+			ipconfigSIM_LINK_TASK_PRIORITY, &xSimLinkTaskHandle ) != pdPASS )
+		{
+			xSimLinkTaskHandle = NULL;
+			xReturn = pdFAIL;
+		}
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xNetworkInterfaceOutput( NetworkBufferDescriptor_t * const pxNetworkBuffer, BaseType_t xReleaseAfterSend )
+{
+NetworkBufferDescriptor_t *pxFrame = pxNetworkBuffer;
+
+	iptraceNETWORK_INTERFACE_TRANSMIT();
+
+	if( xReleaseAfterSend == pdFALSE )
+	{
+		/* The stack keeps ownership of the buffer, and the frame will be
+		modified while it travels, so a copy must be used. */
+		pxFrame = pxDuplicateNetworkBufferWithDescriptor( pxNetworkBuffer, pxNetworkBuffer->xDataLength );
+	}
+
+	if( pxFrame != NULL )
+	{
+		#if( ipconfigUSE_DHCP != 0 )
+		if( prvIsDHCPRequest( pxFrame ) != pdFALSE )
+		{
+			/* The virtual DHCP server will answer once the request has
+			travelled through the cable. */
+			prvEnqueueFrame( pxFrame, eSimLinkClientToServer );
+		}
+		else
+		#endif /* ipconfigUSE_DHCP */
+		if( prvReflectFrame( pxFrame ) != pdFALSE )
+		{
+			prvEnqueueFrame( pxFrame, prvGetDirection( pxFrame ) );
+		}
+		else
+		{
+			vReleaseNetworkBufferAndDescriptor( pxFrame );
+		}
+	}
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+void vNetworkInterfaceAllocateRAMToBuffers( NetworkBufferDescriptor_t pxNetworkBuffers[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS ] )
+{
+static uint8_t ucNetworkPackets[ ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS * niBUFFER_1_PACKET_SIZE ];
+uint8_t *pucRAMBuffer = ucNetworkPackets;
+BaseType_t x;
+
+	for( x = 0; x < ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS; x++ )
+	{
+		pxNetworkBuffers[ x ].pucEthernetBuffer = pucRAMBuffer + ipBUFFER_PADDING;
+		*( ( NetworkBufferDescriptor_t ** ) pucRAMBuffer ) = &( pxNetworkBuffers[ x ] );
+		pucRAMBuffer += niBUFFER_1_PACKET_SIZE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xGetPhyLinkStatus( void )
+{
+	/* The emulated cable is always plugged in. */
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vSimLinkSetParameters( eSimLinkDirection_t eDirection, const SimLinkParameters_t *pxParameters )
+{
+	configASSERT( eDirection < eSimLinkDirections );
+	configASSERT( pxParameters != NULL );
+
+	taskENTER_CRITICAL();
+	{
+		memcpy( &( xPipes[ eDirection ].xParameters ), pxParameters, sizeof( xPipes[ eDirection ].xParameters ) );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vSimLinkGetStatistics( eSimLinkDirection_t eDirection, SimLinkStatistics_t *pxStatistics )
+{
+	configASSERT( eDirection < eSimLinkDirections );
+	configASSERT( pxStatistics != NULL );
+
+	taskENTER_CRITICAL();
+	{
+		memcpy( pxStatistics, &( xPipes[ eDirection ].xStatistics ), sizeof( *pxStatistics ) );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vSimLinkReset( uint32_t ulSeed )
+{
+BaseType_t x;
+
+	/* Zero is a fixed point of the xorshift generator. */
+	if( ulSeed == 0UL )
+	{
+		ulSeed = ipconfigSIM_LINK_DEFAULT_SEED;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		for( x = 0; x < ( BaseType_t ) eSimLinkDirections; x++ )
+		{
+			memset( &( xPipes[ x ].xStatistics ), '\0', sizeof( xPipes[ x ].xStatistics ) );
+			/* Give both directions a different, but repeatable, sequence. */
+			xPipes[ x ].ulRandom = ulSeed ^ ( ( uint32_t ) x * 0x9E3779B9UL );
+			if( xPipes[ x ].ulRandom == 0UL )
+			{
+				xPipes[ x ].ulRandom = ulSeed;
+			}
+		}
+
+		#if( ipconfigUSE_DHCP != 0 )
+		{
+			memset( &xDHCPStatistics, '\0', sizeof( xDHCPStatistics ) );
+		}
+		#endif
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if( ipconfigUSE_DHCP != 0 )
+
+	void vSimLinkSetDHCPServer( const SimLinkDHCPServer_t *pxServer )
+	{
+		configASSERT( pxServer != NULL );
+
+		taskENTER_CRITICAL();
+		{
+			memcpy( &xDHCPServer, pxServer, sizeof( xDHCPServer ) );
+			xDHCPServerConfigured = pdTRUE;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+#endif /* ipconfigUSE_DHCP */
+/*-----------------------------------------------------------*/
+
+#if( ipconfigUSE_DHCP != 0 )
+
+	void vSimLinkGetDHCPServer( SimLinkDHCPServer_t *pxServer )
+	{
+		configASSERT( pxServer != NULL );
+
+		taskENTER_CRITICAL();
+		{
+			memcpy( pxServer, &xDHCPServer, sizeof( *pxServer ) );
+		}
+		taskEXIT_CRITICAL();
+	}
+
+#endif /* ipconfigUSE_DHCP */
+/*-----------------------------------------------------------*/
+
+#if( ipconfigUSE_DHCP != 0 )
+
+	void vSimLinkGetDHCPStatistics( SimLinkDHCPStatistics_t *pxStatistics )
+	{
+		configASSERT( pxStatistics != NULL );
+
+		taskENTER_CRITICAL();
+		{
+			memcpy( pxStatistics, &xDHCPStatistics, sizeof( *pxStatistics ) );
+		}
+		taskEXIT_CRITICAL();
+	}
+
+#endif /* ipconfigUSE_DHCP */
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvReflectFrame( NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+EthernetHeader_t *pxEthernetHeader = ( EthernetHeader_t * ) pxNetworkBuffer->pucEthernetBuffer;
+ARPPacket_t *pxARPPacket;
+ARPHeader_t *pxARPHeader;
+uint32_t ulSenderProtocolAddress, ulTargetProtocolAddress, ulAddressInUse = 0UL;
+BaseType_t xReturn = pdFALSE;
+
+	if( pxNetworkBuffer->xDataLength < sizeof( EthernetHeader_t ) )
+	{
+		/* Runt frame, nothing to reflect. */
+	}
+	else if( pxEthernetHeader->usFrameType == ipARP_FRAME_TYPE )
+	{
+		pxARPPacket = ( ARPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
+		pxARPHeader = &( pxARPPacket->xARPHeader );
+		memcpy( &ulSenderProtocolAddress, pxARPHeader->ucSenderProtocolAddress, sizeof( ulSenderProtocolAddress ) );
+		ulTargetProtocolAddress = pxARPHeader->ulTargetProtocolAddress;
+
+		#if( ipconfigUSE_DHCP != 0 )
+		{
+			taskENTER_CRITICAL();
+			{
+				ulAddressInUse = xDHCPServer.ulAddressInUse;
+			}
+			taskEXIT_CRITICAL();
+		}
+		#endif /* ipconfigUSE_DHCP */
+
+		/* The peer answers every ARP request, except for gratuitous ones and
+		probes, because those would look like an address clash.  A probe for
+		the address that is in use by another host is answered. */
+		if( ( pxNetworkBuffer->xDataLength >= sizeof( ARPPacket_t ) ) &&
+			( pxARPHeader->usOperation == ( uint16_t ) ipARP_REQUEST ) &&
+			( ulSenderProtocolAddress != ulTargetProtocolAddress ) &&
+			( ( ulSenderProtocolAddress != 0UL ) ||
+			  ( ( ulAddressInUse != 0UL ) && ( ulTargetProtocolAddress == ulAddressInUse ) ) ) )
+		{
+			pxARPHeader->usOperation = ( uint16_t ) ipARP_REPLY;
+			memcpy( pxARPHeader->xTargetHardwareAddress.ucBytes, pxARPHeader->xSenderHardwareAddress.ucBytes, sizeof( MACAddress_t ) );
+			pxARPHeader->ulTargetProtocolAddress = ulSenderProtocolAddress;
+			memcpy( pxARPHeader->xSenderHardwareAddress.ucBytes, xSimPeerMACAddress.ucBytes, sizeof( MACAddress_t ) );
+			memcpy( pxARPHeader->ucSenderProtocolAddress, &ulTargetProtocolAddress, sizeof( pxARPHeader->ucSenderProtocolAddress ) );
+			xReturn = pdTRUE;
+		}
+	}
+	else if( memcmp( pxEthernetHeader->xDestinationAddress.ucBytes, xBroadcastMACAddress.ucBytes, sizeof( MACAddress_t ) ) != 0 )
+	{
+		/* A unicast frame is returned unchanged, except for its MAC addresses.
+		Broadcasts (DHCP, NBNS) are not reflected, the stack should not see its
+		own requests. */
+		xReturn = pdTRUE;
+	}
+
+	if( xReturn != pdFALSE )
+	{
+		memcpy( pxEthernetHeader->xDestinationAddress.ucBytes, ipLOCAL_MAC_ADDRESS, sizeof( MACAddress_t ) );
+		memcpy( pxEthernetHeader->xSourceAddress.ucBytes, xSimPeerMACAddress.ucBytes, sizeof( MACAddress_t ) );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static eSimLinkDirection_t prvGetDirection( const NetworkBufferDescriptor_t * const pxNetworkBuffer )
+{
+const UDPPacket_t *pxUDPPacket = ( const UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
+eSimLinkDirection_t eReturn = eSimLinkClientToServer;
+
+	/* The TCP and UDP headers both start with the source and destination port,
+	and the stack always sends IP headers without options. */
+	if( ( pxUDPPacket->xEthernetHeader.usFrameType == ipIPv4_FRAME_TYPE ) &&
+		( pxNetworkBuffer->xDataLength >= sizeof( UDPPacket_t ) ) &&
+		( ( pxUDPPacket->xIPHeader.ucProtocol == ( uint8_t ) ipPROTOCOL_TCP ) ||
+		  ( pxUDPPacket->xIPHeader.ucProtocol == ( uint8_t ) ipPROTOCOL_UDP ) ) )
+	{
+		if( FreeRTOS_ntohs( pxUDPPacket->xUDPHeader.usSourcePort ) < FreeRTOS_ntohs( pxUDPPacket->xUDPHeader.usDestinationPort ) )
+		{
+			eReturn = eSimLinkServerToClient;
+		}
+	}
+
+	return eReturn;
+}
+/*-----------------------------------------------------------*/
+
+static void prvEnqueueFrame( NetworkBufferDescriptor_t * const pxNetworkBuffer, eSimLinkDirection_t eDirection )
+{
+SimLinkPipe_t *pxPipe = &( xPipes[ eDirection ] );
+SimLinkSlot_t *pxSlot = NULL;
+uint64_t ullNow, ullStart, ullDue;
+BaseType_t x;
+
+	ullNow = prvGetTimeUS();
+
+	taskENTER_CRITICAL();
+	{
+		pxPipe->xStatistics.ulFramesSent++;
+
+		if( ( pxPipe->xParameters.ulLossPPM != 0UL ) &&
+			( ( prvNextRandom( pxPipe ) % niPPM_RANGE ) < pxPipe->xParameters.ulLossPPM ) )
+		{
+			pxPipe->xStatistics.ulFramesLost++;
+		}
+		else if( ( pxPipe->xParameters.ulQueueLimit != 0UL ) &&
+				 ( pxPipe->ulInFlight >= pxPipe->xParameters.ulQueueLimit ) )
+		{
+			/* Tail drop, like a router with a full output queue. */
+			pxPipe->xStatistics.ulFramesOverflowed++;
+		}
+		else
+		{
+			for( x = 0; x < ipconfigSIM_LINK_QUEUE_LENGTH; x++ )
+			{
+				if( xSlots[ x ].pxBuffer == NULL )
+				{
+					pxSlot = &( xSlots[ x ] );
+					break;
+				}
+			}
+
+			if( pxSlot == NULL )
+			{
+				pxPipe->xStatistics.ulFramesOverflowed++;
+			}
+			else
+			{
+				/* The frame can not be serialised before the previous frame
+				has left the sender. */
+				ullStart = ( pxPipe->ullBusyUntilUS > ullNow ) ? pxPipe->ullBusyUntilUS : ullNow;
+
+				if( pxPipe->xParameters.ulBandwidthBPS != 0UL )
+				{
+					ullStart += ( ( uint64_t ) pxNetworkBuffer->xDataLength * 8ULL * 1000000ULL ) / pxPipe->xParameters.ulBandwidthBPS;
+				}
+
+				pxPipe->ullBusyUntilUS = ullStart;
+				ullDue = ullStart + ( ( uint64_t ) pxPipe->xParameters.ulLatencyMS * niMICROSECONDS_PER_MS );
+
+				if( ( pxPipe->xParameters.ulReorderPPM != 0UL ) &&
+					( ( prvNextRandom( pxPipe ) % niPPM_RANGE ) < pxPipe->xParameters.ulReorderPPM ) )
+				{
+					ullDue += ( uint64_t ) pxPipe->xParameters.ulReorderDelayMS * niMICROSECONDS_PER_MS;
+					pxPipe->xStatistics.ulFramesReordered++;
+				}
+
+				pxSlot->pxBuffer = pxNetworkBuffer;
+				pxSlot->ullDueTimeUS = ullDue;
+				pxSlot->ulSequence = ulNextSequence++;
+				pxSlot->eDirection = eDirection;
+				pxPipe->ulInFlight++;
+			}
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( pxSlot == NULL )
+	{
+		vReleaseNetworkBufferAndDescriptor( pxNetworkBuffer );
+	}
+	else if( xSimLinkTaskHandle != NULL )
+	{
+		/* The new frame might be due before the one the task is waiting for. */
+		xTaskNotifyGive( xSimLinkTaskHandle );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvSimLinkTask( void *pvParameters )
+{
+IPStackEvent_t xRxEvent = { eNetworkRxEvent, NULL };
+NetworkBufferDescriptor_t *pxBuffer;
+SimLinkSlot_t *pxFirst;
+uint64_t ullNow, ullWaitUS;
+TickType_t xBlockTime;
+BaseType_t x;
+
+	/* Remove compiler warnings about unused parameters. */
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		ullNow = prvGetTimeUS();
+		pxBuffer = NULL;
+		pxFirst = NULL;
+
+		taskENTER_CRITICAL();
+		{
+			/* Find the frame that arrives first.  The cable is short, so a
+			linear search is fast enough. */
+			for( x = 0; x < ipconfigSIM_LINK_QUEUE_LENGTH; x++ )
+			{
+				if( xSlots[ x ].pxBuffer != NULL )
+				{
+					if( ( pxFirst == NULL ) ||
+						( xSlots[ x ].ullDueTimeUS < pxFirst->ullDueTimeUS ) ||
+						( ( xSlots[ x ].ullDueTimeUS == pxFirst->ullDueTimeUS ) &&
+						  ( ( int32_t ) ( xSlots[ x ].ulSequence - pxFirst->ulSequence ) < 0 ) ) )
+					{
+						pxFirst = &( xSlots[ x ] );
+					}
+				}
+			}
+
+			if( ( pxFirst != NULL ) && ( pxFirst->ullDueTimeUS <= ullNow ) )
+			{
+				pxBuffer = pxFirst->pxBuffer;
+				pxFirst->pxBuffer = NULL;
+				xPipes[ pxFirst->eDirection ].ulInFlight--;
+				xPipes[ pxFirst->eDirection ].xStatistics.ulFramesDelivered++;
+				xPipes[ pxFirst->eDirection ].xStatistics.ulBytesDelivered += ( uint32_t ) pxBuffer->xDataLength;
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		#if( ipconfigUSE_DHCP != 0 )
+		if( ( pxBuffer != NULL ) && ( prvIsDHCPRequest( pxBuffer ) != pdFALSE ) )
+		{
+			prvDHCPServerReply( pxBuffer );
+		}
+		else
+		#endif /* ipconfigUSE_DHCP */
+		if( pxBuffer != NULL )
+		{
+			iptraceNETWORK_INTERFACE_RECEIVE();
+			xRxEvent.pvData = ( void * ) pxBuffer;
+
+			if( xSendEventStructToIPTask( &xRxEvent, ( TickType_t ) 0 ) == pdFAIL )
+			{
+				vReleaseNetworkBufferAndDescriptor( pxBuffer );
+				iptraceETHERNET_RX_EVENT_LOST();
+			}
+		}
+		else
+		{
+			if( pxFirst == NULL )
+			{
+				xBlockTime = portMAX_DELAY;
+			}
+			else
+			{
+				/* Round up, a frame must never arrive early. */
+				ullWaitUS = pxFirst->ullDueTimeUS - ullNow;
+				xBlockTime = ( TickType_t ) ( ( ullWaitUS + niMICROSECONDS_PER_TICK - 1ULL ) / niMICROSECONDS_PER_TICK );
+			}
+
+			ulTaskNotifyTake( pdTRUE, xBlockTime );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetTimeUS( void )
+{
+TickType_t xNow;
+uint64_t ullReturn;
+
+	taskENTER_CRITICAL();
+	{
+		xNow = xTaskGetTickCount();
+
+		if( xNow < xLastTickCount )
+		{
+			ullTickOverflows++;
+		}
+
+		xLastTickCount = xNow;
+		ullReturn = ( ( ullTickOverflows << ( sizeof( TickType_t ) * 8U ) ) + ( uint64_t ) xNow ) * niMICROSECONDS_PER_TICK;
+	}
+	taskEXIT_CRITICAL();
+
+	return ullReturn;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvNextRandom( SimLinkPipe_t *pxPipe )
+{
+uint32_t ulValue = pxPipe->ulRandom;
+
+	ulValue ^= ulValue << 13;
+	ulValue ^= ulValue >> 17;
+	ulValue ^= ulValue << 5;
+	pxPipe->ulRandom = ulValue;
+
+	return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+#if( ipconfigUSE_DHCP != 0 )
+
+	static BaseType_t prvIsDHCPRequest( const NetworkBufferDescriptor_t * const pxNetworkBuffer )
+	{
+	const UDPPacket_t *pxUDPPacket = ( const UDPPacket_t * ) pxNetworkBuffer->pucEthernetBuffer;
+	BaseType_t xReturn = pdFALSE;
+
+		if( ( pxNetworkBuffer->xDataLength >= sizeof( UDPPacket_t ) + niDHCP_OPTIONS_OFFSET ) &&
+			( pxUDPPacket->xEthernetHeader.usFrameType == ipIPv4_FRAME_TYPE ) &&
+			( pxUDPPacket->xIPHeader.ucProtocol == ( uint8_t ) ipPROTOCOL_UDP ) &&
+			( pxUDPPacket->xUDPHeader.usDestinationPort == FreeRTOS_htons( niDHCP_SERVER_PORT ) ) )
+		{
+			xReturn = pdTRUE;
+		}
+
+		return xReturn;
+	}
+
+#endif /* ipconfigUSE_DHCP */
+/*-----------------------------------------------------------*/
+
+#if( ipconfigUSE_DHCP != 0 )
+
+	static void prvDHCPServerReply( NetworkBufferDescriptor_t * const pxRequest )
+	{
+	SimLinkDHCPServer_t xServer;
+	const uint8_t *pucRequest = pxRequest->pucEthernetBuffer + sizeof( UDPPacket_t );
+	size_t xRequestLength = pxRequest->xDataLength - sizeof( UDPPacket_t );
+	NetworkBufferDescriptor_t *pxReply;
+	UDPPacket_t *pxUDPPacket;
+	uint8_t *pucReply, *pucOption;
+	uint8_t ucMessageType = 0u, ucAnswer = 0u, ucCode, ucLength;
+	BaseType_t xRapidCommit = pdFALSE;
+	uint32_t ulRequestedAddress, ulValue;
+	size_t xIndex, xPayloadLength;
+
+		vSimLinkGetDHCPServer( &xServer );
+
+		/* An INIT-REBOOT request carries the address in option 50, a renewal
+		carries it in 'ciaddr'. */
+		memcpy( &ulRequestedAddress, pucRequest + niDHCP_CLIENT_IP_OFFSET, sizeof( ulRequestedAddress ) );
+
+		xIndex = niDHCP_OPTIONS_OFFSET;
+		while( xIndex < xRequestLength )
+		{
+			ucCode = pucRequest[ xIndex++ ];
+
+			if( ucCode == niDHCP_OPTION_END )
+			{
+				break;
+			}
+
+			if( ( ucCode == niDHCP_OPTION_PAD ) || ( xIndex >= xRequestLength ) )
+			{
+				continue;
+			}
+
+			ucLength = pucRequest[ xIndex++ ];
+
+			if( xIndex + ucLength > xRequestLength )
+			{
+				break;
+			}
+
+			if( ( ucCode == niDHCP_OPTION_MESSAGE_TYPE ) && ( ucLength == 1u ) )
+			{
+				ucMessageType = pucRequest[ xIndex ];
+			}
+			else if( ( ucCode == niDHCP_OPTION_REQUESTED_IP ) && ( ucLength == sizeof( ulRequestedAddress ) ) )
+			{
+				memcpy( &ulRequestedAddress, pucRequest + xIndex, sizeof( ulRequestedAddress ) );
+			}
+			else if( ucCode == niDHCP_OPTION_RAPID_COMMIT )
+			{
+				xRapidCommit = pdTRUE;
+			}
+
+			xIndex += ucLength;
+		}
+
+		taskENTER_CRITICAL();
+		{
+			if( ucMessageType == niDHCP_DISCOVER )
+			{
+				xDHCPStatistics.ulDiscovers++;
+			}
+			else if( ucMessageType == niDHCP_REQUEST )
+			{
+				xDHCPStatistics.ulRequests++;
+			}
+			else if( ucMessageType == niDHCP_DECLINE )
+			{
+				xDHCPStatistics.ulDeclines++;
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		if( xServer.xEnabled == pdFALSE )
+		{
+			/* The server is down, the request gets lost. */
+		}
+		else if( ucMessageType == niDHCP_DISCOVER )
+		{
+			if( ( xServer.xRapidCommit != pdFALSE ) && ( xRapidCommit != pdFALSE ) )
+			{
+				ucAnswer = niDHCP_ACK;
+			}
+			else
+			{
+				ucAnswer = niDHCP_OFFER;
+				xRapidCommit = pdFALSE;
+			}
+		}
+		else if( ucMessageType == niDHCP_REQUEST )
+		{
+			ucAnswer = ( ulRequestedAddress == xServer.ulOfferedAddress ) ? niDHCP_ACK : niDHCP_NAK;
+			xRapidCommit = pdFALSE;
+		}
+		else
+		{
+			/* A DECLINE or a RELEASE does not get an answer. */
+		}
+
+		pxReply = NULL;
+		if( ucAnswer != 0u )
+		{
+			pxReply = pxGetNetworkBufferWithDescriptor( sizeof( UDPPacket_t ) + niDHCP_OPTIONS_OFFSET + niDHCP_MAX_OPTIONS_LENGTH, ( TickType_t ) 0 );
+		}
+
+		if( pxReply != NULL )
+		{
+			pxUDPPacket = ( UDPPacket_t * ) pxReply->pucEthernetBuffer;
+			pucReply = pxReply->pucEthernetBuffer + sizeof( UDPPacket_t );
+
+			/* The fixed part: the transaction ID, flags and the client's
+			hardware address are copied from the request. */
+			memcpy( pucReply, pucRequest, niDHCP_OPTIONS_OFFSET );
+			pucReply[ niDHCP_OPCODE_OFFSET ] = niDHCP_REPLY_OPCODE;
+			memset( pucReply + niDHCP_CLIENT_IP_OFFSET, '\0', sizeof( uint32_t ) );
+			ulValue = ( ucAnswer == niDHCP_NAK ) ? 0UL : xServer.ulOfferedAddress;
+			memcpy( pucReply + niDHCP_YOUR_IP_OFFSET, &ulValue, sizeof( ulValue ) );
+			memcpy( pucReply + niDHCP_SERVER_IP_OFFSET, &( xServer.ulServerAddress ), sizeof( xServer.ulServerAddress ) );
+
+			pucOption = pucReply + niDHCP_OPTIONS_OFFSET;
+			*( pucOption++ ) = niDHCP_OPTION_MESSAGE_TYPE;
+			*( pucOption++ ) = 1u;
+			*( pucOption++ ) = ucAnswer;
+			*( pucOption++ ) = niDHCP_OPTION_SERVER_ID;
+			*( pucOption++ ) = sizeof( uint32_t );
+			memcpy( pucOption, &( xServer.ulServerAddress ), sizeof( uint32_t ) );
+			pucOption += sizeof( uint32_t );
+
+			if( ucAnswer != niDHCP_NAK )
+			{
+				*( pucOption++ ) = niDHCP_OPTION_LEASE_TIME;
+				*( pucOption++ ) = sizeof( uint32_t );
+				ulValue = FreeRTOS_htonl( xServer.ulLeaseSeconds );
+				memcpy( pucOption, &ulValue, sizeof( uint32_t ) );
+				pucOption += sizeof( uint32_t );
+				*( pucOption++ ) = niDHCP_OPTION_SUBNET_MASK;
+				*( pucOption++ ) = sizeof( uint32_t );
+				memcpy( pucOption, &( xServer.ulNetMask ), sizeof( uint32_t ) );
+				pucOption += sizeof( uint32_t );
+				*( pucOption++ ) = niDHCP_OPTION_GATEWAY;
+				*( pucOption++ ) = sizeof( uint32_t );
+				memcpy( pucOption, &( xServer.ulGatewayAddress ), sizeof( uint32_t ) );
+				pucOption += sizeof( uint32_t );
+				*( pucOption++ ) = niDHCP_OPTION_DNS_SERVER;
+				*( pucOption++ ) = sizeof( uint32_t );
+				memcpy( pucOption, &( xServer.ulDNSServerAddress ), sizeof( uint32_t ) );
+				pucOption += sizeof( uint32_t );
+
+				if( xRapidCommit != pdFALSE )
+				{
+					*( pucOption++ ) = niDHCP_OPTION_RAPID_COMMIT;
+					*( pucOption++ ) = 0u;
+				}
+			}
+
+			*( pucOption++ ) = niDHCP_OPTION_END;
+			xPayloadLength = ( size_t ) ( pucOption - pucReply );
+
+			/* The headers of a broadcast from the server to the client. */
+			memcpy( pxUDPPacket->xEthernetHeader.xDestinationAddress.ucBytes, ipLOCAL_MAC_ADDRESS, sizeof( MACAddress_t ) );
+			memcpy( pxUDPPacket->xEthernetHeader.xSourceAddress.ucBytes, xSimPeerMACAddress.ucBytes, sizeof( MACAddress_t ) );
+			pxUDPPacket->xEthernetHeader.usFrameType = ipIPv4_FRAME_TYPE;
+
+			pxUDPPacket->xIPHeader.ucVersionHeaderLength = 0x45u;
+			pxUDPPacket->xIPHeader.ucDifferentiatedServicesCode = 0u;
+			pxUDPPacket->xIPHeader.usLength = FreeRTOS_htons( ipSIZE_OF_IPv4_HEADER + ipSIZE_OF_UDP_HEADER + xPayloadLength );
+			pxUDPPacket->xIPHeader.usIdentification = 0u;
+			pxUDPPacket->xIPHeader.usFragmentOffset = 0u;
+			pxUDPPacket->xIPHeader.ucTimeToLive = ipconfigUDP_TIME_TO_LIVE;
+			pxUDPPacket->xIPHeader.ucProtocol = ( uint8_t ) ipPROTOCOL_UDP;
+			pxUDPPacket->xIPHeader.ulSourceIPAddress = xServer.ulServerAddress;
+			pxUDPPacket->xIPHeader.ulDestinationIPAddress = ipBROADCAST_IP_ADDRESS;
+			pxUDPPacket->xIPHeader.usHeaderChecksum = 0u;
+			pxUDPPacket->xIPHeader.usHeaderChecksum = usGenerateChecksum( 0UL, ( uint8_t * ) &( pxUDPPacket->xIPHeader.ucVersionHeaderLength ), ipSIZE_OF_IPv4_HEADER );
+			pxUDPPacket->xIPHeader.usHeaderChecksum = ~FreeRTOS_htons( pxUDPPacket->xIPHeader.usHeaderChecksum );
+
+			pxUDPPacket->xUDPHeader.usSourcePort = FreeRTOS_htons( niDHCP_SERVER_PORT );
+			pxUDPPacket->xUDPHeader.usDestinationPort = FreeRTOS_htons( niDHCP_CLIENT_PORT );
+			pxUDPPacket->xUDPHeader.usLength = FreeRTOS_htons( ipSIZE_OF_UDP_HEADER + xPayloadLength );
+
+			pxReply->xDataLength = sizeof( UDPPacket_t ) + xPayloadLength;
+			usGenerateProtocolChecksum( pxReply->pucEthernetBuffer, pxReply->xDataLength, pdTRUE );
+
+			taskENTER_CRITICAL();
+			{
+				if( ucAnswer == niDHCP_OFFER )
+				{
+					xDHCPStatistics.ulOffers++;
+				}
+				else if( ucAnswer == niDHCP_ACK )
+				{
+					xDHCPStatistics.ulAcks++;
+				}
+				else
+				{
+					xDHCPStatistics.ulNaks++;
+				}
+			}
+			taskEXIT_CRITICAL();
+
+			prvEnqueueFrame( pxReply, eSimLinkServerToClient );
+		}
+
+		vReleaseNetworkBufferAndDescriptor( pxRequest );
+	}
+
+#endif /* ipconfigUSE_DHCP */
+/*-----------------------------------------------------------*/
@@ -0,0 +1,169 @@
+/*
+FreeRTOS+TCP V2.0.10
+Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ http://aws.amazon.com/freertos
+ http://www.FreeRTOS.org
+*/
+
+#ifndef SIM_LINK_H
+#define SIM_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The simulated link is a NetworkInterface that does not need any hardware.
+ * The IP-stack is connected through an emulated cable to a virtual peer which
+ * reflects every frame back to the stack, so that a client socket and a server
+ * socket bound to the local IP address talk to each other across the emulated
+ * link.  Each direction of the cable is an independent pipe with its own
+ * latency, bandwidth, loss and reordering properties.  All random decisions
+ * are taken from a seeded pseudo random generator, so a run can be repeated.
+ *
+ * A TCP or UDP frame travels through the eSimLinkServerToClient pipe when its
+ * source port is lower than its destination port, i.e. when it is sent by the
+ * side that owns the well-known port.  All other frames, including ARP and
+ * ICMP, travel through the eSimLinkClientToServer pipe.
+ *
+ * When ipconfigUSE_DHCP is enabled, the peer also runs a minimal DHCP server.
+ * Messages from the DHCP client travel through the eSimLinkClientToServer pipe
+ * and the answers come back through the eSimLinkServerToClient pipe, so the
+ * time needed to obtain an address depends on the properties of the link.
+ */
+
+/* The maximum number of frames that can be in flight in both pipes together. */
+#ifndef ipconfigSIM_LINK_QUEUE_LENGTH
+	#define ipconfigSIM_LINK_QUEUE_LENGTH		( ipconfigNUM_NETWORK_BUFFER_DESCRIPTORS / 2 )
+#endif
+
+/* The priority of the task that delivers frames once their delay has expired.
+It should not be lower than the priority of the IP-task. */
+#ifndef ipconfigSIM_LINK_TASK_PRIORITY
+	#define ipconfigSIM_LINK_TASK_PRIORITY		( ipconfigIP_TASK_PRIORITY )
+#endif
+
+#ifndef ipconfigSIM_LINK_TASK_STACK_SIZE_WORDS
+	#define ipconfigSIM_LINK_TASK_STACK_SIZE_WORDS	( configMINIMAL_STACK_SIZE * 4 )
+#endif
+
+/* The seed used by the pseudo random generator after start-up. */
+#ifndef ipconfigSIM_LINK_DEFAULT_SEED
+	#define ipconfigSIM_LINK_DEFAULT_SEED		( 0x1234567UL )
+#endif
+
+/* The lease time that the virtual DHCP server grants by default. */
+#ifndef ipconfigSIM_LINK_DHCP_LEASE_SECONDS
+	#define ipconfigSIM_LINK_DHCP_LEASE_SECONDS	( 3600UL )
+#endif
+
+typedef enum eSIM_LINK_DIRECTION
+{
+	eSimLinkClientToServer = 0,
+	eSimLinkServerToClient,
+	eSimLinkDirections
+} eSimLinkDirection_t;
+
+typedef struct xSIM_LINK_PARAMETERS
+{
+	uint32_t ulLatencyMS;		/* One-way propagation delay. */
+	uint32_t ulBandwidthBPS;	/* Bits per second, zero means unlimited. */
+	uint32_t ulLossPPM;			/* Chance, in parts per million, that a frame gets lost. */
+	uint32_t ulReorderPPM;		/* Chance, in parts per million, that a frame gets held back. */
+	uint32_t ulReorderDelayMS;	/* Extra delay of a frame that is held back, allowing later frames to overtake it. */
+	uint32_t ulQueueLimit;		/* Maximum number of frames in flight in this pipe, zero means no limit. */
+} SimLinkParameters_t;
+
+typedef struct xSIM_LINK_STATISTICS
+{
+	uint32_t ulFramesSent;		/* Frames handed to the pipe by the IP-stack. */
+	uint32_t ulFramesDelivered;	/* Frames passed back to the IP-task. */
+	uint32_t ulFramesLost;		/* Frames dropped because of ulLossPPM. */
+	uint32_t ulFramesOverflowed;/* Frames dropped because the pipe was full. */
+	uint32_t ulFramesReordered;	/* Frames held back because of ulReorderPPM. */
+	uint32_t ulBytesDelivered;
+} SimLinkStatistics_t;
+
+/*
+ * Change the properties of one direction of the link.  The new values apply to
+ * frames that are sent after the call.  By default a pipe is ideal: no delay,
+ * unlimited bandwidth and no losses.
+ */
+void vSimLinkSetParameters( eSimLinkDirection_t eDirection, const SimLinkParameters_t *pxParameters );
+
+/*
+ * Obtain a copy of the counters of one direction of the link.
+ */
+void vSimLinkGetStatistics( eSimLinkDirection_t eDirection, SimLinkStatistics_t *pxStatistics );
+
+/*
+ * Clear all counters and restart the pseudo random generator of both pipes
+ * with the given seed, so that a benchmark can be repeated exactly.
+ */
+void vSimLinkReset( uint32_t ulSeed );
+
+#if( ipconfigUSE_DHCP != 0 )
+	/* The behaviour of the virtual DHCP server.  All addresses are stored in
+	network byte order. */
+	typedef struct xSIM_LINK_DHCP_SERVER
+	{
+		BaseType_t xEnabled;			/* When pdFALSE, DHCP messages are lost. */
+		BaseType_t xRapidCommit;		/* Answer a DISCOVER with an ACK if the client asks for Rapid Commit. */
+		uint32_t ulServerAddress;		/* The server identifier. */
+		uint32_t ulOfferedAddress;		/* A REQUEST for any other address is answered with a NAK. */
+		uint32_t ulNetMask;
+		uint32_t ulGatewayAddress;
+		uint32_t ulDNSServerAddress;
+		uint32_t ulLeaseSeconds;
+		uint32_t ulAddressInUse;		/* Another host on the link answers an ARP probe for this address, zero for none. */
+	} SimLinkDHCPServer_t;
+
+	/* The DHCP messages that reached the virtual server, and its answers. */
+	typedef struct xSIM_LINK_DHCP_STATISTICS
+	{
+		uint32_t ulDiscovers;
+		uint32_t ulRequests;
+		uint32_t ulDeclines;
+		uint32_t ulOffers;
+		uint32_t ulAcks;
+		uint32_t ulNaks;
+	} SimLinkDHCPStatistics_t;
+
+	/*
+	 * Change or obtain the properties of the virtual DHCP server.  By default
+	 * the server hands out the static address that was passed to
+	 * FreeRTOS_IPInit(), with the gateway as server identifier.
+	 */
+	void vSimLinkSetDHCPServer( const SimLinkDHCPServer_t *pxServer );
+	void vSimLinkGetDHCPServer( SimLinkDHCPServer_t *pxServer );
+
+	/*
+	 * Obtain a copy of the DHCP message counters, they are cleared by
+	 * vSimLinkReset().
+	 */
+	void vSimLinkGetDHCPStatistics( SimLinkDHCPStatistics_t *pxStatistics );
+#endif /* ipconfigUSE_DHCP */
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SIM_LINK_H */
@@ -37,6 +37,7 @@
 
 /* MQTT lib includes. */
 #include "aws_mqtt_lib.h"
+#include "aws_mqtt_offline_spool.h"
 
 /* Library initialization definition include */
 #include "aws_lib_init.h"
@@ -76,8 +77,9 @@ typedef enum
  */
 typedef enum
 {
-    eMQTTAgentPublish,   /**< A Publish message was received from the broker. */
-    eMQTTAgentDisconnect /**< The connection to the broker got disconnected. */
+    eMQTTAgentPublish,      /**< A Publish message was received from the broker. */
+    eMQTTAgentDisconnect,   /**< The connection to the broker got disconnected. */
+    eMQTTAgentPublishChunk  /**< A chunk of a Publish message too large for a buffer was received from the broker. */
 } MQTTAgentEvent_t;
 
 /**
@@ -93,7 +95,10 @@ typedef struct MQTTAgentCallbackParams
     /* This union is here for future support. */
     union
     {
-        MQTTPublishData_t xPublishData; /**< Publish data. Meaningful only in case of eMQTTAgentPublish event. */
+        MQTTPublishData_t xPublishData;                   /**< Publish data. Meaningful only in case of eMQTTAgentPublish event. */
+        #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+            MQTTPublishChunkData_t xPublishChunkData; /**< Publish chunk data. Meaningful only in case of eMQTTAgentPublishChunk event. @see MQTTPublishChunkData_t. */
+        #endif
     } u;
 } MQTTAgentCallbackParams_t;
 
@@ -186,6 +191,39 @@ typedef struct MQTTAgentPublishParams
     uint32_t ulDataLength;    /**< Length of the data. */
 } MQTTAgentPublishParams_t;
 
+/**
+ * @brief Signature of the callback invoked when a publish operation initiated with
+ * MQTT_AGENT_PublishAsync completes.
+ *
+ * The callback is invoked from the MQTT task and therefore must not block. It may
+ * initiate another asynchronous publish operation.
+ *
+ * @param[in] pvCompletionContext The context as provided to MQTT_AGENT_PublishAsync.
+ * @param[in] xReturnCode eMQTTAgentSuccess if the message was sent (QoS0) or acknowledged
+ * (QoS1 and QoS2), eMQTTAgentTimeout if it timed out, eMQTTAgentFailure to indicate any
+ * other failure.
+ */
+typedef void ( * MQTTAgentCompletionCallback_t ) ( void * pvCompletionContext,
+                                                   MQTTAgentReturnCode_t xReturnCode );
+
+/**
+ * @brief Depth and counters of the offline publish queue of a client, as
+ * returned by MQTT_AGENT_GetOfflineQueueStats.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTAgentOfflineQueueStats
+    {
+        uint32_t ulQueuedMessages;     /**< Number of messages in the queue, in RAM and in the spool. */
+        uint32_t ulQueuedBytes;        /**< Number of topic and data bytes in the queue. */
+        uint32_t ulSpooledMessages;    /**< Number of messages in the spool. */
+        uint32_t ulPeakQueuedMessages; /**< Highest value of ulQueuedMessages since the client was created. */
+        uint32_t ulDroppedMessages;    /**< Number of messages which could not be queued or published from the queue. */
+        uint32_t ulReplayedMessages;   /**< Number of messages published from the queue. */
+    } MQTTAgentOfflineQueueStats_t;
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
 /**
  * @brief MQTT library Init function.
  *
@@ -333,12 +371,50 @@ MQTTAgentReturnCode_t MQTT_AGENT_Unsubscribe( MQTTAgentHandle_t xMQTTHandle,
  * macro to convert milliseconds to ticks.
  *
  * @return eMQTTAgentSuccess if the publish operation succeeds, otherwise an error code explaining
- * the reason of the failure is returned.
+ * the reason of the failure is returned. A QoS1 or QoS2 publish only succeeds once the broker
+ * acknowledged the message, and therefore fails while the client is not connected even if an
+ * offline queue is available (see MQTT_AGENT_SetOfflineSpool). A QoS0 one succeeds once the
+ * message is sent or, while the client is not connected, queued.
  */
 MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
                                           const MQTTAgentPublishParams_t * const pxPublishParams,
                                           TickType_t xTimeoutTicks );
 
+/**
+ * @brief Publishes a message to a given topic without waiting for the operation to complete.
+ *
+ * The message is handed over to the MQTT task and the function returns without waiting
+ * for the message to be sent or acknowledged, so that the calling task can keep several
+ * QoS1 and QoS2 messages outstanding. The result of the operation is reported to the
+ * completion callback instead. Unlike MQTT_AGENT_Publish, this function does not alter
+ * the calling task's notification state and value.
+ *
+ * At most mqttconfigMAX_ASYNC_PUBLISHES operations, for all the clients together, can be
+ * in progress at any one time. The number of unacknowledged messages is also limited by
+ * the buffers available to the core MQTT library.
+ *
+ * @warning The parameters are copied, but the topic and the data they point to must
+ * remain valid until the completion callback is invoked.
+ *
+ * @param[in] xMQTTHandle The opaque handle as returned from MQTT_AGENT_Create.
+ * @param[in] pxPublishParams Publish parameters.
+ * @param[in] pxCompletionCallback The callback to invoke when the operation completes. Can be NULL.
+ * @param[in] pvCompletionContext Passed as it is to the completion callback. Can be NULL.
+ * @param[in] xTimeoutTicks Maximum time in ticks after which the operation should fail. The same
+ * time is also used to wait for space in the command queue. Use pdMS_TO_TICKS macro to convert
+ * milliseconds to ticks.
+ *
+ * @return eMQTTAgentSuccess if the operation was initiated, in which case the completion callback
+ * will be invoked exactly once. eMQTTAgentFailure if mqttconfigMAX_ASYNC_PUBLISHES operations are
+ * already in progress or the command could not be posted to the MQTT task, in which case the
+ * completion callback is not invoked.
+ */
+MQTTAgentReturnCode_t MQTT_AGENT_PublishAsync( MQTTAgentHandle_t xMQTTHandle,
+                                               const MQTTAgentPublishParams_t * const pxPublishParams,
+                                               MQTTAgentCompletionCallback_t pxCompletionCallback,
+                                               void * pvCompletionContext,
+                                               TickType_t xTimeoutTicks );
+
 /**
  * @brief Returns the buffer provided in the publish callback.
  *
@@ -356,4 +432,51 @@ MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
 MQTTAgentReturnCode_t MQTT_AGENT_ReturnBuffer( MQTTAgentHandle_t xMQTTHandle,
                                                MQTTBufferHandle_t xBufferHandle );
 
+/**
+ * @brief Supplies the spool of the offline publish queue of a client.
+ *
+ * The messages published with MQTT_AGENT_PublishAsync while the client is not connected
+ * are queued and the operations succeed once the message is queued, whatever their QoS.
+ * Only the QoS0 messages published with MQTT_AGENT_Publish are queued: a QoS1 or QoS2
+ * one still fails while the client is not connected, so that eMQTTAgentSuccess always
+ * means the broker acknowledged it. While the queued messages are published after a
+ * reconnect, such a message is sent ahead of them.
+ *
+ * The messages are queued in RAM first (see mqttconfigOFFLINE_QUEUE_RAM_BLOCKS) and then
+ * in the spool, and are published in order once the client is connected again. The
+ * messages already in the region of the spool, for example from before a reset, are
+ * published as well.
+ *
+ * Must be called after MQTT_AGENT_Create and before the client is connected or any
+ * message is published.
+ *
+ * @param[in] xMQTTHandle The opaque handle as returned from MQTT_AGENT_Create.
+ * @param[in] pxFlash The region of the spool, for example a flash partition or the file
+ * returned by MQTT_OfflineFileFlashOpen. It must remain valid as long as the client
+ * exists.
+ *
+ * @return eMQTTAgentSuccess.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTAgentReturnCode_t MQTT_AGENT_SetOfflineSpool( MQTTAgentHandle_t xMQTTHandle,
+                                                      const MQTTOfflineFlashInterface_t * const pxFlash );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Returns the depth and counters of the offline publish queue of a client.
+ *
+ * @param[in] xMQTTHandle The opaque handle as returned from MQTT_AGENT_Create.
+ * @param[out] pxStats The depth and counters of the queue.
+ *
+ * @return eMQTTAgentSuccess.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTAgentReturnCode_t MQTT_AGENT_GetOfflineQueueStats( MQTTAgentHandle_t xMQTTHandle,
+                                                           MQTTAgentOfflineQueueStats_t * const pxStats );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
 #endif /* _AWS_MQTT_AGENT_H_ */
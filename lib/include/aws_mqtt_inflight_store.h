@@ -0,0 +1,154 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file aws_mqtt_inflight_store.h
+ * @brief In-flight stores for the MQTT Core Library.
+ *
+ * Implements MQTTInflightStoreInterface_t on top of a user supplied memory
+ * region which is used as a ring log, and on top of a flash-like region
+ * (see MQTTOfflineFlashInterface_t) which is written as a log of erase
+ * blocks. The flash store keeps the packets across a power cycle when the
+ * region is a flash partition or a file (see MQTT_OfflineFileFlashOpen).
+ */
+
+#ifndef _AWS_MQTT_INFLIGHT_STORE_H_
+#define _AWS_MQTT_INFLIGHT_STORE_H_
+
+/* MQTT Lib includes. */
+#include "aws_mqtt_lib.h"
+#include "aws_mqtt_offline_spool.h"
+
+/**
+ * @brief The RAM ring in-flight store.
+ *
+ * The stored packets are appended to the memory region supplied in
+ * MQTT_InflightRingStoreInit and the space they take is reused once all
+ * the packets stored before them have been acknowledged. The state of the
+ * log is kept in the memory region itself, so if the region is placed in
+ * memory which is not initialized at start up (and survives a warm reset),
+ * the stored packets survive the reset as well.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    typedef struct MQTTInflightRingStore
+    {
+        uint8_t * pucStorage;                    /**< The memory region holding the log. */
+        uint32_t ulStorageSize;                  /**< The size of the memory region. */
+        MQTTInflightStoreInterface_t xInterface; /**< The interface to supply in MQTTInitParams_t. */
+    } MQTTInflightRingStore_t;
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief The flash in-flight store.
+ *
+ * The stored packets are appended to the block at the tail of the log, and
+ * a packet is removed by clearing the state of its record, so bytes are
+ * only written once between two erases. A block is erased and reused only
+ * once all the packets in it have been removed, so a packet which is never
+ * acknowledged eventually fills the store. The state of the log is
+ * recovered from the region in MQTT_InflightFlashStoreInit.
+ *
+ * The region uses the flash interface of the offline spool, so the store
+ * needs mqttconfigENABLE_OFFLINE_QUEUE as well. It must not be shared with
+ * a spool.
+ *
+ * The members are private to aws_mqtt_inflight_store.c.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTInflightFlashStore
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash; /**< The region holding the log. */
+        uint8_t * pucBuffer;                         /**< Receives the packet read by the get function. */
+        uint32_t ulBufferSize;                       /**< The size of pucBuffer, which bounds the size of the packets. */
+        uint32_t ulHeadOffset;                       /**< Offset of the oldest packet. */
+        uint32_t ulTailOffset;                       /**< Offset at which the next packet is written. */
+        uint32_t ulNextSequence;                     /**< Sequence number of the next block used. */
+        uint32_t ulPackets;                          /**< Number of packets in the store. */
+        MQTTInflightStoreInterface_t xInterface;     /**< The interface to supply in MQTTInitParams_t. */
+    } MQTTInflightFlashStore_t;
+
+#endif /* ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+
+/**
+ * @brief Initializes the RAM ring in-flight store.
+ *
+ * If the memory region already contains a valid log (for example because
+ * it survived a warm reset), the packets in it are kept. Otherwise the log
+ * is emptied.
+ *
+ * @param[in] pxStore The store to initialize.
+ * @param[in] pucStorage The memory region to use. It must remain valid as
+ * long as the store is used.
+ * @param[in] ulStorageSize The size of the memory region. Each packet takes
+ * its length plus 8 bytes, rounded up to a multiple of 4.
+ * @param[in] ulResendTimeoutTicks The time interval in ticks to wait for the
+ * acknowledgment of a re-transmitted message.
+ *
+ * @return The interface to supply as pxInflightStore in MQTTInitParams_t.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    const MQTTInflightStoreInterface_t * MQTT_InflightRingStoreInit( MQTTInflightRingStore_t * pxStore,
+                                                                     uint8_t * pucStorage,
+                                                                     uint32_t ulStorageSize,
+                                                                     uint32_t ulResendTimeoutTicks );
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief Initializes the flash in-flight store and recovers the packets
+ * already in its region.
+ *
+ * Blocks which cannot be read or do not hold a valid log are considered
+ * erased.
+ *
+ * @param[in] pxStore The store to initialize.
+ * @param[in] pxFlash The region of the store. It must remain valid as long
+ * as the store is used.
+ * @param[in] pucBuffer The buffer which receives the packets read by the
+ * get function of the interface. It must remain valid as long as the store
+ * is used.
+ * @param[in] ulBufferSize The size of pucBuffer. Larger packets are not
+ * stored. A packet must also fit in a block with 16 bytes of headers.
+ * @param[in] ulResendTimeoutTicks The time interval in ticks to wait for the
+ * acknowledgment of a re-transmitted message.
+ *
+ * @return The interface to supply as pxInflightStore in MQTTInitParams_t.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    const MQTTInflightStoreInterface_t * MQTT_InflightFlashStoreInit( MQTTInflightFlashStore_t * pxStore,
+                                                                      const MQTTOfflineFlashInterface_t * pxFlash,
+                                                                      uint8_t * pucBuffer,
+                                                                      uint32_t ulBufferSize,
+                                                                      uint32_t ulResendTimeoutTicks );
+
+#endif /* ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+
+#endif /* _AWS_MQTT_INFLIGHT_STORE_H_ */
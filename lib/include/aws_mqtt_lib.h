@@ -81,7 +81,9 @@ typedef enum
     eMQTTNoFreeBuffer,               /**< No free buffer is available for the operation. */
     eMQTTSendFailed,                 /**< The registered send callback failed to transmit data. */
     eMQTTMalformedPacketReceived,    /**< A malformed packet was received. Client has been disconnected. The user must re-connect before carrying out any other operation. */
-    eMQTTSubscriptionManagerFull     /**< No space left in subscription manager to store any more subscriptions. */
+    eMQTTSubscriptionManagerFull,    /**< No space left in subscription manager to store any more subscriptions. */
+    eMQTTInflightStoreFull,          /**< No space left in the in-flight store to store the message. */
+    eMQTTReceiveMaximumExceeded      /**< The broker does not accept more QoS1 and QoS2 publish messages until the ones in flight are acknowledged (MQTT 5 only). */
 } MQTTReturnCode_t;
 
 /**
@@ -101,12 +103,14 @@ typedef enum
  * @brief The action taken on the message being received.
  *
  * If a large enough buffer is available to store the message, it
- * is stored, otherwise it is dropped.
+ * is stored, otherwise it is dropped - or streamed to the user in
+ * case of a publish message, if streaming receive is enabled.
  */
 typedef enum
 {
-    eMQTTRxMessageStore, /**< The message being received is being stored. */
-    eMQTTRxMessageDrop   /**< The message being received is being dropped. */
+    eMQTTRxMessageStore,  /**< The message being received is being stored. */
+    eMQTTRxMessageDrop,   /**< The message being received is being dropped. */
+    eMQTTRxMessageStream  /**< The publish message being received is being passed to the user in chunks. */
 } MQTTRxMessageAction_t;
 
 /**
@@ -123,6 +127,8 @@ typedef enum
     eMQTTUnexpectedConnACK,  /**< Unexpected CONNACK received. */
     eMQTTPubACK,             /**< PUBACK received. */
     eMQTTUnexpectedPubACK,   /**< Unexpected PUBACK received. */
+    eMQTTPubCOMP,            /**< PUBCOMP received i.e. a QoS2 publish is complete. */
+    eMQTTUnexpectedPubCOMP,  /**< Unexpected PUBCOMP received. */
     eMQTTSubACK,             /**< SUBACK received. */
     eMQTTUnexpectedSubACK,   /**< Unexpected SUBACK received. */
     eMQTTUnSubACK,           /**< UNSUBACK received. */
@@ -130,7 +136,8 @@ typedef enum
     eMQTTClientDisconnected, /**< Client has been disconnected. The user must re-connect before carrying out any other operation. */
     eMQTTPacketDropped,      /**< A packet was dropped because a large enough buffer was not available to store it. */
     eMQTTTimeout,            /**< Timeout detected - An expected ACK was not received within the specified time. */
-    eMQTTPingTimeout         /**< A PINGRESP was not received within the expected time. */
+    eMQTTPingTimeout,        /**< A PINGRESP was not received within the expected time. */
+    eMQTTPublishChunk        /**< A chunk of a publish message too large for a buffer from the buffer pool received from the broker. */
 } MQTTEventType_t;
 
 /**
@@ -144,7 +151,8 @@ typedef enum
     eMQTTDisconnectReasonMalformedPacket,         /**< The client was disconnected because a malformed packet was received. */
     eMQTTDisconnectReasonBrokerRefusedConnection, /**< The client was disconnected because broker refused the connection request. */
     eMQTTDisconnectReasonUserRequest,             /**< The client was disconnected on user request. */
-    eMQTTDisconnectReasonConnectTimeout           /**< The client was disconnected because an expected CONNACK was not received. */
+    eMQTTDisconnectReasonConnectTimeout,          /**< The client was disconnected because an expected CONNACK was not received. */
+    eMQTTDisconnectReasonBrokerRequest            /**< The client was disconnected because the broker sent a DISCONNECT (MQTT 5 only). */
 } MQTTDisconnectReason_t;
 
 /**
@@ -154,7 +162,7 @@ typedef enum
 {
     eMQTTQoS0 = 0, /**< Quality of Service 0 - Fire and Forget. No ACK. */
     eMQTTQoS1 = 1, /**< Quality of Service 1 - Wait till ACK or Timeout. */
-    eMQTTQoS2 = 2  /**< Quality of Service 2 - Not supported. */
+    eMQTTQoS2 = 2  /**< Quality of Service 2 - Wait till PUBCOMP or Timeout. */
 } MQTTQoS_t;
 
 /**
@@ -167,11 +175,27 @@ typedef enum
     eMQTTConnected             /**< Connected. */
 } MQTTConnectionState_t;
 
+/**
+ * @brief MQTT protocol versions.
+ *
+ * The version is selected per context in the Init parameters.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    typedef enum
+    {
+        eMQTTProtocolVersion311 = 4, /**< MQTT 3.1.1. */
+        eMQTTProtocolVersion5 = 5    /**< MQTT 5. */
+    } MQTTProtocolVersion_t;
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
 /**
  * @brief Return codes sent by the broker in the CONNACK message.
  *
  * The values in the following enum exactly correspond to the ones
- * received in the CONNACK packet and must not be changed.
+ * received in the CONNACK packet and must not be changed. The MQTT 5
+ * reason codes are converted to the closest of them.
  */
 typedef enum
 {
@@ -215,6 +239,10 @@ typedef struct MQTTConnACKData
 {
     MQTTConnACKReturnCode_t xConnACKReturnCode; /**< CONNACK return code. @see MQTTConnACKReturnCode_t. */
     uint16_t usPacketIdentifier;                /**< Packet identifier which the user can use to match the CONNACK with the Connect request. */
+    MQTTBool_t xSessionPresent;                 /**< Whether the broker has kept the session of a previous connection. Always eMQTTFalse if a clean session was requested. */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucReasonCode;                   /**< The return code or MQTT 5 reason code exactly as received. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTConnACKData_t;
 
 /**
@@ -225,6 +253,9 @@ typedef struct MQTTSubACKData
 {
     MQTTSubACKReturnCode_t xSubACKReturnCode; /**< SUBACK return code. @see MQTTSubACKReturnCode_t. */
     uint16_t usPacketIdentifier;              /**< Packet identifier which the user can use to match the SUBACK with the Subscribe request. */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucReasonCode;                 /**< The return code or MQTT 5 reason code exactly as received. Values of 0x80 and above are failures. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTSubACKData_t;
 
 /**
@@ -234,15 +265,24 @@ typedef struct MQTTSubACKData
 typedef struct MQTTUnSubACKData
 {
     uint16_t usPacketIdentifier; /**< Packet identifier which the user can use to match the UNSUBACK with the Unsubscribe request. */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucReasonCode;    /**< The MQTT 5 reason code, zero with MQTT 3.1.1. Values of 0x80 and above are failures. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTUnSubACKData_t;
 
 /**
  * @brief The data sent by the MQTT library in the user supplied callback
- * when a PUBACK message is received.
+ * when a PUBACK or PUBCOMP message is received.
  */
 typedef struct MQTTPubACKData
 {
-    uint16_t usPacketIdentifier; /**< Packet identifier which the user can use to match the PUBACK with the Publish request. */
+    uint16_t usPacketIdentifier; /**< Packet identifier which the user can use to match the PUBACK or PUBCOMP with the Publish request. */
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        const void * pvPublishData; /**< The payload passed to MQTT_PublishZeroCopy, which the library no longer references. NULL if the message was sent with MQTT_Publish. */
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucReasonCode;       /**< The MQTT 5 reason code, zero with MQTT 3.1.1. Values of 0x80 and above are failures. A QoS2 message refused in the PUBREC is completed with a PUBCOMP event carrying the reason code of the PUBREC. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTPubACKData_t;
 
 /**
@@ -256,9 +296,41 @@ typedef struct MQTTPublishData
     uint16_t usTopicLength;     /**< Length of the topic. */
     const void * pvData;        /**< The received message. */
     uint32_t ulDataLength;      /**< Length of the message. */
-    MQTTBufferHandle_t xBuffer; /**< The buffer containing the whole MQTT message. Both pcTopic and pvData are pointers to the locations in this buffer. */
+    MQTTBufferHandle_t xBuffer; /**< The buffer containing the whole MQTT message. Both pcTopic and pvData are pointers to the locations in this buffer, except that
+                                 *   pucTopic points to the topic alias map of the context if the broker sent a topic alias instead of the topic (MQTT 5 only), in
+                                 *   which case it is valid only until the callback returns. */
 } MQTTPublishData_t;
 
+/**
+ * @brief The data sent by the MQTT library in the user supplied callback
+ * when a chunk of a publish message is received.
+ *
+ * A publish message which does not fit in a buffer from the buffer pool is
+ * passed to the user as it arrives, if mqttconfigENABLE_STREAMING_RECEIVE is
+ * 1. The first chunk is always empty and only carries the topic. Each of the
+ * following ones carries the next part of the message, and the message is
+ * complete when ulOffset + ulDataLength reaches ulTotalDataLength. If the
+ * client is disconnected before that, the partial message must be discarded
+ * as the broker sends it again in full.
+ *
+ * pvData is never NULL, even in the empty chunk, so it can be passed with
+ * ulDataLength to functions such as memcpy() without a check.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+
+    typedef struct MQTTPublishChunkData
+    {
+        MQTTQoS_t xQos;             /**< Quality of Service (QoS). */
+        const uint8_t * pucTopic;   /**< The topic on which the message is received. */
+        uint16_t usTopicLength;     /**< Length of the topic. */
+        const void * pvData;        /**< This chunk of the message, never NULL. Valid only until the callback returns. */
+        uint32_t ulDataLength;      /**< Length of this chunk. */
+        uint32_t ulOffset;          /**< Offset of this chunk in the message. */
+        uint32_t ulTotalDataLength; /**< Length of the whole message. */
+    } MQTTPublishChunkData_t;
+
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+
 /**
  * @brief The data sent by the MQTT library in the user supplied callback
  * when an operation times out.
@@ -266,6 +338,9 @@ typedef struct MQTTPublishData
 typedef struct MQTTTimeoutData
 {
     uint16_t usPacketIdentifier; /**< Packet identifier which the user can use to identify which operation timed out. */
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        const void * pvPublishData; /**< The payload passed to MQTT_PublishZeroCopy if the operation is a publish sent with it, which the library no longer references. NULL otherwise. */
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
 } MQTTTimeoutData_t;
 
 /**
@@ -291,10 +366,13 @@ typedef struct MQTTCallbackParams
         MQTTConnACKData_t xMQTTConnACKData;   /**< CONNACK data. */
         MQTTSubACKData_t xMQTTSubACKData;     /**< SUBACK data. */
         MQTTUnSubACKData_t xMQTTUnSubACKData; /**< UNSUBACK data. */
-        MQTTPubACKData_t xMQTTPubACKData;     /**< PUBACK data. */
+        MQTTPubACKData_t xMQTTPubACKData;     /**< PUBACK and PUBCOMP data. */
         MQTTPublishData_t xPublishData;       /**< Publish data. */
         MQTTTimeoutData_t xTimeoutData;       /**< Timeout data. */
         MQTTDisconnectData_t xDisconnectData; /**< Disconnect data. */
+        #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+            MQTTPublishChunkData_t xPublishChunkData; /**< Publish chunk data. */
+        #endif
     } u;
 } MQTTEventCallbackParams_t;
 
@@ -369,6 +447,43 @@ typedef uint32_t ( * MQTTSend_t ) ( void * pvSendContext,
                                     const uint8_t * const pucData,
                                     uint32_t ulDataLength );
 
+/**
+ * @brief One part of the data passed to MQTTSendVectored_t.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+    typedef struct MQTTSendVector
+    {
+        const uint8_t * pucData; /**< The data to transmit. */
+        uint32_t ulDataLength;   /**< The length of the data. */
+    } MQTTSendVector_t;
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
+/**
+ * @brief Signature of the user supplied callback to transmit data which is
+ * split in several parts.
+ *
+ * The library uses it to transmit the header and the payload of a message
+ * sent with MQTT_PublishZeroCopy without copying them together first. The
+ * parts must be transmitted in order, as if they were one contiguous block
+ * of data, ideally with a single call to a scatter-gather send function of
+ * the network stack.
+ *
+ * @param[in] pvSendContext The send context as supplied by the user in Init parameters.
+ * @param[in] pxVectors The parts of the data to transmit.
+ * @param[in] ulVectorCount The number of parts.
+ *
+ * @return The total number of bytes actually transmitted.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+    typedef uint32_t ( * MQTTSendVectored_t ) ( void * pvSendContext,
+                                                const MQTTSendVector_t * const pxVectors,
+                                                uint32_t ulVectorCount );
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
 /**
  * @brief Signature of the callback to get the current tick count.
  *
@@ -411,36 +526,186 @@ typedef uint8_t * ( * MQTTGetFreeBuffer_t ) ( uint32_t * pulBufferLength );
 typedef void ( * MQTTReturnBuffer_t ) ( uint8_t * pucBuffer );
 
 /**
- * @brief Represents a subscription entry in the subscription manager.
+ * @brief Signature of the callback supplied by the user as part of
+ * MQTTInflightStoreInterface_t to store an unacknowledged message.
+ *
+ * The library calls it with the complete PUBLISH packet before a QoS1 or
+ * QoS2 publish message is transmitted and with the PUBREL packet when the
+ * PUBREC for a QoS2 publish message is received. A packet with the same
+ * packet identifier which is already in the store must be replaced.
+ *
+ * @param[in] pvStoreContext The store context as supplied in the interface.
+ * @param[in] usPacketIdentifier The packet identifier of the message.
+ * @param[in] pucPacket The packet to store.
+ * @param[in] ulPacketLength The length of the packet.
+ *
+ * @return eMQTTTrue if the packet was stored, eMQTTFalse if there is no
+ * space left in the store.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    typedef MQTTBool_t ( * MQTTInflightStorePut_t ) ( void * pvStoreContext,
+                                                      uint16_t usPacketIdentifier,
+                                                      const uint8_t * pucPacket,
+                                                      uint32_t ulPacketLength );
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief Signature of the callback supplied by the user as part of
+ * MQTTInflightStoreInterface_t to remove a message from the store.
+ *
+ * The library calls it when the PUBACK or PUBCOMP for the message is
+ * received. Removing a packet identifier which is not in the store must
+ * have no effect.
+ *
+ * @param[in] pvStoreContext The store context as supplied in the interface.
+ * @param[in] usPacketIdentifier The packet identifier of the message.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    typedef void ( * MQTTInflightStoreRemove_t ) ( void * pvStoreContext,
+                                                   uint16_t usPacketIdentifier );
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief Signature of the callback supplied by the user as part of
+ * MQTTInflightStoreInterface_t to read the stored messages.
+ *
+ * The library calls it with ulIndex starting from zero to retrieve all the
+ * messages in the store, in the order they were stored, whenever a new
+ * connection to the broker is established. The returned packet must remain
+ * valid until the next call to any of the store callbacks.
+ *
+ * @param[in] pvStoreContext The store context as supplied in the interface.
+ * @param[in] ulIndex The index of the message to retrieve.
+ * @param[out] pusPacketIdentifier The packet identifier of the message.
+ * @param[out] ppucPacket The stored packet.
+ * @param[out] pulPacketLength The length of the stored packet.
+ *
+ * @return eMQTTTrue if a message was retrieved, eMQTTFalse if ulIndex is
+ * past the last message in the store.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    typedef MQTTBool_t ( * MQTTInflightStoreGet_t ) ( void * pvStoreContext,
+                                                      uint32_t ulIndex,
+                                                      uint16_t * pusPacketIdentifier,
+                                                      const uint8_t ** ppucPacket,
+                                                      uint32_t * pulPacketLength );
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief The in-flight store interface supplied by the user.
+ *
+ * The library keeps the QoS1 and QoS2 messages it transmits in this store
+ * until the broker acknowledges them, and re-transmits the stored messages
+ * whenever a new connection to the broker is established. A message is only
+ * removed from the store on acknowledgment - an operation timeout or a
+ * disconnect does not remove it. The store can therefore be placed in memory
+ * which survives a reset (such as flash) to survive reboots too.
+ *
+ * @note Since the stored messages are re-transmitted with their original
+ * packet identifiers, the packet identifiers used for new messages must not
+ * collide with the ones in the store.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    typedef struct MQTTInflightStoreInterface
+    {
+        void * pvStoreContext;                 /**< Passed as it is in the store callbacks. */
+        MQTTInflightStorePut_t pxPutFxn;       /**< The function to store a message. @see MQTTInflightStorePut_t. */
+        MQTTInflightStoreRemove_t pxRemoveFxn; /**< The function to remove a message. @see MQTTInflightStoreRemove_t. */
+        MQTTInflightStoreGet_t pxGetFxn;       /**< The function to read the stored messages. @see MQTTInflightStoreGet_t. */
+        uint32_t ulResendTimeoutTicks;         /**< The time interval in ticks to wait for the acknowledgment of a re-transmitted message. */
+    } MQTTInflightStoreInterface_t;
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+/**
+ * @brief Represents one level of a topic filter in the subscription manager.
+ *
+ * The subscription manager stores topic filters in a trie with one node per
+ * topic level. Nodes for a named level are found through a hash table keyed
+ * on the parent node and the level name, while the '+' and '#' wild-card
+ * levels are linked directly from their parent. A subscription is stored in
+ * the node of the last level of its topic filter.
  */
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
-    typedef struct MQTTSubscription
+    typedef struct MQTTTopicNode
     {
-        uint8_t ucTopicFilter[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH ]; /**< The topic filter this subscription entry is for. */
-        uint16_t usTopicFilterLength;                                             /**< The length of the topic filter. */
-        void * pvPublishCallbackContext;                                          /**< The callback context supplied by the user while subscribing. */
-        MQTTPublishCallback_t pxPublishCallback;                                  /**< The callback associated with this subscription. */
-        MQTTBool_t xInUse;                                                        /**< Tracks whether the subscription entry is in-use. */
-        MQTTTopicFilterType_t xTopicFilterType;                                   /**< The type of the topic filter. */
-    } MQTTSubscription_t;
+        uint16_t usParent;                       /**< The node of the previous level, mqttSUBSCRIPTION_NO_NODE for the first level. */
+        uint16_t usNext;                         /**< The next node in the same hash bucket, or in the free list. */
+        uint16_t usPlusChild;                    /**< The '+' level below this one, if any. */
+        uint16_t usHashChild;                    /**< The '#' level below this one, if any. */
+        uint16_t usLevelName;                    /**< The interned level name, mqttSUBSCRIPTION_NO_LEVEL_NAME for wild-cards. */
+        uint16_t usHash;                         /**< Hash of the parent node and the level name. */
+        uint16_t usReferences;                   /**< Number of child nodes plus one if a subscription is stored here. */
+        MQTTBool_t xSubscribed;                  /**< Whether a topic filter ends at this level. */
+        void * pvPublishCallbackContext;         /**< The callback context supplied by the user while subscribing. */
+        MQTTPublishCallback_t pxPublishCallback; /**< The callback associated with this subscription. */
+    } MQTTTopicNode_t;
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief A level name stored once in the string pool of the subscription
+ * manager, shared by all the nodes with the same level name.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    typedef struct MQTTTopicLevelName
+    {
+        uint16_t usOffset;     /**< Offset of the name in the string pool. */
+        uint16_t usLength;     /**< Length of the name, which can be zero. */
+        uint16_t usReferences; /**< Number of nodes using this name, zero if the entry is free. */
+    } MQTTTopicLevelName_t;
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
 /**
  * @brief The subscription manager used to keep track of user subscriptions
  * and topic specific callbacks.
+ *
+ * All the topic filters share the node, level name and string pools, so the
+ * number of subscriptions which can be stored depends on the number of levels
+ * of the topic filters and on how many of them they have in common.
  */
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
     typedef struct MQTTSubscriptionManager
     {
-        MQTTSubscription_t xSubscriptions[ mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ]; /**< User subscriptions. */
-        uint32_t ulInUseSubscriptions;                                                         /**< Number of subscription entries currently in use. */
+        MQTTTopicNode_t xNodes[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES ];               /**< The pool of trie nodes. */
+        MQTTTopicLevelName_t xLevelNames[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES ];     /**< The interned level names. */
+        uint16_t usBuckets[ mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS ];                     /**< Heads of the hash chains of named levels. */
+        uint8_t ucStringPool[ mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE ];               /**< Storage for the level names. */
+        uint16_t usStringPoolUsed;                                                             /**< Number of bytes in use in ucStringPool. */
+        uint16_t usFreeNodes;                                                                  /**< Head of the list of free nodes. */
+        uint16_t usRootPlusChild;                                                              /**< The '+' node of the first level, if any. */
+        uint16_t usRootHashChild;                                                              /**< The '#' node of the first level, if any. */
+        uint32_t ulInUseSubscriptions;                                                         /**< Number of subscriptions currently stored. */
     } MQTTSubscriptionManager_t;
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
+/**
+ * @brief A topic alias of an MQTT 5 connection.
+ *
+ * The alias number is the index of the entry in the alias map plus one.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    typedef struct MQTTTopicAlias
+    {
+        uint16_t usTopicLength;                                    /**< Length of the topic, zero if the alias is not assigned. */
+        uint8_t ucTopic[ mqttconfigTOPIC_ALIAS_MAX_TOPIC_LENGTH ]; /**< The topic the alias stands for. */
+    } MQTTTopicAlias_t;
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
 /**
  * @brief The buffer pool interface supplied by the user.
  *
@@ -462,6 +727,11 @@ typedef struct MQTTRxMessageState
     MQTTRxMessageAction_t xRxMessageAction; /**< Whether the current Rx message is being stored or dropped. Valid only after the fixed header has been received i.e. xRxNextByte is eMQTTRxNextByteMessage. @see MQTTRxMessageAction_t. */
     uint8_t ucRemaingingLengthFieldBytes;   /**< The number of bytes the "Remaining Length" field spans. Valid only after the fixed header has been received i.e. xRxNextByte is eMQTTRxNextByteMessage. */
     uint32_t ulTotalMessageLength;          /**< The total length of the message. Valid only after the fixed header has been received i.e. xRxNextByte is eMQTTRxNextByteMessage. */
+    #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+        MQTTPublishChunkData_t xStreamData; /**< The publish message being streamed. pucTopic is NULL until the topic has been received. Valid only if xRxMessageAction is eMQTTRxMessageStream. */
+        uint16_t usStreamPacketIdentifier;  /**< Packet identifier of the publish message being streamed. Valid only if xRxMessageAction is eMQTTRxMessageStream. */
+        MQTTBool_t xStreamDuplicate;        /**< Whether the publish message being streamed is a re-transmission of a QoS2 message already passed to the user. Valid only if xRxMessageAction is eMQTTRxMessageStream. */
+    #endif /* mqttconfigENABLE_STREAMING_RECEIVE */
 } MQTTRxMessageState_t;
 
 /**
@@ -481,6 +751,9 @@ typedef struct MQTTContext
     MQTTEventCallback_t pxCallback;                             /**< Callback supplied  by the user to get notified of various events. */
     void * pvSendContext;                                       /**< As supplied by the user in Init parameters. */
     MQTTSend_t pxMQTTSendFxn;                                   /**< Callback supplied by the user to transmit data. */
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        MQTTSendVectored_t pxMQTTSendVectoredFxn;               /**< Callback supplied by the user to transmit data split in several parts, or NULL. */
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
     MQTTGetTicks_t pxGetTicksFxn;                               /**< Callback supplied by the user to get current tick count. */
     MQTTBufferPoolInterface_t xBufferPoolInterface;             /**< The buffer pool interface supplied by the user. @see MQTTBufferPoolInterface_t. */
     MQTTConnectionState_t xConnectionState;                     /**< The current connection state. */
@@ -489,9 +762,20 @@ typedef struct MQTTContext
     uint32_t ulKeepAliveActualIntervalTicks;                    /**< The time interval in ticks after which a keep alive message should be sent. */
     uint32_t ulPingRequestTimeoutTicks;                         /**< The time interval in ticks to wait for PINGRESP after sending PINGREQ. */
     MQTTBool_t xWaitingForPingResp;                             /**< Whether a keep alive message has been sent and we are waiting for response from the broker. */
+    uint16_t usQoS2ReceivedPacketIdentifiers[ mqttconfigMAX_QOS2_RECEIVED_PUBLISHES ]; /**< Packet identifiers of the received QoS2 publish messages waiting for PUBREL. Zero marks a free entry. */
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        const MQTTInflightStoreInterface_t * pxInflightStore;   /**< The in-flight store supplied by the user, or NULL. @see MQTTInflightStoreInterface_t. */
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
     #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
         MQTTSubscriptionManager_t xSubscriptionManager;         /**< The subscription manager used to keep track of user subscriptions and topic specific callbacks.*/
     #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProtocolVersion_t xProtocolVersion;                 /**< As supplied by the user in Init parameters. */
+        uint16_t usServerReceiveMaximum;                        /**< Number of QoS1 and QoS2 publish messages the broker accepts in flight, as sent in the CONNACK. */
+        uint16_t usServerTopicAliasMaximum;                     /**< Number of topic aliases the broker accepts, as sent in the CONNACK. */
+        MQTTTopicAlias_t xTxTopicAliases[ mqttconfigTOPIC_ALIAS_MAXIMUM ]; /**< The topic aliases assigned by the client to the topics it publishes on. */
+        MQTTTopicAlias_t xRxTopicAliases[ mqttconfigTOPIC_ALIAS_MAXIMUM ]; /**< The topic aliases assigned by the broker to the topics of the messages it sends. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTContext_t;
 
 /**
@@ -505,8 +789,17 @@ typedef struct MQTTInitParams
     MQTTEventCallback_t pxCallback;                 /**< User supplied callback to get notified of various events. Can be NULL. @see MQTTEventCallback_t.*/
     void * pvSendContext;                           /**< Passed as it is in the send callback. */
     MQTTSend_t pxMQTTSendFxn;                       /**< User supplied callback to transmit data. Must not be NULL. @see MQTTSend_t. */
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        MQTTSendVectored_t pxMQTTSendVectoredFxn;   /**< User supplied callback to transmit data split in several parts. Can be NULL, in which case pxMQTTSendFxn is called for each part. @see MQTTSendVectored_t. */
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
     MQTTGetTicks_t pxGetTicksFxn;                   /**< User supplied callback to get the current tick count. Can be NULL. @see MQTTGetTicks_t. */
     MQTTBufferPoolInterface_t xBufferPoolInterface; /**< User supplied buffer pool interface. @see MQTTBufferPoolInterface_t. */
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        const MQTTInflightStoreInterface_t * pxInflightStore; /**< User supplied in-flight store. Can be NULL. The interface must remain valid as long as the context is used. @see MQTTInflightStoreInterface_t. */
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProtocolVersion_t xProtocolVersion;               /**< The protocol version used on the connections of the context. @see MQTTProtocolVersion_t. */
+    #endif /* mqttconfigENABLE_MQTT5 */
 } MQTTInitParams_t;
 
 /**
@@ -525,6 +818,7 @@ typedef struct MQTTConnectParams
     uint16_t usUserNameLength;               /**< The length of the user name. */
     uint16_t usPacketIdentifier;             /**< The same identifier is returned in the callback when corresponding CONNACK is received or the operation times out. */
     uint32_t ulTimeoutTicks;                 /**< The time interval in ticks after which the operation should fail. */
+    MQTTBool_t xPersistentSession;           /**< Whether the broker should keep the session (i.e. the Clean Session flag is cleared). Needed for the broker to resume the QoS2 exchanges of a previous connection. */
 } MQTTConnectParams_t;
 
 /**
@@ -573,7 +867,7 @@ typedef struct MQTTPublishParams
     MQTTQoS_t xQos;              /**< Quality of Service. */
     const void * pvData;         /**< The data to publish. */
     uint32_t ulDataLength;       /**< Length of the data. */
-    uint16_t usPacketIdentifier; /**< The same identifier is returned in the callback when corresponding PUBACK is received or the operation times out. */
+    uint16_t usPacketIdentifier; /**< The same identifier is returned in the callback when corresponding PUBACK (or PUBCOMP for QoS2) is received or the operation times out. */
     uint32_t ulTimeoutTicks;     /**< The time interval in ticks after which the operation should fail. */
 } MQTTPublishParams_t;
 
@@ -596,7 +890,9 @@ MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
  *
  * Prepares and transmits an MQTT connect message and puts the packet on the
  * waiting ACK list which is removed when the corresponding CONNACK is received
- * or the operation times out.
+ * or the operation times out. Once the broker accepts the connection, all the
+ * messages in the in-flight store (if one was supplied in the Init parameters)
+ * are re-transmitted.
  *
  * @param[in] pxMQTTContext The initialized MQTT context.
  * @param[in] pxConnectParams Connect parameters.
@@ -675,7 +971,20 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
  *
  * Prepares and transmits an MQTT publish message. In non QoS0 case, puts the
  * packet on the waiting ACK list which is removed when the corresponding PUBACK
- * is received or the operation times out.
+ * is received or the operation times out. In QoS2 case, the packet is replaced
+ * by a PUBREL when the PUBREC is received and is removed when the corresponding
+ * PUBCOMP is received or the operation times out.
+ *
+ * If an in-flight store was supplied in the Init parameters, QoS1 and QoS2
+ * messages are stored before being transmitted and eMQTTInflightStoreFull is
+ * returned if there is no space left in the store.
+ *
+ * With MQTT 5, the topic is replaced with a topic alias once the alias has
+ * been sent along with the topic, as long as the broker accepts enough
+ * aliases. Messages put in the in-flight store always carry the topic, as
+ * aliases do not outlive the connection. eMQTTReceiveMaximumExceeded is
+ * returned for a QoS1 or QoS2 message if the broker already has as many of
+ * them in flight as it accepts.
  *
  * @param[in] pxMQTTContext The initialized MQTT context.
  * @param[in] pxPublishParams Publish parameters.
@@ -685,6 +994,38 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
 MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
                                const MQTTPublishParams_t * const pxPublishParams );
 
+/**
+ * @brief Initiates the Publish operation without copying the payload.
+ *
+ * Same as MQTT_Publish except that only the fixed and variable headers of
+ * the message are written into a buffer obtained from the buffer pool. The
+ * header and the payload are then transmitted together with the
+ * pxMQTTSendVectoredFxn callback (or with one call to pxMQTTSendFxn for each
+ * of them, if pxMQTTSendVectoredFxn is NULL). The buffer pool therefore does
+ * not need buffers as large as the largest message.
+ *
+ * In QoS0 case, the payload is not referenced after this function returns.
+ * Otherwise, the library holds a reference to it until the corresponding
+ * PUBACK (or PUBCOMP in case of QoS2) is received, the operation times out or
+ * the client is disconnected, and the user must not modify or free it until
+ * then. The payload is returned in pvPublishData of the PUBACK, PUBCOMP and
+ * timeout events, so that the user can release it from the event callback.
+ *
+ * @note The messages sent with this function are not put in the in-flight
+ * store, as storing them would need a copy of the payload.
+ *
+ * @param[in] pxMQTTContext The initialized MQTT context.
+ * @param[in] pxPublishParams Publish parameters.
+ *
+ * @return eMQTTSuccess if everything succeeds, otherwise an error code explaining the reason of failure.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+    MQTTReturnCode_t MQTT_PublishZeroCopy( MQTTContext_t * pxMQTTContext,
+                                           const MQTTPublishParams_t * const pxPublishParams );
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
 /**
  * @brief Decodes the incoming messages.
  *
@@ -0,0 +1,304 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file aws_mqtt_offline_spool.h
+ * @brief Log-structured spool of publish messages waiting for a connection.
+ *
+ * The MQTT agent queues the messages published while it is disconnected in
+ * a spool and publishes them in order once connected again. A spool is a log
+ * written in the blocks of a flash-like region (see
+ * MQTTOfflineFlashInterface_t). A RAM region, a file on hosted builds or a
+ * real flash partition can be used as the region.
+ */
+
+#ifndef _AWS_MQTT_OFFLINE_SPOOL_H_
+#define _AWS_MQTT_OFFLINE_SPOOL_H_
+
+/* MQTT Lib includes. */
+#include "aws_mqtt_lib.h"
+
+/**
+ * @brief Signature of the function reading from the region of a spool.
+ *
+ * @param[in] pvFlashContext The context as supplied in
+ * MQTTOfflineFlashInterface_t.
+ * @param[in] ulOffset The offset to read from.
+ * @param[out] pucData The buffer to read into.
+ * @param[in] ulLength The number of bytes to read.
+ *
+ * @return eMQTTTrue if the bytes were read, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    typedef MQTTBool_t ( * MQTTOfflineFlashRead_t )( void * pvFlashContext,
+                                                     uint32_t ulOffset,
+                                                     uint8_t * pucData,
+                                                     uint32_t ulLength );
+#endif
+
+/**
+ * @brief Signature of the function writing to the region of a spool.
+ *
+ * The spool only writes bytes which have been erased since they were last
+ * written, except for the state byte of a record which it writes twice,
+ * each time clearing bits only. So NOR flash which can program single bytes
+ * can be written directly.
+ *
+ * @param[in] pvFlashContext The context as supplied in
+ * MQTTOfflineFlashInterface_t.
+ * @param[in] ulOffset The offset to write at.
+ * @param[in] pucData The bytes to write.
+ * @param[in] ulLength The number of bytes to write.
+ *
+ * @return eMQTTTrue if the bytes were written, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    typedef MQTTBool_t ( * MQTTOfflineFlashWrite_t )( void * pvFlashContext,
+                                                      uint32_t ulOffset,
+                                                      const uint8_t * pucData,
+                                                      uint32_t ulLength );
+#endif
+
+/**
+ * @brief Signature of the function erasing a block of the region of a spool.
+ *
+ * Erased bytes must read as 0xFF.
+ *
+ * @param[in] pvFlashContext The context as supplied in
+ * MQTTOfflineFlashInterface_t.
+ * @param[in] ulBlock The index of the block to erase.
+ *
+ * @return eMQTTTrue if the block was erased, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    typedef MQTTBool_t ( * MQTTOfflineFlashErase_t )( void * pvFlashContext,
+                                                      uint32_t ulBlock );
+#endif
+
+/**
+ * @brief The region in which a spool writes its log.
+ *
+ * The region is made of ulBlockCount blocks of ulBlockSize bytes, which
+ * are erased one at a time. A message must fit in a block with 16 bytes of
+ * headers, so the block size bounds the size of the messages which can be
+ * spooled.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTOfflineFlashInterface
+    {
+        void * pvFlashContext;              /**< Passed as it is to the functions below. */
+        MQTTOfflineFlashRead_t pxReadFxn;   /**< Reads from the region. */
+        MQTTOfflineFlashWrite_t pxWriteFxn; /**< Writes to the region. */
+        MQTTOfflineFlashErase_t pxEraseFxn; /**< Erases a block of the region. */
+        uint32_t ulBlockSize;               /**< The size of a block, a multiple of 4. */
+        uint32_t ulBlockCount;              /**< The number of blocks, at least 2. */
+    } MQTTOfflineFlashInterface_t;
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief A spool.
+ *
+ * The messages are appended to the block at the tail of the log. Once it is
+ * full, the next block is erased and used, unless it holds the message at
+ * the head of the log, in which case the spool is full. A block is reused
+ * only once all the messages in it have been removed. The state of the log
+ * is recovered from the region in MQTT_OfflineSpoolInit, so the messages in
+ * a non-volatile region survive a reset.
+ *
+ * The members are private to aws_mqtt_offline_spool.c, except for the
+ * counters which may be read.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTOfflineSpool
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash; /**< The region holding the log. */
+        uint32_t ulHeadOffset;                       /**< Offset of the oldest message. */
+        uint32_t ulTailOffset;                       /**< Offset at which the next message is written. */
+        uint32_t ulNextSequence;                     /**< Sequence number of the next block used. */
+        uint32_t ulMessages;                         /**< Number of messages in the spool. */
+        uint32_t ulBytes;                            /**< Number of topic and data bytes in the spool. */
+    } MQTTOfflineSpool_t;
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief A RAM region for a spool.
+ *
+ * The messages in it survive a warm reset if the memory is not initialized
+ * at start up.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTOfflineRamFlash
+    {
+        uint8_t * pucMemory;                    /**< The memory of the region. */
+        MQTTOfflineFlashInterface_t xInterface; /**< The interface to supply to MQTT_OfflineSpoolInit. */
+    } MQTTOfflineRamFlash_t;
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief A file region for a spool.
+ *
+ * Implemented with the C standard library in
+ * lib/mqtt/portable/pc/aws_mqtt_offline_file_spool.c, for the hosted builds.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    typedef struct MQTTOfflineFileFlash
+    {
+        void * pvFile;                          /**< The open file, a FILE pointer. */
+        MQTTOfflineFlashInterface_t xInterface; /**< The interface to supply to MQTT_OfflineSpoolInit. */
+    } MQTTOfflineFileFlash_t;
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Initializes a spool and recovers the messages already in its
+ * region.
+ *
+ * Blocks which cannot be read or do not hold a valid log are considered
+ * erased.
+ *
+ * @param[in] pxSpool The spool to initialize.
+ * @param[in] pxFlash The region of the spool. It must remain valid as long
+ * as the spool is used.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    void MQTT_OfflineSpoolInit( MQTTOfflineSpool_t * pxSpool,
+                                const MQTTOfflineFlashInterface_t * pxFlash );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Appends a message to a spool.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] pxPublishParams The message. The packet identifier and the
+ * timeout are not stored.
+ *
+ * @return eMQTTTrue if the message was stored, eMQTTFalse if the spool is
+ * full, the message does not fit in a block or the region could not be
+ * written.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTBool_t MQTT_OfflineSpoolPush( MQTTOfflineSpool_t * pxSpool,
+                                      const MQTTPublishParams_t * pxPublishParams );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Reads the oldest message of a spool without removing it.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] pucBuffer The buffer to read the topic and the data into.
+ * @param[in] ulBufferLength The length of the buffer.
+ * @param[out] pxPublishParams The message. The topic and the data point
+ * into pucBuffer. The packet identifier and the timeout are not set.
+ *
+ * @return eMQTTTrue if a message was read, eMQTTFalse if the spool is
+ * empty, the message does not fit in the buffer or the region could not be
+ * read.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTBool_t MQTT_OfflineSpoolPeek( MQTTOfflineSpool_t * pxSpool,
+                                      uint8_t * pucBuffer,
+                                      uint32_t ulBufferLength,
+                                      MQTTPublishParams_t * pxPublishParams );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Removes the oldest message of a spool.
+ *
+ * @param[in] pxSpool The spool.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    void MQTT_OfflineSpoolPop( MQTTOfflineSpool_t * pxSpool );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Initializes a RAM region for a spool.
+ *
+ * @param[in] pxRamFlash The region to initialize.
+ * @param[in] pucMemory The memory to use, ulBlockSize * ulBlockCount bytes
+ * aligned on 4 bytes. It must remain valid as long as the region is used.
+ * @param[in] ulBlockSize The size of a block, a multiple of 4.
+ * @param[in] ulBlockCount The number of blocks, at least 2.
+ *
+ * @return The interface to supply to MQTT_OfflineSpoolInit.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    const MQTTOfflineFlashInterface_t * MQTT_OfflineRamFlashInit( MQTTOfflineRamFlash_t * pxRamFlash,
+                                                                  uint8_t * pucMemory,
+                                                                  uint32_t ulBlockSize,
+                                                                  uint32_t ulBlockCount );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Opens a file region for a spool, creating the file if needed.
+ *
+ * Only available in the hosted builds, see MQTTOfflineFileFlash_t.
+ *
+ * @param[in] pxFileFlash The region to initialize.
+ * @param[in] pcFileName The name of the file.
+ * @param[in] ulBlockSize The size of a block, a multiple of 4.
+ * @param[in] ulBlockCount The number of blocks, at least 2.
+ *
+ * @return The interface to supply to MQTT_OfflineSpoolInit, or NULL if the
+ * file could not be opened.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    const MQTTOfflineFlashInterface_t * MQTT_OfflineFileFlashOpen( MQTTOfflineFileFlash_t * pxFileFlash,
+                                                                   const char * pcFileName,
+                                                                   uint32_t ulBlockSize,
+                                                                   uint32_t ulBlockCount );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+/**
+ * @brief Closes a file region opened with MQTT_OfflineFileFlashOpen.
+ *
+ * @param[in] pxFileFlash The region to close.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    void MQTT_OfflineFileFlashClose( MQTTOfflineFileFlash_t * pxFileFlash );
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+#endif /* _AWS_MQTT_OFFLINE_SPOOL_H_ */
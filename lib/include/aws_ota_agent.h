@@ -154,6 +154,7 @@ typedef uint32_t OTA_Err_t;
 #define kOTA_Err_UserAbort               0x28000000UL     /*!< User aborted the active OTA. */
 #define kOTA_Err_ResetNotSupported       0x29000000UL     /*!< We tried to reset the device but the device doesn't support it. */
 #define kOTA_Err_TopicTooLarge           0x2a000000UL     /*!< Attempt to build a topic string larger than the supplied buffer. */
+#define kOTA_Err_ResumeStateFailed       0x2b000000UL     /*!< The PAL failed to save the resume state of the OTA receive file. */
 
 /**
  * @brief OTA Job callback events.
@@ -219,7 +220,7 @@ typedef struct
     {
         int32_t lFileHandle;      /*!< Device internal file pointer or handle.
                                    * File type is handle after file is open for write. */
-        #if WIN32
+        #if WIN32 || __linux__
             FILE * pxFile;       /*!< File type is stdio FILE structure after file is open for write. */
         #endif
         uint8_t * pucFile;        /*!< File type is RAM/Flash image pointer after file is open for write. */
@@ -237,6 +238,24 @@ typedef struct
     uint8_t * pucCertFilepath;    /*!< Pathname of the certificate file used to validate the receive file. */
     uint32_t ulUpdaterVersion;    /*!< Used by OTA self-test detection, the version of FW that did the update. */
     bool_t xIsInSelfTest;         /*!< True if the job is in self test mode. */
+    uint32_t ulWindowBlocks;      /*!< Number of blocks asked for by each windowed stream request. */
+    uint32_t ulWindowThreshold;   /*!< Window size from which the window grows by one block instead of doubling. */
+    uint32_t ulWindowStart;       /*!< First block covered by the last windowed stream request. */
+    uint32_t ulWindowEnd;         /*!< Block following the last block covered by the last windowed stream request. */
+    uint32_t ulWindowOutstanding; /*!< Number of blocks asked for by the last windowed stream request and not received yet. */
+    TickType_t xWindowSentTime;   /*!< Time at which the last windowed stream request was published. */
+    TickType_t xSmoothedRTT;      /*!< Smoothed round trip time of the windowed stream requests, 0 until measured. */
+    TickType_t xRTTVariation;     /*!< Smoothed variation of the round trip time of the windowed stream requests. */
+    TickType_t xWindowTimeout;    /*!< Time to wait for the blocks of a windowed stream request before asking again. */
+    bool_t xWindowRTTPending;     /*!< True until a block of the last windowed stream request is received, if it was not a repeat. */
+    void * pvSigVerifyContext;    /*!< Signature verification context of the blocks hashed as they were received, or NULL. */
+    uint32_t ulHashedBlocks;      /*!< Number of leading blocks of the file hashed in pvSigVerifyContext. */
+    uint8_t * pucReorderBuffer;   /*!< Blocks received ahead of the next block to hash, one per slot. */
+    uint32_t ulReorderMask;       /*!< Bit n is set if slot n of pucReorderBuffer holds a block. */
+    bool_t xIsDelta;              /*!< True if the file is a patch of the active image. */
+    struct OTA_Delta * pxDelta;   /*!< State of the patch applied as its blocks are received, or NULL. */
+    bool_t xIsCompressed;         /*!< True if the file is compressed. */
+    struct OTA_Decompress * pxDecompress; /*!< State of the decompression of the file as its blocks are received, or NULL. */
 } OTA_FileContext_t;
 
 
@@ -44,11 +44,14 @@ typedef void * ShadowClientHandle_t;
 /**
  * @brief Return values of Shadow API functions.
  *
- * Negative values indicate jsmn (JSON parser) errors, and @c 0 indicates
- * success. Positive values indicate other errors. Values in the range of @c 400
- * to @c 500 correspond to Shadow service rejection reasons.
+ * Negative values indicate JSON errors, and @c 0 indicates success. Positive
+ * values indicate other errors. Values in the range of @c 400 to @c 500
+ * correspond to Shadow service rejection reasons.
  *
- * Refer to jsmn.h for jsmn errors.
+ * A JSON document is truncated (#eShadowJSMNPart), is not valid JSON
+ * (#eShadowJSMNInval) or nests objects and arrays deeper than
+ * jsonscanMAX_DEPTH (#eShadowJSMNNoMem), see aws_json_scanner.h. The names
+ * are kept from the jsmn parser which the Shadow library used to rely on.
  *
  * Refer to
  * http://docs.aws.amazon.com/iot/latest/developerguide/thing-shadow-error-messages.html
@@ -388,6 +391,10 @@ ShadowReturnCode_t SHADOW_ClientDelete( ShadowClientHandle_t xShadowClientHandle
  * will not be notified if acceptance occurs after a timeout. The user may
  * intentionally set a short timeout if the result of the update isn't relevant,
  * but the timeout must still be long enough for the update to be published.
+ * - Up to #shadowconfigMAX_CONCURRENT_OPERATIONS updates, gets and deletes
+ * may be in progress on a Shadow Client. The response to an update is matched
+ * to it by the client token of the update document, so concurrent updates
+ * should use different client tokens.
  */
 ShadowReturnCode_t SHADOW_Update( ShadowClientHandle_t xShadowClientHandle,
                                   ShadowOperationParams_t * const pxUpdateParams,
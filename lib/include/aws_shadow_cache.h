@@ -0,0 +1,246 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_shadow_cache.h
+ * @brief Local cache of a Thing Shadow document.
+ *
+ * A Shadow document cache keeps the last acknowledged reported and desired
+ * state of a Thing Shadow as a list of fields. The application sets the
+ * reported fields in the cache, which publishes only the fields which changed
+ * since the last acknowledged update, coalescing the changes made within
+ * #shadowconfigCACHE_COALESCE_MS into one update. The desired fields are
+ * updated from the delta documents and the documents returned by #SHADOW_Get,
+ * and read from the cache instead of from the documents.
+ *
+ * The path of a field joins the keys leading to it with dots, for example the
+ * path of "red" in {"light":{"color":"red"}} is "light.color". The value of a
+ * field is its JSON text, for example "\"red\"", "42", "true" or "[1,2]".
+ */
+
+#ifndef _AWS_SHADOW_CACHE_H_
+#define _AWS_SHADOW_CACHE_H_
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/* AWS includes. */
+#include "aws_shadow_config.h"
+#include "aws_shadow_config_defaults.h"
+#include "aws_shadow.h"
+
+/**
+ * @brief A field of a Shadow document cache.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    typedef struct ShadowCacheField
+    {
+        char cPath[ shadowconfigCACHE_MAX_PATH_LENGTH ];   /**< Path of the field; empty if the entry is free. */
+        char cValue[ shadowconfigCACHE_MAX_VALUE_LENGTH ]; /**< JSON text of the value. */
+        uint32_t ulChangeSequence;                         /**< Sequence number of the last change not yet acknowledged; 0 if none. */
+    } ShadowCacheField_t;
+#endif
+
+/**
+ * @brief A Shadow document cache.
+ *
+ * Allocated by the application and initialized with #SHADOW_CacheInit. The
+ * members are private to the cache.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    typedef struct ShadowCache
+    {
+        ShadowClientHandle_t xShadowClientHandle;                      /**< The Shadow Client publishing the updates. */
+        const char * pcThingName;                                      /**< The Thing Name of the Shadow. */
+        ShadowCacheField_t xReported[ shadowconfigCACHE_MAX_FIELDS ];  /**< The reported fields. */
+        ShadowCacheField_t xDesired[ shadowconfigCACHE_MAX_FIELDS ];   /**< The desired fields. */
+        uint32_t ulVersion;                                            /**< Version of the last document applied; 0 if none. */
+        uint32_t ulChangeSequence;                                     /**< Sequence number of the last change. */
+        BaseType_t xChangesPending;                                    /**< pdTRUE if a reported field has changed since the last update. */
+        TickType_t xFirstChangeTime;                                   /**< Time of the first change since the last update. */
+        SemaphoreHandle_t xMutex;                                      /**< Protects the members above. */
+        StaticSemaphore_t xMutexBuffer;                                /**< Storage of xMutex. */
+        char cUpdateDocument[ shadowconfigCACHE_DOCUMENT_LENGTH ];     /**< The last update document built. */
+        uint32_t ulUpdateDocumentLength;                               /**< Length of cUpdateDocument. */
+    } ShadowCache_t;
+#endif
+
+/**
+ * @brief Initialize a Shadow document cache.
+ *
+ * @param[in] pxCache The cache to initialize.
+ * @param[in] xShadowClientHandle Handle of the Shadow Client to publish the
+ * updates with.
+ * @param[in] pcThingName The Thing Name of the Shadow; must remain valid
+ * while the cache is used.
+ *
+ * @return #eShadowSuccess, or #eShadowFailure if the mutex of the cache
+ * could not be created.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheInit( ShadowCache_t * const pxCache,
+                                         ShadowClientHandle_t xShadowClientHandle,
+                                         const char * const pcThingName );
+#endif
+
+/**
+ * @brief Set a reported field of a Shadow document cache.
+ *
+ * The field is published by the next #SHADOW_CacheFlush, unless its value
+ * is unchanged. Setting a field to "null" deletes it from the Shadow, and from
+ * the cache once the update is acknowledged.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcPath The path of the field, for example "light.color". The path
+ * of a field must not be a prefix of the path of another, as in "light" and
+ * "light.color".
+ * @param[in] pcValue The JSON text of the value, for example "\"red\"".
+ *
+ * @return #eShadowSuccess, or #eShadowFailure if the path or the value is
+ * too long or invalid, or the cache is full.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheSetReported( ShadowCache_t * const pxCache,
+                                                const char * const pcPath,
+                                                const char * const pcValue );
+#endif
+
+/**
+ * @brief Read a reported field of a Shadow document cache.
+ *
+ * The value is the last one set, whether or not it has been acknowledged.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcPath The path of the field.
+ * @param[out] pcValue The buffer receiving the JSON text of the value, NULL
+ * terminated.
+ * @param[in] xValueLength The size of pcValue.
+ *
+ * @return #eShadowSuccess, or #eShadowFailure if the field is not in the cache
+ * or pcValue is too small.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheGetReported( ShadowCache_t * const pxCache,
+                                                const char * const pcPath,
+                                                char * const pcValue,
+                                                size_t xValueLength );
+#endif
+
+/**
+ * @brief Read a desired field of a Shadow document cache.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcPath The path of the field.
+ * @param[out] pcValue The buffer receiving the JSON text of the value, NULL
+ * terminated.
+ * @param[in] xValueLength The size of pcValue.
+ *
+ * @return #eShadowSuccess, or #eShadowFailure if the field is not in the cache
+ * or pcValue is too small.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheGetDesired( ShadowCache_t * const pxCache,
+                                               const char * const pcPath,
+                                               char * const pcValue,
+                                               size_t xValueLength );
+#endif
+
+/**
+ * @brief Replace the state of a Shadow document cache with a Shadow document.
+ *
+ * The document is the one returned by #SHADOW_Get. Its reported fields replace
+ * the ones of the cache, except the fields changed since the last update, and
+ * its desired fields replace the ones of the cache. The document is ignored
+ * if it is not newer than the last document applied.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcDocument The Shadow document.
+ * @param[in] ulDocumentLength The length of pcDocument.
+ *
+ * @return #eShadowSuccess; #eShadowFailure if some fields did not fit in the
+ * cache; a negative code (see #eShadowJSMNInval) if the document is not
+ * valid JSON.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheApplyDocument( ShadowCache_t * const pxCache,
+                                                  const char * const pcDocument,
+                                                  uint32_t ulDocumentLength );
+#endif
+
+/**
+ * @brief Apply a delta document to the desired fields of a Shadow document
+ * cache.
+ *
+ * Call this function from the #ShadowDeltaCallback_t of the Thing. The delta
+ * document is ignored if it is not newer than the last document applied, as
+ * the Shadow service may deliver delta documents out of order.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcDocument The delta document.
+ * @param[in] ulDocumentLength The length of pcDocument.
+ *
+ * @return #eShadowSuccess; #eShadowFailure if some fields did not fit in the
+ * cache; a negative code (see #eShadowJSMNInval) if the document is not
+ * valid JSON.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheApplyDelta( ShadowCache_t * const pxCache,
+                                               const char * const pcDocument,
+                                               uint32_t ulDocumentLength );
+#endif
+
+/**
+ * @brief Publish the reported fields of a Shadow document cache which changed
+ * since the last acknowledged update.
+ *
+ * The changed fields are published in one #SHADOW_Update, once
+ * #shadowconfigCACHE_COALESCE_MS has elapsed since the first of them was
+ * changed. Call this function periodically, or with xForce set to publish
+ * the changes immediately.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] xForce pdTRUE to publish the changes without waiting for the
+ * coalescing time to elapse.
+ * @param[in] xTimeoutTicks Number of ticks the update may block before
+ * timeout.
+ *
+ * @return #eShadowSuccess if the changes were acknowledged or there was
+ * nothing to publish; #eShadowFailure if the update document does not fit in
+ * #shadowconfigCACHE_DOCUMENT_LENGTH; the result of #SHADOW_Update otherwise.
+ *
+ * @note
+ * - The fields of an update which failed remain changed, and are published
+ * again by the next call.
+ * - This function must not be called from several tasks at once on the same
+ * cache. The other functions may be.
+ */
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+    ShadowReturnCode_t SHADOW_CacheFlush( ShadowCache_t * const pxCache,
+                                          BaseType_t xForce,
+                                          TickType_t xTimeoutTicks );
+#endif
+
+#endif /* _AWS_SHADOW_CACHE_H_ */
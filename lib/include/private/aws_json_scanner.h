@@ -0,0 +1,195 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_json_scanner.h
+ * @brief Streaming JSON scanner.
+ *
+ * The scanner walks a JSON document in a single pass and returns its values
+ * one at a time, pointing into the document instead of copying them. It does
+ * not allocate memory and has no limit on the number of values; only the
+ * nesting of objects and arrays is limited, to #jsonscanMAX_DEPTH.
+ *
+ * @code
+ * JSONScanner_t xScanner;
+ * JSONScanElement_t xElement;
+ *
+ * JSON_ScanInit( &xScanner, pcDoc, ulDocLength );
+ *
+ * while( JSON_ScanNext( &xScanner, &xElement ) == eJSONScanSuccess )
+ * {
+ *     ...
+ * }
+ * @endcode
+ *
+ * #JSON_ScanPaths looks up a set of values by their key paths and stops as
+ * soon as all of them are found.
+ */
+
+#ifndef _AWS_JSON_SCANNER_H_
+#define _AWS_JSON_SCANNER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Maximum nesting of objects and arrays in a scanned document.
+ *
+ * Each level takes 4 bytes in a JSONScanner_t. Must not be more than 32.
+ */
+#ifndef jsonscanMAX_DEPTH
+    #define jsonscanMAX_DEPTH    ( 16 )
+#endif
+
+/**
+ * @brief Return codes of the scanner functions.
+ */
+typedef enum JSONScanStatus
+{
+    eJSONScanSuccess = 0, /**< An element was returned, or all the paths were found. */
+    eJSONScanEnd,         /**< The root value of the document is complete. */
+    eJSONScanInvalid,     /**< The document is not valid JSON. */
+    eJSONScanPartial,     /**< The document ends before its root value is complete. */
+    eJSONScanTooDeep      /**< Objects and arrays are nested deeper than #jsonscanMAX_DEPTH. */
+} JSONScanStatus_t;
+
+/**
+ * @brief Types of the elements returned by the scanner.
+ */
+typedef enum JSONScanType
+{
+    eJSONScanObject = 0, /**< Start of an object. */
+    eJSONScanArray,      /**< Start of an array. */
+    eJSONScanString,     /**< A string. */
+    eJSONScanPrimitive,  /**< A number, true, false or null. */
+    eJSONScanObjectEnd,  /**< End of an object. */
+    eJSONScanArrayEnd    /**< End of an array. */
+} JSONScanType_t;
+
+/**
+ * @brief An element of a JSON document returned by the scanner.
+ */
+typedef struct JSONScanElement
+{
+    JSONScanType_t eType;   /**< Type of the element. */
+    uint8_t ucDepth;        /**< Number of objects and arrays containing the element. The root value has depth 0. */
+    const char * pcKey;     /**< Key of the value in its object, without the quotes. NULL for the values of arrays, the root value and the ends. */
+    uint32_t ulKeyLength;   /**< Length of pcKey. */
+    const char * pcValue;   /**< Strings without the quotes, primitives as they are, the opening bracket of a start and the whole object or array for an end. */
+    uint32_t ulValueLength; /**< Length of pcValue. */
+} JSONScanElement_t;
+
+/**
+ * @brief State of a scan.
+ *
+ * The members are private to the scanner.
+ */
+typedef struct JSONScanner
+{
+    const char * pcDoc;                      /**< The scanned document. */
+    uint32_t ulLength;                       /**< Length of pcDoc. */
+    uint32_t ulIndex;                        /**< Offset in pcDoc of the next character to scan. */
+    uint32_t ulArrayBits;                    /**< Bit n is set when the container at depth n is an array. */
+    uint32_t ulStart[ jsonscanMAX_DEPTH ];   /**< Offsets in pcDoc of the open containers. */
+    uint8_t ucDepth;                         /**< Number of open containers. */
+    uint8_t ucState;                         /**< What the scanner expects next. */
+} JSONScanner_t;
+
+/**
+ * @brief A value looked up by #JSON_ScanPaths.
+ */
+typedef struct JSONScanQuery
+{
+    const char * pcPath;    /**< Keys leading to the value from the root object, joined with dots, for example "state.reported.color". NULL terminated. */
+    JSONScanType_t eType;   /**< Set to the type of the value found, eJSONScanObject or eJSONScanArray for a whole object or array. */
+    const char * pcValue;   /**< Set to the value found, as in JSONScanElement_t, or to NULL if it is not found. */
+    uint32_t ulValueLength; /**< Set to the length of pcValue. */
+} JSONScanQuery_t;
+
+/**
+ * @brief Starts the scan of a JSON document.
+ *
+ * @param[out] pxScanner The scan state to initialize.
+ * @param[in] pcDoc The JSON document. It must remain valid during the scan.
+ * @param[in] ulDocLength The length of pcDoc. The document also ends at a NULL
+ *     character outside of its strings.
+ */
+void JSON_ScanInit( JSONScanner_t * pxScanner,
+                    const char * pcDoc,
+                    uint32_t ulDocLength );
+
+/**
+ * @brief Returns the next element of a JSON document.
+ *
+ * An object or an array is returned as a start element, followed by its
+ * values and an end element. The keys are returned with the values.
+ *
+ * @param[in,out] pxScanner The scan state.
+ * @param[out] pxElement Set to the next element.
+ *
+ * @return eJSONScanSuccess if pxElement was set; eJSONScanEnd once the root
+ *     value is complete; an error otherwise. The text following the root value
+ *     is not scanned.
+ */
+JSONScanStatus_t JSON_ScanNext( JSONScanner_t * pxScanner,
+                                JSONScanElement_t * pxElement );
+
+/**
+ * @brief Skips the values of the object or array just started.
+ *
+ * The values are not checked beyond the matching of the brackets, which is
+ * much faster than returning them.
+ *
+ * @param[in,out] pxScanner The scan state, whose last element was the start of
+ *     an object or an array.
+ * @param[in,out] pxElement The start element, whose value is extended to the
+ *     whole object or array.
+ *
+ * @return eJSONScanSuccess, or eJSONScanPartial if the document ends first.
+ */
+JSONScanStatus_t JSON_ScanSkip( JSONScanner_t * pxScanner,
+                                JSONScanElement_t * pxElement );
+
+/**
+ * @brief Looks up values of a JSON document by their key paths.
+ *
+ * Only the objects leading to the paths are scanned; other objects and arrays
+ * are skipped. The scan stops as soon as all the values are found. The first
+ * value found is kept if a key appears more than once.
+ *
+ * @param[in] pcDoc The JSON document.
+ * @param[in] ulDocLength The length of pcDoc.
+ * @param[in,out] pxQueries The paths to look up, set to the values found.
+ * @param[in] ulQueryCount The number of entries of pxQueries.
+ *
+ * @return eJSONScanSuccess if all the values were found; eJSONScanEnd if some
+ *     were not; an error if the document is invalid before all the values are
+ *     found.
+ */
+JSONScanStatus_t JSON_ScanPaths( const char * pcDoc,
+                                 uint32_t ulDocLength,
+                                 JSONScanQuery_t * pxQueries,
+                                 uint32_t ulQueryCount );
+
+#endif /* _AWS_JSON_SCANNER_H_ */
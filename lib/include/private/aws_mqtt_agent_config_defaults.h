@@ -95,7 +95,9 @@
  *
  * If the platform's secure_sockets layer supports SOCKETS_SO_WAKEUP_CALLBACK i.e.
  * the MQTT task can wake up whenever data is received on a connected socket, this
- * value should be set to maximum value:
+ * value is not used as long as all the connected sockets accept the callback. The
+ * MQTT task then only reads the sockets which signalled data. It should still be
+ * set to maximum value:
  * #define  #define mqttconfigMQTT_TASK_MAX_BLOCK_TICKS    ( ~( ( uint32_t ) 0 ) )
  *
  * If the platform's secure_sockets layer does not support SOCKETS_SO_WAKEUP_CALLBACK
@@ -127,6 +129,18 @@
     #define mqttconfigMAX_BROKERS    ( 1 )
 #endif
 
+/**
+ * @brief Set to 1 to service each client with its own MQTT task and command queue.
+ *
+ * A slow send to one broker then does not delay the other connections, and a
+ * full command queue only blocks the tasks using the same client. Each task uses
+ * mqttconfigMQTT_TASK_STACK_DEPTH and mqttconfigMQTT_TASK_PRIORITY. If set to 0,
+ * a single MQTT task services all the clients.
+ */
+#ifndef mqttconfigTASK_PER_BROKER
+    #define mqttconfigTASK_PER_BROKER    ( 0 )
+#endif
+
 /**
  * @brief Maximum number of parallel operations per client.
  */
@@ -134,6 +148,17 @@
     #define mqttconfigMAX_PARALLEL_OPS    ( 5 )
 #endif
 
+/**
+ * @brief Maximum number of publish operations initiated with MQTT_AGENT_PublishAsync
+ * which can be in progress simultaneously.
+ *
+ * Shared by all the clients. A QoS1 or QoS2 operation is in progress until the
+ * broker acknowledges the message.
+ */
+#ifndef mqttconfigMAX_ASYNC_PUBLISHES
+    #define mqttconfigMAX_ASYNC_PUBLISHES    ( 8 )
+#endif
+
 /**
  * @brief Time in milliseconds after which the TCP send operation should timeout.
  */
@@ -148,6 +173,119 @@
     #define mqttconfigRX_BUFFER_SIZE    ( 1024 )
 #endif
 
+/**
+ * @brief Length of the buffer of each client in which the outgoing packets are
+ * gathered before being sent.
+ *
+ * The packets produced by consecutive commands are then sent with one
+ * SOCKETS_Send call, i.e. one TLS record, instead of one each. Packets larger
+ * than the buffer are sent on their own. Set to 0 to send every packet
+ * immediately.
+ */
+#ifndef mqttconfigTX_BATCH_SIZE
+    #define mqttconfigTX_BATCH_SIZE    ( 0 )
+#endif
+
+/**
+ * @brief Time in ticks for which the gathered packets may wait for more
+ * packets before being sent.
+ *
+ * Only used if mqttconfigTX_BATCH_SIZE is not 0. The gathered packets are sent
+ * once no more commands are queued and the oldest one waited this long, or once
+ * the buffer is full. With the default of 0, the packets are only gathered while
+ * commands are queued and no latency is added.
+ */
+#ifndef mqttconfigTX_BATCH_WINDOW_TICKS
+    #define mqttconfigTX_BATCH_WINDOW_TICKS    ( 0 )
+#endif
+
+/**
+ * @brief Set to 1 to request a persistent session from the broker.
+ *
+ * The broker then keeps the subscriptions and the unacknowledged QoS1 and
+ * QoS2 messages of the client when it disconnects.
+ */
+#ifndef mqttconfigPERSISTENT_SESSION
+    #define mqttconfigPERSISTENT_SESSION    ( 0 )
+#endif
+
+/**
+ * @brief Set to 1 to connect to the brokers with MQTT 5 instead of MQTT 3.1.1.
+ *
+ * Only used if mqttconfigENABLE_MQTT5 is set to 1. A publish refused by the
+ * broker with a failure reason code then fails.
+ */
+#ifndef mqttconfigUSE_MQTT5
+    #define mqttconfigUSE_MQTT5    ( 0 )
+#endif
+
+/**
+ * @brief Size in bytes of the in-flight store of each broker connection.
+ *
+ * Only used if mqttconfigENABLE_INFLIGHT_STORE is set to 1. Each QoS1 or
+ * QoS2 message waiting for its acknowledgment takes its packet length plus
+ * 8 bytes. Set to 0 to not use an in-flight store.
+ */
+#ifndef mqttconfigINFLIGHT_STORE_SIZE
+    #define mqttconfigINFLIGHT_STORE_SIZE    ( 0 )
+#endif
+
+/**
+ * @brief Time in ticks to wait for the acknowledgment of a message
+ * re-transmitted from the in-flight store.
+ */
+#ifndef mqttconfigINFLIGHT_STORE_RESEND_TIMEOUT_TICKS
+    #define mqttconfigINFLIGHT_STORE_RESEND_TIMEOUT_TICKS    ( 5000 )
+#endif
+
+/**
+ * @brief Size in bytes of a block of the RAM offline queue of each broker
+ * connection.
+ *
+ * Only used if mqttconfigENABLE_OFFLINE_QUEUE is set to 1. A queued message
+ * takes its topic and data lengths plus 8 bytes, rounded up to a multiple of
+ * 4, and must fit in a block with 8 more bytes. Must be a multiple of 4.
+ */
+#ifndef mqttconfigOFFLINE_QUEUE_RAM_BLOCK_SIZE
+    #define mqttconfigOFFLINE_QUEUE_RAM_BLOCK_SIZE    ( 512 )
+#endif
+
+/**
+ * @brief Number of blocks of the RAM offline queue of each broker connection.
+ *
+ * The messages published while disconnected are queued in RAM first and,
+ * once it is full, in the spool supplied with MQTT_AGENT_SetOfflineSpool, if
+ * any. Set to 0 to only use the spool. Otherwise must be at least 2.
+ */
+#ifndef mqttconfigOFFLINE_QUEUE_RAM_BLOCKS
+    #define mqttconfigOFFLINE_QUEUE_RAM_BLOCKS    ( 4 )
+#endif
+
+/**
+ * @defgroup OfflineQueueReplay Rate of the publish of the queued messages on reconnect.
+ *
+ * At most mqttconfigOFFLINE_QUEUE_REPLAY_BURST queued messages are published
+ * every mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS ticks, so that a long
+ * queue does not flood the broker or starve the new messages.
+ */
+/** @{ */
+#ifndef mqttconfigOFFLINE_QUEUE_REPLAY_BURST
+    #define mqttconfigOFFLINE_QUEUE_REPLAY_BURST    ( 8 )
+#endif
+
+#ifndef mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS
+    #define mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS    ( 100 )
+#endif
+/** @} */
+
+/**
+ * @brief Time in ticks to wait for the acknowledgment of a QoS1 or QoS2
+ * message published from the offline queue.
+ */
+#ifndef mqttconfigOFFLINE_QUEUE_ACK_TIMEOUT_TICKS
+    #define mqttconfigOFFLINE_QUEUE_ACK_TIMEOUT_TICKS    ( 5000 )
+#endif
+
 /**
  * @defgroup BufferPoolInterface The functions used by the MQTT client to get and return buffers.
  *
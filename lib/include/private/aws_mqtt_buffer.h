@@ -63,6 +63,9 @@ typedef struct MQTTBufferState
     uint64_t xRecordedTickCount; /**< The time-stamp when this packet was sent. */
     uint32_t ulTimeoutTicks;     /**< The time interval after which this packet should timeout i.e. stop waiting for ACK. */
     uint16_t usPacketIdentifier; /**< Packet identifier sent with this packet. */
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        const void * pvPublishData; /**< The payload of a publish message sent with MQTT_PublishZeroCopy, NULL otherwise. */
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
 } MQTTBufferState_t;
 
 /**
@@ -172,6 +175,17 @@ typedef struct MQTTBufferMetadata
  */
 #define mqttbufferGET_PACKET_TIMEOUT_TICKS( xBufferHandle )          ( ( ( MQTTBufferMetadata_t * ) ( xBufferHandle ) )->xBufferState.ulTimeoutTicks )
 
+/**
+ * @brief Given the buffer handle, extracts the payload referenced by a
+ * publish message sent with MQTT_PublishZeroCopy from the metadata portion
+ * of the buffer.
+ *
+ * @param[in] xBufferHandle The given buffer handle.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    #define mqttbufferGET_PUBLISH_DATA( xBufferHandle )              ( ( ( MQTTBufferMetadata_t * ) ( xBufferHandle ) )->xBufferState.pvPublishData )
+#endif
+
 /**
  * @brief Given a list head and a buffer handle, adds the buffer to the given
  * list.
@@ -60,19 +60,145 @@
 #endif
 
 /**
- * @brief Maximum number of subscriptions which can be stored in subscription
- * manager.
+ * @brief Expected number of subscriptions which are stored in subscription
+ * manager simultaneously.
  *
- * If the user has enabled subscription management (by defining the macro
- * mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT to 1), then this macro must be defined
- * to the maximum number of topics which the user is going to subscribe
- * simultaneously. The subscribe operation will fail is the user tries to
- * subscribe to more topics than the maximum specified here.
+ * The subscription manager stores all topic filters in shared pools. This
+ * macro is only used to size those pools when the user does not define
+ * mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES and
+ * mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE. The subscribe operation
+ * fails when the pools are exhausted.
  */
 #ifndef mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS
     #define mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS    ( 8 )
 #endif
 
+/**
+ * @brief Number of topic levels which can be stored in subscription manager.
+ *
+ * Each level of a topic filter takes one node, unless another topic filter
+ * with the same preceding levels already uses it. For example, "a/b/c" and
+ * "a/b/d" take four nodes together. Must be less than 65535.
+ */
+#ifndef mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES
+    #define mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES      ( mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS * 4 )
+#endif
+
+/**
+ * @brief Size in bytes of the pool storing the names of the topic levels in
+ * subscription manager.
+ *
+ * Every distinct level name is stored only once, however many topic filters
+ * use it. Must be less than 65536.
+ */
+#ifndef mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE
+    #define mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE     ( mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS * 32 )
+#endif
+
+/**
+ * @brief Number of hash buckets used by subscription manager to find the
+ * next topic level while dispatching a received publish message.
+ */
+#ifndef mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS
+    #define mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS         ( mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES )
+#endif
+
+/**
+ * @brief Number of QoS2 publish messages received from the broker which can
+ * wait for the PUBREL simultaneously.
+ *
+ * The packet identifier of a received QoS2 publish message is remembered
+ * until the broker releases it, so that a re-transmission of the same message
+ * is acknowledged but not passed to the user again. If all the entries are in
+ * use, the message is passed to the user without being remembered and may
+ * therefore be delivered more than once.
+ */
+#ifndef mqttconfigMAX_QOS2_RECEIVED_PUBLISHES
+    #define mqttconfigMAX_QOS2_RECEIVED_PUBLISHES               ( 4 )
+#endif
+
+/**
+ * @brief Enable the in-flight message store.
+ *
+ * The in-flight store allows the user to supply a store (see
+ * MQTTInflightStoreInterface_t) in which the QoS1 and QoS2 messages are kept
+ * until the broker acknowledges them. The stored messages are re-transmitted
+ * whenever a new connection to the broker is established.
+ */
+#ifndef mqttconfigENABLE_INFLIGHT_STORE
+    #define mqttconfigENABLE_INFLIGHT_STORE                     ( 0 )
+#endif
+
+/**
+ * @brief Enable the zero-copy publish.
+ *
+ * The zero-copy publish (see MQTT_PublishZeroCopy) transmits the payload of
+ * a publish message directly from the memory of the user, instead of copying
+ * it into a buffer from the buffer pool first.
+ */
+#ifndef mqttconfigENABLE_ZERO_COPY_PUBLISH
+    #define mqttconfigENABLE_ZERO_COPY_PUBLISH                  ( 0 )
+#endif
+
+/**
+ * @brief Enable the streaming receive.
+ *
+ * A publish message which does not fit in a buffer from the buffer pool is
+ * then passed to the user in chunks (see MQTTPublishChunkData_t) as it
+ * arrives, instead of being dropped. Only the fixed header, the topic and the
+ * packet identifier of the message are stored in a buffer, so the topic must
+ * still fit in one.
+ */
+#ifndef mqttconfigENABLE_STREAMING_RECEIVE
+    #define mqttconfigENABLE_STREAMING_RECEIVE                  ( 0 )
+#endif
+
+/**
+ * @brief Enable MQTT 5.
+ *
+ * The protocol version of a context (MQTT 3.1.1 or MQTT 5) is then selected
+ * in the Init parameters (see MQTTProtocolVersion_t). MQTT 5 contexts use
+ * topic aliases on both directions, limit the number of QoS1 and QoS2 publish
+ * messages in flight to the Receive Maximum of the broker and report the
+ * reason codes of the acknowledgments.
+ */
+#ifndef mqttconfigENABLE_MQTT5
+    #define mqttconfigENABLE_MQTT5                              ( 0 )
+#endif
+
+/**
+ * @brief Number of topic aliases of an MQTT 5 connection in each direction.
+ *
+ * The client assigns aliases to the first topics it publishes on until the
+ * aliases accepted by the broker are exhausted, and accepts as many aliases
+ * from the broker.
+ */
+#ifndef mqttconfigTOPIC_ALIAS_MAXIMUM
+    #define mqttconfigTOPIC_ALIAS_MAXIMUM                       ( 4 )
+#endif
+
+/**
+ * @brief Maximum length of a topic which can be replaced with a topic alias.
+ *
+ * Longer topics are always sent in full. The broker must not assign aliases
+ * to longer topics, as the client would not be able to resolve them.
+ */
+#ifndef mqttconfigTOPIC_ALIAS_MAX_TOPIC_LENGTH
+    #define mqttconfigTOPIC_ALIAS_MAX_TOPIC_LENGTH              ( 128 )
+#endif
+
+/**
+ * @brief Enable the offline publish queue.
+ *
+ * The MQTT agent then queues the messages published while it is
+ * disconnected, first in RAM and then in a spool (see
+ * aws_mqtt_offline_spool.h), and publishes them in order once connected
+ * again.
+ */
+#ifndef mqttconfigENABLE_OFFLINE_QUEUE
+    #define mqttconfigENABLE_OFFLINE_QUEUE                      ( 0 )
+#endif
+
 /**
  * @brief Define mqttconfigASSERT to enable asserts.
  *
@@ -0,0 +1,189 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_agent_config_defaults.h
+ * @brief OTA agent default config options.
+ *
+ * Ensures that the config options for the OTA agent are set to sensible
+ * default values if the user does not provide one.
+ */
+
+#ifndef _AWS_OTA_AGENT_CONFIG_DEFAULTS_H_
+#define _AWS_OTA_AGENT_CONFIG_DEFAULTS_H_
+
+/**
+ * @brief Enable windowed stream requests.
+ *
+ * By default each stream request asks for every block of the file not received
+ * yet, and is only repeated after otaconfigFILE_REQUEST_WAIT_MS without any
+ * block received. When this is set to 1, each request asks for a window of the
+ * next missing blocks, and the next window is requested as soon as the current
+ * one is received. The window grows while whole windows are received, and is
+ * halved when blocks are lost. Lost blocks are requested again after a time
+ * derived from the measured round trip time of the requests.
+ */
+#ifndef otaconfigENABLE_STREAM_WINDOW
+    #define otaconfigENABLE_STREAM_WINDOW    ( 0 )
+#endif
+
+/**
+ * @brief Number of blocks asked for by the first windowed stream request.
+ */
+#ifndef otaconfigSTREAM_WINDOW_INITIAL_BLOCKS
+    #define otaconfigSTREAM_WINDOW_INITIAL_BLOCKS    ( 4UL )
+#endif
+
+/**
+ * @brief Maximum number of blocks asked for by a windowed stream request.
+ *
+ * The blocks of a window arrive back to back, so the MQTT buffer pool and the
+ * OTA message queue should be able to hold a good part of them.
+ *
+ * @note Must not be more than 256.
+ */
+#ifndef otaconfigSTREAM_WINDOW_MAX_BLOCKS
+    #define otaconfigSTREAM_WINDOW_MAX_BLOCKS    ( 32UL )
+#endif
+
+/**
+ * @brief Minimum time (in milliseconds) to wait for the blocks of a windowed
+ * stream request before asking for them again.
+ *
+ * The wait is four times the measured variation of the round trip time above
+ * its average, but no less than this, and no more than
+ * otaconfigFILE_REQUEST_WAIT_MS.
+ */
+#ifndef otaconfigSTREAM_WINDOW_MIN_WAIT_MS
+    #define otaconfigSTREAM_WINDOW_MIN_WAIT_MS    ( 250UL )
+#endif
+
+/**
+ * @brief Enable hashing the file as it is received.
+ *
+ * By default the PAL reads the whole file back to hash it when it is closed,
+ * before checking its signature. When this is set to 1, the OTA agent hashes
+ * the blocks as they are received, in order, for an ECDSA SHA-256 signature,
+ * and the PAL only has to check the signature. The hash then covers the
+ * blocks as received rather than as read back from storage.
+ *
+ * @note Only useful if the PAL finishes the verification in the
+ * pvSigVerifyContext of the file context when it is not NULL, as the Windows,
+ * ESP32 and PIC32MZ PALs do. Other PALs still hash the file when closing it.
+ */
+#ifndef otaconfigENABLE_STREAMING_SIGNATURE_CHECK
+    #define otaconfigENABLE_STREAMING_SIGNATURE_CHECK    ( 0 )
+#endif
+
+/**
+ * @brief Number of blocks received ahead of the next block to hash which are
+ * kept until it arrives.
+ *
+ * The blocks are kept in RAM, so this costs this number of file blocks of
+ * heap during a download. A block arriving further ahead stops the hashing,
+ * and the PAL hashes the file when it is closed instead.
+ *
+ * @note Must not be more than 32.
+ */
+#ifndef otaconfigSIGNATURE_REORDER_BLOCKS
+    #define otaconfigSIGNATURE_REORDER_BLOCKS    ( 4UL )
+#endif
+
+/**
+ * @brief Enable delta updates.
+ *
+ * The job document of a delta update marks the file with a "delta" key. The
+ * file is then a patch of the active image (see aws_ota_delta.h), which is
+ * applied as its blocks are received to write the new file. The blocks of a
+ * patch are only accepted in order; the others are requested again.
+ */
+#ifndef otaconfigENABLE_DELTA_UPDATE
+    #define otaconfigENABLE_DELTA_UPDATE    ( 0 )
+#endif
+
+/**
+ * @brief Size of the buffer through which the new file of a delta update is
+ * written.
+ *
+ * The new file is written by chunks of this size, and the state of the patch,
+ * of about this size too, is allocated on the heap during a delta update.
+ *
+ * @note Must be at least 12 and less than 65536.
+ */
+#ifndef otaconfigDELTA_BUFFER_SIZE
+    #define otaconfigDELTA_BUFFER_SIZE    ( 256UL )
+#endif
+
+/**
+ * @brief Enable compressed updates.
+ *
+ * The job document of a compressed update marks the file with a "compressed"
+ * key. The file is then decompressed as its blocks are received (see
+ * aws_ota_decompress.h), and only accepted in order. A compressed file may
+ * also be a patch, which is applied as it is decompressed.
+ */
+#ifndef otaconfigENABLE_COMPRESSED_UPDATE
+    #define otaconfigENABLE_COMPRESSED_UPDATE    ( 0 )
+#endif
+
+/**
+ * @brief Size of the largest decompression window, as a power of 2.
+ *
+ * Files compressed with a larger window are rejected. The window is part of
+ * the state of the decompression, allocated on the heap during a compressed
+ * update, and the decompressed file is written by chunks of its size.
+ *
+ * @note Must be from 4 to 15.
+ */
+#ifndef otaconfigDECOMPRESS_WINDOW_BITS
+    #define otaconfigDECOMPRESS_WINDOW_BITS    ( 10U )
+#endif
+
+/**
+ * @brief Enable resuming downloads after a reset.
+ *
+ * When this is set to 1, the OTA agent saves which blocks of the file were
+ * received through the PAL (see prvPAL_SaveResumeState) every
+ * otaconfigRESUME_SAVE_BLOCKS blocks, and when the agent is shut down. When the
+ * same job is received again after a reset or a restart of the agent, the PAL
+ * reopens the partly received file and only the missing blocks are requested.
+ * Patches and compressed files are always downloaded from the start.
+ */
+#ifndef otaconfigENABLE_RESUME
+    #define otaconfigENABLE_RESUME    ( 0 )
+#endif
+
+/**
+ * @brief Number of blocks received between two saves of the resume state.
+ *
+ * The blocks received since the last save are requested again after a reset.
+ * Each save writes the bitmap of the blocks received, one bit per block, to
+ * the storage of the PAL.
+ */
+#ifndef otaconfigRESUME_SAVE_BLOCKS
+    #define otaconfigRESUME_SAVE_BLOCKS    ( 32UL )
+#endif
+
+#endif /* _AWS_OTA_AGENT_CONFIG_DEFAULTS_H_ */
@@ -33,11 +33,13 @@
 #define _AWS_OTA_AGENT_INTERAL_H_
 
 #include "aws_ota_agent_config.h"
-#include "jsmn.h"
+#include "aws_ota_agent_config_defaults.h"
+#include "aws_json_scanner.h"
 
 #define LOG2_BITS_PER_BYTE      3UL                             /* Log base 2 of bits per byte. */
 #define BITS_PER_BYTE           ( 1UL << LOG2_BITS_PER_BYTE )   /* Number of bits in a byte. This is used by the block bitmap implementation. */
 #define OTA_FILE_BLOCK_SIZE     ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE ) /* Data section size of the file data block message (excludes the header). */
+#define OTA_WINDOW_BITMAP_SIZE  32UL                            /* Max number of bytes of the bitmap of a windowed stream request (256 blocks from its offset). */
 
 typedef enum
 {
@@ -54,6 +56,7 @@ typedef enum
     eIngest_Result_Uninitialized = -127,   /* Software BUG: We forgot to set the result code. */
     eIngest_Result_Accepted_Continue = 0,  /* The block was accepted and we're expecting more. */
     eIngest_Result_Duplicate_Continue = 1, /* The block was a duplicate but that's OK. Continue. */
+    eIngest_Result_OutOfOrder_Continue = 2,/* The block can't be used yet, it will be requested again. Continue. */
 } IngestResult_t;
 
 /* Generic JSON document parser errors. */
@@ -68,8 +71,7 @@ typedef enum
     eDocParseErr_InvalidNumChar,        /* There was an invalid character in a numeric value field. */
     eDocParseErr_DuplicatesNotAllowed,  /* A duplicate parameter was found in the job document. */
     eDocParseErr_MalformedDoc,          /* The document didn't fulfill the model requirements. */
-    eDocParseErr_JasmineCountMismatch,  /* The second pass of jsmn_parse() didn't match the first pass. */
-    eDocParseErr_TooManyTokens,         /* We can't support the number of JSON tokens in the document. */
+    eDocParseErr_InvalidJSON,           /* The document is not valid JSON or nests objects too deep. */
     eDocParseErr_NoTokens,              /* No JSON tokens were detected in the document. */
     eDocParseErr_NullModelPointer,      /* The pointer to the document model was NULL. */
     eDocParseErr_NullBodyPointer,       /* The document model's internal body pointer was NULL. */
@@ -77,7 +79,7 @@ typedef enum
     eDocParseErr_TooManyParams,         /* The document model has more parameters than we can handle. */
     eDocParseErr_ParamKeyNotInModel,    /* The document model doesn't include the specified parameter key. */
     eDocParseErr_InvalidModelParamType, /* The document model specified an invalid parameter type. */
-    eDocParseErr_InvalidToken           /* The Jasmine token was invalid, producing a NULL pointer. */
+    eDocParseErr_InvalidToken           /* The JSON value was invalid, producing a NULL pointer. */
 } DocParseErr_t;
 
 /* Document model parameter types used by the JSON document parser. */
@@ -96,11 +98,11 @@ typedef enum
 /* This is a document parameter structure used by the document model. It determines
  * the type of parameter specified by the key name and where to store the parameter
  * locally when it is extracted from the JSON document. It also contains the
- * expected Jasmine type of the value field for validation.
+ * expected JSON type of the value field for validation.
  *
- * NOTE: The ulDestOffset field may be either an offset into the models context structure
+ * NOTE: The uxDestOffset field may be either an offset into the models context structure
  *       or an absolute memory pointer, although it is usually an offset.
- *       If the value of ulDestOffset is less than the size of the context structure,
+ *       If the value of uxDestOffset is less than the size of the context structure,
  *       which is fairly small, it will add the offset of the active context structure
  *       to attain the effective address (somewhere in RAM). Otherwise, it is interpreted
  *       as an absolute memory address and used as is (useful for singleton parameters).
@@ -113,11 +115,11 @@ typedef struct
     const bool_t bRequired; /* If true, this parameter must exist in the document. */
     union
     {
-        const uint32_t ulDestOffset;        /* Pointer or offset to where we'll store the value, if not ~0. */
+        const uintptr_t uxDestOffset;       /* Pointer or offset to where we'll store the value, if not ~0. */
         void * const pvDestOffset;          /* Pointer or offset to where we'll store the value, if not ~0. */
     };
     const ModelParamType_t xModelParamType; /* We extract the value, if found, based on this type. */
-    const jsmntype_t eJasmineType;          /* The JSON value type must match that specified here. */
+    const JSONScanType_t eJSONType;         /* The JSON value type must match that specified here. */
 } JSON_DocParam_t;
 
 
@@ -132,7 +134,7 @@ typedef struct
  */
 typedef struct
 {
-    uint32_t ulContextBase;            /* The base address of the destination OTA context structure. */
+    uintptr_t uxContextBase;           /* The base address of the destination OTA context structure. */
     uint32_t ulContextSize;            /* The size, in bytes, of the destination context structure. */
     const JSON_DocParam_t * pxBodyDef; /* Pointer to the document model body definition. */
     uint16_t usNumModelParams;         /* The number of entries in the document model (limited to 32). */
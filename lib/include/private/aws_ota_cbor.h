@@ -28,6 +28,9 @@
 
 /**
  * @brief Decode a Get Stream response message from AWS IoT OTA.
+ *
+ * The block payload is not copied: *ppucPayload is set to point into
+ * pucMessageBuffer, and is only valid as long as it is.
  */
 BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage(
     const uint8_t *pucMessageBuffer,
@@ -35,7 +38,7 @@ BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage(
     int32_t *plFileId,
     int32_t *plBlockId,
     int32_t *plBlockSize,
-    uint8_t **ppucPayload,
+    const uint8_t **ppucPayload,
     size_t *pxPayloadSize );
 
 /**
@@ -0,0 +1,152 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_decompress.h
+ * @brief Streaming decompression of compressed OTA files.
+ *
+ * A compressed update sends the file compressed. It is decompressed while it
+ * is received: each chunk is decoded as soon as it arrives, and the file is
+ * written in order through the window of the decoder, which takes
+ * 2^#otaconfigDECOMPRESS_WINDOW_BITS bytes. The files are compressed with
+ * tools/ota_compress.
+ *
+ * A compressed file starts with a header of 12 bytes: the magic "AFH1", the
+ * size of the decompressed file as a 32 bit little endian integer, the window
+ * and lookahead sizes (as powers of 2) the file was compressed with, and two
+ * zero bytes. It is followed by a heatshrink stream: bits read from the most
+ * significant bit of each byte, in which
+ *
+ * - a 1 bit is followed by a literal byte, in 8 bits.
+ * - a 0 bit is followed by a back reference: the offset minus 1 in window
+ *   bits, then the length minus 1 in lookahead bits. The length bytes are
+ *   copied one by one from offset bytes before, reading zeros before the
+ *   start of the file.
+ *
+ * The stream ends with the file, padded with zero bits up to a byte boundary.
+ */
+
+#ifndef _AWS_OTA_DECOMPRESS_H_
+#define _AWS_OTA_DECOMPRESS_H_
+
+#include <stdint.h>
+
+#include "aws_ota_agent_config.h"
+#include "aws_ota_agent_config_defaults.h"
+
+#define OTA_DECOMPRESS_HEADER_SIZE    12U                                          /* Size of the header of a compressed file. */
+#define OTA_DECOMPRESS_WINDOW_SIZE    ( 1UL << otaconfigDECOMPRESS_WINDOW_BITS ) /* Size of the largest window which can be decompressed. */
+
+/**
+ * @brief Return codes of the decompression functions.
+ */
+typedef enum OTA_DecompressErr
+{
+    eOTA_DecompressErr_None = 0,    /**< The compressed data was decoded. */
+    eOTA_DecompressErr_BadStream,   /**< The stream is malformed, ends early or needs a larger window. */
+    eOTA_DecompressErr_WriteFailed  /**< The decompressed file could not be written. */
+} OTA_DecompressErr_t;
+
+/**
+ * @brief Writes bytes of the decompressed file. The file is written in order.
+ *
+ * @return The number of bytes written, which is less than ulLength on failure.
+ */
+typedef int32_t ( * OTA_DecompressWrite_t )( void * pvContext,
+                                             uint32_t ulOffset,
+                                             const uint8_t * pucData,
+                                             uint32_t ulLength );
+
+/**
+ * @brief State of the decompression of a file.
+ *
+ * The members are private to the decompression functions.
+ */
+typedef struct OTA_Decompress
+{
+    OTA_DecompressWrite_t xWrite;                     /**< Writes the decompressed file. */
+    void * pvContext;                                 /**< Passed to xWrite. */
+    OTA_DecompressErr_t eError;                       /**< The error which stopped the decompression, if any. */
+    uint32_t ulSize;                                  /**< Size of the decompressed file. */
+    uint32_t ulProduced;                              /**< Number of bytes of the decompressed file decoded. */
+    uint32_t ulWritten;                               /**< Number of bytes of the decompressed file written. */
+    uint32_t ulBits;                                  /**< The bits received and not decoded yet, in the low ucBitCount bits. */
+    uint16_t usHead;                                  /**< Position in the window of the next byte decoded. */
+    uint16_t usFlushed;                               /**< Position in the window of the first byte not written. */
+    uint16_t usOffset;                                /**< Offset of the back reference being decoded. */
+    uint8_t ucBitCount;                               /**< Number of bits in ulBits. */
+    uint8_t ucState;                                  /**< What the stream is expected to contain next. */
+    uint8_t ucWindowBits;                             /**< Window size of the stream, as a power of 2. */
+    uint8_t ucLookaheadBits;                          /**< Lookahead size of the stream, as a power of 2. */
+    uint8_t ucHeader[ OTA_DECOMPRESS_HEADER_SIZE ];   /**< The header, as it is received. */
+    uint8_t ucHeaderLength;                           /**< Number of bytes in ucHeader. */
+    uint8_t ucWindow[ OTA_DECOMPRESS_WINDOW_SIZE ];   /**< The last bytes decoded, also written from here. */
+} OTA_Decompress_t;
+
+/**
+ * @brief Starts the decompression of a file.
+ *
+ * @param[out] pxDecompress The state to initialize.
+ * @param[in] xWrite Writes the decompressed file.
+ * @param[in] pvContext Passed as it is to xWrite.
+ */
+void OTA_DecompressInit( OTA_Decompress_t * pxDecompress,
+                         OTA_DecompressWrite_t xWrite,
+                         void * pvContext );
+
+/**
+ * @brief Decodes the next chunk of a compressed file.
+ *
+ * The chunks may be of any size, and are not referenced after the call. The
+ * decompressed file is written each time the window is full, and its last
+ * bytes by the call which decodes the end of the stream.
+ *
+ * @param[in] pxDecompress The state of the decompression.
+ * @param[in] pucData The next chunk of the compressed file.
+ * @param[in] ulLength The length of pucData.
+ *
+ * @return eOTA_DecompressErr_None, or the error which stopped the
+ *     decompression. No more chunks can be decoded after an error.
+ */
+OTA_DecompressErr_t OTA_DecompressApply( OTA_Decompress_t * pxDecompress,
+                                         const uint8_t * pucData,
+                                         uint32_t ulLength );
+
+/**
+ * @brief Checks that a compressed file was decoded up to its end.
+ *
+ * @return eOTA_DecompressErr_None if the decompressed file is complete;
+ *     eOTA_DecompressErr_BadStream if the stream ended early, or the error
+ *     which stopped it.
+ */
+OTA_DecompressErr_t OTA_DecompressFinish( const OTA_Decompress_t * pxDecompress );
+
+/**
+ * @brief Returns the size of the decompressed file, or 0 if the header of the
+ * compressed file was not decoded yet.
+ */
+uint32_t OTA_DecompressSize( const OTA_Decompress_t * pxDecompress );
+
+#endif /* _AWS_OTA_DECOMPRESS_H_ */
@@ -0,0 +1,169 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_delta.h
+ * @brief Streaming application of OTA delta patches.
+ *
+ * A delta update sends a patch instead of a whole file. The patch describes
+ * the new file in terms of the active image of the device, and is applied
+ * while it is received: each chunk of it is decoded as soon as it arrives,
+ * reading the active image and writing the new file in order, through a
+ * buffer of #otaconfigDELTA_BUFFER_SIZE bytes. The patches are created with
+ * tools/ota_delta.
+ *
+ * A patch starts with a header of 12 bytes: the magic "AFD1", then the sizes
+ * of the new file and of the active image it applies to, as 32 bit little
+ * endian integers. It is followed by records until the new file is complete.
+ * Each record is:
+ *
+ * - the diff length, the extra length and the seek, as varints (7 bits per
+ *   byte, least significant first, with the top bit set on all bytes but the
+ *   last). The seek is signed, zigzag encoded.
+ * - the diff data, as pairs of varints and bytes: the number of bytes equal
+ *   in both files, then the number of bytes which differ, followed by the
+ *   differences, new minus old modulo 256. The pairs cover the diff length,
+ *   reading the active image from its current offset, and no pair is empty.
+ * - the extra data, the extra length bytes copied into the new file as is.
+ *
+ * The offset in the active image, 0 at first, moves by the diff length then
+ * by the seek after each record.
+ */
+
+#ifndef _AWS_OTA_DELTA_H_
+#define _AWS_OTA_DELTA_H_
+
+#include <stdint.h>
+
+#include "aws_ota_agent_config.h"
+#include "aws_ota_agent_config_defaults.h"
+
+#define OTA_DELTA_HEADER_SIZE    12U /* Size of the header of a patch. */
+
+/**
+ * @brief Return codes of the patch functions.
+ */
+typedef enum OTA_DeltaErr
+{
+    eOTA_DeltaErr_None = 0,   /**< The patch data was applied. */
+    eOTA_DeltaErr_BadPatch,   /**< The patch is malformed, ends early or does not fit the active image. */
+    eOTA_DeltaErr_ReadFailed, /**< The active image could not be read. */
+    eOTA_DeltaErr_WriteFailed /**< The new file could not be written. */
+} OTA_DeltaErr_t;
+
+/**
+ * @brief Reads bytes of the active image.
+ *
+ * @return The number of bytes read, which is less than ulLength on failure.
+ */
+typedef int32_t ( * OTA_DeltaReadOld_t )( void * pvContext,
+                                          uint32_t ulOffset,
+                                          uint8_t * pucBuffer,
+                                          uint32_t ulLength );
+
+/**
+ * @brief Writes bytes of the new file. The new file is written in order.
+ *
+ * @return The number of bytes written, which is less than ulLength on failure.
+ */
+typedef int32_t ( * OTA_DeltaWriteNew_t )( void * pvContext,
+                                           uint32_t ulOffset,
+                                           const uint8_t * pucData,
+                                           uint32_t ulLength );
+
+/**
+ * @brief State of the application of a patch.
+ *
+ * The members are private to the patch functions.
+ */
+typedef struct OTA_Delta
+{
+    OTA_DeltaReadOld_t xReadOld;                       /**< Reads the active image. */
+    OTA_DeltaWriteNew_t xWriteNew;                     /**< Writes the new file. */
+    void * pvContext;                                  /**< Passed to xReadOld and xWriteNew. */
+    OTA_DeltaErr_t eError;                             /**< The error which stopped the patch, if any. */
+    uint32_t ulNewSize;                                /**< Size of the new file. */
+    uint32_t ulOldSize;                                /**< Size of the active image. */
+    uint32_t ulOldOffset;                              /**< Offset in the active image of the next diff byte. */
+    uint32_t ulWritten;                                /**< Number of bytes of the new file written. */
+    uint32_t ulDiffRemaining;                          /**< Diff bytes of the current record not produced yet. */
+    uint32_t ulExtraRemaining;                         /**< Extra bytes of the current record not produced yet. */
+    uint32_t ulSeek;                                   /**< Magnitude of the seek of the current record. */
+    uint32_t ulRunRemaining;                           /**< Differences of the current pair not received yet. */
+    uint32_t ulVarint;                                 /**< Value of the varint being received. */
+    uint8_t ucVarintShift;                             /**< Position of the next 7 bits of the varint being received. */
+    uint8_t ucState;                                   /**< What the patch is expected to contain next. */
+    uint8_t ucSeekBack;                                /**< Non-zero if the seek of the current record is negative. */
+    uint8_t ucEmptyRun;                                /**< Non-zero if the current pair has no equal bytes. */
+    uint16_t usBuffered;                               /**< Number of bytes in ucBuffer. */
+    uint8_t ucBuffer[ otaconfigDELTA_BUFFER_SIZE ];    /**< The header, then the next bytes of the new file. */
+} OTA_Delta_t;
+
+/**
+ * @brief Starts the application of a patch.
+ *
+ * @param[out] pxDelta The state to initialize.
+ * @param[in] xReadOld Reads the active image.
+ * @param[in] xWriteNew Writes the new file.
+ * @param[in] pvContext Passed as it is to xReadOld and xWriteNew.
+ */
+void OTA_DeltaInit( OTA_Delta_t * pxDelta,
+                    OTA_DeltaReadOld_t xReadOld,
+                    OTA_DeltaWriteNew_t xWriteNew,
+                    void * pvContext );
+
+/**
+ * @brief Applies the next chunk of a patch.
+ *
+ * The chunks may be of any size, and are not referenced after the call. The
+ * last bytes of the new file are written by the call which applies the end of
+ * the patch.
+ *
+ * @param[in] pxDelta The state of the patch.
+ * @param[in] pucPatch The next chunk of the patch.
+ * @param[in] ulLength The length of pucPatch.
+ *
+ * @return eOTA_DeltaErr_None, or the error which stopped the patch. No more
+ *     chunks can be applied after an error.
+ */
+OTA_DeltaErr_t OTA_DeltaApply( OTA_Delta_t * pxDelta,
+                               const uint8_t * pucPatch,
+                               uint32_t ulLength );
+
+/**
+ * @brief Checks that a patch was applied up to its end.
+ *
+ * @return eOTA_DeltaErr_None if the new file is complete; eOTA_DeltaErr_BadPatch
+ *     if the patch ended early, or the error which stopped it.
+ */
+OTA_DeltaErr_t OTA_DeltaFinish( const OTA_Delta_t * pxDelta );
+
+/**
+ * @brief Returns the size of the new file, or 0 if the header of the patch
+ * was not applied yet.
+ */
+uint32_t OTA_DeltaNewSize( const OTA_Delta_t * pxDelta );
+
+#endif /* _AWS_OTA_DELTA_H_ */
@@ -117,6 +117,8 @@ OTA_Err_t prvPAL_CloseFile( OTA_FileContext_t * const C );
  * The file pointer/handl,e C->pucFile, is checked for NULL by the OTA agent before this 
  * function is called.
  * pacData is checked for NULL by the OTA agent before this function is called.
+ * pacData points into the received stream message, so it may not be aligned and must
+ * not be modified.
  * ulBlockSize is validated for range by the OTA agent before this function is called.
  * ulBlockIndex is validated by the OTA agent before this function is called.
  * 
@@ -129,6 +131,91 @@ OTA_Err_t prvPAL_CloseFile( OTA_FileContext_t * const C );
  */
 int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pcData, uint32_t ulBlockSize );
 
+/**
+ * @brief Read bytes of the active firmware image.
+ *
+ * A delta update (see otaconfigENABLE_DELTA_UPDATE) receives a patch of the active image,
+ * which is read through this function as the patch is applied. The image is read as it was
+ * received by the OTA update which installed it, starting at the same offset 0, and must not
+ * change while the new file is written. The function is only called by the OTA agent if
+ * delta updates are enabled.
+ *
+ * @note The input OTA_FileContext_t C is the context of the file being written, which is open.
+ * pucBuffer is checked for NULL by the OTA agent before this function is called.
+ *
+ * @param[in] C OTA file context information.
+ * @param[in] ulOffset Byte offset to read from the beginning of the active image.
+ * @param[out] pucBuffer Pointer to the buffer to read into.
+ * @param[in] ulLength The number of bytes to read.
+ *
+ * @return The number of bytes read on success, or a negative error code from the platform
+ * abstraction layer, including if the bytes are not all within the active image.
+ */
+int32_t prvPAL_ReadActiveImage( OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pucBuffer, uint32_t ulLength );
+
+/**
+ * @brief Save the resume state of the file being received, or erase it.
+ *
+ * When downloads are resumed after a reset (see otaconfigENABLE_RESUME), the OTA agent
+ * saves which blocks of the file were received through this function, every few blocks.
+ * The state is an opaque record of the OTA agent, which replaces any state saved before.
+ * It must be kept across resets, in storage which isn't erased by prvPAL_CreateFileForRx.
+ * The function is only called by the OTA agent if resuming downloads is enabled.
+ *
+ * @note The blocks written to the receive file so far must be made persistent before the
+ * state is, since the blocks it marks as received aren't received again. The OTA agent
+ * detects a torn write of the state, so it needn't be written atomically.
+ *
+ * @param[in] C OTA file context information, or NULL if the state is erased.
+ * @param[in] pucState Pointer to the state to save, or NULL to erase the saved state.
+ * @param[in] ulLength The length of the state, or 0 to erase the saved state.
+ *
+ * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
+ * error codes information in aws_ota_agent.h.
+ *
+ * kOTA_Err_None is returned on success, including if there is no saved state to erase.
+ * kOTA_Err_ResumeStateFailed is returned if the state could not be saved or erased.
+ */
+OTA_Err_t prvPAL_SaveResumeState( OTA_FileContext_t * const C, const uint8_t * pucState, uint32_t ulLength );
+
+/**
+ * @brief Load the resume state saved by prvPAL_SaveResumeState.
+ *
+ * The OTA agent loads the state when it starts receiving a file, to check whether the file
+ * was partly received before a reset. The function is only called by the OTA agent if
+ * resuming downloads is enabled.
+ *
+ * @note pucState is checked for NULL by the OTA agent before this function is called.
+ *
+ * @param[out] pucState Pointer to the buffer to load the state into.
+ * @param[in] ulMaxLength The size of the buffer. A longer state is truncated.
+ *
+ * @return The number of bytes loaded, or a negative error code from the platform abstraction
+ * layer, including if there is no saved state.
+ */
+int32_t prvPAL_LoadResumeState( uint8_t * const pucState, uint32_t ulMaxLength );
+
+/**
+ * @brief Open the receive file partly received before a reset, to write its missing blocks.
+ *
+ * The OTA agent calls this function instead of prvPAL_CreateFileForRx when the resume state
+ * saved for the file matches the job, so the file must be opened as it was left, without
+ * being erased. The function is only called by the OTA agent if resuming downloads is enabled.
+ *
+ * @note The input OTA_FileContext_t C is checked for NULL by the OTA agent before this
+ * function is called, and C->pucFilePath is the path of the file created before the reset.
+ *
+ * @param[in] C OTA file context information.
+ *
+ * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
+ * error codes information in aws_ota_agent.h.
+ *
+ * kOTA_Err_None is returned when the file is open.
+ * kOTA_Err_RxFileCreateFailed is returned if the file doesn't exist or can't be resumed, in
+ * which case the OTA agent creates it again with prvPAL_CreateFileForRx.
+ */
+OTA_Err_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C );
+
 /** 
  * @brief Activate the newest MCU image received via OTA.
  * 
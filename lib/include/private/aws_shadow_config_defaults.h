@@ -32,9 +32,11 @@
 #define _AWS_SHADOW_CONFIG_DEFAULTS_H_
 
 /**
- * @brief Number of jsmn tokens to use in parsing.  Each jsmn token contains 4 ints.
- * Ensure that the number of tokens does not overflow the calling task's stack,
- * but is also sufficient to parse the largest expected JSON documents. */
+ * @brief Unused.
+ *
+ * The Shadow library used to parse JSON documents into this number of jsmn
+ * tokens. It now scans them with the streaming JSON scanner (see
+ * aws_json_scanner.h), which has no limit on the size of the documents. */
 #ifndef shadowconfigJSON_JSMN_TOKENS
     #define shadowconfigJSON_JSMN_TOKENS    ( 64 )
 #endif
@@ -77,6 +79,95 @@
     #define shadowconfigMAX_THINGS_WITH_CALLBACKS    ( 1 )
 #endif
 
+/**
+ * @brief Number of operations which may be in progress simultaneously on each
+ * Shadow Client.
+ *
+ * #SHADOW_Update, #SHADOW_Get and #SHADOW_Delete calls made from different
+ * tasks wait for their accepted or rejected responses concurrently, up to this
+ * number. Further calls block until one of the operations completes. The
+ * responses are routed to the waiting operations by client token.
+ */
+#ifndef shadowconfigMAX_CONCURRENT_OPERATIONS
+    #define shadowconfigMAX_CONCURRENT_OPERATIONS    ( 4 )
+#endif
+
+/**
+ * @brief Maximum length of the client token of a Shadow operation.
+ *
+ * The client token of an update document must not be longer than this, or the
+ * update fails. The Shadow service does not accept client tokens longer than
+ * 64 bytes.
+ *
+ * @note Must be at least 16, the length of the client tokens generated for
+ * #SHADOW_Get and #SHADOW_Delete.
+ */
+#ifndef shadowconfigMAX_CLIENT_TOKEN_LENGTH
+    #define shadowconfigMAX_CLIENT_TOKEN_LENGTH    ( 64 )
+#endif
+
+/**
+ * @brief Enable the local Shadow document cache.
+ *
+ * The cache (see aws_shadow_cache.h) keeps the last acknowledged reported and
+ * desired state of a Thing Shadow, so that only the changed fields are
+ * published.
+ */
+#ifndef shadowconfigENABLE_DOCUMENT_CACHE
+    #define shadowconfigENABLE_DOCUMENT_CACHE    ( 0 )
+#endif
+
+/**
+ * @brief Number of reported fields, and of desired fields, a Shadow document
+ * cache can hold.
+ *
+ * A field is a value which is not an object, such as "color" in
+ * {"light":{"color":"red"}}. Arrays are stored as single fields.
+ *
+ * @note Should be less than 256.
+ */
+#ifndef shadowconfigCACHE_MAX_FIELDS
+    #define shadowconfigCACHE_MAX_FIELDS    ( 16 )
+#endif
+
+/**
+ * @brief Maximum length of the path of a field in a Shadow document cache,
+ * including the NULL terminator.
+ *
+ * The path of a field joins the keys leading to it with dots, for example
+ * "light.color".
+ */
+#ifndef shadowconfigCACHE_MAX_PATH_LENGTH
+    #define shadowconfigCACHE_MAX_PATH_LENGTH    ( 32 )
+#endif
+
+/**
+ * @brief Maximum length of the JSON text of a field value in a Shadow
+ * document cache, including the NULL terminator.
+ */
+#ifndef shadowconfigCACHE_MAX_VALUE_LENGTH
+    #define shadowconfigCACHE_MAX_VALUE_LENGTH    ( 32 )
+#endif
+
+/**
+ * @brief Size of the buffer in which a Shadow document cache builds its
+ * update documents.
+ */
+#ifndef shadowconfigCACHE_DOCUMENT_LENGTH
+    #define shadowconfigCACHE_DOCUMENT_LENGTH    ( 512 )
+#endif
+
+/**
+ * @brief Time (in milliseconds) during which the changes made to a Shadow
+ * document cache are coalesced into one update.
+ *
+ * #SHADOW_CacheFlush does not publish the changes before this time has
+ * elapsed since the first of them was made, unless forced to.
+ */
+#ifndef shadowconfigCACHE_COALESCE_MS
+    #define shadowconfigCACHE_COALESCE_MS    ( 1000UL )
+#endif
+
 /**
  * @brief Time (in milliseconds) a Shadow Client may block during cleanup @b IF
  * a timeout occurs.
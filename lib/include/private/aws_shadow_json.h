@@ -35,19 +35,22 @@
 #include "FreeRTOS.h"
 
 /**
- * @brief Check if the client tokens in pcDoc1 and pcDoc2 match.
+ * @brief Finds the client token in a Shadow JSON document.
  *
- * @param[in] pcDoc1, pcDoc2 JSON strings
- * @param[in] ulDoc1Length, ulDoc2Length the lengths of pcDoc1 and pcDoc2,
- *     respectively
- * @return pdTRUE if the client tokens in pcDoc1 and pcDoc2 match; pdFALSE
- *     if the client tokens don't match; jsmn error (see jsmn.h) if jsmn
- *     fails to parse either string.
+ * Only the "clientToken" member of the top-level object is looked up; keys of
+ * the same name nested in other members are ignored. The document is scanned
+ * up to the client token.
+ *
+ * @param[in] pcDoc JSON string
+ * @param[in] ulDocLength the length of pcDoc
+ * @param[out] ppcClientToken set to the location of the client token in pcDoc,
+ *     without the quotes.
+ * @return the length of the client token; 0 if pcDoc has no client token
+ *     string or is not valid JSON before it.
  */
-BaseType_t SHADOW_JSONDocClientTokenMatch( const char * const pcDoc1,
-                                           uint32_t ulDoc1Length,
-                                           const char * const pcDoc2,
-                                           uint32_t ulDoc2Length );
+uint16_t SHADOW_JSONGetClientToken( const char * const pcDoc,
+                                    uint32_t ulDocLength,
+                                    const char ** ppcClientToken );
 
 /**
  * @brief Extracts the error code and message from a Shadow error JSON string.
@@ -58,12 +61,56 @@ BaseType_t SHADOW_JSONDocClientTokenMatch( const char * const pcDoc1,
  *     Pass NULL to ignore error message.
  * @param[out] pusErrorMessageLength set to the size of the error message
  *     Pass NULL to ignore error message.
- * @return a positive code corresponding to an error reason on success; jsmn error
- *     (see jsmn.h) if jsmn fails to parse pcErrorJSON; 0 for bad pointer arguments
+ * @return a positive code corresponding to an error reason on success; a
+ *     negative Shadow return code (see aws_shadow.h) if pcErrorJSON is not
+ *     valid JSON; 0 if pcErrorJSON has no error code
  */
 int16_t SHADOW_JSONGetErrorCodeAndMessage( const char * const pcErrorJSON,
                                            uint32_t ulErrorJSONLength,
                                            char ** ppcErrorMessage,
                                            uint16_t * pusErrorMessageLength );
 
+/**
+ * @brief Function signature of the callback invoked for each field of the
+ * state of a Shadow JSON document.
+ *
+ * @param[in] pvContext The context given to #SHADOW_JSONForEachStateField.
+ * @param[in] pcPath The keys leading to the field from the state object,
+ *     joined with dots and NULL terminated, for example "reported.color".
+ * @param[in] usPathLength the length of pcPath
+ * @param[in] pcValue the JSON text of the value, with the quotes of a string.
+ * @param[in] usValueLength the length of pcValue
+ */
+typedef void ( * ShadowJSONFieldCallback_t )( void * pvContext,
+                                              const char * pcPath,
+                                              uint16_t usPathLength,
+                                              const char * pcValue,
+                                              uint16_t usValueLength );
+
+/**
+ * @brief Invokes a callback for each field of the state of a Shadow JSON
+ * document.
+ *
+ * The fields are the values of the "state" object, and of the objects nested
+ * in it, which are not objects themselves. Arrays are passed as single fields.
+ * The document is scanned once, up to the end of the state, and the version is
+ * looked up before.
+ *
+ * @param[in] pcDoc JSON string
+ * @param[in] ulDocLength the length of pcDoc
+ * @param[in,out] pulVersion if not NULL and pcDoc has a version, the fields
+ *     are only visited if the version of pcDoc is newer than *pulVersion
+ *     (0 meaning no version), and *pulVersion is then set to it.
+ * @param[in] xCallback the function invoked for each field
+ * @param[in] pvContext passed as it is to xCallback
+ * @return the number of fields visited; a negative Shadow return code (see
+ *     aws_shadow.h) if pcDoc is not valid JSON, in which case the fields
+ *     preceding the error may have been visited.
+ */
+int16_t SHADOW_JSONForEachStateField( const char * const pcDoc,
+                                      uint32_t ulDocLength,
+                                      uint32_t * pulVersion,
+                                      ShadowJSONFieldCallback_t xCallback,
+                                      void * pvContext );
+
 #endif /* _AWS_SHADOW_JSON_H_ */
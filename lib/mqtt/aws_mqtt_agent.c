@@ -33,6 +33,7 @@
 #include "aws_mqtt_agent.h"
 #include "aws_mqtt_agent_config.h"
 #include "aws_mqtt_agent_config_defaults.h"
+#include "aws_mqtt_inflight_store.h"
 
 /* Buffer Pool includes. */
 #include "aws_bufferpool.h"
@@ -54,11 +55,41 @@
  * tasks to the MQTT task.
  *
  * The queue can have a maximum of mqttconfigMAX_PARALLEL_OPS parallel operations
- * for each broker connection at any one time. The socket wake callback will only
- * post to the queue if the queue is empty, so there is no need to leave space for
- * that.
+ * for each broker connection it serves at any one time, plus one per asynchronous
+ * publish operation. The socket wake callback will only post to the queue if the
+ * queue is empty, so there is no need to leave space for that.
  */
-#define mqttCOMMAND_QUEUE_LENGTH    ( ( UBaseType_t ) ( mqttconfigMAX_BROKERS * mqttconfigMAX_PARALLEL_OPS ) )
+#if ( mqttconfigTASK_PER_BROKER == 1 )
+    #define mqttCOMMAND_QUEUE_LENGTH    ( ( UBaseType_t ) ( mqttconfigMAX_PARALLEL_OPS + mqttconfigMAX_ASYNC_PUBLISHES ) )
+#else
+    #define mqttCOMMAND_QUEUE_LENGTH    ( ( UBaseType_t ) ( ( mqttconfigMAX_BROKERS * mqttconfigMAX_PARALLEL_OPS ) + mqttconfigMAX_ASYNC_PUBLISHES ) )
+#endif
+
+/**
+ * @brief The number of MQTT tasks, each with its own command queue.
+ */
+#if ( mqttconfigTASK_PER_BROKER == 1 )
+    #define mqttTASK_COUNT    ( ( UBaseType_t ) mqttconfigMAX_BROKERS )
+#else
+    #define mqttTASK_COUNT    ( ( UBaseType_t ) 1 )
+#endif
+
+/**
+ * @brief Gets the index of the MQTT task servicing a broker connection.
+ *
+ * @param[in] uxBrokerNumber The broker number, indexed from 0.
+ */
+#if ( mqttconfigTASK_PER_BROKER == 1 )
+    #define mqttTASK_INDEX( uxBrokerNumber )    ( uxBrokerNumber )
+#else
+    #define mqttTASK_INDEX( uxBrokerNumber )    ( ( UBaseType_t ) 0 )
+#endif
+
+/**
+ * @brief Size of the buffer holding the name of an MQTT task, "MQTT" followed by
+ * the index of the task when there is one per broker, and the NULL terminator.
+ */
+#define mqttTASK_NAME_LENGTH    ( 16 )
 
 /**
  * @defgroup MessageIdentifer Macros related to message identifier.
@@ -137,7 +168,8 @@ typedef enum
     eMQTTDisconnectRequest,  /**< Disconnect the connection to an MQTT broker. */
     eMQTTSubscribeRequest,   /**< Initiate a subscribe to a topic.  _TODO_ Currently limited to one topic per subscribe message. */
     eMQTTUnsubscribeRequest, /**< Initiate unsubscribe from a topic.  _TODO_ Currently limited to one topic per unsubscribe message. */
-    eMQTTPublishRequest      /**< Initiate a publish to a topic.  _TODO_ Currently limited to one topic per publish message. */
+    eMQTTPublishRequest,     /**< Initiate a publish to a topic.  _TODO_ Currently limited to one topic per publish message. */
+    eMQTTPublishAsyncRequest /**< Initiate a publish to a topic without blocking the requesting task. */
 } MQTTAction_t;
 
 /**
@@ -177,6 +209,26 @@ typedef struct MQTTNotificationData
     uint32_t ulMessageIdentifier; /**< Used to match a request going from application task to MQTT task with response going the other way. */
 } MQTTNotificationData_t;
 
+/**
+ * @brief Stores the state of a publish operation initiated with MQTT_AGENT_PublishAsync.
+ *
+ * These are shared by all the connections. They are allocated by application tasks
+ * (prvGetFreeAsyncPublish) and freed by the MQTT task (prvCompleteAsyncPublish),
+ * hence xInUse must be accessed in critical section. When mqttconfigTASK_PER_BROKER
+ * is 1, the MQTT task of each broker also scans the operations of the others, so
+ * xAwaitingAck and the scans are in critical section too.
+ */
+typedef struct MQTTAsyncPublish
+{
+    BaseType_t xInUse;                                  /**< Tracks whether or not the operation is in progress. */
+    BaseType_t xAwaitingAck;                            /**< Set once the message is sent and the MQTT task waits for the acknowledgment. Accessed in critical section. */
+    UBaseType_t uxBrokerNumber;                         /**< The broker the message is published to, indexed from 0. */
+    uint32_t ulMessageIdentifier;                       /**< The top 16 bits are the packet identifier of the message. */
+    MQTTAgentPublishParams_t xPublishParams;            /**< Copy of the publish parameters supplied by the user. */
+    MQTTAgentCompletionCallback_t pxCompletionCallback; /**< The callback to invoke when the operation completes. Can be NULL. */
+    void * pvCompletionContext;                         /**< Passed as it is to the completion callback. */
+} MQTTAsyncPublish_t;
+
 /**
  * @brief Contents of the message sent from an application task to the MQTT task to
  * initiate an MQTT operation.
@@ -198,6 +250,7 @@ typedef struct MQTTEventData
         const MQTTAgentSubscribeParams_t * pxSubscribeParams;     /**< Subscribe Parameters. */
         const MQTTAgentUnsubscribeParams_t * pxUnsubscribeParams; /**< Unsubscribe Parameters. */
         const MQTTAgentPublishParams_t * pxPublishParams;         /**< Publish Parameters. */
+        MQTTAsyncPublish_t * pxAsyncPublish;                      /**< Asynchronous publish operation. */
     } u;
 } MQTTEventData_t;
 
@@ -217,6 +270,24 @@ typedef struct MQTTBrokerConnection
     MQTTAgentCallback_t pxCallback;                                     /**< The callback to notify user of various events including the Publish messages received from the broker. */
     UBaseType_t uxFlags;                                                /**< Various properties of the connection - secured etc. */
     BaseType_t xConnectionInUse;                                        /**< Tracks whether or not the connection is in use. It is accessed from application tasks (prvGetFreeConnection and prvReturnConnection) and hence should be accessed in critical section. */
+    BaseType_t xWakeupCallbackSet;                                      /**< Whether or not the socket accepted the wakeup callback. If not, the socket is read on every iteration of the MQTT task. */
+    volatile BaseType_t xDataAvailable;                                 /**< Set when the socket may have data to read. It is set from the wakeup callback, which runs in the context of the network stack. */
+    #if ( mqttconfigTX_BATCH_SIZE > 0 )
+        uint8_t ucTxBatch[ mqttconfigTX_BATCH_SIZE ];                   /**< Gathers the outgoing packets so that they are sent with one SOCKETS_Send call. */
+        uint32_t ulTxBatchLength;                                       /**< Number of bytes in ucTxBatch. */
+        TickType_t xTxBatchStartTicks;                                  /**< Tick count when the first packet was added to the empty ucTxBatch. */
+    #endif
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+            MQTTOfflineSpool_t xRamQueue;                               /**< Queues the messages published while disconnected. */
+            MQTTOfflineRamFlash_t xRamQueueRegion;                      /**< The region of xRamQueue. */
+        #endif
+        MQTTOfflineSpool_t xSpool;                                      /**< Queues the messages published while disconnected once xRamQueue is full. */
+        BaseType_t xSpoolSet;                                           /**< Whether or not xSpool has been supplied a region by MQTT_AGENT_SetOfflineSpool. */
+        MQTTAgentOfflineQueueStats_t xOfflineQueueStats;                /**< Depth and counters of the queue. Read by application tasks and hence accessed in critical section. */
+        TickType_t xReplayWindowStartTicks;                             /**< Tick count when the current window of mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS started. */
+        uint32_t ulReplayedInWindow;                                    /**< Number of messages published from the queue in the current window. */
+    #endif
     uint8_t ucRxBuffer[ mqttconfigRX_BUFFER_SIZE ];                     /**< Buffers incoming messages. */
 } MQTTBrokerConnection_t;
 /*-----------------------------------------------------------*/
@@ -253,21 +324,53 @@ static const uint16_t usUserNameLength = ( uint16_t ) ( sizeof( cUserName ) - 1U
 static MQTTBrokerConnection_t xMQTTConnections[ mqttconfigMAX_BROKERS ];
 
 /**
- * @brief Handle of the command queue used to pass commands from application
- * tasks to the MQTT task.
+ * @brief Handles of the command queues used to pass commands from application
+ * tasks to the MQTT tasks.
+ *
+ * There is one per broker connection if mqttconfigTASK_PER_BROKER is set to 1,
+ * otherwise a single one serves all the connections.
  */
-static QueueHandle_t xCommandQueue = NULL;
+static QueueHandle_t xCommandQueues[ mqttTASK_COUNT ] = { NULL };
 
 /**
- * @brief Handle of the MQTT task.
+ * @brief Handles of the MQTT tasks, one per command queue.
  */
-static TaskHandle_t xMQTTTaskHandle = NULL;
+static TaskHandle_t xMQTTTaskHandles[ mqttTASK_COUNT ] = { NULL };
 
 /**
  * @brief Used to match commands sent to the MQTT task to replies coming from the
  * MQTT task.
  */
 static uint32_t ulQueueMessageIdentifier = 0;
+
+/**
+ * @brief The asynchronous publish operations in progress.
+ *
+ * The QoS1 and QoS2 ones stay in progress until the broker acknowledges
+ * the message, so this bounds the number of messages an application task
+ * can keep outstanding without waiting.
+ */
+static MQTTAsyncPublish_t xAsyncPublishes[ mqttconfigMAX_ASYNC_PUBLISHES ];
+
+/**
+ * @brief The in-flight stores of the brokers and their memory.
+ *
+ * The QoS1 and QoS2 messages are kept in them until acknowledged by
+ * the broker and re-transmitted on reconnect.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigINFLIGHT_STORE_SIZE > 0 )
+    static MQTTInflightRingStore_t xInflightStores[ mqttconfigMAX_BROKERS ];
+    static uint8_t ucInflightStoreStorage[ mqttconfigMAX_BROKERS ][ mqttconfigINFLIGHT_STORE_SIZE ];
+#endif
+
+/**
+ * @brief The memory of the RAM offline queues of the brokers.
+ *
+ * Declared as words, as the regions of a spool must be aligned on 4 bytes.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) && ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+    static uint32_t ulOfflineQueueStorage[ mqttconfigMAX_BROKERS ][ ( mqttconfigOFFLINE_QUEUE_RAM_BLOCK_SIZE * mqttconfigOFFLINE_QUEUE_RAM_BLOCKS ) / 4 ];
+#endif
 /*-----------------------------------------------------------*/
 
 /**
@@ -396,8 +499,9 @@ static void prvGracefulSocketClose( MQTTBrokerConnection_t * const pxConnection
 /**
  * @brief The callback registered with the socket to get notified of the available data to read on the socket.
  *
- * This function just posts a eMQTTServiceSocket request to the MQTT command queue to
- * unblock the MQTT task in order to ensure that the available data is read and processed.
+ * This function marks the connection using the socket as having data available and posts
+ * a eMQTTServiceSocket request to the MQTT command queue to unblock the MQTT task in order
+ * to ensure that the available data is read and processed.
  *
  * @param[in] pxSocket The socket on which the data is available for reading.
  */
@@ -440,10 +544,11 @@ static void prvProcessReceivedUNSUBACK( MQTTBrokerConnection_t * const pxConnect
                                         const MQTTEventCallbackParams_t * const pxParams );
 
 /**
- * @brief Notifies the application task about the received PUBACK message.
+ * @brief Notifies the application task about the received PUBACK or PUBCOMP message.
  *
  * Retrieves the notification data corresponding to the task which initiated the Publish operation.
- * If there is a task waiting for the PUBACK, notifies the task otherwise silently ignores the PUBACK.
+ * If there is a task waiting for the PUBACK (or PUBCOMP in case of QoS2), notifies the task otherwise
+ * silently ignores it.
  *
  * @param[in] pxConnection The MQTTBrokerConnection_t corresponding to the connection on which PUBACK is received.
  * @param[in] pxParams The parameters received in the callback form the MQTT Core library containing relevant data.
@@ -465,6 +570,20 @@ static void prvProcessReceivedPUBACK( MQTTBrokerConnection_t * const pxConnectio
 static BaseType_t prvProcessReceivedPublish( MQTTBrokerConnection_t * const pxConnection,
                                              const MQTTEventCallbackParams_t * const pxParams );
 
+/**
+ * @brief Notifies the user about a received chunk of a Publish message.
+ *
+ * If the user has registered a callback, invokes the callback to pass the chunk
+ * otherwise silently ignores it.
+ *
+ * @param[in] pxConnection The MQTTBrokerConnection_t corresponding to the connection on which the chunk is received.
+ * @param[in] pxParams The parameters received in the callback form the MQTT Core library containing relevant data.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+    static void prvProcessReceivedPublishChunk( MQTTBrokerConnection_t * const pxConnection,
+                                                const MQTTEventCallbackParams_t * const pxParams );
+#endif
+
 /**
  * @brief Notifies the application task about the timeout.
  *
@@ -509,13 +628,27 @@ static void prvNotifyRequestingTask( MQTTNotificationData_t * const pxNotificati
 /**
  * @brief Called on each iteration of the MQTT task to service connected sockets.
  *
- * For all the connected sockets, it reads the available data and passes it to the
- * MQTT Core library. It also invokes the MQTT_Periodic function of the core library
- * to ensure regular timeout and keep alive processing.
+ * For all the connected sockets serviced by the calling MQTT task, it reads the
+ * available data and passes it to the MQTT Core library. It also invokes the
+ * MQTT_Periodic function of the core library to ensure regular timeout and keep
+ * alive processing.
+ *
+ * @param[in] uxTaskIndex The index of the calling MQTT task.
  *
  * @return Time in ticks when the next invocation of MQTT_Periodic is required.
  */
-static TickType_t prvManageConnections( void );
+static TickType_t prvManageConnections( UBaseType_t uxTaskIndex );
+
+/**
+ * @brief Checks whether or not the calling task is one of the MQTT tasks.
+ *
+ * Commands must not be sent from the MQTT tasks (which could be the case if a
+ * command is sent from a callback function), as they could end up waiting for
+ * themselves or for each other.
+ *
+ * @return pdTRUE if the calling task is an MQTT task, pdFALSE otherwise.
+ */
+static BaseType_t prvIsMQTTTask( void );
 
 /**
  * @brief Initiates the MQTT Connect operation.
@@ -586,6 +719,132 @@ static void prvInitiateMQTTUnSubscribe( MQTTEventData_t * const pxEventData );
  */
 static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData );
 
+/**
+ * @brief Initiates an MQTT Publish operation requested with MQTT_AGENT_PublishAsync.
+ *
+ * Calls the publish function of the core MQTT library. The operation completes
+ * immediately in case of QoS0 or if the publish fails, otherwise when the
+ * acknowledgment is received, the operation times out or the connection is lost.
+ *
+ * @param[in] pxEventData The event data as posted by application task to the command queue.
+ */
+static void prvInitiateMQTTPublishAsync( MQTTEventData_t * const pxEventData );
+
+/**
+ * @brief Sets up the publish parameters and calls the publish function of the core
+ * MQTT library.
+ *
+ * @param[in] pxConnection The connection to publish the message on.
+ * @param[in] pxAgentPublishParams The publish parameters supplied by the user.
+ * @param[in] ulMessageIdentifier The message identifier of the operation.
+ * @param[in] xTicksToWait Time in ticks to wait for the acknowledgment.
+ *
+ * @return The return code of the core MQTT library.
+ */
+static MQTTReturnCode_t prvPublish( MQTTBrokerConnection_t * const pxConnection,
+                                   const MQTTAgentPublishParams_t * const pxAgentPublishParams,
+                                   uint32_t ulMessageIdentifier,
+                                   TickType_t xTicksToWait );
+
+/**
+ * @brief Allocates the state of an asynchronous publish operation.
+ *
+ * @return A free MQTTAsyncPublish_t, or NULL if mqttconfigMAX_ASYNC_PUBLISHES
+ * operations are already in progress.
+ */
+static MQTTAsyncPublish_t * prvGetFreeAsyncPublish( void );
+
+/**
+ * @brief Retrieves the asynchronous publish operation waiting for the acknowledgment
+ * of the given packet identifier.
+ *
+ * @param[in] pxConnection The connection on which the acknowledgment was received.
+ * @param[in] usPacketIdentifier The packet identifier of the acknowledged message.
+ *
+ * @return The operation, or NULL if no asynchronous publish operation is waiting
+ * for this acknowledgment.
+ */
+static MQTTAsyncPublish_t * prvRetrieveAsyncPublish( const MQTTBrokerConnection_t * const pxConnection,
+                                                     uint16_t usPacketIdentifier );
+
+/**
+ * @brief Frees an asynchronous publish operation and invokes its completion callback.
+ *
+ * @param[in] pxAsyncPublish The operation which completed.
+ * @param[in] xReturnCode The result of the operation.
+ */
+static void prvCompleteAsyncPublish( MQTTAsyncPublish_t * const pxAsyncPublish,
+                                     MQTTAgentReturnCode_t xReturnCode );
+
+/**
+ * @brief Returns the message identifier to use for the next request sent to the MQTT task.
+ *
+ * @return The message identifier. Only the top 16 bits are used.
+ */
+static uint32_t prvGetNextMessageIdentifier( void );
+
+/**
+ * @brief Empties the offline queue of a connection and forgets its spool.
+ *
+ * @param[in] pxConnection The connection.
+ * @param[in] uxBrokerNumber The broker number of the connection, indexed from 0.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static void prvResetOfflineQueue( MQTTBrokerConnection_t * const pxConnection,
+                                      UBaseType_t uxBrokerNumber );
+#endif
+
+/**
+ * @brief Checks whether a message published on a connection must be queued.
+ *
+ * The messages are queued while the connection is not established and, so that
+ * they stay in order, as long as the queue is not empty.
+ *
+ * @param[in] pxConnection The connection.
+ *
+ * @return pdTRUE if the message must be queued, pdFALSE if it can be published.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static BaseType_t prvIsOfflineQueueInUse( const MQTTBrokerConnection_t * const pxConnection );
+#endif
+
+/**
+ * @brief Queues a message published on a connection.
+ *
+ * @param[in] pxConnection The connection.
+ * @param[in] pxAgentPublishParams The message.
+ *
+ * @return pdPASS if the message was queued, pdFAIL if the queue is full.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static BaseType_t prvQueueOfflinePublish( MQTTBrokerConnection_t * const pxConnection,
+                                              const MQTTAgentPublishParams_t * const pxAgentPublishParams );
+#endif
+
+/**
+ * @brief Publishes the queued messages of an established connection, at most
+ * mqttconfigOFFLINE_QUEUE_REPLAY_BURST every mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS.
+ *
+ * A message is removed from the queue once the core library accepted it. The QoS1
+ * and QoS2 ones are then re-transmitted by the in-flight store, if any.
+ *
+ * @param[in] pxConnection The connection.
+ *
+ * @return The time in ticks after which the function must be called again.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static TickType_t prvReplayOfflineQueue( MQTTBrokerConnection_t * const pxConnection );
+#endif
+
+/**
+ * @brief Updates the depth of the offline queue of a connection in its statistics.
+ *
+ * @param[in] pxConnection The connection.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static void prvUpdateOfflineQueueStats( MQTTBrokerConnection_t * const pxConnection );
+#endif
+
 /*
  * @brief Posts the event to the command queue and waits for the notification from the MQTT task.
  *
@@ -614,9 +873,50 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
  * It wakes up periodically and calls prvManageConnections() in order to
  * ensure regular timeout and keep alive processing by the MQTT Core library.
  *
- * @param[in] pvParameters The parameters as specified when creating the task, NULL in this case.
+ * @param[in] pvParameters The parameters as specified when creating the task, the index
+ * of the task in this case.
  */
 static void prvMQTTTask( void * pvParameters );
+
+/**
+ * @brief Gets the name of an MQTT task.
+ *
+ * The MQTT tasks are named "MQTT0", "MQTT1"... when there is one per broker,
+ * so that they can be told apart in the debugger, and "MQTT" otherwise.
+ *
+ * @param[in] uxTaskIndex The index of the task.
+ * @param[out] pcTaskName The buffer of mqttTASK_NAME_LENGTH bytes to write the
+ * NULL terminated name to.
+ */
+static void prvGetTaskName( UBaseType_t uxTaskIndex,
+                            char * const pcTaskName );
+
+/**
+ * @brief Sends data over the socket of a connection.
+ *
+ * Keeps re-trying until all the data is sent, mqttconfigTCP_SEND_TIMEOUT_MS
+ * elapses or any error other than SOCKETS_EWOULDBLOCK occurs.
+ *
+ * @param[in] pxConnection The connection to send the data on.
+ * @param[in] pucData The data to send.
+ * @param[in] ulDataLength Length of the data.
+ *
+ * @return The number of actually transmitted bytes.
+ */
+static uint32_t prvSocketSend( MQTTBrokerConnection_t * const pxConnection,
+                               const uint8_t * const pucData,
+                               uint32_t ulDataLength );
+
+/**
+ * @brief Sends the packets gathered in the batch of a connection and empties it.
+ *
+ * @param[in] pxConnection The connection whose batch to send.
+ *
+ * @return pdPASS if the batch was empty or completely sent, pdFAIL otherwise.
+ */
+#if ( mqttconfigTX_BATCH_SIZE > 0 )
+    static BaseType_t prvFlushTxBatch( MQTTBrokerConnection_t * const pxConnection );
+#endif
 /*-----------------------------------------------------------*/
 
 static uint32_t prvMQTTSendCallback( void * pvSendContext,
@@ -625,20 +925,67 @@ static uint32_t prvMQTTSendCallback( void * pvSendContext,
 {
     MQTTBrokerConnection_t * pxConnection;
     UBaseType_t uxBrokerNumber = ( UBaseType_t ) pvSendContext; /*lint !e923 The cast is ok as we passed the index of the client before. */
-    int32_t lSendRetVal;
     uint32_t ulBytesSent = 0;
-    TimeOut_t xTimestamp;
-    TickType_t xTicksToWait = pdMS_TO_TICKS( mqttconfigTCP_SEND_TIMEOUT_MS );
 
     /* Broker number must be valid. */
     configASSERT( uxBrokerNumber < ( UBaseType_t ) mqttconfigMAX_BROKERS );
 
-    /* Record the timestamp when this function was called. */
-    vTaskSetTimeOutState( &( xTimestamp ) );
-
     /* Get the actual connection to the broker. */
     pxConnection = &( xMQTTConnections[ uxBrokerNumber ] );
 
+    #if ( mqttconfigTX_BATCH_SIZE > 0 )
+        {
+            BaseType_t xBatchSent = pdPASS;
+
+            /* Make room in the batch if the packet does not fit. */
+            if( ulDataLength > ( ( uint32_t ) mqttconfigTX_BATCH_SIZE - pxConnection->ulTxBatchLength ) )
+            {
+                xBatchSent = prvFlushTxBatch( pxConnection );
+            }
+
+            /* The packets which fit are only copied to the batch, which is sent
+             * by prvManageConnections. The larger ones are sent straight away,
+             * after the batch to preserve the ordering. */
+            if( xBatchSent == pdFAIL )
+            {
+                mqttconfigDEBUG_LOG( ( "Failed to send the batched packets.\r\n" ) );
+            }
+            else if( ulDataLength <= ( uint32_t ) mqttconfigTX_BATCH_SIZE )
+            {
+                if( pxConnection->ulTxBatchLength == ( uint32_t ) 0 )
+                {
+                    pxConnection->xTxBatchStartTicks = xTaskGetTickCount();
+                }
+
+                memcpy( &( pxConnection->ucTxBatch[ pxConnection->ulTxBatchLength ] ), pucData, ( size_t ) ulDataLength );
+                pxConnection->ulTxBatchLength += ulDataLength;
+                ulBytesSent = ulDataLength;
+            }
+            else
+            {
+                ulBytesSent = prvSocketSend( pxConnection, pucData, ulDataLength );
+            }
+        }
+    #else /* if ( mqttconfigTX_BATCH_SIZE > 0 ) */
+        ulBytesSent = prvSocketSend( pxConnection, pucData, ulDataLength );
+    #endif /* mqttconfigTX_BATCH_SIZE */
+
+    return ulBytesSent;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvSocketSend( MQTTBrokerConnection_t * const pxConnection,
+                               const uint8_t * const pucData,
+                               uint32_t ulDataLength )
+{
+    int32_t lSendRetVal;
+    uint32_t ulBytesSent = 0;
+    TimeOut_t xTimestamp;
+    TickType_t xTicksToWait = pdMS_TO_TICKS( mqttconfigTCP_SEND_TIMEOUT_MS );
+
+    /* Record the timestamp when this function was called. */
+    vTaskSetTimeOutState( &( xTimestamp ) );
+
     /* Keep re-trying until timeout or any error
      * other than SOCKETS_EWOULDBLOCK occurs. */
     while( ulBytesSent < ulDataLength )
@@ -677,6 +1024,32 @@ static uint32_t prvMQTTSendCallback( void * pvSendContext,
     return ulBytesSent;
 }
 /*-----------------------------------------------------------*/
+
+#if ( mqttconfigTX_BATCH_SIZE > 0 )
+
+    static BaseType_t prvFlushTxBatch( MQTTBrokerConnection_t * const pxConnection )
+    {
+        BaseType_t xStatus = pdPASS;
+        const uint32_t ulTxBatchLength = pxConnection->ulTxBatchLength;
+
+        /* The batch is emptied even if the send fails, in which case the
+         * connection cannot be used anymore anyway. */
+        pxConnection->ulTxBatchLength = 0;
+
+        if( ulTxBatchLength > ( uint32_t ) 0 )
+        {
+            if( prvSocketSend( pxConnection, pxConnection->ucTxBatch, ulTxBatchLength ) != ulTxBatchLength )
+            {
+                xStatus = pdFAIL;
+            }
+        }
+
+        return xStatus;
+    }
+
+#endif /* mqttconfigTX_BATCH_SIZE */
+/*-----------------------------------------------------------*/
+
 static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
                                         const MQTTEventCallbackParams_t * const pxParams )
 {
@@ -705,6 +1078,7 @@ static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
             break;
 
         case eMQTTPubACK:
+        case eMQTTPubCOMP:
             prvProcessReceivedPUBACK( pxConnection, pxParams );
             break;
 
@@ -723,6 +1097,12 @@ static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
             prvProcessReceivedTimeout( pxConnection, pxParams );
             break;
 
+        #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+            case eMQTTPublishChunk:
+                prvProcessReceivedPublishChunk( pxConnection, pxParams );
+                break;
+        #endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+
         case eMQTTClientDisconnected:
             prvProcessReceivedDisconnect( pxConnection, pxParams );
             break;
@@ -888,12 +1268,27 @@ static BaseType_t prvSetupConnection( const MQTTEventData_t * const pxEventData
         if( pxConnection->xSocket != SOCKETS_INVALID_SOCKET )
         {
             /* Set a callback function that will unblock the MQTT task when data
-             * is received on a socket. */
-            ( void ) SOCKETS_SetSockOpt( pxConnection->xSocket,
-                                         0,                                            /* Level - Unused. */
-                                         SOCKETS_SO_WAKEUP_CALLBACK,
-                                         ( void * ) prvMQTTClientSocketWakeupCallback, /*lint !e9087 !e9074 The cast is ok as we are setting the callback here. */
-                                         sizeof( &( prvMQTTClientSocketWakeupCallback ) ) );
+             * is received on a socket. If the socket does not support it, the
+             * MQTT task has to read the socket on every iteration. */
+            if( SOCKETS_SetSockOpt( pxConnection->xSocket,
+                                    0,                                            /* Level - Unused. */
+                                    SOCKETS_SO_WAKEUP_CALLBACK,
+                                    ( void * ) prvMQTTClientSocketWakeupCallback, /*lint !e9087 !e9074 The cast is ok as we are setting the callback here. */
+                                    sizeof( &( prvMQTTClientSocketWakeupCallback ) ) ) == SOCKETS_ERROR_NONE )
+            {
+                pxConnection->xWakeupCallbackSet = pdTRUE;
+            }
+            else
+            {
+                pxConnection->xWakeupCallbackSet = pdFALSE;
+            }
+
+            /* Read the socket at least once. */
+            pxConnection->xDataAvailable = pdTRUE;
+
+            #if ( mqttconfigTX_BATCH_SIZE > 0 )
+                pxConnection->ulTxBatchLength = 0;
+            #endif
 
             /* Set secure socket option if it is a secured connection. */
             if( ( pxConnection->uxFlags & mqttCONNECTION_SECURED ) == mqttCONNECTION_SECURED )
@@ -998,6 +1393,11 @@ static void prvGracefulSocketClose( MQTTBrokerConnection_t * const pxConnection
 
     mqttconfigDEBUG_LOG( ( "About to close socket.\r\n" ) );
 
+    /* Send the packets still in the batch, for example the DISCONNECT. */
+    #if ( mqttconfigTX_BATCH_SIZE > 0 )
+        ( void ) prvFlushTxBatch( pxConnection );
+    #endif
+
     /* Initialize xTimeOut.  This records the time at which this function was
      * entered. */
     vTaskSetTimeOutState( &xTimeOut );
@@ -1037,27 +1437,56 @@ static void prvMQTTClientSocketWakeupCallback( Socket_t pxSocket )
 {
     const TickType_t xTicksToWait = pdMS_TO_TICKS( 20 );
     MQTTEventData_t xEventData;
-
-    /* Just to avoid compiler warnings.  The socket is not used but the function
-     * prototype cannot be changed because this is a callback function. */
-    ( void ) pxSocket;
+    UBaseType_t x;
+    BaseType_t xConnectionFound = pdFALSE;
 
     /* Should not be possible to get here without the task having been
      * created! */
-    configASSERT( xMQTTTaskHandle );
+    configASSERT( xMQTTTaskHandles[ 0 ] );
+
+    /* Mark the connection using the socket, so that the MQTT task reads
+     * only the sockets which have data. */
+    for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_BROKERS; x++ )
+    {
+        if( xMQTTConnections[ x ].xSocket == pxSocket )
+        {
+            xMQTTConnections[ x ].xDataAvailable = pdTRUE;
+            xConnectionFound = pdTRUE;
+        }
+    }
+
+    /* Some secure sockets ports pass the underlying socket of the network
+     * stack to the callback instead. In that case all the connections using
+     * the callback must be read. */
+    if( xConnectionFound == pdFALSE )
+    {
+        for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_BROKERS; x++ )
+        {
+            if( xMQTTConnections[ x ].xWakeupCallbackSet == pdTRUE )
+            {
+                xMQTTConnections[ x ].xDataAvailable = pdTRUE;
+            }
+        }
+    }
 
-    /* A socket used by the MQTT task may need attention.  Send an event
-     * to the MQTT task to make sure the task is not blocked on xCommandQueue.
-     * There is only any need to do this if there are no messages already in the
-     * queue, as if there are, the task won't block anyway. */
-    if( uxQueueMessagesWaiting( xCommandQueue ) == ( UBaseType_t ) 0 )
+    /* The eMQTTServiceSocket event is not handled directly, it is only used
+     * to unblock the MQTT task, so only the xEventType needs to be set. */
+    memset( &xEventData, 0x00, sizeof( MQTTEventData_t ) );
+    xEventData.xEventType = eMQTTServiceSocket;
+
+    for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_BROKERS; x++ )
     {
-        /* The eMQTTServiceSocket event is not handled directly, it is only used
-         * to unblock the MQTT task, so only the xEventType needs to be set. */
-        memset( &xEventData, 0x00, sizeof( MQTTEventData_t ) );
-        xEventData.xEventType = eMQTTServiceSocket;
-        mqttconfigDEBUG_LOG( ( "Socket sending wakeup to MQTT task.\r\n" ) );
-        ( void ) xQueueSendToBack( xCommandQueue, &xEventData, xTicksToWait );
+        /* A socket used by the MQTT task may need attention.  Send an event
+         * to the MQTT task to make sure the task is not blocked on its command
+         * queue. There is only any need to do this if there are no messages
+         * already in the queue, as if there are, the task won't block anyway. */
+        if( ( xMQTTConnections[ x ].xDataAvailable == pdTRUE ) &&
+            ( uxQueueMessagesWaiting( xCommandQueues[ mqttTASK_INDEX( x ) ] ) == ( UBaseType_t ) 0 ) )
+        {
+            xEventData.uxBrokerNumber = x;
+            mqttconfigDEBUG_LOG( ( "Socket sending wakeup to MQTT task.\r\n" ) );
+            ( void ) xQueueSendToBack( xCommandQueues[ mqttTASK_INDEX( x ) ], &xEventData, xTicksToWait );
+        }
     }
 }
 /*-----------------------------------------------------------*/
@@ -1142,15 +1571,39 @@ static void prvProcessReceivedPUBACK( MQTTBrokerConnection_t * const pxConnectio
 {
     MQTTNotificationData_t * pxNotificationData;
 
+    MQTTAsyncPublish_t * pxAsyncPublish;
+    BaseType_t xStatus = pdPASS;
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+        /* An MQTT 5 broker may refuse the message. */
+        if( pxParams->u.xMQTTPubACKData.ucReasonCode >= ( uint8_t ) 0x80 )
+        {
+            mqttconfigDEBUG_LOG( ( "MQTT Publish refused with reason code 0x%02x.\r\n", pxParams->u.xMQTTPubACKData.ucReasonCode ) );
+            xStatus = pdFAIL;
+        }
+    #endif /* mqttconfigENABLE_MQTT5 */
+
     /* Retrieve the notification data for the task which initiated the Publish operation.*/
     pxNotificationData = prvRetrieveNotificationData( pxConnection, pxParams->u.xMQTTPubACKData.usPacketIdentifier );
 
-    /* If there is no task waiting for it, ignore it. */
+    /* If there is no task waiting for it, the message may have
+     * been published asynchronously. */
     if( pxNotificationData != NULL )
     {
         /* Otherwise inform the task. */
-        mqttconfigDEBUG_LOG( ( "MQTT Publish was successful.\r\n" ) );
-        prvNotifyRequestingTask( pxNotificationData, eMQTTPUBACKReceived, pdPASS );
+        mqttconfigDEBUG_LOG( ( "MQTT Publish was acknowledged.\r\n" ) );
+        prvNotifyRequestingTask( pxNotificationData, eMQTTPUBACKReceived, ( UBaseType_t ) xStatus );
+    }
+    else
+    {
+        pxAsyncPublish = prvRetrieveAsyncPublish( pxConnection, pxParams->u.xMQTTPubACKData.usPacketIdentifier );
+
+        if( pxAsyncPublish != NULL )
+        {
+            mqttconfigDEBUG_LOG( ( "MQTT asynchronous Publish was acknowledged.\r\n" ) );
+            prvCompleteAsyncPublish( pxAsyncPublish, ( xStatus == pdPASS ) ? eMQTTAgentSuccess : eMQTTAgentFailure );
+        }
     }
 }
 /*-----------------------------------------------------------*/
@@ -1178,21 +1631,54 @@ static BaseType_t prvProcessReceivedPublish( MQTTBrokerConnection_t * const pxCo
 }
 /*-----------------------------------------------------------*/
 
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+
+    static void prvProcessReceivedPublishChunk( MQTTBrokerConnection_t * const pxConnection,
+                                                const MQTTEventCallbackParams_t * const pxParams )
+    {
+        MQTTAgentCallbackParams_t xCallbackParams;
+
+        /* Chunks are passed to the generic callback only, as there is
+         * no buffer the subscription callbacks could take. */
+        if( pxConnection->pxCallback != NULL )
+        {
+            xCallbackParams.xMQTTEvent = eMQTTAgentPublishChunk;
+            xCallbackParams.u.xPublishChunkData = pxParams->u.xPublishChunkData;
+
+            ( void ) pxConnection->pxCallback( pxConnection->pvUserData, &( xCallbackParams ) );
+        }
+    }
+
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+/*-----------------------------------------------------------*/
+
 static void prvProcessReceivedTimeout( MQTTBrokerConnection_t * const pxConnection,
                                        const MQTTEventCallbackParams_t * const pxParams )
 {
     MQTTNotificationData_t * pxNotificationData;
 
+    MQTTAsyncPublish_t * pxAsyncPublish;
+
     /* Try to see if there is a task waiting for the operation which just timed out. */
     pxNotificationData = prvRetrieveNotificationData( pxConnection, pxParams->u.xTimeoutData.usPacketIdentifier );
 
-    /* If there is no task waiting, just ignore. Otherwise
-     * inform the task about the timeout. */
+    /* If there is a task waiting, inform the task about the timeout.
+     * Otherwise the operation may be an asynchronous publish. */
     if( pxNotificationData != NULL )
     {
         mqttconfigDEBUG_LOG( ( "MQTT Timeout.\r\n" ) );
         prvNotifyRequestingTask( pxNotificationData, eMQTTOperationTimedOut, pdFAIL );
     }
+    else
+    {
+        pxAsyncPublish = prvRetrieveAsyncPublish( pxConnection, pxParams->u.xTimeoutData.usPacketIdentifier );
+
+        if( pxAsyncPublish != NULL )
+        {
+            mqttconfigDEBUG_LOG( ( "MQTT asynchronous Publish timed out.\r\n" ) );
+            prvCompleteAsyncPublish( pxAsyncPublish, eMQTTAgentTimeout );
+        }
+    }
 }
 /*-----------------------------------------------------------*/
 
@@ -1201,6 +1687,7 @@ static void prvProcessReceivedDisconnect( MQTTBrokerConnection_t * const pxConne
 {
     UBaseType_t x;
     MQTTAgentCallbackParams_t xCallbackParams;
+    MQTTAsyncPublish_t * pxAsyncPublish;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxParams;
@@ -1236,6 +1723,29 @@ static void prvProcessReceivedDisconnect( MQTTBrokerConnection_t * const pxConne
                                      pdFAIL );
         }
     }
+
+    /* Likewise fail the asynchronous publish operations waiting for ACKs.
+     * The operations are completed out of the critical section, as the
+     * completion callback is invoked. */
+    for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_ASYNC_PUBLISHES; x++ )
+    {
+        pxAsyncPublish = NULL;
+
+        taskENTER_CRITICAL();
+        {
+            if( ( xAsyncPublishes[ x ].xAwaitingAck == pdTRUE ) &&
+                ( &( xMQTTConnections[ xAsyncPublishes[ x ].uxBrokerNumber ] ) == pxConnection ) )
+            {
+                pxAsyncPublish = &( xAsyncPublishes[ x ] );
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if( pxAsyncPublish != NULL )
+        {
+            prvCompleteAsyncPublish( pxAsyncPublish, eMQTTAgentFailure );
+        }
+    }
 }
 /*-----------------------------------------------------------*/
 
@@ -1263,71 +1773,100 @@ static void prvNotifyRequestingTask( MQTTNotificationData_t * const pxNotificati
 }
 /*-----------------------------------------------------------*/
 
-static TickType_t prvManageConnections( void )
+static TickType_t prvManageConnections( UBaseType_t uxTaskIndex )
 {
-    UBaseType_t uxBrokerNumber;
-    MQTTBrokerConnection_t * pxConnection;
-    BaseType_t xAnyConnectedClient = pdFALSE;
+    UBaseType_t uxBrokerNumber, uxFirstBroker, uxLastBroker;
+
+    #if ( mqttconfigTX_BATCH_SIZE > 0 )
+        BaseType_t xBatchWindowElapsed;
+
+        #if ( mqttconfigTX_BATCH_WINDOW_TICKS > 0 )
+            TickType_t xBatchAgeTicks;
+        #endif
+    #endif
+    MQTTBrokerConnection_t * pxConnection;
+    BaseType_t xAnyPolledClient = pdFALSE;
     int32_t lBytesReceived;
     TickType_t xNextMQTTPeriodicInvokeTicks, xNextTimeoutTicks = portMAX_DELAY;
     uint64_t xTickCount = 0;
 
+    /* Each MQTT task only services its own brokers. */
+    #if ( mqttconfigTASK_PER_BROKER == 1 )
+        uxFirstBroker = uxTaskIndex;
+        uxLastBroker = uxTaskIndex + ( UBaseType_t ) 1;
+    #else
+        ( void ) uxTaskIndex;
+        uxFirstBroker = 0;
+        uxLastBroker = ( UBaseType_t ) mqttconfigMAX_BROKERS;
+    #endif
+
     /* For each broker the MQTT task might be connected to. */
-    for( uxBrokerNumber = 0; uxBrokerNumber < ( UBaseType_t ) mqttconfigMAX_BROKERS; uxBrokerNumber++ )
+    for( uxBrokerNumber = uxFirstBroker; uxBrokerNumber < uxLastBroker; uxBrokerNumber++ )
     {
         pxConnection = &( xMQTTConnections[ uxBrokerNumber ] );
 
         /* Process only the connected clients. */
         if( pxConnection->xSocket != SOCKETS_INVALID_SOCKET )
         {
-            /* Read data from the socket. */
-            lBytesReceived = SOCKETS_Recv( pxConnection->xSocket, pxConnection->ucRxBuffer, mqttconfigRX_BUFFER_SIZE, 0 );
-
-            /* If data was read, pass it to the MQTT Core library. */
-            if( lBytesReceived > 0 )
-            {
-                ( void ) MQTT_ParseReceivedData( &( pxConnection->xMQTTContext ), pxConnection->ucRxBuffer, ( size_t ) lBytesReceived );
-
-                /* Some data was received on this socket and we do not
-                 * know if there is more data available. Therefore we
-                 * set xNextTimeoutTicks to zero which ensures that we
-                 * do not block on the command queue and try to read
-                 * again from this socket on the next invocation of
-                 * prvManageConnections. This way we ensure that we keep
-                 * processing commands received on the command queue
-                 * between calls to SOCKETS_Recv. As a result, a socket
-                 * receiving lots of data continuously does not starve
-                 * the command processing. */
-                xNextTimeoutTicks = 0;
-            }
-            else if( lBytesReceived < 0 )
+            /* The sockets using the wakeup callback are read only when
+             * they signalled that data is available. */
+            if( ( pxConnection->xWakeupCallbackSet == pdFALSE ) || ( pxConnection->xDataAvailable == pdTRUE ) )
             {
-                /* A negative return value from SOCKETS_Recv indicates error.
-                 * Since the socket is marked non-blocking, read can potentially
-                 * return SOCKETS_EWOULDBLOCK in which case we will re-try to
-                 * read on the next execution of this function. In case of any
-                 * other error, we disconnect. */
-                if( lBytesReceived != SOCKETS_EWOULDBLOCK )
+                /* Read data from the socket. The flag is cleared first,
+                 * so that data arriving during the read is not missed. */
+                pxConnection->xDataAvailable = pdFALSE;
+                lBytesReceived = SOCKETS_Recv( pxConnection->xSocket, pxConnection->ucRxBuffer, mqttconfigRX_BUFFER_SIZE, 0 );
+
+                /* If data was read, pass it to the MQTT Core library. */
+                if( lBytesReceived > 0 )
                 {
-                    /* Disconnect from the broker. Note that the socket close
-                     * and cleanup will happen in the disconnect callback
-                     * ( prvProcessReceivedDisconnect function ) from the core
-                     * MQTT library. */
-                    ( void ) MQTT_Disconnect( &( pxConnection->xMQTTContext ) );
+                    ( void ) MQTT_ParseReceivedData( &( pxConnection->xMQTTContext ), pxConnection->ucRxBuffer, ( size_t ) lBytesReceived );
+                    pxConnection->xDataAvailable = pdTRUE;
+
+                    /* Some data was received on this socket and we do not
+                     * know if there is more data available (for example
+                     * buffered by the TLS layer, which does not invoke the
+                     * wakeup callback again). Therefore we keep the socket
+                     * marked and set xNextTimeoutTicks to zero which ensures
+                     * that we do not block on the command queue and try to
+                     * read again from this socket on the next invocation of
+                     * prvManageConnections. This way we ensure that we keep
+                     * processing commands received on the command queue
+                     * between calls to SOCKETS_Recv. As a result, a socket
+                     * receiving lots of data continuously does not starve
+                     * the command processing. */
+                    xNextTimeoutTicks = 0;
+                }
+                else if( lBytesReceived < 0 )
+                {
+                    /* A negative return value from SOCKETS_Recv indicates error.
+                     * Since the socket is marked non-blocking, read can potentially
+                     * return SOCKETS_EWOULDBLOCK in which case we will re-try to
+                     * read on the next execution of this function. In case of any
+                     * other error, we disconnect. */
+                    if( lBytesReceived != SOCKETS_EWOULDBLOCK )
+                    {
+                        /* Disconnect from the broker. Note that the socket close
+                         * and cleanup will happen in the disconnect callback
+                         * ( prvProcessReceivedDisconnect function ) from the core
+                         * MQTT library. */
+                        ( void ) MQTT_Disconnect( &( pxConnection->xMQTTContext ) );
+                    }
+                }
+                else
+                {
+                    /* If no data was received on this socket, we continue
+                     * to call MQTT_Periodic and calculate xNextTimeoutTicks
+                     * accordingly. */
                 }
-            }
-            else
-            {
-                /* If no data was received on this socket, we continue
-                 * to call MQTT_Periodic and calculate xNextTimeoutTicks
-                 * accordingly. */
             }
         }
 
-        /* Is the client connected? */
-        if( ( xAnyConnectedClient == pdFALSE ) && ( pxConnection->xSocket != SOCKETS_INVALID_SOCKET ) )
+        /* Is the client connected without the wakeup callback? It
+         * must then be polled. */
+        if( ( pxConnection->xSocket != SOCKETS_INVALID_SOCKET ) && ( pxConnection->xWakeupCallbackSet == pdFALSE ) )
         {
-            xAnyConnectedClient = pdTRUE;
+            xAnyPolledClient = pdTRUE;
         }
 
         /* Get the current tick count. */
@@ -1338,11 +1877,56 @@ static TickType_t prvManageConnections( void )
 
         /* Update the next timeout value. */
         xNextTimeoutTicks = configMIN( xNextTimeoutTicks, xNextMQTTPeriodicInvokeTicks );
+
+        #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+            /* Publish the messages queued while disconnected. They are
+             * batched with the other outgoing packets, if enabled. */
+            xNextTimeoutTicks = configMIN( xNextTimeoutTicks, prvReplayOfflineQueue( pxConnection ) );
+        #endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+        #if ( mqttconfigTX_BATCH_SIZE > 0 )
+            if( ( pxConnection->xSocket != SOCKETS_INVALID_SOCKET ) && ( pxConnection->ulTxBatchLength > ( uint32_t ) 0 ) )
+            {
+                /* Keep gathering packets, including the ones sent by
+                 * MQTT_Periodic, while more commands are queued and until
+                 * the oldest packet waited for the batching window. */
+                #if ( mqttconfigTX_BATCH_WINDOW_TICKS > 0 )
+                    xBatchAgeTicks = xTaskGetTickCount() - pxConnection->xTxBatchStartTicks;
+                    xBatchWindowElapsed = ( xBatchAgeTicks >= ( TickType_t ) mqttconfigTX_BATCH_WINDOW_TICKS ) ? pdTRUE : pdFALSE;
+                #else
+                    xBatchWindowElapsed = pdTRUE;
+                #endif
+
+                if( ( uxQueueMessagesWaiting( xCommandQueues[ uxTaskIndex ] ) == ( UBaseType_t ) 0 ) &&
+                    ( xBatchWindowElapsed == pdTRUE ) )
+                {
+                    if( prvFlushTxBatch( pxConnection ) == pdFAIL )
+                    {
+                        /* As for the receive errors, the socket close and
+                         * cleanup happen in the disconnect callback. */
+                        ( void ) MQTT_Disconnect( &( pxConnection->xMQTTContext ) );
+                    }
+                }
+                #if ( mqttconfigTX_BATCH_WINDOW_TICKS > 0 )
+                    else if( xBatchWindowElapsed == pdFALSE )
+                    {
+                        xNextTimeoutTicks = configMIN( xNextTimeoutTicks, ( TickType_t ) mqttconfigTX_BATCH_WINDOW_TICKS - xBatchAgeTicks );
+                    }
+                #endif
+                else
+                {
+                    /* More commands are queued, so the task does not
+                     * block. */
+                }
+            }
+        #endif /* mqttconfigTX_BATCH_SIZE */
     }
 
     /* The MQTT task must not block for more than mqttconfigMQTT_TASK_MAX_BLOCK_TICKS
-     * ticks if any client is connected. */
-    if( xAnyConnectedClient == pdTRUE )
+     * ticks if any client is connected without the wakeup callback. The others wake
+     * the MQTT task up when data is received. */
+    if( xAnyPolledClient == pdTRUE )
     {
         xNextTimeoutTicks = configMIN( xNextTimeoutTicks, ( TickType_t ) mqttconfigMQTT_TASK_MAX_BLOCK_TICKS );
     }
@@ -1402,6 +1986,7 @@ static void prvInitiateMQTTConnect( MQTTEventData_t * const pxEventData )
             xConnectParams.ulPingRequestTimeoutTicks = mqttconfigKEEP_ALIVE_TIMEOUT_TICKS;
             xConnectParams.usPacketIdentifier = ( uint16_t ) ( mqttMESSAGE_IDENTIFIER_EXTRACT( pxEventData->xNotificationData.ulMessageIdentifier ) );
             xConnectParams.ulTimeoutTicks = pxEventData->xTicksToWait;
+            xConnectParams.xPersistentSession = ( mqttconfigPERSISTENT_SESSION == 1 ) ? eMQTTTrue : eMQTTFalse;
 
             if( MQTT_Connect( &( pxConnection->xMQTTContext ), &( xConnectParams ) ) != eMQTTSuccess )
             {
@@ -1566,13 +2151,26 @@ static void prvInitiateMQTTUnSubscribe( MQTTEventData_t * const pxEventData )
 static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData )
 {
     BaseType_t xStatus = pdFAIL;
+    BaseType_t xQueued = pdFALSE;
     MQTTNotificationData_t * pxNotificationData = NULL;
-    MQTTPublishParams_t xPublishParams;
     MQTTBrokerConnection_t * pxConnection = &( xMQTTConnections[ pxEventData->uxBrokerNumber ] );
 
+    /* While disconnected, a QoS0 message is queued and published once
+     * connected again. The QoS1 and QoS2 ones are not, as the calling
+     * task waits for the broker to acknowledge them; they fail while
+     * disconnected instead. */
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        if( ( pxEventData->u.pxPublishParams->xQoS == eMQTTQoS0 ) &&
+            ( prvIsOfflineQueueInUse( pxConnection ) == pdTRUE ) )
+        {
+            xQueued = pdTRUE;
+            xStatus = prvQueueOfflinePublish( pxConnection, pxEventData->u.pxPublishParams );
+        }
+    #endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
     /* No need to store  notification data in case of QoS0 because
      * there will not be any ACK. */
-    if( pxEventData->u.pxPublishParams->xQoS != eMQTTQoS0 )
+    if( ( xQueued == pdFALSE ) && ( pxEventData->u.pxPublishParams->xQoS != eMQTTQoS0 ) )
     {
         pxNotificationData = prvStoreNotificationData( pxConnection, pxEventData );
     }
@@ -1581,18 +2179,16 @@ static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData )
      * (i.e. mqttconfigMAX_PARALLEL_OPS tasks are already in progress), fail
      * immediately. We don't store notification data in case of QoS0, so
      * proceed anyways. */
-    if( ( pxNotificationData != NULL ) || ( pxEventData->u.pxPublishParams->xQoS == eMQTTQoS0 ) )
+    if( xQueued == pdTRUE )
     {
-        /* Setup publish parameters and call the Core library publish function. */
-        xPublishParams.pucTopic = pxEventData->u.pxPublishParams->pucTopic;
-        xPublishParams.usTopicLength = pxEventData->u.pxPublishParams->usTopicLength;
-        xPublishParams.xQos = pxEventData->u.pxPublishParams->xQoS;
-        xPublishParams.pvData = pxEventData->u.pxPublishParams->pvData;
-        xPublishParams.ulDataLength = pxEventData->u.pxPublishParams->ulDataLength;
-        xPublishParams.usPacketIdentifier = ( uint16_t ) ( mqttMESSAGE_IDENTIFIER_EXTRACT( pxEventData->xNotificationData.ulMessageIdentifier ) );
-        xPublishParams.ulTimeoutTicks = pxEventData->xTicksToWait;
-
-        if( MQTT_Publish( &( pxConnection->xMQTTContext ), &( xPublishParams ) ) == eMQTTSuccess )
+        mqttconfigDEBUG_LOG( ( "MQTT Publish queued while disconnected.\r\n" ) );
+    }
+    else if( ( pxNotificationData != NULL ) || ( pxEventData->u.pxPublishParams->xQoS == eMQTTQoS0 ) )
+    {
+        if( prvPublish( pxConnection,
+                        pxEventData->u.pxPublishParams,
+                        pxEventData->xNotificationData.ulMessageIdentifier,
+                        pxEventData->xTicksToWait ) == eMQTTSuccess )
         {
             xStatus = pdPASS;
         }
@@ -1607,8 +2203,9 @@ static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData )
     }
 
     /* In case of QoS0 successful publish, inform and unblock the task that
-     * initiated the publish operation as no PUBACK is expected. */
-    if( ( xStatus == pdPASS ) && ( pxEventData->u.pxPublishParams->xQoS == eMQTTQoS0 ) )
+     * initiated the publish operation as no PUBACK is expected. Neither is
+     * one expected for a queued message. */
+    if( ( xStatus == pdPASS ) && ( ( pxEventData->u.pxPublishParams->xQoS == eMQTTQoS0 ) || ( xQueued == pdTRUE ) ) )
     {
         prvNotifyRequestingTask( &( pxEventData->xNotificationData ), eMQTTPUBSent, pdPASS );
     }
@@ -1628,6 +2225,459 @@ static void prvInitiateMQTTPublish( MQTTEventData_t * const pxEventData )
 }
 /*-----------------------------------------------------------*/
 
+static MQTTReturnCode_t prvPublish( MQTTBrokerConnection_t * const pxConnection,
+                                   const MQTTAgentPublishParams_t * const pxAgentPublishParams,
+                                   uint32_t ulMessageIdentifier,
+                                   TickType_t xTicksToWait )
+{
+    MQTTPublishParams_t xPublishParams;
+    MQTTReturnCode_t xReturnCode;
+
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        MQTTBool_t xCopyPayload = eMQTTFalse;
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
+    /* Setup publish parameters and call the Core library publish function. */
+    xPublishParams.pucTopic = pxAgentPublishParams->pucTopic;
+    xPublishParams.usTopicLength = pxAgentPublishParams->usTopicLength;
+    xPublishParams.xQos = pxAgentPublishParams->xQoS;
+    xPublishParams.pvData = pxAgentPublishParams->pvData;
+    xPublishParams.ulDataLength = pxAgentPublishParams->ulDataLength;
+    xPublishParams.usPacketIdentifier = ( uint16_t ) ( mqttMESSAGE_IDENTIFIER_EXTRACT( ulMessageIdentifier ) );
+    xPublishParams.ulTimeoutTicks = xTicksToWait;
+
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+        /* The payload is only read while it is transmitted, which
+         * happens before the requesting operation completes, so it
+         * does not need to be copied - unless the message has to
+         * be kept in the in-flight store. */
+        #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+            if( ( xPublishParams.xQos != eMQTTQoS0 ) && ( pxConnection->xMQTTContext.pxInflightStore != NULL ) )
+            {
+                xCopyPayload = eMQTTTrue;
+            }
+        #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+        if( xCopyPayload == eMQTTFalse )
+        {
+            xReturnCode = MQTT_PublishZeroCopy( &( pxConnection->xMQTTContext ), &( xPublishParams ) );
+        }
+        else
+        {
+            xReturnCode = MQTT_Publish( &( pxConnection->xMQTTContext ), &( xPublishParams ) );
+        }
+    #else /* if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 ) */
+        xReturnCode = MQTT_Publish( &( pxConnection->xMQTTContext ), &( xPublishParams ) );
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
+static void prvInitiateMQTTPublishAsync( MQTTEventData_t * const pxEventData )
+{
+    MQTTAsyncPublish_t * pxAsyncPublish = pxEventData->u.pxAsyncPublish;
+    MQTTBrokerConnection_t * pxConnection = &( xMQTTConnections[ pxEventData->uxBrokerNumber ] );
+    BaseType_t xQueued = pdFALSE;
+
+    /* While disconnected, the operation completes once the
+     * message is queued. */
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        if( prvIsOfflineQueueInUse( pxConnection ) == pdTRUE )
+        {
+            xQueued = pdTRUE;
+            prvCompleteAsyncPublish( pxAsyncPublish,
+                                     ( prvQueueOfflinePublish( pxConnection, &( pxAsyncPublish->xPublishParams ) ) == pdPASS ) ? eMQTTAgentSuccess : eMQTTAgentFailure );
+        }
+    #endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
+    if( xQueued == pdFALSE )
+    {
+        if( prvPublish( pxConnection,
+                        &( pxAsyncPublish->xPublishParams ),
+                        pxAsyncPublish->ulMessageIdentifier,
+                        pxEventData->xTicksToWait ) == eMQTTSuccess )
+        {
+            if( pxAsyncPublish->xPublishParams.xQoS == eMQTTQoS0 )
+            {
+                /* No PUBACK is expected, the operation is complete. */
+                prvCompleteAsyncPublish( pxAsyncPublish, eMQTTAgentSuccess );
+            }
+            else
+            {
+                /* The operation completes when the PUBACK, a timeout or
+                 * a disconnect is received from the core library. */
+                taskENTER_CRITICAL();
+                pxAsyncPublish->xAwaitingAck = pdTRUE;
+                taskEXIT_CRITICAL();
+            }
+        }
+        else
+        {
+            mqttconfigDEBUG_LOG( ( "MQTT_Publish failed!\r\n" ) );
+            prvCompleteAsyncPublish( pxAsyncPublish, eMQTTAgentFailure );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static MQTTAsyncPublish_t * prvGetFreeAsyncPublish( void )
+{
+    UBaseType_t x;
+    MQTTAsyncPublish_t * pxAsyncPublish = NULL;
+
+    /* Multiple application tasks can be allocating operations
+     * simultaneously and the MQTT task frees them, therefore
+     * it has to be in critical section. */
+    taskENTER_CRITICAL();
+    {
+        for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_ASYNC_PUBLISHES; x++ )
+        {
+            if( xAsyncPublishes[ x ].xInUse == pdFALSE )
+            {
+                pxAsyncPublish = &( xAsyncPublishes[ x ] );
+                pxAsyncPublish->xInUse = pdTRUE;
+                pxAsyncPublish->xAwaitingAck = pdFALSE;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return pxAsyncPublish;
+}
+/*-----------------------------------------------------------*/
+
+static MQTTAsyncPublish_t * prvRetrieveAsyncPublish( const MQTTBrokerConnection_t * const pxConnection,
+                                                     uint16_t usPacketIdentifier )
+{
+    UBaseType_t x;
+    MQTTAsyncPublish_t * pxAsyncPublish = NULL;
+
+    /* Only the operations whose message has been sent can be
+     * acknowledged. The MQTT tasks of the other brokers may be
+     * updating theirs, therefore it has to be in critical section. */
+    taskENTER_CRITICAL();
+    {
+        for( x = 0; x < ( UBaseType_t ) mqttconfigMAX_ASYNC_PUBLISHES; x++ )
+        {
+            if( ( xAsyncPublishes[ x ].xAwaitingAck == pdTRUE ) &&
+                ( &( xMQTTConnections[ xAsyncPublishes[ x ].uxBrokerNumber ] ) == pxConnection ) &&
+                ( usPacketIdentifier == ( uint16_t ) ( mqttMESSAGE_IDENTIFIER_EXTRACT( xAsyncPublishes[ x ].ulMessageIdentifier ) ) ) )
+            {
+                pxAsyncPublish = &( xAsyncPublishes[ x ] );
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return pxAsyncPublish;
+}
+/*-----------------------------------------------------------*/
+
+static void prvCompleteAsyncPublish( MQTTAsyncPublish_t * const pxAsyncPublish,
+                                     MQTTAgentReturnCode_t xReturnCode )
+{
+    MQTTAgentCompletionCallback_t pxCompletionCallback = pxAsyncPublish->pxCompletionCallback;
+    void * pvCompletionContext = pxAsyncPublish->pvCompletionContext;
+
+    /* Free the operation before invoking the callback, so that
+     * the callback can initiate the next one. */
+    taskENTER_CRITICAL();
+    {
+        pxAsyncPublish->xAwaitingAck = pdFALSE;
+        pxAsyncPublish->xInUse = pdFALSE;
+    }
+    taskEXIT_CRITICAL();
+
+    if( pxCompletionCallback != NULL )
+    {
+        pxCompletionCallback( pvCompletionContext, xReturnCode );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvGetNextMessageIdentifier( void )
+{
+    uint32_t ulMessageIdentifier;
+
+    taskENTER_CRITICAL();
+    {
+        /* The message identifier is used to know which message is being
+         * acknowledged.  A critical region is used as a single message identifier
+         * variable is used by all connections. The identifier uses the top 16-bits
+         * of the 32-bit word, leaving the lowest 16-bits free for use by the MQTT
+         * task to return a status code. */
+        ulMessageIdentifier = ulQueueMessageIdentifier;
+        ulQueueMessageIdentifier += mqttMESSAGE_IDENTIFIER_MIN;
+
+        if( ulQueueMessageIdentifier >= mqttMESSAGE_IDENTIFIER_MAX )
+        {
+            ulQueueMessageIdentifier = mqttMESSAGE_IDENTIFIER_MIN;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return ulMessageIdentifier;
+}
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static void prvResetOfflineQueue( MQTTBrokerConnection_t * const pxConnection,
+                                      UBaseType_t uxBrokerNumber )
+    {
+        #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+            /* Erase the memory, so that no message is recovered from it. */
+            memset( ulOfflineQueueStorage[ uxBrokerNumber ], 0xFF, sizeof( ulOfflineQueueStorage[ uxBrokerNumber ] ) );
+
+            MQTT_OfflineSpoolInit( &( pxConnection->xRamQueue ),
+                                   MQTT_OfflineRamFlashInit( &( pxConnection->xRamQueueRegion ),
+                                                             ( uint8_t * ) ulOfflineQueueStorage[ uxBrokerNumber ],
+                                                             ( uint32_t ) mqttconfigOFFLINE_QUEUE_RAM_BLOCK_SIZE,
+                                                             ( uint32_t ) mqttconfigOFFLINE_QUEUE_RAM_BLOCKS ) );
+        #else
+            ( void ) uxBrokerNumber;
+        #endif
+
+        pxConnection->xSpoolSet = pdFALSE;
+        pxConnection->xReplayWindowStartTicks = 0;
+        pxConnection->ulReplayedInWindow = 0;
+
+        taskENTER_CRITICAL();
+        memset( &( pxConnection->xOfflineQueueStats ), 0x00, sizeof( pxConnection->xOfflineQueueStats ) );
+        taskEXIT_CRITICAL();
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static BaseType_t prvIsOfflineQueueInUse( const MQTTBrokerConnection_t * const pxConnection )
+    {
+        BaseType_t xInUse = pdFALSE;
+        BaseType_t xQueueAvailable = pxConnection->xSpoolSet;
+
+        #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+            xQueueAvailable = pdTRUE;
+
+            if( pxConnection->xRamQueue.ulMessages > ( uint32_t ) 0 )
+            {
+                xInUse = pdTRUE;
+            }
+        #endif
+
+        if( ( pxConnection->xSpoolSet == pdTRUE ) && ( pxConnection->xSpool.ulMessages > ( uint32_t ) 0 ) )
+        {
+            xInUse = pdTRUE;
+        }
+
+        if( ( xQueueAvailable == pdTRUE ) &&
+            ( ( pxConnection->xSocket == SOCKETS_INVALID_SOCKET ) ||
+              ( pxConnection->xMQTTContext.xConnectionState != eMQTTConnected ) ) )
+        {
+            xInUse = pdTRUE;
+        }
+
+        return xInUse;
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static BaseType_t prvQueueOfflinePublish( MQTTBrokerConnection_t * const pxConnection,
+                                              const MQTTAgentPublishParams_t * const pxAgentPublishParams )
+    {
+        MQTTPublishParams_t xPublishParams;
+        MQTTBool_t xQueued = eMQTTFalse;
+
+        xPublishParams.pucTopic = pxAgentPublishParams->pucTopic;
+        xPublishParams.usTopicLength = pxAgentPublishParams->usTopicLength;
+        xPublishParams.xQos = pxAgentPublishParams->xQoS;
+        xPublishParams.pvData = pxAgentPublishParams->pvData;
+        xPublishParams.ulDataLength = pxAgentPublishParams->ulDataLength;
+
+        /* Once the spool holds messages, the following ones are queued
+         * after them even if the RAM queue has emptied meanwhile. */
+        #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+            if( ( pxConnection->xSpoolSet == pdFALSE ) || ( pxConnection->xSpool.ulMessages == ( uint32_t ) 0 ) )
+            {
+                xQueued = MQTT_OfflineSpoolPush( &( pxConnection->xRamQueue ), &( xPublishParams ) );
+            }
+        #endif
+
+        if( ( xQueued == eMQTTFalse ) && ( pxConnection->xSpoolSet == pdTRUE ) )
+        {
+            xQueued = MQTT_OfflineSpoolPush( &( pxConnection->xSpool ), &( xPublishParams ) );
+        }
+
+        if( xQueued == eMQTTFalse )
+        {
+            mqttconfigDEBUG_LOG( ( "MQTT offline queue is full!\r\n" ) );
+
+            taskENTER_CRITICAL();
+            pxConnection->xOfflineQueueStats.ulDroppedMessages++;
+            taskEXIT_CRITICAL();
+        }
+
+        prvUpdateOfflineQueueStats( pxConnection );
+
+        return ( xQueued == eMQTTTrue ) ? pdPASS : pdFAIL;
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static TickType_t prvReplayOfflineQueue( MQTTBrokerConnection_t * const pxConnection )
+    {
+        MQTTOfflineSpool_t * pxQueue;
+        MQTTPublishParams_t xPublishParams;
+        uint8_t * pucBuffer = NULL;
+        uint32_t ulBufferLength = 0, ulReplayed = 0, ulDropped = 0;
+        TickType_t xWindowAgeTicks, xNextReplayTicks = portMAX_DELAY;
+
+        if( ( pxConnection->xSocket != SOCKETS_INVALID_SOCKET ) &&
+            ( pxConnection->xMQTTContext.xConnectionState == eMQTTConnected ) )
+        {
+            xWindowAgeTicks = xTaskGetTickCount() - pxConnection->xReplayWindowStartTicks;
+
+            if( xWindowAgeTicks >= ( TickType_t ) mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS )
+            {
+                pxConnection->xReplayWindowStartTicks += xWindowAgeTicks;
+                pxConnection->ulReplayedInWindow = 0;
+                xWindowAgeTicks = 0;
+            }
+
+            for( ; ; )
+            {
+                /* The RAM queue holds the oldest messages. */
+                pxQueue = NULL;
+
+                #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+                    if( pxConnection->xRamQueue.ulMessages > ( uint32_t ) 0 )
+                    {
+                        pxQueue = &( pxConnection->xRamQueue );
+                    }
+                #endif
+
+                if( ( pxQueue == NULL ) && ( pxConnection->xSpoolSet == pdTRUE ) && ( pxConnection->xSpool.ulMessages > ( uint32_t ) 0 ) )
+                {
+                    pxQueue = &( pxConnection->xSpool );
+                }
+
+                if( ( pxQueue == NULL ) || ( pxConnection->ulReplayedInWindow >= ( uint32_t ) mqttconfigOFFLINE_QUEUE_REPLAY_BURST ) )
+                {
+                    break;
+                }
+
+                /* The topic and the data are read into a buffer, which is
+                 * kept for all the messages of the burst. */
+                if( pucBuffer == NULL )
+                {
+                    ulBufferLength = 0;
+                    pucBuffer = mqttconfigGET_FREE_BUFFER_FXN( &( ulBufferLength ) );
+
+                    if( pucBuffer == NULL )
+                    {
+                        break;
+                    }
+                }
+
+                if( MQTT_OfflineSpoolPeek( pxQueue, pucBuffer, ulBufferLength, &( xPublishParams ) ) == eMQTTFalse )
+                {
+                    /* The message does not fit in a buffer or cannot be
+                     * read, so it can never be published. */
+                    MQTT_OfflineSpoolPop( pxQueue );
+                    ulDropped++;
+                }
+                else
+                {
+                    /* The payload is copied, as the buffer is returned
+                     * before the message is acknowledged. */
+                    xPublishParams.usPacketIdentifier = ( uint16_t ) ( mqttMESSAGE_IDENTIFIER_EXTRACT( prvGetNextMessageIdentifier() ) );
+                    xPublishParams.ulTimeoutTicks = ( uint32_t ) mqttconfigOFFLINE_QUEUE_ACK_TIMEOUT_TICKS;
+
+                    if( MQTT_Publish( &( pxConnection->xMQTTContext ), &( xPublishParams ) ) != eMQTTSuccess )
+                    {
+                        /* Try again in the next window. */
+                        break;
+                    }
+
+                    MQTT_OfflineSpoolPop( pxQueue );
+                    pxConnection->ulReplayedInWindow++;
+                    ulReplayed++;
+                }
+            }
+
+            if( pucBuffer != NULL )
+            {
+                mqttconfigRETURN_BUFFER_FXN( pucBuffer );
+            }
+
+            if( pxQueue != NULL )
+            {
+                xNextReplayTicks = ( TickType_t ) mqttconfigOFFLINE_QUEUE_REPLAY_INTERVAL_TICKS - xWindowAgeTicks;
+            }
+
+            if( ( ulReplayed > ( uint32_t ) 0 ) || ( ulDropped > ( uint32_t ) 0 ) )
+            {
+                taskENTER_CRITICAL();
+                pxConnection->xOfflineQueueStats.ulReplayedMessages += ulReplayed;
+                pxConnection->xOfflineQueueStats.ulDroppedMessages += ulDropped;
+                taskEXIT_CRITICAL();
+
+                prvUpdateOfflineQueueStats( pxConnection );
+            }
+        }
+
+        return xNextReplayTicks;
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static void prvUpdateOfflineQueueStats( MQTTBrokerConnection_t * const pxConnection )
+    {
+        uint32_t ulMessages = 0, ulBytes = 0, ulSpooledMessages = 0;
+
+        #if ( mqttconfigOFFLINE_QUEUE_RAM_BLOCKS > 0 )
+            ulMessages = pxConnection->xRamQueue.ulMessages;
+            ulBytes = pxConnection->xRamQueue.ulBytes;
+        #endif
+
+        if( pxConnection->xSpoolSet == pdTRUE )
+        {
+            ulSpooledMessages = pxConnection->xSpool.ulMessages;
+            ulMessages += ulSpooledMessages;
+            ulBytes += pxConnection->xSpool.ulBytes;
+        }
+
+        taskENTER_CRITICAL();
+        {
+            pxConnection->xOfflineQueueStats.ulQueuedMessages = ulMessages;
+            pxConnection->xOfflineQueueStats.ulQueuedBytes = ulBytes;
+            pxConnection->xOfflineQueueStats.ulSpooledMessages = ulSpooledMessages;
+
+            if( ulMessages > pxConnection->xOfflineQueueStats.ulPeakQueuedMessages )
+            {
+                pxConnection->xOfflineQueueStats.ulPeakQueuedMessages = ulMessages;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
 static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEventData )
 {
     BaseType_t xReturn;
@@ -1636,33 +2686,18 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
 
     /* Should not try to send commands until after the MQTT task has been
      * initialized, in which case the command queue will have been created. */
-    configASSERT( xCommandQueue );
+    configASSERT( xCommandQueues[ mqttTASK_INDEX( pxEventData->uxBrokerNumber ) ] );
 
     /* Setup notification data. */
     pxEventData->xNotificationData.xTaskToNotify = xTaskGetCurrentTaskHandle();
 
-    /* Commands must not be sent from the MQTT task itself (which could be
-     * the case if a command is sent from a callback function).  Otherwise
+    /* Commands must not be sent from the MQTT tasks themselves (which could
+     * be the case if a command is sent from a callback function).  Otherwise
      * there is the possibility that the task could end up waiting for itself
      * resulting in deadlock. */
-    if( pxEventData->xNotificationData.xTaskToNotify != xMQTTTaskHandle )
+    if( prvIsMQTTTask() == pdFALSE )
     {
-        taskENTER_CRITICAL();
-        {
-            /* The message identifier is used to know which message is being
-             * acknowledged.  A critical region is used as a single message identifier
-             * variable is used by all connections. The identifier uses the top 16-bits
-             * of the 32-bit word, leaving the lowest 16-bits free for use by the MQTT
-             * task to return a status code. */
-            pxEventData->xNotificationData.ulMessageIdentifier = ulQueueMessageIdentifier;
-            ulQueueMessageIdentifier += mqttMESSAGE_IDENTIFIER_MIN;
-
-            if( ulQueueMessageIdentifier >= mqttMESSAGE_IDENTIFIER_MAX )
-            {
-                ulQueueMessageIdentifier = mqttMESSAGE_IDENTIFIER_MIN;
-            }
-        }
-        taskEXIT_CRITICAL();
+        pxEventData->xNotificationData.ulMessageIdentifier = prvGetNextMessageIdentifier();
 
         /* Record the time at which this event is created. */
         vTaskSetTimeOutState( &( pxEventData->xEventCreationTimestamp ) );
@@ -1676,7 +2711,7 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
          * are sent on a queue, and a signal is sent back using a task
          * notification. */
         mqttconfigDEBUG_LOG( ( "Sending command to MQTT task.\r\n" ) );
-        xReturn = xQueueSendToBack( xCommandQueue, pxEventData, pxEventData->xTicksToWait );
+        xReturn = xQueueSendToBack( xCommandQueues[ mqttTASK_INDEX( pxEventData->uxBrokerNumber ) ], pxEventData, pxEventData->xTicksToWait );
 
         if( xReturn != pdFALSE )
         {
@@ -1745,13 +2780,63 @@ static MQTTAgentReturnCode_t prvSendCommandToMQTTTask( MQTTEventData_t * pxEvent
 }
 /*-----------------------------------------------------------*/
 
+static BaseType_t prvIsMQTTTask( void )
+{
+    UBaseType_t x;
+    BaseType_t xIsMQTTTask = pdFALSE;
+    const TaskHandle_t xCurrentTask = xTaskGetCurrentTaskHandle();
+
+    for( x = 0; x < mqttTASK_COUNT; x++ )
+    {
+        if( xCurrentTask == xMQTTTaskHandles[ x ] )
+        {
+            xIsMQTTTask = pdTRUE;
+            break;
+        }
+    }
+
+    return xIsMQTTTask;
+}
+/*-----------------------------------------------------------*/
+
+static void prvGetTaskName( UBaseType_t uxTaskIndex,
+                            char * const pcTaskName )
+{
+    size_t xLength = 4;
+
+    memcpy( pcTaskName, "MQTT", xLength );
+
+    #if ( mqttconfigTASK_PER_BROKER == 1 )
+        {
+            UBaseType_t uxDivisor = 1;
+
+            /* Append the index in decimal. */
+            while( ( uxTaskIndex / uxDivisor ) >= ( UBaseType_t ) 10 )
+            {
+                uxDivisor *= ( UBaseType_t ) 10;
+            }
+
+            while( ( uxDivisor > ( UBaseType_t ) 0 ) && ( xLength < ( size_t ) ( mqttTASK_NAME_LENGTH - 1 ) ) )
+            {
+                pcTaskName[ xLength ] = ( char ) ( '0' + ( ( uxTaskIndex / uxDivisor ) % ( UBaseType_t ) 10 ) );
+                xLength++;
+                uxDivisor /= ( UBaseType_t ) 10;
+            }
+        }
+    #else
+        ( void ) uxTaskIndex;
+    #endif /* mqttconfigTASK_PER_BROKER */
+
+    pcTaskName[ xLength ] = '\0';
+}
+/*-----------------------------------------------------------*/
+
 static void prvMQTTTask( void * pvParameters )
 {
     MQTTEventData_t xMQTTCommand;
     TickType_t xNextTimeoutTicks = 0;
-
-    /* Remove compiler warnings about unused parameters. */
-    ( void ) pvParameters;
+    const UBaseType_t uxTaskIndex = ( UBaseType_t ) pvParameters; /*lint !e923 The cast is ok as we are passing the index of the task. */
+    const QueueHandle_t xCommandQueue = xCommandQueues[ uxTaskIndex ];
 
     for( ; ; )
     {
@@ -1777,6 +2862,13 @@ static void prvMQTTTask( void * pvParameters )
                  * be NULL and therefore prvNotifyRequestingTask returns
                  * without doing anything. */
                 prvNotifyRequestingTask( &( xMQTTCommand.xNotificationData ), eMQTTOperationTimedOut, pdFAIL );
+
+                /* No task is waiting for an asynchronous publish, its
+                 * completion callback is invoked instead. */
+                if( xMQTTCommand.xEventType == eMQTTPublishAsyncRequest )
+                {
+                    prvCompleteAsyncPublish( xMQTTCommand.u.pxAsyncPublish, eMQTTAgentTimeout );
+                }
             }
             else
             {
@@ -1806,6 +2898,10 @@ static void prvMQTTTask( void * pvParameters )
                         prvInitiateMQTTPublish( &( xMQTTCommand ) );
                         break;
 
+                    case eMQTTPublishAsyncRequest:
+                        prvInitiateMQTTPublishAsync( &( xMQTTCommand ) );
+                        break;
+
                     default:
                         /* Anything else is illegal. */
                         mqttconfigDEBUG_LOG( ( "Unknown request received on command queue.\r\n" ) );
@@ -1816,7 +2912,7 @@ static void prvMQTTTask( void * pvParameters )
 
         /* Process active connections each time the queue unblocks.  It might
          * be that the queue read timed out because a connection needs service. */
-        xNextTimeoutTicks = prvManageConnections();
+        xNextTimeoutTicks = prvManageConnections( uxTaskIndex );
     }
 }
 /*-----------------------------------------------------------*/
@@ -1826,25 +2922,26 @@ BaseType_t MQTT_AGENT_Init( void )
     /* The following variables must be static as they hold data that is used as
      * long as the MQTT application is running. */
 
-    /* The variable used to hold the queue's data structure. */
-    static StaticQueue_t xStaticQueue;
+    /* The variables used to hold the queues' data structures. */
+    static StaticQueue_t xStaticQueues[ mqttTASK_COUNT ];
 
-    /* The array to use as the queue's storage area.  This must be at least
+    /* The arrays to use as the queues' storage areas.  These must be at least
      * uxQueueLength * uxItemSize bytes.  Again, must be static. */
-    static uint8_t ucQueueStorageArea[ mqttCOMMAND_QUEUE_LENGTH * sizeof( MQTTEventData_t ) ];
+    static uint8_t ucQueueStorageAreas[ mqttTASK_COUNT ][ mqttCOMMAND_QUEUE_LENGTH * sizeof( MQTTEventData_t ) ];
 
-    /* The stack used by the MQTT task. */
-    static StackType_t xStack[ mqttconfigMQTT_TASK_STACK_DEPTH ];
+    /* The stacks used by the MQTT tasks. */
+    static StackType_t xStacks[ mqttTASK_COUNT ][ mqttconfigMQTT_TASK_STACK_DEPTH ];
 
-    /* The variable used to hold the MQTT task's data structures. */
-    static StaticTask_t xStaticTask;
+    /* The variables used to hold the MQTT tasks' data structures. */
+    static StaticTask_t xStaticTasks[ mqttTASK_COUNT ];
 
     BaseType_t xReturnCode = pdPASS;
     UBaseType_t x, y;
+    char cTaskName[ mqttTASK_NAME_LENGTH ];
 
-    /* If the command queue is not NULL then the queue and task have already
-     * been created. */
-    if( xCommandQueue == NULL )
+    /* If the first command queue is not NULL then the queues and tasks have
+     * already been created. */
+    if( xCommandQueues[ 0 ] == NULL )
     {
         /* Ensure the connection structures start in a consistent state. */
         memset( xMQTTConnections, 0x00, sizeof( xMQTTConnections ) );
@@ -1866,10 +2963,34 @@ BaseType_t MQTT_AGENT_Init( void )
             xInitParams.pxCallback = prvMQTTEventCallback;
             xInitParams.pvSendContext = ( void * ) x;     /*lint !e923 The cast is ok as we are passing the index of the client. */
             xInitParams.pxMQTTSendFxn = prvMQTTSendCallback;
+
+            #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+                /* Secure sockets cannot send from more than one buffer at a
+                 * time, so the header and the payload are sent separately. */
+                xInitParams.pxMQTTSendVectoredFxn = NULL;
+            #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
             xInitParams.pxGetTicksFxn = prvMQTTGetTicks;
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                xInitParams.xProtocolVersion = ( mqttconfigUSE_MQTT5 == 1 ) ? eMQTTProtocolVersion5 : eMQTTProtocolVersion311;
+            #endif /* mqttconfigENABLE_MQTT5 */
+
             xInitParams.xBufferPoolInterface.pxGetBufferFxn = mqttconfigGET_FREE_BUFFER_FXN;
             xInitParams.xBufferPoolInterface.pxReturnBufferFxn = mqttconfigRETURN_BUFFER_FXN;
 
+            #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+                #if ( mqttconfigINFLIGHT_STORE_SIZE > 0 )
+                    xInitParams.pxInflightStore = MQTT_InflightRingStoreInit( &( xInflightStores[ x ] ),
+                                                                              ucInflightStoreStorage[ x ],
+                                                                              ( uint32_t ) mqttconfigINFLIGHT_STORE_SIZE,
+                                                                              ( uint32_t ) mqttconfigINFLIGHT_STORE_RESEND_TIMEOUT_TICKS );
+                #else
+                    xInitParams.pxInflightStore = NULL;
+                #endif
+            #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
             if( MQTT_Init( &xMQTTConnections[ x ].xMQTTContext, &xInitParams ) != eMQTTSuccess )
             {
                 xReturnCode = pdFAIL;
@@ -1884,17 +3005,27 @@ BaseType_t MQTT_AGENT_Init( void )
             }
         }
 
+        /* No asynchronous publish operation is in progress. */
+        memset( xAsyncPublishes, 0x00, sizeof( xAsyncPublishes ) );
+
         /* ulQueueMessageIdentifier uses the top 16-bits of a 32-bit value, so
          * initialize it to its start value. */
         ulQueueMessageIdentifier = mqttMESSAGE_IDENTIFIER_MIN;
 
-        /* Don't create the MQTT task until the command queue has been created,
-         * as the task itself assumes the queue is valid. */
-        xCommandQueue = xQueueCreateStatic( mqttCOMMAND_QUEUE_LENGTH, sizeof( MQTTEventData_t ), ucQueueStorageArea, &xStaticQueue );
-        configASSERT( xCommandQueue );
+        /* Don't create the MQTT tasks until all the command queues have been
+         * created, as the tasks themselves assume the queues are valid. */
+        for( x = 0; x < mqttTASK_COUNT; x++ )
+        {
+            xCommandQueues[ x ] = xQueueCreateStatic( mqttCOMMAND_QUEUE_LENGTH, sizeof( MQTTEventData_t ), ucQueueStorageAreas[ x ], &( xStaticQueues[ x ] ) );
+            configASSERT( xCommandQueues[ x ] );
+        }
 
-        xMQTTTaskHandle = xTaskCreateStatic( prvMQTTTask, "MQTT", mqttconfigMQTT_TASK_STACK_DEPTH, NULL, mqttconfigMQTT_TASK_PRIORITY, xStack, &xStaticTask );
-        configASSERT( xMQTTTaskHandle );
+        for( x = 0; x < mqttTASK_COUNT; x++ )
+        {
+            prvGetTaskName( x, cTaskName );
+            xMQTTTaskHandles[ x ] = xTaskCreateStatic( prvMQTTTask, cTaskName, mqttconfigMQTT_TASK_STACK_DEPTH, ( void * ) x, mqttconfigMQTT_TASK_PRIORITY, xStacks[ x ], &( xStaticTasks[ x ] ) ); /*lint !e923 The cast is ok as we are passing the index of the task. */
+            configASSERT( xMQTTTaskHandles[ x ] );
+        }
     }
 
     return xReturnCode;
@@ -1913,6 +3044,12 @@ MQTTAgentReturnCode_t MQTT_AGENT_Create( MQTTAgentHandle_t * const pxMQTTHandle
     /* If we cannot get a free connection, fail immediately. */
     if( xBrokerNumber >= 0 )
     {
+        /* The messages queued by the previous user of the connection
+         * are dropped. */
+        #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+            prvResetOfflineQueue( &( xMQTTConnections[ xBrokerNumber ] ), ( UBaseType_t ) xBrokerNumber );
+        #endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+
         /* Encode the broker number. */
         xEncodedBrokerNumber = mqttENCODE_BROKER_NUMBER( xBrokerNumber );
 
@@ -2052,6 +3189,76 @@ MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
 }
 /*-----------------------------------------------------------*/
 
+MQTTAgentReturnCode_t MQTT_AGENT_PublishAsync( MQTTAgentHandle_t xMQTTHandle,
+                                               const MQTTAgentPublishParams_t * const pxPublishParams,
+                                               MQTTAgentCompletionCallback_t pxCompletionCallback,
+                                               void * pvCompletionContext,
+                                               TickType_t xTimeoutTicks )
+{
+    MQTTEventData_t xEventData;
+    MQTTAsyncPublish_t * pxAsyncPublish;
+    MQTTAgentReturnCode_t xReturnCode = eMQTTAgentFailure;
+    TickType_t xTicksToWaitForQueue = xTimeoutTicks;
+
+    const UBaseType_t uxBrokerNumber = ( UBaseType_t ) mqttDECODE_BROKER_NUMBER( xMQTTHandle ); /*lint !e923 Opaque pointer. */
+
+    /* Should not try to send commands until after the MQTT task has been
+     * initialized, in which case the command queue will have been created. */
+    configASSERT( xCommandQueues[ mqttTASK_INDEX( uxBrokerNumber ) ] );
+
+    /* The MQTT tasks (i.e. the completion callback) must not block on
+     * the command queue, as they may be the one emptying it. */
+    if( prvIsMQTTTask() == pdTRUE )
+    {
+        xTicksToWaitForQueue = 0;
+    }
+
+    pxAsyncPublish = prvGetFreeAsyncPublish();
+
+    if( pxAsyncPublish != NULL )
+    {
+        /* Setup the operation. The parameters are copied, but not the
+         * memory they point to. */
+        pxAsyncPublish->uxBrokerNumber = uxBrokerNumber;
+        pxAsyncPublish->ulMessageIdentifier = prvGetNextMessageIdentifier();
+        pxAsyncPublish->xPublishParams = *pxPublishParams;
+        pxAsyncPublish->pxCompletionCallback = pxCompletionCallback;
+        pxAsyncPublish->pvCompletionContext = pvCompletionContext;
+
+        /* Setup the event to be sent to the command queue. No task
+         * waits for the notification. */
+        xEventData.uxBrokerNumber = pxAsyncPublish->uxBrokerNumber;
+        xEventData.xEventType = eMQTTPublishAsyncRequest;
+        xEventData.xTicksToWait = xTimeoutTicks;
+        xEventData.xNotificationData.xTaskToNotify = NULL;
+        xEventData.xNotificationData.ulMessageIdentifier = pxAsyncPublish->ulMessageIdentifier;
+        xEventData.u.pxAsyncPublish = pxAsyncPublish;
+        vTaskSetTimeOutState( &( xEventData.xEventCreationTimestamp ) );
+
+        if( xQueueSendToBack( xCommandQueues[ mqttTASK_INDEX( uxBrokerNumber ) ], &xEventData, xTicksToWaitForQueue ) != pdFALSE )
+        {
+            /* The completion callback will be invoked from the MQTT task. */
+            xReturnCode = eMQTTAgentSuccess;
+        }
+        else
+        {
+            mqttconfigDEBUG_LOG( ( "Attempt to write to the MQTT command queue failed.\r\n" ) );
+
+            /* The MQTT task does not know about the operation. */
+            taskENTER_CRITICAL();
+            pxAsyncPublish->xInUse = pdFALSE;
+            taskEXIT_CRITICAL();
+        }
+    }
+    else
+    {
+        mqttconfigDEBUG_LOG( ( "Too many asynchronous publish operations in progress!\r\n" ) );
+    }
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
 MQTTAgentReturnCode_t MQTT_AGENT_ReturnBuffer( MQTTAgentHandle_t xMQTTHandle,
                                                MQTTBufferHandle_t xBufferHandle )
 {
@@ -2067,3 +3274,48 @@ MQTTAgentReturnCode_t MQTT_AGENT_ReturnBuffer( MQTTAgentHandle_t xMQTTHandle,
     return eMQTTAgentSuccess;
 }
 /*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTAgentReturnCode_t MQTT_AGENT_SetOfflineSpool( MQTTAgentHandle_t xMQTTHandle,
+                                                      const MQTTOfflineFlashInterface_t * const pxFlash )
+    {
+        const UBaseType_t uxBrokerNumber = ( UBaseType_t ) mqttDECODE_BROKER_NUMBER( xMQTTHandle ); /*lint !e923 Opaque pointer. */
+        MQTTBrokerConnection_t * pxConnection = &( xMQTTConnections[ uxBrokerNumber ] );
+
+        configASSERT( uxBrokerNumber < ( UBaseType_t ) mqttconfigMAX_BROKERS );
+        configASSERT( pxFlash != NULL );
+
+        /* The MQTT task does not access the queue before the client
+         * is connected or a message is published, so it is safe to
+         * set it up from the calling task. */
+        MQTT_OfflineSpoolInit( &( pxConnection->xSpool ), pxFlash );
+        pxConnection->xSpoolSet = pdTRUE;
+
+        prvUpdateOfflineQueueStats( pxConnection );
+
+        return eMQTTAgentSuccess;
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    MQTTAgentReturnCode_t MQTT_AGENT_GetOfflineQueueStats( MQTTAgentHandle_t xMQTTHandle,
+                                                           MQTTAgentOfflineQueueStats_t * const pxStats )
+    {
+        const UBaseType_t uxBrokerNumber = ( UBaseType_t ) mqttDECODE_BROKER_NUMBER( xMQTTHandle ); /*lint !e923 Opaque pointer. */
+
+        configASSERT( uxBrokerNumber < ( UBaseType_t ) mqttconfigMAX_BROKERS );
+
+        /* The statistics are updated by the MQTT task. */
+        taskENTER_CRITICAL();
+        *pxStats = xMQTTConnections[ uxBrokerNumber ].xOfflineQueueStats;
+        taskEXIT_CRITICAL();
+
+        return eMQTTAgentSuccess;
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
@@ -0,0 +1,1186 @@
+/*
+ * Amazon FreeRTOS MQTT Library V1.1.3
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file aws_mqtt_inflight_store.c
+ * @brief RAM ring in-flight store implementation.
+ */
+
+/* Interface includes. */
+#include "aws_mqtt_inflight_store.h"
+
+/* Standard includes. */
+#include <stddef.h>
+#include <string.h>
+
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+/**
+ * @brief Value of the magic field of a valid control block.
+ */
+    #define mqttringstoreMAGIC                  ( ( uint32_t ) 0x4D514946 )
+
+/**
+ * @defgroup RecordStates States of a record in the ring.
+ */
+/** @{ */
+    #define mqttringstoreRECORD_LIVE            ( ( uint8_t ) 0xA5 ) /**< The record holds a stored packet. */
+    #define mqttringstoreRECORD_REMOVED         ( ( uint8_t ) 0x00 ) /**< The packet in the record has been removed. */
+    #define mqttringstoreRECORD_WRAP            ( ( uint8_t ) 0x5A ) /**< The next record is at the start of the ring. */
+/** @} */
+
+/**
+ * @brief Rounds up the given length to a multiple of 4.
+ */
+    #define mqttringstoreALIGN( ulLength )      ( ( ( ulLength ) + ( uint32_t ) 3 ) & ~( ( uint32_t ) 3 ) )
+
+/**
+ * @brief The control block kept at the start of the memory region.
+ *
+ * All the offsets are from the start of the memory region.
+ */
+    typedef struct RingStoreControl
+    {
+        uint32_t ulMagic; /**< mqttringstoreMAGIC if the control block is valid. */
+        uint32_t ulHead;  /**< Offset of the oldest record. */
+        uint32_t ulTail;  /**< Offset at which the next record is written. */
+        uint32_t ulUsed;  /**< Number of bytes between the head and the tail, including the ones skipped at the end of the ring. */
+        uint32_t ulCheck; /**< XOR of the other fields and the size of the memory region. */
+    } RingStoreControl_t;
+
+/**
+ * @brief The header preceding every record in the ring.
+ *
+ * The packet follows the header and the next record starts at the next
+ * multiple of 4. If fewer bytes than the size of the header remain at the
+ * end of the ring, the next record is at the start of the ring.
+ */
+    typedef struct RingStoreRecordHeader
+    {
+        uint16_t usPacketIdentifier; /**< Packet identifier of the stored packet. */
+        uint8_t ucState;             /**< One of the @ref RecordStates. */
+        uint8_t ucReserved;          /**< Unused. */
+        uint32_t ulLength;           /**< Length of the stored packet. */
+    } RingStoreRecordHeader_t;
+
+/**
+ * @brief The offset of the first record in the memory region.
+ */
+    #define mqttringstoreFIRST_RECORD           ( mqttringstoreALIGN( ( uint32_t ) sizeof( RingStoreControl_t ) ) )
+
+/**
+ * @brief The size of a record header.
+ */
+    #define mqttringstoreHEADER_SIZE            ( ( uint32_t ) sizeof( RingStoreRecordHeader_t ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Computes the check field of the control block.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] pxControl The control block.
+ *
+ * @return The value of the check field.
+ */
+    static uint32_t prvRingStoreCheck( const MQTTInflightRingStore_t * pxStore,
+                                       const RingStoreControl_t * pxControl );
+
+/**
+ * @brief Writes the control block into the memory region.
+ *
+ * @param[in] pxStore The store.
+ * @param[in, out] pxControl The control block. The check field is updated.
+ */
+    static void prvRingStoreWriteControl( MQTTInflightRingStore_t * pxStore,
+                                          RingStoreControl_t * pxControl );
+
+/**
+ * @brief Reads the record at the given offset and moves the offset to the
+ * next record.
+ *
+ * The wraps at the end of the ring are followed, so the returned header
+ * is never a wrap marker.
+ *
+ * @param[in] pxStore The store.
+ * @param[in, out] pulOffset The offset of the record. Updated to the offset
+ * of the next record.
+ * @param[in, out] pulRemaining The number of used bytes from the offset up
+ * to the tail. Decremented by the bytes skipped.
+ * @param[out] pulRecordOffset The offset of the returned record.
+ * @param[out] pxHeader The header of the returned record.
+ *
+ * @return eMQTTTrue if a record is returned, eMQTTFalse if the tail has
+ * been reached.
+ */
+    static MQTTBool_t prvRingStoreNextRecord( const MQTTInflightRingStore_t * pxStore,
+                                              uint32_t * pulOffset,
+                                              uint32_t * pulRemaining,
+                                              uint32_t * pulRecordOffset,
+                                              RingStoreRecordHeader_t * pxHeader );
+
+/**
+ * @brief Finds the live record storing the given packet identifier.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] pxControl The control block.
+ * @param[in] usPacketIdentifier The packet identifier to find.
+ *
+ * @return The offset of the record, or 0 if it is not found.
+ */
+    static uint32_t prvRingStoreFind( const MQTTInflightRingStore_t * pxStore,
+                                      const RingStoreControl_t * pxControl,
+                                      uint16_t usPacketIdentifier );
+
+/**
+ * @brief Marks the record at the given offset as removed and releases the
+ * space of the removed records at the head of the ring.
+ *
+ * @param[in] pxStore The store.
+ * @param[in, out] pxControl The control block.
+ * @param[in] ulRecordOffset The offset of the record to remove.
+ */
+    static void prvRingStoreRemoveRecord( MQTTInflightRingStore_t * pxStore,
+                                          RingStoreControl_t * pxControl,
+                                          uint32_t ulRecordOffset );
+
+/**
+ * @brief Stores a packet. Implements MQTTInflightStorePut_t.
+ */
+    static MQTTBool_t prvRingStorePut( void * pvStoreContext,
+                                       uint16_t usPacketIdentifier,
+                                       const uint8_t * pucPacket,
+                                       uint32_t ulPacketLength );
+
+/**
+ * @brief Removes a packet. Implements MQTTInflightStoreRemove_t.
+ */
+    static void prvRingStoreRemove( void * pvStoreContext,
+                                    uint16_t usPacketIdentifier );
+
+/**
+ * @brief Reads a stored packet. Implements MQTTInflightStoreGet_t.
+ */
+    static MQTTBool_t prvRingStoreGet( void * pvStoreContext,
+                                       uint32_t ulIndex,
+                                       uint16_t * pusPacketIdentifier,
+                                       const uint8_t ** ppucPacket,
+                                       uint32_t * pulPacketLength );
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvRingStoreCheck( const MQTTInflightRingStore_t * pxStore,
+                                       const RingStoreControl_t * pxControl )
+    {
+        return pxControl->ulMagic ^ pxControl->ulHead ^ pxControl->ulTail ^ pxControl->ulUsed ^ pxStore->ulStorageSize;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvRingStoreWriteControl( MQTTInflightRingStore_t * pxStore,
+                                          RingStoreControl_t * pxControl )
+    {
+        /* An empty ring always starts at the first record, so that the
+         * largest possible packet fits. */
+        if( pxControl->ulUsed == ( uint32_t ) 0 )
+        {
+            pxControl->ulHead = mqttringstoreFIRST_RECORD;
+            pxControl->ulTail = mqttringstoreFIRST_RECORD;
+        }
+
+        pxControl->ulCheck = prvRingStoreCheck( pxStore, pxControl );
+        ( void ) memcpy( pxStore->pucStorage, pxControl, sizeof( RingStoreControl_t ) );
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRingStoreNextRecord( const MQTTInflightRingStore_t * pxStore,
+                                              uint32_t * pulOffset,
+                                              uint32_t * pulRemaining,
+                                              uint32_t * pulRecordOffset,
+                                              RingStoreRecordHeader_t * pxHeader )
+    {
+        MQTTBool_t xFound = eMQTTFalse;
+        uint32_t ulSkipped;
+
+        while( ( xFound == eMQTTFalse ) && ( *pulRemaining > ( uint32_t ) 0 ) )
+        {
+            /* Follow the wrap at the end of the ring, implicit if there
+             * is no room left for a header. */
+            if( ( pxStore->ulStorageSize - *pulOffset ) >= mqttringstoreHEADER_SIZE )
+            {
+                ( void ) memcpy( pxHeader, &( pxStore->pucStorage[ *pulOffset ] ), sizeof( RingStoreRecordHeader_t ) );
+            }
+            else
+            {
+                pxHeader->ucState = mqttringstoreRECORD_WRAP;
+            }
+
+            if( pxHeader->ucState == mqttringstoreRECORD_WRAP )
+            {
+                ulSkipped = pxStore->ulStorageSize - *pulOffset;
+                *pulOffset = mqttringstoreFIRST_RECORD;
+            }
+            else
+            {
+                ulSkipped = mqttringstoreHEADER_SIZE + mqttringstoreALIGN( pxHeader->ulLength );
+                *pulRecordOffset = *pulOffset;
+                *pulOffset += ulSkipped;
+                xFound = eMQTTTrue;
+            }
+
+            *pulRemaining -= ulSkipped;
+        }
+
+        return xFound;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvRingStoreFind( const MQTTInflightRingStore_t * pxStore,
+                                      const RingStoreControl_t * pxControl,
+                                      uint16_t usPacketIdentifier )
+    {
+        uint32_t ulOffset = pxControl->ulHead, ulRemaining = pxControl->ulUsed, ulRecordOffset = 0;
+        uint32_t ulFoundOffset = 0;
+        RingStoreRecordHeader_t xHeader;
+
+        while( prvRingStoreNextRecord( pxStore, &ulOffset, &ulRemaining, &ulRecordOffset, &xHeader ) == eMQTTTrue )
+        {
+            if( ( xHeader.ucState == mqttringstoreRECORD_LIVE ) && ( xHeader.usPacketIdentifier == usPacketIdentifier ) )
+            {
+                ulFoundOffset = ulRecordOffset;
+                break;
+            }
+        }
+
+        return ulFoundOffset;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvRingStoreRemoveRecord( MQTTInflightRingStore_t * pxStore,
+                                          RingStoreControl_t * pxControl,
+                                          uint32_t ulRecordOffset )
+    {
+        uint32_t ulOffset = pxControl->ulHead, ulRemaining = pxControl->ulUsed, ulRecordStart = 0;
+        RingStoreRecordHeader_t xHeader;
+
+        pxStore->pucStorage[ ulRecordOffset + ( uint32_t ) offsetof( RingStoreRecordHeader_t, ucState ) ] = mqttringstoreRECORD_REMOVED;
+
+        /* Move the head past the removed records and wraps, so that their
+         * space can be reused. */
+        while( prvRingStoreNextRecord( pxStore, &ulOffset, &ulRemaining, &ulRecordStart, &xHeader ) == eMQTTTrue )
+        {
+            if( xHeader.ucState == mqttringstoreRECORD_LIVE )
+            {
+                ulOffset = ulRecordStart;
+                ulRemaining += mqttringstoreHEADER_SIZE + mqttringstoreALIGN( xHeader.ulLength );
+                break;
+            }
+        }
+
+        pxControl->ulHead = ulOffset;
+        pxControl->ulUsed = ulRemaining;
+        prvRingStoreWriteControl( pxStore, pxControl );
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRingStorePut( void * pvStoreContext,
+                                       uint16_t usPacketIdentifier,
+                                       const uint8_t * pucPacket,
+                                       uint32_t ulPacketLength )
+    {
+        MQTTInflightRingStore_t * pxStore = ( MQTTInflightRingStore_t * ) pvStoreContext;
+        RingStoreControl_t xControl;
+        RingStoreRecordHeader_t xHeader;
+        uint32_t ulRecordSize, ulOffset, ulSkipped = 0, ulOldRecord;
+        MQTTBool_t xStored = eMQTTFalse;
+
+        ( void ) memcpy( &xControl, pxStore->pucStorage, sizeof( RingStoreControl_t ) );
+
+        ulRecordSize = mqttringstoreHEADER_SIZE + mqttringstoreALIGN( ulPacketLength );
+        ulOffset = xControl.ulTail;
+
+        /* Find where the record fits. The free space is either between
+         * the tail and the end of the ring followed by the space up to
+         * the head at the start of the ring, or between the tail and the
+         * head. */
+        if( ( xControl.ulUsed == ( uint32_t ) 0 ) || ( xControl.ulTail > xControl.ulHead ) )
+        {
+            if( ( pxStore->ulStorageSize - ulOffset ) < ulRecordSize )
+            {
+                ulSkipped = pxStore->ulStorageSize - ulOffset;
+                ulOffset = mqttringstoreFIRST_RECORD;
+
+                if( ( xControl.ulUsed != ( uint32_t ) 0 ) && ( ( xControl.ulHead - ulOffset ) >= ulRecordSize ) )
+                {
+                    xStored = eMQTTTrue;
+                }
+            }
+            else
+            {
+                xStored = eMQTTTrue;
+            }
+        }
+        else if( ( xControl.ulHead - ulOffset ) >= ulRecordSize )
+        {
+            xStored = eMQTTTrue;
+        }
+
+        if( xStored == eMQTTTrue )
+        {
+            ulOldRecord = prvRingStoreFind( pxStore, &xControl, usPacketIdentifier );
+
+            /* Write the wrap marker if there is room for it. */
+            if( ulSkipped >= mqttringstoreHEADER_SIZE )
+            {
+                pxStore->pucStorage[ xControl.ulTail + ( uint32_t ) offsetof( RingStoreRecordHeader_t, ucState ) ] = mqttringstoreRECORD_WRAP;
+            }
+
+            /* Write the packet before the header, so that the record is
+             * live only once it is complete. */
+            ( void ) memcpy( &( pxStore->pucStorage[ ulOffset + mqttringstoreHEADER_SIZE ] ), pucPacket, ( size_t ) ulPacketLength );
+
+            xHeader.usPacketIdentifier = usPacketIdentifier;
+            xHeader.ucState = mqttringstoreRECORD_LIVE;
+            xHeader.ucReserved = 0;
+            xHeader.ulLength = ulPacketLength;
+            ( void ) memcpy( &( pxStore->pucStorage[ ulOffset ] ), &xHeader, sizeof( RingStoreRecordHeader_t ) );
+
+            xControl.ulTail = ulOffset + ulRecordSize;
+            xControl.ulUsed += ulSkipped + ulRecordSize;
+            prvRingStoreWriteControl( pxStore, &xControl );
+
+            /* The new packet replaces the packet stored earlier with the
+             * same packet identifier (a PUBREL replaces the PUBLISH). */
+            if( ulOldRecord != ( uint32_t ) 0 )
+            {
+                prvRingStoreRemoveRecord( pxStore, &xControl, ulOldRecord );
+            }
+        }
+
+        return xStored;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvRingStoreRemove( void * pvStoreContext,
+                                    uint16_t usPacketIdentifier )
+    {
+        MQTTInflightRingStore_t * pxStore = ( MQTTInflightRingStore_t * ) pvStoreContext;
+        RingStoreControl_t xControl;
+        uint32_t ulRecordOffset;
+
+        ( void ) memcpy( &xControl, pxStore->pucStorage, sizeof( RingStoreControl_t ) );
+
+        ulRecordOffset = prvRingStoreFind( pxStore, &xControl, usPacketIdentifier );
+
+        if( ulRecordOffset != ( uint32_t ) 0 )
+        {
+            prvRingStoreRemoveRecord( pxStore, &xControl, ulRecordOffset );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRingStoreGet( void * pvStoreContext,
+                                       uint32_t ulIndex,
+                                       uint16_t * pusPacketIdentifier,
+                                       const uint8_t ** ppucPacket,
+                                       uint32_t * pulPacketLength )
+    {
+        const MQTTInflightRingStore_t * pxStore = ( const MQTTInflightRingStore_t * ) pvStoreContext;
+        RingStoreControl_t xControl;
+        RingStoreRecordHeader_t xHeader;
+        uint32_t ulOffset, ulRemaining, ulRecordOffset = 0, ulLiveRecords = 0;
+        MQTTBool_t xFound = eMQTTFalse;
+
+        ( void ) memcpy( &xControl, pxStore->pucStorage, sizeof( RingStoreControl_t ) );
+
+        ulOffset = xControl.ulHead;
+        ulRemaining = xControl.ulUsed;
+
+        while( prvRingStoreNextRecord( pxStore, &ulOffset, &ulRemaining, &ulRecordOffset, &xHeader ) == eMQTTTrue )
+        {
+            if( xHeader.ucState == mqttringstoreRECORD_LIVE )
+            {
+                if( ulLiveRecords == ulIndex )
+                {
+                    *pusPacketIdentifier = xHeader.usPacketIdentifier;
+                    *ppucPacket = &( pxStore->pucStorage[ ulRecordOffset + mqttringstoreHEADER_SIZE ] );
+                    *pulPacketLength = xHeader.ulLength;
+                    xFound = eMQTTTrue;
+                    break;
+                }
+
+                ulLiveRecords++;
+            }
+        }
+
+        return xFound;
+    }
+/*-----------------------------------------------------------*/
+
+    const MQTTInflightStoreInterface_t * MQTT_InflightRingStoreInit( MQTTInflightRingStore_t * pxStore,
+                                                                     uint8_t * pucStorage,
+                                                                     uint32_t ulStorageSize,
+                                                                     uint32_t ulResendTimeoutTicks )
+    {
+        RingStoreControl_t xControl;
+
+        mqttconfigASSERT( pxStore != NULL );
+        mqttconfigASSERT( pucStorage != NULL );
+        mqttconfigASSERT( ulStorageSize > ( mqttringstoreFIRST_RECORD + mqttringstoreHEADER_SIZE ) );
+
+        pxStore->pucStorage = pucStorage;
+
+        /* Records always start at a multiple of 4, so any bytes after the
+         * last multiple of 4 are never used. */
+        pxStore->ulStorageSize = ulStorageSize & ~( ( uint32_t ) 3 );
+
+        pxStore->xInterface.pvStoreContext = ( void * ) pxStore;
+        pxStore->xInterface.pxPutFxn = prvRingStorePut;
+        pxStore->xInterface.pxRemoveFxn = prvRingStoreRemove;
+        pxStore->xInterface.pxGetFxn = prvRingStoreGet;
+        pxStore->xInterface.ulResendTimeoutTicks = ulResendTimeoutTicks;
+
+        /* Keep the stored packets if the memory region already holds a
+         * valid log of the same size, otherwise empty the log. */
+        ( void ) memcpy( &xControl, pucStorage, sizeof( RingStoreControl_t ) );
+
+        if( ( xControl.ulMagic != mqttringstoreMAGIC ) ||
+            ( xControl.ulCheck != prvRingStoreCheck( pxStore, &xControl ) ) ||
+            ( xControl.ulHead < mqttringstoreFIRST_RECORD ) ||
+            ( xControl.ulHead > pxStore->ulStorageSize ) ||
+            ( xControl.ulTail < mqttringstoreFIRST_RECORD ) ||
+            ( xControl.ulTail > pxStore->ulStorageSize ) ||
+            ( xControl.ulUsed > ( pxStore->ulStorageSize - mqttringstoreFIRST_RECORD ) ) ||
+            ( ( ( xControl.ulHead | xControl.ulTail ) & ( uint32_t ) 3 ) != ( uint32_t ) 0 ) )
+        {
+            xControl.ulMagic = mqttringstoreMAGIC;
+            xControl.ulUsed = 0;
+            prvRingStoreWriteControl( pxStore, &xControl );
+        }
+
+        return &( pxStore->xInterface );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+/**
+ * @brief XORed with the sequence number of a block in its header.
+ */
+    #define mqttflashstoreBLOCK_MAGIC             ( ( uint32_t ) 0x4D514653 )
+
+/**
+ * @defgroup FlashStoreRecordStates States of a record in the flash log.
+ *
+ * Each state only clears bits of the previous one, so that the state can be
+ * updated in flash without erasing it. A record still in the erased state
+ * was not completely written and is skipped.
+ */
+/** @{ */
+    #define mqttflashstoreRECORD_ERASED           ( ( uint8_t ) 0xFF ) /**< The record is being written. */
+    #define mqttflashstoreRECORD_LIVE             ( ( uint8_t ) 0x5A ) /**< The record holds a stored packet. */
+    #define mqttflashstoreRECORD_REMOVED          ( ( uint8_t ) 0x00 ) /**< The packet in the record has been removed. */
+/** @} */
+
+/**
+ * @brief Rounds up the given length to a multiple of 4.
+ */
+    #define mqttflashstoreALIGN( ulLength )       ( ( ( ulLength ) + ( uint32_t ) 3 ) & ~( ( uint32_t ) 3 ) )
+
+/**
+ * @brief The header at the start of every block in use.
+ *
+ * The blocks are used in order, each with the next sequence number, so the
+ * oldest and the newest blocks of the log are found from their sequence
+ * numbers.
+ */
+    typedef struct FlashStoreBlockHeader
+    {
+        uint32_t ulSequence; /**< Sequence number of the block. */
+        uint32_t ulCheck;    /**< ulSequence XOR mqttflashstoreBLOCK_MAGIC if the header is valid. */
+    } FlashStoreBlockHeader_t;
+
+/**
+ * @brief The header preceding every record in a block.
+ *
+ * The packet follows the header and the next record starts at the next
+ * multiple of 4. An erased header ends the records of the block.
+ */
+    typedef struct FlashStoreRecordHeader
+    {
+        uint16_t usPacketIdentifier; /**< Packet identifier of the stored packet. */
+        uint8_t ucState;             /**< One of the @ref FlashStoreRecordStates. */
+        uint8_t ucReserved;          /**< Left erased. */
+        uint32_t ulLength;           /**< Length of the stored packet. */
+    } FlashStoreRecordHeader_t;
+
+/**
+ * @brief The size of a block header.
+ */
+    #define mqttflashstoreBLOCK_HEADER_SIZE       ( ( uint32_t ) sizeof( FlashStoreBlockHeader_t ) )
+
+/**
+ * @brief The size of a record header.
+ */
+    #define mqttflashstoreRECORD_HEADER_SIZE      ( ( uint32_t ) sizeof( FlashStoreRecordHeader_t ) )
+
+/**
+ * @brief The size of the record storing a packet of the given length.
+ */
+    #define mqttflashstoreRECORD_SIZE( ulLength )    ( mqttflashstoreRECORD_HEADER_SIZE + mqttflashstoreALIGN( ulLength ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reads the header of the given block.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] ulBlock The index of the block.
+ * @param[out] pulSequence The sequence number of the block.
+ *
+ * @return eMQTTTrue if the block holds a valid header, eMQTTFalse otherwise.
+ */
+    static MQTTBool_t prvFlashStoreReadBlockHeader( const MQTTInflightFlashStore_t * pxStore,
+                                                    uint32_t ulBlock,
+                                                    uint32_t * pulSequence );
+
+/**
+ * @brief Reads the record at the given offset.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] ulOffset The offset of the record.
+ * @param[out] pxHeader The header of the record. All its bytes are 0xFF if
+ * the header is erased.
+ *
+ * @return The size of the record, or 0 if the block has no more records
+ * from this offset.
+ */
+    static uint32_t prvFlashStoreReadRecord( const MQTTInflightFlashStore_t * pxStore,
+                                             uint32_t ulOffset,
+                                             FlashStoreRecordHeader_t * pxHeader );
+
+/**
+ * @brief Reads the record at the given offset, or the first one after it,
+ * and moves the offset to the next record.
+ *
+ * The end of a block is followed by the first record of the next block.
+ *
+ * @param[in] pxStore The store.
+ * @param[in, out] pulOffset The offset to read from. It can be the end of a
+ * block. Updated to the offset after the returned record.
+ * @param[out] pulRecordOffset The offset of the returned record.
+ * @param[out] pxHeader The header of the returned record.
+ *
+ * @return eMQTTTrue if a record is returned, eMQTTFalse if the tail has
+ * been reached.
+ */
+    static MQTTBool_t prvFlashStoreNextRecord( const MQTTInflightFlashStore_t * pxStore,
+                                               uint32_t * pulOffset,
+                                               uint32_t * pulRecordOffset,
+                                               FlashStoreRecordHeader_t * pxHeader );
+
+/**
+ * @brief Finds the live record storing the given packet identifier.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] ulOffset The offset to search from.
+ * @param[in] usPacketIdentifier The packet identifier to find.
+ *
+ * @return The offset of the record, or 0 if it is not found.
+ */
+    static uint32_t prvFlashStoreFind( const MQTTInflightFlashStore_t * pxStore,
+                                       uint32_t ulOffset,
+                                       uint16_t usPacketIdentifier );
+
+/**
+ * @brief Marks the record at the given offset as removed and moves the head
+ * to the next live record if it was the oldest one.
+ *
+ * @param[in] pxStore The store.
+ * @param[in] ulRecordOffset The offset of the record to remove.
+ */
+    static void prvFlashStoreRemoveRecord( MQTTInflightFlashStore_t * pxStore,
+                                           uint32_t ulRecordOffset );
+
+/**
+ * @brief Erases the block after the tail block and moves the tail to it.
+ *
+ * @param[in] pxStore The store.
+ *
+ * @return eMQTTTrue if the tail was moved, eMQTTFalse if the next block
+ * holds the head or could not be erased.
+ */
+    static MQTTBool_t prvFlashStoreStartNextBlock( MQTTInflightFlashStore_t * pxStore );
+
+/**
+ * @brief Recovers the head, the tail and the number of packets of the log
+ * from the region.
+ *
+ * @param[in] pxStore The store.
+ */
+    static void prvFlashStoreRecover( MQTTInflightFlashStore_t * pxStore );
+
+/**
+ * @brief Stores a packet. Implements MQTTInflightStorePut_t.
+ */
+    static MQTTBool_t prvFlashStorePut( void * pvStoreContext,
+                                        uint16_t usPacketIdentifier,
+                                        const uint8_t * pucPacket,
+                                        uint32_t ulPacketLength );
+
+/**
+ * @brief Removes a packet. Implements MQTTInflightStoreRemove_t.
+ */
+    static void prvFlashStoreRemove( void * pvStoreContext,
+                                     uint16_t usPacketIdentifier );
+
+/**
+ * @brief Reads a stored packet. Implements MQTTInflightStoreGet_t.
+ */
+    static MQTTBool_t prvFlashStoreGet( void * pvStoreContext,
+                                        uint32_t ulIndex,
+                                        uint16_t * pusPacketIdentifier,
+                                        const uint8_t ** ppucPacket,
+                                        uint32_t * pulPacketLength );
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFlashStoreReadBlockHeader( const MQTTInflightFlashStore_t * pxStore,
+                                                    uint32_t ulBlock,
+                                                    uint32_t * pulSequence )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        FlashStoreBlockHeader_t xHeader;
+        MQTTBool_t xValid = eMQTTFalse;
+
+        if( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                ulBlock * pxFlash->ulBlockSize,
+                                ( uint8_t * ) &xHeader,
+                                mqttflashstoreBLOCK_HEADER_SIZE ) == eMQTTTrue )
+        {
+            if( ( xHeader.ulSequence ^ mqttflashstoreBLOCK_MAGIC ) == xHeader.ulCheck )
+            {
+                *pulSequence = xHeader.ulSequence;
+                xValid = eMQTTTrue;
+            }
+        }
+
+        return xValid;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvFlashStoreReadRecord( const MQTTInflightFlashStore_t * pxStore,
+                                             uint32_t ulOffset,
+                                             FlashStoreRecordHeader_t * pxHeader )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        const uint32_t ulBlockEnd = ( ( ulOffset / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+        uint32_t ulSize = 0;
+
+        /* The bytes at the end of a block too few for a header are
+         * never used. */
+        memset( pxHeader, 0x00, sizeof( FlashStoreRecordHeader_t ) );
+
+        if( ( ulBlockEnd - ulOffset ) >= mqttflashstoreRECORD_HEADER_SIZE )
+        {
+            if( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                    ulOffset,
+                                    ( uint8_t * ) pxHeader,
+                                    mqttflashstoreRECORD_HEADER_SIZE ) == eMQTTTrue )
+            {
+                /* An erased header is the end of the records. One which
+                 * does not fit in the block was not completely written,
+                 * which also ends them. */
+                if( ( pxHeader->ulLength <= pxFlash->ulBlockSize ) &&
+                    ( mqttflashstoreRECORD_SIZE( pxHeader->ulLength ) <= ( ulBlockEnd - ulOffset ) ) )
+                {
+                    ulSize = mqttflashstoreRECORD_SIZE( pxHeader->ulLength );
+                }
+            }
+            else
+            {
+                memset( pxHeader, 0x00, sizeof( FlashStoreRecordHeader_t ) );
+            }
+        }
+
+        return ulSize;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFlashStoreNextRecord( const MQTTInflightFlashStore_t * pxStore,
+                                               uint32_t * pulOffset,
+                                               uint32_t * pulRecordOffset,
+                                               FlashStoreRecordHeader_t * pxHeader )
+    {
+        const uint32_t ulBlockSize = pxStore->pxFlash->ulBlockSize;
+        const uint32_t ulRegionSize = ulBlockSize * pxStore->pxFlash->ulBlockCount;
+        const uint32_t ulTailBlock = ( pxStore->ulTailOffset - ( uint32_t ) 1 ) / ulBlockSize;
+        uint32_t ulSize;
+        MQTTBool_t xFound = eMQTTFalse;
+
+        while( ( xFound == eMQTTFalse ) && ( *pulOffset != pxStore->ulTailOffset ) )
+        {
+            if( ( *pulOffset % ulBlockSize ) == ( uint32_t ) 0 )
+            {
+                *pulOffset = ( *pulOffset % ulRegionSize ) + mqttflashstoreBLOCK_HEADER_SIZE;
+            }
+            else
+            {
+                ulSize = prvFlashStoreReadRecord( pxStore, *pulOffset, pxHeader );
+
+                if( ulSize == ( uint32_t ) 0 )
+                {
+                    /* The tail block always has records up to the tail. */
+                    if( ( *pulOffset / ulBlockSize ) == ulTailBlock )
+                    {
+                        *pulOffset = pxStore->ulTailOffset;
+                    }
+                    else
+                    {
+                        *pulOffset = ( ( *pulOffset / ulBlockSize ) + ( uint32_t ) 1 ) * ulBlockSize;
+                    }
+                }
+                else
+                {
+                    *pulRecordOffset = *pulOffset;
+                    *pulOffset += ulSize;
+                    xFound = eMQTTTrue;
+                }
+            }
+        }
+
+        return xFound;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvFlashStoreFind( const MQTTInflightFlashStore_t * pxStore,
+                                       uint32_t ulOffset,
+                                       uint16_t usPacketIdentifier )
+    {
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulRecordOffset = 0, ulFoundOffset = 0;
+
+        if( pxStore->ulPackets > ( uint32_t ) 0 )
+        {
+            while( prvFlashStoreNextRecord( pxStore, &ulOffset, &ulRecordOffset, &xHeader ) == eMQTTTrue )
+            {
+                if( ( xHeader.ucState == mqttflashstoreRECORD_LIVE ) && ( xHeader.usPacketIdentifier == usPacketIdentifier ) )
+                {
+                    ulFoundOffset = ulRecordOffset;
+                    break;
+                }
+            }
+        }
+
+        return ulFoundOffset;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvFlashStoreRemoveRecord( MQTTInflightFlashStore_t * pxStore,
+                                           uint32_t ulRecordOffset )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulOffset, ulLiveOffset = 0;
+        uint8_t ucState = mqttflashstoreRECORD_REMOVED;
+
+        /* If the state cannot be written, the packet is re-transmitted
+         * after a reset, which the broker tolerates. */
+        ( void ) pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                      ulRecordOffset + ( uint32_t ) offsetof( FlashStoreRecordHeader_t, ucState ),
+                                      &ucState,
+                                      ( uint32_t ) 1 );
+
+        pxStore->ulPackets--;
+
+        if( pxStore->ulPackets == ( uint32_t ) 0 )
+        {
+            pxStore->ulHeadOffset = pxStore->ulTailOffset;
+        }
+        else if( ulRecordOffset == pxStore->ulHeadOffset )
+        {
+            /* Move the head to the next live record, so that the blocks
+             * before it can be reused. */
+            ulOffset = ulRecordOffset;
+            pxStore->ulHeadOffset = pxStore->ulTailOffset;
+
+            while( prvFlashStoreNextRecord( pxStore, &ulOffset, &ulLiveOffset, &xHeader ) == eMQTTTrue )
+            {
+                if( xHeader.ucState == mqttflashstoreRECORD_LIVE )
+                {
+                    pxStore->ulHeadOffset = ulLiveOffset;
+                    break;
+                }
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFlashStoreStartNextBlock( MQTTInflightFlashStore_t * pxStore )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        const uint32_t ulNextBlock = ( ( pxStore->ulTailOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize + ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+        FlashStoreBlockHeader_t xHeader;
+        MQTTBool_t xStarted = eMQTTFalse;
+
+        /* The block holding the oldest packet is reused only once the
+         * packet has been removed. */
+        if( ( pxStore->ulPackets == ( uint32_t ) 0 ) || ( ( pxStore->ulHeadOffset / pxFlash->ulBlockSize ) != ulNextBlock ) )
+        {
+            xHeader.ulSequence = pxStore->ulNextSequence;
+            xHeader.ulCheck = xHeader.ulSequence ^ mqttflashstoreBLOCK_MAGIC;
+
+            if( ( pxFlash->pxEraseFxn( pxFlash->pvFlashContext, ulNextBlock ) == eMQTTTrue ) &&
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                       ulNextBlock * pxFlash->ulBlockSize,
+                                       ( const uint8_t * ) &xHeader,
+                                       mqttflashstoreBLOCK_HEADER_SIZE ) == eMQTTTrue ) )
+            {
+                pxStore->ulNextSequence++;
+                pxStore->ulTailOffset = ( ulNextBlock * pxFlash->ulBlockSize ) + mqttflashstoreBLOCK_HEADER_SIZE;
+                xStarted = eMQTTTrue;
+            }
+            else
+            {
+                /* The block may be half erased and no packet is written
+                 * to it. Using it again needs another erase. */
+                pxStore->ulTailOffset = ( ulNextBlock + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+            }
+
+            /* The head of an empty store follows the tail. */
+            if( pxStore->ulPackets == ( uint32_t ) 0 )
+            {
+                pxStore->ulHeadOffset = pxStore->ulTailOffset;
+            }
+        }
+
+        return xStarted;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvFlashStoreRecover( MQTTInflightFlashStore_t * pxStore )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulBlock, ulNewestBlock = 0, ulOldestBlock, ulPreviousBlock;
+        uint32_t ulSequence, ulNewestSequence = 0, ulOldestSequence, ulOffset, ulBlockEnd, ulSize;
+        MQTTBool_t xAnyBlock = eMQTTFalse, xFoundHead = eMQTTFalse;
+
+        pxStore->ulPackets = 0;
+
+        /* The newest block has the highest sequence number. */
+        for( ulBlock = 0; ulBlock < pxFlash->ulBlockCount; ulBlock++ )
+        {
+            if( prvFlashStoreReadBlockHeader( pxStore, ulBlock, &ulSequence ) == eMQTTTrue )
+            {
+                if( ( xAnyBlock == eMQTTFalse ) || ( ( int32_t ) ( ulSequence - ulNewestSequence ) > 0 ) )
+                {
+                    ulNewestBlock = ulBlock;
+                    ulNewestSequence = ulSequence;
+                }
+
+                xAnyBlock = eMQTTTrue;
+            }
+        }
+
+        if( xAnyBlock == eMQTTFalse )
+        {
+            /* An empty log. The first packet starts the first block. */
+            pxStore->ulTailOffset = pxFlash->ulBlockCount * pxFlash->ulBlockSize;
+            pxStore->ulNextSequence = 0;
+        }
+        else
+        {
+            /* The blocks of the log precede the newest block with
+             * consecutive sequence numbers. */
+            ulOldestBlock = ulNewestBlock;
+            ulOldestSequence = ulNewestSequence;
+
+            for( ; ; )
+            {
+                ulPreviousBlock = ( ulOldestBlock + pxFlash->ulBlockCount - ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+
+                if( ( ulPreviousBlock == ulNewestBlock ) ||
+                    ( prvFlashStoreReadBlockHeader( pxStore, ulPreviousBlock, &ulSequence ) == eMQTTFalse ) ||
+                    ( ulSequence != ( ulOldestSequence - ( uint32_t ) 1 ) ) )
+                {
+                    break;
+                }
+
+                ulOldestBlock = ulPreviousBlock;
+                ulOldestSequence = ulSequence;
+            }
+
+            /* Count the live records from the oldest block on. The tail is
+             * after the last record of the newest block. */
+            ulBlock = ulOldestBlock;
+
+            for( ; ; )
+            {
+                ulOffset = ( ulBlock * pxFlash->ulBlockSize ) + mqttflashstoreBLOCK_HEADER_SIZE;
+                ulBlockEnd = ( ulBlock + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+
+                while( ulOffset < ulBlockEnd )
+                {
+                    ulSize = prvFlashStoreReadRecord( pxStore, ulOffset, &xHeader );
+
+                    if( ulSize == ( uint32_t ) 0 )
+                    {
+                        /* Only an erased header can be written over. */
+                        if( ( xHeader.usPacketIdentifier != ( uint16_t ) 0xFFFF ) ||
+                            ( xHeader.ucState != mqttflashstoreRECORD_ERASED ) ||
+                            ( xHeader.ucReserved != ( uint8_t ) 0xFF ) ||
+                            ( xHeader.ulLength != ( uint32_t ) 0xFFFFFFFF ) )
+                        {
+                            ulOffset = ulBlockEnd;
+                        }
+
+                        break;
+                    }
+
+                    if( xHeader.ucState == mqttflashstoreRECORD_LIVE )
+                    {
+                        if( xFoundHead == eMQTTFalse )
+                        {
+                            pxStore->ulHeadOffset = ulOffset;
+                            xFoundHead = eMQTTTrue;
+                        }
+
+                        pxStore->ulPackets++;
+                    }
+
+                    ulOffset += ulSize;
+                }
+
+                if( ulBlock == ulNewestBlock )
+                {
+                    pxStore->ulTailOffset = ulOffset;
+                    break;
+                }
+
+                ulBlock = ( ulBlock + ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+            }
+
+            pxStore->ulNextSequence = ulNewestSequence + ( uint32_t ) 1;
+        }
+
+        if( xFoundHead == eMQTTFalse )
+        {
+            pxStore->ulHeadOffset = pxStore->ulTailOffset;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFlashStorePut( void * pvStoreContext,
+                                        uint16_t usPacketIdentifier,
+                                        const uint8_t * pucPacket,
+                                        uint32_t ulPacketLength )
+    {
+        MQTTInflightFlashStore_t * pxStore = ( MQTTInflightFlashStore_t * ) pvStoreContext;
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        const uint32_t ulRecordSize = mqttflashstoreRECORD_SIZE( ulPacketLength );
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulOffset, ulBlockEnd, ulOldRecord = 0;
+        uint8_t ucState = mqttflashstoreRECORD_LIVE;
+        MQTTBool_t xStored = eMQTTFalse;
+
+        /* A record never spans two blocks, and must fit in the buffer the
+         * packets are read into. */
+        if( ( ulPacketLength <= pxStore->ulBufferSize ) &&
+            ( ulPacketLength <= pxFlash->ulBlockSize ) &&
+            ( ulRecordSize <= ( pxFlash->ulBlockSize - mqttflashstoreBLOCK_HEADER_SIZE ) ) )
+        {
+            ulOldRecord = prvFlashStoreFind( pxStore, pxStore->ulHeadOffset, usPacketIdentifier );
+            ulBlockEnd = ( ( ( pxStore->ulTailOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+
+            if( ( ulBlockEnd - pxStore->ulTailOffset ) >= ulRecordSize )
+            {
+                xStored = eMQTTTrue;
+            }
+            else
+            {
+                xStored = prvFlashStoreStartNextBlock( pxStore );
+            }
+        }
+
+        if( xStored == eMQTTTrue )
+        {
+            ulOffset = pxStore->ulTailOffset;
+
+            /* Write the header in the erased state and the packet, then
+             * the state, so that the record is live only once it is
+             * complete. */
+            xHeader.usPacketIdentifier = usPacketIdentifier;
+            xHeader.ucState = mqttflashstoreRECORD_ERASED;
+            xHeader.ucReserved = ( uint8_t ) 0xFF;
+            xHeader.ulLength = ulPacketLength;
+
+            if( ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext, ulOffset, ( const uint8_t * ) &xHeader, mqttflashstoreRECORD_HEADER_SIZE ) == eMQTTFalse ) ||
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext, ulOffset + mqttflashstoreRECORD_HEADER_SIZE, pucPacket, ulPacketLength ) == eMQTTFalse ) ||
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                       ulOffset + ( uint32_t ) offsetof( FlashStoreRecordHeader_t, ucState ),
+                                       &ucState,
+                                       ( uint32_t ) 1 ) == eMQTTFalse ) )
+            {
+                /* The rest of the block is in an unknown state, so it is
+                 * not used anymore. */
+                pxStore->ulTailOffset = ( ( ( ulOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+                xStored = eMQTTFalse;
+            }
+            else
+            {
+                pxStore->ulTailOffset = ulOffset + ulRecordSize;
+
+                if( pxStore->ulPackets == ( uint32_t ) 0 )
+                {
+                    pxStore->ulHeadOffset = ulOffset;
+                }
+
+                pxStore->ulPackets++;
+
+                /* The new packet replaces the packet stored earlier with
+                 * the same packet identifier (a PUBREL replaces the
+                 * PUBLISH). */
+                if( ulOldRecord != ( uint32_t ) 0 )
+                {
+                    prvFlashStoreRemoveRecord( pxStore, ulOldRecord );
+                }
+            }
+
+            if( pxStore->ulPackets == ( uint32_t ) 0 )
+            {
+                pxStore->ulHeadOffset = pxStore->ulTailOffset;
+            }
+        }
+
+        return xStored;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvFlashStoreRemove( void * pvStoreContext,
+                                     uint16_t usPacketIdentifier )
+    {
+        MQTTInflightFlashStore_t * pxStore = ( MQTTInflightFlashStore_t * ) pvStoreContext;
+        uint32_t ulRecordOffset;
+
+        ulRecordOffset = prvFlashStoreFind( pxStore, pxStore->ulHeadOffset, usPacketIdentifier );
+
+        if( ulRecordOffset != ( uint32_t ) 0 )
+        {
+            prvFlashStoreRemoveRecord( pxStore, ulRecordOffset );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFlashStoreGet( void * pvStoreContext,
+                                        uint32_t ulIndex,
+                                        uint16_t * pusPacketIdentifier,
+                                        const uint8_t ** ppucPacket,
+                                        uint32_t * pulPacketLength )
+    {
+        const MQTTInflightFlashStore_t * pxStore = ( const MQTTInflightFlashStore_t * ) pvStoreContext;
+        const MQTTOfflineFlashInterface_t * pxFlash = pxStore->pxFlash;
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulOffset = pxStore->ulHeadOffset, ulRecordOffset = 0, ulLiveRecords = 0;
+        MQTTBool_t xFound = eMQTTFalse;
+
+        if( ulIndex < pxStore->ulPackets )
+        {
+            while( prvFlashStoreNextRecord( pxStore, &ulOffset, &ulRecordOffset, &xHeader ) == eMQTTTrue )
+            {
+                if( xHeader.ucState == mqttflashstoreRECORD_LIVE )
+                {
+                    if( ulLiveRecords == ulIndex )
+                    {
+                        if( ( xHeader.ulLength <= pxStore->ulBufferSize ) &&
+                            ( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                                  ulRecordOffset + mqttflashstoreRECORD_HEADER_SIZE,
+                                                  pxStore->pucBuffer,
+                                                  xHeader.ulLength ) == eMQTTTrue ) )
+                        {
+                            *pusPacketIdentifier = xHeader.usPacketIdentifier;
+                            *ppucPacket = pxStore->pucBuffer;
+                            *pulPacketLength = xHeader.ulLength;
+                            xFound = eMQTTTrue;
+                        }
+
+                        break;
+                    }
+
+                    ulLiveRecords++;
+                }
+            }
+        }
+
+        return xFound;
+    }
+/*-----------------------------------------------------------*/
+
+    const MQTTInflightStoreInterface_t * MQTT_InflightFlashStoreInit( MQTTInflightFlashStore_t * pxStore,
+                                                                      const MQTTOfflineFlashInterface_t * pxFlash,
+                                                                      uint8_t * pucBuffer,
+                                                                      uint32_t ulBufferSize,
+                                                                      uint32_t ulResendTimeoutTicks )
+    {
+        FlashStoreRecordHeader_t xHeader;
+        uint32_t ulOffset, ulRecordOffset = 0;
+
+        mqttconfigASSERT( pxStore != NULL );
+        mqttconfigASSERT( pxFlash != NULL );
+        mqttconfigASSERT( pucBuffer != NULL );
+        mqttconfigASSERT( pxFlash->ulBlockCount >= ( uint32_t ) 2 );
+        mqttconfigASSERT( ( pxFlash->ulBlockSize & ( uint32_t ) 3 ) == ( uint32_t ) 0 );
+        mqttconfigASSERT( pxFlash->ulBlockSize > ( mqttflashstoreBLOCK_HEADER_SIZE + mqttflashstoreRECORD_HEADER_SIZE ) );
+
+        pxStore->pxFlash = pxFlash;
+        pxStore->pucBuffer = pucBuffer;
+        pxStore->ulBufferSize = ulBufferSize;
+
+        pxStore->xInterface.pvStoreContext = ( void * ) pxStore;
+        pxStore->xInterface.pxPutFxn = prvFlashStorePut;
+        pxStore->xInterface.pxRemoveFxn = prvFlashStoreRemove;
+        pxStore->xInterface.pxGetFxn = prvFlashStoreGet;
+        pxStore->xInterface.ulResendTimeoutTicks = ulResendTimeoutTicks;
+
+        prvFlashStoreRecover( pxStore );
+
+        /* A reset between storing a packet and removing the one it
+         * replaces leaves both live. The newer one is kept. */
+        ulOffset = pxStore->ulHeadOffset;
+
+        while( prvFlashStoreNextRecord( pxStore, &ulOffset, &ulRecordOffset, &xHeader ) == eMQTTTrue )
+        {
+            if( ( xHeader.ucState == mqttflashstoreRECORD_LIVE ) &&
+                ( prvFlashStoreFind( pxStore, ulOffset, xHeader.usPacketIdentifier ) != ( uint32_t ) 0 ) )
+            {
+                prvFlashStoreRemoveRecord( pxStore, ulRecordOffset );
+            }
+        }
+
+        return &( pxStore->xInterface );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
@@ -104,6 +104,61 @@
  */
 #define mqttPROTOCOL_LEVEL    ( ( uint8_t ) 0x04 )
 
+/**
+ * @brief Protocol level value is 5 for version 5.
+ */
+#define mqttPROTOCOL_LEVEL_MQTT5    ( ( uint8_t ) 0x05 )
+
+/**
+ * @defgroup Properties MQTT 5 property identifiers used by the library.
+ */
+/** @{ */
+#define mqttPROPERTY_SESSION_EXPIRY_INTERVAL    ( ( uint8_t ) 0x11 )
+#define mqttPROPERTY_RECEIVE_MAXIMUM            ( ( uint8_t ) 0x21 )
+#define mqttPROPERTY_TOPIC_ALIAS_MAXIMUM        ( ( uint8_t ) 0x22 )
+#define mqttPROPERTY_TOPIC_ALIAS                ( ( uint8_t ) 0x23 )
+/** @} */
+
+/**
+ * @defgroup PropertyTypes Encodings of the values of the MQTT 5 properties.
+ */
+/** @{ */
+#define mqttPROPERTY_TYPE_INVALID        ( ( uint8_t ) 0 ) /**< Not a property identifier. */
+#define mqttPROPERTY_TYPE_BYTE           ( ( uint8_t ) 1 ) /**< One byte. */
+#define mqttPROPERTY_TYPE_TWO_BYTES      ( ( uint8_t ) 2 ) /**< Two byte integer. */
+#define mqttPROPERTY_TYPE_FOUR_BYTES     ( ( uint8_t ) 4 ) /**< Four byte integer. */
+#define mqttPROPERTY_TYPE_VARIABLE       ( ( uint8_t ) 5 ) /**< Variable byte integer. */
+#define mqttPROPERTY_TYPE_STRING         ( ( uint8_t ) 6 ) /**< String or binary data prefixed with a two byte length. */
+#define mqttPROPERTY_TYPE_STRING_PAIR    ( ( uint8_t ) 7 ) /**< Two strings. */
+/** @} */
+
+/**
+ * @brief MQTT 5 reason codes of this value and above indicate a failure.
+ */
+#define mqttREASON_CODE_FAILURE    ( ( uint8_t ) 0x80 )
+
+/**
+ * @brief Length of the properties written in the MQTT 5 connect message,
+ * including the property length field.
+ *
+ * They are the Receive Maximum and the Topic Alias Maximum, and the Session
+ * Expiry Interval if a persistent session is requested.
+ */
+#define mqttCONNECT_PROPERTIES_LENGTH                     7
+#define mqttCONNECT_PERSISTENT_SESSION_PROPERTY_LENGTH    5
+
+/**
+ * @brief Length of an empty MQTT 5 property list, which is only the property
+ * length field.
+ */
+#define mqttNO_PROPERTIES_LENGTH    1
+
+/**
+ * @brief Length of the properties of an MQTT 5 publish message carrying a
+ * topic alias, including the property length field.
+ */
+#define mqttPUBLISH_TOPIC_ALIAS_PROPERTIES_LENGTH    4
+
 /**
  * @brief Macro to calculate total message length.
  *
@@ -131,6 +186,7 @@
 #define mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH    2
 #define mqttPUBLISH_QOS2_PACKET_IDENTIFER_LENGTH    2
 #define mqttPUBACK_PACKET_IDENTIFER_LENGTH          2
+#define mqttPUBACK_PACKET_LENGTH                    4 /**< PUBACK, PUBREC, PUBREL and PUBCOMP packets are all 4 bytes long. */
 /** @} */
 
 /**
@@ -195,10 +251,11 @@
  * variable header.
  */
 /** @{ */
-#define mqttCONNECT_FLAGS_OFFSET            9
-#define mqttCONNECT_KEEPALIVE_MSB_OFFSET    10
-#define mqttCONNECT_KEEPALIVE_LSB_OFFSET    11
-#define mqttCONNECT_CLIENT_ID_OFFSET        12
+#define mqttCONNECT_PROTOCOL_LEVEL_OFFSET    8
+#define mqttCONNECT_FLAGS_OFFSET             9
+#define mqttCONNECT_KEEPALIVE_MSB_OFFSET     10
+#define mqttCONNECT_KEEPALIVE_LSB_OFFSET     11
+#define mqttCONNECT_CLIENT_ID_OFFSET         12
 /** @} */
 
 /**
@@ -259,10 +316,26 @@
 
 /**
  * @defgroup PubAckOffsets Offsets to data within the PUBACK packet.
+ *
+ * PUBREC, PUBREL and PUBCOMP packets have the same layout.
  */
 /** @{ */
 #define mqttPUBACK_PACKET_ID_MSB_OFFSET    2
 #define mqttPUBACK_PACKET_ID_LSB_OFFSET    3
+#define mqttPUBACK_REASON_CODE_OFFSET      4 /**< MQTT 5 only, the reason code is 0 if it is left out. */
+#define mqttPUBACK_PROPERTIES_OFFSET       5 /**< MQTT 5 only. */
+/** @} */
+
+/**
+ * @defgroup MQTT5Offsets Offsets to the properties of the MQTT 5 CONNACK,
+ * SUBACK and UNSUBACK packets.
+ *
+ * The reason codes of the SUBACK and UNSUBACK packets follow the properties.
+ */
+/** @{ */
+#define mqttCONNACK_PROPERTIES_OFFSET     4
+#define mqttSUBACK_PROPERTIES_OFFSET      4
+#define mqttUNSUBACK_PROPERTIES_OFFSET    4
 /** @} */
 
 /**
@@ -298,6 +371,27 @@
 #define mqttLOWER_NIBBLE_MASK    ( ( uint8_t ) 0x0F )
 /** @} */
 
+/**
+ * @defgroup SubscriptionManager Helper macros for the topic trie of the
+ * subscription manager.
+ */
+/** @{ */
+#define mqttSUBSCRIPTION_NO_NODE             ( ( uint16_t ) 0xFFFF ) /**< Parent of the first level, and end of the node lists. */
+#define mqttSUBSCRIPTION_NO_LEVEL_NAME       ( ( uint16_t ) 0xFFFF ) /**< Level name of the '+' and '#' levels. */
+#define mqttSUBSCRIPTION_FNV_OFFSET_BASIS    ( ( uint32_t ) 2166136261UL )
+#define mqttSUBSCRIPTION_FNV_PRIME           ( ( uint32_t ) 16777619UL )
+/** @} */
+
+/**
+ * @brief Checks whether a level of a topic filter is a '+' or a '#' wild-card.
+ *
+ * @param[in] pucLevel The first character of the level.
+ * @param[in] usLevelLength The length of the level.
+ */
+#define mqttIS_WILD_CARD_LEVEL( pucLevel, usLevelLength )                 \
+    ( ( ( usLevelLength ) == ( uint16_t ) 1 ) &&                          \
+      ( ( ( pucLevel )[ 0 ] == ( uint8_t ) '+' ) || ( ( pucLevel )[ 0 ] == ( uint8_t ) '#' ) ) )
+
 /**
  * @brief Returns minimum of the two given values.
  *
@@ -328,6 +422,23 @@
     }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief The properties of a received MQTT 5 message used by the library.
+ *
+ * Each member holds the default value of the property if it is absent.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    typedef struct MQTTProperties
+    {
+        uint16_t usReceiveMaximum;    /**< Receive Maximum, 65535 if absent. */
+        uint16_t usTopicAliasMaximum; /**< Topic Alias Maximum, 0 if absent. */
+        uint16_t usTopicAlias;        /**< Topic Alias, 0 if absent. */
+    } MQTTProperties_t;
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Takes a buffer of the desired length from the free buffer
  * pool using the user supplied buffer pool interface and returns it.
@@ -490,6 +601,30 @@ static MQTTReturnCode_t prvSendData( MQTTContext_t * pxMQTTContext,
                                      const uint8_t * const pucData,
                                      uint32_t ulDataLength );
 
+/**
+ * @brief Transmits the given header and payload as one message.
+ *
+ * The send vectored function supplied by the user is used if there is one,
+ * otherwise the header and the payload are transmitted with two calls to
+ * the send function. Like prvSendData, it updates the last sent message
+ * timestamp.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ * @param[in] pucHeader The header to transmit.
+ * @param[in] ulHeaderLength Length of the header.
+ * @param[in] pucPayload The payload to transmit.
+ * @param[in] ulPayloadLength Length of the payload.
+ *
+ * @return eMQTTSuccess if send is successful, eMQTTSendFailed otherwise.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    static MQTTReturnCode_t prvSendDataVectored( MQTTContext_t * pxMQTTContext,
+                                                 const uint8_t * const pucHeader,
+                                                 uint32_t ulHeaderLength,
+                                                 const uint8_t * const pucPayload,
+                                                 uint32_t ulPayloadLength );
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
 /**
  * @brief Decodes and processes the received MQTT message containing only fixed header.
  *
@@ -565,6 +700,122 @@ static void prvProcessReceivedUNSUBACK( MQTTContext_t * pxMQTTContext );
  */
 static void prvProcessReceivedPUBACK( MQTTContext_t * pxMQTTContext );
 
+/**
+ * @brief Decodes and processes the received PUBREC message.
+ *
+ * It tries to find out if this is a valid and expected PUBREC i.e. a QoS2
+ * Publish message was sent before and has not timed out yet. The Publish
+ * message is then replaced by a PUBREL which is transmitted and waits for
+ * PUBCOMP. A PUBREC for a message which has already been released results
+ * in re-transmission of the PUBREL.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ */
+static void prvProcessReceivedPUBREC( MQTTContext_t * pxMQTTContext );
+
+/**
+ * @brief Decodes and processes the received PUBREL message.
+ *
+ * It forgets the packet identifier of the QoS2 publish message released by
+ * the broker and transmits the PUBCOMP.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ */
+static void prvProcessReceivedPUBREL( MQTTContext_t * pxMQTTContext );
+
+/**
+ * @brief Decodes and processes the received PUBCOMP message.
+ *
+ * It tries to find out if this is a valid and expected PUBCOMP i.e. a PUBREL
+ * message was sent before and has not timed out yet. It invokes the user supplied
+ * callback to inform about the received message.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ */
+static void prvProcessReceivedPUBCOMP( MQTTContext_t * pxMQTTContext );
+
+/**
+ * @brief Extracts the packet identifier from the received PUBACK, PUBREC,
+ * PUBREL or PUBCOMP message.
+ *
+ * With MQTT 5, the message may also carry a reason code and properties.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ * @param[in] ucControlByte The expected first byte of the message.
+ * @param[out] pusPacketIdentifier The extracted packet identifier.
+ * @param[out] pucReasonCode The extracted reason code, 0 if there is none.
+ *
+ * @return eMQTTTrue if the message is well formed, eMQTTFalse otherwise.
+ */
+static MQTTBool_t prvGetAckPacketIdentifier( const MQTTContext_t * pxMQTTContext,
+                                             uint8_t ucControlByte,
+                                             uint16_t * pusPacketIdentifier,
+                                             uint8_t * pucReasonCode );
+
+/**
+ * @brief Transmits a PUBACK, PUBREC, PUBREL or PUBCOMP message.
+ *
+ * These messages are not kept in the Tx buffer list. If the transmission
+ * fails, the broker re-transmits the message being acknowledged.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ * @param[in] ucControlByte The first byte of the message.
+ * @param[in] usPacketIdentifier The packet identifier to acknowledge.
+ */
+static void prvSendPublishAck( MQTTContext_t * pxMQTTContext,
+                               uint8_t ucControlByte,
+                               uint16_t usPacketIdentifier );
+
+/**
+ * @brief Remembers the packet identifier of a received QoS2 publish message.
+ *
+ * The broker may re-transmit a QoS2 publish message until it receives the
+ * PUBREC. The packet identifier is therefore remembered until the broker
+ * releases it with a PUBREL, so that the re-transmissions are not passed to
+ * the user again.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ * @param[in] usPacketIdentifier The packet identifier of the received message.
+ *
+ * @return eMQTTFalse if the message was received before and has not been
+ * released yet, eMQTTTrue otherwise.
+ */
+static MQTTBool_t prvIsNewQoS2Publish( MQTTContext_t * pxMQTTContext,
+                                       uint16_t usPacketIdentifier );
+
+/**
+ * @brief Checks whether a QoS2 publish message with the given packet
+ * identifier was received before and has not been released yet.
+ *
+ * Unlike prvIsNewQoS2Publish, it does not remember the packet identifier.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ * @param[in] usPacketIdentifier The packet identifier of the received message.
+ *
+ * @return eMQTTTrue if the message was received before, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+    static MQTTBool_t prvIsQoS2PublishReceived( const MQTTContext_t * pxMQTTContext,
+                                                uint16_t usPacketIdentifier );
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+
+/**
+ * @brief Re-transmits all the messages in the in-flight store.
+ *
+ * This is invoked when the broker accepts a new connection. Each stored
+ * message is copied in a Tx buffer and put on the waiting ACK list. The
+ * DUP flag is set in the re-transmitted Publish messages. If no free buffer
+ * is available, the remaining messages stay in the store and are
+ * re-transmitted on the next connection.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ */
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    static void prvResendInflightMessages( MQTTContext_t * pxMQTTContext );
+
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
 /**
  * @brief Decodes and processes the received PINGRESP message.
  *
@@ -589,6 +840,30 @@ static void prvProcessReceivedPINGRESP( MQTTContext_t * pxMQTTContext );
  */
 static void prvProcessReceivedPublish( MQTTContext_t * pxMQTTContext );
 
+/**
+ * @brief Passes the received bytes of a publish message being streamed to
+ * the user.
+ *
+ * The fixed header, the topic and the packet identifier are stored in the
+ * Rx buffer. Once they are complete, the user supplied callback is invoked
+ * with an empty chunk carrying the topic, and then with every part of the
+ * message as it is received, straight from pucReceivedData. When the whole
+ * message has been passed, it is acknowledged and the Rx state is reset.
+ * If the topic does not fit in the Rx buffer, the rest of the message is
+ * dropped instead.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which the message is received.
+ * @param[in] pucReceivedData The received bytes.
+ * @param[in] xReceivedDataLength The number of received bytes.
+ *
+ * @return The number of bytes which belong to the message.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+    static size_t prvStreamReceivedPublish( MQTTContext_t * pxMQTTContext,
+                                            const uint8_t * pucReceivedData,
+                                            size_t xReceivedDataLength );
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+
 /**
  * @brief Invokes the user supplied callback.
  *
@@ -686,164 +961,565 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                                          uint32_t * const pulRemainingLength );
 
 /**
- * @brief Store the subscription in the subscription manager.
+ * @brief Gets a buffer and writes a publish message into it.
  *
- * This function can fail to store the subscription if all the entries in the
- * subscription manager are in use or the topic name is longer than the maximum
- * length as specified by the mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH
- * macro or if the topic represents an invalid topic filter. eMQTTFalse is returned
- * to indicate the failure.
+ * The buffer is added to the Tx buffer list. If the payload is not copied, the
+ * buffer holds only the fixed header, the topic and the packet identifier,
+ * and the data length of the buffer is set to the length of those.
  *
- * @param[in] pxMQTTContext The MQTT context for which to store the subscription.
- * @param[in] pucTopic The topic this subscription entry is for.
- * @param[in] usTopicLength The length of the topic.
- * @param[in] pvPublishCallbackContext The user supplied callback context.
- * @param[in] pxPublishCallback The callback to invoke whenever a publish message
- * is received on this topic.
+ * @param[in] pxMQTTContext The MQTT context.
+ * @param[in] pxPublishParams The publish parameters.
+ * @param[in] xCopyPayload Whether or not to copy the payload into the buffer.
+ * @param[out] pxBuffer Used to return the buffer, if eMQTTSuccess is returned.
  *
- * @return eMQTTTrue if subscription is stored successfully, eMQTTFalse otherwise.
+ * @return eMQTTSuccess if the message is written, eMQTTClientNotConnected,
+ * eMQTTReceiveMaximumExceeded, eMQTTNoFreeBuffer or eMQTTFailure otherwise.
  */
-#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+static MQTTReturnCode_t prvPreparePublish( MQTTContext_t * pxMQTTContext,
+                                           const MQTTPublishParams_t * const pxPublishParams,
+                                           MQTTBool_t xCopyPayload,
+                                           MQTTBufferHandle_t * pxBuffer );
 
-    static MQTTBool_t prvStoreSubscription( MQTTContext_t * pxMQTTContext,
-                                            const uint8_t * const pucTopic,
-                                            uint16_t usTopicLength,
-                                            void * pvPublishCallbackContext,
-                                            MQTTPublishCallback_t pxPublishCallback );
+/**
+ * @brief Decodes a variable byte integer, which does not need to be complete.
+ *
+ * Same as prvDecodeRemainingLength except that it does not read beyond
+ * ulDataLength bytes.
+ *
+ * @param[in] pucData The encoded integer.
+ * @param[in] ulDataLength The number of bytes available at pucData.
+ * @param[out] pulValue The decoded integer.
+ *
+ * @return The number of bytes the integer spans, or 0 if it is malformed or
+ * not complete.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
 
-#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+    static uint8_t prvDecodeVariableByteInteger( const uint8_t * const pucData,
+                                                 uint32_t ulDataLength,
+                                                 uint32_t * const pulValue );
+
+#endif /* mqttconfigENABLE_MQTT5 */
 
 /**
- * @brief Removes the subscription entry from the subscription manager corresponding
- * to the provided topic.
+ * @brief Decodes the properties of a received MQTT 5 message.
  *
- * Iterates over all the entries in the subscription manager and tries to find
- * the one with the matching topic. If it finds one, removes it by marking it
- * free.
+ * Checks that every property is well formed and fits in the properties, and
+ * extracts the ones used by the library. The other ones are skipped.
  *
- * @param[in] pxMQTTContext The MQTT context for which to remove the subscription.
- * @param[in] pucTopic The topic for which the subscription entry is to be removed.
+ * @param[in] pucData The property length field followed by the properties.
+ * @param[in] ulDataLength The number of bytes of the message from pucData.
+ * @param[out] pxProperties The extracted properties.
+ *
+ * @return The length of the property length field and of the properties, or
+ * 0 if they are malformed.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static uint32_t prvDecodeProperties( const uint8_t * const pucData,
+                                         uint32_t ulDataLength,
+                                         MQTTProperties_t * const pxProperties );
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
+/**
+ * @brief Checks whether the broker already has as many QoS1 and QoS2 publish
+ * messages in flight as it accepts.
+ *
+ * The publish messages waiting for PUBACK or PUBREC and the PUBREL messages
+ * waiting for PUBCOMP in the Tx buffer list are counted.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ *
+ * @return eMQTTTrue if no more QoS1 and QoS2 publish messages can be sent,
+ * eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static MQTTBool_t prvIsReceiveMaximumReached( MQTTContext_t * pxMQTTContext );
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
+/**
+ * @brief Finds the topic alias to send instead of the given topic.
+ *
+ * If no alias has been assigned to the topic yet, a free alias is assigned if
+ * the broker accepts one more. The topic must then be sent along with the
+ * alias once, after which the alias is sent alone.
+ *
+ * @param[in] pxMQTTContext The MQTT context.
+ * @param[in] pucTopic The topic of the publish message.
  * @param[in] usTopicLength The length of the topic.
+ * @param[out] pxNewAlias Set to eMQTTTrue if the alias has just been assigned.
+ *
+ * @return The alias, or 0 if the topic must be sent without alias.
  */
-#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+#if ( mqttconfigENABLE_MQTT5 == 1 )
 
-    static void prvRemoveSubscription( MQTTContext_t * pxMQTTContext,
-                                       const uint8_t * const pucTopic,
-                                       uint16_t usTopicLength );
+    static uint16_t prvGetTxTopicAlias( MQTTContext_t * pxMQTTContext,
+                                        const uint8_t * const pucTopic,
+                                        uint16_t usTopicLength,
+                                        MQTTBool_t * pxNewAlias );
 
-#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+#endif /* mqttconfigENABLE_MQTT5 */
 
 /**
- * @brief Removes the subscription entry from the subscription manager corresponding
- * to the topic contained in the provided MQTT subscribe or unsubscribe message.
+ * @brief Resolves the topic alias of a received publish message.
  *
- * The provided buffer must contain a valid MQTT subscribe or unsubscribe message.
- * It extracts the topic from the MQTT message and removes the corresponding entry
- * in the subscription manager by calling prvRemoveSubscription.
+ * If the message carries the topic, the alias is (re)assigned to it.
+ * Otherwise, the topic is replaced with the one assigned to the alias before.
  *
- * @param[in] pxMQTTContext The MQTT context for which to remove the subscription.
- * @param[in] xBuffer The provided buffer containing a valid MQTT subscribe or
- * unsubscribe message.
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ * @param[in] usTopicAlias The received topic alias, or 0 if there is none.
+ * @param[in,out] ppucTopic The received topic, replaced if it was empty.
+ * @param[in,out] pusTopicLength The length of the topic.
+ *
+ * @return eMQTTFalse if the alias is not valid or the topic cannot be
+ * resolved, eMQTTTrue otherwise.
  */
-#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+#if ( mqttconfigENABLE_MQTT5 == 1 )
 
-    static void prvRemoveSubscriptionForSubscribeOrUnsubscribeBuffer( MQTTContext_t * pxMQTTContext,
-                                                                      MQTTBufferHandle_t xBuffer );
+    static MQTTBool_t prvResolveRxTopicAlias( MQTTContext_t * pxMQTTContext,
+                                              uint16_t usTopicAlias,
+                                              const uint8_t ** ppucTopic,
+                                              uint16_t * pusTopicLength );
 
-#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+#endif /* mqttconfigENABLE_MQTT5 */
 
 /**
- * @brief Invokes the subscription callbacks for the topic on which the provided
- * publish message is received.
+ * @brief Processes a DISCONNECT message received from the broker.
  *
- * It stops as soon as the user takes the ownership of the MQTT buffer by
- * returning eMQTTTrue from the callback. It follows the following sequence
- * for invoking callbacks:
- * - First it tries to find an exact match with the entries containing topic
- *   filters without wild-cards.
- * - Then it tries to find entries containing topic filters with wild-cards
- *   which match the topic on which the publish message is received.
+ * MQTT 5 brokers send a DISCONNECT before closing the connection. The client
+ * is disconnected and the user is informed.
  *
- * @param[in] pxMQTTContext The MQTT context for which to invoke the subscription callbacks.
- * @param[in] pxPublishData The publish data containing the topic and the received message.
- * @param[out] pxSubscriptionCallbackInvoked Set to eMQTTTrue if any callback was invoked,
- * otherwise set to eMQTTFalse.
+ * @param[in] pxMQTTContext The MQTT context for which the message was received.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static void prvProcessReceivedDISCONNECT( MQTTContext_t * pxMQTTContext );
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
+/**
+ * @brief Converts the reason code of an MQTT 5 CONNACK to the closest MQTT
+ * 3.1.1 return code.
  *
- * @return eMQTTTrue if the user took the ownership of the MQTT buffer, eMQTTFalse otherwise.
+ * @param[in] ucReasonCode The reason code of the CONNACK.
+ *
+ * @return 0 if the connection is accepted, 1 to 5 if it is refused or 0xFF if
+ * the reason code is not valid in a CONNACK.
  */
-#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+#if ( mqttconfigENABLE_MQTT5 == 1 )
 
-    static MQTTBool_t prvInvokeSubscriptionCallbacks( MQTTContext_t * pxMQTTContext,
-                                                      const MQTTPublishData_t * pxPublishData,
-                                                      MQTTBool_t * pxSubscriptionCallbackInvoked );
+    static uint8_t prvConvertCONNACKReasonCode( uint8_t ucReasonCode );
 
-#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+#endif /* mqttconfigENABLE_MQTT5 */
 
 /**
- * @brief Infers the type of the given topic filter.
+ * @brief Completes a QoS2 publish message refused by the broker.
  *
- * It ensure that if the given topic filter contains wild-cards, then those
- * wild-cards are valid as per the rules documented by the MQTT protocol
- * spec. The rules it checks are:
- * - '+' must either be the first character or the preceding character
- *   must be '/'.
- * - '+' must either be the last character or the succeeding character
- *   must be '/'.
- * - '#' must either be the first character or the preceding character
- *   must be '/'.
- * - '#' must be the last character.
+ * An MQTT 5 broker refuses a QoS2 message with a failure reason code in the
+ * PUBREC, in which case no PUBREL is sent. The user is informed with a PUBCOMP
+ * event carrying the reason code of the PUBREC.
  *
- * @param[in] pucTopicFilter The given topic filter.
- * @param[in] usTopicFilterLength The length of the given topic filter.
+ * @param[in] pxMQTTContext The MQTT context for which the PUBREC was received.
+ * @param[in] xPublishTxBuffer The buffer holding the refused publish message.
+ * @param[in] usPacketIdentifier The packet identifier of the message.
+ * @param[in] ucReasonCode The reason code of the PUBREC.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static void prvCompleteRefusedPublish( MQTTContext_t * pxMQTTContext,
+                                           MQTTBufferHandle_t xPublishTxBuffer,
+                                           uint16_t usPacketIdentifier,
+                                           uint8_t ucReasonCode );
+
+#endif /* mqttconfigENABLE_MQTT5 */
+
+/**
+ * @brief Empties the subscription manager.
  *
- * @return eMQTTTopicFilterTypeSimple if the given topic filter is valid and
- * does not contain any wild-card, eMQTTTopicFilterTypeWildCard if the given
- * topic filter is valid and contains wild-cards, eMQTTTopicFilterTypeInvalid
- * otherwise.
+ * Puts all the nodes in the free list, empties the hash chains and the string
+ * pool, and forgets all the subscriptions.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager to empty.
  */
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
-    static MQTTTopicFilterType_t prvGetTopicFilterType( const uint8_t * const pucTopicFilter,
-                                                        uint16_t usTopicFilterLength );
+    static void prvInitSubscriptionManager( MQTTSubscriptionManager_t * pxSubscriptionManager );
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
 /**
- * @brief Checks whether the given topic matches the given topic
- * filter.
+ * @brief Calculates the hash of a named topic level.
  *
- * @warning It assumes that the given topic filter is valid i.e.
- * calling prvIsValidTopicFilter with the given topic will not
- * return eMQTTTopicFilterTypeInvalid.
- *
- * Some corner cases as documented by the MQTT protocol spec are:
- * - Filter of type "sport/#" also matches the singular "sport"
- *   since # includes the parent level.
- * - Filter of type "sport/+" also matches the "sport/" but not
- *   "sport".
+ * The hash covers both the parent node and the name of the level, so that
+ * the same name below different parents is spread over different hash
+ * chains.
  *
- * @param[in] pucTopic The given topic to match.
- * @param[in] usTopicLength The length of the given topic.
- * @param[in] pucTopicFilter The given topic filter with which to match
- * the given topic.
- * @param[in] usTopicFilterLength The length of the given topic filter.
+ * @param[in] usParent The node of the previous level.
+ * @param[in] pucLevel The name of the level.
+ * @param[in] usLevelLength The length of the name.
  *
- * @return eMQTTTrue if the topic matches the filter, eMQTTFalse otherwise.
+ * @return The 16-bit hash of the level.
  */
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
-    static MQTTBool_t prvDoesTopicMatchTopicFilter( const uint8_t * const pucTopic,
-                                                    uint16_t usTopicLength,
-                                                    const uint8_t * const pucTopicFilter,
-                                                    uint16_t usTopicFilterLength );
+    static uint16_t prvHashTopicLevel( uint16_t usParent,
+                                       const uint8_t * const pucLevel,
+                                       uint16_t usLevelLength );
 
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-/*-----------------------------------------------------------*/
 
-static MQTTBufferHandle_t prvGetFreeBuffer( MQTTContext_t * pxMQTTContext,
-                                            uint32_t ulBufferLength )
-{
-    MQTTBufferHandle_t xFreeBufferHandle = NULL;
+/**
+ * @brief Finds the end of the topic level starting at the given offset.
+ *
+ * @param[in] pucTopic The topic or topic filter.
+ * @param[in] usTopicLength The length of the topic or topic filter.
+ * @param[in] ulLevelStart The offset of the first character of the level.
+ *
+ * @return The offset of the '/' which ends the level, or usTopicLength if
+ * this is the last level.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint32_t prvGetTopicLevelEnd( const uint8_t * const pucTopic,
+                                         uint16_t usTopicLength,
+                                         uint32_t ulLevelStart );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Returns the link to the '+' or the '#' level below the given node.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usParent The node of the previous level, or mqttSUBSCRIPTION_NO_NODE
+ * for the first level.
+ * @param[in] ucWildCard Either '+' or '#'.
+ *
+ * @return The link, which contains mqttSUBSCRIPTION_NO_NODE if there is no
+ * such level.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t * prvGetWildCardLink( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                          uint16_t usParent,
+                                          uint8_t ucWildCard );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Finds the named level below the given node.
+ *
+ * Wild-card characters in the level name have no special meaning, which makes
+ * this function suitable to look up the levels of the topic of a received
+ * publish message.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usParent The node of the previous level, or mqttSUBSCRIPTION_NO_NODE
+ * for the first level.
+ * @param[in] pucLevel The name of the level.
+ * @param[in] usLevelLength The length of the name.
+ *
+ * @return The node of the level, or mqttSUBSCRIPTION_NO_NODE if not found.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvFindNamedTopicNode( const MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                           uint16_t usParent,
+                                           const uint8_t * const pucLevel,
+                                           uint16_t usLevelLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Finds the level of a topic filter below the given node.
+ *
+ * Unlike prvFindNamedTopicNode, a level consisting of a single '+' or '#'
+ * character is looked up as a wild-card.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usParent The node of the previous level, or mqttSUBSCRIPTION_NO_NODE
+ * for the first level.
+ * @param[in] pucLevel The level of the topic filter.
+ * @param[in] usLevelLength The length of the level.
+ *
+ * @return The node of the level, or mqttSUBSCRIPTION_NO_NODE if not found.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvFindTopicNode( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                      uint16_t usParent,
+                                      const uint8_t * const pucLevel,
+                                      uint16_t usLevelLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Adds a level of a topic filter below the given node.
+ *
+ * Takes a node from the free list and links it to its parent. The name of a
+ * named level is shared with the other levels which have the same name.
+ * The new node has no references, so it is returned to the free list by
+ * prvPruneTopicNodes unless a subscription or another level is added below it.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usParent The node of the previous level, or mqttSUBSCRIPTION_NO_NODE
+ * for the first level.
+ * @param[in] pucLevel The level of the topic filter.
+ * @param[in] usLevelLength The length of the level.
+ *
+ * @return The new node, or mqttSUBSCRIPTION_NO_NODE if there is no free node or
+ * no space left in the string pool.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvAddTopicNode( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                     uint16_t usParent,
+                                     const uint8_t * const pucLevel,
+                                     uint16_t usLevelLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Returns the given node and the levels above it to the free list, for
+ * as long as they are not referenced by a subscription or another level.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usNode The node to start from.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvPruneTopicNodes( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                    uint16_t usNode );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Stores a level name in the string pool, or takes an additional
+ * reference to it if it is stored already.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] pucLevel The name of the level.
+ * @param[in] usLevelLength The length of the name.
+ *
+ * @return The index of the level name, or mqttSUBSCRIPTION_NO_LEVEL_NAME if
+ * there is no space left in the string pool.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvInternLevelName( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                        const uint8_t * const pucLevel,
+                                        uint16_t usLevelLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Drops a reference to a level name.
+ *
+ * When the last reference is dropped, the name is removed from the string
+ * pool and the names stored after it are moved down, so that the free space
+ * of the string pool is always at its end.
+ *
+ * @param[in] pxSubscriptionManager The subscription manager.
+ * @param[in] usLevelName The index of the level name.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvReleaseLevelName( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                     uint16_t usLevelName );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Invokes the callback of the subscription stored in the given node, if
+ * any.
+ *
+ * @param[in] pxNode The node.
+ * @param[in] pxPublishData The publish data containing the topic and the received message.
+ * @param[out] pxSubscriptionCallbackInvoked Set to eMQTTTrue if the callback was invoked,
+ * otherwise left unchanged.
+ *
+ * @return eMQTTTrue if the user took the ownership of the MQTT buffer, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTBool_t prvInvokeSubscription( const MQTTTopicNode_t * pxNode,
+                                             const MQTTPublishData_t * pxPublishData,
+                                             MQTTBool_t * pxSubscriptionCallbackInvoked );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Store the subscription in the subscription manager.
+ *
+ * Walks down the topic trie one level of the topic filter at a time, adding
+ * the levels which are not present yet, and stores the subscription in the
+ * node of the last level. A subscription which is already stored for the same
+ * topic filter is replaced.
+ *
+ * This function can fail to store the subscription if the nodes or the string
+ * pool of the subscription manager are exhausted or the topic name is longer
+ * than the maximum length as specified by the
+ * mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH macro or if the topic
+ * represents an invalid topic filter. eMQTTFalse is returned to indicate the
+ * failure, and the levels added for this topic filter are removed again.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which to store the subscription.
+ * @param[in] pucTopic The topic this subscription entry is for.
+ * @param[in] usTopicLength The length of the topic.
+ * @param[in] pvPublishCallbackContext The user supplied callback context.
+ * @param[in] pxPublishCallback The callback to invoke whenever a publish message
+ * is received on this topic.
+ *
+ * @return eMQTTTrue if subscription is stored successfully, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTBool_t prvStoreSubscription( MQTTContext_t * pxMQTTContext,
+                                            const uint8_t * const pucTopic,
+                                            uint16_t usTopicLength,
+                                            void * pvPublishCallbackContext,
+                                            MQTTPublishCallback_t pxPublishCallback );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Removes the subscription entry from the subscription manager corresponding
+ * to the provided topic.
+ *
+ * Follows the levels of the topic filter through the topic trie. If a
+ * subscription is stored in the node of the last level, removes it and
+ * returns the levels which are no longer used to the free list.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which to remove the subscription.
+ * @param[in] pucTopic The topic for which the subscription entry is to be removed.
+ * @param[in] usTopicLength The length of the topic.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvRemoveSubscription( MQTTContext_t * pxMQTTContext,
+                                       const uint8_t * const pucTopic,
+                                       uint16_t usTopicLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Removes the subscription entry from the subscription manager corresponding
+ * to the topic contained in the provided MQTT subscribe or unsubscribe message.
+ *
+ * The provided buffer must contain a valid MQTT subscribe or unsubscribe message.
+ * It extracts the topic from the MQTT message and removes the corresponding entry
+ * in the subscription manager by calling prvRemoveSubscription.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which to remove the subscription.
+ * @param[in] xBuffer The provided buffer containing a valid MQTT subscribe or
+ * unsubscribe message.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvRemoveSubscriptionForSubscribeOrUnsubscribeBuffer( MQTTContext_t * pxMQTTContext,
+                                                                      MQTTBufferHandle_t xBuffer );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Invokes the subscription callbacks for the topic on which the provided
+ * publish message is received.
+ *
+ * It stops as soon as the user takes the ownership of the MQTT buffer by
+ * returning eMQTTTrue from the callback. It follows the following sequence
+ * for invoking callbacks:
+ * - First it follows the levels of the topic through the named levels of the
+ *   topic trie to find an exact match with a topic filter without wild-cards.
+ * - Then it visits, depth first, all the paths through the topic trie which
+ *   match the levels of the topic, and invokes the callbacks of the topic
+ *   filters with wild-cards found on the way.
+ *
+ * The work done therefore depends on the number of levels of the topic and on
+ * the number of matching wild-card levels, not on the number of subscriptions.
+ * The callbacks must not change the subscriptions of the MQTT context.
+ *
+ * @param[in] pxMQTTContext The MQTT context for which to invoke the subscription callbacks.
+ * @param[in] pxPublishData The publish data containing the topic and the received message.
+ * @param[out] pxSubscriptionCallbackInvoked Set to eMQTTTrue if any callback was invoked,
+ * otherwise set to eMQTTFalse.
+ *
+ * @return eMQTTTrue if the user took the ownership of the MQTT buffer, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTBool_t prvInvokeSubscriptionCallbacks( MQTTContext_t * pxMQTTContext,
+                                                      const MQTTPublishData_t * pxPublishData,
+                                                      MQTTBool_t * pxSubscriptionCallbackInvoked );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Infers the type of the given topic filter.
+ *
+ * It ensure that if the given topic filter contains wild-cards, then those
+ * wild-cards are valid as per the rules documented by the MQTT protocol
+ * spec. The rules it checks are:
+ * - '+' must either be the first character or the preceding character
+ *   must be '/'.
+ * - '+' must either be the last character or the succeeding character
+ *   must be '/'.
+ * - '#' must either be the first character or the preceding character
+ *   must be '/'.
+ * - '#' must be the last character.
+ *
+ * @param[in] pucTopicFilter The given topic filter.
+ * @param[in] usTopicFilterLength The length of the given topic filter.
+ *
+ * @return eMQTTTopicFilterTypeSimple if the given topic filter is valid and
+ * does not contain any wild-card, eMQTTTopicFilterTypeWildCard if the given
+ * topic filter is valid and contains wild-cards, eMQTTTopicFilterTypeInvalid
+ * otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTTopicFilterType_t prvGetTopicFilterType( const uint8_t * const pucTopicFilter,
+                                                        uint16_t usTopicFilterLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+/**
+ * @brief Checks whether the given topic matches the given topic
+ * filter.
+ *
+ * @warning It assumes that the given topic filter is valid i.e.
+ * calling prvIsValidTopicFilter with the given topic will not
+ * return eMQTTTopicFilterTypeInvalid.
+ *
+ * Some corner cases as documented by the MQTT protocol spec are:
+ * - Filter of type "sport/#" also matches the singular "sport"
+ *   since # includes the parent level.
+ * - Filter of type "sport/+" also matches the "sport/" but not
+ *   "sport".
+ *
+ * @param[in] pucTopic The given topic to match.
+ * @param[in] usTopicLength The length of the given topic.
+ * @param[in] pucTopicFilter The given topic filter with which to match
+ * the given topic.
+ * @param[in] usTopicFilterLength The length of the given topic filter.
+ *
+ * @return eMQTTTrue if the topic matches the filter, eMQTTFalse otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTBool_t prvDoesTopicMatchTopicFilter( const uint8_t * const pucTopic,
+                                                    uint16_t usTopicLength,
+                                                    const uint8_t * const pucTopicFilter,
+                                                    uint16_t usTopicFilterLength );
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+static MQTTBufferHandle_t prvGetFreeBuffer( MQTTContext_t * pxMQTTContext,
+                                            uint32_t ulBufferLength )
+{
+    MQTTBufferHandle_t xFreeBufferHandle = NULL;
     uint32_t ulRequestedBufferLength = 0;
     uint8_t * pucFreeBuffer;
 
@@ -862,6 +1538,13 @@ static MQTTBufferHandle_t prvGetFreeBuffer( MQTTContext_t * pxMQTTContext,
         /* Get the handle to return. */
         xFreeBufferHandle = mqttbufferGET_HANDLE_FROM_RAW_BUFFER( pucFreeBuffer ); /*lint !e9087 Opaque pointer. */
 
+        #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+            /* The buffer does not reference any user memory until
+             * MQTT_PublishZeroCopy says so. */
+            mqttbufferGET_PUBLISH_DATA( xFreeBufferHandle ) = NULL;
+        #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
         /* Ensure that the actual space in the buffer to store
          * data is at least what the user requested. */
         mqttconfigASSERT( mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( xFreeBufferHandle ) >= ulBufferLength );
@@ -998,6 +1681,10 @@ static void prvResetRxMessageState( MQTTContext_t * pxMQTTContext )
     pxMQTTContext->xRxMessageState.xRxNextByte = eMQTTRxNextBytePacketType;
     pxMQTTContext->ulRxMessageReceivedLength = 0;
     pxMQTTContext->xRxBuffer = NULL;
+
+    #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+        pxMQTTContext->xRxMessageState.xStreamData.pucTopic = NULL;
+    #endif /* mqttconfigENABLE_STREAMING_RECEIVE */
 }
 /*-----------------------------------------------------------*/
 
@@ -1006,10 +1693,6 @@ static void prvResetMQTTContext( MQTTContext_t * pxMQTTContext )
     Link_t * pxLink, * pxTempLink;
     MQTTBufferHandle_t xBufferHandle;
 
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-        uint32_t x;
-    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-
     /* Set connection state to not connected. */
     pxMQTTContext->xConnectionState = eMQTTNotConnected;
 
@@ -1028,15 +1711,9 @@ static void prvResetMQTTContext( MQTTContext_t * pxMQTTContext )
 
     #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
 
-        /* Mark all the subscription entires in the subscription
-         * manager as free. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
-        {
-            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
-        }
-
-        /* Set the number of in-use subscription entries to zero. */
-        pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions = 0;
+        /* Remove all the subscriptions from the subscription
+         * manager. */
+        prvInitSubscriptionManager( &( pxMQTTContext->xSubscriptionManager ) );
     #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 }
 /*-----------------------------------------------------------*/
@@ -1121,20 +1798,79 @@ static MQTTReturnCode_t prvSendData( MQTTContext_t * pxMQTTContext,
 }
 /*-----------------------------------------------------------*/
 
-static void prvProcessReceivedFixedHeaderOnlyMQTTPacket( MQTTContext_t * pxMQTTContext )
-{
-    MQTTEventCallbackParams_t xEventCallbackParams;
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
 
-    /* Is this a PINGRESP? */
-    if( pxMQTTContext->ucRxFixedHeaderBuffer[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_PINGRESP | mqttFLAGS_PINGRESP ) )
-    {
-        prvProcessReceivedPINGRESP( pxMQTTContext );
-    }
-    /* Any other fixed header only packet is considered a malformed packet. */
-    else
+    static MQTTReturnCode_t prvSendDataVectored( MQTTContext_t * pxMQTTContext,
+                                                 const uint8_t * const pucHeader,
+                                                 uint32_t ulHeaderLength,
+                                                 const uint8_t * const pucPayload,
+                                                 uint32_t ulPayloadLength )
     {
-        /* A malformed packet has been received - disconnect. */
-        prvResetMQTTContext( pxMQTTContext );
+        MQTTReturnCode_t xReturnCode = eMQTTSendFailed;
+        MQTTSendVector_t xVectors[ 2 ];
+        uint32_t ulBytesSent;
+
+        if( pxMQTTContext->pxMQTTSendVectoredFxn != NULL )
+        {
+            xVectors[ 0 ].pucData = pucHeader;
+            xVectors[ 0 ].ulDataLength = ulHeaderLength;
+            xVectors[ 1 ].pucData = pucPayload;
+            xVectors[ 1 ].ulDataLength = ulPayloadLength;
+
+            ulBytesSent = pxMQTTContext->pxMQTTSendVectoredFxn( pxMQTTContext->pvSendContext, xVectors, ( uint32_t ) 2 );
+        }
+        else
+        {
+            ulBytesSent = pxMQTTContext->pxMQTTSendFxn( pxMQTTContext->pvSendContext, pucHeader, ulHeaderLength );
+
+            /* Do not send the payload if the header was not sent
+             * completely, as the broker would not be able to make
+             * sense of it. */
+            if( ( ulBytesSent == ulHeaderLength ) && ( ulPayloadLength > ( uint32_t ) 0 ) )
+            {
+                ulBytesSent += pxMQTTContext->pxMQTTSendFxn( pxMQTTContext->pvSendContext, pucPayload, ulPayloadLength );
+            }
+        }
+
+        if( ulBytesSent == ( ulHeaderLength + ulPayloadLength ) )
+        {
+            xReturnCode = eMQTTSuccess;
+
+            /* Sending any message delays when the next keep
+             * alive should be sent. */
+            pxMQTTContext->xLastSentMessageTimestamp = prvGetCurrentTickCount( pxMQTTContext );
+            pxMQTTContext->ulNextPeriodicInvokeTicks = pxMQTTContext->ulKeepAliveActualIntervalTicks;
+        }
+
+        return xReturnCode;
+    }
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+/*-----------------------------------------------------------*/
+
+static void prvProcessReceivedFixedHeaderOnlyMQTTPacket( MQTTContext_t * pxMQTTContext )
+{
+    MQTTEventCallbackParams_t xEventCallbackParams;
+
+    /* Is this a PINGRESP? */
+    if( pxMQTTContext->ucRxFixedHeaderBuffer[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_PINGRESP | mqttFLAGS_PINGRESP ) )
+    {
+        prvProcessReceivedPINGRESP( pxMQTTContext );
+    }
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        /* Is this a DISCONNECT without reason code? */
+        else if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) &&
+                 ( pxMQTTContext->ucRxFixedHeaderBuffer[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_DISCONNECT | mqttFLAGS_DISCONNECT ) ) )
+        {
+            prvProcessReceivedDISCONNECT( pxMQTTContext );
+        }
+    #endif /* mqttconfigENABLE_MQTT5 */
+    /* Any other fixed header only packet is considered a malformed packet. */
+    else
+    {
+        /* A malformed packet has been received - disconnect. */
+        prvResetMQTTContext( pxMQTTContext );
 
         /* Inform the user about the malformed packet. */
         xEventCallbackParams.xEventType = eMQTTClientDisconnected;
@@ -1163,6 +1899,21 @@ static void prvProcessReceivedMQTTPacket( MQTTContext_t * pxMQTTContext )
     {
         prvProcessReceivedPUBACK( pxMQTTContext );
     }
+    /* Is this a PUBREC? */
+    else if( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_PUBREC | mqttFLAGS_PUBREC ) )
+    {
+        prvProcessReceivedPUBREC( pxMQTTContext );
+    }
+    /* Is this a PUBREL? */
+    else if( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL ) )
+    {
+        prvProcessReceivedPUBREL( pxMQTTContext );
+    }
+    /* Is this a PUBCOMP? */
+    else if( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_PUBCOMP | mqttFLAGS_PUBCOMP ) )
+    {
+        prvProcessReceivedPUBCOMP( pxMQTTContext );
+    }
     /* Is this a SUBACK? */
     else if( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_SUBACK | mqttFLAGS_SUBACK ) )
     {
@@ -1173,6 +1924,15 @@ static void prvProcessReceivedMQTTPacket( MQTTContext_t * pxMQTTContext )
     {
         prvProcessReceivedUNSUBACK( pxMQTTContext );
     }
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        /* Is this a DISCONNECT? */
+        else if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) &&
+                 ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ( uint8_t ) ( mqttCONTROL_DISCONNECT | mqttFLAGS_DISCONNECT ) ) )
+        {
+            prvProcessReceivedDISCONNECT( pxMQTTContext );
+        }
+    #endif /* mqttconfigENABLE_MQTT5 */
     /* Any other packet is considered malformed. */
     else
     {
@@ -1192,7 +1952,9 @@ static void prvProcessReceivedCONNACK( MQTTContext_t * pxMQTTContext )
     MQTTBufferHandle_t xConnectTxBuffer;
     MQTTEventCallbackParams_t xEventCallbackParams;
     MQTTBool_t xConnectionEstablished = eMQTTFalse, xConnectionRefused = eMQTTFalse, xMalformedPacket = eMQTTFalse;
-    uint8_t ucReturnCode;
+    MQTTBool_t xSessionPresent = eMQTTFalse, xWellFormed = eMQTTFalse;
+    const uint8_t * pucPacket = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer );
+    uint8_t ucFlags = 0, ucReturnCode = 0, ucReasonCode = 0;
     static const uint8_t ucDefaultCONNACKParameters[] =
     {
         mqttCONTROL_CONNACK | mqttFLAGS_CONNACK, /* Fixed header control packet type. */
@@ -1201,6 +1963,12 @@ static void prvProcessReceivedCONNACK( MQTTContext_t * pxMQTTContext )
         0,                                       /* Return code. */
     };
 
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucRemainingLengthFieldBytes = pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes;
+        MQTTProperties_t xProperties;
+        uint32_t ulOffset, ulLength;
+    #endif /* mqttconfigENABLE_MQTT5 */
+
     /* Is there a connect message waiting for CONNACK? */
     xConnectTxBuffer = prvPacketTypeFlagsGetTxBuffer( pxMQTTContext, mqttCONTROL_CONNECT, mqttFLAGS_CONNECT );
 
@@ -1216,86 +1984,129 @@ static void prvProcessReceivedCONNACK( MQTTContext_t * pxMQTTContext )
     }
     else
     {
-        if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= sizeof( ucDefaultCONNACKParameters ) )
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                /* The return code is followed by properties, so the
+                 * Remaining Length is not fixed. */
+                ulLength = mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer );
+                ulOffset = mqttADJUST_OFFSET( mqttCONNACK_PROPERTIES_OFFSET, ucRemainingLengthFieldBytes );
+
+                if( ( pucPacket[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ucDefaultCONNACKParameters[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] ) &&
+                    ( ulLength > ulOffset ) &&
+                    ( prvDecodeProperties( &( pucPacket[ ulOffset ] ), ulLength - ulOffset, &xProperties ) == ( ulLength - ulOffset ) ) )
+                {
+                    ucFlags = pucPacket[ mqttADJUST_OFFSET( mqttCONNACK_SESSION_PRESENT_OFFSET, ucRemainingLengthFieldBytes ) ];
+                    ucReasonCode = pucPacket[ mqttADJUST_OFFSET( mqttCONNACK_RETURN_CODE_OFFSET, ucRemainingLengthFieldBytes ) ];
+                    ucReturnCode = prvConvertCONNACKReasonCode( ucReasonCode );
+                    xWellFormed = eMQTTTrue;
+                }
+            }
+            else
+        #endif /* mqttconfigENABLE_MQTT5 */
         {
             /* Received enough data for a CONNACK - does the received fixed header match
              * the expected one for the CONNACK message (Fixed header is of 2 bytes for CONNACK
              * message because Remaining Length is 2 which takes only one byte)? */
-            if( memcmp( ucDefaultCONNACKParameters, mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), mqttFIXED_HEADER_MIN_SIZE ) == 0 )
+            if( ( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= sizeof( ucDefaultCONNACKParameters ) ) &&
+                ( memcmp( ucDefaultCONNACKParameters, pucPacket, mqttFIXED_HEADER_MIN_SIZE ) == 0 ) )
             {
-                mqttconfigDEBUG_LOG( ( "CONNACK received.\r\n" ) );
+                ucFlags = pucPacket[ mqttCONNACK_SESSION_PRESENT_OFFSET ];
+                ucReturnCode = pucPacket[ mqttCONNACK_RETURN_CODE_OFFSET ];
+                ucReasonCode = ucReturnCode;
+                xWellFormed = eMQTTTrue;
+            }
+        }
 
-                xEventCallbackParams.xEventType = eMQTTConnACK;
+        if( xWellFormed == eMQTTTrue )
+        {
+            mqttconfigDEBUG_LOG( ( "CONNACK received.\r\n" ) );
 
-                /* Since AWS IoT only supports CleanSession 1, SP bit will
-                 * always be zero. */
-                ucReturnCode = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttCONNACK_RETURN_CODE_OFFSET ];
+            xEventCallbackParams.xEventType = eMQTTConnACK;
 
-                if( ucReturnCode == ( uint8_t ) 0 ) /* Connection Accepted. */
-                {
-                    /* Server has accepted the connection and we are now in
-                     * connected state. */
-                    xEventCallbackParams.xEventType = eMQTTConnACK;
-                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKConnectionAccepted;
-                    xEventCallbackParams.u.xMQTTConnACKData.usPacketIdentifier = mqttbufferGET_PACKET_IDENTIFIER( xConnectTxBuffer );
-                    ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+            /* The SP bit is only set if a persistent session was
+             * requested and the broker has kept it. */
+            xSessionPresent = ( ( ucFlags & ( uint8_t ) 0x01 ) != ( uint8_t ) 0 ) ? eMQTTTrue : eMQTTFalse;
+            xEventCallbackParams.u.xMQTTConnACKData.xSessionPresent = xSessionPresent;
 
-                    /* Connection is established. */
-                    xConnectionEstablished = eMQTTTrue;
-                }
-                else if( ( ucReturnCode >= ( uint8_t ) 1 ) && ( ucReturnCode <= ( uint8_t ) 5 ) )
-                {
-                    /* Server refused to accept the connection. */
-                    xEventCallbackParams.xEventType = eMQTTConnACK;
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                xEventCallbackParams.u.xMQTTConnACKData.ucReasonCode = ucReasonCode;
+            #else
+                ( void ) ucReasonCode;
+            #endif /* mqttconfigENABLE_MQTT5 */
 
-                    /* Convert the return code to a user friendly enum value. */
-                    if( ucReturnCode == ( uint8_t ) 1 )
-                    {
-                        xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKUnacceptableProtocolVersion;
-                    }
-                    else if( ucReturnCode == ( uint8_t ) 2 )
-                    {
-                        xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKIdentifierRejected;
-                    }
-                    else if( ucReturnCode == ( uint8_t ) 3 )
-                    {
-                        xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKServerUnavailable;
-                    }
-                    else if( ucReturnCode == ( uint8_t ) 4 )
-                    {
-                        xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKBadUsernameOrPassword;
-                    }
-                    else
+            if( ucReturnCode == ( uint8_t ) 0 ) /* Connection Accepted. */
+            {
+                #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                    /* Remember the limits of the broker for this
+                     * connection. The topic aliases of a previous
+                     * connection are not valid anymore. */
+                    if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
                     {
-                        xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKUnauthorized;
+                        pxMQTTContext->usServerReceiveMaximum = xProperties.usReceiveMaximum;
+                        pxMQTTContext->usServerTopicAliasMaximum = xProperties.usTopicAliasMaximum;
+                        memset( pxMQTTContext->xTxTopicAliases, 0x00, sizeof( pxMQTTContext->xTxTopicAliases ) );
+                        memset( pxMQTTContext->xRxTopicAliases, 0x00, sizeof( pxMQTTContext->xRxTopicAliases ) );
                     }
+                #endif /* mqttconfigENABLE_MQTT5 */
 
-                    xEventCallbackParams.u.xMQTTConnACKData.usPacketIdentifier = mqttbufferGET_PACKET_IDENTIFIER( xConnectTxBuffer );
-                    ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                /* Server has accepted the connection and we are now in
+                 * connected state. */
+                xEventCallbackParams.xEventType = eMQTTConnACK;
+                xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKConnectionAccepted;
+                xEventCallbackParams.u.xMQTTConnACKData.usPacketIdentifier = mqttbufferGET_PACKET_IDENTIFIER( xConnectTxBuffer );
+                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+
+                /* Connection is established. */
+                xConnectionEstablished = eMQTTTrue;
+            }
+            else if( ( ucReturnCode >= ( uint8_t ) 1 ) && ( ucReturnCode <= ( uint8_t ) 5 ) )
+            {
+                /* Server refused to accept the connection. */
+                xEventCallbackParams.xEventType = eMQTTConnACK;
 
-                    xConnectionRefused = eMQTTTrue;
+                /* Convert the return code to a user friendly enum value. */
+                if( ucReturnCode == ( uint8_t ) 1 )
+                {
+                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKUnacceptableProtocolVersion;
+                }
+                else if( ucReturnCode == ( uint8_t ) 2 )
+                {
+                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKIdentifierRejected;
+                }
+                else if( ucReturnCode == ( uint8_t ) 3 )
+                {
+                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKServerUnavailable;
+                }
+                else if( ucReturnCode == ( uint8_t ) 4 )
+                {
+                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKBadUsernameOrPassword;
                 }
                 else
                 {
-                    /* Malformed packet - Reserved return code. */
-                    xMalformedPacket = eMQTTTrue;
+                    xEventCallbackParams.u.xMQTTConnACKData.xConnACKReturnCode = eMQTTConnACKUnauthorized;
                 }
+
+                xEventCallbackParams.u.xMQTTConnACKData.usPacketIdentifier = mqttbufferGET_PACKET_IDENTIFIER( xConnectTxBuffer );
+                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+
+                xConnectionRefused = eMQTTTrue;
             }
             else
             {
-                mqttconfigDEBUG_LOG( ( "Unknown messages %x %x %x %x, expected CONNACK, disconnecting socket.\r\n",
-                                       mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ 0 ],
-                                       mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ 1 ],
-                                       mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ 2 ],
-                                       mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ 3 ] ) );
-
-                /* Malformed packet - Fixed header does not match. */
+                /* Malformed packet - Reserved return code. */
                 xMalformedPacket = eMQTTTrue;
             }
         }
         else
         {
-            /* Malformed packet - Not enough bytes. */
+            mqttconfigDEBUG_LOG( ( "Unknown messages %x %x, expected CONNACK, disconnecting socket.\r\n",
+                                   pucPacket[ 0 ],
+                                   pucPacket[ 1 ] ) );
+
+            /* Malformed packet - Fixed header does not match or not
+             * enough bytes. */
             xMalformedPacket = eMQTTTrue;
         }
 
@@ -1336,6 +2147,21 @@ static void prvProcessReceivedCONNACK( MQTTContext_t * pxMQTTContext )
 
         /* No ping has been sent yet. */
         pxMQTTContext->xWaitingForPingResp = eMQTTFalse;
+
+        /* If the broker has not kept the session, it will not
+         * re-transmit or release the QoS2 publish messages received
+         * before, so there is no need to remember them. */
+        if( xSessionPresent == eMQTTFalse )
+        {
+            memset( pxMQTTContext->usQoS2ReceivedPacketIdentifiers, 0x00, sizeof( pxMQTTContext->usQoS2ReceivedPacketIdentifiers ) );
+        }
+
+        #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+            /* Re-transmit the messages which were not acknowledged
+             * on the previous connections. */
+            prvResendInflightMessages( pxMQTTContext );
+        #endif /* mqttconfigENABLE_INFLIGHT_STORE */
     }
 
     /* Return the RxBuffer to the free buffer pool. */
@@ -1350,10 +2176,31 @@ static void prvProcessReceivedSUBACK( MQTTContext_t * pxMQTTContext )
     MQTTBool_t xMalformedPacket = eMQTTFalse;
     uint8_t ucReturnCode;
     uint16_t usPacketIdentifier;
+    uint32_t ulReturnCodeOffset;
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProperties_t xProperties;
+        uint32_t ulPropertiesLength;
+    #endif /* mqttconfigENABLE_MQTT5 */
+
+    ulReturnCodeOffset = mqttADJUST_OFFSET( mqttSUBACK_RETURN_CODE_OFFSET, pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes );
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+        /* The properties come before the return code. Malformed
+         * properties leave no room for the return code. */
+        if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) &&
+            ( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) > ulReturnCodeOffset ) )
+        {
+            ulPropertiesLength = prvDecodeProperties( &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulReturnCodeOffset ] ),
+                                                      mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) - ulReturnCodeOffset,
+                                                      &xProperties );
+            ulReturnCodeOffset = ( ulPropertiesLength > ( uint32_t ) 0 ) ? ( ulReturnCodeOffset + ulPropertiesLength ) : mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer );
+        }
+    #endif /* mqttconfigENABLE_MQTT5 */
 
     /* Must have enough bytes to at least read out one return code. */
-    if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) > ( uint32_t ) mqttADJUST_OFFSET( mqttSUBACK_RETURN_CODE_OFFSET,
-                                                                                                pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) )
+    if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) > ulReturnCodeOffset )
     {
         /* Extract the packet identifier and see if there is a subscribe
          * packet waiting for ACK. */
@@ -1376,11 +2223,21 @@ static void prvProcessReceivedSUBACK( MQTTContext_t * pxMQTTContext )
         else
         {
             /* Extract the return code from the packet. */
-            ucReturnCode = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttSUBACK_RETURN_CODE_OFFSET,
-                                                                                              pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ];
+            ucReturnCode = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulReturnCodeOffset ];
 
-            /* Return code must be valid. Note that QoS2 is not supported. */
-            if( ( ucReturnCode <= ( uint8_t ) 1 ) || ( ucReturnCode == ( uint8_t ) 128 ) )
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                /* MQTT 5 tells why a subscription failed. */
+                xEventCallbackParams.u.xMQTTSubACKData.ucReasonCode = ucReturnCode;
+
+                if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) && ( ucReturnCode >= mqttREASON_CODE_FAILURE ) )
+                {
+                    ucReturnCode = 128;
+                }
+            #endif /* mqttconfigENABLE_MQTT5 */
+
+            /* Return code must be valid. */
+            if( ( ucReturnCode <= ( uint8_t ) 2 ) || ( ucReturnCode == ( uint8_t ) 128 ) )
             {
                 /* Inform the user about the received SUBACK. */
                 xEventCallbackParams.xEventType = eMQTTSubACK;
@@ -1394,6 +2251,10 @@ static void prvProcessReceivedSUBACK( MQTTContext_t * pxMQTTContext )
                 {
                     xEventCallbackParams.u.xMQTTSubACKData.xSubACKReturnCode = eMQTTSubACKSuccessQos1;
                 }
+                else if( ucReturnCode == ( uint8_t ) 2 )
+                {
+                    xEventCallbackParams.u.xMQTTSubACKData.xSubACKReturnCode = eMQTTSubACKSuccessQos2;
+                }
                 else
                 {
                     xEventCallbackParams.u.xMQTTSubACKData.xSubACKReturnCode = eMQTTSubACKFailure;
@@ -1451,69 +2312,105 @@ static void prvProcessReceivedUNSUBACK( MQTTContext_t * pxMQTTContext )
 {
     MQTTBufferHandle_t xUnsubscribeTxBuffer;
     MQTTEventCallbackParams_t xEventCallbackParams;
-    MQTTBool_t xMalformedPacket = eMQTTFalse;
+    MQTTBool_t xMalformedPacket = eMQTTFalse, xWellFormed = eMQTTFalse;
     uint16_t usPacketIdentifier;
+    uint8_t ucReasonCode = 0;
     static const uint8_t ucUNSUBACKFixedHeader[] =
     {
         mqttCONTROL_UNSUBACK | mqttFLAGS_UNSUBACK, /* Fixed header control packet type. */
         2,                                         /* Fixed header remaining length - always 2 for UNSUBACK. */
     };
 
-    /* Must have enough bytes to form a complete UNSUBACK packet
-     * which contains 2 byte packet identifier other than the fixed
-     * header. */
-    if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= ( sizeof( ucUNSUBACKFixedHeader ) + ( uint32_t ) mqttUNSUBACK_PACKET_IDENTIFER_LENGTH ) )
-    {
-        /* Received enough data for an UNSUBACK - does the received fixed header match
-         * the expected one for the UNSUBACK message (Fixed header is of 2 bytes for UNSUBACK
-         * message because Remaining Length is 2 which takes only one byte)? */
-        if( memcmp( ucUNSUBACKFixedHeader, mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), sizeof( ucUNSUBACKFixedHeader ) ) == 0 )
-        {
-            /* Extract the packet identifier and see if there is an unsubscribe
-             * packet waiting for ACK. */
-            usPacketIdentifier = ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttUNSUBACK_PACKET_ID_MSB_OFFSET,
-                                                                                                                  pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
-            usPacketIdentifier <<= mqttBITS_PER_BYTE;
-            usPacketIdentifier |= ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttUNSUBACK_PACKET_ID_LSB_OFFSET,
-                                                                                                                   pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProperties_t xProperties;
+        uint32_t ulOffset, ulLength, ulPropertiesLength;
+    #endif /* mqttconfigENABLE_MQTT5 */
 
-            xUnsubscribeTxBuffer = prvPacketTypeFlagsIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_UNSUBSCRIBE, mqttFLAGS_UNSUBSCRIBE, usPacketIdentifier );
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+        {
+            /* The packet identifier is followed by properties and
+             * the reason code of the topic filter. */
+            ulLength = mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer );
+            ulOffset = mqttADJUST_OFFSET( mqttUNSUBACK_PROPERTIES_OFFSET, pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes );
 
-            if( xUnsubscribeTxBuffer == NULL )
+            if( ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ucUNSUBACKFixedHeader[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] ) &&
+                ( ulLength > ulOffset ) )
             {
-                /* Either an unsubscribe was never sent or the sender
-                 * timed out. Either case, this is an unexpected UNSUBACK. */
-                xEventCallbackParams.xEventType = eMQTTUnexpectedUnSubACK;
-                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                ulPropertiesLength = prvDecodeProperties( &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulOffset ] ), ulLength - ulOffset, &xProperties );
+
+                if( ( ulPropertiesLength > ( uint32_t ) 0 ) && ( ulLength > ( ulOffset + ulPropertiesLength ) ) )
+                {
+                    ucReasonCode = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulOffset + ulPropertiesLength ];
+                    xWellFormed = eMQTTTrue;
+                }
             }
-            else
-            {
-                /* Inform the user about the received UNSUBACK. */
-                xEventCallbackParams.xEventType = eMQTTUnSubACK;
-                xEventCallbackParams.u.xMQTTUnSubACKData.usPacketIdentifier = usPacketIdentifier;
-                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+        }
+        else
+    #endif /* mqttconfigENABLE_MQTT5 */
+    {
+        /* Must have enough bytes to form a complete UNSUBACK packet
+         * which contains 2 byte packet identifier other than the fixed
+         * header. Does the received fixed header match the expected one
+         * for the UNSUBACK message (Fixed header is of 2 bytes for UNSUBACK
+         * message because Remaining Length is 2 which takes only one byte)? */
+        if( ( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= ( sizeof( ucUNSUBACKFixedHeader ) + ( uint32_t ) mqttUNSUBACK_PACKET_IDENTIFER_LENGTH ) ) &&
+            ( memcmp( ucUNSUBACKFixedHeader, mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), sizeof( ucUNSUBACKFixedHeader ) ) == 0 ) )
+        {
+            xWellFormed = eMQTTTrue;
+        }
+    }
 
-                #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    if( xWellFormed == eMQTTTrue )
+    {
+        /* Extract the packet identifier and see if there is an unsubscribe
+         * packet waiting for ACK. */
+        usPacketIdentifier = ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttUNSUBACK_PACKET_ID_MSB_OFFSET,
+                                                                                                              pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
+        usPacketIdentifier <<= mqttBITS_PER_BYTE;
+        usPacketIdentifier |= ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttUNSUBACK_PACKET_ID_LSB_OFFSET,
+                                                                                                               pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
 
-                    /* If we successfully unsubscribed, remove the
-                     * corresponding subscription entry from the subscription
-                     * manager. */
-                    prvRemoveSubscriptionForSubscribeOrUnsubscribeBuffer( pxMQTTContext, xUnsubscribeTxBuffer );
-                #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+        xUnsubscribeTxBuffer = prvPacketTypeFlagsIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_UNSUBSCRIBE, mqttFLAGS_UNSUBSCRIBE, usPacketIdentifier );
 
-                /* Return the Tx Buffer to the pool. */
-                prvReturnBuffer( pxMQTTContext, xUnsubscribeTxBuffer );
-            }
+        if( xUnsubscribeTxBuffer == NULL )
+        {
+            /* Either an unsubscribe was never sent or the sender
+             * timed out. Either case, this is an unexpected UNSUBACK. */
+            xEventCallbackParams.xEventType = eMQTTUnexpectedUnSubACK;
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
         }
         else
         {
-            /* Malformed packet - fixed header does not match the expected one. */
-            xMalformedPacket = eMQTTTrue;
+            /* Inform the user about the received UNSUBACK. */
+            xEventCallbackParams.xEventType = eMQTTUnSubACK;
+            xEventCallbackParams.u.xMQTTUnSubACKData.usPacketIdentifier = usPacketIdentifier;
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                xEventCallbackParams.u.xMQTTUnSubACKData.ucReasonCode = ucReasonCode;
+            #endif /* mqttconfigENABLE_MQTT5 */
+
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+
+            #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+                /* If we successfully unsubscribed, remove the
+                 * corresponding subscription entry from the subscription
+                 * manager. An MQTT 5 broker may refuse to unsubscribe. */
+                if( ucReasonCode < mqttREASON_CODE_FAILURE )
+                {
+                    prvRemoveSubscriptionForSubscribeOrUnsubscribeBuffer( pxMQTTContext, xUnsubscribeTxBuffer );
+                }
+            #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+            /* Return the Tx Buffer to the pool. */
+            prvReturnBuffer( pxMQTTContext, xUnsubscribeTxBuffer );
         }
     }
     else
     {
-        /* Malformed packet - not enough bytes. */
+        /* Malformed packet - not enough bytes or fixed header does
+         * not match the expected one. */
         xMalformedPacket = eMQTTTrue;
     }
 
@@ -1539,69 +2436,57 @@ static void prvProcessReceivedPUBACK( MQTTContext_t * pxMQTTContext )
 {
     MQTTBufferHandle_t xPublishTxBuffer;
     MQTTEventCallbackParams_t xEventCallbackParams;
-    MQTTBool_t xMalformedPacket = eMQTTFalse;
     uint16_t usPacketIdentifier;
-    static const uint8_t ucPUBACKFixedHeader[] =
-    {
-        mqttCONTROL_PUBACK | mqttFLAGS_PUBACK, /* Fixed header control packet type. */
-        2,                                     /* Fixed header remaining length - always 2 for PUBACK. */
-    };
+    uint8_t ucReasonCode;
 
-    /* Must have enough bytes to form a complete PUBACK packet
-     * which contains 2 byte packet identifier other than the fixed
-     * header. */
-    if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= ( sizeof( ucPUBACKFixedHeader ) + ( uint32_t ) mqttPUBACK_PACKET_IDENTIFER_LENGTH ) )
+    /* Is this a well formed PUBACK? */
+    if( prvGetAckPacketIdentifier( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBACK | mqttFLAGS_PUBACK ), &( usPacketIdentifier ), &( ucReasonCode ) ) == eMQTTTrue )
     {
-        /* Received enough data for a PUBACK - does the received fixed header match
-         * the expected one for the PUBACK message (Fixed header is of 2 bytes for PUBACK
-         * message because Remaining Length is 2 which takes only one byte)? */
-        if( memcmp( ucPUBACKFixedHeader, mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), sizeof( ucPUBACKFixedHeader ) ) == 0 )
-        {
-            /* Extract the packet identifier and see if there is a publish
-             * packet waiting for ACK. */
-            usPacketIdentifier = ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBACK_PACKET_ID_MSB_OFFSET,
-                                                                                                                  pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
-            usPacketIdentifier <<= mqttBITS_PER_BYTE;
-            usPacketIdentifier |= ( uint8_t ) ( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBACK_PACKET_ID_LSB_OFFSET,
-                                                                                                                   pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
+        /* See if there is a publish packet waiting for ACK. */
+        xPublishTxBuffer = prvPacketTypeIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_PUBLISH, usPacketIdentifier );
 
-            xPublishTxBuffer = prvPacketTypeIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_PUBLISH, usPacketIdentifier );
-
-            if( xPublishTxBuffer == NULL )
-            {
-                /* Either a publish was never sent or the sender
-                 * timed out. Either case, this is an unexpected PUBACK. */
-                xEventCallbackParams.xEventType = eMQTTUnexpectedPubACK;
-                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
-            }
-            else
-            {
-                /* Inform the user about the received UNSUBACK. */
-                xEventCallbackParams.xEventType = eMQTTPubACK;
-                xEventCallbackParams.u.xMQTTPubACKData.usPacketIdentifier = usPacketIdentifier;
-                ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
-
-                /* Return the Tx Buffer to the pool. */
-                prvReturnBuffer( pxMQTTContext, xPublishTxBuffer );
-            }
+        if( xPublishTxBuffer == NULL )
+        {
+            /* Either a publish was never sent or the sender
+             * timed out. Either case, this is an unexpected PUBACK. */
+            xEventCallbackParams.xEventType = eMQTTUnexpectedPubACK;
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
         }
         else
         {
-            /* Malformed packet - fixed header does not match the expected one. */
-            xMalformedPacket = eMQTTTrue;
+            /* Inform the user about the received PUBACK. */
+            xEventCallbackParams.xEventType = eMQTTPubACK;
+            xEventCallbackParams.u.xMQTTPubACKData.usPacketIdentifier = usPacketIdentifier;
+
+            #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+                xEventCallbackParams.u.xMQTTPubACKData.pvPublishData = mqttbufferGET_PUBLISH_DATA( xPublishTxBuffer );
+            #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                xEventCallbackParams.u.xMQTTPubACKData.ucReasonCode = ucReasonCode;
+            #endif /* mqttconfigENABLE_MQTT5 */
+
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+
+            #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+                /* The message has been delivered, it does not need
+                 * to be re-transmitted anymore. */
+                if( pxMQTTContext->pxInflightStore != NULL )
+                {
+                    pxMQTTContext->pxInflightStore->pxRemoveFxn( pxMQTTContext->pxInflightStore->pvStoreContext, usPacketIdentifier );
+                }
+            #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+            /* Return the Tx Buffer to the pool. */
+            prvReturnBuffer( pxMQTTContext, xPublishTxBuffer );
         }
     }
     else
     {
-        /* Malformed packet - not enough bytes. */
-        xMalformedPacket = eMQTTTrue;
-    }
-
-    /* A malformed packet should result in disconnect. Note
-     * that there is no need to disconnect in the case of
-     * unexpected PUBACK. */
-    if( xMalformedPacket == eMQTTTrue )
-    {
+        /* A malformed packet should result in disconnect. Note
+         * that there is no need to disconnect in the case of
+         * unexpected PUBACK. */
         prvResetMQTTContext( pxMQTTContext );
 
         /* Inform user about the malformed packet received. */
@@ -1615,45 +2500,81 @@ static void prvProcessReceivedPUBACK( MQTTContext_t * pxMQTTContext )
 }
 /*-----------------------------------------------------------*/
 
-static void prvProcessReceivedPINGRESP( MQTTContext_t * pxMQTTContext )
+static void prvProcessReceivedPUBREC( MQTTContext_t * pxMQTTContext )
 {
+    MQTTBufferHandle_t xTxBuffer;
     MQTTEventCallbackParams_t xEventCallbackParams;
-    MQTTBool_t xValidPingResponse = eMQTTFalse;
-    static const uint8_t ucPingRespPacket[] =
-    {
-        mqttCONTROL_PINGRESP | mqttFLAGS_PINGRESP,
-        0 /* PINGRESP packet does not have any variable header or payload. */
-    };
+    uint16_t usPacketIdentifier;
+    uint8_t * pucPacket;
+    uint8_t ucReasonCode;
 
-    /* Did we receive a valid PINGRESP? */
-    if( pxMQTTContext->ulRxMessageReceivedLength >= sizeof( ucPingRespPacket ) )
+    /* Is this a well formed PUBREC? */
+    if( prvGetAckPacketIdentifier( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBREC | mqttFLAGS_PUBREC ), &( usPacketIdentifier ), &( ucReasonCode ) ) == eMQTTTrue )
     {
-        if( memcmp( pxMQTTContext->ucRxFixedHeaderBuffer, ucPingRespPacket, sizeof( ucPingRespPacket ) ) == 0 )
+        /* See if there is a QoS2 publish packet waiting for PUBREC. */
+        xTxBuffer = prvPacketTypeIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_PUBLISH, usPacketIdentifier );
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+            /* A refused message ends the exchange without a PUBREL. */
+            if( ( xTxBuffer != NULL ) &&
+                ( ucReasonCode >= mqttREASON_CODE_FAILURE ) &&
+                ( mqttPUBLISH_QoS_BITS( mqttbufferGET_DATA( xTxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] ) == ( uint8_t ) eMQTTQoS2 ) )
+            {
+                prvCompleteRefusedPublish( pxMQTTContext, xTxBuffer, usPacketIdentifier, ucReasonCode );
+                xTxBuffer = NULL;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+
+        if( ( xTxBuffer != NULL ) &&
+            ( mqttPUBLISH_QoS_BITS( mqttbufferGET_DATA( xTxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] ) == ( uint8_t ) eMQTTQoS2 ) )
         {
-            /* PINGRESP packet is valid. */
-            xValidPingResponse = eMQTTTrue;
+            /* The broker now owns the message, so the publish packet is
+             * no longer needed. Replace it with the PUBREL in the same
+             * buffer - it keeps the remaining timeout of the operation. */
+            pucPacket = mqttbufferGET_DATA( xTxBuffer );
+            pucPacket[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] = mqttCONTROL_PUBREL | mqttFLAGS_PUBREL;
+            pucPacket[ mqttFIXED_HEADER_REMAINING_LENGTH_OFFSET ] = ( uint8_t ) mqttPUBACK_PACKET_IDENTIFER_LENGTH;
+            pucPacket[ mqttPUBACK_PACKET_ID_MSB_OFFSET ] = ( uint8_t ) ( usPacketIdentifier >> mqttBITS_PER_BYTE );
+            pucPacket[ mqttPUBACK_PACKET_ID_LSB_OFFSET ] = ( uint8_t ) ( usPacketIdentifier );
+            mqttbufferGET_DATA_LENGTH( xTxBuffer ) = ( uint32_t ) mqttPUBACK_PACKET_LENGTH;
+
+            #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+                /* Replace the publish packet in the store as well. If
+                 * it fails, the publish packet is re-transmitted instead
+                 * on the next connection and the broker answers with
+                 * another PUBREC. */
+                if( pxMQTTContext->pxInflightStore != NULL )
+                {
+                    if( pxMQTTContext->pxInflightStore->pxPutFxn( pxMQTTContext->pxInflightStore->pvStoreContext,
+                                                                  usPacketIdentifier,
+                                                                  pucPacket,
+                                                                  ( uint32_t ) mqttPUBACK_PACKET_LENGTH ) == eMQTTFalse )
+                    {
+                        mqttconfigDEBUG_LOG( ( "Failed to store PUBREL %d.\r\n", usPacketIdentifier ) );
+                    }
+                }
+            #endif /* mqttconfigENABLE_INFLIGHT_STORE */
         }
-    }
-
-    if( xValidPingResponse == eMQTTTrue )
-    {
-        /* If we were expecting a PINGESP, update the time-stamp
-         * when the next PINGREQ should be sent. Otherwise ignore
-         * this unexpected PINRESP. */
-        if( pxMQTTContext->xWaitingForPingResp == eMQTTTrue )
+        else
         {
-            /* Mark that we received the expected PINGRESP. */
-            pxMQTTContext->xWaitingForPingResp = eMQTTFalse;
+            /* Is the message already released? This happens when the
+             * broker re-transmits the PUBREC because the PUBREL was lost. */
+            xTxBuffer = prvPacketTypeFlagsIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_PUBREL, mqttFLAGS_PUBREL, usPacketIdentifier );
+        }
 
-            /* Reset the last sent message timestamp so that the
-             * next PINGREQ can be sent at appropriate time. */
-            pxMQTTContext->xLastSentMessageTimestamp = prvGetCurrentTickCount( pxMQTTContext );
-            pxMQTTContext->ulNextPeriodicInvokeTicks = pxMQTTContext->ulKeepAliveActualIntervalTicks;
+        if( xTxBuffer != NULL )
+        {
+            /* Transmit the PUBREL. If it fails, the broker re-transmits
+             * the PUBREC. */
+            ( void ) prvSendData( pxMQTTContext, mqttbufferGET_DATA( xTxBuffer ), mqttbufferGET_DATA_LENGTH( xTxBuffer ) );
         }
-        else
+        else if( ucReasonCode < mqttREASON_CODE_FAILURE )
         {
-            /* Unexpected PINGRESP. */
-            mqttconfigDEBUG_LOG( ( "Unexpected PINGRESP received.\r\n" ) );
+            /* Either a QoS2 publish was never sent or the sender timed
+             * out. Either case, this is an unexpected PUBREC. */
+            mqttconfigDEBUG_LOG( ( "Unexpected PUBREC %d received.\r\n", usPacketIdentifier ) );
         }
     }
     else
@@ -1666,102 +2587,111 @@ static void prvProcessReceivedPINGRESP( MQTTContext_t * pxMQTTContext )
         xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
         ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
     }
+
+    /* Return the RxBuffer to the free buffer pool. */
+    prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
 }
 /*-----------------------------------------------------------*/
 
-static void prvProcessReceivedPublish( MQTTContext_t * pxMQTTContext )
+static void prvProcessReceivedPUBREL( MQTTContext_t * pxMQTTContext )
 {
     MQTTEventCallbackParams_t xEventCallbackParams;
-    uint8_t ucPacketIdentiferLength; /* Length in bytes taken by the packet identifier field in the received publish packet. */
-    uint8_t ucQos;
-    static uint8_t ucPUBACKPacket[] =
-    {
-        mqttCONTROL_PUBACK | mqttFLAGS_PUBACK, /* Fixed header control packet type. */
-        2,                                     /* Fixed header remaining length - always 2 for PUBACK. */
-        0,                                     /* Packet identifier MSB. */
-        0                                      /* Packet identifier LSB. */
-    };
+    uint16_t usPacketIdentifier;
+    uint8_t ucReasonCode;
+    uint32_t x;
 
-    /* A broker has sent a message to this client.  Decode it, then pass the
-     * decoded message into an application defined callback. */
-    xEventCallbackParams.xEventType = eMQTTPublish;
+    /* Is this a well formed PUBREL? */
+    if( prvGetAckPacketIdentifier( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL ), &( usPacketIdentifier ), &( ucReasonCode ) ) == eMQTTTrue )
+    {
+        /* The broker will not re-transmit the publish message
+         * anymore, so forget its packet identifier. */
+        for( x = 0; x < ( uint32_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES; x++ )
+        {
+            if( pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ x ] == usPacketIdentifier )
+            {
+                pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ x ] = 0;
+            }
+        }
 
-    /*_TODO_ Do we want to expose DUP and RETAIN? */
-    ucQos = mqttPUBLISH_QoS_BITS( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] );
+        /* The reason code of a PUBREL is only informative. */
+        ( void ) ucReasonCode;
 
-    /* QoS2 is not supported. */
-    if( ( ucQos == ( uint8_t ) 0 /* QoS0. */ ) || ( ucQos == ( uint8_t ) 1 /* QoS1. */ ) )
+        /* A PUBCOMP must be sent even if the packet identifier was
+         * unknown, for example because the PUBCOMP sent before was
+         * lost and the broker re-transmitted the PUBREL. */
+        prvSendPublishAck( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBCOMP | mqttFLAGS_PUBCOMP ), usPacketIdentifier );
+    }
+    else
     {
-        xEventCallbackParams.u.xPublishData.xQos = ( ucQos == ( uint8_t ) 0 ) ? eMQTTQoS0 : eMQTTQoS1;
+        /* A malformed packet should result in disconnect. */
+        prvResetMQTTContext( pxMQTTContext );
 
-        if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS0 )
+        /* Inform user about the malformed packet received. */
+        xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+        xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
+        ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+    }
+
+    /* Return the RxBuffer to the free buffer pool. */
+    prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+}
+/*-----------------------------------------------------------*/
+
+static void prvProcessReceivedPUBCOMP( MQTTContext_t * pxMQTTContext )
+{
+    MQTTBufferHandle_t xPubRelTxBuffer;
+    MQTTEventCallbackParams_t xEventCallbackParams;
+    uint16_t usPacketIdentifier;
+    uint8_t ucReasonCode;
+
+    /* Is this a well formed PUBCOMP? */
+    if( prvGetAckPacketIdentifier( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBCOMP | mqttFLAGS_PUBCOMP ), &( usPacketIdentifier ), &( ucReasonCode ) ) == eMQTTTrue )
+    {
+        /* See if there is a PUBREL packet waiting for PUBCOMP. */
+        xPubRelTxBuffer = prvPacketTypeFlagsIdentifierGetTxBuffer( pxMQTTContext, mqttCONTROL_PUBREL, mqttFLAGS_PUBREL, usPacketIdentifier );
+
+        if( xPubRelTxBuffer == NULL )
         {
-            ucPacketIdentiferLength = mqttPUBLISH_QOS0_PACKET_IDENTIFER_LENGTH;
+            /* Either a QoS2 publish was never sent or the sender
+             * timed out. Either case, this is an unexpected PUBCOMP. */
+            xEventCallbackParams.xEventType = eMQTTUnexpectedPubCOMP;
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
         }
         else
         {
-            ucPacketIdentiferLength = mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH;
-        }
-
-        /* Extract Topic Length. */
-        xEventCallbackParams.u.xPublishData.usTopicLength = ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_LENGTH_MSB,
-                                                                                                                                            pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ];
-        xEventCallbackParams.u.xPublishData.usTopicLength <<= mqttBITS_PER_BYTE;
-        xEventCallbackParams.u.xPublishData.usTopicLength |= ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_LENGTH_LSB,
-                                                                                                                                             pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ];
+            /* Inform the user about the received PUBCOMP. */
+            xEventCallbackParams.xEventType = eMQTTPubCOMP;
+            xEventCallbackParams.u.xMQTTPubACKData.usPacketIdentifier = usPacketIdentifier;
 
-        /* Extract Topic. */
-        xEventCallbackParams.u.xPublishData.pucTopic = &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET,
-                                                                                                                             pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ] );
+            #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+                xEventCallbackParams.u.xMQTTPubACKData.pvPublishData = mqttbufferGET_PUBLISH_DATA( xPubRelTxBuffer );
+            #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
 
-        /* Extract Published Data. */
-        xEventCallbackParams.u.xPublishData.pvData = ( void * ) &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET,
-                                                                                                                                      pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) +
-                                                                                                                   xEventCallbackParams.u.xPublishData.usTopicLength +
-                                                                                                                   ucPacketIdentiferLength ] ); /*lint !e9087 Publish data is provided as void* to the user. */
-
-        /* Topic string is followed by packet identifier which is
-         * followed by actual data. NOte that QoS0 publishes do not
-         * have packet identifier. */
-        xEventCallbackParams.u.xPublishData.ulDataLength = pxMQTTContext->xRxMessageState.ulTotalMessageLength - ( mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET,
-                                                                                                                                      pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) +
-                                                                                                                   xEventCallbackParams.u.xPublishData.usTopicLength +
-                                                                                                                   ucPacketIdentiferLength );
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                xEventCallbackParams.u.xMQTTPubACKData.ucReasonCode = ucReasonCode;
+            #endif /* mqttconfigENABLE_MQTT5 */
 
-        /* Pass the handle of the buffer containing the whole MQTT message. */
-        xEventCallbackParams.u.xPublishData.xBuffer = pxMQTTContext->xRxBuffer;
+            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
 
-        /* If this is a QoS1 publish, send the PUBACK before invoking the
-         * callback. */
-        if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS1 )
-        {
-            /* Extract the packet identifier from the publish message
-             * to set the same in PUBACK message. */
-            ucPUBACKPacket[ mqttPUBACK_PACKET_ID_MSB_OFFSET ] = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET,
-                                                                                                                                   pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) +
-                                                                                                                xEventCallbackParams.u.xPublishData.usTopicLength ];
-            ucPUBACKPacket[ mqttPUBACK_PACKET_ID_LSB_OFFSET ] = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET,
-                                                                                                                                   pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) +
-                                                                                                                xEventCallbackParams.u.xPublishData.usTopicLength +
-                                                                                                                ( uint16_t ) 1 /* Packet ID LSB follows MSB. */ ];
+            #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
 
-            /* Send a PUBACK to the broker confirming the receipt
-             * of the publish message. If we fail to send the PUBACK,
-             * we will receive the same publish message again. */
-            ( void ) prvSendData( pxMQTTContext, ucPUBACKPacket, ( uint32_t ) sizeof( ucPUBACKPacket ) );
-        }
+                /* The exchange is complete, the PUBREL does not need
+                 * to be re-transmitted anymore. */
+                if( pxMQTTContext->pxInflightStore != NULL )
+                {
+                    pxMQTTContext->pxInflightStore->pxRemoveFxn( pxMQTTContext->pxInflightStore->pvStoreContext, usPacketIdentifier );
+                }
+            #endif /* mqttconfigENABLE_INFLIGHT_STORE */
 
-        /* If the user chooses not to take the ownership of the buffer,
-         * return it back to the free buffer pool. */
-        if( prvInvokeCallback( pxMQTTContext, &xEventCallbackParams ) == eMQTTFalse )
-        {
-            prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+            /* Return the Tx Buffer to the pool. */
+            prvReturnBuffer( pxMQTTContext, xPubRelTxBuffer );
         }
     }
     else
     {
-        /* A publish packet with QoS2 is considered malformed and
-         * we disconnect. */
+        /* A malformed packet should result in disconnect. Note
+         * that there is no need to disconnect in the case of
+         * unexpected PUBCOMP. */
         prvResetMQTTContext( pxMQTTContext );
 
         /* Inform user about the malformed packet received. */
@@ -1769,212 +2699,1925 @@ static void prvProcessReceivedPublish( MQTTContext_t * pxMQTTContext )
         xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
         ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
     }
+
+    /* Return the RxBuffer to the free buffer pool. */
+    prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
 }
 /*-----------------------------------------------------------*/
 
-static MQTTBool_t prvInvokeCallback( MQTTContext_t * pxMQTTContext,
-                                     MQTTEventCallbackParams_t * pxEventCallbackParams )
+static MQTTBool_t prvGetAckPacketIdentifier( const MQTTContext_t * pxMQTTContext,
+                                             uint8_t ucControlByte,
+                                             uint16_t * pusPacketIdentifier,
+                                             uint8_t * pucReasonCode )
 {
-    MQTTBool_t xBufferOwnershipTaken = eMQTTFalse;
+    MQTTBool_t xWellFormed = eMQTTFalse;
+    const uint8_t * pucPacket = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer );
+    uint8_t ucRemainingLengthFieldBytes = pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes;
 
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-        MQTTBool_t xSubscriptionCallbackInvoked = eMQTTFalse;
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProperties_t xProperties;
+        uint32_t ulOffset, ulLength;
+    #endif /* mqttconfigENABLE_MQTT5 */
 
-        /* In case of a publish message, try to invoke
-         * subscription specific callback first. If the
-         * user has not registered any specific callback
-         * for this topic, invoke the generic one. */
-        if( pxEventCallbackParams->xEventType == eMQTTPublish )
-        {
-            xBufferOwnershipTaken = prvInvokeSubscriptionCallbacks( pxMQTTContext,
-                                                                    &( pxEventCallbackParams->u.xPublishData ),
-                                                                    &( xSubscriptionCallbackInvoked ) );
-        }
+    /* A left out reason code means success. */
+    *pucReasonCode = 0;
 
-        /* Invoke generic callback, if any subscription callback was
-         * not invoked and the user has registered a generic one. Note
-         * that since no callback was invoked, we are sure that the user
-         * has not got any chance to take the buffer ownership. That's
-         * why no check for xBufferOwnershipTaken. */
-        if( ( xSubscriptionCallbackInvoked == eMQTTFalse ) && ( pxMQTTContext->pxCallback != NULL ) )
-        {
-            xBufferOwnershipTaken = pxMQTTContext->pxCallback( pxMQTTContext->pvCallbackContext, pxEventCallbackParams );
-        }
-    #else /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-        /* Invoke the generic callback, if the user has registered one. */
-        if( pxMQTTContext->pxCallback != NULL )
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
         {
-            xBufferOwnershipTaken = pxMQTTContext->pxCallback( pxMQTTContext->pvCallbackContext, pxEventCallbackParams );
-        }
-    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-
-    return xBufferOwnershipTaken;
-}
-/*-----------------------------------------------------------*/
+            /* The packet identifier may be followed by a reason code,
+             * which may be followed by properties. */
+            ulLength = mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer );
+            ulOffset = mqttADJUST_OFFSET( mqttPUBACK_REASON_CODE_OFFSET, ucRemainingLengthFieldBytes );
 
-static uint8_t * prvWriteString( uint8_t * pucDestination,
-                                 const uint8_t * const pucLastByteInBuffer,
-                                 const uint8_t * const pucString,
-                                 uint16_t usStringLength )
-{
-    uint8_t * pucEndAddress;
+            if( ( pucPacket[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ucControlByte ) && ( ulLength >= ulOffset ) )
+            {
+                xWellFormed = eMQTTTrue;
 
-    /* Check that writing the string and the two byte length into pucDestination
-     * won't overflow the buffer. */
-    pucEndAddress = &( pucDestination[ mqttSTRLEN( usStringLength ) - ( uint16_t ) 1 ] );
+                if( ulLength > ulOffset )
+                {
+                    *pucReasonCode = pucPacket[ ulOffset ];
+                    ulOffset++;
+                }
 
-    /* Check the calculated end address against the last address of the Tx
-     * buffer. */
-    if( pucEndAddress <= pucLastByteInBuffer ) /*lint !e946 Pointer comparison is ok as we are checking for memory overflow. */
+                if( ( ulLength > ulOffset ) && ( prvDecodeProperties( &( pucPacket[ ulOffset ] ), ulLength - ulOffset, &xProperties ) != ( ulLength - ulOffset ) ) )
+                {
+                    xWellFormed = eMQTTFalse;
+                }
+            }
+        }
+        else
+    #endif /* mqttconfigENABLE_MQTT5 */
     {
-        *pucDestination = ( uint8_t ) ( usStringLength >> mqttBITS_PER_BYTE );
-        pucDestination++;
-        *pucDestination = ( uint8_t ) usStringLength;
-        pucDestination++;
-        memcpy( pucDestination, pucString, usStringLength );
+        /* Must have enough bytes to form a complete packet which contains
+         * 2 byte packet identifier other than the fixed header. The fixed
+         * header is of 2 bytes because the Remaining Length is always 2
+         * which takes only one byte. */
+        if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= ( uint32_t ) mqttPUBACK_PACKET_LENGTH )
+        {
+            /* Does the received fixed header match the expected one? */
+            if( ( pucPacket[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] == ucControlByte ) &&
+                ( pucPacket[ mqttFIXED_HEADER_REMAINING_LENGTH_OFFSET ] == ( uint8_t ) mqttPUBACK_PACKET_IDENTIFER_LENGTH ) )
+            {
+                xWellFormed = eMQTTTrue;
+            }
+        }
     }
-    else
+
+    if( xWellFormed == eMQTTTrue )
     {
-        /* Writing the string would have overflowed the Tx buffer. */
-        usStringLength = ( uint16_t ) 0;
+        /* Extract the packet identifier. */
+        *pusPacketIdentifier = ( uint16_t ) pucPacket[ mqttADJUST_OFFSET( mqttPUBACK_PACKET_ID_MSB_OFFSET, ucRemainingLengthFieldBytes ) ];
+        *pusPacketIdentifier <<= mqttBITS_PER_BYTE;
+        *pusPacketIdentifier |= ( uint16_t ) pucPacket[ mqttADJUST_OFFSET( mqttPUBACK_PACKET_ID_LSB_OFFSET, ucRemainingLengthFieldBytes ) ];
     }
 
-    /* Return the address of the byte following the string just copied to the
-     * buffer. */
-    return &( pucDestination[ usStringLength ] );
+    return xWellFormed;
 }
 /*-----------------------------------------------------------*/
 
-static uint8_t prvSizeOfRemainingLength( uint32_t ulRemainingLength )
+static void prvSendPublishAck( MQTTContext_t * pxMQTTContext,
+                               uint8_t ucControlByte,
+                               uint16_t usPacketIdentifier )
 {
-    uint8_t ucRemainingLengthFieldBytes = 0;
-
-    /* Ensure that given length is within the limits of what can be
-     * encoded in 4 bytes. */
-    mqttconfigASSERT( ulRemainingLength <= mqttMAX_REMAINING_LENGTH_LENGTH );
+    uint8_t ucAckPacket[ mqttPUBACK_PACKET_LENGTH ];
 
-    /* The numbers below are taken from the MQTT protocol spec. */
-    if( ulRemainingLength <= ( uint32_t ) mqttONE_BYTE_MAX_REMAINING_LENGTH )
-    {
-        ucRemainingLengthFieldBytes = 1;
-    }
-    else if( ( ulRemainingLength > ( uint32_t ) mqttONE_BYTE_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttTWO_BYTES_MAX_REMAINING_LENGTH ) )
-    {
-        ucRemainingLengthFieldBytes = 2;
-    }
-    else if( ( ulRemainingLength > ( uint32_t ) mqttTWO_BYTES_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttTHREE_BYTES_MAX_REMAINING_LENGTH ) )
-    {
-        ucRemainingLengthFieldBytes = 3;
-    }
-    else if( ( ulRemainingLength > ( uint32_t ) mqttTHREE_BYTES_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttMAX_REMAINING_LENGTH_LENGTH ) )
-    {
-        ucRemainingLengthFieldBytes = 4;
-    }
-    else
-    {
-        /* Incorrect remaining length. */
-    }
+    ucAckPacket[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] = ucControlByte;
+    ucAckPacket[ mqttFIXED_HEADER_REMAINING_LENGTH_OFFSET ] = ( uint8_t ) mqttPUBACK_PACKET_IDENTIFER_LENGTH;
+    ucAckPacket[ mqttPUBACK_PACKET_ID_MSB_OFFSET ] = ( uint8_t ) ( usPacketIdentifier >> mqttBITS_PER_BYTE );
+    ucAckPacket[ mqttPUBACK_PACKET_ID_LSB_OFFSET ] = ( uint8_t ) ( usPacketIdentifier );
 
-    return ucRemainingLengthFieldBytes;
+    /* If we fail to send the acknowledgment, the broker
+     * re-transmits the message being acknowledged. */
+    ( void ) prvSendData( pxMQTTContext, ucAckPacket, ( uint32_t ) sizeof( ucAckPacket ) );
 }
 /*-----------------------------------------------------------*/
 
-static uint8_t prvEncodeRemainingLength( uint32_t ulRemainingLength,
-                                         uint8_t * const pucEncodedRemainingLength,
-                                         const uint8_t * const pucLastByteInBuffer )
+static MQTTBool_t prvIsNewQoS2Publish( MQTTContext_t * pxMQTTContext,
+                                       uint16_t usPacketIdentifier )
 {
-    uint8_t ucBytesWritten = 0, ucEncodedByte;
-
-    /* Ensure that given length is within the limits of what can be
-     * encoded in 4 bytes. */
-    mqttconfigASSERT( ulRemainingLength <= mqttMAX_REMAINING_LENGTH_LENGTH );
+    MQTTBool_t xNewPublish = eMQTTTrue;
+    uint32_t x, ulFreeEntry = ( uint32_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES;
 
-    do
+    /* Zero marks a free entry and is not a valid packet identifier. */
+    if( usPacketIdentifier != ( uint16_t ) 0 )
     {
-        /* Extract 7 bits from the length. */
-        ucEncodedByte = ( ( uint8_t ) ( ulRemainingLength ) & mqttLENGTH_BITMASK_REMAINING_LENGTH );
-        ulRemainingLength >>= mqttLENGTH_BITS_REMAINING_LENGTH;
-
-        /* If there is more data to encode, set the continuation
-         * bit of this byte. */
-        if( ulRemainingLength > ( uint32_t ) 0 )
+        for( x = 0; x < ( uint32_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES; x++ )
         {
-            ucEncodedByte |= mqttREMAINING_LENGTH_CONTINUATION_BITMASK;
+            if( pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ x ] == usPacketIdentifier )
+            {
+                /* Received before and not released yet. */
+                xNewPublish = eMQTTFalse;
+                break;
+            }
+            else if( pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ x ] == ( uint16_t ) 0 )
+            {
+                ulFreeEntry = x;
+            }
+            else
+            {
+                /* Entry in use for another message. */
+            }
         }
 
-        /* Ensure that writing this byte will not result in buffer overflow. */
-        mqttconfigASSERT( &( pucEncodedRemainingLength[ ucBytesWritten ] ) <= pucLastByteInBuffer );
-
-        if( &( pucEncodedRemainingLength[ ucBytesWritten ] ) <= pucLastByteInBuffer ) /*lint !e946 Pointer comparison is ok as we are checking for memory overflow. */
-        {
-            /* Write the encoded byte to the provided buffer. */
-            pucEncodedRemainingLength[ ucBytesWritten ] = ucEncodedByte;
-            ucBytesWritten++;
-        }
-        else
+        if( xNewPublish == eMQTTTrue )
         {
-            /* There is not enough space in the provided buffer. Inform the caller
-             * by returning zero. */
-            ucBytesWritten = 0;
-            break;
+            if( ulFreeEntry < ( uint32_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES )
+            {
+                pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ ulFreeEntry ] = usPacketIdentifier;
+            }
+            else
+            {
+                mqttconfigDEBUG_LOG( ( "No space to remember QoS2 publish %d, it may be delivered again.\r\n", usPacketIdentifier ) );
+            }
         }
-    } while( ulRemainingLength > ( uint32_t ) 0 );
+    }
 
-    return ucBytesWritten;
+    return xNewPublish;
 }
 /*-----------------------------------------------------------*/
 
-static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemainingLength,
-                                         uint32_t * const pulRemainingLength )
-{
-    uint8_t ucBytesRead, ucDecodedByte;
-    uint32_t x, ulDecodedRemainingLength = 0, ulDecodedByte;
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
 
-    for( x = 0; x < ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES; x++ )
+    static MQTTBool_t prvIsQoS2PublishReceived( const MQTTContext_t * pxMQTTContext,
+                                                uint16_t usPacketIdentifier )
     {
-        /* Extract 7 lower bits from the current byte - These bits contain the
-         * actual length information. */
-        ucDecodedByte = ( pucEncodedRemainingLength[ x ] & mqttLENGTH_BITMASK_REMAINING_LENGTH );
-
-        /* Move the extracted bits to their correct location. */
-        ulDecodedByte = ( uint32_t ) ucDecodedByte;
-        ulDecodedByte <<= ( x * ( uint32_t ) mqttLENGTH_BITS_REMAINING_LENGTH );
-
-        /* Place the extracted bits in the decoded length. */
-        ulDecodedRemainingLength |= ulDecodedByte;
+        MQTTBool_t xReceived = eMQTTFalse;
+        uint32_t x;
 
-        /* If the continuation bit is not set in the current byte, decoding is
-         * complete. */
-        if( ( pucEncodedRemainingLength[ x ] & mqttREMAINING_LENGTH_CONTINUATION_BITMASK ) == ( uint8_t ) 0 )
+        /* Zero marks a free entry and is not a valid packet identifier. */
+        if( usPacketIdentifier != ( uint16_t ) 0 )
         {
-            break;
+            for( x = 0; x < ( uint32_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES; x++ )
+            {
+                if( pxMQTTContext->usQoS2ReceivedPacketIdentifiers[ x ] == usPacketIdentifier )
+                {
+                    xReceived = eMQTTTrue;
+                    break;
+                }
+            }
         }
+
+        return xReceived;
     }
 
-    if( x >= ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES )
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+    static void prvResendInflightMessages( MQTTContext_t * pxMQTTContext )
     {
-        /* This would happen in case 4th byte also has continuation bit set.
-         * This indicates a malformed encoded length and we inform the caller by
-         * returning 0. Note that the provided output buffer pulRemainingLength
-         * is not modified in this case. */
-        ucBytesRead = 0;
+        const MQTTInflightStoreInterface_t * pxInflightStore = pxMQTTContext->pxInflightStore;
+        MQTTBufferHandle_t xBuffer;
+        const uint8_t * pucPacket;
+        uint32_t ulPacketLength, ulIndex = 0;
+        uint16_t usPacketIdentifier;
+
+        if( pxInflightStore != NULL )
+        {
+            while( pxInflightStore->pxGetFxn( pxInflightStore->pvStoreContext,
+                                              ulIndex,
+                                              &( usPacketIdentifier ),
+                                              &( pucPacket ),
+                                              &( ulPacketLength ) ) == eMQTTTrue )
+            {
+                /* Try to get a buffer from the free buffer pool. */
+                xBuffer = prvGetFreeBuffer( pxMQTTContext, ulPacketLength );
+
+                if( xBuffer == NULL )
+                {
+                    /* The remaining messages stay in the store and are
+                     * re-transmitted on the next connection. */
+                    mqttconfigDEBUG_LOG( ( "No free buffer to re-transmit in-flight messages. \r\n" ) );
+                    break;
+                }
+
+                /* Copy the stored packet and mark re-transmitted publish
+                 * packets as duplicates. */
+                memcpy( mqttbufferGET_DATA( xBuffer ), pucPacket, ( size_t ) ulPacketLength );
+                mqttbufferGET_DATA_LENGTH( xBuffer ) = ulPacketLength;
+
+                if( ( mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] & mqttTOP_NIBBLE_MASK ) == mqttCONTROL_PUBLISH )
+                {
+                    mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] |= mqttFLAGS_PUBLISH_DUP;
+                }
+
+                /* Record time-stamp, store timeout and packet identifier and
+                 * wait for the acknowledgment like for any other message. */
+                mqttbufferGET_PACKET_RECORDED_TICK_COUNT( xBuffer ) = prvGetCurrentTickCount( pxMQTTContext );
+                mqttbufferGET_PACKET_TIMEOUT_TICKS( xBuffer ) = pxInflightStore->ulResendTimeoutTicks;
+                mqttbufferGET_PACKET_IDENTIFIER( xBuffer ) = usPacketIdentifier;
+                mqttbufferLIST_ADD( &( pxMQTTContext->xTxBufferListHead ), xBuffer );
+
+                if( prvSendData( pxMQTTContext, mqttbufferGET_DATA( xBuffer ), mqttbufferGET_DATA_LENGTH( xBuffer ) ) != eMQTTSuccess )
+                {
+                    /* The connection is not usable, the message stays in
+                     * the store. */
+                    prvReturnBuffer( pxMQTTContext, xBuffer );
+                    break;
+                }
+
+                ulIndex++;
+            }
+        }
     }
-    else
-    {
-        /* The decoding is successful. Inform the user by returning the number
-         * of bytes used in decoding from given encoded length. */
-        ucBytesRead = ( uint8_t ) x + ( uint8_t ) 1;
 
-        /* If the user has provided output buffer, return the decoded length
-         * in it. */
-        if( pulRemainingLength != NULL )
+#endif /* mqttconfigENABLE_INFLIGHT_STORE */
+/*-----------------------------------------------------------*/
+
+static void prvProcessReceivedPINGRESP( MQTTContext_t * pxMQTTContext )
+{
+    MQTTEventCallbackParams_t xEventCallbackParams;
+    MQTTBool_t xValidPingResponse = eMQTTFalse;
+    static const uint8_t ucPingRespPacket[] =
+    {
+        mqttCONTROL_PINGRESP | mqttFLAGS_PINGRESP,
+        0 /* PINGRESP packet does not have any variable header or payload. */
+    };
+
+    /* Did we receive a valid PINGRESP? */
+    if( pxMQTTContext->ulRxMessageReceivedLength >= sizeof( ucPingRespPacket ) )
+    {
+        if( memcmp( pxMQTTContext->ucRxFixedHeaderBuffer, ucPingRespPacket, sizeof( ucPingRespPacket ) ) == 0 )
+        {
+            /* PINGRESP packet is valid. */
+            xValidPingResponse = eMQTTTrue;
+        }
+    }
+
+    if( xValidPingResponse == eMQTTTrue )
+    {
+        /* If we were expecting a PINGESP, update the time-stamp
+         * when the next PINGREQ should be sent. Otherwise ignore
+         * this unexpected PINRESP. */
+        if( pxMQTTContext->xWaitingForPingResp == eMQTTTrue )
+        {
+            /* Mark that we received the expected PINGRESP. */
+            pxMQTTContext->xWaitingForPingResp = eMQTTFalse;
+
+            /* Reset the last sent message timestamp so that the
+             * next PINGREQ can be sent at appropriate time. */
+            pxMQTTContext->xLastSentMessageTimestamp = prvGetCurrentTickCount( pxMQTTContext );
+            pxMQTTContext->ulNextPeriodicInvokeTicks = pxMQTTContext->ulKeepAliveActualIntervalTicks;
+        }
+        else
+        {
+            /* Unexpected PINGRESP. */
+            mqttconfigDEBUG_LOG( ( "Unexpected PINGRESP received.\r\n" ) );
+        }
+    }
+    else
+    {
+        /* A malformed packet should result in disconnect. */
+        prvResetMQTTContext( pxMQTTContext );
+
+        /* Inform user about the malformed packet received. */
+        xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+        xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
+        ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvProcessReceivedPublish( MQTTContext_t * pxMQTTContext )
+{
+    MQTTEventCallbackParams_t xEventCallbackParams;
+    uint8_t ucPacketIdentiferLength; /* Length in bytes taken by the packet identifier field in the received publish packet. */
+    uint8_t ucQos;
+    uint16_t usPacketIdentifier = 0;
+    uint32_t ulTopicOffset, ulDataOffset;
+    MQTTBool_t xNewPublish = eMQTTTrue, xWellFormed = eMQTTFalse;
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        MQTTProperties_t xProperties;
+        uint32_t ulPropertiesLength = 0;
+    #endif /* mqttconfigENABLE_MQTT5 */
+
+    /* A broker has sent a message to this client.  Decode it, then pass the
+     * decoded message into an application defined callback. */
+    xEventCallbackParams.xEventType = eMQTTPublish;
+
+    /*_TODO_ Do we want to expose DUP and RETAIN? */
+    ucQos = mqttPUBLISH_QoS_BITS( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] );
+
+    /* Both QoS bits set is a reserved value. */
+    if( ucQos <= ( uint8_t ) eMQTTQoS2 )
+    {
+        xEventCallbackParams.u.xPublishData.xQos = ( MQTTQoS_t ) ucQos;
+
+        if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS0 )
+        {
+            ucPacketIdentiferLength = mqttPUBLISH_QOS0_PACKET_IDENTIFER_LENGTH;
+        }
+        else if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS1 )
+        {
+            ucPacketIdentiferLength = mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH;
+        }
+        else
+        {
+            ucPacketIdentiferLength = mqttPUBLISH_QOS2_PACKET_IDENTIFER_LENGTH;
+        }
+
+        /* Extract Topic Length. */
+        xEventCallbackParams.u.xPublishData.usTopicLength = ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_LENGTH_MSB,
+                                                                                                                                            pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ];
+        xEventCallbackParams.u.xPublishData.usTopicLength <<= mqttBITS_PER_BYTE;
+        xEventCallbackParams.u.xPublishData.usTopicLength |= ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_LENGTH_LSB,
+                                                                                                                                             pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes ) ];
+
+        /* Extract Topic. */
+        ulTopicOffset = mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET, pxMQTTContext->xRxMessageState.ucRemaingingLengthFieldBytes );
+        xEventCallbackParams.u.xPublishData.pucTopic = &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulTopicOffset ] );
+
+        /* Topic string is followed by the packet identifier, which
+         * QoS0 publishes do not have. */
+        if( xEventCallbackParams.u.xPublishData.xQos != eMQTTQoS0 )
+        {
+            usPacketIdentifier = ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulTopicOffset +
+                                                                                              xEventCallbackParams.u.xPublishData.usTopicLength ];
+            usPacketIdentifier <<= mqttBITS_PER_BYTE;
+            usPacketIdentifier |= ( uint16_t ) mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulTopicOffset +
+                                                                                               xEventCallbackParams.u.xPublishData.usTopicLength +
+                                                                                               ( uint16_t ) 1 /* Packet ID LSB follows MSB. */ ];
+        }
+
+        /* The packet identifier is followed by actual data. */
+        ulDataOffset = ulTopicOffset + ( uint32_t ) xEventCallbackParams.u.xPublishData.usTopicLength + ( uint32_t ) ucPacketIdentiferLength;
+        xWellFormed = eMQTTTrue;
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                /* The properties come between the packet identifier
+                 * and the data. The topic may be replaced with an
+                 * alias. */
+                if( ulDataOffset < pxMQTTContext->xRxMessageState.ulTotalMessageLength )
+                {
+                    ulPropertiesLength = prvDecodeProperties( &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulDataOffset ] ),
+                                                              pxMQTTContext->xRxMessageState.ulTotalMessageLength - ulDataOffset,
+                                                              &xProperties );
+                }
+
+                if( ( ulPropertiesLength == ( uint32_t ) 0 ) ||
+                    ( prvResolveRxTopicAlias( pxMQTTContext,
+                                              xProperties.usTopicAlias,
+                                              &( xEventCallbackParams.u.xPublishData.pucTopic ),
+                                              &( xEventCallbackParams.u.xPublishData.usTopicLength ) ) == eMQTTFalse ) )
+                {
+                    xWellFormed = eMQTTFalse;
+                }
+
+                ulDataOffset += ulPropertiesLength;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+    }
+
+    if( xWellFormed == eMQTTTrue )
+    {
+        /* Extract Published Data. */
+        xEventCallbackParams.u.xPublishData.pvData = ( void * ) &( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer )[ ulDataOffset ] ); /*lint !e9087 Publish data is provided as void* to the user. */
+        xEventCallbackParams.u.xPublishData.ulDataLength = pxMQTTContext->xRxMessageState.ulTotalMessageLength - ulDataOffset;
+
+        /* Pass the handle of the buffer containing the whole MQTT message. */
+        xEventCallbackParams.u.xPublishData.xBuffer = pxMQTTContext->xRxBuffer;
+
+        /* Send the acknowledgment before invoking the callback. If we
+         * fail to send it, we will receive the same publish message
+         * again. */
+        if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS1 )
+        {
+            /* Send a PUBACK to the broker confirming the receipt
+             * of the publish message. */
+            prvSendPublishAck( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBACK | mqttFLAGS_PUBACK ), usPacketIdentifier );
+        }
+        else if( xEventCallbackParams.u.xPublishData.xQos == eMQTTQoS2 )
+        {
+            /* A QoS2 publish message is passed to the user only the
+             * first time it is received, but every re-transmission is
+             * acknowledged with a PUBREC as the previous one may have
+             * been lost. */
+            xNewPublish = prvIsNewQoS2Publish( pxMQTTContext, usPacketIdentifier );
+            prvSendPublishAck( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBREC | mqttFLAGS_PUBREC ), usPacketIdentifier );
+        }
+        else
+        {
+            /* No acknowledgment for QoS0. */
+        }
+
+        /* Drop a duplicate. Otherwise, if the user chooses not to take
+         * the ownership of the buffer, return it back to the free buffer
+         * pool. */
+        if( xNewPublish == eMQTTFalse )
+        {
+            mqttconfigDEBUG_LOG( ( "Duplicate QoS2 publish %d dropped.\r\n", usPacketIdentifier ) );
+            prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+        }
+        else if( prvInvokeCallback( pxMQTTContext, &xEventCallbackParams ) == eMQTTFalse )
+        {
+            prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+        }
+        else
+        {
+            /* The user owns the buffer now. */
+        }
+    }
+    else
+    {
+        /* A publish packet with reserved QoS value or malformed
+         * properties is considered malformed and we disconnect. */
+        prvResetMQTTContext( pxMQTTContext );
+
+        /* Inform user about the malformed packet received. */
+        xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+        xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
+        ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+
+    static size_t prvStreamReceivedPublish( MQTTContext_t * pxMQTTContext,
+                                            const uint8_t * pucReceivedData,
+                                            size_t xReceivedDataLength )
+    {
+        MQTTRxMessageState_t * pxRxMessageState = &( pxMQTTContext->xRxMessageState );
+        MQTTPublishChunkData_t * pxStreamData = &( pxMQTTContext->xRxMessageState.xStreamData );
+        MQTTEventCallbackParams_t xEventCallbackParams;
+        const uint8_t * pucHeader = mqttbufferGET_DATA( pxMQTTContext->xRxBuffer );
+        uint32_t ulTopicOffset, ulPropertiesOffset, ulHeaderLength, ulBytes;
+        size_t xProcessedBytes = 0;
+        uint8_t ucQos;
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            MQTTProperties_t xProperties;
+            uint32_t ulPropertiesLength;
+            uint8_t ucPropertiesLengthFieldBytes;
+        #endif /* mqttconfigENABLE_MQTT5 */
+
+        ulTopicOffset = ( uint32_t ) mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_STRING_OFFSET, pxRxMessageState->ucRemaingingLengthFieldBytes );
+        ucQos = mqttPUBLISH_QoS_BITS( pucHeader[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] );
+
+        while( pxRxMessageState->xRxMessageAction == eMQTTRxMessageStream )
+        {
+            if( pxStreamData->pucTopic == NULL )
+            {
+                /* The length of the header is known once the topic
+                 * length has been received. */
+                ulHeaderLength = ulTopicOffset;
+                ulPropertiesOffset = ulTopicOffset;
+
+                if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) >= ulTopicOffset )
+                {
+                    ulHeaderLength += ( ( uint32_t ) pucHeader[ ulTopicOffset - ( uint32_t ) 2 ] << mqttBITS_PER_BYTE ) |
+                                      ( uint32_t ) pucHeader[ ulTopicOffset - ( uint32_t ) 1 ];
+
+                    if( ucQos != ( uint8_t ) eMQTTQoS0 )
+                    {
+                        ulHeaderLength += ( uint32_t ) mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH;
+                    }
+
+                    ulPropertiesOffset = ulHeaderLength;
+
+                    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                        /* The properties follow the packet identifier.
+                         * Their length is known once the property length
+                         * field has been received, until then one more
+                         * byte is asked for. A malformed field makes the
+                         * header longer than any packet. */
+                        if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                        {
+                            ulBytes = ( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) > ulHeaderLength ) ? ( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) - ulHeaderLength ) : ( uint32_t ) 0;
+                            ucPropertiesLengthFieldBytes = prvDecodeVariableByteInteger( &( pucHeader[ ulHeaderLength ] ), ulBytes, &ulPropertiesLength );
+
+                            if( ucPropertiesLengthFieldBytes > ( uint8_t ) 0 )
+                            {
+                                ulHeaderLength += ( uint32_t ) ucPropertiesLengthFieldBytes + ulPropertiesLength;
+                            }
+                            else if( ulBytes < ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES )
+                            {
+                                ulHeaderLength += ulBytes + ( uint32_t ) 1;
+                            }
+                            else
+                            {
+                                ulHeaderLength = pxRxMessageState->ulTotalMessageLength + ( uint32_t ) 1;
+                            }
+                        }
+                    #endif /* mqttconfigENABLE_MQTT5 */
+                }
+
+                if( ( ucQos > ( uint8_t ) eMQTTQoS2 ) || ( ulHeaderLength > pxRxMessageState->ulTotalMessageLength ) )
+                {
+                    /* A publish packet with reserved QoS value or a header
+                     * longer than the packet is considered malformed and
+                     * we disconnect. */
+                    prvResetMQTTContext( pxMQTTContext );
+
+                    /* Inform user about the malformed packet received. */
+                    xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+                    xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
+                    ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                }
+                else if( ulHeaderLength > mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( pxMQTTContext->xRxBuffer ) )
+                {
+                    /* The topic does not fit in the buffer, drop the rest
+                     * of the message. The received length is up to date,
+                     * so the drop continues from here. */
+                    mqttconfigDEBUG_LOG( ( "Topic of the streamed publish message too long.\r\n" ) );
+                    prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+                    pxMQTTContext->xRxBuffer = NULL;
+                    pxRxMessageState->xRxMessageAction = eMQTTRxMessageDrop;
+                }
+                else if( mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) < ulHeaderLength )
+                {
+                    if( xProcessedBytes == xReceivedDataLength )
+                    {
+                        /* Wait for more data. */
+                        break;
+                    }
+
+                    /* Store as much of the header as available. */
+                    ulBytes = ulHeaderLength - mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer );
+
+                    if( ( size_t ) ulBytes > ( xReceivedDataLength - xProcessedBytes ) )
+                    {
+                        ulBytes = ( uint32_t ) ( xReceivedDataLength - xProcessedBytes );
+                    }
+
+                    pxMQTTContext->ulRxMessageReceivedLength += ulBytes;
+                    mqttCOPY_BYTES( pucReceivedData, xProcessedBytes, mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ), ulBytes );
+                }
+                else
+                {
+                    /* The header is complete. */
+                    pxStreamData->xQos = ( MQTTQoS_t ) ucQos;
+                    pxStreamData->pucTopic = &( pucHeader[ ulTopicOffset ] );
+                    pxStreamData->usTopicLength = ( uint16_t ) ( ( ( uint16_t ) pucHeader[ ulTopicOffset - ( uint32_t ) 2 ] << mqttBITS_PER_BYTE ) |
+                                                                 ( uint16_t ) pucHeader[ ulTopicOffset - ( uint32_t ) 1 ] );
+
+                    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                        /* The topic may be replaced with an alias. */
+                        if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) &&
+                            ( ( prvDecodeProperties( &( pucHeader[ ulPropertiesOffset ] ), ulHeaderLength - ulPropertiesOffset, &xProperties ) != ( ulHeaderLength - ulPropertiesOffset ) ) ||
+                              ( prvResolveRxTopicAlias( pxMQTTContext, xProperties.usTopicAlias, &( pxStreamData->pucTopic ), &( pxStreamData->usTopicLength ) ) == eMQTTFalse ) ) )
+                        {
+                            /* Malformed properties - disconnect. */
+                            prvResetMQTTContext( pxMQTTContext );
+
+                            /* Inform user about the malformed packet received. */
+                            xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+                            xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonMalformedPacket;
+                            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                        }
+                        else
+                    #endif /* mqttconfigENABLE_MQTT5 */
+                    {
+                        pxStreamData->ulOffset = 0;
+                        pxStreamData->ulTotalDataLength = pxRxMessageState->ulTotalMessageLength - ulHeaderLength;
+                        pxRxMessageState->usStreamPacketIdentifier = 0;
+                        pxRxMessageState->xStreamDuplicate = eMQTTFalse;
+
+                        if( ucQos != ( uint8_t ) eMQTTQoS0 )
+                        {
+                            pxRxMessageState->usStreamPacketIdentifier = ( uint16_t ) ( ( ( uint16_t ) pucHeader[ ulPropertiesOffset - ( uint32_t ) 2 ] << mqttBITS_PER_BYTE ) |
+                                                                                        ( uint16_t ) pucHeader[ ulPropertiesOffset - ( uint32_t ) 1 ] );
+                        }
+
+                        /* A re-transmission of a QoS2 message which has
+                         * already been passed to the user is only
+                         * acknowledged. The packet identifier of a new one is
+                         * remembered only once the whole message has been
+                         * passed, so that it is passed again in full if the
+                         * client is disconnected before that. */
+                        if( ucQos == ( uint8_t ) eMQTTQoS2 )
+                        {
+                            pxRxMessageState->xStreamDuplicate = prvIsQoS2PublishReceived( pxMQTTContext, pxRxMessageState->usStreamPacketIdentifier );
+                        }
+
+                        /* Pass the topic first. The chunk is empty, but
+                         * pvData is still a valid pointer so that it can be
+                         * passed as is to functions such as memcpy(). */
+                        if( pxRxMessageState->xStreamDuplicate == eMQTTFalse )
+                        {
+                            xEventCallbackParams.xEventType = eMQTTPublishChunk;
+                            xEventCallbackParams.u.xPublishChunkData = *pxStreamData;
+                            xEventCallbackParams.u.xPublishChunkData.pvData = pxStreamData->pucTopic;
+                            xEventCallbackParams.u.xPublishChunkData.ulDataLength = 0;
+                            ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                        }
+                    }
+                }
+            }
+            else if( pxStreamData->ulOffset < pxStreamData->ulTotalDataLength )
+            {
+                if( xProcessedBytes == xReceivedDataLength )
+                {
+                    /* Wait for more data. */
+                    break;
+                }
+
+                /* Pass as much of the message as available, without
+                 * copying it. */
+                ulBytes = pxStreamData->ulTotalDataLength - pxStreamData->ulOffset;
+
+                if( ( size_t ) ulBytes > ( xReceivedDataLength - xProcessedBytes ) )
+                {
+                    ulBytes = ( uint32_t ) ( xReceivedDataLength - xProcessedBytes );
+                }
+
+                if( pxRxMessageState->xStreamDuplicate == eMQTTFalse )
+                {
+                    xEventCallbackParams.xEventType = eMQTTPublishChunk;
+                    xEventCallbackParams.u.xPublishChunkData = *pxStreamData;
+                    xEventCallbackParams.u.xPublishChunkData.pvData = &( pucReceivedData[ xProcessedBytes ] );
+                    xEventCallbackParams.u.xPublishChunkData.ulDataLength = ulBytes;
+                    ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+                }
+
+                pxStreamData->ulOffset += ulBytes;
+                pxMQTTContext->ulRxMessageReceivedLength += ulBytes;
+                xProcessedBytes += ulBytes;
+            }
+            else
+            {
+                /* The whole message has been passed, acknowledge it. If
+                 * we fail to send the acknowledgment, we will receive
+                 * the same publish message again. */
+                if( pxStreamData->xQos == eMQTTQoS1 )
+                {
+                    prvSendPublishAck( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBACK | mqttFLAGS_PUBACK ), pxRxMessageState->usStreamPacketIdentifier );
+                }
+                else if( pxStreamData->xQos == eMQTTQoS2 )
+                {
+                    ( void ) prvIsNewQoS2Publish( pxMQTTContext, pxRxMessageState->usStreamPacketIdentifier );
+                    prvSendPublishAck( pxMQTTContext, ( uint8_t ) ( mqttCONTROL_PUBREC | mqttFLAGS_PUBREC ), pxRxMessageState->usStreamPacketIdentifier );
+                }
+                else
+                {
+                    /* No acknowledgment for QoS0. */
+                }
+
+                /* Reset Rx state to receive next packet. */
+                prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
+                prvResetRxMessageState( pxMQTTContext );
+            }
+        }
+
+        return xProcessedBytes;
+    }
+
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+/*-----------------------------------------------------------*/
+
+static MQTTBool_t prvInvokeCallback( MQTTContext_t * pxMQTTContext,
+                                     MQTTEventCallbackParams_t * pxEventCallbackParams )
+{
+    MQTTBool_t xBufferOwnershipTaken = eMQTTFalse;
+
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+        MQTTBool_t xSubscriptionCallbackInvoked = eMQTTFalse;
+
+        /* In case of a publish message, try to invoke
+         * subscription specific callback first. If the
+         * user has not registered any specific callback
+         * for this topic, invoke the generic one. */
+        if( pxEventCallbackParams->xEventType == eMQTTPublish )
+        {
+            xBufferOwnershipTaken = prvInvokeSubscriptionCallbacks( pxMQTTContext,
+                                                                    &( pxEventCallbackParams->u.xPublishData ),
+                                                                    &( xSubscriptionCallbackInvoked ) );
+        }
+
+        /* Invoke generic callback, if any subscription callback was
+         * not invoked and the user has registered a generic one. Note
+         * that since no callback was invoked, we are sure that the user
+         * has not got any chance to take the buffer ownership. That's
+         * why no check for xBufferOwnershipTaken. */
+        if( ( xSubscriptionCallbackInvoked == eMQTTFalse ) && ( pxMQTTContext->pxCallback != NULL ) )
+        {
+            xBufferOwnershipTaken = pxMQTTContext->pxCallback( pxMQTTContext->pvCallbackContext, pxEventCallbackParams );
+        }
+    #else /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+        /* Invoke the generic callback, if the user has registered one. */
+        if( pxMQTTContext->pxCallback != NULL )
+        {
+            xBufferOwnershipTaken = pxMQTTContext->pxCallback( pxMQTTContext->pvCallbackContext, pxEventCallbackParams );
+        }
+    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+
+    return xBufferOwnershipTaken;
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvWriteString( uint8_t * pucDestination,
+                                 const uint8_t * const pucLastByteInBuffer,
+                                 const uint8_t * const pucString,
+                                 uint16_t usStringLength )
+{
+    uint8_t * pucEndAddress;
+
+    /* Check that writing the string and the two byte length into pucDestination
+     * won't overflow the buffer. */
+    pucEndAddress = &( pucDestination[ mqttSTRLEN( usStringLength ) - ( uint16_t ) 1 ] );
+
+    /* Check the calculated end address against the last address of the Tx
+     * buffer. */
+    if( pucEndAddress <= pucLastByteInBuffer ) /*lint !e946 Pointer comparison is ok as we are checking for memory overflow. */
+    {
+        *pucDestination = ( uint8_t ) ( usStringLength >> mqttBITS_PER_BYTE );
+        pucDestination++;
+        *pucDestination = ( uint8_t ) usStringLength;
+        pucDestination++;
+        memcpy( pucDestination, pucString, usStringLength );
+    }
+    else
+    {
+        /* Writing the string would have overflowed the Tx buffer. */
+        usStringLength = ( uint16_t ) 0;
+    }
+
+    /* Return the address of the byte following the string just copied to the
+     * buffer. */
+    return &( pucDestination[ usStringLength ] );
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t prvSizeOfRemainingLength( uint32_t ulRemainingLength )
+{
+    uint8_t ucRemainingLengthFieldBytes = 0;
+
+    /* Ensure that given length is within the limits of what can be
+     * encoded in 4 bytes. */
+    mqttconfigASSERT( ulRemainingLength <= mqttMAX_REMAINING_LENGTH_LENGTH );
+
+    /* The numbers below are taken from the MQTT protocol spec. */
+    if( ulRemainingLength <= ( uint32_t ) mqttONE_BYTE_MAX_REMAINING_LENGTH )
+    {
+        ucRemainingLengthFieldBytes = 1;
+    }
+    else if( ( ulRemainingLength > ( uint32_t ) mqttONE_BYTE_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttTWO_BYTES_MAX_REMAINING_LENGTH ) )
+    {
+        ucRemainingLengthFieldBytes = 2;
+    }
+    else if( ( ulRemainingLength > ( uint32_t ) mqttTWO_BYTES_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttTHREE_BYTES_MAX_REMAINING_LENGTH ) )
+    {
+        ucRemainingLengthFieldBytes = 3;
+    }
+    else if( ( ulRemainingLength > ( uint32_t ) mqttTHREE_BYTES_MAX_REMAINING_LENGTH ) && ( ulRemainingLength <= ( uint32_t ) mqttMAX_REMAINING_LENGTH_LENGTH ) )
+    {
+        ucRemainingLengthFieldBytes = 4;
+    }
+    else
+    {
+        /* Incorrect remaining length. */
+    }
+
+    return ucRemainingLengthFieldBytes;
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t prvEncodeRemainingLength( uint32_t ulRemainingLength,
+                                         uint8_t * const pucEncodedRemainingLength,
+                                         const uint8_t * const pucLastByteInBuffer )
+{
+    uint8_t ucBytesWritten = 0, ucEncodedByte;
+
+    /* Ensure that given length is within the limits of what can be
+     * encoded in 4 bytes. */
+    mqttconfigASSERT( ulRemainingLength <= mqttMAX_REMAINING_LENGTH_LENGTH );
+
+    do
+    {
+        /* Extract 7 bits from the length. */
+        ucEncodedByte = ( ( uint8_t ) ( ulRemainingLength ) & mqttLENGTH_BITMASK_REMAINING_LENGTH );
+        ulRemainingLength >>= mqttLENGTH_BITS_REMAINING_LENGTH;
+
+        /* If there is more data to encode, set the continuation
+         * bit of this byte. */
+        if( ulRemainingLength > ( uint32_t ) 0 )
+        {
+            ucEncodedByte |= mqttREMAINING_LENGTH_CONTINUATION_BITMASK;
+        }
+
+        /* Ensure that writing this byte will not result in buffer overflow. */
+        mqttconfigASSERT( &( pucEncodedRemainingLength[ ucBytesWritten ] ) <= pucLastByteInBuffer );
+
+        if( &( pucEncodedRemainingLength[ ucBytesWritten ] ) <= pucLastByteInBuffer ) /*lint !e946 Pointer comparison is ok as we are checking for memory overflow. */
+        {
+            /* Write the encoded byte to the provided buffer. */
+            pucEncodedRemainingLength[ ucBytesWritten ] = ucEncodedByte;
+            ucBytesWritten++;
+        }
+        else
+        {
+            /* There is not enough space in the provided buffer. Inform the caller
+             * by returning zero. */
+            ucBytesWritten = 0;
+            break;
+        }
+    } while( ulRemainingLength > ( uint32_t ) 0 );
+
+    return ucBytesWritten;
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemainingLength,
+                                         uint32_t * const pulRemainingLength )
+{
+    uint8_t ucBytesRead, ucDecodedByte;
+    uint32_t x, ulDecodedRemainingLength = 0, ulDecodedByte;
+
+    for( x = 0; x < ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES; x++ )
+    {
+        /* Extract 7 lower bits from the current byte - These bits contain the
+         * actual length information. */
+        ucDecodedByte = ( pucEncodedRemainingLength[ x ] & mqttLENGTH_BITMASK_REMAINING_LENGTH );
+
+        /* Move the extracted bits to their correct location. */
+        ulDecodedByte = ( uint32_t ) ucDecodedByte;
+        ulDecodedByte <<= ( x * ( uint32_t ) mqttLENGTH_BITS_REMAINING_LENGTH );
+
+        /* Place the extracted bits in the decoded length. */
+        ulDecodedRemainingLength |= ulDecodedByte;
+
+        /* If the continuation bit is not set in the current byte, decoding is
+         * complete. */
+        if( ( pucEncodedRemainingLength[ x ] & mqttREMAINING_LENGTH_CONTINUATION_BITMASK ) == ( uint8_t ) 0 )
+        {
+            break;
+        }
+    }
+
+    if( x >= ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES )
+    {
+        /* This would happen in case 4th byte also has continuation bit set.
+         * This indicates a malformed encoded length and we inform the caller by
+         * returning 0. Note that the provided output buffer pulRemainingLength
+         * is not modified in this case. */
+        ucBytesRead = 0;
+    }
+    else
+    {
+        /* The decoding is successful. Inform the user by returning the number
+         * of bytes used in decoding from given encoded length. */
+        ucBytesRead = ( uint8_t ) x + ( uint8_t ) 1;
+
+        /* If the user has provided output buffer, return the decoded length
+         * in it. */
+        if( pulRemainingLength != NULL )
+        {
+            *pulRemainingLength = ulDecodedRemainingLength;
+        }
+    }
+
+    return ucBytesRead;
+}
+/*-----------------------------------------------------------*/
+
+static MQTTReturnCode_t prvPreparePublish( MQTTContext_t * pxMQTTContext,
+                                           const MQTTPublishParams_t * const pxPublishParams,
+                                           MQTTBool_t xCopyPayload,
+                                           MQTTBufferHandle_t * pxBuffer )
+{
+    uint8_t * pucNextByte, * pucLastByteInBuffer, ucRemainingLengthFieldBytes;
+    uint32_t ulRemainingLength, ulTotalMessageLength;
+    uint16_t usTopicLength, usWrittenTopicLength;
+    MQTTBufferHandle_t xBuffer = NULL;
+    MQTTReturnCode_t xReturnCode = eMQTTFailure;
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint32_t ulPropertiesLength = 0;
+        uint16_t usTopicAlias = 0;
+        MQTTBool_t xNewAlias = eMQTTFalse, xUseAlias = eMQTTTrue;
+    #endif /* mqttconfigENABLE_MQTT5 */
+
+    if( pxMQTTContext->xConnectionState != eMQTTConnected )
+    {
+        /* Fail the publish operation immediately, if
+         * MQTT client is not connected. */
+        xReturnCode = eMQTTClientNotConnected;
+    }
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+        /* The broker disconnects a client which sends more QoS1 and
+         * QoS2 messages than it can receive at once. */
+        else if( ( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 ) &&
+                 ( pxPublishParams->xQos != eMQTTQoS0 ) &&
+                 ( prvIsReceiveMaximumReached( pxMQTTContext ) == eMQTTTrue ) )
+        {
+            xReturnCode = eMQTTReceiveMaximumExceeded;
+        }
+    #endif /* mqttconfigENABLE_MQTT5 */
+    else
+    {
+        /* Length of the topic in the actual MQTT message. */
+        usWrittenTopicLength = pxPublishParams->usTopicLength;
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+                    /* A stored message may be re-transmitted on a later
+                     * connection, on which the alias is not valid. */
+                    if( ( pxMQTTContext->pxInflightStore != NULL ) && ( pxPublishParams->xQos != eMQTTQoS0 ) )
+                    {
+                        xUseAlias = eMQTTFalse;
+                    }
+                #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+                if( xUseAlias == eMQTTTrue )
+                {
+                    usTopicAlias = prvGetTxTopicAlias( pxMQTTContext, pxPublishParams->pucTopic, pxPublishParams->usTopicLength, &xNewAlias );
+                }
+
+                /* The topic is left out once the broker knows its alias. */
+                if( ( usTopicAlias != ( uint16_t ) 0 ) && ( xNewAlias == eMQTTFalse ) )
+                {
+                    usWrittenTopicLength = 0;
+                }
+
+                ulPropertiesLength = ( usTopicAlias != ( uint16_t ) 0 ) ? ( uint32_t ) mqttPUBLISH_TOPIC_ALIAS_PROPERTIES_LENGTH : ( uint32_t ) mqttNO_PROPERTIES_LENGTH;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+
+        usTopicLength = mqttSTRLEN( usWrittenTopicLength );
+
+        /* Calculate the "Remaining Length" i.e. length of the packet excluding Fixed Header. */
+        ulRemainingLength = ( uint32_t ) usTopicLength +
+                            ( pxPublishParams->xQos == eMQTTQoS0 ? ( uint32_t ) mqttPUBLISH_QOS0_PACKET_IDENTIFER_LENGTH : ( uint32_t ) mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH ) +
+                            pxPublishParams->ulDataLength;
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            ulRemainingLength += ulPropertiesLength;
+        #endif /* mqttconfigENABLE_MQTT5 */
+
+        /* Calculate the number of bytes occupied by the "Remaining Length" field. */
+        ucRemainingLengthFieldBytes = prvSizeOfRemainingLength( ulRemainingLength );
+
+        /* Make sure that "Remaining Length" is within the permissible limits. */
+        if( ucRemainingLengthFieldBytes > ( uint8_t ) 0 )
+        {
+            /* Calculate total MQTT message length. */
+            ulTotalMessageLength = mqttTOTAL_MESSAGE_LENGTH( ucRemainingLengthFieldBytes, ulRemainingLength );
+
+            /* Try to get a buffer from the free buffer pool. The
+             * payload is left out of it, if it is not to be copied. */
+            xBuffer = prvGetFreeBuffer( pxMQTTContext,
+                                        ( xCopyPayload == eMQTTTrue ) ? ulTotalMessageLength : ( ulTotalMessageLength - pxPublishParams->ulDataLength ) );
+
+            if( xBuffer == NULL )
+            {
+                /* Fail the publish operation immediately, if
+                 * no free buffer is available. */
+                mqttconfigDEBUG_LOG( ( "No free buffer is available to carry out the operation. \r\n" ) );
+                xReturnCode = eMQTTNoFreeBuffer;
+            }
+            else
+            {
+                /* Add the buffer to the Tx buffer list. */
+                mqttbufferLIST_ADD( &( pxMQTTContext->xTxBufferListHead ), xBuffer );
+
+                /* To help debugging only. */
+                memset( mqttbufferGET_DATA( xBuffer ), 0x00, mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( xBuffer ) );
+
+                /* Record time-stamp and store timeout. */
+                mqttbufferGET_PACKET_RECORDED_TICK_COUNT( xBuffer ) = prvGetCurrentTickCount( pxMQTTContext );
+                mqttbufferGET_PACKET_TIMEOUT_TICKS( xBuffer ) = pxPublishParams->ulTimeoutTicks;
+
+                /* Write Control Packet Type. */
+                /*_TODO_ Note!  DUP and RETAIN are all currently all set to 0. */
+                mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] = mqttCONTROL_PUBLISH;
+
+                /* Set QoS. */
+                mqttconfigASSERT( pxPublishParams->xQos == eMQTTQoS0 || pxPublishParams->xQos == eMQTTQoS1 || pxPublishParams->xQos == eMQTTQoS2 );
+                mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] |= ( ( ( uint8_t ) ( pxPublishParams->xQos ) ) << 1 );
+
+                /* Write encoded "Remaining Length" in the fixed header. */
+                pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_REMAINING_LENGTH_OFFSET ] );
+                pucLastByteInBuffer = &( mqttbufferGET_DATA( xBuffer )[ mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( xBuffer ) - ( uint32_t ) 1 ] );
+                ucRemainingLengthFieldBytes = prvEncodeRemainingLength( ulRemainingLength, pucNextByte, pucLastByteInBuffer );
+
+                /* We should have successfully encoded the remaining length field
+                 * as we already have a large enough buffer. */
+                mqttconfigASSERT( ucRemainingLengthFieldBytes == prvSizeOfRemainingLength( ulRemainingLength ) );
+
+                /* Write the topic into the message (part of variable header). */
+                pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_OFFSET, ucRemainingLengthFieldBytes ) ] );
+                pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxPublishParams->pucTopic, usWrittenTopicLength );
+
+                /* Write packet identifier into the message, if it is not QoS0. */
+                if( pxPublishParams->xQos != eMQTTQoS0 )
+                {
+                    /* Write MSB. */
+                    *pucNextByte = ( uint8_t ) ( ( pxPublishParams->usPacketIdentifier ) >> mqttBITS_PER_BYTE );
+                    pucNextByte++;
+
+                    /* Write LSB. */
+                    *pucNextByte = ( uint8_t ) ( pxPublishParams->usPacketIdentifier );
+                    pucNextByte++;
+                }
+
+                #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                    /* Write the properties, which are only the topic
+                     * alias, if any. */
+                    if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                    {
+                        *pucNextByte = ( uint8_t ) ( ulPropertiesLength - ( uint32_t ) mqttNO_PROPERTIES_LENGTH );
+                        pucNextByte++;
+
+                        if( usTopicAlias != ( uint16_t ) 0 )
+                        {
+                            *pucNextByte = mqttPROPERTY_TOPIC_ALIAS;
+                            pucNextByte++;
+                            *pucNextByte = ( uint8_t ) ( usTopicAlias >> mqttBITS_PER_BYTE );
+                            pucNextByte++;
+                            *pucNextByte = ( uint8_t ) ( usTopicAlias );
+                            pucNextByte++;
+                        }
+                    }
+                #endif /* mqttconfigENABLE_MQTT5 */
+
+                /* Write the payload into the message, if asked to. */
+                if( xCopyPayload == eMQTTTrue )
+                {
+                    memcpy( pucNextByte, pxPublishParams->pvData, ( size_t ) pxPublishParams->ulDataLength );
+                }
+                else
+                {
+                    ulTotalMessageLength -= pxPublishParams->ulDataLength;
+                }
+
+                /* Store the packet identifier in TxBuffer also for matching
+                 * ACK later. */
+                mqttbufferGET_PACKET_IDENTIFIER( xBuffer ) = pxPublishParams->usPacketIdentifier;
+
+                /* Update the number of bytes written to the buffer. */
+                mqttbufferGET_DATA_LENGTH( xBuffer ) = ulTotalMessageLength;
+
+                /* MQTT packet created. */
+                xReturnCode = eMQTTSuccess;
+            }
+        }
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+            /* The broker does not learn a new alias from a message
+             * which is not written. It was the last one assigned,
+             * so releasing it keeps the aliases in order. */
+            if( ( xReturnCode != eMQTTSuccess ) && ( xNewAlias == eMQTTTrue ) )
+            {
+                pxMQTTContext->xTxTopicAliases[ usTopicAlias - ( uint16_t ) 1 ].usTopicLength = 0;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+    }
+
+    *pxBuffer = xBuffer;
+
+    return xReturnCode;
+}
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static uint8_t prvDecodeVariableByteInteger( const uint8_t * const pucData,
+                                                 uint32_t ulDataLength,
+                                                 uint32_t * const pulValue )
+    {
+        uint8_t ucBytesRead = 0;
+        uint32_t x, ulValue = 0, ulDecodedByte;
+
+        for( x = 0; ( x < ( uint32_t ) mqttREMAINING_LENGTH_MAX_BYTES ) && ( x < ulDataLength ); x++ )
+        {
+            /* Place the lower 7 bits of the current byte in the value. */
+            ulDecodedByte = ( uint32_t ) ( pucData[ x ] & mqttLENGTH_BITMASK_REMAINING_LENGTH );
+            ulValue |= ulDecodedByte << ( x * ( uint32_t ) mqttLENGTH_BITS_REMAINING_LENGTH );
+
+            /* If the continuation bit is not set in the current byte,
+             * decoding is complete. */
+            if( ( pucData[ x ] & mqttREMAINING_LENGTH_CONTINUATION_BITMASK ) == ( uint8_t ) 0 )
+            {
+                ucBytesRead = ( uint8_t ) x + ( uint8_t ) 1;
+                *pulValue = ulValue;
+                break;
+            }
+        }
+
+        return ucBytesRead;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static uint32_t prvDecodeProperties( const uint8_t * const pucData,
+                                         uint32_t ulDataLength,
+                                         MQTTProperties_t * const pxProperties )
+    {
+        /* Encoding of the value of each property, indexed by the
+         * property identifier. */
+        static const uint8_t ucPropertyTypes[] =
+        {
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_FOUR_BYTES,  mqttPROPERTY_TYPE_STRING,      /* 0x00 - 0x03 */
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_INVALID,     mqttPROPERTY_TYPE_INVALID,     /* 0x04 - 0x07 */
+            mqttPROPERTY_TYPE_STRING,     mqttPROPERTY_TYPE_STRING,     mqttPROPERTY_TYPE_INVALID,     mqttPROPERTY_TYPE_VARIABLE,    /* 0x08 - 0x0B */
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_INVALID,     mqttPROPERTY_TYPE_INVALID,     /* 0x0C - 0x0F */
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_FOUR_BYTES, mqttPROPERTY_TYPE_STRING,      mqttPROPERTY_TYPE_TWO_BYTES,   /* 0x10 - 0x13 */
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_STRING,     mqttPROPERTY_TYPE_STRING,      mqttPROPERTY_TYPE_BYTE,        /* 0x14 - 0x17 */
+            mqttPROPERTY_TYPE_FOUR_BYTES, mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_STRING,      mqttPROPERTY_TYPE_INVALID,     /* 0x18 - 0x1B */
+            mqttPROPERTY_TYPE_STRING,     mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_INVALID,     mqttPROPERTY_TYPE_STRING,      /* 0x1C - 0x1F */
+            mqttPROPERTY_TYPE_INVALID,    mqttPROPERTY_TYPE_TWO_BYTES,  mqttPROPERTY_TYPE_TWO_BYTES,   mqttPROPERTY_TYPE_TWO_BYTES,   /* 0x20 - 0x23 */
+            mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_STRING_PAIR, mqttPROPERTY_TYPE_FOUR_BYTES,  /* 0x24 - 0x27 */
+            mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_BYTE,       mqttPROPERTY_TYPE_BYTE                                        /* 0x28 - 0x2A */
+        };
+        MQTTBool_t xWellFormed = eMQTTFalse;
+        uint32_t x, ulOffset, ulEnd = 0, ulPropertiesLength = 0, ulValueLength, ulValue, ulStrings;
+        uint16_t usValue;
+        uint8_t ucLengthFieldBytes, ucIdentifier, ucType;
+
+        /* Absent properties take their default value. */
+        pxProperties->usReceiveMaximum = ( uint16_t ) 0xFFFF;
+        pxProperties->usTopicAliasMaximum = 0;
+        pxProperties->usTopicAlias = 0;
+
+        /* The properties must fit in the message. */
+        ucLengthFieldBytes = prvDecodeVariableByteInteger( pucData, ulDataLength, &ulPropertiesLength );
+
+        if( ( ucLengthFieldBytes > ( uint8_t ) 0 ) && ( ulPropertiesLength <= ( ulDataLength - ( uint32_t ) ucLengthFieldBytes ) ) )
+        {
+            xWellFormed = eMQTTTrue;
+            ulOffset = ( uint32_t ) ucLengthFieldBytes;
+            ulEnd = ulOffset + ulPropertiesLength;
+
+            while( ( xWellFormed == eMQTTTrue ) && ( ulOffset < ulEnd ) )
+            {
+                ucIdentifier = pucData[ ulOffset ];
+                ulOffset++;
+                ucType = ( ucIdentifier < ( uint8_t ) sizeof( ucPropertyTypes ) ) ? ucPropertyTypes[ ucIdentifier ] : mqttPROPERTY_TYPE_INVALID;
+                ulValueLength = 0;
+
+                if( ( ucType == mqttPROPERTY_TYPE_BYTE ) || ( ucType == mqttPROPERTY_TYPE_TWO_BYTES ) || ( ucType == mqttPROPERTY_TYPE_FOUR_BYTES ) )
+                {
+                    /* The type is the length of the value. */
+                    ulValueLength = ( uint32_t ) ucType;
+                }
+                else if( ucType == mqttPROPERTY_TYPE_VARIABLE )
+                {
+                    ulValueLength = ( uint32_t ) prvDecodeVariableByteInteger( &( pucData[ ulOffset ] ), ulEnd - ulOffset, &ulValue );
+                    xWellFormed = ( ulValueLength > ( uint32_t ) 0 ) ? eMQTTTrue : eMQTTFalse;
+                }
+                else if( ( ucType == mqttPROPERTY_TYPE_STRING ) || ( ucType == mqttPROPERTY_TYPE_STRING_PAIR ) )
+                {
+                    /* Each string is prefixed with its length. */
+                    ulStrings = ( ucType == mqttPROPERTY_TYPE_STRING_PAIR ) ? ( uint32_t ) 2 : ( uint32_t ) 1;
+
+                    for( x = 0; ( x < ulStrings ) && ( xWellFormed == eMQTTTrue ); x++ )
+                    {
+                        if( ( ulEnd - ulOffset ) >= ( ulValueLength + ( uint32_t ) 2 ) )
+                        {
+                            ulValueLength += ( uint32_t ) mqttSTRLEN( ( ( uint32_t ) pucData[ ulOffset + ulValueLength ] << mqttBITS_PER_BYTE ) |
+                                                                      ( uint32_t ) pucData[ ulOffset + ulValueLength + ( uint32_t ) 1 ] );
+                        }
+                        else
+                        {
+                            xWellFormed = eMQTTFalse;
+                        }
+                    }
+                }
+                else
+                {
+                    /* Unknown property identifier. */
+                    xWellFormed = eMQTTFalse;
+                }
+
+                if( ( xWellFormed == eMQTTTrue ) && ( ulValueLength <= ( ulEnd - ulOffset ) ) )
+                {
+                    /* Extract the properties used by the library. */
+                    if( ucType == mqttPROPERTY_TYPE_TWO_BYTES )
+                    {
+                        usValue = ( uint16_t ) ( ( ( uint16_t ) pucData[ ulOffset ] << mqttBITS_PER_BYTE ) | ( uint16_t ) pucData[ ulOffset + ( uint32_t ) 1 ] );
+
+                        if( ucIdentifier == mqttPROPERTY_RECEIVE_MAXIMUM )
+                        {
+                            pxProperties->usReceiveMaximum = usValue;
+                        }
+                        else if( ucIdentifier == mqttPROPERTY_TOPIC_ALIAS_MAXIMUM )
+                        {
+                            pxProperties->usTopicAliasMaximum = usValue;
+                        }
+                        else if( ucIdentifier == mqttPROPERTY_TOPIC_ALIAS )
+                        {
+                            pxProperties->usTopicAlias = usValue;
+                        }
+                        else
+                        {
+                            /* Not used by the library. */
+                        }
+                    }
+
+                    ulOffset += ulValueLength;
+                }
+                else
+                {
+                    /* The property does not fit in the properties. */
+                    xWellFormed = eMQTTFalse;
+                }
+            }
+        }
+
+        return ( xWellFormed == eMQTTTrue ) ? ulEnd : ( uint32_t ) 0;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static MQTTBool_t prvIsReceiveMaximumReached( MQTTContext_t * pxMQTTContext )
+    {
+        Link_t * pxLink;
+        MQTTBufferHandle_t xBuffer;
+        uint8_t ucControlByte;
+        uint32_t ulInFlight = 0;
+
+        /* Count the messages the broker has not completed yet. */
+        listFOR_EACH( pxLink, &( pxMQTTContext->xTxBufferListHead ) )
+        {
+            xBuffer = mqttbufferGET_BUFFER_HANDLE_FROM_LINK( pxLink );
+            ucControlByte = mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ];
+
+            if( ( ( ( ucControlByte & mqttTOP_NIBBLE_MASK ) == mqttCONTROL_PUBLISH ) && ( mqttPUBLISH_QoS_BITS( ucControlByte ) != ( uint8_t ) eMQTTQoS0 ) ) ||
+                ( ucControlByte == ( uint8_t ) ( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL ) ) )
+            {
+                ulInFlight++;
+            }
+        }
+
+        return ( ulInFlight >= ( uint32_t ) pxMQTTContext->usServerReceiveMaximum ) ? eMQTTTrue : eMQTTFalse;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static uint16_t prvGetTxTopicAlias( MQTTContext_t * pxMQTTContext,
+                                        const uint8_t * const pucTopic,
+                                        uint16_t usTopicLength,
+                                        MQTTBool_t * pxNewAlias )
+    {
+        MQTTTopicAlias_t * pxAlias;
+        uint16_t usAlias = 0;
+        uint32_t x, ulAliases;
+
+        *pxNewAlias = eMQTTFalse;
+
+        /* Only as many aliases as both sides accept can be used. */
+        ulAliases = mqttMIN( ( uint32_t ) mqttconfigTOPIC_ALIAS_MAXIMUM, ( uint32_t ) pxMQTTContext->usServerTopicAliasMaximum );
+
+        if( ( usTopicLength > ( uint16_t ) 0 ) && ( usTopicLength <= ( uint16_t ) mqttconfigTOPIC_ALIAS_MAX_TOPIC_LENGTH ) )
+        {
+            /* The aliases are assigned in order and are only released
+             * all together, so the first free one ends the search. */
+            for( x = 0; x < ulAliases; x++ )
+            {
+                pxAlias = &( pxMQTTContext->xTxTopicAliases[ x ] );
+
+                if( pxAlias->usTopicLength == ( uint16_t ) 0 )
+                {
+                    memcpy( pxAlias->ucTopic, pucTopic, ( size_t ) usTopicLength );
+                    pxAlias->usTopicLength = usTopicLength;
+                    *pxNewAlias = eMQTTTrue;
+                    usAlias = ( uint16_t ) x + ( uint16_t ) 1;
+                    break;
+                }
+                else if( ( pxAlias->usTopicLength == usTopicLength ) && ( memcmp( pxAlias->ucTopic, pucTopic, ( size_t ) usTopicLength ) == 0 ) )
+                {
+                    usAlias = ( uint16_t ) x + ( uint16_t ) 1;
+                    break;
+                }
+                else
+                {
+                    /* Alias assigned to another topic. */
+                }
+            }
+        }
+
+        return usAlias;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static MQTTBool_t prvResolveRxTopicAlias( MQTTContext_t * pxMQTTContext,
+                                              uint16_t usTopicAlias,
+                                              const uint8_t ** ppucTopic,
+                                              uint16_t * pusTopicLength )
+    {
+        MQTTTopicAlias_t * pxAlias;
+        MQTTBool_t xResolved = eMQTTFalse;
+
+        if( usTopicAlias == ( uint16_t ) 0 )
+        {
+            /* Without alias, the topic must be present. */
+            if( *pusTopicLength > ( uint16_t ) 0 )
+            {
+                xResolved = eMQTTTrue;
+            }
+        }
+        else if( usTopicAlias <= ( uint16_t ) mqttconfigTOPIC_ALIAS_MAXIMUM )
+        {
+            pxAlias = &( pxMQTTContext->xRxTopicAliases[ usTopicAlias - ( uint16_t ) 1 ] );
+
+            if( *pusTopicLength > ( uint16_t ) 0 )
+            {
+                /* The broker (re)assigns the alias to the topic. A topic
+                 * too long to be remembered leaves the alias unassigned. */
+                if( *pusTopicLength <= ( uint16_t ) mqttconfigTOPIC_ALIAS_MAX_TOPIC_LENGTH )
+                {
+                    memcpy( pxAlias->ucTopic, *ppucTopic, ( size_t ) *pusTopicLength );
+                    pxAlias->usTopicLength = *pusTopicLength;
+                }
+                else
+                {
+                    mqttconfigDEBUG_LOG( ( "Topic of alias %d too long to be remembered.\r\n", usTopicAlias ) );
+                    pxAlias->usTopicLength = 0;
+                }
+
+                xResolved = eMQTTTrue;
+            }
+            else if( pxAlias->usTopicLength > ( uint16_t ) 0 )
+            {
+                *ppucTopic = pxAlias->ucTopic;
+                *pusTopicLength = pxAlias->usTopicLength;
+                xResolved = eMQTTTrue;
+            }
+            else
+            {
+                /* The alias has not been assigned. */
+            }
+        }
+        else
+        {
+            /* The client does not accept this many aliases. */
+        }
+
+        return xResolved;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static void prvProcessReceivedDISCONNECT( MQTTContext_t * pxMQTTContext )
+    {
+        MQTTEventCallbackParams_t xEventCallbackParams;
+
+        mqttconfigDEBUG_LOG( ( "DISCONNECT received.\r\n" ) );
+
+        /* The broker closes the connection after sending the DISCONNECT,
+         * whatever the reason code. */
+        prvResetMQTTContext( pxMQTTContext );
+
+        /* Inform the user about the disconnect. */
+        xEventCallbackParams.xEventType = eMQTTClientDisconnected;
+        xEventCallbackParams.u.xDisconnectData.xDisconnectReason = eMQTTDisconnectReasonBrokerRequest;
+        ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static uint8_t prvConvertCONNACKReasonCode( uint8_t ucReasonCode )
+    {
+        uint8_t ucReturnCode;
+
+        if( ucReasonCode == ( uint8_t ) 0 ) /* Success. */
+        {
+            ucReturnCode = 0;
+        }
+        else if( ucReasonCode < mqttREASON_CODE_FAILURE )
+        {
+            /* Not a valid CONNACK reason code. */
+            ucReturnCode = 0xFF;
+        }
+        else if( ucReasonCode == ( uint8_t ) 0x84 ) /* Unsupported Protocol Version. */
+        {
+            ucReturnCode = 1;
+        }
+        else if( ucReasonCode == ( uint8_t ) 0x85 ) /* Client Identifier not valid. */
+        {
+            ucReturnCode = 2;
+        }
+        else if( ( ucReasonCode == ( uint8_t ) 0x88 ) || ( ucReasonCode == ( uint8_t ) 0x89 ) ) /* Server unavailable or busy. */
+        {
+            ucReturnCode = 3;
+        }
+        else if( ucReasonCode == ( uint8_t ) 0x86 ) /* Bad User Name or Password. */
+        {
+            ucReturnCode = 4;
+        }
+        else
+        {
+            /* All the other failures are reported as not authorized. */
+            ucReturnCode = 5;
+        }
+
+        return ucReturnCode;
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static void prvCompleteRefusedPublish( MQTTContext_t * pxMQTTContext,
+                                           MQTTBufferHandle_t xPublishTxBuffer,
+                                           uint16_t usPacketIdentifier,
+                                           uint8_t ucReasonCode )
+    {
+        MQTTEventCallbackParams_t xEventCallbackParams;
+
+        mqttconfigDEBUG_LOG( ( "Publish %d refused with reason code 0x%02x.\r\n", usPacketIdentifier, ucReasonCode ) );
+
+        /* Inform the user that the exchange is over. */
+        xEventCallbackParams.xEventType = eMQTTPubCOMP;
+        xEventCallbackParams.u.xMQTTPubACKData.usPacketIdentifier = usPacketIdentifier;
+        xEventCallbackParams.u.xMQTTPubACKData.ucReasonCode = ucReasonCode;
+
+        #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+            xEventCallbackParams.u.xMQTTPubACKData.pvPublishData = mqttbufferGET_PUBLISH_DATA( xPublishTxBuffer );
+        #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
+        ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
+
+        #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+            /* The message must not be re-transmitted. */
+            if( pxMQTTContext->pxInflightStore != NULL )
+            {
+                pxMQTTContext->pxInflightStore->pxRemoveFxn( pxMQTTContext->pxInflightStore->pvStoreContext, usPacketIdentifier );
+            }
+        #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
+        /* Return the Tx Buffer to the pool. */
+        prvReturnBuffer( pxMQTTContext, xPublishTxBuffer );
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvInitSubscriptionManager( MQTTSubscriptionManager_t * pxSubscriptionManager )
+    {
+        uint32_t x;
+
+        /* Chain all the nodes in the free list and mark all
+         * the level names as unused. */
+        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES; x++ )
+        {
+            pxSubscriptionManager->xNodes[ x ].usNext = ( uint16_t ) ( x + ( uint32_t ) 1 );
+            pxSubscriptionManager->xLevelNames[ x ].usReferences = 0;
+        }
+
+        pxSubscriptionManager->xNodes[ mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES - 1 ].usNext = mqttSUBSCRIPTION_NO_NODE;
+        pxSubscriptionManager->usFreeNodes = 0;
+
+        /* Empty all the hash chains. */
+        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS; x++ )
+        {
+            pxSubscriptionManager->usBuckets[ x ] = mqttSUBSCRIPTION_NO_NODE;
+        }
+
+        pxSubscriptionManager->usStringPoolUsed = 0;
+        pxSubscriptionManager->usRootPlusChild = mqttSUBSCRIPTION_NO_NODE;
+        pxSubscriptionManager->usRootHashChild = mqttSUBSCRIPTION_NO_NODE;
+
+        /* Set the number of stored subscriptions to zero. */
+        pxSubscriptionManager->ulInUseSubscriptions = 0;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvHashTopicLevel( uint16_t usParent,
+                                       const uint8_t * const pucLevel,
+                                       uint16_t usLevelLength )
+    {
+        uint32_t ulHash = mqttSUBSCRIPTION_FNV_OFFSET_BASIS;
+        uint16_t x;
+
+        /* FNV-1a over the two bytes of the parent node
+         * followed by the level name. */
+        ulHash = ( ulHash ^ ( uint32_t ) ( usParent & ( uint16_t ) 0xFF ) ) * mqttSUBSCRIPTION_FNV_PRIME;
+        ulHash = ( ulHash ^ ( uint32_t ) ( usParent >> mqttBITS_PER_BYTE ) ) * mqttSUBSCRIPTION_FNV_PRIME;
+
+        for( x = 0; x < usLevelLength; x++ )
+        {
+            ulHash = ( ulHash ^ ( uint32_t ) pucLevel[ x ] ) * mqttSUBSCRIPTION_FNV_PRIME;
+        }
+
+        /* Fold the hash into 16 bits. */
+        return ( uint16_t ) ( ulHash ^ ( ulHash >> 16 ) );
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint32_t prvGetTopicLevelEnd( const uint8_t * const pucTopic,
+                                         uint16_t usTopicLength,
+                                         uint32_t ulLevelStart )
+    {
+        uint32_t ulLevelEnd = ulLevelStart;
+
+        /* A level lasts until the next '/' or the end
+         * of the topic. */
+        while( ( ulLevelEnd < ( uint32_t ) usTopicLength ) && ( pucTopic[ ulLevelEnd ] != ( uint8_t ) '/' ) )
+        {
+            ulLevelEnd++;
+        }
+
+        return ulLevelEnd;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t * prvGetWildCardLink( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                          uint16_t usParent,
+                                          uint8_t ucWildCard )
+    {
+        uint16_t * pusLink;
+
+        if( usParent == mqttSUBSCRIPTION_NO_NODE )
+        {
+            /* The wild-card levels of the first level are
+             * linked from the subscription manager itself. */
+            if( ucWildCard == ( uint8_t ) '+' )
+            {
+                pusLink = &( pxSubscriptionManager->usRootPlusChild );
+            }
+            else
+            {
+                pusLink = &( pxSubscriptionManager->usRootHashChild );
+            }
+        }
+        else
+        {
+            if( ucWildCard == ( uint8_t ) '+' )
+            {
+                pusLink = &( pxSubscriptionManager->xNodes[ usParent ].usPlusChild );
+            }
+            else
+            {
+                pusLink = &( pxSubscriptionManager->xNodes[ usParent ].usHashChild );
+            }
+        }
+
+        return pusLink;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvFindNamedTopicNode( const MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                           uint16_t usParent,
+                                           const uint8_t * const pucLevel,
+                                           uint16_t usLevelLength )
+    {
+        const MQTTTopicNode_t * pxNode;
+        const MQTTTopicLevelName_t * pxLevelName;
+        uint16_t usHash, usNode;
+
+        usHash = prvHashTopicLevel( usParent, pucLevel, usLevelLength );
+        usNode = pxSubscriptionManager->usBuckets[ ( uint32_t ) usHash % ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS ];
+
+        /* Walk the hash chain. Only the nodes with the same
+         * parent and hash need a comparison of the names. */
+        while( usNode != mqttSUBSCRIPTION_NO_NODE )
+        {
+            pxNode = &( pxSubscriptionManager->xNodes[ usNode ] );
+
+            if( ( pxNode->usHash == usHash ) && ( pxNode->usParent == usParent ) )
+            {
+                pxLevelName = &( pxSubscriptionManager->xLevelNames[ pxNode->usLevelName ] );
+
+                if( ( pxLevelName->usLength == usLevelLength ) &&
+                    ( memcmp( &( pxSubscriptionManager->ucStringPool[ pxLevelName->usOffset ] ), pucLevel, usLevelLength ) == 0 ) )
+                {
+                    /* Found the level. */
+                    break;
+                }
+            }
+
+            usNode = pxNode->usNext;
+        }
+
+        return usNode;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvFindTopicNode( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                      uint16_t usParent,
+                                      const uint8_t * const pucLevel,
+                                      uint16_t usLevelLength )
+    {
+        uint16_t usNode;
+
+        if( mqttIS_WILD_CARD_LEVEL( pucLevel, usLevelLength ) )
+        {
+            usNode = *( prvGetWildCardLink( pxSubscriptionManager, usParent, pucLevel[ 0 ] ) );
+        }
+        else
+        {
+            usNode = prvFindNamedTopicNode( pxSubscriptionManager, usParent, pucLevel, usLevelLength );
+        }
+
+        return usNode;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvAddTopicNode( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                     uint16_t usParent,
+                                     const uint8_t * const pucLevel,
+                                     uint16_t usLevelLength )
+    {
+        MQTTTopicNode_t * pxNode;
+        uint16_t usNode;
+        uint32_t ulBucket;
+
+        /* Take the first node of the free list. */
+        usNode = pxSubscriptionManager->usFreeNodes;
+
+        if( usNode != mqttSUBSCRIPTION_NO_NODE )
+        {
+            pxNode = &( pxSubscriptionManager->xNodes[ usNode ] );
+
+            if( mqttIS_WILD_CARD_LEVEL( pucLevel, usLevelLength ) )
+            {
+                /* Wild-card levels are linked directly
+                 * from their parent. */
+                pxSubscriptionManager->usFreeNodes = pxNode->usNext;
+                pxNode->usLevelName = mqttSUBSCRIPTION_NO_LEVEL_NAME;
+                pxNode->usHash = 0;
+                pxNode->usNext = mqttSUBSCRIPTION_NO_NODE;
+                *( prvGetWildCardLink( pxSubscriptionManager, usParent, pucLevel[ 0 ] ) ) = usNode;
+            }
+            else
+            {
+                pxNode->usLevelName = prvInternLevelName( pxSubscriptionManager, pucLevel, usLevelLength );
+
+                if( pxNode->usLevelName != mqttSUBSCRIPTION_NO_LEVEL_NAME )
+                {
+                    /* Named levels are added to the head
+                     * of their hash chain. */
+                    pxSubscriptionManager->usFreeNodes = pxNode->usNext;
+                    pxNode->usHash = prvHashTopicLevel( usParent, pucLevel, usLevelLength );
+                    ulBucket = ( uint32_t ) pxNode->usHash % ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS;
+                    pxNode->usNext = pxSubscriptionManager->usBuckets[ ulBucket ];
+                    pxSubscriptionManager->usBuckets[ ulBucket ] = usNode;
+                }
+                else
+                {
+                    /* No space left in the string pool. The
+                     * node is still in the free list. */
+                    usNode = mqttSUBSCRIPTION_NO_NODE;
+                }
+            }
+
+            if( usNode != mqttSUBSCRIPTION_NO_NODE )
+            {
+                pxNode->usParent = usParent;
+                pxNode->usPlusChild = mqttSUBSCRIPTION_NO_NODE;
+                pxNode->usHashChild = mqttSUBSCRIPTION_NO_NODE;
+                pxNode->usReferences = 0;
+                pxNode->xSubscribed = eMQTTFalse;
+                pxNode->pvPublishCallbackContext = NULL;
+                pxNode->pxPublishCallback = NULL;
+
+                /* The parent is now referenced by the new level. */
+                if( usParent != mqttSUBSCRIPTION_NO_NODE )
+                {
+                    pxSubscriptionManager->xNodes[ usParent ].usReferences++;
+                }
+            }
+        }
+
+        return usNode;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvPruneTopicNodes( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                    uint16_t usNode )
+    {
+        MQTTTopicNode_t * pxNode;
+        uint16_t * pusLink;
+        uint16_t usParent;
+
+        while( ( usNode != mqttSUBSCRIPTION_NO_NODE ) &&
+               ( pxSubscriptionManager->xNodes[ usNode ].usReferences == ( uint16_t ) 0 ) )
+        {
+            pxNode = &( pxSubscriptionManager->xNodes[ usNode ] );
+            usParent = pxNode->usParent;
+
+            if( pxNode->usLevelName == mqttSUBSCRIPTION_NO_LEVEL_NAME )
+            {
+                /* Unlink the wild-card level from its parent. */
+                pusLink = prvGetWildCardLink( pxSubscriptionManager, usParent, ( uint8_t ) '+' );
+
+                if( *pusLink != usNode )
+                {
+                    pusLink = prvGetWildCardLink( pxSubscriptionManager, usParent, ( uint8_t ) '#' );
+                }
+
+                *pusLink = mqttSUBSCRIPTION_NO_NODE;
+            }
+            else
+            {
+                /* Unlink the named level from its hash chain. */
+                pusLink = &( pxSubscriptionManager->usBuckets[ ( uint32_t ) pxNode->usHash % ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_HASH_BUCKETS ] );
+
+                while( *pusLink != usNode )
+                {
+                    pusLink = &( pxSubscriptionManager->xNodes[ *pusLink ].usNext );
+                }
+
+                *pusLink = pxNode->usNext;
+
+                prvReleaseLevelName( pxSubscriptionManager, pxNode->usLevelName );
+            }
+
+            /* Return the node to the free list. */
+            pxNode->usNext = pxSubscriptionManager->usFreeNodes;
+            pxSubscriptionManager->usFreeNodes = usNode;
+
+            /* The parent is no longer referenced by this
+             * level, and might not be needed anymore. */
+            if( usParent != mqttSUBSCRIPTION_NO_NODE )
+            {
+                pxSubscriptionManager->xNodes[ usParent ].usReferences--;
+            }
+
+            usNode = usParent;
+        }
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static uint16_t prvInternLevelName( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                        const uint8_t * const pucLevel,
+                                        uint16_t usLevelLength )
+    {
+        MQTTTopicLevelName_t * pxLevelName;
+        uint16_t usLevelName = mqttSUBSCRIPTION_NO_LEVEL_NAME, usFreeLevelName = mqttSUBSCRIPTION_NO_LEVEL_NAME;
+        uint32_t x;
+
+        /* Look for the name among the stored ones, and
+         * remember the first unused entry on the way. */
+        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES; x++ )
+        {
+            pxLevelName = &( pxSubscriptionManager->xLevelNames[ x ] );
+
+            if( pxLevelName->usReferences == ( uint16_t ) 0 )
+            {
+                if( usFreeLevelName == mqttSUBSCRIPTION_NO_LEVEL_NAME )
+                {
+                    usFreeLevelName = ( uint16_t ) x;
+                }
+            }
+            else if( ( pxLevelName->usLength == usLevelLength ) &&
+                     ( memcmp( &( pxSubscriptionManager->ucStringPool[ pxLevelName->usOffset ] ), pucLevel, usLevelLength ) == 0 ) )
+            {
+                /* Share the stored name. */
+                pxLevelName->usReferences++;
+                usLevelName = ( uint16_t ) x;
+                break;
+            }
+            else
+            {
+                /* A different name. */
+            }
+        }
+
+        /* If the name is not stored yet, append it to the
+         * string pool. */
+        if( ( usLevelName == mqttSUBSCRIPTION_NO_LEVEL_NAME ) && ( usFreeLevelName != mqttSUBSCRIPTION_NO_LEVEL_NAME ) )
+        {
+            if( ( ( uint32_t ) pxSubscriptionManager->usStringPoolUsed + ( uint32_t ) usLevelLength ) <= ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE )
+            {
+                pxLevelName = &( pxSubscriptionManager->xLevelNames[ usFreeLevelName ] );
+                pxLevelName->usOffset = pxSubscriptionManager->usStringPoolUsed;
+                pxLevelName->usLength = usLevelLength;
+                pxLevelName->usReferences = 1;
+
+                memcpy( &( pxSubscriptionManager->ucStringPool[ pxLevelName->usOffset ] ), pucLevel, usLevelLength );
+                pxSubscriptionManager->usStringPoolUsed += usLevelLength;
+
+                usLevelName = usFreeLevelName;
+            }
+        }
+
+        return usLevelName;
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static void prvReleaseLevelName( MQTTSubscriptionManager_t * pxSubscriptionManager,
+                                     uint16_t usLevelName )
+    {
+        MQTTTopicLevelName_t * pxLevelName = &( pxSubscriptionManager->xLevelNames[ usLevelName ] );
+        uint16_t usOffset, usLength;
+        uint32_t x;
+
+        pxLevelName->usReferences--;
+
+        if( pxLevelName->usReferences == ( uint16_t ) 0 )
+        {
+            usOffset = pxLevelName->usOffset;
+            usLength = pxLevelName->usLength;
+
+            /* Close the gap left in the string pool. */
+            memmove( &( pxSubscriptionManager->ucStringPool[ usOffset ] ),
+                     &( pxSubscriptionManager->ucStringPool[ usOffset + usLength ] ),
+                     ( size_t ) ( pxSubscriptionManager->usStringPoolUsed - usOffset - usLength ) );
+            pxSubscriptionManager->usStringPoolUsed -= usLength;
+
+            /* Update the names which were stored after it. */
+            for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES; x++ )
+            {
+                if( ( pxSubscriptionManager->xLevelNames[ x ].usReferences != ( uint16_t ) 0 ) &&
+                    ( pxSubscriptionManager->xLevelNames[ x ].usOffset > usOffset ) )
+                {
+                    pxSubscriptionManager->xLevelNames[ x ].usOffset -= usLength;
+                }
+            }
+        }
+    }
+
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+    static MQTTBool_t prvInvokeSubscription( const MQTTTopicNode_t * pxNode,
+                                             const MQTTPublishData_t * pxPublishData,
+                                             MQTTBool_t * pxSubscriptionCallbackInvoked )
+    {
+        MQTTBool_t xBufferOwnershipTaken = eMQTTFalse;
+
+        /* If a subscription with a callback is stored in
+         * the node, invoke the callback. */
+        if( ( pxNode->xSubscribed == eMQTTTrue ) && ( pxNode->pxPublishCallback != NULL ) )
         {
-            *pulRemainingLength = ulDecodedRemainingLength;
+            /* Note that a callback was invoked. */
+            *pxSubscriptionCallbackInvoked = eMQTTTrue;
+
+            /* Invoke callback. */
+            xBufferOwnershipTaken = pxNode->pxPublishCallback( pxNode->pvPublishCallbackContext, pxPublishData );
         }
+
+        return xBufferOwnershipTaken;
     }
 
-    return ucBytesRead;
-}
+#endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 /*-----------------------------------------------------------*/
 
 #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
@@ -1985,71 +4628,86 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                                             void * pvPublishCallbackContext,
                                             MQTTPublishCallback_t pxPublishCallback )
     {
-        uint32_t x;
+        MQTTSubscriptionManager_t * pxSubscriptionManager = &( pxMQTTContext->xSubscriptionManager );
+        MQTTTopicNode_t * pxNode;
+        uint16_t usNode = mqttSUBSCRIPTION_NO_NODE, usChild;
+        uint32_t ulLevelStart = 0, ulLevelEnd;
         MQTTBool_t xSubscriptionStored = eMQTTFalse;
-        MQTTTopicFilterType_t xTopicFilterType;
 
-        /* Is there a free entry in the subscription manager? */
-        if( pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
+        /* Check that the topic name is not empty or too long. */
+        if( ( usTopicLength > ( uint16_t ) 0 ) && ( usTopicLength <= ( uint16_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH ) )
         {
-            /* Check that the topic name is not too long. */
-            if( usTopicLength <= ( uint16_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH )
+            /* Ensure that the topic is not invalid. */
+            if( prvGetTopicFilterType( pucTopic, usTopicLength ) != eMQTTTopicFilterTypeInvalid )
             {
-                /* Ensure that the topic is not invalid. */
-                xTopicFilterType = prvGetTopicFilterType( pucTopic, usTopicLength );
+                xSubscriptionStored = eMQTTTrue;
 
-                if( xTopicFilterType != eMQTTTopicFilterTypeInvalid )
+                /* Walk down the trie one level of the topic filter
+                 * at a time, adding the levels not present yet. */
+                while( ulLevelStart <= ( uint32_t ) usTopicLength )
                 {
-                    /* Ensure that subscription manager does not contain
-                     * an entry for the topic filter already. */
-                    prvRemoveSubscription( pxMQTTContext, pucTopic, usTopicLength );
+                    ulLevelEnd = prvGetTopicLevelEnd( pucTopic, usTopicLength, ulLevelStart );
+                    usChild = prvFindTopicNode( pxSubscriptionManager,
+                                                usNode,
+                                                &( pucTopic[ ulLevelStart ] ),
+                                                ( uint16_t ) ( ulLevelEnd - ulLevelStart ) );
 
-                    /* Find a free entry in the subscription manager. */
-                    for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+                    if( usChild == mqttSUBSCRIPTION_NO_NODE )
                     {
-                        if( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTFalse )
+                        usChild = prvAddTopicNode( pxSubscriptionManager,
+                                                   usNode,
+                                                   &( pucTopic[ ulLevelStart ] ),
+                                                   ( uint16_t ) ( ulLevelEnd - ulLevelStart ) );
+
+                        if( usChild == mqttSUBSCRIPTION_NO_NODE )
                         {
-                            /* Found a free entry. Mark it as used and
-                             * store the subscription. */
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTTrue;
-
-                            /* Store the subscription. */
-                            memcpy( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter,
-                                    pucTopic,
-                                    usTopicLength );
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength = usTopicLength;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pvPublishCallbackContext = pvPublishCallbackContext;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].pxPublishCallback = pxPublishCallback;
-                            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType = xTopicFilterType;
-
-                            /* Increase the in-use subscription entries count. */
-                            pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions += ( uint32_t ) 1;
-
-                            /* Inform the user that the subscription was stored
-                             * successfully. */
-                            xSubscriptionStored = eMQTTTrue;
-
-                            /* Done. */
+                            xSubscriptionStored = eMQTTFalse;
                             break;
                         }
                     }
+
+                    usNode = usChild;
+                    ulLevelStart = ulLevelEnd + ( uint32_t ) 1;
+                }
+
+                if( xSubscriptionStored == eMQTTTrue )
+                {
+                    pxNode = &( pxSubscriptionManager->xNodes[ usNode ] );
+
+                    /* A subscription already stored for the same
+                     * topic filter is replaced. */
+                    if( pxNode->xSubscribed == eMQTTFalse )
+                    {
+                        pxNode->xSubscribed = eMQTTTrue;
+                        pxNode->usReferences++;
+
+                        /* Increase the stored subscriptions count. */
+                        pxSubscriptionManager->ulInUseSubscriptions += ( uint32_t ) 1;
+                    }
+
+                    /* Store the subscription. */
+                    pxNode->pvPublishCallbackContext = pvPublishCallbackContext;
+                    pxNode->pxPublishCallback = pxPublishCallback;
                 }
                 else
                 {
-                    /* The provided topic filter is invalid. */
-                    mqttconfigDEBUG_LOG( ( "WARN: The topic filter is invalid.\r\n" ) );
+                    /* Remove the levels added for this topic filter. */
+                    prvPruneTopicNodes( pxSubscriptionManager, usNode );
+
+                    /* Subscription Manager full. */
+                    mqttconfigDEBUG_LOG( ( "WARN: Subscription Manager full! No space left to store new subscriptions.\r\n" ) );
                 }
             }
             else
             {
-                /* Topic too long. */
-                mqttconfigDEBUG_LOG( ( "WARN: Topic is too long and cannot be stored in the subscription manager. Consider increasing mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH.\r\n" ) );
+                /* The provided topic filter is invalid. */
+                mqttconfigDEBUG_LOG( ( "WARN: The topic filter is invalid.\r\n" ) );
             }
         }
         else
         {
-            /* Subscription Manager full. */
-            mqttconfigDEBUG_LOG( ( "WARN: Subscription Manager full! No space left to store new subscriptions.\r\n" ) );
+            /* Topic too long. */
+            mqttconfigDEBUG_LOG( ( "WARN: Topic is too long and cannot be stored in the subscription manager. Consider increasing mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_LENGTH.\r\n" ) );
         }
 
         return xSubscriptionStored;
@@ -2064,28 +4722,45 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                                        const uint8_t * const pucTopic,
                                        uint16_t usTopicLength )
     {
-        uint32_t x;
+        MQTTSubscriptionManager_t * pxSubscriptionManager = &( pxMQTTContext->xSubscriptionManager );
+        MQTTTopicNode_t * pxNode;
+        uint16_t usNode = mqttSUBSCRIPTION_NO_NODE;
+        uint32_t ulLevelStart = 0, ulLevelEnd;
 
-        /* Iterate over all the subscription entries in
-         * the subscription manager and try to find the
-         * matching one. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+        /* Follow the levels of the topic filter. */
+        while( ulLevelStart <= ( uint32_t ) usTopicLength )
         {
-            if( ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTTrue ) &&
-                ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength == usTopicLength ) )
+            ulLevelEnd = prvGetTopicLevelEnd( pucTopic, usTopicLength, ulLevelStart );
+            usNode = prvFindTopicNode( pxSubscriptionManager,
+                                       usNode,
+                                       &( pucTopic[ ulLevelStart ] ),
+                                       ( uint16_t ) ( ulLevelEnd - ulLevelStart ) );
+
+            if( usNode == mqttSUBSCRIPTION_NO_NODE )
             {
-                if( memcmp( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter, pucTopic, usTopicLength ) == 0 )
-                {
-                    /* Found a matching subscription, mark it as free. */
-                    pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
+                break;
+            }
 
-                    /* Reduce the count of in-use subscription entries
-                     * in the subscription manager. */
-                    pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions -= ( uint32_t ) 1;
+            ulLevelStart = ulLevelEnd + ( uint32_t ) 1;
+        }
 
-                    /* Done. */
-                    break;
-                }
+        if( usNode != mqttSUBSCRIPTION_NO_NODE )
+        {
+            pxNode = &( pxSubscriptionManager->xNodes[ usNode ] );
+
+            if( pxNode->xSubscribed == eMQTTTrue )
+            {
+                /* Found a matching subscription, remove it. */
+                pxNode->xSubscribed = eMQTTFalse;
+                pxNode->pvPublishCallbackContext = NULL;
+                pxNode->pxPublishCallback = NULL;
+                pxNode->usReferences--;
+
+                /* Reduce the stored subscriptions count. */
+                pxSubscriptionManager->ulInUseSubscriptions -= ( uint32_t ) 1;
+
+                /* Return the levels no longer used to the free list. */
+                prvPruneTopicNodes( pxSubscriptionManager, usNode );
             }
         }
     }
@@ -2100,6 +4775,7 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
     {
         uint8_t ucRemaingingLengthFieldBytes;
         uint16_t usTopicLength;
+        uint32_t ulTopicOffset;
 
         /* Get the number of bytes "Remaining Length" field spans
          * from the subscribe or unsubscribe Tx buffer. */
@@ -2114,15 +4790,24 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
          * happens to be at the same offset in both subscribe
          * and unsubscribe message and therefore there is no need
          * to repeat the same code with different #defines. */
-        usTopicLength = ( uint8_t ) ( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttSUBSCRIBE_TOPIC_OFFSET,
-                                                                                        ucRemaingingLengthFieldBytes ) ] );
+        ulTopicOffset = mqttADJUST_OFFSET( mqttSUBSCRIBE_TOPIC_OFFSET, ucRemaingingLengthFieldBytes );
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+            /* Skip the empty property list. */
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                ulTopicOffset += ( uint32_t ) mqttNO_PROPERTIES_LENGTH;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+
+        usTopicLength = ( uint8_t ) ( mqttbufferGET_DATA( xBuffer )[ ulTopicOffset ] );
         usTopicLength <<= mqttBITS_PER_BYTE;
-        usTopicLength |= ( uint8_t ) ( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( ( mqttSUBSCRIBE_TOPIC_OFFSET + 1 ),
-                                                                                         ucRemaingingLengthFieldBytes ) ] );
+        usTopicLength |= ( uint8_t ) ( mqttbufferGET_DATA( xBuffer )[ ulTopicOffset + ( uint32_t ) 1 ] );
 
         /* Remove the subscription entry from the subscription manager. */
         prvRemoveSubscription( pxMQTTContext,
-                               &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( ( mqttSUBSCRIBE_TOPIC_OFFSET + 2 ), ucRemaingingLengthFieldBytes ) ] ),
+                               &( mqttbufferGET_DATA( xBuffer )[ ulTopicOffset + ( uint32_t ) 2 ] ),
                                usTopicLength );
     }
 #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
@@ -2134,88 +4819,168 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
                                                       const MQTTPublishData_t * pxPublishData,
                                                       MQTTBool_t * pxSubscriptionCallbackInvoked )
     {
+        MQTTSubscriptionManager_t * pxSubscriptionManager = &( pxMQTTContext->xSubscriptionManager );
+        const uint8_t * const pucTopic = pxPublishData->pucTopic;
+        uint16_t usTopicLength = pxPublishData->usTopicLength;
         MQTTBool_t xBufferOwnershipTaken = eMQTTFalse;
-        MQTTSubscription_t * pxSubscription;
-        uint32_t x;
+        uint16_t usNode, usChild, usParent;
+        uint32_t ulLevelStart, ulLevelEnd, ulNextLevel, ulWildCards;
 
         /* Set the output parameter to eMQTTFalse. It will
          * be set to eMQTTTrue if any callback is invoked. */
         *pxSubscriptionCallbackInvoked = eMQTTFalse;
 
-        /* Iterate over the subscription entries containing topic filters
-         * without any wild-cards and invoke the registered callbacks. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+        if( usTopicLength > ( uint16_t ) 0 )
         {
-            if( ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTTrue ) &&
-                ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType == eMQTTTopicFilterTypeSimple ) &&
-                ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength == pxPublishData->usTopicLength ) )
+            /* Follow the levels of the topic through the named
+             * levels of the trie, to find the topic filter without
+             * wild-cards which matches the topic exactly. */
+            usNode = mqttSUBSCRIPTION_NO_NODE;
+            ulNextLevel = 0;
+
+            while( ulNextLevel <= ( uint32_t ) usTopicLength )
             {
-                if( memcmp( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter, pxPublishData->pucTopic, pxPublishData->usTopicLength ) == 0 )
+                ulLevelEnd = prvGetTopicLevelEnd( pucTopic, usTopicLength, ulNextLevel );
+                usNode = prvFindNamedTopicNode( pxSubscriptionManager,
+                                                usNode,
+                                                &( pucTopic[ ulNextLevel ] ),
+                                                ( uint16_t ) ( ulLevelEnd - ulNextLevel ) );
+
+                if( usNode == mqttSUBSCRIPTION_NO_NODE )
                 {
-                    /* Found a matching subscription. */
-                    pxSubscription = &( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ] );
+                    break;
+                }
 
-                    /* If a callback is registered with the subscription,
-                     * invoke it. */
-                    if( pxSubscription->pxPublishCallback != NULL )
-                    {
-                        /* Note that a callback was invoked. */
-                        *pxSubscriptionCallbackInvoked = eMQTTTrue;
+                ulNextLevel = ulLevelEnd + ( uint32_t ) 1;
+            }
 
-                        /* Invoke callback. */
-                        xBufferOwnershipTaken = pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, pxPublishData );
+            if( usNode != mqttSUBSCRIPTION_NO_NODE )
+            {
+                xBufferOwnershipTaken = prvInvokeSubscription( &( pxSubscriptionManager->xNodes[ usNode ] ),
+                                                               pxPublishData,
+                                                               pxSubscriptionCallbackInvoked );
+            }
 
-                        /* If the user takes the buffer ownership, do
-                         * not invoke any other callbacks. */
-                        if( xBufferOwnershipTaken == eMQTTTrue )
-                        {
-                            break;
-                        }
+            /* If the user has not taken the buffer ownership yet, visit
+             * all the paths through the trie which match the topic and
+             * invoke the callbacks of the topic filters with wild-cards.
+             * The trie is walked depth first using the parent links, so
+             * no stack is needed. ulLevelStart and ulNextLevel are the
+             * offsets of the level of the current node and of the level
+             * after it, the latter being beyond the end of the topic if
+             * the current node matches the last level. ulWildCards counts
+             * the '+' levels on the path to the current node. */
+            usNode = mqttSUBSCRIPTION_NO_NODE;
+            ulLevelStart = 0;
+            ulNextLevel = 0;
+            ulWildCards = 0;
+
+            while( xBufferOwnershipTaken == eMQTTFalse )
+            {
+                /* A '#' level below the current node matches all the
+                 * remaining levels of the topic. If there are none left,
+                 * it matches the parent level as "sport/#" also matches
+                 * "sport". */
+                usChild = *( prvGetWildCardLink( pxSubscriptionManager, usNode, ( uint8_t ) '#' ) );
+
+                if( usChild != mqttSUBSCRIPTION_NO_NODE )
+                {
+                    xBufferOwnershipTaken = prvInvokeSubscription( &( pxSubscriptionManager->xNodes[ usChild ] ),
+                                                                   pxPublishData,
+                                                                   pxSubscriptionCallbackInvoked );
+                }
+
+                /* A topic filter ending at the current node matches if
+                 * all the levels of the topic are consumed. The ones
+                 * without wild-cards were invoked above already. */
+                if( ( xBufferOwnershipTaken == eMQTTFalse ) &&
+                    ( ulNextLevel > ( uint32_t ) usTopicLength ) &&
+                    ( ulWildCards > ( uint32_t ) 0 ) )
+                {
+                    xBufferOwnershipTaken = prvInvokeSubscription( &( pxSubscriptionManager->xNodes[ usNode ] ),
+                                                                   pxPublishData,
+                                                                   pxSubscriptionCallbackInvoked );
+                }
+
+                if( xBufferOwnershipTaken == eMQTTTrue )
+                {
+                    break;
+                }
+
+                /* Go down to the '+' level below the current node, or
+                 * else to the named level matching the next level of
+                 * the topic. */
+                usChild = mqttSUBSCRIPTION_NO_NODE;
+
+                if( ulNextLevel <= ( uint32_t ) usTopicLength )
+                {
+                    ulLevelEnd = prvGetTopicLevelEnd( pucTopic, usTopicLength, ulNextLevel );
+                    usChild = *( prvGetWildCardLink( pxSubscriptionManager, usNode, ( uint8_t ) '+' ) );
+
+                    if( usChild != mqttSUBSCRIPTION_NO_NODE )
+                    {
+                        ulWildCards++;
+                    }
+                    else
+                    {
+                        usChild = prvFindNamedTopicNode( pxSubscriptionManager,
+                                                         usNode,
+                                                         &( pucTopic[ ulNextLevel ] ),
+                                                         ( uint16_t ) ( ulLevelEnd - ulNextLevel ) );
+                    }
+
+                    if( usChild != mqttSUBSCRIPTION_NO_NODE )
+                    {
+                        ulLevelStart = ulNextLevel;
+                        ulNextLevel = ulLevelEnd + ( uint32_t ) 1;
                     }
                 }
-            }
-        }
 
-        /* If the user has not taken the buffer ownership yet (which can
-         * happen if there is no exact matching entry in the subscription
-         * manager or the user does not take the ownership in the callback),
-         * iterate over the subscription entries containing topic filters
-         * with wild-cards and invoke the registered callbacks for the ones
-         * which match the topic. */
-        if( xBufferOwnershipTaken == eMQTTFalse )
-        {
-            for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
-            {
-                if( ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse == eMQTTTrue ) &&
-                    ( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xTopicFilterType == eMQTTTopicFilterTypeWildCard ) )
+                /* Otherwise go back up until a level is found whose
+                 * named sibling has not been visited yet. */
+                while( ( usChild == mqttSUBSCRIPTION_NO_NODE ) && ( usNode != mqttSUBSCRIPTION_NO_NODE ) )
                 {
-                    if( prvDoesTopicMatchTopicFilter( pxPublishData->pucTopic,
-                                                      pxPublishData->usTopicLength,
-                                                      pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].ucTopicFilter,
-                                                      pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].usTopicFilterLength ) == eMQTTTrue )
+                    usParent = pxSubscriptionManager->xNodes[ usNode ].usParent;
+
+                    if( usNode == *( prvGetWildCardLink( pxSubscriptionManager, usParent, ( uint8_t ) '+' ) ) )
                     {
-                        /* Found a matching subscription. */
-                        pxSubscription = &( pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ] );
+                        /* The named sibling of a '+' level matches the
+                         * same level of the topic. */
+                        ulWildCards--;
+                        usChild = prvFindNamedTopicNode( pxSubscriptionManager,
+                                                         usParent,
+                                                         &( pucTopic[ ulLevelStart ] ),
+                                                         ( uint16_t ) ( ulNextLevel - ( uint32_t ) 1 - ulLevelStart ) );
+                    }
 
-                        /* If a callback is registered with the subscription,
-                         * invoke it. */
-                        if( pxSubscription->pxPublishCallback != NULL )
-                        {
-                            /* Note that a callback was invoked. */
-                            *pxSubscriptionCallbackInvoked = eMQTTTrue;
+                    if( usChild == mqttSUBSCRIPTION_NO_NODE )
+                    {
+                        /* The level of the parent ends just before
+                         * the level of the current node. */
+                        ulNextLevel = ulLevelStart;
 
-                            /* Invoke callback. */
-                            xBufferOwnershipTaken = pxSubscription->pxPublishCallback( pxSubscription->pvPublishCallbackContext, pxPublishData );
+                        if( ulLevelStart > ( uint32_t ) 0 )
+                        {
+                            ulLevelStart--;
 
-                            /* If the user takes the buffer ownership, do
-                             * not invoke any other callbacks. */
-                            if( xBufferOwnershipTaken == eMQTTTrue )
+                            while( ( ulLevelStart > ( uint32_t ) 0 ) && ( pucTopic[ ulLevelStart - ( uint32_t ) 1 ] != ( uint8_t ) '/' ) )
                             {
-                                break;
+                                ulLevelStart--;
                             }
                         }
+
+                        usNode = usParent;
                     }
                 }
+
+                if( usChild == mqttSUBSCRIPTION_NO_NODE )
+                {
+                    /* Back at the first level, all the matching paths
+                     * have been visited. */
+                    break;
+                }
+
+                usNode = usChild;
             }
         }
 
@@ -2422,10 +5187,6 @@ static uint8_t prvDecodeRemainingLength( const uint8_t * const pucEncodedRemaini
 MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
                             const MQTTInitParams_t * const pxInitParams )
 {
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
-        uint32_t x;
-    #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
-
     /* These are checked here once and are later used without
      * NULL checks. */
     mqttconfigASSERT( pxMQTTContext != NULL );
@@ -2451,23 +5212,48 @@ MQTTReturnCode_t MQTT_Init( MQTTContext_t * pxMQTTContext,
     pxMQTTContext->pvSendContext = pxInitParams->pvSendContext;
     pxMQTTContext->pxMQTTSendFxn = pxInitParams->pxMQTTSendFxn;
 
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        pxMQTTContext->pxMQTTSendVectoredFxn = pxInitParams->pxMQTTSendVectoredFxn;
+    #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
     /* Store get ticks function. */
     pxMQTTContext->pxGetTicksFxn = pxInitParams->pxGetTicksFxn;
 
     /* Store buffer pool interface. */
     pxMQTTContext->xBufferPoolInterface = pxInitParams->xBufferPoolInterface;
 
-    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    /* No QoS2 publish message has been received yet. */
+    memset( pxMQTTContext->usQoS2ReceivedPacketIdentifiers, 0x00, sizeof( pxMQTTContext->usQoS2ReceivedPacketIdentifiers ) );
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+        /* Store the protocol version. The limits of the broker
+         * are only known once connected. */
+        pxMQTTContext->xProtocolVersion = pxInitParams->xProtocolVersion;
+        pxMQTTContext->usServerReceiveMaximum = 0xFFFF;
+        pxMQTTContext->usServerTopicAliasMaximum = 0;
+        memset( pxMQTTContext->xTxTopicAliases, 0x00, sizeof( pxMQTTContext->xTxTopicAliases ) );
+        memset( pxMQTTContext->xRxTopicAliases, 0x00, sizeof( pxMQTTContext->xRxTopicAliases ) );
+    #endif /* mqttconfigENABLE_MQTT5 */
+
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+        /* Store in-flight store interface. */
+        pxMQTTContext->pxInflightStore = pxInitParams->pxInflightStore;
 
-        /* Mark all the subscription entires in the subscription
-         * manager as free. */
-        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS; x++ )
+        if( pxMQTTContext->pxInflightStore != NULL )
         {
-            pxMQTTContext->xSubscriptionManager.xSubscriptions[ x ].xInUse = eMQTTFalse;
+            mqttconfigASSERT( pxMQTTContext->pxInflightStore->pxPutFxn != NULL );
+            mqttconfigASSERT( pxMQTTContext->pxInflightStore->pxRemoveFxn != NULL );
+            mqttconfigASSERT( pxMQTTContext->pxInflightStore->pxGetFxn != NULL );
         }
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
 
-        /* Set the number of in-use subscription entries to zero. */
-        pxMQTTContext->xSubscriptionManager.ulInUseSubscriptions = 0;
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+
+        /* Remove all the subscriptions from the subscription
+         * manager. */
+        prvInitSubscriptionManager( &( pxMQTTContext->xSubscriptionManager ) );
     #endif /* mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT */
 
     return eMQTTSuccess;
@@ -2482,6 +5268,11 @@ MQTTReturnCode_t MQTT_Connect( MQTTContext_t * pxMQTTContext,
     uint16_t usClientIdLength, usUserNameLength;
     MQTTBufferHandle_t xBuffer = NULL;
     MQTTReturnCode_t xReturnCode = eMQTTFailure;
+
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        uint8_t ucProperties[ mqttCONNECT_PROPERTIES_LENGTH + mqttCONNECT_PERSISTENT_SESSION_PROPERTY_LENGTH ];
+        uint32_t ulPropertiesLength = 0;
+    #endif /* mqttconfigENABLE_MQTT5 */
     static const uint8_t ucDefaultConnectVariableHeader[] =
     {
         0,                              /* Protocol name length MSB. */
@@ -2491,7 +5282,7 @@ MQTTReturnCode_t MQTT_Connect( MQTTContext_t * pxMQTTContext,
         ( uint8_t ) 'T',                /* Protocol name byte 2. */
         ( uint8_t ) 'T',                /* Protocol name byte 3. */
         mqttPROTOCOL_LEVEL,             /* Protocol level. */
-        mqttCONNECT_CLEAN_SESSION_FLAG, /* AWS IoT Broker does not support persistent sessions i.e. Clean Session flag must be set. */
+        mqttCONNECT_CLEAN_SESSION_FLAG, /* Cleared below if the user requests a persistent session. */
         ( uint8_t ) 0,                  /* Keep-alive time in seconds MSB. */
         ( uint8_t ) 0,                  /* Keep-alive time in seconds LSB. */
     };
@@ -2527,6 +5318,39 @@ MQTTReturnCode_t MQTT_Connect( MQTTContext_t * pxMQTTContext,
                             ( uint32_t ) usClientIdLength +
                             ( uint32_t ) usUserNameLength;
 
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                /* The Receive Maximum is the number of QoS2 messages which
+                 * can be de-duplicated, so that the broker never has more
+                 * QoS1 and QoS2 messages in flight than that. */
+                ucProperties[ 1 ] = mqttPROPERTY_RECEIVE_MAXIMUM;
+                ucProperties[ 2 ] = ( uint8_t ) ( ( uint16_t ) mqttconfigMAX_QOS2_RECEIVED_PUBLISHES >> mqttBITS_PER_BYTE );
+                ucProperties[ 3 ] = ( uint8_t ) ( mqttconfigMAX_QOS2_RECEIVED_PUBLISHES );
+                ucProperties[ 4 ] = mqttPROPERTY_TOPIC_ALIAS_MAXIMUM;
+                ucProperties[ 5 ] = ( uint8_t ) ( ( uint16_t ) mqttconfigTOPIC_ALIAS_MAXIMUM >> mqttBITS_PER_BYTE );
+                ucProperties[ 6 ] = ( uint8_t ) ( mqttconfigTOPIC_ALIAS_MAXIMUM );
+                ulPropertiesLength = ( uint32_t ) mqttCONNECT_PROPERTIES_LENGTH;
+
+                /* An MQTT 5 session ends with the connection, unless
+                 * it is given an expiry interval. The maximum value
+                 * means that it never expires. */
+                if( pxConnectParams->xPersistentSession == eMQTTTrue )
+                {
+                    ucProperties[ 7 ] = mqttPROPERTY_SESSION_EXPIRY_INTERVAL;
+                    ucProperties[ 8 ] = ( uint8_t ) 0xFF;
+                    ucProperties[ 9 ] = ( uint8_t ) 0xFF;
+                    ucProperties[ 10 ] = ( uint8_t ) 0xFF;
+                    ucProperties[ 11 ] = ( uint8_t ) 0xFF;
+                    ulPropertiesLength += ( uint32_t ) mqttCONNECT_PERSISTENT_SESSION_PROPERTY_LENGTH;
+                }
+
+                /* The property length field does not count itself. */
+                ucProperties[ 0 ] = ( uint8_t ) ( ulPropertiesLength - ( uint32_t ) 1 );
+                ulRemainingLength += ulPropertiesLength;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+
         /* Calculate the number of bytes occupied by the "Remaining Length" field. */
         ucRemainingLengthFieldBytes = prvSizeOfRemainingLength( ulRemainingLength );
 
@@ -2574,6 +5398,13 @@ MQTTReturnCode_t MQTT_Connect( MQTTContext_t * pxMQTTContext,
                 pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttVARIABLE_LENGTH_HEADER_START_OFFSET, ucRemainingLengthFieldBytes ) ] );
                 memcpy( pucNextByte, ucDefaultConnectVariableHeader, sizeof( ucDefaultConnectVariableHeader ) );
 
+                /* Clear the clean session flag, if the broker should
+                 * keep the session. */
+                if( pxConnectParams->xPersistentSession == eMQTTTrue )
+                {
+                    mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttCONNECT_FLAGS_OFFSET, ucRemainingLengthFieldBytes ) ] &= ( uint8_t ) ~mqttCONNECT_CLEAN_SESSION_FLAG;
+                }
+
                 /* Update the user name flag. */
                 if( pxConnectParams->usUserNameLength > ( uint16_t ) 0 )
                 {
@@ -2588,6 +5419,19 @@ MQTTReturnCode_t MQTT_Connect( MQTTContext_t * pxMQTTContext,
 
                 /* Write the client ID into the payload. */
                 pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttCONNECT_CLIENT_ID_OFFSET, ucRemainingLengthFieldBytes ) ] );
+
+                #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                    /* The properties come between the variable header
+                     * and the payload. */
+                    if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                    {
+                        mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttCONNECT_PROTOCOL_LEVEL_OFFSET, ucRemainingLengthFieldBytes ) ] = mqttPROTOCOL_LEVEL_MQTT5;
+                        memcpy( pucNextByte, ucProperties, ulPropertiesLength );
+                        pucNextByte = &( pucNextByte[ ulPropertiesLength ] );
+                    }
+                #endif /* mqttconfigENABLE_MQTT5 */
+
                 pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxConnectParams->pucClientId, pxConnectParams->usClientIdLength );
 
                 /* Write the user name into the payload. */
@@ -2734,6 +5578,13 @@ MQTTReturnCode_t MQTT_Subscribe( MQTTContext_t * pxMQTTContext,
                                 ( uint32_t ) usTopicLength +
                                 ( uint32_t ) mqttSUBSCRIBE_REQUESTED_QOS_LENGTH;
 
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                {
+                    ulRemainingLength += ( uint32_t ) mqttNO_PROPERTIES_LENGTH;
+                }
+            #endif /* mqttconfigENABLE_MQTT5 */
+
             /* Calculate the number of bytes occupied by the "Remaining Length" field. */
             ucRemainingLengthFieldBytes = prvSizeOfRemainingLength( ulRemainingLength );
 
@@ -2786,6 +5637,17 @@ MQTTReturnCode_t MQTT_Subscribe( MQTTContext_t * pxMQTTContext,
 
                     /* Write the topic into the message. */
                     pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttSUBSCRIBE_TOPIC_OFFSET, ucRemainingLengthFieldBytes ) ] );
+
+                    #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                        /* No properties precede the topic. */
+                        if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                        {
+                            *pucNextByte = 0;
+                            pucNextByte = &( pucNextByte[ mqttNO_PROPERTIES_LENGTH ] );
+                        }
+                    #endif /* mqttconfigENABLE_MQTT5 */
+
                     pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxSubscribeParams->pucTopic, pxSubscribeParams->usTopicLength );
 
                     /* Write the Requested QoS into the message. */
@@ -2871,6 +5733,13 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
          * excluding fixed header. */
         ulRemainingLength = ( uint32_t ) mqttUNSUBSCRIBE_PACKET_IDENTIFER_LENGTH + ( uint32_t ) usTopicLength;
 
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+            if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+            {
+                ulRemainingLength += ( uint32_t ) mqttNO_PROPERTIES_LENGTH;
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
+
         /* Calculate the number of bytes occupied by the "Remaining Length" field. */
         ucRemainingLengthFieldBytes = prvSizeOfRemainingLength( ulRemainingLength );
 
@@ -2923,6 +5792,17 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
 
                 /* Write the topic into the message. */
                 pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttUNSUBSCRIBE_TOPIC_OFFSET, ucRemainingLengthFieldBytes ) ] );
+
+                #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                    /* No properties precede the topic. */
+                    if( pxMQTTContext->xProtocolVersion == eMQTTProtocolVersion5 )
+                    {
+                        *pucNextByte = 0;
+                        pucNextByte = &( pucNextByte[ mqttNO_PROPERTIES_LENGTH ] );
+                    }
+                #endif /* mqttconfigENABLE_MQTT5 */
+
                 pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxUnsubscribeParams->pucTopic, pxUnsubscribeParams->usTopicLength );
 
                 /* MISRA compliance. */
@@ -2962,11 +5842,12 @@ MQTTReturnCode_t MQTT_Unsubscribe( MQTTContext_t * pxMQTTContext,
 MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
                                const MQTTPublishParams_t * const pxPublishParams )
 {
-    uint8_t * pucNextByte, * pucLastByteInBuffer, ucRemainingLengthFieldBytes;
-    uint32_t ulRemainingLength, ulTotalMessageLength;
-    uint16_t usTopicLength;
     MQTTBufferHandle_t xBuffer = NULL;
-    MQTTReturnCode_t xReturnCode = eMQTTFailure;
+    MQTTReturnCode_t xReturnCode;
+
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        MQTTBool_t xStored = eMQTTFalse;
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
 
     /* These are checked here once and are later used without
      * NULL checks. */
@@ -2978,108 +5859,55 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
 
     mqttconfigDEBUG_LOG( ( "Initiating MQTT publish.\r\n" ) );
 
-    if( pxMQTTContext->xConnectionState != eMQTTConnected )
-    {
-        /* Fail the publish operation immediately, if
-         * MQTT client is not connected. */
-        xReturnCode = eMQTTClientNotConnected;
-    }
-    else
-    {
-        /* Length of the topic in the actual MQTT message. */
-        usTopicLength = mqttSTRLEN( pxPublishParams->usTopicLength );
-
-        /* Calculate the "Remaining Length" i.e. length of the packet excluding Fixed Header. */
-        ulRemainingLength = ( uint32_t ) usTopicLength +
-                            ( pxPublishParams->xQos == eMQTTQoS0 ? ( uint32_t ) mqttPUBLISH_QOS0_PACKET_IDENTIFER_LENGTH : ( uint32_t ) mqttPUBLISH_QOS1_PACKET_IDENTIFER_LENGTH ) +
-                            pxPublishParams->ulDataLength;
+    xReturnCode = prvPreparePublish( pxMQTTContext, pxPublishParams, eMQTTTrue, &xBuffer );
 
-        /* Calculate the number of bytes occupied by the "Remaining Length" field. */
-        ucRemainingLengthFieldBytes = prvSizeOfRemainingLength( ulRemainingLength );
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
 
-        /* Make sure that "Remaining Length" is within the permissible limits. */
-        if( ucRemainingLengthFieldBytes > ( uint8_t ) 0 )
+        /* Keep the message in the in-flight store until it is
+         * acknowledged, so that it can be re-transmitted on the next
+         * connection. It is stored before transmission so that the
+         * acknowledgment cannot arrive before the message is stored. */
+        if( ( xReturnCode == eMQTTSuccess ) && ( pxPublishParams->xQos != eMQTTQoS0 ) && ( pxMQTTContext->pxInflightStore != NULL ) )
         {
-            /* Calculate total MQTT message length. */
-            ulTotalMessageLength = mqttTOTAL_MESSAGE_LENGTH( ucRemainingLengthFieldBytes, ulRemainingLength );
-
-            /* Try to get a buffer from the free buffer pool. */
-            xBuffer = prvGetFreeBuffer( pxMQTTContext, ulTotalMessageLength );
+            xStored = pxMQTTContext->pxInflightStore->pxPutFxn( pxMQTTContext->pxInflightStore->pvStoreContext,
+                                                                pxPublishParams->usPacketIdentifier,
+                                                                mqttbufferGET_DATA( xBuffer ),
+                                                                mqttbufferGET_DATA_LENGTH( xBuffer ) );
 
-            if( xBuffer == NULL )
-            {
-                /* Fail the publish operation immediately, if
-                 * no free buffer is available. */
-                mqttconfigDEBUG_LOG( ( "No free buffer is available to carry out the operation. \r\n" ) );
-                xReturnCode = eMQTTNoFreeBuffer;
-            }
-            else
+            if( xStored == eMQTTFalse )
             {
-                /* Add the buffer to the Tx buffer list. */
-                mqttbufferLIST_ADD( &( pxMQTTContext->xTxBufferListHead ), xBuffer );
-
-                /* To help debugging only. */
-                memset( mqttbufferGET_DATA( xBuffer ), 0x00, mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( xBuffer ) );
-
-                /* Record time-stamp and store timeout. */
-                mqttbufferGET_PACKET_RECORDED_TICK_COUNT( xBuffer ) = prvGetCurrentTickCount( pxMQTTContext );
-                mqttbufferGET_PACKET_TIMEOUT_TICKS( xBuffer ) = pxPublishParams->ulTimeoutTicks;
-
-                /* Write Control Packet Type. */
-                /*_TODO_ Note!  DUP and RETAIN are all currently all set to 0. */
-                mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] = mqttCONTROL_PUBLISH;
-
-                /* Set QoS. QoS2 is not supported.*/
-                mqttconfigASSERT( pxPublishParams->xQos == eMQTTQoS0 || pxPublishParams->xQos == eMQTTQoS1 );
-                mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] |= ( ( ( uint8_t ) ( pxPublishParams->xQos ) ) << 1 );
-
-                /* Write encoded "Remaining Length" in the fixed header. */
-                pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttFIXED_HEADER_REMAINING_LENGTH_OFFSET ] );
-                pucLastByteInBuffer = &( mqttbufferGET_DATA( xBuffer )[ mqttbufferGET_EFFECTIVE_BUFFER_LENGTH( xBuffer ) - ( uint32_t ) 1 ] );
-                ucRemainingLengthFieldBytes = prvEncodeRemainingLength( ulRemainingLength, pucNextByte, pucLastByteInBuffer );
-
-                /* We should have successfully encoded the remaining length field
-                 * as we already have a large enough buffer. */
-                mqttconfigASSERT( ucRemainingLengthFieldBytes == prvSizeOfRemainingLength( ulRemainingLength ) );
-
-                /* Write the topic into the message (part of variable header). */
-                pucNextByte = &( mqttbufferGET_DATA( xBuffer )[ mqttADJUST_OFFSET( mqttPUBLISH_TOPIC_OFFSET, ucRemainingLengthFieldBytes ) ] );
-                pucNextByte = prvWriteString( pucNextByte, pucLastByteInBuffer, pxPublishParams->pucTopic, pxPublishParams->usTopicLength );
-
-                /* Write packet identifier into the message, if it is not QoS0. */
-                if( pxPublishParams->xQos != eMQTTQoS0 )
-                {
-                    /* Write MSB. */
-                    *pucNextByte = ( uint8_t ) ( ( pxPublishParams->usPacketIdentifier ) >> mqttBITS_PER_BYTE );
-                    pucNextByte++;
-
-                    /* Write LSB. */
-                    *pucNextByte = ( uint8_t ) ( pxPublishParams->usPacketIdentifier );
-                    pucNextByte++;
-                }
-
-                /* Write the payload into the message. */
-                memcpy( pucNextByte, pxPublishParams->pvData, ( size_t ) pxPublishParams->ulDataLength );
-
-                /* Store the packet identifier in TxBuffer also for matching
-                 * ACK later. */
-                mqttbufferGET_PACKET_IDENTIFIER( xBuffer ) = pxPublishParams->usPacketIdentifier;
-
-                /* Update the number of bytes written to the buffer. */
-                mqttbufferGET_DATA_LENGTH( xBuffer ) = ulTotalMessageLength;
-
-                /* MQTT packet created. */
-                xReturnCode = eMQTTSuccess;
+                mqttconfigDEBUG_LOG( ( "No space left in the in-flight store. \r\n" ) );
+                xReturnCode = eMQTTInflightStoreFull;
             }
         }
-    }
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
 
     /* If the packet was successfully constructed, transmit it. */
     if( xReturnCode == eMQTTSuccess )
     {
         xReturnCode = prvSendData( pxMQTTContext, mqttbufferGET_DATA( xBuffer ), mqttbufferGET_DATA_LENGTH( xBuffer ) );
+
+        #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+            /* The broker may not have learnt the alias of the topic.
+             * The aliases are assigned again along with the topics. */
+            if( xReturnCode != eMQTTSuccess )
+            {
+                memset( pxMQTTContext->xTxTopicAliases, 0x00, sizeof( pxMQTTContext->xTxTopicAliases ) );
+            }
+        #endif /* mqttconfigENABLE_MQTT5 */
     }
 
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+
+        /* The user is informed that the message was not sent, so it
+         * must not be re-transmitted later either. */
+        if( ( xReturnCode != eMQTTSuccess ) && ( xStored == eMQTTTrue ) )
+        {
+            pxMQTTContext->pxInflightStore->pxRemoveFxn( pxMQTTContext->pxInflightStore->pvStoreContext, pxPublishParams->usPacketIdentifier );
+        }
+    #endif /* mqttconfigENABLE_INFLIGHT_STORE */
+
     /* If some error occurred or QOS0 (No ACK is expected in case of QOS0),
      * return the buffer, otherwise it will be returned upon receiving ACK
      * or timeout. */
@@ -3093,6 +5921,65 @@ MQTTReturnCode_t MQTT_Publish( MQTTContext_t * pxMQTTContext,
 }
 /*-----------------------------------------------------------*/
 
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+    MQTTReturnCode_t MQTT_PublishZeroCopy( MQTTContext_t * pxMQTTContext,
+                                           const MQTTPublishParams_t * const pxPublishParams )
+    {
+        MQTTBufferHandle_t xBuffer = NULL;
+        MQTTReturnCode_t xReturnCode;
+
+        /* These are checked here once and are later used without
+         * NULL checks. */
+        mqttconfigASSERT( pxMQTTContext != NULL );
+        mqttconfigASSERT( pxMQTTContext->pxMQTTSendFxn != NULL );
+        mqttconfigASSERT( pxMQTTContext->xBufferPoolInterface.pxGetBufferFxn != NULL );
+        mqttconfigASSERT( pxMQTTContext->xBufferPoolInterface.pxReturnBufferFxn != NULL );
+        mqttconfigASSERT( pxPublishParams != NULL );
+
+        mqttconfigDEBUG_LOG( ( "Initiating MQTT zero-copy publish.\r\n" ) );
+
+        /* Only the header is written into the buffer. */
+        xReturnCode = prvPreparePublish( pxMQTTContext, pxPublishParams, eMQTTFalse, &xBuffer );
+
+        if( xReturnCode == eMQTTSuccess )
+        {
+            /* Remember the payload so that it can be handed back
+             * to the user along with the ACK or timeout. */
+            mqttbufferGET_PUBLISH_DATA( xBuffer ) = pxPublishParams->pvData;
+
+            xReturnCode = prvSendDataVectored( pxMQTTContext,
+                                               mqttbufferGET_DATA( xBuffer ),
+                                               mqttbufferGET_DATA_LENGTH( xBuffer ),
+                                               ( const uint8_t * ) pxPublishParams->pvData,
+                                               pxPublishParams->ulDataLength );
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+
+                /* The broker may not have learnt the alias of the topic.
+                 * The aliases are assigned again along with the topics. */
+                if( xReturnCode != eMQTTSuccess )
+                {
+                    memset( pxMQTTContext->xTxTopicAliases, 0x00, sizeof( pxMQTTContext->xTxTopicAliases ) );
+                }
+            #endif /* mqttconfigENABLE_MQTT5 */
+        }
+
+        /* If some error occurred or QOS0 (No ACK is expected in case of QOS0),
+         * return the buffer, otherwise it will be returned upon receiving ACK
+         * or timeout. */
+        if( ( xReturnCode != eMQTTSuccess ) || ( pxPublishParams->xQos == eMQTTQoS0 ) )
+        {
+            /* Return the buffer to the free buffer pool. */
+            prvReturnBuffer( pxMQTTContext, xBuffer );
+        }
+
+        return xReturnCode;
+    }
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+/*-----------------------------------------------------------*/
+
 MQTTReturnCode_t MQTT_ParseReceivedData( MQTTContext_t * pxMQTTContext,
                                          const uint8_t * pucReceivedData,
                                          size_t xReceivedDataLength )
@@ -3219,6 +6106,26 @@ MQTTReturnCode_t MQTT_ParseReceivedData( MQTTContext_t * pxMQTTContext,
                          * can be used for other operations. */
                         prvReturnBuffer( pxMQTTContext, pxMQTTContext->xRxBuffer );
                         pxMQTTContext->xRxBuffer = NULL;
+
+                        #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+
+                            /* A publish message is passed to the user in chunks
+                             * instead. Only its header is stored, in a buffer of
+                             * the usual size. */
+                            if( ( pxMQTTContext->ucRxFixedHeaderBuffer[ mqttFIXED_HEADER_CONTROL_BYTE_OFFSET ] & mqttTOP_NIBBLE_MASK ) == mqttCONTROL_PUBLISH )
+                            {
+                                pxMQTTContext->xRxBuffer = prvGetFreeBuffer( pxMQTTContext, pxMQTTContext->ulRxMessageReceivedLength + ( uint32_t ) mqttSTRLEN( 0 ) );
+
+                                if( pxMQTTContext->xRxBuffer != NULL )
+                                {
+                                    /* Copy the fixed header in the Rx buffer. */
+                                    memcpy( mqttbufferGET_DATA( pxMQTTContext->xRxBuffer ), pxMQTTContext->ucRxFixedHeaderBuffer, pxMQTTContext->ulRxMessageReceivedLength );
+                                    mqttbufferGET_DATA_LENGTH( pxMQTTContext->xRxBuffer ) = pxMQTTContext->ulRxMessageReceivedLength;
+
+                                    pxMQTTContext->xRxMessageState.xRxMessageAction = eMQTTRxMessageStream;
+                                }
+                            }
+                        #endif /* mqttconfigENABLE_STREAMING_RECEIVE */
                     }
                 }
             }
@@ -3272,6 +6179,13 @@ MQTTReturnCode_t MQTT_ParseReceivedData( MQTTContext_t * pxMQTTContext,
                 prvResetRxMessageState( pxMQTTContext );
             }
         }
+
+        #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+            else if( ( pxMQTTContext->xRxMessageState.xRxNextByte == eMQTTRxNextByteMessage ) && ( pxMQTTContext->xRxMessageState.xRxMessageAction == eMQTTRxMessageStream ) )
+            {
+                xProcessedBytes += prvStreamReceivedPublish( pxMQTTContext, &( pucReceivedData[ xProcessedBytes ] ), xReceivedDataLength - xProcessedBytes );
+            }
+        #endif /* mqttconfigENABLE_STREAMING_RECEIVE */
         else
         {
             /* Should not reach here. */
@@ -3360,6 +6274,11 @@ uint32_t MQTT_Periodic( MQTTContext_t * pxMQTTContext,
                 /* Inform the user about the timeout. */
                 xEventCallbackParams.xEventType = eMQTTTimeout;
                 xEventCallbackParams.u.xTimeoutData.usPacketIdentifier = mqttbufferGET_PACKET_IDENTIFIER( xBuffer );
+
+                #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+                    xEventCallbackParams.u.xTimeoutData.pvPublishData = mqttbufferGET_PUBLISH_DATA( xBuffer );
+                #endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+
                 ( void ) prvInvokeCallback( pxMQTTContext, &xEventCallbackParams );
 
                 /* Return the buffer back to the free buffer pool. */
@@ -0,0 +1,666 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file aws_mqtt_offline_spool.c
+ * @brief Log-structured spool of publish messages implementation.
+ */
+
+/* Interface includes. */
+#include "aws_mqtt_offline_spool.h"
+
+/* Standard includes. */
+#include <stddef.h>
+#include <string.h>
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+/**
+ * @brief XORed with the sequence number of a block in its header.
+ */
+    #define mqttspoolBLOCK_MAGIC             ( ( uint32_t ) 0x4D515350 )
+
+/**
+ * @defgroup SpoolRecordStates States of a record in the log.
+ *
+ * Each state only clears bits of the previous one, so that the state can be
+ * updated in flash without erasing it. A record still in the erased state
+ * was not completely written and is skipped.
+ */
+/** @{ */
+    #define mqttspoolRECORD_ERASED           ( ( uint8_t ) 0xFF ) /**< The record is being written. */
+    #define mqttspoolRECORD_LIVE             ( ( uint8_t ) 0x5A ) /**< The record holds a message. */
+    #define mqttspoolRECORD_REMOVED          ( ( uint8_t ) 0x00 ) /**< The message in the record has been removed. */
+/** @} */
+
+/**
+ * @brief Rounds up the given length to a multiple of 4.
+ */
+    #define mqttspoolALIGN( ulLength )       ( ( ( ulLength ) + ( uint32_t ) 3 ) & ~( ( uint32_t ) 3 ) )
+
+/**
+ * @brief The header at the start of every block in use.
+ *
+ * The blocks are used in order, each with the next sequence number, so the
+ * oldest and the newest blocks of the log are found from their sequence
+ * numbers.
+ */
+    typedef struct SpoolBlockHeader
+    {
+        uint32_t ulSequence; /**< Sequence number of the block. */
+        uint32_t ulCheck;    /**< ulSequence XOR mqttspoolBLOCK_MAGIC if the header is valid. */
+    } SpoolBlockHeader_t;
+
+/**
+ * @brief The header preceding every record in a block.
+ *
+ * The topic and the data follow the header and the next record starts at
+ * the next multiple of 4. An erased header ends the records of the block.
+ */
+    typedef struct SpoolRecordHeader
+    {
+        uint8_t ucState;        /**< One of the @ref SpoolRecordStates. */
+        uint8_t ucQoS;          /**< QoS of the message. */
+        uint16_t usTopicLength; /**< Length of the topic. */
+        uint32_t ulDataLength;  /**< Length of the data. */
+    } SpoolRecordHeader_t;
+
+/**
+ * @brief The size of a block header.
+ */
+    #define mqttspoolBLOCK_HEADER_SIZE       ( ( uint32_t ) sizeof( SpoolBlockHeader_t ) )
+
+/**
+ * @brief The size of a record header.
+ */
+    #define mqttspoolRECORD_HEADER_SIZE      ( ( uint32_t ) sizeof( SpoolRecordHeader_t ) )
+
+/**
+ * @brief The size of the record storing a message with the given topic and
+ * data lengths.
+ */
+    #define mqttspoolRECORD_SIZE( ulBytes )    ( mqttspoolRECORD_HEADER_SIZE + mqttspoolALIGN( ulBytes ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reads the header of the given block.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] ulBlock The index of the block.
+ * @param[out] pulSequence The sequence number of the block.
+ *
+ * @return eMQTTTrue if the block holds a valid header, eMQTTFalse otherwise.
+ */
+    static MQTTBool_t prvSpoolReadBlockHeader( const MQTTOfflineSpool_t * pxSpool,
+                                               uint32_t ulBlock,
+                                               uint32_t * pulSequence );
+
+/**
+ * @brief Reads the record at the given offset.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] ulOffset The offset of the record.
+ * @param[out] pxHeader The header of the record. All its bytes are 0xFF if
+ * the header is erased.
+ *
+ * @return The size of the record, or 0 if the block has no more records
+ * from this offset.
+ */
+    static uint32_t prvSpoolReadRecord( const MQTTOfflineSpool_t * pxSpool,
+                                        uint32_t ulOffset,
+                                        SpoolRecordHeader_t * pxHeader );
+
+/**
+ * @brief Finds the first live record from the given offset.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] ulOffset The offset to search from. It can be the end of a
+ * block.
+ *
+ * @return The offset of the record, or the tail if none is found.
+ */
+    static uint32_t prvSpoolFindLive( const MQTTOfflineSpool_t * pxSpool,
+                                      uint32_t ulOffset );
+
+/**
+ * @brief Erases the block after the tail block and moves the tail to it.
+ *
+ * @param[in] pxSpool The spool.
+ *
+ * @return eMQTTTrue if the tail was moved, eMQTTFalse if the next block
+ * holds the head or could not be erased.
+ */
+    static MQTTBool_t prvSpoolStartNextBlock( MQTTOfflineSpool_t * pxSpool );
+
+/**
+ * @brief Reads from a RAM region. Implements MQTTOfflineFlashRead_t.
+ */
+    static MQTTBool_t prvRamFlashRead( void * pvFlashContext,
+                                       uint32_t ulOffset,
+                                       uint8_t * pucData,
+                                       uint32_t ulLength );
+
+/**
+ * @brief Writes to a RAM region. Implements MQTTOfflineFlashWrite_t.
+ */
+    static MQTTBool_t prvRamFlashWrite( void * pvFlashContext,
+                                        uint32_t ulOffset,
+                                        const uint8_t * pucData,
+                                        uint32_t ulLength );
+
+/**
+ * @brief Erases a block of a RAM region. Implements MQTTOfflineFlashErase_t.
+ */
+    static MQTTBool_t prvRamFlashErase( void * pvFlashContext,
+                                        uint32_t ulBlock );
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvSpoolReadBlockHeader( const MQTTOfflineSpool_t * pxSpool,
+                                               uint32_t ulBlock,
+                                               uint32_t * pulSequence )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        SpoolBlockHeader_t xHeader;
+        MQTTBool_t xValid = eMQTTFalse;
+
+        if( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                ulBlock * pxFlash->ulBlockSize,
+                                ( uint8_t * ) &xHeader,
+                                mqttspoolBLOCK_HEADER_SIZE ) == eMQTTTrue )
+        {
+            if( ( xHeader.ulSequence ^ mqttspoolBLOCK_MAGIC ) == xHeader.ulCheck )
+            {
+                *pulSequence = xHeader.ulSequence;
+                xValid = eMQTTTrue;
+            }
+        }
+
+        return xValid;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvSpoolReadRecord( const MQTTOfflineSpool_t * pxSpool,
+                                        uint32_t ulOffset,
+                                        SpoolRecordHeader_t * pxHeader )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        const uint32_t ulBlockEnd = ( ( ulOffset / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+        uint32_t ulSize = 0;
+
+        /* The bytes at the end of a block too few for a header are
+         * never used. */
+        memset( pxHeader, 0x00, sizeof( SpoolRecordHeader_t ) );
+
+        if( ( ulBlockEnd - ulOffset ) >= mqttspoolRECORD_HEADER_SIZE )
+        {
+            if( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                    ulOffset,
+                                    ( uint8_t * ) pxHeader,
+                                    mqttspoolRECORD_HEADER_SIZE ) == eMQTTTrue )
+            {
+                /* An erased header is the end of the records. One which
+                 * does not fit in the block was not completely written,
+                 * which also ends them. */
+                if( ( pxHeader->ucQoS <= ( uint8_t ) eMQTTQoS2 ) &&
+                    ( pxHeader->ulDataLength <= pxFlash->ulBlockSize ) &&
+                    ( mqttspoolRECORD_SIZE( ( uint32_t ) pxHeader->usTopicLength + pxHeader->ulDataLength ) <= ( ulBlockEnd - ulOffset ) ) )
+                {
+                    ulSize = mqttspoolRECORD_SIZE( ( uint32_t ) pxHeader->usTopicLength + pxHeader->ulDataLength );
+                }
+            }
+            else
+            {
+                memset( pxHeader, 0x00, sizeof( SpoolRecordHeader_t ) );
+            }
+        }
+
+        return ulSize;
+    }
+/*-----------------------------------------------------------*/
+
+    static uint32_t prvSpoolFindLive( const MQTTOfflineSpool_t * pxSpool,
+                                      uint32_t ulOffset )
+    {
+        const uint32_t ulBlockSize = pxSpool->pxFlash->ulBlockSize;
+        const uint32_t ulRegionSize = ulBlockSize * pxSpool->pxFlash->ulBlockCount;
+        const uint32_t ulTailBlock = ( pxSpool->ulTailOffset - ( uint32_t ) 1 ) / ulBlockSize;
+        SpoolRecordHeader_t xHeader;
+        uint32_t ulSize;
+
+        while( ulOffset != pxSpool->ulTailOffset )
+        {
+            /* The end of a block is followed by the first record of the
+             * next block. */
+            if( ( ulOffset % ulBlockSize ) == ( uint32_t ) 0 )
+            {
+                ulOffset = ( ulOffset % ulRegionSize ) + mqttspoolBLOCK_HEADER_SIZE;
+            }
+
+            ulSize = prvSpoolReadRecord( pxSpool, ulOffset, &xHeader );
+
+            if( ulSize == ( uint32_t ) 0 )
+            {
+                /* The tail block always has records up to the tail. */
+                if( ( ulOffset / ulBlockSize ) == ulTailBlock )
+                {
+                    ulOffset = pxSpool->ulTailOffset;
+                }
+                else
+                {
+                    ulOffset = ( ( ulOffset / ulBlockSize ) + ( uint32_t ) 1 ) * ulBlockSize;
+                }
+            }
+            else if( xHeader.ucState == mqttspoolRECORD_LIVE )
+            {
+                break;
+            }
+            else
+            {
+                ulOffset += ulSize;
+            }
+        }
+
+        return ulOffset;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvSpoolStartNextBlock( MQTTOfflineSpool_t * pxSpool )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        const uint32_t ulNextBlock = ( ( pxSpool->ulTailOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize + ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+        SpoolBlockHeader_t xHeader;
+        MQTTBool_t xStarted = eMQTTFalse;
+
+        /* The block holding the oldest message is reused only once the
+         * message has been removed. */
+        if( ( pxSpool->ulMessages == ( uint32_t ) 0 ) || ( ( pxSpool->ulHeadOffset / pxFlash->ulBlockSize ) != ulNextBlock ) )
+        {
+            xHeader.ulSequence = pxSpool->ulNextSequence;
+            xHeader.ulCheck = xHeader.ulSequence ^ mqttspoolBLOCK_MAGIC;
+
+            if( ( pxFlash->pxEraseFxn( pxFlash->pvFlashContext, ulNextBlock ) == eMQTTTrue ) &&
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                       ulNextBlock * pxFlash->ulBlockSize,
+                                       ( const uint8_t * ) &xHeader,
+                                       mqttspoolBLOCK_HEADER_SIZE ) == eMQTTTrue ) )
+            {
+                pxSpool->ulNextSequence++;
+                pxSpool->ulTailOffset = ( ulNextBlock * pxFlash->ulBlockSize ) + mqttspoolBLOCK_HEADER_SIZE;
+                xStarted = eMQTTTrue;
+            }
+            else
+            {
+                /* The block may be half erased and no message is
+                 * written to it. Using it again needs another erase. */
+                pxSpool->ulTailOffset = ( ulNextBlock + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+            }
+
+            /* The head of an empty spool follows the tail. */
+            if( pxSpool->ulMessages == ( uint32_t ) 0 )
+            {
+                pxSpool->ulHeadOffset = pxSpool->ulTailOffset;
+            }
+        }
+
+        return xStarted;
+    }
+/*-----------------------------------------------------------*/
+
+    void MQTT_OfflineSpoolInit( MQTTOfflineSpool_t * pxSpool,
+                                const MQTTOfflineFlashInterface_t * pxFlash )
+    {
+        SpoolRecordHeader_t xHeader;
+        uint32_t ulBlock, ulNewestBlock = 0, ulOldestBlock, ulPreviousBlock;
+        uint32_t ulSequence, ulNewestSequence = 0, ulOldestSequence, ulOffset, ulBlockEnd, ulSize;
+        MQTTBool_t xAnyBlock = eMQTTFalse, xFoundHead = eMQTTFalse;
+
+        mqttconfigASSERT( pxSpool != NULL );
+        mqttconfigASSERT( pxFlash != NULL );
+        mqttconfigASSERT( pxFlash->ulBlockCount >= ( uint32_t ) 2 );
+        mqttconfigASSERT( ( pxFlash->ulBlockSize & ( uint32_t ) 3 ) == ( uint32_t ) 0 );
+        mqttconfigASSERT( pxFlash->ulBlockSize > ( mqttspoolBLOCK_HEADER_SIZE + mqttspoolRECORD_HEADER_SIZE ) );
+
+        pxSpool->pxFlash = pxFlash;
+        pxSpool->ulMessages = 0;
+        pxSpool->ulBytes = 0;
+
+        /* The newest block has the highest sequence number. */
+        for( ulBlock = 0; ulBlock < pxFlash->ulBlockCount; ulBlock++ )
+        {
+            if( prvSpoolReadBlockHeader( pxSpool, ulBlock, &ulSequence ) == eMQTTTrue )
+            {
+                if( ( xAnyBlock == eMQTTFalse ) || ( ( int32_t ) ( ulSequence - ulNewestSequence ) > 0 ) )
+                {
+                    ulNewestBlock = ulBlock;
+                    ulNewestSequence = ulSequence;
+                }
+
+                xAnyBlock = eMQTTTrue;
+            }
+        }
+
+        if( xAnyBlock == eMQTTFalse )
+        {
+            /* An empty log. The first message starts the first block. */
+            pxSpool->ulTailOffset = pxFlash->ulBlockCount * pxFlash->ulBlockSize;
+            pxSpool->ulNextSequence = 0;
+        }
+        else
+        {
+            /* The blocks of the log precede the newest block with
+             * consecutive sequence numbers. */
+            ulOldestBlock = ulNewestBlock;
+            ulOldestSequence = ulNewestSequence;
+
+            for( ; ; )
+            {
+                ulPreviousBlock = ( ulOldestBlock + pxFlash->ulBlockCount - ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+
+                if( ( ulPreviousBlock == ulNewestBlock ) ||
+                    ( prvSpoolReadBlockHeader( pxSpool, ulPreviousBlock, &ulSequence ) == eMQTTFalse ) ||
+                    ( ulSequence != ( ulOldestSequence - ( uint32_t ) 1 ) ) )
+                {
+                    break;
+                }
+
+                ulOldestBlock = ulPreviousBlock;
+                ulOldestSequence = ulSequence;
+            }
+
+            /* Count the live records from the oldest block on. The tail is
+             * after the last record of the newest block. */
+            ulBlock = ulOldestBlock;
+
+            for( ; ; )
+            {
+                ulOffset = ( ulBlock * pxFlash->ulBlockSize ) + mqttspoolBLOCK_HEADER_SIZE;
+                ulBlockEnd = ( ulBlock + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+
+                while( ulOffset < ulBlockEnd )
+                {
+                    ulSize = prvSpoolReadRecord( pxSpool, ulOffset, &xHeader );
+
+                    if( ulSize == ( uint32_t ) 0 )
+                    {
+                        /* Only an erased header can be written over. */
+                        if( ( xHeader.ucState != mqttspoolRECORD_ERASED ) ||
+                            ( xHeader.ucQoS != ( uint8_t ) 0xFF ) ||
+                            ( xHeader.usTopicLength != ( uint16_t ) 0xFFFF ) ||
+                            ( xHeader.ulDataLength != ( uint32_t ) 0xFFFFFFFF ) )
+                        {
+                            ulOffset = ulBlockEnd;
+                        }
+
+                        break;
+                    }
+
+                    if( xHeader.ucState == mqttspoolRECORD_LIVE )
+                    {
+                        if( xFoundHead == eMQTTFalse )
+                        {
+                            pxSpool->ulHeadOffset = ulOffset;
+                            xFoundHead = eMQTTTrue;
+                        }
+
+                        pxSpool->ulMessages++;
+                        pxSpool->ulBytes += ( uint32_t ) xHeader.usTopicLength + xHeader.ulDataLength;
+                    }
+
+                    ulOffset += ulSize;
+                }
+
+                if( ulBlock == ulNewestBlock )
+                {
+                    pxSpool->ulTailOffset = ulOffset;
+                    break;
+                }
+
+                ulBlock = ( ulBlock + ( uint32_t ) 1 ) % pxFlash->ulBlockCount;
+            }
+
+            pxSpool->ulNextSequence = ulNewestSequence + ( uint32_t ) 1;
+        }
+
+        if( xFoundHead == eMQTTFalse )
+        {
+            pxSpool->ulHeadOffset = pxSpool->ulTailOffset;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    MQTTBool_t MQTT_OfflineSpoolPush( MQTTOfflineSpool_t * pxSpool,
+                                      const MQTTPublishParams_t * pxPublishParams )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        const uint32_t ulBytes = ( uint32_t ) pxPublishParams->usTopicLength + pxPublishParams->ulDataLength;
+        const uint32_t ulRecordSize = mqttspoolRECORD_SIZE( ulBytes );
+        SpoolRecordHeader_t xHeader;
+        uint32_t ulOffset, ulBlockEnd;
+        uint8_t ucState = mqttspoolRECORD_LIVE;
+        MQTTBool_t xStored = eMQTTFalse;
+
+        /* A record never spans two blocks. */
+        if( ( pxPublishParams->ulDataLength <= pxFlash->ulBlockSize ) &&
+            ( ulRecordSize <= ( pxFlash->ulBlockSize - mqttspoolBLOCK_HEADER_SIZE ) ) )
+        {
+            ulBlockEnd = ( ( ( pxSpool->ulTailOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+
+            if( ( ulBlockEnd - pxSpool->ulTailOffset ) >= ulRecordSize )
+            {
+                xStored = eMQTTTrue;
+            }
+            else
+            {
+                xStored = prvSpoolStartNextBlock( pxSpool );
+            }
+        }
+
+        if( xStored == eMQTTTrue )
+        {
+            ulOffset = pxSpool->ulTailOffset;
+
+            /* Write the header in the erased state and the message, then
+             * the state, so that the record is live only once it is
+             * complete. */
+            xHeader.ucState = mqttspoolRECORD_ERASED;
+            xHeader.ucQoS = ( uint8_t ) pxPublishParams->xQos;
+            xHeader.usTopicLength = pxPublishParams->usTopicLength;
+            xHeader.ulDataLength = pxPublishParams->ulDataLength;
+
+            if( ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext, ulOffset, ( const uint8_t * ) &xHeader, mqttspoolRECORD_HEADER_SIZE ) == eMQTTFalse ) ||
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                       ulOffset + mqttspoolRECORD_HEADER_SIZE,
+                                       pxPublishParams->pucTopic,
+                                       ( uint32_t ) pxPublishParams->usTopicLength ) == eMQTTFalse ) ||
+                ( ( pxPublishParams->ulDataLength > ( uint32_t ) 0 ) &&
+                  ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                         ulOffset + mqttspoolRECORD_HEADER_SIZE + ( uint32_t ) pxPublishParams->usTopicLength,
+                                         ( const uint8_t * ) pxPublishParams->pvData,
+                                         pxPublishParams->ulDataLength ) == eMQTTFalse ) ) ||
+                ( pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                       ulOffset + ( uint32_t ) offsetof( SpoolRecordHeader_t, ucState ),
+                                       &ucState,
+                                       ( uint32_t ) 1 ) == eMQTTFalse ) )
+            {
+                /* The rest of the block is in an unknown state, so it is
+                 * not used anymore. */
+                pxSpool->ulTailOffset = ( ( ( ulOffset - ( uint32_t ) 1 ) / pxFlash->ulBlockSize ) + ( uint32_t ) 1 ) * pxFlash->ulBlockSize;
+                xStored = eMQTTFalse;
+            }
+            else
+            {
+                pxSpool->ulTailOffset = ulOffset + ulRecordSize;
+
+                if( pxSpool->ulMessages == ( uint32_t ) 0 )
+                {
+                    pxSpool->ulHeadOffset = ulOffset;
+                }
+
+                pxSpool->ulMessages++;
+                pxSpool->ulBytes += ulBytes;
+            }
+
+            if( pxSpool->ulMessages == ( uint32_t ) 0 )
+            {
+                pxSpool->ulHeadOffset = pxSpool->ulTailOffset;
+            }
+        }
+
+        return xStored;
+    }
+/*-----------------------------------------------------------*/
+
+    MQTTBool_t MQTT_OfflineSpoolPeek( MQTTOfflineSpool_t * pxSpool,
+                                      uint8_t * pucBuffer,
+                                      uint32_t ulBufferLength,
+                                      MQTTPublishParams_t * pxPublishParams )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        SpoolRecordHeader_t xHeader;
+        uint32_t ulBytes;
+        MQTTBool_t xRead = eMQTTFalse;
+
+        if( pxSpool->ulMessages > ( uint32_t ) 0 )
+        {
+            if( prvSpoolReadRecord( pxSpool, pxSpool->ulHeadOffset, &xHeader ) != ( uint32_t ) 0 )
+            {
+                ulBytes = ( uint32_t ) xHeader.usTopicLength + xHeader.ulDataLength;
+
+                if( ( ulBytes <= ulBufferLength ) &&
+                    ( pxFlash->pxReadFxn( pxFlash->pvFlashContext,
+                                          pxSpool->ulHeadOffset + mqttspoolRECORD_HEADER_SIZE,
+                                          pucBuffer,
+                                          ulBytes ) == eMQTTTrue ) )
+                {
+                    pxPublishParams->pucTopic = pucBuffer;
+                    pxPublishParams->usTopicLength = xHeader.usTopicLength;
+                    pxPublishParams->xQos = ( MQTTQoS_t ) xHeader.ucQoS;
+                    pxPublishParams->pvData = &( pucBuffer[ xHeader.usTopicLength ] );
+                    pxPublishParams->ulDataLength = xHeader.ulDataLength;
+                    xRead = eMQTTTrue;
+                }
+            }
+        }
+
+        return xRead;
+    }
+/*-----------------------------------------------------------*/
+
+    void MQTT_OfflineSpoolPop( MQTTOfflineSpool_t * pxSpool )
+    {
+        const MQTTOfflineFlashInterface_t * pxFlash = pxSpool->pxFlash;
+        SpoolRecordHeader_t xHeader;
+        uint32_t ulSize;
+        uint8_t ucState = mqttspoolRECORD_REMOVED;
+
+        if( pxSpool->ulMessages > ( uint32_t ) 0 )
+        {
+            ulSize = prvSpoolReadRecord( pxSpool, pxSpool->ulHeadOffset, &xHeader );
+
+            /* If the state cannot be written, the message is spooled again
+             * after a reset. */
+            ( void ) pxFlash->pxWriteFxn( pxFlash->pvFlashContext,
+                                          pxSpool->ulHeadOffset + ( uint32_t ) offsetof( SpoolRecordHeader_t, ucState ),
+                                          &ucState,
+                                          ( uint32_t ) 1 );
+
+            pxSpool->ulMessages--;
+            pxSpool->ulBytes -= ( uint32_t ) xHeader.usTopicLength + xHeader.ulDataLength;
+
+            if( ( pxSpool->ulMessages == ( uint32_t ) 0 ) || ( ulSize == ( uint32_t ) 0 ) )
+            {
+                pxSpool->ulMessages = 0;
+                pxSpool->ulBytes = 0;
+                pxSpool->ulHeadOffset = pxSpool->ulTailOffset;
+            }
+            else
+            {
+                pxSpool->ulHeadOffset = prvSpoolFindLive( pxSpool, pxSpool->ulHeadOffset + ulSize );
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRamFlashRead( void * pvFlashContext,
+                                       uint32_t ulOffset,
+                                       uint8_t * pucData,
+                                       uint32_t ulLength )
+    {
+        const MQTTOfflineRamFlash_t * pxRamFlash = ( const MQTTOfflineRamFlash_t * ) pvFlashContext;
+
+        ( void ) memcpy( pucData, &( pxRamFlash->pucMemory[ ulOffset ] ), ( size_t ) ulLength );
+
+        return eMQTTTrue;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRamFlashWrite( void * pvFlashContext,
+                                        uint32_t ulOffset,
+                                        const uint8_t * pucData,
+                                        uint32_t ulLength )
+    {
+        MQTTOfflineRamFlash_t * pxRamFlash = ( MQTTOfflineRamFlash_t * ) pvFlashContext;
+
+        ( void ) memcpy( &( pxRamFlash->pucMemory[ ulOffset ] ), pucData, ( size_t ) ulLength );
+
+        return eMQTTTrue;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvRamFlashErase( void * pvFlashContext,
+                                        uint32_t ulBlock )
+    {
+        MQTTOfflineRamFlash_t * pxRamFlash = ( MQTTOfflineRamFlash_t * ) pvFlashContext;
+        const uint32_t ulBlockSize = pxRamFlash->xInterface.ulBlockSize;
+
+        ( void ) memset( &( pxRamFlash->pucMemory[ ulBlock * ulBlockSize ] ), 0xFF, ( size_t ) ulBlockSize );
+
+        return eMQTTTrue;
+    }
+/*-----------------------------------------------------------*/
+
+    const MQTTOfflineFlashInterface_t * MQTT_OfflineRamFlashInit( MQTTOfflineRamFlash_t * pxRamFlash,
+                                                                  uint8_t * pucMemory,
+                                                                  uint32_t ulBlockSize,
+                                                                  uint32_t ulBlockCount )
+    {
+        mqttconfigASSERT( pxRamFlash != NULL );
+        mqttconfigASSERT( pucMemory != NULL );
+
+        pxRamFlash->pucMemory = pucMemory;
+        pxRamFlash->xInterface.pvFlashContext = ( void * ) pxRamFlash;
+        pxRamFlash->xInterface.pxReadFxn = prvRamFlashRead;
+        pxRamFlash->xInterface.pxWriteFxn = prvRamFlashWrite;
+        pxRamFlash->xInterface.pxEraseFxn = prvRamFlashErase;
+        pxRamFlash->xInterface.ulBlockSize = ulBlockSize;
+        pxRamFlash->xInterface.ulBlockCount = ulBlockCount;
+
+        return &( pxRamFlash->xInterface );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
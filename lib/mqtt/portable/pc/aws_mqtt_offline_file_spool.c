@@ -0,0 +1,230 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+
+/**
+ * @file aws_mqtt_offline_file_spool.c
+ * @brief File region for the spool of the offline publish queue.
+ *
+ * Uses the C standard library, so it is available on any hosted build.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Interface includes. */
+#include "aws_mqtt_offline_spool.h"
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+/**
+ * @brief Size of the buffer used to erase the blocks of the file.
+ */
+    #define mqttfilespoolERASE_CHUNK_SIZE    ( 64 )
+
+/**
+ * @brief Reads from a file region. Implements MQTTOfflineFlashRead_t.
+ */
+    static MQTTBool_t prvFileFlashRead( void * pvFlashContext,
+                                        uint32_t ulOffset,
+                                        uint8_t * pucData,
+                                        uint32_t ulLength );
+
+/**
+ * @brief Writes to a file region. Implements MQTTOfflineFlashWrite_t.
+ */
+    static MQTTBool_t prvFileFlashWrite( void * pvFlashContext,
+                                         uint32_t ulOffset,
+                                         const uint8_t * pucData,
+                                         uint32_t ulLength );
+
+/**
+ * @brief Erases a block of a file region. Implements MQTTOfflineFlashErase_t.
+ */
+    static MQTTBool_t prvFileFlashErase( void * pvFlashContext,
+                                         uint32_t ulBlock );
+
+/**
+ * @brief Fills a part of a file region with 0xFF.
+ *
+ * @param[in] pxFile The file.
+ * @param[in] ulOffset The offset of the part.
+ * @param[in] ulLength The length of the part.
+ *
+ * @return eMQTTTrue if the part was filled, eMQTTFalse otherwise.
+ */
+    static MQTTBool_t prvFileFlashFill( FILE * pxFile,
+                                        uint32_t ulOffset,
+                                        uint32_t ulLength );
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFileFlashRead( void * pvFlashContext,
+                                        uint32_t ulOffset,
+                                        uint8_t * pucData,
+                                        uint32_t ulLength )
+    {
+        FILE * pxFile = ( FILE * ) ( ( MQTTOfflineFileFlash_t * ) pvFlashContext )->pvFile;
+        MQTTBool_t xRead = eMQTTFalse;
+
+        if( ( fseek( pxFile, ( long ) ulOffset, SEEK_SET ) == 0 ) &&
+            ( fread( pucData, 1, ( size_t ) ulLength, pxFile ) == ( size_t ) ulLength ) )
+        {
+            xRead = eMQTTTrue;
+        }
+
+        return xRead;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFileFlashWrite( void * pvFlashContext,
+                                         uint32_t ulOffset,
+                                         const uint8_t * pucData,
+                                         uint32_t ulLength )
+    {
+        FILE * pxFile = ( FILE * ) ( ( MQTTOfflineFileFlash_t * ) pvFlashContext )->pvFile;
+        MQTTBool_t xWritten = eMQTTFalse;
+
+        /* The spool relies on the order of its writes, so each one is
+         * flushed before the next. */
+        if( ( fseek( pxFile, ( long ) ulOffset, SEEK_SET ) == 0 ) &&
+            ( fwrite( pucData, 1, ( size_t ) ulLength, pxFile ) == ( size_t ) ulLength ) &&
+            ( fflush( pxFile ) == 0 ) )
+        {
+            xWritten = eMQTTTrue;
+        }
+
+        return xWritten;
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFileFlashErase( void * pvFlashContext,
+                                         uint32_t ulBlock )
+    {
+        MQTTOfflineFileFlash_t * pxFileFlash = ( MQTTOfflineFileFlash_t * ) pvFlashContext;
+        const uint32_t ulBlockSize = pxFileFlash->xInterface.ulBlockSize;
+
+        return prvFileFlashFill( ( FILE * ) pxFileFlash->pvFile, ulBlock * ulBlockSize, ulBlockSize );
+    }
+/*-----------------------------------------------------------*/
+
+    static MQTTBool_t prvFileFlashFill( FILE * pxFile,
+                                        uint32_t ulOffset,
+                                        uint32_t ulLength )
+    {
+        uint8_t ucErased[ mqttfilespoolERASE_CHUNK_SIZE ];
+        size_t xChunk;
+        MQTTBool_t xFilled = eMQTTFalse;
+
+        memset( ucErased, 0xFF, sizeof( ucErased ) );
+
+        if( fseek( pxFile, ( long ) ulOffset, SEEK_SET ) == 0 )
+        {
+            xFilled = eMQTTTrue;
+
+            while( ( ulLength > ( uint32_t ) 0 ) && ( xFilled == eMQTTTrue ) )
+            {
+                xChunk = ( ulLength < ( uint32_t ) sizeof( ucErased ) ) ? ( size_t ) ulLength : sizeof( ucErased );
+
+                if( fwrite( ucErased, 1, xChunk, pxFile ) != xChunk )
+                {
+                    xFilled = eMQTTFalse;
+                }
+
+                ulLength -= ( uint32_t ) xChunk;
+            }
+
+            if( fflush( pxFile ) != 0 )
+            {
+                xFilled = eMQTTFalse;
+            }
+        }
+
+        return xFilled;
+    }
+/*-----------------------------------------------------------*/
+
+    const MQTTOfflineFlashInterface_t * MQTT_OfflineFileFlashOpen( MQTTOfflineFileFlash_t * pxFileFlash,
+                                                                   const char * pcFileName,
+                                                                   uint32_t ulBlockSize,
+                                                                   uint32_t ulBlockCount )
+    {
+        const MQTTOfflineFlashInterface_t * pxInterface = NULL;
+        FILE * pxFile;
+        long lSize = -1;
+
+        mqttconfigASSERT( pxFileFlash != NULL );
+        mqttconfigASSERT( pcFileName != NULL );
+
+        /* Keep the messages of an existing file. */
+        pxFile = fopen( pcFileName, "r+b" );
+
+        if( pxFile == NULL )
+        {
+            pxFile = fopen( pcFileName, "w+b" );
+        }
+
+        if( pxFile != NULL )
+        {
+            if( fseek( pxFile, 0L, SEEK_END ) == 0 )
+            {
+                lSize = ftell( pxFile );
+            }
+
+            /* A new or shorter file is extended with erased bytes. */
+            if( ( lSize >= 0L ) &&
+                ( ( ( uint32_t ) lSize >= ( ulBlockSize * ulBlockCount ) ) ||
+                  ( prvFileFlashFill( pxFile, ( uint32_t ) lSize, ( ulBlockSize * ulBlockCount ) - ( uint32_t ) lSize ) == eMQTTTrue ) ) )
+            {
+                pxFileFlash->pvFile = ( void * ) pxFile;
+                pxFileFlash->xInterface.pvFlashContext = ( void * ) pxFileFlash;
+                pxFileFlash->xInterface.pxReadFxn = prvFileFlashRead;
+                pxFileFlash->xInterface.pxWriteFxn = prvFileFlashWrite;
+                pxFileFlash->xInterface.pxEraseFxn = prvFileFlashErase;
+                pxFileFlash->xInterface.ulBlockSize = ulBlockSize;
+                pxFileFlash->xInterface.ulBlockCount = ulBlockCount;
+                pxInterface = &( pxFileFlash->xInterface );
+            }
+            else
+            {
+                ( void ) fclose( pxFile );
+            }
+        }
+
+        return pxInterface;
+    }
+/*-----------------------------------------------------------*/
+
+    void MQTT_OfflineFileFlashClose( MQTTOfflineFileFlash_t * pxFileFlash )
+    {
+        if( pxFileFlash->pvFile != NULL )
+        {
+            ( void ) fclose( ( FILE * ) pxFileFlash->pvFile );
+            pxFileFlash->pvFile = NULL;
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
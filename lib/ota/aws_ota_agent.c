@@ -52,9 +52,16 @@
 #include "aws_mqtt_agent.h"
 
 /* JSON job document parser includes. */
-#include "jsmn.h" /*lint !e537 All headers have multiple inclusion prevention. */
+#include "aws_json_scanner.h" /*lint !e537 All headers have multiple inclusion prevention. */
 #include "mbedtls/base64.h"
 
+/* Signature verification includes. */
+#include "aws_crypto.h"
+
+/* Delta and compressed update includes. */
+#include "aws_ota_delta.h"
+#include "aws_ota_decompress.h"
+
 /* Returns the byte offset of the element 'e' in the typedef structure 't'.
  * Setting an arbitrarily large base of 0x10000 and masking off that base allows
  * us to do the same thing as a zero offset without the lint warnings of using a
@@ -63,6 +70,10 @@
 /*lint -emacro((923,9078),OFFSET_OF) Intentionally cast pointer to uint32_t because we are using it as an offset. */
 #define OFFSET_OF( t, e )    ( ( uint32_t ) ( &( ( t * ) 0x10000UL )->e ) & 0xffffUL )
 
+/* True if the file of a context is decoded as its blocks are received, a patch or a compressed file,
+ * which needs the blocks in order. */
+#define OTA_DECODED_FILE( C )    ( ( ( C )->pxDelta != NULL ) || ( ( C )->pxDecompress != NULL ) )
+
 /* General constants. */
 #define OTA_MAX_JSON_STR_LEN               256U             /* Limit our JSON string compares to something small to avoid going into the weeds. */
 #define OTA_ERASED_BLOCKS_VAL              0xffU            /* The starting state of a group of erased blocks in the Rx block bitmap. */
@@ -94,7 +105,6 @@
 
 /* Job document parser constants. */
 
-#define OTA_MAX_JSON_TOKENS    64U                      /* Number of JSON tokens supported in a single parser call. */
 #define OTA_MAX_TOPIC_LEN      256U                     /* Max length of a dynamically generated topic string (usually on the stack). */
 
 /* When subscribing to MQTT topics with a callback handler, we use the callback
@@ -124,7 +134,7 @@ typedef struct
  * size, attributes, etc. The following value specifies the number of parameters
  * that are included in the job document model although some may be optional. */
 
-#define OTA_NUM_JOB_PARAMS         ( 16 ) /* Number of parameters in the job document. */
+#define OTA_NUM_JOB_PARAMS         ( 18 ) /* Number of parameters in the job document. */
 /* We need the following string to match in a couple places in the code so use a #define. */
 #define OTA_JSON_UPDATED_BY_KEY    "updatedBy"
 
@@ -143,6 +153,8 @@ static const char cOTA_JSON_FileSizeKey[] = "filesize";
 static const char cOTA_JSON_FileIDKey[] = "fileid";
 static const char cOTA_JSON_FileAttributeKey[] = "attr";
 static const char cOTA_JSON_FileCertNameKey[] = "certfile";
+static const char cOTA_JSON_FileDeltaKey[] = "delta";
+static const char cOTA_JSON_FileCompressedKey[] = "compressed";
 
 enum
 {
@@ -195,7 +207,7 @@ static const char * pcOTA_JobStatus_Strings[ eNumJobStatusMappings ] =
 #define OTA_DOC_MODEL_MAX_PARAMS    32U                    /* The parameter list is backed by a 32 bit longword bitmap by design. */
 #define OTA_JOB_PARAM_REQUIRED      ( ( bool_t ) pdTRUE )  /* Used to denote a required document model parameter. */
 #define OTA_JOB_PARAM_OPTIONAL      ( ( bool_t ) pdFALSE ) /* Used to denote an optional document model parameter. */
-#define OTA_DONT_STORE_PARAM        0xffffffffUL           /* If ulDestOffset in the model is 0xffffffff, do not store the value. */
+#define OTA_DONT_STORE_PARAM        0xffffffffUL           /* If uxDestOffset in the model is 0xffffffff, do not store the value. */
 
 /* This union allows us to access document model parameter addresses as their
  * actual type without casting every time we access a parameter. */
@@ -205,7 +217,7 @@ typedef union MultiParmPtr
     char ** ppcPtr;
     const char ** ppcConstPtr;
     uint32_t * pulPtr;
-    uint32_t ulVal;
+    uintptr_t uxVal;
     bool_t * pxBoolPtr;
     Sig256_t ** ppxSig256Ptr;
     void ** ppvPtr;
@@ -216,15 +228,17 @@ typedef union MultiParmPtr
 
 typedef enum
 {
-    eOTA_JobParseErr_Unknown = -1,        /* The error code has not yet been set by a logic path. */
-    eOTA_JobParseErr_None = 0,            /* Signifies no error has occurred. */
-    eOTA_JobParseErr_BusyWithExistingJob, /* We're busy with a job but received a new job document. */
-    eOTA_JobParseErr_NullJob,             /* A null job was reported (no job ID). */
-    eOTA_JobParseErr_BusyWithSameJob,     /* We're already busy with the reported job ID. */
-    eOTA_JobParseErr_ZeroFileSize,        /* Job document specified a zero sized file. This is not allowed. */
-    eOTA_JobParseErr_NonConformingJobDoc, /* The job document failed to fulfill the model requirements. */
-    eOTA_JobParseErr_BadModelInitParams,  /* There was an invalid initialization parameter used in the document model. */
-    eOTA_JobParseErr_NoContextAvailable   /* There wasn't an OTA context available. */
+    eOTA_JobParseErr_Unknown = -1,           /* The error code has not yet been set by a logic path. */
+    eOTA_JobParseErr_None = 0,               /* Signifies no error has occurred. */
+    eOTA_JobParseErr_BusyWithExistingJob,    /* We're busy with a job but received a new job document. */
+    eOTA_JobParseErr_NullJob,                /* A null job was reported (no job ID). */
+    eOTA_JobParseErr_BusyWithSameJob,        /* We're already busy with the reported job ID. */
+    eOTA_JobParseErr_ZeroFileSize,           /* Job document specified a zero sized file. This is not allowed. */
+    eOTA_JobParseErr_NonConformingJobDoc,    /* The job document failed to fulfill the model requirements. */
+    eOTA_JobParseErr_BadModelInitParams,     /* There was an invalid initialization parameter used in the document model. */
+    eOTA_JobParseErr_NoContextAvailable,     /* There wasn't an OTA context available. */
+    eOTA_JobParseErr_DeltaNotSupported,      /* The file is a patch but delta updates are disabled. */
+    eOTA_JobParseErr_CompressionNotSupported /* The file is compressed but compressed updates are disabled. */
 } OTA_JobParseErr_t;
 
 
@@ -356,6 +370,106 @@ static void prvUpdateJobStatus( OTA_FileContext_t * C,
 
 static OTA_Err_t prvPublishGetStreamMessage( OTA_FileContext_t * C );
 
+#if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+
+    /* Reset the stream request window of a file context to its initial size. */
+
+    static void prvStreamWindowInit( OTA_FileContext_t * C );
+
+    /* Halve the stream request window after blocks were lost. */
+
+    static void prvStreamWindowShrink( OTA_FileContext_t * C );
+
+    /* Build the block bitmap of the next windowed stream request and return its block offset. */
+
+    static uint32_t prvStreamWindowRequest( OTA_FileContext_t * C,
+                                            TickType_t xNow,
+                                            uint8_t * pucBitmap,
+                                            uint32_t * pulBitmapLen );
+
+    /* Account for a newly received block in the stream request window. */
+
+    static void prvStreamWindowReceived( OTA_FileContext_t * C,
+                                         uint32_t ulBlockIndex,
+                                         TickType_t xNow );
+#endif /* otaconfigENABLE_STREAM_WINDOW */
+
+#if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+
+    /* Start applying the patch received in the file of a context. */
+
+    static OTA_Err_t prvDeltaStart( OTA_FileContext_t * C );
+
+    /* Apply a block of the patch received in the file of a context and return its size, or a negative error. */
+
+    static int32_t prvDeltaApply( OTA_FileContext_t * C,
+                                  const uint8_t * pucData,
+                                  uint32_t ulBlockSize );
+
+    /* Check that the patch of a context is complete, and make its new file the file of the context. */
+
+    static bool_t prvDeltaFinish( OTA_FileContext_t * C );
+
+    /* Stop applying the patch of a context and free its state. */
+
+    static void prvDeltaStop( OTA_FileContext_t * C );
+#endif /* otaconfigENABLE_DELTA_UPDATE */
+
+#if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+
+    /* Start decompressing the file of a context. */
+
+    static OTA_Err_t prvDecompressStart( OTA_FileContext_t * C );
+
+    /* Decompress a block of the file of a context and return its size, or a negative error. */
+
+    static int32_t prvDecompressApply( OTA_FileContext_t * C,
+                                       const uint8_t * pucData,
+                                       uint32_t ulBlockSize );
+
+    /* Check that the compressed file of a context is complete, and make the decompressed file the file of the context. */
+
+    static bool_t prvDecompressFinish( OTA_FileContext_t * C );
+
+    /* Stop decompressing the file of a context and free its state. */
+
+    static void prvDecompressStop( OTA_FileContext_t * C );
+#endif /* otaconfigENABLE_COMPRESSED_UPDATE */
+
+#if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+
+    /* Start hashing the file of a context as its blocks are received. */
+
+    static void prvSignatureStart( OTA_FileContext_t * C );
+
+    /* Hash a newly received block, or keep it until the blocks before it are hashed. */
+
+    static void prvSignatureUpdate( OTA_FileContext_t * C,
+                                    uint32_t ulBlockIndex,
+                                    const uint8_t * pucData,
+                                    uint32_t ulBlockSize );
+
+    /* Stop hashing the file of a context as its blocks are received and free the resources used. */
+
+    static void prvSignatureStop( OTA_FileContext_t * C );
+#endif /* otaconfigENABLE_STREAMING_SIGNATURE_CHECK */
+
+#if ( otaconfigENABLE_RESUME == 1 )
+
+    /* Save which blocks of the file of a context were received, to resume its download after a reset. */
+
+    static void prvResumeSave( OTA_FileContext_t * C );
+
+    /* Resume the download of the file of a context partly received before a reset, if its saved state matches. */
+
+    static bool_t prvResumeLoad( OTA_FileContext_t * C,
+                                 uint32_t ulBitmapLen );
+
+    /* Erase the saved resume state once the download it belongs to is over. */
+
+    static void prvResumeErase( void );
+#endif /* otaconfigENABLE_RESUME */
+
 /* Internal function to set the image state including an optional reason code. */
 
 static OTA_Err_t prvSetImageStateWithReason( OTA_ImageState_t eState,
@@ -381,7 +495,7 @@ static DocParseErr_t prvSearchModelForTokenKey( JSON_DocModel_t * pxDocModel,
 
 static DocParseErr_t prvInitDocModel( JSON_DocModel_t * pxDocModel,
                                       const JSON_DocParam_t * pxBodyDef,
-                                      uint32_t ulContextBaseAddr,
+                                      uintptr_t uxContextBaseAddr,
                                       uint32_t ulContextSize,
                                       uint16_t usNumJobParams );
 
@@ -742,6 +856,11 @@ static void prvAgentShutdownCleanup( OTA_PubMsg_t * pxMsgMetaData )
     /* Close any open OTA transfers. */
     for( ulIndex = 0; ulIndex < OTA_MAX_FILES; ulIndex++ )
     {
+        #if ( otaconfigENABLE_RESUME == 1 )
+            /* Save the blocks received so far, to resume the download when the agent is started again. */
+            prvResumeSave( &xOTA_Agent.xOTA_Files[ ulIndex ] );
+        #endif
+
         if( prvOTA_Close( &xOTA_Agent.xOTA_Files[ ulIndex ] ) == ( bool_t ) pdFALSE )
         {
             OTA_LOG_L1( "[%s] Error! OTA_FileContext_t[%u] pointer is null.\r\n", OTA_METHOD_NAME, ulIndex );
@@ -949,6 +1068,14 @@ static OTA_Err_t prvSetImageStateWithReason( OTA_ImageState_t eState,
 
         xOTA_Agent.eImageState = eState;
 
+        #if ( otaconfigENABLE_RESUME == 1 )
+            /* A job which was aborted or rejected isn't resumed. */
+            if( ( eState == eOTA_ImageState_Aborted ) || ( eState == eOTA_ImageState_Rejected ) )
+            {
+                prvResumeErase();
+            }
+        #endif
+
         if( xOTA_Agent.pucOTA_Singleton_ActiveJobName != NULL )
         {
             if( eState == eOTA_ImageState_Testing )
@@ -1175,18 +1302,34 @@ static OTA_Err_t prvPublishGetStreamMessage( OTA_FileContext_t * C )
 
     uint32_t ulMsgSizeToPublish;
     size_t xMsgSizeFromStream;
-    uint32_t ulNumBlocks, ulBitmapLen, ulTopicLen;
+    uint32_t ulBitmapLen, ulBlockOffset, ulTopicLen;
+    uint8_t * pucBitmap;
     MQTTAgentReturnCode_t eResult;
     OTA_Err_t xErr = kOTA_Err_None;
     char cMsg[ OTA_REQUEST_MSG_MAX_SIZE ];
     char cTopicBuffer[ OTA_MAX_TOPIC_LEN ];
 
+    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+        uint8_t ucWindowBitmap[ OTA_WINDOW_BITMAP_SIZE ];
+    #else
+        uint32_t ulNumBlocks;
+    #endif
+
     if( C != NULL )
     {
         if( C->ulRequestMomentum < OTA_MAX_STREAM_REQUEST_MOMENTUM )
         {
-            ulNumBlocks = ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
-            ulBitmapLen = ( ulNumBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+            #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                /* Only ask for the blocks of the next window. */
+                ulBlockOffset = prvStreamWindowRequest( C, xTaskGetTickCount(), ucWindowBitmap, &ulBitmapLen );
+                pucBitmap = ucWindowBitmap;
+            #else
+                /* Ask for every block not received yet. */
+                ulNumBlocks = ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+                ulBitmapLen = ( ulNumBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+                ulBlockOffset = 0U;
+                pucBitmap = C->pucRxBlockBitmap;
+            #endif
 
             if( pdTRUE == OTA_CBOR_Encode_GetStreamRequestMessage(
                     ( uint8_t * ) cMsg,
@@ -1195,8 +1338,8 @@ static OTA_Err_t prvPublishGetStreamMessage( OTA_FileContext_t * C )
                     OTA_CLIENT_TOKEN,
                     ( int32_t ) C->ulServerFileID,
                     ( int32_t ) ( OTA_FILE_BLOCK_SIZE & 0x7fffffffUL ), /* Mask to keep lint happy. It's still a constant. */
-                    0,
-                    C->pucRxBlockBitmap,
+                    ( int32_t ) ulBlockOffset,
+                    pucBitmap,
                     ulBitmapLen ) )
             {
                 ulMsgSizeToPublish = ( uint32_t ) xMsgSizeFromStream;
@@ -1263,6 +1406,198 @@ static OTA_Err_t prvPublishGetStreamMessage( OTA_FileContext_t * C )
     return xErr;
 }
 
+#if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+
+/* Reset the stream request window of a file context to its initial size. Until the
+ * round trip time is measured, wait as long as for the whole bitmap requests. */
+
+    static void prvStreamWindowInit( OTA_FileContext_t * C )
+    {
+        C->ulWindowBlocks = otaconfigSTREAM_WINDOW_INITIAL_BLOCKS;
+        C->ulWindowThreshold = otaconfigSTREAM_WINDOW_MAX_BLOCKS;
+        C->ulWindowStart = 0U;
+        C->ulWindowEnd = 0U;
+        C->ulWindowOutstanding = 0U;
+        C->xWindowSentTime = 0U;
+        C->xSmoothedRTT = 0U;
+        C->xRTTVariation = 0U;
+        C->xWindowTimeout = pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS );
+        C->xWindowRTTPending = false;
+    }
+
+
+/* Halve the stream request window after blocks were lost, most likely because too many
+ * were in flight, and remember the size at which it happened. */
+
+    static void prvStreamWindowShrink( OTA_FileContext_t * C )
+    {
+        C->ulWindowThreshold = C->ulWindowBlocks >> 1U;
+
+        if( C->ulWindowThreshold == 0U )
+        {
+            C->ulWindowThreshold = 1U;
+        }
+
+        C->ulWindowBlocks = C->ulWindowThreshold;
+    }
+
+
+/* Build the block bitmap of the next windowed stream request.
+ *
+ * The window starts at the byte of the bitmap holding the first missing block and covers
+ * the next ulWindowBlocks missing blocks. If blocks of the previous window are still
+ * missing, its request timed out, so the window is halved and the next wait doubled
+ * before asking for them again. The round trip time of such a repeated request is not
+ * measured since the blocks received may answer either request. Returns the block offset
+ * of the bitmap.
+ */
+
+    static uint32_t prvStreamWindowRequest( OTA_FileContext_t * C,
+                                            TickType_t xNow,
+                                            uint8_t * pucBitmap,
+                                            uint32_t * pulBitmapLen )
+    {
+        uint32_t ulNumBlocks = ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+        uint32_t ulByte = C->ulWindowStart >> LOG2_BITS_PER_BYTE;
+        uint32_t ulOffset, ulBlock, ulBit, ulRequested = 0U;
+        uint8_t ucBitMask;
+
+        if( C->ulWindowOutstanding > 0U )
+        {
+            prvStreamWindowShrink( C );
+            C->xWindowTimeout <<= 1U;
+
+            if( C->xWindowTimeout > pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS ) )
+            {
+                C->xWindowTimeout = pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS );
+            }
+
+            C->xWindowRTTPending = false;
+        }
+        else
+        {
+            C->xWindowRTTPending = true;
+        }
+
+        /* Every block before the previous window has been received. */
+        while( ( ( ulByte << LOG2_BITS_PER_BYTE ) < ulNumBlocks ) && ( C->pucRxBlockBitmap[ ulByte ] == 0U ) )
+        {
+            ulByte++;
+        }
+
+        ulOffset = ulByte << LOG2_BITS_PER_BYTE;
+        C->ulWindowEnd = ulOffset;
+        memset( pucBitmap, 0, OTA_WINDOW_BITMAP_SIZE );
+
+        for( ulBlock = ulOffset;
+             ( ulBlock < ulNumBlocks ) && ( ulRequested < C->ulWindowBlocks ) && ( ( ulBlock - ulOffset ) < ( OTA_WINDOW_BITMAP_SIZE * BITS_PER_BYTE ) );
+             ulBlock++ )
+        {
+            ucBitMask = 1U << ( ulBlock % BITS_PER_BYTE ); /*lint !e9031 The composite expression will never be greater than BITS_PER_BYTE(8). */
+
+            if( ( C->pucRxBlockBitmap[ ulBlock >> LOG2_BITS_PER_BYTE ] & ucBitMask ) != 0U )
+            {
+                ulBit = ulBlock - ulOffset;
+                pucBitmap[ ulBit >> LOG2_BITS_PER_BYTE ] |= ucBitMask;
+                C->ulWindowEnd = ulBlock + 1U;
+                ulRequested++;
+            }
+        }
+
+        C->ulWindowStart = ulOffset;
+        C->ulWindowOutstanding = ulRequested;
+        C->xWindowSentTime = xNow;
+        *pulBitmapLen = ( ( C->ulWindowEnd - ulOffset ) + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+
+        return ulOffset;
+    }
+
+
+/* Account for a newly received block in the stream request window.
+ *
+ * The first block answering a request measures its round trip time, which is smoothed
+ * as TCP does to derive the time to wait before asking for missing blocks again. Once
+ * every block of the window has been received, the window doubles, or grows by one
+ * block once it has reached the size at which blocks were last lost. The stream service
+ * sends the blocks in order, so blocks still missing when the last one arrives were
+ * lost: the window is halved and marked as received so that they are asked for again
+ * right away instead of after the wait.
+ */
+
+    static void prvStreamWindowReceived( OTA_FileContext_t * C,
+                                         uint32_t ulBlockIndex,
+                                         TickType_t xNow )
+    {
+        TickType_t xRTT, xDelta;
+
+        if( ( ulBlockIndex >= C->ulWindowStart ) && ( ulBlockIndex < C->ulWindowEnd ) && ( C->ulWindowOutstanding > 0U ) )
+        {
+            if( C->xWindowRTTPending == true )
+            {
+                xRTT = xNow - C->xWindowSentTime;
+
+                if( C->xSmoothedRTT == 0U )
+                {
+                    C->xSmoothedRTT = xRTT;
+                    C->xRTTVariation = xRTT >> 1U;
+                }
+                else
+                {
+                    xDelta = ( xRTT > C->xSmoothedRTT ) ? ( xRTT - C->xSmoothedRTT ) : ( C->xSmoothedRTT - xRTT );
+                    C->xRTTVariation = ( ( 3U * C->xRTTVariation ) + xDelta ) >> 2U;
+                    C->xSmoothedRTT = ( ( 7U * C->xSmoothedRTT ) + xRTT ) >> 3U;
+                }
+
+                C->xWindowTimeout = C->xSmoothedRTT + ( 4U * C->xRTTVariation );
+
+                if( C->xWindowTimeout < pdMS_TO_TICKS( otaconfigSTREAM_WINDOW_MIN_WAIT_MS ) )
+                {
+                    C->xWindowTimeout = pdMS_TO_TICKS( otaconfigSTREAM_WINDOW_MIN_WAIT_MS );
+                }
+                else if( C->xWindowTimeout > pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS ) )
+                {
+                    C->xWindowTimeout = pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS );
+                }
+                else
+                {
+                    /* The wait is within bounds. */
+                }
+
+                C->xWindowRTTPending = false;
+            }
+
+            C->ulWindowOutstanding--;
+
+            if( ( C->ulWindowOutstanding > 0U ) && ( ulBlockIndex == ( C->ulWindowEnd - 1U ) ) )
+            {
+                prvStreamWindowShrink( C );
+                C->ulWindowOutstanding = 0U;
+            }
+            else if( C->ulWindowOutstanding == 0U )
+            {
+                if( C->ulWindowBlocks < C->ulWindowThreshold )
+                {
+                    C->ulWindowBlocks <<= 1U;
+                }
+                else
+                {
+                    C->ulWindowBlocks++;
+                }
+
+                if( C->ulWindowBlocks > otaconfigSTREAM_WINDOW_MAX_BLOCKS )
+                {
+                    C->ulWindowBlocks = otaconfigSTREAM_WINDOW_MAX_BLOCKS;
+                }
+            }
+            else
+            {
+                /* Blocks of the window are still on their way. */
+            }
+        }
+    }
+
+#endif /* otaconfigENABLE_STREAM_WINDOW */
+
 
 /* This function is called whenever we receive a MQTT publish message on one of our OTA topics. */
 
@@ -1436,6 +1771,14 @@ static void prvOTAUpdateTask( void * pvUnused )
                                 else
                                 {
                                     xOTA_Agent.eState = eOTA_AgentState_Active;
+
+                                    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                                        /* Ask for the first window right away instead of waiting for the request timer. */
+                                        if( pxC->ulBlocksRemaining > 0U )
+                                        {
+                                            ( void ) prvPublishGetStreamMessage( pxC ); /* The request timer retries on failure. */
+                                        }
+                                    #endif
                                 }
                             }
                             /* It's not a job message, maybe it's a data stream message... */
@@ -1456,6 +1799,11 @@ static void prvOTAUpdateTask( void * pvUnused )
                                          * because we are either done or in an unrecoverable error state.
                                          * We don't want to hang on to the resources. */
 
+                                        #if ( otaconfigENABLE_RESUME == 1 )
+                                            /* The download is over, so there is nothing to resume after a reset. */
+                                            prvResumeErase();
+                                        #endif
+
                                         if( xResult == eIngest_Result_FileComplete )
                                         {
                                             /* File receive is complete and authenticated. Update the job status with the self_test ready identifier. */
@@ -1498,6 +1846,14 @@ static void prvOTAUpdateTask( void * pvUnused )
                                       /* First reset the momentum counter since we received a good block. */
                                         pxC->ulRequestMomentum = 0;
                                         prvUpdateJobStatus( pxC, eJobStatus_InProgress, ( int32_t ) eJobReason_Receiving, ( int32_t ) NULL );
+
+                                        #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                                            /* Ask for the next window as soon as the current one is received. */
+                                            if( pxC->ulWindowOutstanding == 0U )
+                                            {
+                                                ( void ) prvPublishGetStreamMessage( pxC ); /* The request timer retries on failure. */
+                                            }
+                                        #endif
                                     }
                                 }
                             }
@@ -1647,7 +2003,8 @@ static void prvRequestTimer_Callback( TimerHandle_t T )
 
 /* Create and start or reset the OTA request timer to kick off the process if needed.
  * Do not output an important log message on reset since this gets called every time a file
- * block is received. Use log level 2 at most.
+ * block is received. Use log level 2 at most. With windowed stream requests, the timer
+ * period follows the wait derived from the round trip time of the requests.
  */
 static void prvStartRequestTimer( OTA_FileContext_t * C )
 {
@@ -1656,10 +2013,16 @@ static void prvStartRequestTimer( OTA_FileContext_t * C )
 
     BaseType_t xTimerStarted = pdFALSE;
 
+    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+        TickType_t xPeriod = C->xWindowTimeout;
+    #else
+        TickType_t xPeriod = pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS );
+    #endif
+
     if( C->xRequestTimer == NULL )
     {
         C->xRequestTimer = xTimerCreate( cTimerName,
-                                         pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS ),
+                                         xPeriod,
                                          pdFALSE,
                                          ( void * ) C, /*lint !e9087 Using the file context as the timer ID does not cause undefined behavior. */
                                          prvRequestTimer_Callback );
@@ -1671,7 +2034,12 @@ static void prvStartRequestTimer( OTA_FileContext_t * C )
     }
     else
     {
-        xTimerStarted = xTimerReset( C->xRequestTimer, portMAX_DELAY );
+        #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+            /* Changing the period also restarts the timer. */
+            xTimerStarted = xTimerChangePeriod( C->xRequestTimer, xPeriod, portMAX_DELAY );
+        #else
+            xTimerStarted = xTimerReset( C->xRequestTimer, portMAX_DELAY );
+        #endif
     }
 
     if( xTimerStarted == pdTRUE )
@@ -1744,6 +2112,18 @@ static bool_t prvOTA_Close( OTA_FileContext_t * const C )
             C->pxSignature = NULL;
         }
 
+        #if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+            prvDeltaStop( C );
+        #endif
+
+        #if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+            prvDecompressStop( C );
+        #endif
+
+        #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+            prvSignatureStop( C );
+        #endif
+
         if( C->pucFilePath != NULL )
         {
             vPortFree( C->pucFilePath ); /* Free the file path name string memory. */
@@ -1859,20 +2239,15 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
     DEFINE_OTA_METHOD_NAME( "prvParseJSONbyModel" );
 
     const JSON_DocParam_t * pxModelParam;
-    jsmn_parser xParser;
-    jsmntok_t * pxTokens;
-    jsmntok_t * pxValTok;
-    uint32_t ulNumTokens, ulTokenLen;
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    JSONScanStatus_t eScanStatus = eJSONScanPartial;
+    uint32_t ulElements = 0U;
     MultiParmPtr_t xParamAddr; /*lint !e9018 We intentionally use this union to cast the parameter address to the proper type. */
-    uint32_t ulIndex;
     uint16_t usModelParamIndex;
     uint32_t ulScanIndex;
     DocParseErr_t eErr = eDocParseErr_Unknown;
 
-
-    /* Reset the Jasmine tokenizer. */
-    jsmn_init( &xParser );
-
     /* Validate some initial parameters. */
     if( pxDocModel == NULL )
     {
@@ -1898,267 +2273,237 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
     {
         pxModelParam = pxDocModel->pxBodyDef;
 
-        /* Count the total number of tokens in our JSON document. */
-        ulNumTokens = ( uint32_t ) jsmn_parse( &xParser, pcJSON, ( size_t ) ulMsgLen, NULL, 1UL );
-
-        if( ulNumTokens > 0U )
-        {
-            /* If the JSON document isn't too big for our token array... */
-            if( ulNumTokens <= OTA_MAX_JSON_TOKENS )
-            {
-                /* Allocate space for the document JSON tokens. */
-                void * pvTokenArray = pvPortMalloc( ulNumTokens * sizeof( jsmntok_t ) ); /* Allocate space on heap for temporary token array. */
-                pxTokens = ( jsmntok_t * ) pvTokenArray;                                 /*lint !e9079 !e9087 heap allocations return void* so we allow casting to a pointer to the actual type. */
-
-                if( pxTokens != NULL )
-                {
-                    /* Reset Jasmine again and tokenize the document for real. */
-                    jsmn_init( &xParser );
-                    ulIndex = ( uint32_t ) jsmn_parse( &xParser, pcJSON, ulMsgLen, pxTokens, ulNumTokens );
-
-                    if( ulIndex == ulNumTokens )
-                    {
-                        /* Start the parser in an error free state. */
-                        eErr = eDocParseErr_None;
-
-                        /* Examine each JSON token, searching for job parameters based on our document model. */
-                        for( ulIndex = 0U; ( eErr == eDocParseErr_None ) && ( ulIndex < ulNumTokens ); ulIndex++ )
-                        {
-                            /* All parameter keys are JSON strings. */
-                            if( pxTokens[ ulIndex ].type == JSMN_STRING )
-                            {
-                                /* Search the document model to see if it matches the current key. */
-                                ulTokenLen = ( uint32_t ) pxTokens[ ulIndex ].end - ( uint32_t ) pxTokens[ ulIndex ].start;
-                                eErr = prvSearchModelForTokenKey( pxDocModel, &pcJSON[ pxTokens[ ulIndex ].start ], ulTokenLen, &usModelParamIndex );
+        /* Start the parser in an error free state. */
+        eErr = eDocParseErr_None;
 
-                                /* If we didn't find a match in the model, skip over it and its descendants. */
-                                if( eErr == eDocParseErr_ParamKeyNotInModel )
-                                {
-                                    int32_t lRoot = ( int32_t ) ulIndex; /* Create temp root from the unrecognized tokens index. Use signed int since the parent index is signed. */
-                                    ulIndex++;                           /* Skip the active key since it's the one we don't recognize. */
+        /* Scan the JSON document in a single pass, searching for job parameters based on our
+         * document model. The whole document is scanned so that duplicate parameters are found. */
+        JSON_ScanInit( &xScanner, pcJSON, ulMsgLen );
 
-                                    /* Skip tokens whose parents are equal to or deeper than the unrecognized temporary root token level. */
-                                    while( ( ulIndex < ulNumTokens ) && ( pxTokens[ ulIndex ].parent >= lRoot ) )
-                                    {
-                                        ulIndex++; /* Skip over all descendants of the unknown parent. */
-                                    }
+        while( eErr == eDocParseErr_None )
+        {
+            eScanStatus = JSON_ScanNext( &xScanner, &xElement );
 
-                                    --ulIndex;                /* Adjust for outer for-loop increment. */
-                                    eErr = eDocParseErr_None; /* Unknown key structures are simply skipped so clear the error state to continue. */
-                                }
-                                else if( eErr == eDocParseErr_None )
-                                {
-                                    /* We found the parameter key in the document model. */
+            if( eScanStatus != eJSONScanSuccess )
+            {
+                break;
+            }
 
-                                    /* Get the value field (i.e. the following token) for the parameter. */
-                                    pxValTok = &pxTokens[ ulIndex + 1UL ];
+            ulElements++;
 
-                                    /* Verify the field type is what we expect for this parameter. */
-                                    if( pxValTok->type != pxModelParam[ usModelParamIndex ].eJasmineType )
-                                    {
-                                        ulTokenLen = ( uint32_t ) ( pxValTok->end ) - ( uint32_t ) ( pxValTok->start );
-                                        OTA_LOG_L1( "[%s] parameter type mismatch [ %s : %.*s ] type %u, expected %u\r\n",
-                                                    OTA_METHOD_NAME, pxModelParam[ usModelParamIndex ].pcSrcKey, ulTokenLen,
-                                                    &pcJSON[ pxValTok->start ],
-                                                    pxValTok->type, pxModelParam[ usModelParamIndex ].eJasmineType );
-                                        eErr = eDocParseErr_FieldTypeMismatch;
-                                        /* break; */
-                                    }
-                                    else if( OTA_DONT_STORE_PARAM == pxModelParam[ usModelParamIndex ].ulDestOffset )
-                                    {
-                                        /* Nothing to do with this parameter since we're not storing it. */
-                                        continue;
-                                    }
-                                    else
-                                    {
-                                        /* Get destination offset to parameter storage location. */
+            /* All parameters are values of objects, with a key. */
+            if( xElement.pcKey == NULL )
+            {
+                /* Ignore array values and the ends of objects and arrays and move on to the next. */
+                continue;
+            }
 
-                                        /* If it's within the models context structure, add in the context instance base address. */
-                                        if( pxModelParam[ usModelParamIndex ].ulDestOffset < pxDocModel->ulContextSize )
-                                        {
-                                            xParamAddr.ulVal = pxDocModel->ulContextBase + pxModelParam[ usModelParamIndex ].ulDestOffset;
-                                        }
-                                        else
-                                        {
-                                            /* It's a raw pointer so keep it as is. */
-                                            xParamAddr.ulVal = pxModelParam[ usModelParamIndex ].ulDestOffset;
-                                        }
+            /* Search the document model to see if it matches the current key. */
+            eErr = prvSearchModelForTokenKey( pxDocModel, xElement.pcKey, xElement.ulKeyLength, &usModelParamIndex );
 
-                                        if( eModelParamType_StringCopy == pxModelParam[ usModelParamIndex ].xModelParamType )
-                                        {
-                                            /* Malloc memory for a copy of the value string plus a zero terminator. */
-                                            ulTokenLen = ( uint32_t ) ( pxValTok->end ) - ( uint32_t ) ( pxValTok->start );
-                                            void * pvStringCopy = pvPortMalloc( ulTokenLen + 1U );
+            /* If we didn't find a match in the model, skip over it and its descendants. */
+            if( eErr == eDocParseErr_ParamKeyNotInModel )
+            {
+                if( ( xElement.eType == eJSONScanObject ) || ( xElement.eType == eJSONScanArray ) )
+                {
+                    eScanStatus = JSON_ScanSkip( &xScanner, &xElement );
 
-                                            if( pvStringCopy != NULL )
-                                            {
-                                                *xParamAddr.ppvPtr = pvStringCopy;
-                                                char * pcStringCopy = *xParamAddr.ppcPtr;
-                                                /* Copy parameter string into newly allocated memory. */
-                                                memcpy( pcStringCopy, &pcJSON[ pxValTok->start ], ulTokenLen );
-                                                /* Zero terminate the new string. */
-                                                pcStringCopy[ ulTokenLen ] = '\0';
-                                                OTA_LOG_L1( "[%s] Extracted parameter [ %s: %s ]\r\n",
-                                                            OTA_METHOD_NAME,
-                                                            pxModelParam[ usModelParamIndex ].pcSrcKey,
-                                                            pcStringCopy );
-                                            }
-                                            else
-                                            {   /* Stop processing on error. */
-                                                eErr = eDocParseErr_OutOfMemory;
-                                                /* break; */
-                                            }
-                                        }
-                                        else if( eModelParamType_StringInDoc == pxModelParam[ usModelParamIndex ].xModelParamType )
-                                        {
-                                            /* Copy pointer to source string instead of duplicating the string. */
-                                            const char * pcStringInDoc = &pcJSON[ pxValTok->start ];
+                    if( eScanStatus != eJSONScanSuccess )
+                    {
+                        break;
+                    }
+                }
 
-                                            if( pcStringInDoc != NULL ) /*lint !e774 This can result in NULL if offset rolls the address around. */
-                                            {
-                                                *xParamAddr.ppcConstPtr = pcStringInDoc;
-                                                ulTokenLen = ( uint32_t ) ( pxValTok->end ) - ( uint32_t ) ( pxValTok->start );
-                                                OTA_LOG_L1( "[%s] Extracted parameter [ %s: %.*s ]\r\n",
-                                                            OTA_METHOD_NAME,
-                                                            pxModelParam[ usModelParamIndex ].pcSrcKey,
-                                                            ulTokenLen, pcStringInDoc );
-                                            }
-                                            else
-                                            {
-                                                /* This should never happen unless there's a bug or memory is corrupted. */
-                                                OTA_LOG_L1( "[%s] Error! JSON token produced a null pointer for parameter [ %s ]\r\n",
-                                                            OTA_METHOD_NAME,
-                                                            pxModelParam[ usModelParamIndex ].pcSrcKey );
-                                                eErr = eDocParseErr_InvalidToken;
-                                            }
-                                        }
-                                        else if( eModelParamType_UInt32 == pxModelParam[ usModelParamIndex ].xModelParamType )
-                                        {
-                                            char * pcEnd;
-                                            const char * pcStart = &pcJSON[ pxValTok->start ];
-                                            *xParamAddr.pulPtr = strtoul( pcStart, &pcEnd, 0 );
+                eErr = eDocParseErr_None; /* Unknown key structures are simply skipped so clear the error state to continue. */
+            }
+            else if( eErr == eDocParseErr_None )
+            {
+                /* We found the parameter key in the document model. */
 
-                                            if( pcEnd == &pcJSON[ pxValTok->end ] )
-                                            {
-                                                OTA_LOG_L1( "[%s] Extracted parameter [ %s: %u ]\r\n",
-                                                            OTA_METHOD_NAME,
-                                                            pxModelParam[ usModelParamIndex ].pcSrcKey,
-                                                            *xParamAddr.pulPtr );
-                                            }
-                                            else
-                                            {
-                                                eErr = eDocParseErr_InvalidNumChar;
-                                            }
-                                        }
-                                        else if( eModelParamType_SigBase64 == pxModelParam[ usModelParamIndex ].xModelParamType )
-                                        {
-                                            /* Allocate space for and decode the base64 signature. */
-                                            void * pvSignature = pvPortMalloc( sizeof( Sig256_t ) );
+                /* Verify the field type is what we expect for this parameter. */
+                if( xElement.eType != pxModelParam[ usModelParamIndex ].eJSONType )
+                {
+                    OTA_LOG_L1( "[%s] parameter type mismatch [ %s : %.*s ] type %u, expected %u\r\n",
+                                OTA_METHOD_NAME, pxModelParam[ usModelParamIndex ].pcSrcKey, xElement.ulValueLength,
+                                xElement.pcValue,
+                                xElement.eType, pxModelParam[ usModelParamIndex ].eJSONType );
+                    eErr = eDocParseErr_FieldTypeMismatch;
+                    /* break; */
+                }
+                else if( OTA_DONT_STORE_PARAM == pxModelParam[ usModelParamIndex ].uxDestOffset )
+                {
+                    /* Nothing to do with this parameter since we're not storing it. The values of
+                     * an object or an array are scanned next. */
+                    continue;
+                }
+                else
+                {
+                    /* Get destination offset to parameter storage location. */
 
-                                            if( pvSignature != NULL )
-                                            {
-                                                size_t xActualLen;
-                                                *xParamAddr.ppvPtr = pvSignature;
-                                                Sig256_t * pxSig256 = *xParamAddr.ppxSig256Ptr;
-                                                ulTokenLen = ( uint32_t ) ( pxValTok->end ) - ( uint32_t ) ( pxValTok->start );
-
-                                                if( mbedtls_base64_decode( pxSig256->ucData, sizeof( pxSig256->ucData ), &xActualLen,
-                                                                           ( const uint8_t * ) &pcJSON[ pxValTok->start ], ulTokenLen ) != 0 )
-                                                {   /* Stop processing on error. */
-                                                    OTA_LOG_L1( "[%s] mbedtls_base64_decode failed.\r\n", OTA_METHOD_NAME );
-                                                    eErr = eDocParseErr_Base64Decode;
-                                                    /* break; */
-                                                }
-                                                else
-                                                {
-                                                    pxSig256->usSize = ( uint16_t ) xActualLen;
-                                                    OTA_LOG_L1( "[%s] Extracted parameter [ %s: %.32s... ]\r\n",
-                                                                OTA_METHOD_NAME,
-                                                                pxModelParam[ usModelParamIndex ].pcSrcKey,
-                                                                &pcJSON[ pxValTok->start ] );
-                                                }
-                                            }
-                                            else
-                                            {
-                                                /* We failed to allocate needed memory. Everything will be freed below upon failure. */
-                                                eErr = eDocParseErr_OutOfMemory;
-                                            }
-                                        }
-                                        else if( eModelParamType_Ident == pxModelParam[ usModelParamIndex ].xModelParamType )
-                                        {
-                                            OTA_LOG_L1( "[%s] Identified parameter [ %s ]\r\n",
-                                                        OTA_METHOD_NAME,
-                                                        pxModelParam[ usModelParamIndex ].pcSrcKey );
-                                            *xParamAddr.pxBoolPtr = pdTRUE;
-                                        }
-                                        else
-                                        {
-                                            /* Ignore invalid document model type. */
-                                        }
-                                    }
-                                }
-                                else
-                                {
-                                    /* Nothing special to do. The error will break us out of the loop. */
-                                }
-                            }
-                            else
-                            {
-                                /* Ignore tokens that are not strings and move on to the next. */
-                            }
-                        }
+                    /* If it's within the models context structure, add in the context instance base address. */
+                    if( pxModelParam[ usModelParamIndex ].uxDestOffset < pxDocModel->ulContextSize )
+                    {
+                        xParamAddr.uxVal = pxDocModel->uxContextBase + pxModelParam[ usModelParamIndex ].uxDestOffset;
+                    }
+                    else
+                    {
+                        /* It's a raw pointer so keep it as is. */
+                        xParamAddr.uxVal = pxModelParam[ usModelParamIndex ].uxDestOffset;
+                    }
 
-                        /* Free the token memory. */
-                        vPortFree( pxTokens ); /*lint !e850 ulIndex is intentionally modified within the loop to skip over unknown tags. */
+                    if( eModelParamType_StringCopy == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        /* Malloc memory for a copy of the value string plus a zero terminator. */
+                        void * pvStringCopy = pvPortMalloc( xElement.ulValueLength + 1U );
 
-                        if( eErr == eDocParseErr_None )
+                        if( pvStringCopy != NULL )
                         {
-                            uint32_t ulMissingParams = ( pxDocModel->ulParamsReceivedBitmap & pxDocModel->ulParamsRequiredBitmap )
-                                                       ^ pxDocModel->ulParamsRequiredBitmap;
-
-                            if( ulMissingParams != 0U )
-                            {
-                                /* The job document did not have all required document model parameters. */
-                                for( ulScanIndex = 0UL; ulScanIndex < pxDocModel->usNumModelParams; ulScanIndex++ )
-                                {
-                                    if( ( ulMissingParams & ( 1UL << ulScanIndex ) ) != 0UL )
-                                    {
-                                        OTA_LOG_L1( "[%s] parameter not present: %s\r\n",
-                                                    OTA_METHOD_NAME,
-                                                    pxModelParam[ ulScanIndex ].pcSrcKey );
-                                    }
-                                }
-
-                                eErr = eDocParseErr_MalformedDoc;
-                            }
+                            *xParamAddr.ppvPtr = pvStringCopy;
+                            char * pcStringCopy = *xParamAddr.ppcPtr;
+                            /* Copy parameter string into newly allocated memory. */
+                            memcpy( pcStringCopy, xElement.pcValue, xElement.ulValueLength );
+                            /* Zero terminate the new string. */
+                            pcStringCopy[ xElement.ulValueLength ] = '\0';
+                            OTA_LOG_L1( "[%s] Extracted parameter [ %s: %s ]\r\n",
+                                        OTA_METHOD_NAME,
+                                        pxModelParam[ usModelParamIndex ].pcSrcKey,
+                                        pcStringCopy );
                         }
                         else
-                        {
-                            OTA_LOG_L1( "[%s] Error (%d) parsing JSON document.\r\n", OTA_METHOD_NAME, ( int32_t ) eErr );
+                        {   /* Stop processing on error. */
+                            eErr = eDocParseErr_OutOfMemory;
+                            /* break; */
                         }
                     }
+                    else if( eModelParamType_StringInDoc == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        /* Copy pointer to source string instead of duplicating the string. */
+                        const char * pcStringInDoc = xElement.pcValue;
+
+                        if( pcStringInDoc != NULL ) /*lint !e774 This can result in NULL if offset rolls the address around. */
+                        {
+                            *xParamAddr.ppcConstPtr = pcStringInDoc;
+                            OTA_LOG_L1( "[%s] Extracted parameter [ %s: %.*s ]\r\n",
+                                        OTA_METHOD_NAME,
+                                        pxModelParam[ usModelParamIndex ].pcSrcKey,
+                                        xElement.ulValueLength, pcStringInDoc );
+                        }
+                        else
+                        {
+                            /* This should never happen unless there's a bug or memory is corrupted. */
+                            OTA_LOG_L1( "[%s] Error! JSON value produced a null pointer for parameter [ %s ]\r\n",
+                                        OTA_METHOD_NAME,
+                                        pxModelParam[ usModelParamIndex ].pcSrcKey );
+                            eErr = eDocParseErr_InvalidToken;
+                        }
+                    }
+                    else if( eModelParamType_UInt32 == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        char * pcEnd;
+                        const char * pcStart = xElement.pcValue;
+                        *xParamAddr.pulPtr = strtoul( pcStart, &pcEnd, 0 );
+
+                        if( pcEnd == &pcStart[ xElement.ulValueLength ] )
+                        {
+                            OTA_LOG_L1( "[%s] Extracted parameter [ %s: %u ]\r\n",
+                                        OTA_METHOD_NAME,
+                                        pxModelParam[ usModelParamIndex ].pcSrcKey,
+                                        *xParamAddr.pulPtr );
+                        }
+                        else
+                        {
+                            eErr = eDocParseErr_InvalidNumChar;
+                        }
+                    }
+                    else if( eModelParamType_SigBase64 == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        /* Allocate space for and decode the base64 signature. */
+                        void * pvSignature = pvPortMalloc( sizeof( Sig256_t ) );
+
+                        if( pvSignature != NULL )
+                        {
+                            size_t xActualLen;
+                            *xParamAddr.ppvPtr = pvSignature;
+                            Sig256_t * pxSig256 = *xParamAddr.ppxSig256Ptr;
+
+                            if( mbedtls_base64_decode( pxSig256->ucData, sizeof( pxSig256->ucData ), &xActualLen,
+                                                       ( const uint8_t * ) xElement.pcValue, xElement.ulValueLength ) != 0 )
+                            {   /* Stop processing on error. */
+                                OTA_LOG_L1( "[%s] mbedtls_base64_decode failed.\r\n", OTA_METHOD_NAME );
+                                eErr = eDocParseErr_Base64Decode;
+                                /* break; */
+                            }
+                            else
+                            {
+                                pxSig256->usSize = ( uint16_t ) xActualLen;
+                                OTA_LOG_L1( "[%s] Extracted parameter [ %s: %.32s... ]\r\n",
+                                            OTA_METHOD_NAME,
+                                            pxModelParam[ usModelParamIndex ].pcSrcKey,
+                                            xElement.pcValue );
+                            }
+                        }
+                        else
+                        {
+                            /* We failed to allocate needed memory. Everything will be freed below upon failure. */
+                            eErr = eDocParseErr_OutOfMemory;
+                        }
+                    }
+                    else if( eModelParamType_Ident == pxModelParam[ usModelParamIndex ].xModelParamType )
+                    {
+                        OTA_LOG_L1( "[%s] Identified parameter [ %s ]\r\n",
+                                    OTA_METHOD_NAME,
+                                    pxModelParam[ usModelParamIndex ].pcSrcKey );
+                        *xParamAddr.pxBoolPtr = pdTRUE;
+                    }
                     else
                     {
-                        OTA_LOG_L1( "[%s] jsmn_parse didn't match token count when parsing.\r\n", OTA_METHOD_NAME );
-                        eErr = eDocParseErr_JasmineCountMismatch;
+                        /* Ignore invalid document model type. */
                     }
                 }
-                else
+            }
+            else
+            {
+                /* Nothing special to do. The error will break us out of the loop. */
+            }
+        }
+
+        if( eErr == eDocParseErr_None )
+        {
+            if( eScanStatus == eJSONScanEnd )
+            {
+                uint32_t ulMissingParams = ( pxDocModel->ulParamsReceivedBitmap & pxDocModel->ulParamsRequiredBitmap )
+                                           ^ pxDocModel->ulParamsRequiredBitmap;
+
+                if( ulMissingParams != 0U )
                 {
-                    OTA_LOG_L1( "[%s] No memory for JSON tokens.\r\n", OTA_METHOD_NAME );
-                    eErr = eDocParseErr_OutOfMemory;
+                    /* The job document did not have all required document model parameters. */
+                    for( ulScanIndex = 0UL; ulScanIndex < pxDocModel->usNumModelParams; ulScanIndex++ )
+                    {
+                        if( ( ulMissingParams & ( 1UL << ulScanIndex ) ) != 0UL )
+                        {
+                            OTA_LOG_L1( "[%s] parameter not present: %s\r\n",
+                                        OTA_METHOD_NAME,
+                                        pxModelParam[ ulScanIndex ].pcSrcKey );
+                        }
+                    }
+
+                    eErr = eDocParseErr_MalformedDoc;
                 }
             }
+            else if( ulElements == 0U )
+            {
+                OTA_LOG_L1( "[%s] Invalid JSON document. No tokens parsed. \r\n", OTA_METHOD_NAME );
+                eErr = eDocParseErr_NoTokens;
+            }
             else
             {
-                OTA_LOG_L1( "[%s] Document has too many keys.\r\n", OTA_METHOD_NAME );
-                eErr = eDocParseErr_TooManyTokens;
+                OTA_LOG_L1( "[%s] Invalid JSON document. Scanner error %u.\r\n", OTA_METHOD_NAME, eScanStatus );
+                eErr = eDocParseErr_InvalidJSON;
             }
         }
         else
         {
-            OTA_LOG_L1( "[%s] Invalid JSON document. No tokens parsed. \r\n", OTA_METHOD_NAME );
-            eErr = eDocParseErr_NoTokens;
+            OTA_LOG_L1( "[%s] Error (%d) parsing JSON document.\r\n", OTA_METHOD_NAME, ( int32_t ) eErr );
         }
     }
 
@@ -2172,7 +2517,7 @@ static DocParseErr_t prvParseJSONbyModel( const char * pcJSON,
 
 static DocParseErr_t prvInitDocModel( JSON_DocModel_t * pxDocModel,
                                       const JSON_DocParam_t * pxBodyDef,
-                                      uint32_t ulContextBaseAddr,
+                                      uintptr_t uxContextBaseAddr,
                                       uint32_t ulContextSize,
                                       uint16_t usNumJobParams )
 {
@@ -2201,7 +2546,7 @@ static DocParseErr_t prvInitDocModel( JSON_DocModel_t * pxDocModel,
     }
     else
     {
-        pxDocModel->ulContextBase = ulContextBaseAddr;
+        pxDocModel->uxContextBase = uxContextBaseAddr;
         pxDocModel->ulContextSize = ulContextSize;
         pxDocModel->pxBodyDef = pxBodyDef;
         pxDocModel->usNumModelParams = usNumJobParams;
@@ -2239,22 +2584,24 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
     /* Namely union initialization and pointers converted to values. */
     static const JSON_DocParam_t xOTA_JobDocModelParamStructure[ OTA_NUM_JOB_PARAMS ] =
     {
-        { cOTA_JSON_ClientTokenKey,   OTA_JOB_PARAM_OPTIONAL, { ( uint32_t ) &xOTA_Agent.pucClientTokenFromJob }, eModelParamType_StringInDoc, JSMN_STRING    }, /*lint !e9078 !e923 Get address of token as value. */
-        { cOTA_JSON_ExecutionKey,     OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      JSMN_OBJECT    },
-        { cOTA_JSON_JobIDKey,         OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucJobName )     }, eModelParamType_StringCopy,  JSMN_STRING    },
-        { cOTA_JSON_StatusDetailsKey, OTA_JOB_PARAM_OPTIONAL, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      JSMN_OBJECT    },
-        { cOTA_JSON_SelfTestKey,      OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, xIsInSelfTest )  }, eModelParamType_Ident,       JSMN_STRING    },
-        { cOTA_JSON_UpdatedByKey,     OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, ulUpdaterVersion )}, eModelParamType_UInt32,      JSMN_STRING    },
-        { cOTA_JSON_JobDocKey,        OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      JSMN_OBJECT    },
-        { cOTA_JSON_OTAUnitKey,       OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      JSMN_OBJECT    },
-        { cOTA_JSON_StreamNameKey,    OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucStreamName )  }, eModelParamType_StringCopy,  JSMN_STRING    },
-        { cOTA_JSON_FileGroupKey,     OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Array,       JSMN_ARRAY     },
-        { cOTA_JSON_FilePathKey,      OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucFilePath )    }, eModelParamType_StringCopy,  JSMN_STRING    },
-        { cOTA_JSON_FileSizeKey,      OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, ulFileSize )     }, eModelParamType_UInt32,      JSMN_PRIMITIVE },
-        { cOTA_JSON_FileIDKey,        OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, ulServerFileID ) }, eModelParamType_UInt32,      JSMN_PRIMITIVE },
-        { cOTA_JSON_FileCertNameKey,  OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucCertFilepath )}, eModelParamType_StringCopy,  JSMN_STRING    },
-        { cOTA_JSON_FileSignatureKey, OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pxSignature )    }, eModelParamType_SigBase64,   JSMN_STRING    },
-        { cOTA_JSON_FileAttributeKey, OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, ulFileAttributes )}, eModelParamType_UInt32,      JSMN_PRIMITIVE },
+        { cOTA_JSON_ClientTokenKey,   OTA_JOB_PARAM_OPTIONAL, { ( uintptr_t ) &xOTA_Agent.pucClientTokenFromJob }, eModelParamType_StringInDoc, eJSONScanString    }, /*lint !e9078 !e923 Get address of token as value. */
+        { cOTA_JSON_ExecutionKey,     OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      eJSONScanObject    },
+        { cOTA_JSON_JobIDKey,         OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucJobName )     }, eModelParamType_StringCopy,  eJSONScanString    },
+        { cOTA_JSON_StatusDetailsKey, OTA_JOB_PARAM_OPTIONAL, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      eJSONScanObject    },
+        { cOTA_JSON_SelfTestKey,      OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, xIsInSelfTest )  }, eModelParamType_Ident,       eJSONScanString    },
+        { cOTA_JSON_UpdatedByKey,     OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, ulUpdaterVersion )}, eModelParamType_UInt32,      eJSONScanString    },
+        { cOTA_JSON_JobDocKey,        OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      eJSONScanObject    },
+        { cOTA_JSON_OTAUnitKey,       OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Object,      eJSONScanObject    },
+        { cOTA_JSON_StreamNameKey,    OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucStreamName )  }, eModelParamType_StringCopy,  eJSONScanString    },
+        { cOTA_JSON_FileGroupKey,     OTA_JOB_PARAM_REQUIRED, { OTA_DONT_STORE_PARAM                           }, eModelParamType_Array,       eJSONScanArray     },
+        { cOTA_JSON_FilePathKey,      OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucFilePath )    }, eModelParamType_StringCopy,  eJSONScanString    },
+        { cOTA_JSON_FileSizeKey,      OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, ulFileSize )     }, eModelParamType_UInt32,      eJSONScanPrimitive },
+        { cOTA_JSON_FileIDKey,        OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, ulServerFileID ) }, eModelParamType_UInt32,      eJSONScanPrimitive },
+        { cOTA_JSON_FileCertNameKey,  OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pucCertFilepath )}, eModelParamType_StringCopy,  eJSONScanString    },
+        { cOTA_JSON_FileSignatureKey, OTA_JOB_PARAM_REQUIRED, { OFFSET_OF( OTA_FileContext_t, pxSignature )    }, eModelParamType_SigBase64,   eJSONScanString    },
+        { cOTA_JSON_FileAttributeKey, OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, ulFileAttributes )}, eModelParamType_UInt32,      eJSONScanPrimitive },
+        { cOTA_JSON_FileDeltaKey,     OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, xIsDelta )       }, eModelParamType_Ident,       eJSONScanString    },
+        { cOTA_JSON_FileCompressedKey, OTA_JOB_PARAM_OPTIONAL, { OFFSET_OF( OTA_FileContext_t, xIsCompressed ) }, eModelParamType_Ident,       eJSONScanString    },
     };
 
     OTA_JobParseErr_t eErr = eOTA_JobParseErr_Unknown;
@@ -2275,7 +2622,7 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
 
         if( prvInitDocModel( &xOTA_JobDocModel,
                              xOTA_JobDocModelParamStructure,
-                             ( uint32_t ) pxC, /*lint !e9078 !e923 Intentionally casting context pointer to a value for prvInitDocModel. */
+                             ( uintptr_t ) pxC, /*lint !e9078 !e923 Intentionally casting context pointer to a value for prvInitDocModel. */
                              sizeof( OTA_FileContext_t ),
                              OTA_NUM_JOB_PARAMS ) != eDocParseErr_None )
         {
@@ -2290,6 +2637,22 @@ static OTA_FileContext_t * prvParseJobDoc( const char * pcJSON,
                 OTA_LOG_L1( "[%s] Zero file size is not allowed!\r\n", OTA_METHOD_NAME );
                 eErr = eOTA_JobParseErr_ZeroFileSize;
             }
+
+            #if ( otaconfigENABLE_DELTA_UPDATE == 0 )
+                else if( pxC->xIsDelta == ( bool_t ) pdTRUE )
+                {
+                    OTA_LOG_L1( "[%s] Delta updates are not enabled!\r\n", OTA_METHOD_NAME );
+                    eErr = eOTA_JobParseErr_DeltaNotSupported;
+                }
+            #endif
+
+            #if ( otaconfigENABLE_COMPRESSED_UPDATE == 0 )
+                else if( pxC->xIsCompressed == ( bool_t ) pdTRUE )
+                {
+                    OTA_LOG_L1( "[%s] Compressed updates are not enabled!\r\n", OTA_METHOD_NAME );
+                    eErr = eOTA_JobParseErr_CompressionNotSupported;
+                }
+            #endif
             /* If there's an active job, verify that it's the same as what's being reported now. */
             /* We already checked for missing parameters so we SHOULD have a job name in the context. */
             else if( xOTA_Agent.pucOTA_Singleton_ActiveJobName != NULL )
@@ -2495,10 +2858,39 @@ static OTA_FileContext_t * prvProcessOTAJobMsg( const char * pcRawMsg,
                 }
 
                 pxUpdateFile->ulBlocksRemaining = ulNumBlocks; /* Initialize our blocks remaining counter. */
+
+                #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                    prvStreamWindowInit( pxUpdateFile );
+                #endif
+
                 prvStartRequestTimer( pxUpdateFile );
 
-                /* Create/Open the OTA file on the file system. */
-                xErr = prvPAL_CreateFileForRx( pxUpdateFile );
+                #if ( otaconfigENABLE_RESUME == 1 )
+                    /* Reopen the file partly received before a reset, if any, and only request its missing blocks. */
+                    if( prvResumeLoad( pxUpdateFile, ulBitmapLen ) == ( bool_t ) pdTRUE )
+                    {
+                        xErr = kOTA_Err_None;
+                    }
+                    else
+                #endif
+                {
+                    /* Create/Open the OTA file on the file system. */
+                    xErr = prvPAL_CreateFileForRx( pxUpdateFile );
+                }
+
+                #if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+                    if( ( xErr == kOTA_Err_None ) && ( pxUpdateFile->xIsDelta == ( bool_t ) pdTRUE ) )
+                    {
+                        xErr = prvDeltaStart( pxUpdateFile );
+                    }
+                #endif
+
+                #if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+                    if( ( xErr == kOTA_Err_None ) && ( pxUpdateFile->xIsCompressed == ( bool_t ) pdTRUE ) )
+                    {
+                        xErr = prvDecompressStart( pxUpdateFile );
+                    }
+                #endif
 
                 if( xErr != kOTA_Err_None )
                 {
@@ -2506,6 +2898,16 @@ static OTA_FileContext_t * prvProcessOTAJobMsg( const char * pcRawMsg,
                     ( void ) prvOTA_Close( pxUpdateFile ); /* Ignore false result since we're setting the pointer to null on the next line. */
                     pxUpdateFile = NULL;
                 }
+                else
+                {
+                    #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+                        /* The blocks of a resumed file received before the reset are hashed by the PAL when it is closed. */
+                        if( pxUpdateFile->ulBlocksRemaining == ulNumBlocks )
+                        {
+                            prvSignatureStart( pxUpdateFile );
+                        }
+                    #endif
+                }
             }
             else
             {
@@ -2527,6 +2929,616 @@ static OTA_FileContext_t * prvProcessOTAJobMsg( const char * pcRawMsg,
 
 
 
+#if ( otaconfigENABLE_DELTA_UPDATE == 1 ) || ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+
+/* Write the file decoded from the file received by a context, the new file of a patch or the
+ * decompressed file, hashing it on the way if its signature is checked as it is received.
+ */
+
+    static int32_t prvWriteDecodedFile( void * pvContext,
+                                        uint32_t ulOffset,
+                                        const uint8_t * pucData,
+                                        uint32_t ulLength )
+    {
+        OTA_FileContext_t * C = ( OTA_FileContext_t * ) pvContext; /*lint !e9079 The context is the file context given to the decoder. */
+        int32_t lBytesWritten = prvPAL_WriteBlock( C, ulOffset, ( uint8_t * ) pucData, ulLength ); /*lint !e9005 The PAL does not modify the data. */
+
+        #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+            if( ( lBytesWritten == ( int32_t ) ulLength ) && ( C->pvSigVerifyContext != NULL ) )
+            {
+                CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext, pucData, ulLength );
+            }
+        #endif
+
+        return lBytesWritten;
+    }
+#endif /* otaconfigENABLE_DELTA_UPDATE || otaconfigENABLE_COMPRESSED_UPDATE */
+
+
+#if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+
+/* Read the active image for the patch of a context. */
+
+    static int32_t prvDeltaReadOld( void * pvContext,
+                                    uint32_t ulOffset,
+                                    uint8_t * pucBuffer,
+                                    uint32_t ulLength )
+    {
+        return prvPAL_ReadActiveImage( ( OTA_FileContext_t * ) pvContext, ulOffset, pucBuffer, ulLength ); /*lint !e9079 The context is the file context given to OTA_DeltaInit. */
+    }
+
+
+/* Allocate the state of the patch received in the file of a context. The patch is applied as its
+ * blocks are received, through a buffer in the state, so the RAM needed doesn't depend on the
+ * size of the files.
+ */
+
+    static OTA_Err_t prvDeltaStart( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDeltaStart" );
+
+        OTA_Err_t xErr = kOTA_Err_None;
+
+        prvDeltaStop( C );
+
+        C->pxDelta = ( OTA_Delta_t * ) pvPortMalloc( sizeof( OTA_Delta_t ) ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+        if( C->pxDelta == NULL )
+        {
+            OTA_LOG_L1( "[%s] Error: Unable to allocate the patch state.\r\n", OTA_METHOD_NAME );
+            xErr = kOTA_Err_OutOfMemory;
+        }
+        else
+        {
+            OTA_DeltaInit( C->pxDelta, prvDeltaReadOld, prvWriteDecodedFile, C );
+        }
+
+        return xErr;
+    }
+
+
+/* Apply the next block of the patch of a context. */
+
+    static int32_t prvDeltaApply( OTA_FileContext_t * C,
+                                  const uint8_t * pucData,
+                                  uint32_t ulBlockSize )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDeltaApply" );
+
+        int32_t lResult = ( int32_t ) ulBlockSize;
+        OTA_DeltaErr_t eErr = OTA_DeltaApply( C->pxDelta, pucData, ulBlockSize );
+
+        if( eErr != eOTA_DeltaErr_None )
+        {
+            OTA_LOG_L1( "[%s] Error (%d) applying the patch.\r\n", OTA_METHOD_NAME, eErr );
+            lResult = -( int32_t ) eErr;
+        }
+
+        return lResult;
+    }
+
+
+/* Once all the blocks of a patch are applied, check that the new file is complete. The new file
+ * then replaces the patch as the file of the context, so it is its size that is closed.
+ */
+
+    static bool_t prvDeltaFinish( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDeltaFinish" );
+
+        bool_t xResult = pdFALSE;
+
+        if( OTA_DeltaFinish( C->pxDelta ) != eOTA_DeltaErr_None )
+        {
+            OTA_LOG_L1( "[%s] Error: The patch ended before the new file was complete.\r\n", OTA_METHOD_NAME );
+        }
+        else
+        {
+            OTA_LOG_L1( "[%s] Patch applied, new file size %u.\r\n", OTA_METHOD_NAME, OTA_DeltaNewSize( C->pxDelta ) );
+            C->ulFileSize = OTA_DeltaNewSize( C->pxDelta );
+            xResult = pdTRUE;
+        }
+
+        prvDeltaStop( C );
+
+        return xResult;
+    }
+
+
+/* Free the state of the patch of a context. */
+
+    static void prvDeltaStop( OTA_FileContext_t * C )
+    {
+        if( C->pxDelta != NULL )
+        {
+            vPortFree( C->pxDelta );
+            C->pxDelta = NULL;
+        }
+    }
+#endif /* otaconfigENABLE_DELTA_UPDATE */
+
+
+#if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+
+/* Write the decompressed file of a context, or apply it if it is a patch. */
+
+    static int32_t prvDecompressWrite( void * pvContext,
+                                       uint32_t ulOffset,
+                                       const uint8_t * pucData,
+                                       uint32_t ulLength )
+    {
+        int32_t lResult;
+
+        #if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+            OTA_FileContext_t * C = ( OTA_FileContext_t * ) pvContext; /*lint !e9079 The context is the file context given to OTA_DecompressInit. */
+
+            if( C->pxDelta != NULL )
+            {   /* The decompressed file is a patch, which writes the new file as it is applied. */
+                lResult = prvDeltaApply( C, pucData, ulLength );
+            }
+            else
+        #endif
+        {
+            lResult = prvWriteDecodedFile( pvContext, ulOffset, pucData, ulLength );
+        }
+
+        return lResult;
+    }
+
+
+/* Allocate the state of the decompression of the file of a context. The file is decompressed as
+ * its blocks are received, through the window in the state, so the RAM needed doesn't depend on
+ * the size of the files.
+ */
+
+    static OTA_Err_t prvDecompressStart( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDecompressStart" );
+
+        OTA_Err_t xErr = kOTA_Err_None;
+
+        prvDecompressStop( C );
+
+        C->pxDecompress = ( OTA_Decompress_t * ) pvPortMalloc( sizeof( OTA_Decompress_t ) ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+        if( C->pxDecompress == NULL )
+        {
+            OTA_LOG_L1( "[%s] Error: Unable to allocate the decompression state.\r\n", OTA_METHOD_NAME );
+            xErr = kOTA_Err_OutOfMemory;
+        }
+        else
+        {
+            OTA_DecompressInit( C->pxDecompress, prvDecompressWrite, C );
+        }
+
+        return xErr;
+    }
+
+
+/* Decompress the next block of the file of a context. */
+
+    static int32_t prvDecompressApply( OTA_FileContext_t * C,
+                                       const uint8_t * pucData,
+                                       uint32_t ulBlockSize )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDecompressApply" );
+
+        int32_t lResult = ( int32_t ) ulBlockSize;
+        OTA_DecompressErr_t eErr = OTA_DecompressApply( C->pxDecompress, pucData, ulBlockSize );
+
+        if( eErr != eOTA_DecompressErr_None )
+        {
+            OTA_LOG_L1( "[%s] Error (%d) decompressing the file.\r\n", OTA_METHOD_NAME, eErr );
+            lResult = -( int32_t ) eErr;
+        }
+
+        return lResult;
+    }
+
+
+/* Once all the blocks of a compressed file are decompressed, check that the decompressed file is
+ * complete. It then replaces the compressed file as the file of the context, so it is its size
+ * that is closed. The new file of a patch replaces it in turn when the patch is finished.
+ */
+
+    static bool_t prvDecompressFinish( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvDecompressFinish" );
+
+        bool_t xResult = pdFALSE;
+
+        if( OTA_DecompressFinish( C->pxDecompress ) != eOTA_DecompressErr_None )
+        {
+            OTA_LOG_L1( "[%s] Error: The compressed file ended before the decompressed file was complete.\r\n", OTA_METHOD_NAME );
+        }
+        else
+        {
+            OTA_LOG_L1( "[%s] File decompressed, size %u.\r\n", OTA_METHOD_NAME, OTA_DecompressSize( C->pxDecompress ) );
+            C->ulFileSize = OTA_DecompressSize( C->pxDecompress );
+            xResult = pdTRUE;
+        }
+
+        prvDecompressStop( C );
+
+        return xResult;
+    }
+
+
+/* Free the state of the decompression of the file of a context. */
+
+    static void prvDecompressStop( OTA_FileContext_t * C )
+    {
+        if( C->pxDecompress != NULL )
+        {
+            vPortFree( C->pxDecompress );
+            C->pxDecompress = NULL;
+        }
+    }
+#endif /* otaconfigENABLE_COMPRESSED_UPDATE */
+
+
+#if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+
+/* Start hashing the file of a context as its blocks are received, so that closing the file
+ * only has to check the signature instead of reading the whole file back. The blocks received
+ * ahead of the next one to hash are kept in a reorder buffer until it arrives. If the hashing
+ * can't start, the PAL hashes the file when it is closed, as usual.
+ */
+
+    static void prvSignatureStart( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvSignatureStart" );
+
+        prvSignatureStop( C );
+
+        /* A decoded file is hashed as it is written, in order, so it needs no reorder buffer. */
+        if( !OTA_DECODED_FILE( C ) )
+        {
+            C->pucReorderBuffer = ( uint8_t * ) pvPortMalloc( otaconfigSIGNATURE_REORDER_BLOCKS * OTA_FILE_BLOCK_SIZE ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+        }
+
+        if( ( C->pucReorderBuffer != NULL ) || OTA_DECODED_FILE( C ) )
+        {
+            if( CRYPTO_SignatureVerificationStart( &C->pvSigVerifyContext,
+                                                   cryptoASYMMETRIC_ALGORITHM_ECDSA,
+                                                   cryptoHASH_ALGORITHM_SHA256 ) == pdFALSE )
+            {
+                C->pvSigVerifyContext = NULL;
+                prvSignatureStop( C );
+            }
+        }
+
+        if( C->pvSigVerifyContext == NULL )
+        {
+            OTA_LOG_L1( "[%s] Warning: the file will be hashed when closed.\r\n", OTA_METHOD_NAME );
+        }
+    }
+
+
+/* Hash a newly received block if all the blocks before it are hashed, followed by the blocks
+ * after it kept in the reorder buffer. A block received ahead of the next one to hash is kept
+ * in the slot of its index modulo the size of the buffer, which is free as long as it is not
+ * more than the size of the buffer ahead. Hashing stops for the rest of the file otherwise.
+ */
+
+    static void prvSignatureUpdate( OTA_FileContext_t * C,
+                                    uint32_t ulBlockIndex,
+                                    const uint8_t * pucData,
+                                    uint32_t ulBlockSize )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvSignatureUpdate" );
+
+        uint32_t ulLastBlock = ( ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE ) - 1U;
+        uint32_t ulSlot = ulBlockIndex % otaconfigSIGNATURE_REORDER_BLOCKS;
+
+        if( C->pvSigVerifyContext != NULL )
+        {
+            if( ulBlockIndex == C->ulHashedBlocks )
+            {
+                CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext, pucData, ulBlockSize );
+                C->ulHashedBlocks++;
+                ulSlot = C->ulHashedBlocks % otaconfigSIGNATURE_REORDER_BLOCKS;
+
+                while( ( C->ulReorderMask & ( 1UL << ulSlot ) ) != 0U )
+                {
+                    ulBlockSize = ( C->ulHashedBlocks == ulLastBlock ) ? ( C->ulFileSize - ( ulLastBlock * OTA_FILE_BLOCK_SIZE ) ) : OTA_FILE_BLOCK_SIZE;
+                    CRYPTO_SignatureVerificationUpdate( C->pvSigVerifyContext, &C->pucReorderBuffer[ ulSlot * OTA_FILE_BLOCK_SIZE ], ulBlockSize );
+                    C->ulReorderMask &= ~( 1UL << ulSlot );
+                    C->ulHashedBlocks++;
+                    ulSlot = C->ulHashedBlocks % otaconfigSIGNATURE_REORDER_BLOCKS;
+                }
+            }
+            else if( ( ulBlockIndex - C->ulHashedBlocks ) <= otaconfigSIGNATURE_REORDER_BLOCKS )
+            {
+                memcpy( &C->pucReorderBuffer[ ulSlot * OTA_FILE_BLOCK_SIZE ], pucData, ulBlockSize );
+                C->ulReorderMask |= 1UL << ulSlot;
+            }
+            else
+            {
+                OTA_LOG_L1( "[%s] Block %u is too far ahead of block %u, the file will be hashed when closed.\r\n", OTA_METHOD_NAME,
+                            ulBlockIndex,
+                            C->ulHashedBlocks );
+                prvSignatureStop( C );
+            }
+        }
+    }
+
+
+/* Stop hashing the file of a context as its blocks are received, if it was not taken over by
+ * the PAL, and free the reorder buffer.
+ */
+
+    static void prvSignatureStop( OTA_FileContext_t * C )
+    {
+        if( C->pvSigVerifyContext != NULL )
+        {
+            /* Frees the context without checking a signature. */
+            ( void ) CRYPTO_SignatureVerificationFinal( C->pvSigVerifyContext, NULL, 0, NULL, 0 );
+            C->pvSigVerifyContext = NULL;
+        }
+
+        if( C->pucReorderBuffer != NULL )
+        {
+            vPortFree( C->pucReorderBuffer );
+            C->pucReorderBuffer = NULL;
+        }
+
+        C->ulHashedBlocks = 0U;
+        C->ulReorderMask = 0U;
+    }
+#endif /* otaconfigENABLE_STREAMING_SIGNATURE_CHECK */
+
+
+#if ( otaconfigENABLE_RESUME == 1 )
+
+/* The resume state of a file, saved through the PAL, is this header followed by the block bitmap
+ * of the file. All its fields are words, so it has no padding.
+ */
+
+    #define OTA_RESUME_MAGIC          0x5245534fUL /* "OSER", the magic of version 1 of the state. */
+    #define OTA_RESUME_HASH_OFFSET    2166136261UL /* FNV-1a offset basis. */
+    #define OTA_RESUME_HASH_PRIME     16777619UL   /* FNV-1a prime. */
+
+    typedef struct
+    {
+        uint32_t ulMagic;           /* OTA_RESUME_MAGIC. */
+        uint32_t ulFileSize;        /* Size of the file. */
+        uint32_t ulServerFileID;    /* ID of the file in the job. */
+        uint32_t ulBlockSize;       /* Size of the blocks of the file. */
+        uint32_t ulJobHash;         /* Hash of the job name, stream name, file paths and signature of the file. */
+        uint32_t ulBlocksRemaining; /* Number of blocks of the file not received yet. */
+        uint32_t ulChecksum;        /* Hash of the state up to this field and of the bitmap, to detect a torn write. */
+    } OTA_ResumeHeader_t;
+
+
+/* Continue an FNV-1a hash with some bytes. */
+
+    static uint32_t prvResumeHash( uint32_t ulHash,
+                                   const uint8_t * pucData,
+                                   uint32_t ulLength )
+    {
+        uint32_t ulIndex;
+
+        for( ulIndex = 0U; ulIndex < ulLength; ulIndex++ )
+        {
+            ulHash = ( ulHash ^ pucData[ ulIndex ] ) * OTA_RESUME_HASH_PRIME;
+        }
+
+        return ulHash;
+    }
+
+
+/* Continue an FNV-1a hash with a string, including its terminator so that consecutive strings
+ * can't be confused, or with a single terminator if it is NULL.
+ */
+
+    static uint32_t prvResumeHashString( uint32_t ulHash,
+                                         const uint8_t * pucString )
+    {
+        static const uint8_t ucEmpty = 0U;
+
+        if( pucString == NULL )
+        {
+            pucString = &ucEmpty;
+        }
+
+        return prvResumeHash( ulHash, pucString, ( uint32_t ) strlen( ( const char * ) pucString ) + 1U );
+    }
+
+
+/* Fill the header of the resume state of the file of a context. The checksum is left 0. */
+
+    static void prvResumeHeader( const OTA_FileContext_t * C,
+                                 OTA_ResumeHeader_t * pxHeader )
+    {
+        uint32_t ulHash = OTA_RESUME_HASH_OFFSET;
+
+        ulHash = prvResumeHashString( ulHash, C->pucJobName );
+        ulHash = prvResumeHashString( ulHash, C->pucStreamName );
+        ulHash = prvResumeHashString( ulHash, C->pucFilePath );
+        ulHash = prvResumeHashString( ulHash, C->pucCertFilepath );
+
+        if( C->pxSignature != NULL )
+        {
+            ulHash = prvResumeHash( ulHash, C->pxSignature->ucData, C->pxSignature->usSize );
+        }
+
+        pxHeader->ulMagic = OTA_RESUME_MAGIC;
+        pxHeader->ulFileSize = C->ulFileSize;
+        pxHeader->ulServerFileID = C->ulServerFileID;
+        pxHeader->ulBlockSize = OTA_FILE_BLOCK_SIZE;
+        pxHeader->ulJobHash = ulHash;
+        pxHeader->ulBlocksRemaining = C->ulBlocksRemaining;
+        pxHeader->ulChecksum = 0U;
+    }
+
+
+/* Return the checksum of a resume state, which covers all of it but the checksum itself. */
+
+    static uint32_t prvResumeChecksum( const uint8_t * pucState,
+                                       uint32_t ulStateLen )
+    {
+        uint32_t ulHash = prvResumeHash( OTA_RESUME_HASH_OFFSET, pucState, OFFSET_OF( OTA_ResumeHeader_t, ulChecksum ) );
+
+        return prvResumeHash( ulHash, &pucState[ sizeof( OTA_ResumeHeader_t ) ], ulStateLen - ( uint32_t ) sizeof( OTA_ResumeHeader_t ) );
+    }
+
+
+/* Save the resume state of the file of a context, after it is written. A patch or a compressed
+ * file isn't resumable, since the state of its decoding is only in RAM. A failure to save is only
+ * logged, the download going on without it.
+ */
+
+    static void prvResumeSave( OTA_FileContext_t * C )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvResumeSave" );
+
+        OTA_ResumeHeader_t xHeader;
+        uint8_t * pucState;
+        uint32_t ulBitmapLen = ( ( ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE ) + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+        uint32_t ulStateLen = ( uint32_t ) sizeof( OTA_ResumeHeader_t ) + ulBitmapLen;
+
+        if( ( C->pucRxBlockBitmap != NULL ) && ( C->pucFile != NULL ) &&
+            ( C->xIsDelta == ( bool_t ) pdFALSE ) && ( C->xIsCompressed == ( bool_t ) pdFALSE ) )
+        {
+            pucState = ( uint8_t * ) pvPortMalloc( ulStateLen ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+
+            if( pucState == NULL )
+            {
+                OTA_LOG_L1( "[%s] Error: Unable to allocate the resume state.\r\n", OTA_METHOD_NAME );
+            }
+            else
+            {
+                prvResumeHeader( C, &xHeader );
+                memcpy( pucState, &xHeader, sizeof( xHeader ) );
+                memcpy( &pucState[ sizeof( xHeader ) ], C->pucRxBlockBitmap, ulBitmapLen );
+                xHeader.ulChecksum = prvResumeChecksum( pucState, ulStateLen );
+                memcpy( pucState, &xHeader, sizeof( xHeader ) );
+
+                if( prvPAL_SaveResumeState( C, pucState, ulStateLen ) != kOTA_Err_None )
+                {
+                    OTA_LOG_L1( "[%s] Error: Unable to save the resume state.\r\n", OTA_METHOD_NAME );
+                }
+
+                vPortFree( pucState );
+            }
+        }
+    }
+
+
+/* Check that a loaded resume state is intact and belongs to the file of a context, and that its
+ * bitmap only marks blocks of the file, as many as it says are remaining.
+ */
+
+    static bool_t prvResumeValid( const OTA_FileContext_t * C,
+                                  const uint8_t * pucState,
+                                  uint32_t ulBitmapLen )
+    {
+        OTA_ResumeHeader_t xHeader;
+        OTA_ResumeHeader_t xExpected;
+        uint32_t ulNumBlocks = ( C->ulFileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+        uint32_t ulBlock;
+        uint32_t ulMissing = 0U;
+        bool_t xValid = pdFALSE;
+
+        memcpy( &xHeader, pucState, sizeof( xHeader ) );
+        prvResumeHeader( C, &xExpected );
+        xExpected.ulBlocksRemaining = xHeader.ulBlocksRemaining;
+        xExpected.ulChecksum = prvResumeChecksum( pucState, ( uint32_t ) sizeof( OTA_ResumeHeader_t ) + ulBitmapLen );
+
+        if( ( memcmp( &xHeader, &xExpected, sizeof( xHeader ) ) == 0 ) && ( xHeader.ulBlocksRemaining > 0U ) )
+        {
+            xValid = pdTRUE;
+
+            for( ulBlock = 0U; ulBlock < ( ulBitmapLen * BITS_PER_BYTE ); ulBlock++ )
+            {
+                if( ( pucState[ sizeof( xHeader ) + ( ulBlock >> LOG2_BITS_PER_BYTE ) ] & ( 1U << ( ulBlock % BITS_PER_BYTE ) ) ) != 0U )
+                {
+                    if( ulBlock >= ulNumBlocks )
+                    {
+                        xValid = pdFALSE; /* The bits of the blocks out of range are always clear. */
+                    }
+
+                    ulMissing++;
+                }
+            }
+
+            if( ulMissing != xHeader.ulBlocksRemaining )
+            {
+                xValid = pdFALSE;
+            }
+        }
+
+        return xValid;
+    }
+
+
+/* Resume the download of the file of a context from the state saved before a reset, if it is
+ * valid and the PAL can reopen the partly received file. The bitmap of the context, allocated
+ * with ulBitmapLen bytes, then marks the blocks received before the reset, so only the missing
+ * ones are requested. Any other state is stale, and erased.
+ */
+
+    static bool_t prvResumeLoad( OTA_FileContext_t * C,
+                                 uint32_t ulBitmapLen )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvResumeLoad" );
+
+        OTA_ResumeHeader_t xHeader;
+        uint8_t * pucState = NULL;
+        uint32_t ulStateLen = ( uint32_t ) sizeof( OTA_ResumeHeader_t ) + ulBitmapLen;
+        bool_t xResumed = pdFALSE;
+
+        if( ( C->xIsDelta == ( bool_t ) pdFALSE ) && ( C->xIsCompressed == ( bool_t ) pdFALSE ) )
+        {
+            pucState = ( uint8_t * ) pvPortMalloc( ulStateLen ); /*lint !e9079 FreeRTOS malloc port returns void*. */
+        }
+
+        if( pucState != NULL )
+        {
+            if( ( prvPAL_LoadResumeState( pucState, ulStateLen ) == ( int32_t ) ulStateLen ) &&
+                ( prvResumeValid( C, pucState, ulBitmapLen ) == ( bool_t ) pdTRUE ) )
+            {
+                if( prvPAL_ResumeFileForRx( C ) == kOTA_Err_None )
+                {
+                    memcpy( &xHeader, pucState, sizeof( xHeader ) );
+                    memcpy( C->pucRxBlockBitmap, &pucState[ sizeof( xHeader ) ], ulBitmapLen );
+                    C->ulBlocksRemaining = xHeader.ulBlocksRemaining;
+                    xResumed = pdTRUE;
+                    OTA_LOG_L1( "[%s] Resuming the download, %u blocks remaining.\r\n", OTA_METHOD_NAME, C->ulBlocksRemaining );
+                }
+                else
+                {
+                    OTA_LOG_L1( "[%s] Warning: the partly received file can't be reopened, downloading it again.\r\n", OTA_METHOD_NAME );
+                }
+            }
+
+            vPortFree( pucState );
+        }
+
+        if( xResumed == ( bool_t ) pdFALSE )
+        {
+            prvResumeErase();
+        }
+
+        return xResumed;
+    }
+
+
+/* Erase the saved resume state, if any. */
+
+    static void prvResumeErase( void )
+    {
+        DEFINE_OTA_METHOD_NAME( "prvResumeErase" );
+
+        if( prvPAL_SaveResumeState( NULL, NULL, 0U ) != kOTA_Err_None )
+        {
+            OTA_LOG_L1( "[%s] Error: Unable to erase the resume state.\r\n", OTA_METHOD_NAME );
+        }
+    }
+#endif /* otaconfigENABLE_RESUME */
+
+
 /* prvIngestDataBlock
  *
  * A block of file data was received by the application via some configured communication protocol.
@@ -2547,7 +3559,7 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
     int32_t lFileId = 0;
     uint32_t ulBlockSize = 0;
     uint32_t ulBlockIndex = 0;
-    uint8_t * pucPayload = NULL;
+    const uint8_t * pucPayload = NULL;
     size_t xPayloadSize = 0;
 
     if( C != NULL )
@@ -2569,8 +3581,8 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
                         &lFileId,
                         ( int32_t * ) &ulBlockIndex, /*lint !e9087 CBOR requires pointer to int and our block index's never exceed 31 bits. */
                         ( int32_t * ) &ulBlockSize,  /*lint !e9087 CBOR requires pointer to int and our block sizes never exceed 31 bits. */
-                        &pucPayload,                 /* This payload gets malloc'd by OTA_CBOR_Decode_GetStreamResponseMessage(). We must free it. */
-                        ( size_t * ) &xPayloadSize ) )
+                        &pucPayload,                 /* This payload points into pcRawMsg, so it is written without being copied. */
+                        ( size_t * ) &xPayloadSize ) || ( xPayloadSize != ( size_t ) ulBlockSize ) )
                 {
                     eIngestResult = eIngest_Result_BadData;
                 }
@@ -2600,11 +3612,42 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
                             eIngestResult = eIngest_Result_Duplicate_Continue;
                             *pxCloseResult = kOTA_Err_None; /* This is a success path. */
                         }
+
+                        #if ( otaconfigENABLE_DELTA_UPDATE == 1 ) || ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+                            /* A decoded file is decoded in order, so a block after the next one is dropped, to be requested again. */
+                            else if( OTA_DECODED_FILE( C ) && ( ulBlockIndex != ( ( ulLastBlock + 1U ) - C->ulBlocksRemaining ) ) )
+                            {
+                                OTA_LOG_L1( "[%s] block %u is OUT OF ORDER. Expecting block %u.\r\n", OTA_METHOD_NAME,
+                                            ulBlockIndex,
+                                            ( ulLastBlock + 1U ) - C->ulBlocksRemaining );
+                                eIngestResult = eIngest_Result_OutOfOrder_Continue;
+                                *pxCloseResult = kOTA_Err_None; /* This is a success path. */
+                            }
+                        #endif
                         else /* Otherwise, process it normally... */
                         {
                             if( C->pucFile != NULL )
                             {
-                                int32_t lBytesWritten = prvPAL_WriteBlock( C, ( ulBlockIndex * OTA_FILE_BLOCK_SIZE ), pucPayload, ( uint32_t ) ulBlockSize );
+                                int32_t lBytesWritten;
+
+                                #if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+                                    if( C->pxDecompress != NULL )
+                                    {   /* The block is a chunk of a compressed file, which writes the decompressed file as it is decoded. */
+                                        lBytesWritten = prvDecompressApply( C, pucPayload, ulBlockSize );
+                                    }
+                                    else
+                                #endif
+
+                                #if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+                                    if( C->pxDelta != NULL )
+                                    {   /* The block is a chunk of a patch, which writes the new file as it is applied. */
+                                        lBytesWritten = prvDeltaApply( C, pucPayload, ulBlockSize );
+                                    }
+                                    else
+                                #endif
+                                {
+                                    lBytesWritten = prvPAL_WriteBlock( C, ( ulBlockIndex * OTA_FILE_BLOCK_SIZE ), ( uint8_t * ) pucPayload, ( uint32_t ) ulBlockSize ); /*lint !e9005 The PAL does not modify the block data. */
+                                }
 
                                 if( lBytesWritten < 0 )
                                 {
@@ -2615,6 +3658,28 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
                                 {
                                     C->pucRxBlockBitmap[ ulByte ] &= ~ucBitMask; /* Mark this block as received in our bitmap. */
                                     C->ulBlocksRemaining--;
+
+                                    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                                        prvStreamWindowReceived( C, ulBlockIndex, xTaskGetTickCount() );
+                                    #endif
+
+                                    #if ( otaconfigENABLE_RESUME == 1 )
+                                        /* Save the blocks received so far every few blocks, the last block being saved as done. */
+                                        if( ( C->ulBlocksRemaining > 0U ) &&
+                                            ( ( ( ( ulLastBlock + 1U ) - C->ulBlocksRemaining ) % otaconfigRESUME_SAVE_BLOCKS ) == 0U ) )
+                                        {
+                                            prvResumeSave( C );
+                                        }
+                                    #endif
+
+                                    #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+                                        /* A decoded file is hashed as it is written instead. */
+                                        if( !OTA_DECODED_FILE( C ) )
+                                        {
+                                            prvSignatureUpdate( C, ulBlockIndex, pucPayload, ulBlockSize );
+                                        }
+                                    #endif
+
                                     eIngestResult = eIngest_Result_Accepted_Continue;
                                     *pxCloseResult = kOTA_Err_None; /* This is a success path. */
                                 }
@@ -2632,10 +3697,32 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
                                 vPortFree( C->pucRxBlockBitmap ); /* Free the bitmap now that we're done with the download. */
                                 C->pucRxBlockBitmap = NULL;
 
+                                #if ( otaconfigENABLE_COMPRESSED_UPDATE == 1 )
+                                    if( ( C->pxDecompress != NULL ) && ( prvDecompressFinish( C ) == ( bool_t ) pdFALSE ) )
+                                    {
+                                        eIngestResult = eIngest_Result_BadData;
+                                    }
+                                    else
+                                #endif
+
+                                #if ( otaconfigENABLE_DELTA_UPDATE == 1 )
+                                    if( ( C->pxDelta != NULL ) && ( prvDeltaFinish( C ) == ( bool_t ) pdFALSE ) )
+                                    {
+                                        eIngestResult = eIngest_Result_BadData;
+                                    }
+                                    else
+                                #endif
+
                                 if( C->pucFile != NULL )
                                 {
+                                    /* The PAL finishes the signature verification of a file hashed as it
+                                     * was received, taking over its context. */
                                     *pxCloseResult = prvPAL_CloseFile( C );
 
+                                    #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+                                        prvSignatureStop( C );
+                                    #endif
+
                                     if( *pxCloseResult == kOTA_Err_None )
                                     {
                                         OTA_LOG_L1( "[%s] File receive complete and signature is valid.\r\n", OTA_METHOD_NAME );
@@ -2695,11 +3782,6 @@ static IngestResult_t prvIngestDataBlock( OTA_FileContext_t * C,
         eIngestResult = eIngest_Result_NullContext;
     }
 
-    if( NULL != pucPayload )
-    {
-        vPortFree( pucPayload );
-    }
-
     return eIngestResult;
 }
 
@@ -39,6 +39,13 @@
 
 #define OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT    5
 
+/**
+ * @brief CBOR initial byte fields, per RFC 7049.
+ */
+
+#define OTA_CBOR_ADDITIONAL_INFO_MASK           0x1FU /* The argument or its size. */
+#define OTA_CBOR_ADDITIONAL_INFO_UINT8          24U   /* 24 to 27: the argument follows in 1, 2, 4 or 8 bytes. */
+
 /**
  * @brief Internal context structure for decoding CBOR arrays.
  */
@@ -48,20 +55,43 @@ typedef struct OTAMessageDecodeContext
     CborValue xCborRecursedItem;
 } OTAMessageDecodeContext_t, * OTAMessageDecodeContextPtr_t;
 
+/**
+ * @brief Size of the header of a CBOR data item, from its initial byte.
+ *
+ * The additional information in the low 5 bits of the initial byte either is
+ * the argument of the item or says how many bytes following it hold the
+ * argument.
+ */
+static size_t prvGetHeaderSize( uint8_t ucInitialByte )
+{
+    uint8_t ucAdditionalInfo = ucInitialByte & OTA_CBOR_ADDITIONAL_INFO_MASK;
+    size_t xHeaderSize = 1;
+
+    if( ucAdditionalInfo >= OTA_CBOR_ADDITIONAL_INFO_UINT8 )
+    {
+        xHeaderSize += ( size_t ) 1U << ( ucAdditionalInfo - OTA_CBOR_ADDITIONAL_INFO_UINT8 );
+    }
+
+    return xHeaderSize;
+}
+
 /**
  * @brief Decode a Get Stream response message from AWS IoT OTA.
+ *
+ * The payload is not copied: *ppucPayload points into pucMessageBuffer.
  */
 BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pucMessageBuffer,
                                                      size_t xMessageSize,
                                                      int32_t * plFileId,
                                                      int32_t * plBlockId,
                                                      int32_t * plBlockSize,
-                                                     uint8_t ** ppucPayload,
+                                                     const uint8_t ** ppucPayload,
                                                      size_t * pxPayloadSize )
 {
     CborError xCborResult = CborNoError;
     CborParser xCborParser;
     CborValue xCborValue, xCborMap;
+    const uint8_t * pucPayload = NULL;
 
     /* Initialize the parser. */
     xCborResult = cbor_parser_init( pucMessageBuffer,
@@ -162,28 +192,26 @@ BaseType_t OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pucMessageB
         }
     }
 
+    /* The payload is returned in place, so it must be a single chunk. */
     if( CborNoError == xCborResult )
     {
-        xCborResult = cbor_value_calculate_string_length( &xCborValue,
-                                                          pxPayloadSize );
+        xCborResult = cbor_value_get_string_length( &xCborValue,
+                                                    pxPayloadSize );
     }
 
     if( CborNoError == xCborResult )
     {
-        *ppucPayload = pvPortMalloc( *pxPayloadSize );
+        pucPayload = cbor_value_get_next_byte( &xCborValue );
+        pucPayload += prvGetHeaderSize( *pucPayload );
 
-        if( NULL == *ppucPayload )
+        if( *pxPayloadSize > ( size_t ) ( ( pucMessageBuffer + xMessageSize ) - pucPayload ) )
         {
-            xCborResult = CborErrorOutOfMemory;
+            xCborResult = CborErrorUnexpectedEOF;
+        }
+        else
+        {
+            *ppucPayload = pucPayload;
         }
-    }
-
-    if( CborNoError == xCborResult )
-    {
-        xCborResult = cbor_value_copy_byte_string( &xCborValue,
-                                                   *ppucPayload,
-                                                   pxPayloadSize,
-                                                   NULL );
     }
 
     return CborNoError == xCborResult;
@@ -0,0 +1,371 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_decompress.c
+ * @brief Streaming decompression of compressed OTA files.
+ */
+
+/* C library includes. */
+#include <string.h>
+
+/* OTA decompression includes. */
+#include "aws_ota_decompress.h"
+
+/* What the stream is expected to contain next. */
+#define otadecompressSTATE_HEADER          ( 0 ) /* The rest of the header. */
+#define otadecompressSTATE_TAG             ( 1 ) /* The bit telling a literal from a back reference. */
+#define otadecompressSTATE_LITERAL         ( 2 ) /* The byte of a literal. */
+#define otadecompressSTATE_OFFSET          ( 3 ) /* The offset of a back reference. */
+#define otadecompressSTATE_LENGTH          ( 4 ) /* The length of a back reference. */
+#define otadecompressSTATE_DONE            ( 5 ) /* Nothing, the decompressed file is complete. */
+
+/* The magic number at the start of a compressed file. */
+#define otadecompressMAGIC                 "AFH1"
+#define otadecompressMAGIC_LENGTH          ( 4U )
+
+/* The bounds of the window and lookahead sizes of a stream, as powers of 2. */
+#define otadecompressMIN_WINDOW_BITS       ( 4U )
+#define otadecompressMIN_LOOKAHEAD_BITS    ( 3U )
+
+/* Bits in a literal, and in a byte of the stream. */
+#define otadecompressLITERAL_BITS          ( 8U )
+
+/**
+ * @brief Reads a 32 bit little endian integer.
+ */
+#define otadecompressREAD_UINT32( p )                                   \
+    ( ( uint32_t ) ( p )[ 0 ] | ( ( uint32_t ) ( p )[ 1 ] << 8 ) |      \
+      ( ( uint32_t ) ( p )[ 2 ] << 16 ) | ( ( uint32_t ) ( p )[ 3 ] << 24 ) )
+
+/**
+ * @brief Writes the bytes of the window decoded since the last write, and
+ * goes back to the start of the window once it is full.
+ */
+static OTA_DecompressErr_t prvFlush( OTA_Decompress_t * pxDecompress );
+
+/**
+ * @brief Adds a byte to the decompressed file.
+ */
+static OTA_DecompressErr_t prvProduce( OTA_Decompress_t * pxDecompress,
+                                       uint8_t ucByte );
+
+/**
+ * @brief Adds ulLength bytes copied from the current back reference to the
+ * decompressed file.
+ */
+static OTA_DecompressErr_t prvCopy( OTA_Decompress_t * pxDecompress,
+                                    uint32_t ulLength );
+
+/**
+ * @brief Checks the complete header.
+ */
+static OTA_DecompressErr_t prvParseHeader( OTA_Decompress_t * pxDecompress );
+
+/**
+ * @brief Returns the number of bits of the next part of the stream.
+ */
+static uint8_t prvBitsNeeded( const OTA_Decompress_t * pxDecompress );
+
+/**
+ * @brief Decodes the bits received, as far as they go.
+ */
+static OTA_DecompressErr_t prvDecodeBits( OTA_Decompress_t * pxDecompress );
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvFlush( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulLength = ( uint32_t ) pxDecompress->usHead - pxDecompress->usFlushed;
+
+    if( ulLength > 0U )
+    {
+        if( pxDecompress->xWrite( pxDecompress->pvContext,
+                                  pxDecompress->ulWritten,
+                                  &pxDecompress->ucWindow[ pxDecompress->usFlushed ],
+                                  ulLength ) != ( int32_t ) ulLength )
+        {
+            eErr = eOTA_DecompressErr_WriteFailed;
+        }
+        else
+        {
+            pxDecompress->ulWritten += ulLength;
+            pxDecompress->usFlushed = pxDecompress->usHead;
+        }
+    }
+
+    if( ( eErr == eOTA_DecompressErr_None ) &&
+        ( pxDecompress->usHead == ( 1UL << pxDecompress->ucWindowBits ) ) )
+    {
+        pxDecompress->usHead = 0U;
+        pxDecompress->usFlushed = 0U;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvProduce( OTA_Decompress_t * pxDecompress,
+                                       uint8_t ucByte )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+
+    if( pxDecompress->ulProduced == pxDecompress->ulSize )
+    {
+        /* The stream goes on after the decompressed file is complete. */
+        eErr = eOTA_DecompressErr_BadStream;
+    }
+    else
+    {
+        pxDecompress->ucWindow[ pxDecompress->usHead ] = ucByte;
+        pxDecompress->usHead++;
+        pxDecompress->ulProduced++;
+
+        if( ( pxDecompress->usHead == ( 1UL << pxDecompress->ucWindowBits ) ) ||
+            ( pxDecompress->ulProduced == pxDecompress->ulSize ) )
+        {
+            eErr = prvFlush( pxDecompress );
+        }
+
+        if( pxDecompress->ulProduced == pxDecompress->ulSize )
+        {
+            pxDecompress->ucState = otadecompressSTATE_DONE;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvCopy( OTA_Decompress_t * pxDecompress,
+                                    uint32_t ulLength )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulMask = ( 1UL << pxDecompress->ucWindowBits ) - 1UL;
+
+    /* The bytes are copied one by one, as the reference may overlap them. */
+    while( ( eErr == eOTA_DecompressErr_None ) && ( ulLength > 0U ) )
+    {
+        eErr = prvProduce( pxDecompress,
+                           pxDecompress->ucWindow[ ( ( uint32_t ) pxDecompress->usHead - pxDecompress->usOffset ) & ulMask ] );
+        ulLength--;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvParseHeader( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    const uint8_t * pucHeader = pxDecompress->ucHeader;
+
+    pxDecompress->ulSize = otadecompressREAD_UINT32( &pucHeader[ otadecompressMAGIC_LENGTH ] );
+    pxDecompress->ucWindowBits = pucHeader[ 8 ];
+    pxDecompress->ucLookaheadBits = pucHeader[ 9 ];
+
+    if( ( memcmp( pucHeader, otadecompressMAGIC, otadecompressMAGIC_LENGTH ) != 0 ) ||
+        ( pxDecompress->ucWindowBits < otadecompressMIN_WINDOW_BITS ) ||
+        ( pxDecompress->ucWindowBits > otaconfigDECOMPRESS_WINDOW_BITS ) ||
+        ( pxDecompress->ucLookaheadBits < otadecompressMIN_LOOKAHEAD_BITS ) ||
+        ( pxDecompress->ucLookaheadBits >= pxDecompress->ucWindowBits ) ||
+        ( pucHeader[ 10 ] != 0U ) ||
+        ( pucHeader[ 11 ] != 0U ) )
+    {
+        pxDecompress->ulSize = 0U;
+        eErr = eOTA_DecompressErr_BadStream;
+    }
+    else if( pxDecompress->ulSize == 0U )
+    {
+        pxDecompress->ucState = otadecompressSTATE_DONE;
+    }
+    else
+    {
+        pxDecompress->ucState = otadecompressSTATE_TAG;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvBitsNeeded( const OTA_Decompress_t * pxDecompress )
+{
+    uint8_t ucNeeded;
+
+    if( pxDecompress->ucState == otadecompressSTATE_LITERAL )
+    {
+        ucNeeded = otadecompressLITERAL_BITS;
+    }
+    else if( pxDecompress->ucState == otadecompressSTATE_OFFSET )
+    {
+        ucNeeded = pxDecompress->ucWindowBits;
+    }
+    else if( pxDecompress->ucState == otadecompressSTATE_LENGTH )
+    {
+        ucNeeded = pxDecompress->ucLookaheadBits;
+    }
+    else
+    {
+        ucNeeded = 1U;
+    }
+
+    return ucNeeded;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DecompressErr_t prvDecodeBits( OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint8_t ucNeeded = prvBitsNeeded( pxDecompress );
+    uint32_t ulValue;
+
+    while( ( eErr == eOTA_DecompressErr_None ) &&
+           ( pxDecompress->ucState != otadecompressSTATE_DONE ) &&
+           ( pxDecompress->ucBitCount >= ucNeeded ) )
+    {
+        pxDecompress->ucBitCount -= ucNeeded;
+        ulValue = ( pxDecompress->ulBits >> pxDecompress->ucBitCount ) & ( ( 1UL << ucNeeded ) - 1UL );
+
+        if( pxDecompress->ucState == otadecompressSTATE_LITERAL )
+        {
+            pxDecompress->ucState = otadecompressSTATE_TAG;
+            eErr = prvProduce( pxDecompress, ( uint8_t ) ulValue );
+        }
+        else if( pxDecompress->ucState == otadecompressSTATE_OFFSET )
+        {
+            pxDecompress->usOffset = ( uint16_t ) ( ulValue + 1U );
+            pxDecompress->ucState = otadecompressSTATE_LENGTH;
+        }
+        else if( pxDecompress->ucState == otadecompressSTATE_LENGTH )
+        {
+            pxDecompress->ucState = otadecompressSTATE_TAG;
+            eErr = prvCopy( pxDecompress, ulValue + 1U );
+        }
+        else
+        {
+            pxDecompress->ucState = ( ulValue != 0U ) ? otadecompressSTATE_LITERAL : otadecompressSTATE_OFFSET;
+        }
+
+        ucNeeded = prvBitsNeeded( pxDecompress );
+    }
+
+    /* The file is complete, so the rest of the stream is the padding of its last byte. */
+    if( ( eErr == eOTA_DecompressErr_None ) &&
+        ( pxDecompress->ucState == otadecompressSTATE_DONE ) &&
+        ( ( pxDecompress->ucBitCount >= otadecompressLITERAL_BITS ) ||
+          ( ( pxDecompress->ulBits & ( ( 1UL << pxDecompress->ucBitCount ) - 1UL ) ) != 0U ) ) )
+    {
+        eErr = eOTA_DecompressErr_BadStream;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+void OTA_DecompressInit( OTA_Decompress_t * pxDecompress,
+                         OTA_DecompressWrite_t xWrite,
+                         void * pvContext )
+{
+    /* The window starts with zeros, which back references before the start of the file read. */
+    memset( pxDecompress, 0, sizeof( OTA_Decompress_t ) );
+    pxDecompress->xWrite = xWrite;
+    pxDecompress->pvContext = pvContext;
+    pxDecompress->eError = eOTA_DecompressErr_None;
+    pxDecompress->ucState = otadecompressSTATE_HEADER;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DecompressErr_t OTA_DecompressApply( OTA_Decompress_t * pxDecompress,
+                                         const uint8_t * pucData,
+                                         uint32_t ulLength )
+{
+    OTA_DecompressErr_t eErr = pxDecompress->eError;
+    uint32_t ulChunk;
+
+    while( ( eErr == eOTA_DecompressErr_None ) && ( ulLength > 0U ) )
+    {
+        if( pxDecompress->ucState == otadecompressSTATE_HEADER )
+        {
+            ulChunk = OTA_DECOMPRESS_HEADER_SIZE - pxDecompress->ucHeaderLength;
+            ulChunk = ( ulChunk > ulLength ) ? ulLength : ulChunk;
+            memcpy( &pxDecompress->ucHeader[ pxDecompress->ucHeaderLength ], pucData, ulChunk );
+            pxDecompress->ucHeaderLength += ( uint8_t ) ulChunk;
+
+            if( pxDecompress->ucHeaderLength == OTA_DECOMPRESS_HEADER_SIZE )
+            {
+                eErr = prvParseHeader( pxDecompress );
+            }
+        }
+        else if( pxDecompress->ucState == otadecompressSTATE_DONE )
+        {
+            /* The stream goes on after the decompressed file is complete. */
+            ulChunk = 0U;
+            eErr = eOTA_DecompressErr_BadStream;
+        }
+        else
+        {
+            ulChunk = 1U;
+            pxDecompress->ulBits = ( pxDecompress->ulBits << otadecompressLITERAL_BITS ) | *pucData;
+            pxDecompress->ucBitCount += ( uint8_t ) otadecompressLITERAL_BITS;
+            eErr = prvDecodeBits( pxDecompress );
+        }
+
+        pucData += ulChunk;
+        ulLength -= ulChunk;
+    }
+
+    pxDecompress->eError = eErr;
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DecompressErr_t OTA_DecompressFinish( const OTA_Decompress_t * pxDecompress )
+{
+    OTA_DecompressErr_t eErr = pxDecompress->eError;
+
+    if( ( eErr == eOTA_DecompressErr_None ) && ( pxDecompress->ucState != otadecompressSTATE_DONE ) )
+    {
+        eErr = eOTA_DecompressErr_BadStream;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OTA_DecompressSize( const OTA_Decompress_t * pxDecompress )
+{
+    return pxDecompress->ulSize;
+}
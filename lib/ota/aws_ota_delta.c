@@ -0,0 +1,504 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_ota_delta.c
+ * @brief Streaming application of OTA delta patches.
+ */
+
+/* C library includes. */
+#include <string.h>
+
+/* OTA delta includes. */
+#include "aws_ota_delta.h"
+
+/* What the patch is expected to contain next. */
+#define otadeltaSTATE_HEADER            ( 0 ) /* The rest of the header. */
+#define otadeltaSTATE_DIFF_LENGTH       ( 1 ) /* The diff length of a record. */
+#define otadeltaSTATE_EXTRA_LENGTH      ( 2 ) /* The extra length of a record. */
+#define otadeltaSTATE_SEEK              ( 3 ) /* The seek of a record. */
+#define otadeltaSTATE_EQUAL_COUNT       ( 4 ) /* The number of equal bytes of a diff pair. */
+#define otadeltaSTATE_CHANGED_COUNT     ( 5 ) /* The number of differences of a diff pair. */
+#define otadeltaSTATE_CHANGED           ( 6 ) /* The rest of the differences of a diff pair. */
+#define otadeltaSTATE_EXTRA             ( 7 ) /* The rest of the extra data of a record. */
+#define otadeltaSTATE_DONE              ( 8 ) /* Nothing, the new file is complete. */
+
+/* The magic number at the start of a patch. */
+#define otadeltaMAGIC                   "AFD1"
+#define otadeltaMAGIC_LENGTH            ( 4U )
+
+/* The bits of a varint byte. */
+#define otadeltaVARINT_VALUE_MASK       ( 0x7FU )
+#define otadeltaVARINT_MORE             ( 0x80U )
+#define otadeltaVARINT_LAST_SHIFT       ( 28U )   /* Only the low 4 bits of a fifth byte fit in 32 bits. */
+#define otadeltaVARINT_LAST_MASK        ( 0xF0U ) /* The bits a fifth byte must not have. */
+
+/**
+ * @brief Reads a 32 bit little endian integer.
+ */
+#define otadeltaREAD_UINT32( p )                                        \
+    ( ( uint32_t ) ( p )[ 0 ] | ( ( uint32_t ) ( p )[ 1 ] << 8 ) |      \
+      ( ( uint32_t ) ( p )[ 2 ] << 16 ) | ( ( uint32_t ) ( p )[ 3 ] << 24 ) )
+
+/**
+ * @brief Writes the buffered bytes of the new file.
+ */
+static OTA_DeltaErr_t prvFlush( OTA_Delta_t * pxDelta );
+
+/**
+ * @brief Produces ulLength diff bytes of the new file from the active image,
+ * adding the differences in pucChanges to them unless it is NULL.
+ */
+static OTA_DeltaErr_t prvProduceDiff( OTA_Delta_t * pxDelta,
+                                      const uint8_t * pucChanges,
+                                      uint32_t ulLength );
+
+/**
+ * @brief Produces ulLength extra bytes of the new file from pucExtra.
+ */
+static OTA_DeltaErr_t prvProduceExtra( OTA_Delta_t * pxDelta,
+                                       const uint8_t * pucExtra,
+                                       uint32_t ulLength );
+
+/**
+ * @brief Checks the complete header, in the buffer.
+ */
+static OTA_DeltaErr_t prvParseHeader( OTA_Delta_t * pxDelta );
+
+/**
+ * @brief Moves on to the next part of the current record, or to the next
+ * record once it is complete.
+ */
+static OTA_DeltaErr_t prvNextPart( OTA_Delta_t * pxDelta );
+
+/**
+ * @brief Uses the value of a complete varint.
+ */
+static OTA_DeltaErr_t prvVarintDone( OTA_Delta_t * pxDelta,
+                                     uint32_t ulValue );
+
+/**
+ * @brief Adds the next byte of a varint.
+ */
+static OTA_DeltaErr_t prvVarintByte( OTA_Delta_t * pxDelta,
+                                     uint8_t ucByte );
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvFlush( OTA_Delta_t * pxDelta )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+
+    if( pxDelta->usBuffered > 0U )
+    {
+        if( pxDelta->xWriteNew( pxDelta->pvContext,
+                                pxDelta->ulWritten,
+                                pxDelta->ucBuffer,
+                                pxDelta->usBuffered ) != ( int32_t ) pxDelta->usBuffered )
+        {
+            eErr = eOTA_DeltaErr_WriteFailed;
+        }
+        else
+        {
+            pxDelta->ulWritten += pxDelta->usBuffered;
+            pxDelta->usBuffered = 0U;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvProduceDiff( OTA_Delta_t * pxDelta,
+                                      const uint8_t * pucChanges,
+                                      uint32_t ulLength )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulChunk;
+    uint32_t ulIndex;
+    uint8_t * pucOut;
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulLength > 0U ) )
+    {
+        ulChunk = otaconfigDELTA_BUFFER_SIZE - pxDelta->usBuffered;
+
+        if( ulChunk > ulLength )
+        {
+            ulChunk = ulLength;
+        }
+
+        pucOut = &pxDelta->ucBuffer[ pxDelta->usBuffered ];
+
+        if( pxDelta->xReadOld( pxDelta->pvContext, pxDelta->ulOldOffset, pucOut, ulChunk ) != ( int32_t ) ulChunk )
+        {
+            eErr = eOTA_DeltaErr_ReadFailed;
+        }
+        else
+        {
+            if( pucChanges != NULL )
+            {
+                for( ulIndex = 0U; ulIndex < ulChunk; ulIndex++ )
+                {
+                    pucOut[ ulIndex ] = ( uint8_t ) ( pucOut[ ulIndex ] + pucChanges[ ulIndex ] );
+                }
+
+                pucChanges += ulChunk;
+            }
+
+            pxDelta->usBuffered += ( uint16_t ) ulChunk;
+            pxDelta->ulOldOffset += ulChunk;
+            pxDelta->ulDiffRemaining -= ulChunk;
+            ulLength -= ulChunk;
+
+            if( pxDelta->usBuffered == otaconfigDELTA_BUFFER_SIZE )
+            {
+                eErr = prvFlush( pxDelta );
+            }
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvProduceExtra( OTA_Delta_t * pxDelta,
+                                       const uint8_t * pucExtra,
+                                       uint32_t ulLength )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulChunk;
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulLength > 0U ) )
+    {
+        ulChunk = otaconfigDELTA_BUFFER_SIZE - pxDelta->usBuffered;
+
+        if( ulChunk > ulLength )
+        {
+            ulChunk = ulLength;
+        }
+
+        memcpy( &pxDelta->ucBuffer[ pxDelta->usBuffered ], pucExtra, ulChunk );
+        pucExtra += ulChunk;
+        pxDelta->usBuffered += ( uint16_t ) ulChunk;
+        pxDelta->ulExtraRemaining -= ulChunk;
+        ulLength -= ulChunk;
+
+        if( pxDelta->usBuffered == otaconfigDELTA_BUFFER_SIZE )
+        {
+            eErr = prvFlush( pxDelta );
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvParseHeader( OTA_Delta_t * pxDelta )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+
+    if( memcmp( pxDelta->ucBuffer, otadeltaMAGIC, otadeltaMAGIC_LENGTH ) != 0 )
+    {
+        eErr = eOTA_DeltaErr_BadPatch;
+    }
+    else
+    {
+        pxDelta->ulNewSize = otadeltaREAD_UINT32( &pxDelta->ucBuffer[ otadeltaMAGIC_LENGTH ] );
+        pxDelta->ulOldSize = otadeltaREAD_UINT32( &pxDelta->ucBuffer[ otadeltaMAGIC_LENGTH + 4U ] );
+        pxDelta->usBuffered = 0U;
+        pxDelta->ucState = ( pxDelta->ulNewSize == 0U ) ? otadeltaSTATE_DONE : otadeltaSTATE_DIFF_LENGTH;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvNextPart( OTA_Delta_t * pxDelta )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+
+    if( pxDelta->ulDiffRemaining > 0U )
+    {
+        pxDelta->ucState = otadeltaSTATE_EQUAL_COUNT;
+    }
+    else if( pxDelta->ulExtraRemaining > 0U )
+    {
+        pxDelta->ucState = otadeltaSTATE_EXTRA;
+    }
+    else
+    {
+        /* The record is complete, so apply its seek. */
+        if( pxDelta->ucSeekBack != 0U )
+        {
+            if( pxDelta->ulSeek > pxDelta->ulOldOffset )
+            {
+                eErr = eOTA_DeltaErr_BadPatch;
+            }
+            else
+            {
+                pxDelta->ulOldOffset -= pxDelta->ulSeek;
+            }
+        }
+        else
+        {
+            if( pxDelta->ulSeek > ( pxDelta->ulOldSize - pxDelta->ulOldOffset ) )
+            {
+                eErr = eOTA_DeltaErr_BadPatch;
+            }
+            else
+            {
+                pxDelta->ulOldOffset += pxDelta->ulSeek;
+            }
+        }
+
+        if( eErr != eOTA_DeltaErr_None )
+        {
+            /* The error is returned. */
+        }
+        else if( ( pxDelta->ulWritten + pxDelta->usBuffered ) == pxDelta->ulNewSize )
+        {
+            eErr = prvFlush( pxDelta );
+            pxDelta->ucState = otadeltaSTATE_DONE;
+        }
+        else
+        {
+            pxDelta->ucState = otadeltaSTATE_DIFF_LENGTH;
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvVarintDone( OTA_Delta_t * pxDelta,
+                                     uint32_t ulValue )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulNewRemaining = pxDelta->ulNewSize - ( pxDelta->ulWritten + pxDelta->usBuffered );
+
+    if( pxDelta->ucState == otadeltaSTATE_DIFF_LENGTH )
+    {
+        /* The diff bytes must fit in both files. */
+        if( ( ulValue > ulNewRemaining ) || ( ulValue > ( pxDelta->ulOldSize - pxDelta->ulOldOffset ) ) )
+        {
+            eErr = eOTA_DeltaErr_BadPatch;
+        }
+        else
+        {
+            pxDelta->ulDiffRemaining = ulValue;
+            pxDelta->ucState = otadeltaSTATE_EXTRA_LENGTH;
+        }
+    }
+    else if( pxDelta->ucState == otadeltaSTATE_EXTRA_LENGTH )
+    {
+        if( ulValue > ( ulNewRemaining - pxDelta->ulDiffRemaining ) )
+        {
+            eErr = eOTA_DeltaErr_BadPatch;
+        }
+        else
+        {
+            pxDelta->ulExtraRemaining = ulValue;
+            pxDelta->ucState = otadeltaSTATE_SEEK;
+        }
+    }
+    else if( pxDelta->ucState == otadeltaSTATE_SEEK )
+    {
+        /* Zigzag decoding: even values are positive, odd values negative. */
+        pxDelta->ucSeekBack = ( uint8_t ) ( ulValue & 1U );
+        pxDelta->ulSeek = ( ulValue >> 1 ) + ( ulValue & 1U );
+        eErr = prvNextPart( pxDelta );
+    }
+    else if( pxDelta->ucState == otadeltaSTATE_EQUAL_COUNT )
+    {
+        if( ulValue > pxDelta->ulDiffRemaining )
+        {
+            eErr = eOTA_DeltaErr_BadPatch;
+        }
+        else
+        {
+            pxDelta->ucEmptyRun = ( ulValue == 0U ) ? 1U : 0U;
+            pxDelta->ucState = otadeltaSTATE_CHANGED_COUNT;
+            eErr = prvProduceDiff( pxDelta, NULL, ulValue );
+        }
+    }
+    else /* otadeltaSTATE_CHANGED_COUNT */
+    {
+        /* An empty pair would not make progress. */
+        if( ( ulValue > pxDelta->ulDiffRemaining ) || ( ( ulValue == 0U ) && ( pxDelta->ucEmptyRun != 0U ) ) )
+        {
+            eErr = eOTA_DeltaErr_BadPatch;
+        }
+        else if( ulValue > 0U )
+        {
+            pxDelta->ulRunRemaining = ulValue;
+            pxDelta->ucState = otadeltaSTATE_CHANGED;
+        }
+        else
+        {
+            eErr = prvNextPart( pxDelta );
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+static OTA_DeltaErr_t prvVarintByte( OTA_Delta_t * pxDelta,
+                                     uint8_t ucByte )
+{
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulValue;
+
+    if( ( pxDelta->ucVarintShift == otadeltaVARINT_LAST_SHIFT ) && ( ( ucByte & otadeltaVARINT_LAST_MASK ) != 0U ) )
+    {
+        /* The varint does not fit in 32 bits. */
+        eErr = eOTA_DeltaErr_BadPatch;
+    }
+    else
+    {
+        pxDelta->ulVarint |= ( uint32_t ) ( ucByte & otadeltaVARINT_VALUE_MASK ) << pxDelta->ucVarintShift;
+
+        if( ( ucByte & otadeltaVARINT_MORE ) != 0U )
+        {
+            pxDelta->ucVarintShift += 7U;
+        }
+        else
+        {
+            ulValue = pxDelta->ulVarint;
+            pxDelta->ulVarint = 0U;
+            pxDelta->ucVarintShift = 0U;
+            eErr = prvVarintDone( pxDelta, ulValue );
+        }
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+void OTA_DeltaInit( OTA_Delta_t * pxDelta,
+                    OTA_DeltaReadOld_t xReadOld,
+                    OTA_DeltaWriteNew_t xWriteNew,
+                    void * pvContext )
+{
+    memset( pxDelta, 0, sizeof( OTA_Delta_t ) );
+    pxDelta->xReadOld = xReadOld;
+    pxDelta->xWriteNew = xWriteNew;
+    pxDelta->pvContext = pvContext;
+    pxDelta->eError = eOTA_DeltaErr_None;
+    pxDelta->ucState = otadeltaSTATE_HEADER;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DeltaErr_t OTA_DeltaApply( OTA_Delta_t * pxDelta,
+                               const uint8_t * pucPatch,
+                               uint32_t ulLength )
+{
+    OTA_DeltaErr_t eErr = pxDelta->eError;
+    uint32_t ulChunk;
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulLength > 0U ) )
+    {
+        if( pxDelta->ucState == otadeltaSTATE_HEADER )
+        {
+            ulChunk = OTA_DELTA_HEADER_SIZE - pxDelta->usBuffered;
+            ulChunk = ( ulChunk > ulLength ) ? ulLength : ulChunk;
+            memcpy( &pxDelta->ucBuffer[ pxDelta->usBuffered ], pucPatch, ulChunk );
+            pxDelta->usBuffered += ( uint16_t ) ulChunk;
+
+            if( pxDelta->usBuffered == OTA_DELTA_HEADER_SIZE )
+            {
+                eErr = prvParseHeader( pxDelta );
+            }
+        }
+        else if( pxDelta->ucState == otadeltaSTATE_CHANGED )
+        {
+            ulChunk = ( pxDelta->ulRunRemaining > ulLength ) ? ulLength : pxDelta->ulRunRemaining;
+            pxDelta->ulRunRemaining -= ulChunk;
+            eErr = prvProduceDiff( pxDelta, pucPatch, ulChunk );
+
+            if( ( eErr == eOTA_DeltaErr_None ) && ( pxDelta->ulRunRemaining == 0U ) )
+            {
+                eErr = prvNextPart( pxDelta );
+            }
+        }
+        else if( pxDelta->ucState == otadeltaSTATE_EXTRA )
+        {
+            ulChunk = ( pxDelta->ulExtraRemaining > ulLength ) ? ulLength : pxDelta->ulExtraRemaining;
+            eErr = prvProduceExtra( pxDelta, pucPatch, ulChunk );
+
+            if( ( eErr == eOTA_DeltaErr_None ) && ( pxDelta->ulExtraRemaining == 0U ) )
+            {
+                eErr = prvNextPart( pxDelta );
+            }
+        }
+        else if( pxDelta->ucState == otadeltaSTATE_DONE )
+        {
+            /* The patch goes on after the new file is complete. */
+            ulChunk = 0U;
+            eErr = eOTA_DeltaErr_BadPatch;
+        }
+        else
+        {
+            ulChunk = 1U;
+            eErr = prvVarintByte( pxDelta, *pucPatch );
+        }
+
+        pucPatch += ulChunk;
+        ulLength -= ulChunk;
+    }
+
+    pxDelta->eError = eErr;
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+OTA_DeltaErr_t OTA_DeltaFinish( const OTA_Delta_t * pxDelta )
+{
+    OTA_DeltaErr_t eErr = pxDelta->eError;
+
+    if( ( eErr == eOTA_DeltaErr_None ) && ( pxDelta->ucState != otadeltaSTATE_DONE ) )
+    {
+        eErr = eOTA_DeltaErr_BadPatch;
+    }
+
+    return eErr;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OTA_DeltaNewSize( const OTA_Delta_t * pxDelta )
+{
+    return pxDelta->ulNewSize;
+}
@@ -383,14 +383,19 @@ OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
 {
     OTA_Err_t result;
     uint32_t ulSignerCertSize;
-    void * pvSigVerifyContext;
+    void * pvSigVerifyContext = C->pvSigVerifyContext;
+    bool xHashed = ( pvSigVerifyContext != NULL );
     u8 * pucSignerCert = 0;
     static spi_flash_mmap_memory_t ota_data_map;
     const void * buf = NULL;
 
+    /* Take over the verification of a file the OTA agent hashed as it was received. */
+    C->pvSigVerifyContext = NULL;
+
     /* Verify an ECDSA-SHA256 signature. */
-    if( CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA,
-                                           cryptoHASH_ALGORITHM_SHA256 ) == pdFALSE )
+    if( ( xHashed == false ) &&
+        ( CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA,
+                                             cryptoHASH_ALGORITHM_SHA256 ) == pdFALSE ) )
     {
         ESP_LOGE( TAG, "signature verification start failed" );
         return kOTA_Err_SignatureCheckFailed;
@@ -404,18 +409,21 @@ OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
         return kOTA_Err_BadSignerCert;
     }
 
-    esp_err_t ret = esp_partition_mmap( ota_ctx.update_partition, 0, ota_ctx.data_write_len,
-                                        SPI_FLASH_MMAP_DATA, &buf, &ota_data_map );
-
-    if( ret != ESP_OK )
+    if( xHashed == false )
     {
-        ESP_LOGE( TAG, "partition mmap failed %d", ret );
-        result = kOTA_Err_SignatureCheckFailed;
-        goto end;
-    }
+        esp_err_t ret = esp_partition_mmap( ota_ctx.update_partition, 0, ota_ctx.data_write_len,
+                                            SPI_FLASH_MMAP_DATA, &buf, &ota_data_map );
+
+        if( ret != ESP_OK )
+        {
+            ESP_LOGE( TAG, "partition mmap failed %d", ret );
+            result = kOTA_Err_SignatureCheckFailed;
+            goto end;
+        }
 
-    CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, buf, ota_ctx.data_write_len );
-    spi_flash_munmap( ota_data_map );
+        CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, buf, ota_ctx.data_write_len );
+        spi_flash_munmap( ota_data_map );
+    }
 
     if( CRYPTO_SignatureVerificationFinal( pvSigVerifyContext, ( char * ) pucSignerCert, ulSignerCertSize,
                                            C->pxSignature->ucData, C->pxSignature->usSize ) == pdFALSE )
@@ -568,6 +576,57 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
     return iBlockSize;
 }
 
+int32_t prvPAL_ReadActiveImage( OTA_FileContext_t * const C,
+                                uint32_t ulOffset,
+                                uint8_t * const pucBuffer,
+                                uint32_t ulLength )
+{
+    const esp_partition_t * running = esp_ota_get_running_partition();
+
+    ( void ) C;
+
+    if( ( running == NULL ) || ( ulOffset > running->size ) || ( ulLength > ( running->size - ulOffset ) ) )
+    {
+        ESP_LOGE( TAG, "Read outside of the running partition at the offset %d", ulOffset );
+        return -1;
+    }
+
+    if( esp_partition_read( running, ulOffset, pucBuffer, ulLength ) != ESP_OK )
+    {
+        ESP_LOGE( TAG, "Couldn't read the running partition at the offset %d", ulOffset );
+        return -1;
+    }
+
+    return ulLength;
+}
+
+/* Resuming downloads is not supported: the OTA partition is erased by each download. */
+
+OTA_Err_t prvPAL_SaveResumeState( OTA_FileContext_t * const C, const uint8_t * pucState, uint32_t ulLength )
+{
+    ( void ) C;
+    ( void ) pucState;
+    ( void ) ulLength;
+
+    return kOTA_Err_ResumeStateFailed;
+}
+
+int32_t prvPAL_LoadResumeState( uint8_t * const pucState, uint32_t ulMaxLength )
+{
+    ( void ) pucState;
+    ( void ) ulMaxLength;
+
+    return -1;
+}
+
+OTA_Err_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C )
+{
+    ( void ) C;
+
+    ESP_LOGE( TAG, "Resuming downloads is not supported" );
+    return kOTA_Err_RxFileCreateFailed;
+}
+
 OTA_PAL_ImageState_t prvPAL_GetPlatformImageState()
 {
     OTA_PAL_ImageState_t eImageState = eOTA_PAL_ImageState_Unknown;
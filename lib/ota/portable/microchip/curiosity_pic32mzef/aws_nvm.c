@@ -110,13 +110,23 @@ bool_t AWS_NVM_QuadWordWrite(const uint32_t* address, const uint32_t* data, uint
     }
 
     uint32_t flash_phys_addr = KVA_TO_PA((uint32_t)address);
+    uint32_t quad_buff[AWS_NVM_QUAD_SIZE / sizeof(uint32_t)];
 
     bool_t success = pdTRUE;
     while(nQuads--)
     {
+        const uint32_t* quad_data = data;
+
+        if(((uint32_t)data & (sizeof(uint32_t) - 1)) != 0)
+        {   // OTA blocks are written straight from the received message, which
+            // is not word aligned; the NVM needs whole words
+            memcpy(quad_buff, data, sizeof(quad_buff));
+            quad_data = quad_buff;
+        }
+
         PLIB_NVM_FlashAddressToModify(NVM_ID_0, flash_phys_addr);
 
-        PLIB_NVM_FlashProvideQuadData(NVM_ID_0, (uint32_t*)data);
+        PLIB_NVM_FlashProvideQuadData(NVM_ID_0, (uint32_t*)quad_data);
 
         if(!AWS_NVMOperation(QUAD_WORD_PROGRAM_OPERATION))
         {
@@ -351,6 +351,68 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
     return sReturnVal;
 }
 
+/**
+ * @brief Reads bytes of the active image, which is in the lower flash bank
+ * laid out as the new image is in the upper one.
+ */
+int32_t prvPAL_ReadActiveImage( OTA_FileContext_t * const C,
+                                uint32_t ulOffset,
+                                uint8_t * const pucBuffer,
+                                uint32_t ulLength )
+{
+    int32_t lReturnVal;
+
+    if( prvContextValidate( C ) == ( bool_t ) pdFALSE )
+    {
+        lReturnVal = MCHP_ERR_INVALID_CONTEXT;
+    }
+    else if( ( ulOffset > ulFlashImageMaxSize ) || ( ulLength > ( ulFlashImageMaxSize - ulOffset ) ) )
+    {   /* invalid address. */
+        lReturnVal = MCHP_ERR_ADDR_OUT_OF_RANGE;
+    }
+    else
+    {
+        /* Program flash is memory mapped, and read through the uncached segment as in prvPAL_GetPlatformImageState. */
+        const uint8_t * pucFlashAddr = ( const uint8_t * ) KVA0_TO_KVA1( &pcFlashLowerBankStart[ sizeof( BootImageHeader_t ) + ulOffset ] ); /*lint !e923 !e9078 Please see earlier lint comment header. */
+
+        memcpy( pucBuffer, pucFlashAddr, ulLength );
+        lReturnVal = ( int32_t ) ulLength;
+    }
+
+    return lReturnVal;
+}
+
+/**
+ * @brief Resuming downloads is not supported: the upper flash bank is erased
+ * by each download.
+ */
+OTA_Err_t prvPAL_SaveResumeState( OTA_FileContext_t * const C,
+                                  const uint8_t * pucState,
+                                  uint32_t ulLength )
+{
+    ( void ) C;
+    ( void ) pucState;
+    ( void ) ulLength;
+
+    return kOTA_Err_ResumeStateFailed;
+}
+
+int32_t prvPAL_LoadResumeState( uint8_t * const pucState,
+                                uint32_t ulMaxLength )
+{
+    ( void ) pucState;
+    ( void ) ulMaxLength;
+
+    return -1;
+}
+
+OTA_Err_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C )
+{
+    ( void ) C;
+
+    return kOTA_Err_RxFileCreateFailed;
+}
+
 /**
  * @brief Closes the specified file. This will also authenticate the file if it
  * is marked as secure.
@@ -416,12 +478,17 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
 
     OTA_Err_t eResult;
     uint32_t ulSignerCertSize;
-    void * pvSigVerifyContext;
+    void * pvSigVerifyContext = C->pvSigVerifyContext;
+    bool_t xHashed = ( pvSigVerifyContext != NULL ) ? ( bool_t ) pdTRUE : ( bool_t ) pdFALSE;
     uint8_t * pucSignerCert = NULL;
 
+    /* Take over the verification of a file the OTA agent hashed as it was received. */
+    C->pvSigVerifyContext = NULL;
+
     /* Verify an ECDSA-SHA256 signature. */
-    if( CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA,
-                                           cryptoHASH_ALGORITHM_SHA256 ) == pdFALSE )
+    if( ( xHashed == ( bool_t ) pdFALSE ) &&
+        ( CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA,
+                                             cryptoHASH_ALGORITHM_SHA256 ) == pdFALSE ) )
     {
         eResult = kOTA_Err_SignatureCheckFailed;
     }
@@ -437,10 +504,13 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
         }
         else
         {
-            const uint8_t * pucFlashAddr = &pcProgImageBankStart[ sizeof( BootImageHeader_t ) + pxCurOTADesc->ulLowImageOffset ]; /* Image descriptor is not part of the image. */
-            pucFlashAddr = ( const uint8_t * ) KVA0_TO_KVA1( pucFlashAddr );                                                      /*lint !e9078 !e923 !e9027 !e9029 !e9033 !e9079 Please see the comment header block above. */
-            CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, pucFlashAddr,
-                                                pxCurOTADesc->ulHighImageOffset - pxCurOTADesc->ulLowImageOffset );
+            if( xHashed == ( bool_t ) pdFALSE )
+            {
+                const uint8_t * pucFlashAddr = &pcProgImageBankStart[ sizeof( BootImageHeader_t ) + pxCurOTADesc->ulLowImageOffset ]; /* Image descriptor is not part of the image. */
+                pucFlashAddr = ( const uint8_t * ) KVA0_TO_KVA1( pucFlashAddr );                                                      /*lint !e9078 !e923 !e9027 !e9029 !e9033 !e9079 Please see the comment header block above. */
+                CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, pucFlashAddr,
+                                                    pxCurOTADesc->ulHighImageOffset - pxCurOTADesc->ulLowImageOffset );
+            }
 
             if( CRYPTO_SignatureVerificationFinal( pvSigVerifyContext, ( char * ) pucSignerCert, ulSignerCertSize,
                                                    C->pxSignature->ucData, C->pxSignature->usSize ) == pdFALSE )
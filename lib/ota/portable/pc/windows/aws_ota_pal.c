@@ -27,6 +27,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <windows.h>
 #include "FreeRTOS.h"
 #include "aws_crypto.h"
 #include "aws_ota_pal.h"
@@ -53,6 +55,11 @@ static inline BaseType_t prvContextValidate( OTA_FileContext_t * C )
 /* Size of buffer used in file operations on this platform (Windows). */
 #define OTA_PAL_WIN_BUF_SIZE ( ( size_t ) 4096UL )
 
+/* Files in which the resume state of the file being received is saved, written to the temporary
+ * file first so that the saved state is replaced at once. */
+#define OTA_PAL_RESUME_FILE_PATH        "ota_resume.dat"
+#define OTA_PAL_RESUME_TEMP_FILE_PATH   "ota_resume.tmp"
+
 /* Attempt to create a new receive file for the file chunks as they come in. */
 
 OTA_Err_t prvPAL_CreateFileForRx( OTA_FileContext_t * const C )
@@ -192,6 +199,163 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C,
     return ( int16_t ) lResult;
 }
 
+/* Read bytes of the active image, which is the running executable on Windows. */
+
+int32_t prvPAL_ReadActiveImage( OTA_FileContext_t * const C,
+                                uint32_t ulOffset,
+                                uint8_t * const pucBuffer,
+                                uint32_t ulLength )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_ReadActiveImage" );
+
+    int32_t lResult = -1;
+    char cPath[ MAX_PATH ];
+    FILE * pxImage;
+
+    ( void ) C;
+
+    if( GetModuleFileNameA( NULL, cPath, sizeof( cPath ) ) == 0U )
+    {
+        OTA_LOG_L1( "[%s] ERROR - Unable to find the executable.\r\n", OTA_METHOD_NAME );
+    }
+    else
+    {
+        pxImage = fopen( cPath, "rb" ); /*lint !e586
+                                         * C standard library call is being used for portability. */
+
+        if( pxImage == NULL )
+        {
+            OTA_LOG_L1( "[%s] ERROR - Unable to open the executable.\r\n", OTA_METHOD_NAME );
+        }
+        else
+        {
+            if( fseek( pxImage, ( long ) ulOffset, SEEK_SET ) == 0 ) /*lint !e586
+                                                                     * C standard library call is being used for portability. */
+            {
+                lResult = ( int32_t ) fread( pucBuffer, 1, ulLength, pxImage ); /*lint !e586
+                                                                                * C standard library call is being used for portability. */
+            }
+
+            ( void ) fclose( pxImage ); /*lint !e586
+                                         * C standard library call is being used for portability. */
+        }
+    }
+
+    return lResult;
+}
+
+/* Save the resume state of the file being received, after flushing the blocks written to it. */
+
+OTA_Err_t prvPAL_SaveResumeState( OTA_FileContext_t * const C,
+                                  const uint8_t * pucState,
+                                  uint32_t ulLength )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_SaveResumeState" );
+
+    OTA_Err_t eResult = kOTA_Err_ResumeStateFailed;
+    FILE * pxState;
+
+    if( ( pucState == NULL ) || ( ulLength == 0U ) )
+    {
+        /* Erase the saved state, if any. */
+        if( ( remove( OTA_PAL_RESUME_FILE_PATH ) == 0 ) || ( errno == ENOENT ) ) /*lint !e586 !e40
+                                                                                 * C standard library call is being used for portability. */
+        {
+            eResult = kOTA_Err_None;
+        }
+    }
+    else if( ( prvContextValidate( C ) == pdTRUE ) && ( fflush( C->pxFile ) == 0 ) ) /*lint !e586
+                                                                                      * C standard library call is being used for portability. */
+    {
+        pxState = fopen( OTA_PAL_RESUME_TEMP_FILE_PATH, "wb" ); /*lint !e586
+                                                                 * C standard library call is being used for portability. */
+
+        if( pxState != NULL )
+        {
+            if( fwrite( pucState, 1, ulLength, pxState ) == ulLength ) /*lint !e586
+                                                                        * C standard library call is being used for portability. */
+            {
+                eResult = kOTA_Err_None;
+            }
+
+            if( fclose( pxState ) != 0 ) /*lint !e586
+                                          * C standard library call is being used for portability. */
+            {
+                eResult = kOTA_Err_ResumeStateFailed;
+            }
+
+            if( ( eResult == kOTA_Err_None ) &&
+                ( MoveFileExA( OTA_PAL_RESUME_TEMP_FILE_PATH, OTA_PAL_RESUME_FILE_PATH, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) == 0 ) )
+            {
+                eResult = ( kOTA_Err_ResumeStateFailed | ( GetLastError() & kOTA_PAL_ErrMask ) );
+            }
+        }
+    }
+    else
+    {
+        /* The state of a file which can't be flushed isn't saved. */
+    }
+
+    if( eResult != kOTA_Err_None )
+    {
+        OTA_LOG_L1( "[%s] ERROR - Unable to save the resume state.\r\n", OTA_METHOD_NAME );
+    }
+
+    return eResult;
+}
+
+/* Load the resume state of the file being received. */
+
+int32_t prvPAL_LoadResumeState( uint8_t * const pucState,
+                                uint32_t ulMaxLength )
+{
+    int32_t lResult = -1;
+    FILE * pxState;
+
+    pxState = fopen( OTA_PAL_RESUME_FILE_PATH, "rb" ); /*lint !e586
+                                                        * C standard library call is being used for portability. */
+
+    if( pxState != NULL )
+    {
+        lResult = ( int32_t ) fread( pucState, 1, ulMaxLength, pxState ); /*lint !e586
+                                                                           * C standard library call is being used for portability. */
+        ( void ) fclose( pxState );                                        /*lint !e586
+                                                                           * C standard library call is being used for portability. */
+    }
+
+    return lResult;
+}
+
+/* Open the receive file partly received before a reset, without truncating it. */
+
+OTA_Err_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_ResumeFileForRx" );
+
+    OTA_Err_t eResult = kOTA_Err_RxFileCreateFailed;
+
+    if( ( C != NULL ) && ( C->pucFilePath != NULL ) )
+    {
+        C->pxFile = fopen( ( const char * ) C->pucFilePath, "r+b" ); /*lint !e586
+                                                                     * C standard library call is being used for portability. */
+
+        if( C->pxFile != NULL )
+        {
+            eResult = kOTA_Err_None;
+            OTA_LOG_L1( "[%s] Receive file resumed.\r\n", OTA_METHOD_NAME );
+        }
+        else
+        {
+            eResult = ( kOTA_Err_RxFileCreateFailed | ( errno & kOTA_PAL_ErrMask ) ); /*lint !e40 !e737 !e9027 !e9029
+                                                                                       * Errno is being used in accordance with host API documentation.
+                                                                                       * Bitmasking is being used to preserve host API error with library status code. */
+            OTA_LOG_L1( "[%s] ERROR - Unable to open the partly received file.\r\n", OTA_METHOD_NAME );
+        }
+    }
+
+    return eResult;
+}
+
 /* Close the specified file. This shall authenticate the file if it is marked as secure. */
 
 OTA_Err_t prvPAL_CloseFile( OTA_FileContext_t * const C )
@@ -263,11 +427,18 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
     uint32_t ulSignerCertSize;
     uint8_t * pucBuf, * pucSignerCert;
     void * pvSigVerifyContext;
+    BaseType_t xHashed;
 
     if( prvContextValidate( C ) == pdTRUE )
     {
+        /* Take over the verification of a file the OTA agent hashed as it was received. */
+        pvSigVerifyContext = C->pvSigVerifyContext;
+        C->pvSigVerifyContext = NULL;
+        xHashed = ( pvSigVerifyContext != NULL ) ? pdTRUE : pdFALSE;
+
         /* Verify an ECDSA-SHA256 signature. */
-        if( pdFALSE == CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA, cryptoHASH_ALGORITHM_SHA256 ) )
+        if( ( pvSigVerifyContext == NULL ) &&
+            ( pdFALSE == CRYPTO_SignatureVerificationStart( &pvSigVerifyContext, cryptoASYMMETRIC_ALGORITHM_ECDSA, cryptoHASH_ALGORITHM_SHA256 ) ) )
         {
             eResult = kOTA_Err_SignatureCheckFailed;
         }
@@ -283,17 +454,23 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
 
                 if( pucBuf != NULL )
                 {
-                    /* Rewind the received file to the beginning. */
-                    if( fseek( C->pxFile, 0L, SEEK_SET ) == 0 ) /*lint !e586
-                                                                  * C standard library call is being used for portability. */
+                    /* Rewind the received file to the beginning, unless it is already hashed. */
+                    if( ( xHashed == pdTRUE ) ||
+                        ( fseek( C->pxFile, 0L, SEEK_SET ) == 0 ) ) /*lint !e586
+                                                                     * C standard library call is being used for portability. */
                     {
-                        do
+                        while( xHashed == pdFALSE )
                         {
                             ulBytesRead = fread( pucBuf, 1, OTA_PAL_WIN_BUF_SIZE, C->pxFile ); /*lint !e586
                                                                                                * C standard library call is being used for portability. */
                             /* Include the file chunk in the signature validation. Zero size is OK. */
                             CRYPTO_SignatureVerificationUpdate( pvSigVerifyContext, pucBuf, ulBytesRead );
-                        } while( ulBytesRead > 0UL );
+
+                            if( ulBytesRead == 0UL )
+                            {
+                                xHashed = pdTRUE;
+                            }
+                        }
 
                         if( pdFALSE == CRYPTO_SignatureVerificationFinal( pvSigVerifyContext,
                                                                           ( char * ) pucSignerCert,
@@ -307,7 +484,8 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
                     }
                     else
                     {
-                        /* Nothing special to do. */
+                        OTA_LOG_L1( "[%s] ERROR - Failed to rewind the file.\r\n", OTA_METHOD_NAME );
+                        eResult = kOTA_Err_SignatureCheckFailed;
                     }
 
                     /* Free the temporary file page buffer. */
@@ -326,6 +504,12 @@ static OTA_Err_t prvPAL_CheckFileSignature( OTA_FileContext_t * const C )
             {
                 eResult = kOTA_Err_BadSignerCert;
             }
+
+            /* Free the verification context if the signature was not checked. */
+            if( pvSigVerifyContext != NULL )
+            {
+                ( void ) CRYPTO_SignatureVerificationFinal( pvSigVerifyContext, NULL, 0, NULL, 0 );
+            }
         }
     }
     else
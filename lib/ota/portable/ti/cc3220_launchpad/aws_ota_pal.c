@@ -541,3 +541,60 @@ int16_t prvPAL_WriteBlock( OTA_FileContext_t * const C, uint32_t ulOffset, uint8
     	}
     return lReturnVal;
 }
+
+/* Read bytes of the active image. Delta updates are not supported on this platform, where the
+ * active image is stored in a file system which the new image replaces as a whole. */
+
+int32_t prvPAL_ReadActiveImage( OTA_FileContext_t * const C,
+                                uint32_t ulOffset,
+                                uint8_t * const pucBuffer,
+                                uint32_t ulLength )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_ReadActiveImage" );
+
+    ( void ) C;
+    ( void ) ulOffset;
+    ( void ) pucBuffer;
+    ( void ) ulLength;
+
+    OTA_LOG_L1( "[%s] Delta updates are not supported.\r\n", OTA_METHOD_NAME );
+
+    return -1;
+}
+
+
+/* Resuming downloads is not supported on this platform, where the receive file is created
+ * again by each download. */
+
+OTA_Err_t prvPAL_SaveResumeState( OTA_FileContext_t * const C,
+                                  const uint8_t * pucState,
+                                  uint32_t ulLength )
+{
+    ( void ) C;
+    ( void ) pucState;
+    ( void ) ulLength;
+
+    return kOTA_Err_ResumeStateFailed;
+}
+
+
+int32_t prvPAL_LoadResumeState( uint8_t * const pucState,
+                                uint32_t ulMaxLength )
+{
+    ( void ) pucState;
+    ( void ) ulMaxLength;
+
+    return -1;
+}
+
+
+OTA_Err_t prvPAL_ResumeFileForRx( OTA_FileContext_t * const C )
+{
+    DEFINE_OTA_METHOD_NAME( "prvPAL_ResumeFileForRx" );
+
+    ( void ) C;
+
+    OTA_LOG_L1( "[%s] Resuming downloads is not supported.\r\n", OTA_METHOD_NAME );
+
+    return kOTA_Err_RxFileCreateFailed;
+}
@@ -49,12 +49,39 @@ typedef struct SSOCKETContext
     char ** ppcAlpnProtocols;
     uint32_t ulAlpnProtocolsCount;
     BaseType_t xConnectAttempted;
+    #if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+        void ( * pxWakeupCallback )( Socket_t xSocket );
+        struct SSOCKETContext * pxNextWakeupContext;
+    #endif
 } SSOCKETContext_t, * SSOCKETContextPtr_t;
 
+/*
+ * The contexts whose socket has a wakeup callback. The callback is invoked
+ * by the IP task with the FreeRTOS+TCP socket, which is looked up here so
+ * that the application receives the secure socket, as with the other ports.
+ */
+#if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+    static SSOCKETContextPtr_t pxWakeupContexts = NULL;
+#endif
+
 /*
  * Helper routines.
  */
 
+/*
+ * @brief Wakeup callback registered with FreeRTOS+TCP.
+ */
+#if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+    static void prvWakeupCallback( Socket_t xSocket );
+#endif
+
+/*
+ * @brief Removes a context from the contexts with a wakeup callback.
+ */
+#if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+    static void prvRemoveWakeupContext( SSOCKETContextPtr_t pxContext );
+#endif
+
 /*
  * @brief Network send callback.
  */
@@ -81,6 +108,63 @@ static BaseType_t prvNetworkRecv( void * pvContext,
 }
 /*-----------------------------------------------------------*/
 
+#if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+
+    static void prvWakeupCallback( Socket_t xSocket )
+    {
+        SSOCKETContextPtr_t pxContext;
+        void ( * pxWakeupCallback )( Socket_t xSocket ) = NULL;
+
+        vTaskSuspendAll();
+        {
+            for( pxContext = pxWakeupContexts; pxContext != NULL; pxContext = pxContext->pxNextWakeupContext )
+            {
+                if( pxContext->xSocket == xSocket )
+                {
+                    pxWakeupCallback = pxContext->pxWakeupCallback;
+                    break;
+                }
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        /* The callback is invoked with the scheduler running, as it may
+         * block. */
+        if( pxWakeupCallback != NULL )
+        {
+            pxWakeupCallback( ( Socket_t ) pxContext );
+        }
+    }
+
+#endif /* ipconfigSOCKET_HAS_USER_WAKE_CALLBACK */
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+
+    static void prvRemoveWakeupContext( SSOCKETContextPtr_t pxContext )
+    {
+        SSOCKETContextPtr_t * ppxPrevious;
+
+        vTaskSuspendAll();
+        {
+            for( ppxPrevious = &pxWakeupContexts; *ppxPrevious != NULL; ppxPrevious = &( ( *ppxPrevious )->pxNextWakeupContext ) )
+            {
+                if( *ppxPrevious == pxContext )
+                {
+                    *ppxPrevious = pxContext->pxNextWakeupContext;
+                    break;
+                }
+            }
+
+            pxContext->pxWakeupCallback = NULL;
+            pxContext->pxNextWakeupContext = NULL;
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+#endif /* ipconfigSOCKET_HAS_USER_WAKE_CALLBACK */
+/*-----------------------------------------------------------*/
+
 /*
  * Interface routines.
  */
@@ -127,6 +211,11 @@ int32_t SOCKETS_Close( Socket_t xSocket )
             TLS_Cleanup( pxContext->pvTLSContext );
         }
 
+        /* The callback must not be invoked once the context is freed. */
+        #if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+            prvRemoveWakeupContext( pxContext );
+        #endif
+
         /* Close the underlying socket handle. */
         ( void ) FreeRTOS_closesocket( pxContext->xSocket );
 
@@ -443,6 +532,45 @@ int32_t SOCKETS_SetSockOpt( Socket_t xSocket,
                                                xOptionLength );
                 break;
 
+            #if ( ipconfigSOCKET_HAS_USER_WAKE_CALLBACK == 1 )
+                case SOCKETS_SO_WAKEUP_CALLBACK:
+
+                    /* FreeRTOS+TCP invokes its callback with its own socket,
+                     * so the one of the application is invoked from
+                     * prvWakeupCallback with the secure socket instead. */
+                    prvRemoveWakeupContext( pxContext );
+
+                    if( pvOptionValue != NULL )
+                    {
+                        lStatus = FreeRTOS_setsockopt( pxContext->xSocket,
+                                                       lLevel,
+                                                       lOptionName,
+                                                       ( const void * ) prvWakeupCallback, /*lint !e9074 !e9087 The option value is the callback. */
+                                                       sizeof( &( prvWakeupCallback ) ) );
+
+                        if( lStatus == SOCKETS_ERROR_NONE )
+                        {
+                            vTaskSuspendAll();
+                            {
+                                pxContext->pxWakeupCallback = ( void ( * )( Socket_t ) )pvOptionValue; /*lint !e9074 !e9087 The option value is the callback. */
+                                pxContext->pxNextWakeupContext = pxWakeupContexts;
+                                pxWakeupContexts = pxContext;
+                            }
+                            ( void ) xTaskResumeAll();
+                        }
+                    }
+                    else
+                    {
+                        lStatus = FreeRTOS_setsockopt( pxContext->xSocket,
+                                                       lLevel,
+                                                       lOptionName,
+                                                       NULL,
+                                                       xOptionLength );
+                    }
+
+                    break;
+            #endif /* ipconfigSOCKET_HAS_USER_WAKE_CALLBACK */
+
             default:
                 lStatus = FreeRTOS_setsockopt( pxContext->xSocket,
                                                lLevel,
@@ -79,6 +79,17 @@
 #define configMAX_THING_NAME_LENGTH    128
 #define shadowTOPIC_BUFFER_LENGTH      ( configMAX_THING_NAME_LENGTH + ( int16_t ) sizeof( shadowTOPIC_UPDATE_DOCUMENTS ) )
 
+/** The request published for the operations without a document (get and
+ * delete), carrying the client token that the Shadow service echoes in its
+ * response. A generated client token has shadowGENERATED_TOKEN_LENGTH
+ * hexadecimal digits. */
+/** @{ */
+#define shadowREQUEST_PREFIX           "{\"clientToken\":\""
+#define shadowREQUEST_SUFFIX           "\"}"
+#define shadowGENERATED_TOKEN_LENGTH   ( 16 )
+#define shadowREQUEST_BUFFER_LENGTH    ( sizeof( shadowREQUEST_PREFIX shadowREQUEST_SUFFIX ) + shadowGENERATED_TOKEN_LENGTH )
+/** @} */
+
 #if shadowconfigENABLE_DEBUG_LOGS == 1
     #define Shadow_debug_printf( X )    configPRINTF( X )
 #else
@@ -101,14 +112,28 @@ typedef enum ShadowOperationName
 } ShadowOperationName_t;
 
 /**
- * @brief Data on the Shadow operation currently in progress.
+ * @brief A Shadow operation waiting for its accepted or rejected response.
  *
+ * The responses are routed to the waiting operations by client token, so that
+ * several operations can be in progress on the same Shadow Client.
  */
-typedef struct ShadowOperationData
+typedef struct PendingOperation
 {
-    ShadowOperationName_t xOperationInProgress;
+    BaseType_t xInUse;
+    uint32_t ulSequence; /* Orders the operations using the same client token. */
+
+    ShadowOperationName_t xOperationName;
+    const char * pcOperationTopic;
     ShadowOperationParams_t * pxOperationParams;
-} ShadowOperationData_t;
+
+    char cClientToken[ shadowconfigMAX_CLIENT_TOKEN_LENGTH ];
+    uint16_t usClientTokenLength;
+
+    /* Set by the operation-specific callback before it gives xCallbackSemaphore. */
+    ShadowReturnCode_t xOperationResult;
+    SemaphoreHandle_t xCallbackSemaphore;
+    StaticSemaphore_t xCallbackSemaphoreBuffer;
+} PendingOperation_t;
 
 /**
  * @brief Data on the timeout by which a function needs to complete.
@@ -172,29 +197,24 @@ typedef struct ShadowClient
     BaseType_t xDeleteSubscribed;
 
     /* Synchronization mechanisms. */
-    SemaphoreHandle_t xOperationDataMutex; /* Allows only one in-progress operation. */
-    SemaphoreHandle_t xOperationMutex;     /* Allows only one in-progress operation. */
-    SemaphoreHandle_t xCallbackSemaphore;  /* Communication with callbacks. */
+    SemaphoreHandle_t xOperationDataMutex; /* Guards xPendingOperations. */
+    SemaphoreHandle_t xOperationMutex;     /* Guards the subscriptions and ucTopicBuffer. */
+    SemaphoreHandle_t xOperationSlots;     /* Counts the free xPendingOperations. */
     StaticSemaphore_t xOperationMutexBuffer;
-    StaticSemaphore_t xCallbackSemaphoreBuffer;
+    StaticSemaphore_t xOperationSlotsBuffer;
     StaticSemaphore_t xOperationDataMutexBuffer;
 
-    /* Data shared between blocking function and MQTT callback. */
-    ShadowOperationData_t * pxOperationData;
-
-    /* The callback functions pass data to the API calls by setting xOperationResult.
-     * This value is volatile to ensure that the compiler knows the value can change
-     * without anything happening in the API call. */
-    volatile ShadowReturnCode_t xOperationResult;
+    /* Data shared between blocking functions and MQTT callback. */
+    PendingOperation_t xPendingOperations[ shadowconfigMAX_CONCURRENT_OPERATIONS ];
+    UBaseType_t uxPendingOperations;
+    uint32_t ulNextSequence;
 
     /* Callback catalog stores Thing Names and registered callbacks. */
     CallbackCatalogEntry_t xCallbackCatalog[ shadowconfigMAX_THINGS_WITH_CALLBACKS ];
 
-    /* Stores the topic of the in-progress operation. Some of the Shadow API's
-     * static functions depend on this buffer remaining the same throughout a
-     * Shadow API operation. Therefore, only prvShadowOperation (and the static
-     * functions called by prvShadowOperation) should modify the contents of this
-     * buffer. */
+    /* Stores the topics subscribed to and unsubscribed from by
+     * prvShadowOperation (and the static functions called by
+     * prvShadowOperation), which only modify it while holding xOperationMutex. */
     uint8_t ucTopicBuffer[ shadowTOPIC_BUFFER_LENGTH ];
 } ShadowClient_t;
 
@@ -280,12 +300,51 @@ static const CallbackCatalogEntry_t * prvMatchCallbackTopic( const ShadowClient_
                                                              uint16_t usTopicLength,
                                                              ShadowOperationName_t * const pxOperationName );
 
+/**
+ * @brief Finds the pending operation that an accepted or rejected response
+ * belongs to, by topic and client token. Must be called with
+ * xOperationDataMutex held.
+ */
+static PendingOperation_t * prvFindPendingOperation( ShadowClient_t * const pxShadowClient,
+                                                     const MQTTPublishData_t * const pxPublishData,
+                                                     ShadowReturnCode_t * const pxResult );
+
+/**
+ * @brief Reserves a pending operation, whose response is then routed to it.
+ * A client token is generated if pcClientToken is NULL.
+ */
+static PendingOperation_t * prvAddPendingOperation( ShadowClient_t * const pxShadowClient,
+                                                    const ShadowOperationCallParams_t * const pxParams,
+                                                    const char * const pcClientToken,
+                                                    uint16_t usClientTokenLength );
+
+/**
+ * @brief Releases a pending operation. Returns the result of the operation if
+ * its response arrived in the meantime, or xReturn otherwise.
+ */
+static ShadowReturnCode_t prvRemovePendingOperation( ShadowClient_t * const pxShadowClient,
+                                                     PendingOperation_t * const pxOperation,
+                                                     ShadowReturnCode_t xReturn );
+
+/**
+ * @brief Checks whether an operation of the given name is pending.
+ */
+static BaseType_t prvIsOperationPending( ShadowClient_t * const pxShadowClient,
+                                         ShadowOperationName_t xOperationName );
+
+/**
+ * @brief Writes a client token in hexadecimal digits for the operations which
+ * do not publish a document.
+ */
+static void prvCreateClientToken( char * pcClientToken,
+                                  uint32_t ulSequence );
+
 /**
  * @brief Update callback for Shadow Operations.
  */
 static void prvShadowUpdateCallback( BaseType_t xShadowClientID,
                                      ShadowReturnCode_t xResult,
-                                     const ShadowOperationParams_t * const pxParams,
+                                     PendingOperation_t * const pxOperation,
                                      const char * const pcData,
                                      uint32_t ulDataLength );
 
@@ -294,7 +353,7 @@ static void prvShadowUpdateCallback( BaseType_t xShadowClientID,
  */
 static void prvShadowGetCallback( BaseType_t xShadowClientID,
                                   ShadowReturnCode_t xResult,
-                                  ShadowOperationParams_t * const pxParams,
+                                  PendingOperation_t * const pxOperation,
                                   const char * const pcData,
                                   uint32_t ulDataLength,
                                   MQTTBufferHandle_t xBuffer );
@@ -304,6 +363,7 @@ static void prvShadowGetCallback( BaseType_t xShadowClientID,
  */
 static void prvShadowDeleteCallback( BaseType_t xShadowClientID,
                                      ShadowReturnCode_t xResult,
+                                     PendingOperation_t * const pxOperation,
                                      const char * const pcData,
                                      uint32_t ulDataLength );
 
@@ -729,8 +789,8 @@ static BaseType_t prvShadowMQTTCallback( void * pvUserData,
     ShadowOperationName_t xOperationName;
     ShadowReturnCode_t xResult;
     const CallbackCatalogEntry_t * pxCallbackCatalogEntry;
+    PendingOperation_t * pxOperation;
     BaseType_t xReturn = pdFALSE;
-    BaseType_t xCompareLen;
     BaseType_t xShadowClientID;
 
 
@@ -741,7 +801,7 @@ static BaseType_t prvShadowMQTTCallback( void * pvUserData,
     {
         pxPublishData = ( &( pxCallbackParams->u.xPublishData ) );
 
-        /* If xOperationMutex is locked, the client is waiting on the acceptance
+        /* If an operation is pending, the client is waiting on the acceptance
          * or rejection of a publish. Publish results take priority over user notify
          * callbacks. This also means that the client will not be notified of gets or
          * deletes performed by itself in a user notify callback. However, the client
@@ -751,68 +811,53 @@ static BaseType_t prvShadowMQTTCallback( void * pvUserData,
         if( xSemaphoreTake( pxShadowClient->xOperationDataMutex,
                             portMAX_DELAY ) == pdPASS )
         {
-            if( pxShadowClient->pxOperationData != NULL )
-            {
-                /* Verify Thing Name and operation by comparing the received topic with
-                 * the current operation's topic. */
+            /* Find the operation waiting for this response, if any; its topic
+             * and client token both match those of the response. */
+            pxOperation = prvFindPendingOperation( pxShadowClient,
+                                                   pxPublishData,
+                                                   &xResult );
 
-                xCompareLen = ( BaseType_t ) configMIN( ( BaseType_t ) strlen( ( const char * ) pxShadowClient->ucTopicBuffer ),
-                                                        ( BaseType_t ) pxPublishData->usTopicLength );
+            if( pxOperation != NULL )
+            {
+                xOperationMatched = pdTRUE;
 
-                if( strncmp( ( const char * ) pxPublishData->pucTopic,
-                             ( const char * ) pxShadowClient->ucTopicBuffer,
-                             ( size_t ) xCompareLen ) == 0 )
+                switch( pxOperation->xOperationName )
                 {
-                    /* Parse the in-progress operation and result. */
-                    xOperationName = ( pxShadowClient->pxOperationData )->xOperationInProgress;
-                    xResult = prvParseShadowOperationStatus( pxPublishData->pucTopic,
-                                                             pxPublishData->usTopicLength );
-
-                    /* Both an operation and result were identified, and both match
-                     * the operation this Shadow Client is waiting on; call the
-                     * operation-specific callback. */
-                    if( ( xResult != eShadowUnknown ) && ( xOperationName != eShadowOperationOther ) )
-                    {
-                        xOperationMatched = pdTRUE;
+                    case eShadowOperationUpdate:
+                        prvShadowUpdateCallback( xShadowClientID,
+                                                 xResult,
+                                                 pxOperation,
+                                                 ( const char * ) pxPublishData->pvData,
+                                                 pxPublishData->ulDataLength );
+                        break;
+
+                    case eShadowOperationGet:
+                        prvShadowGetCallback( xShadowClientID,
+                                              xResult,
+                                              pxOperation,
+                                              ( const char * ) pxPublishData->pvData,
+                                              pxPublishData->ulDataLength,
+                                              pxPublishData->xBuffer );
 
-                        switch( xOperationName )
+                        /* Only take an MQTT buffer if the Get operation succeeded. */
+                        if( xResult == eShadowSuccess )
                         {
-                            case eShadowOperationUpdate:
-                                prvShadowUpdateCallback( xShadowClientID,
-                                                         xResult,
-                                                         ( pxShadowClient->pxOperationData )->pxOperationParams,
-                                                         ( const char * ) pxPublishData->pvData,
-                                                         pxPublishData->ulDataLength );
-                                break;
-
-                            case eShadowOperationGet:
-                                prvShadowGetCallback( xShadowClientID,
-                                                      xResult,
-                                                      ( pxShadowClient->pxOperationData )->pxOperationParams,
-                                                      ( const char * ) pxPublishData->pvData,
-                                                      pxPublishData->ulDataLength,
-                                                      pxPublishData->xBuffer );
-
-                                /* Only take an MQTT buffer if the Get operation succeeded. */
-                                if( xResult == eShadowSuccess )
-                                {
-                                    xReturn = pdTRUE;
-                                }
-
-                                break;
-
-                            case eShadowOperationDelete:
-                                prvShadowDeleteCallback( xShadowClientID,
-                                                         xResult,
-                                                         ( const char * ) pxPublishData->pvData,
-                                                         pxPublishData->ulDataLength );
-                                break;
-
-                            default:
-                                /* Should not fall here. */
-                                break;
+                            xReturn = pdTRUE;
                         }
-                    }
+
+                        break;
+
+                    case eShadowOperationDelete:
+                        prvShadowDeleteCallback( xShadowClientID,
+                                                 xResult,
+                                                 pxOperation,
+                                                 ( const char * ) pxPublishData->pvData,
+                                                 pxPublishData->ulDataLength );
+                        break;
+
+                    default:
+                        /* Should not fall here. */
+                        break;
                 }
             }
 
@@ -1023,57 +1068,244 @@ static const CallbackCatalogEntry_t * prvMatchCallbackTopic( const ShadowClient_
 
 /*-----------------------------------------------------------*/
 
-static void prvShadowUpdateCallback( BaseType_t xShadowClientID,
-                                     ShadowReturnCode_t xResult,
-                                     const ShadowOperationParams_t * const pxParams,
-                                     const char * const pcData,
-                                     uint32_t ulDataLength )
+static PendingOperation_t * prvFindPendingOperation( ShadowClient_t * const pxShadowClient,
+                                                     const MQTTPublishData_t * const pxPublishData,
+                                                     ShadowReturnCode_t * const pxResult )
 {
-    /* Remove warning about unused parameters. */
-    ( void ) pxParams;
+    PendingOperation_t * pxReturn = NULL;
+    PendingOperation_t * pxOperation;
+    uint8_t ucTopicBuffer[ shadowTOPIC_BUFFER_LENGTH ];
+    const char * pcClientToken = NULL;
+    uint16_t usClientTokenLength = 0;
+    uint16_t usTopicLength;
+    BaseType_t xIterator;
 
-    ShadowClient_t * pxShadowClient;
+    *pxResult = eShadowUnknown;
 
-    BaseType_t xReturn;
+    /* Only responses on accepted and rejected topics complete an operation. */
+    if( ( pxShadowClient->uxPendingOperations > ( UBaseType_t ) 0 ) &&
+        ( pxPublishData->usTopicLength > ( uint16_t ) strlen( shadowTOPIC_SUFFIX_ACCEPTED ) ) )
+    {
+        *pxResult = prvParseShadowOperationStatus( pxPublishData->pucTopic,
+                                                   pxPublishData->usTopicLength );
+    }
 
-    pxShadowClient = &( xShadowClients[ xShadowClientID ] );
+    if( *pxResult != eShadowUnknown )
+    {
+        usClientTokenLength = SHADOW_JSONGetClientToken( ( const char * ) pxPublishData->pvData,
+                                                         pxPublishData->ulDataLength,
+                                                         &pcClientToken );
 
-    /* Verify client token match. */
-    xReturn = SHADOW_JSONDocClientTokenMatch( pxParams->pcData,
-                                              pxParams->ulDataLength,
-                                              pcData,
-                                              ulDataLength );
+        for( xIterator = 0; xIterator < shadowconfigMAX_CONCURRENT_OPERATIONS; xIterator++ )
+        {
+            pxOperation = &( pxShadowClient->xPendingOperations[ xIterator ] );
+
+            /* The oldest operation using this client token and still waiting
+             * (its result is still unknown) gets the response, as the Shadow
+             * service answers the requests in order. */
+            if( ( pxOperation->xInUse == pdTRUE ) &&
+                ( pxOperation->xOperationResult == eShadowUnknown ) &&
+                ( pxOperation->usClientTokenLength == usClientTokenLength ) &&
+                ( ( pxReturn == NULL ) ||
+                  ( ( int32_t ) ( pxOperation->ulSequence - pxReturn->ulSequence ) < 0 ) ) )
+            {
+                if( ( usClientTokenLength == ( uint16_t ) 0 ) ||
+                    ( strncmp( pxOperation->cClientToken,
+                               pcClientToken,
+                               ( size_t ) usClientTokenLength ) == 0 ) )
+                {
+                    /* Verify Thing Name and operation by comparing the received
+                     * topic with the operation's topic. */
+                    usTopicLength = prvCreateTopic( ( char * ) ucTopicBuffer,
+                                                    shadowTOPIC_BUFFER_LENGTH,
+                                                    pxOperation->pcOperationTopic,
+                                                    pxOperation->pxOperationParams->pcThingName );
+
+                    if( ( ( uint32_t ) usTopicLength + strlen( shadowTOPIC_SUFFIX_ACCEPTED ) == ( uint32_t ) pxPublishData->usTopicLength ) &&
+                        ( strncmp( ( const char * ) pxPublishData->pucTopic,
+                                   ( const char * ) ucTopicBuffer,
+                                   ( size_t ) usTopicLength ) == 0 ) )
+                    {
+                        pxReturn = pxOperation;
+                    }
+                }
+            }
+        }
+    }
+
+    return pxReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+static PendingOperation_t * prvAddPendingOperation( ShadowClient_t * const pxShadowClient,
+                                                    const ShadowOperationCallParams_t * const pxParams,
+                                                    const char * const pcClientToken,
+                                                    uint16_t usClientTokenLength )
+{
+    PendingOperation_t * pxReturn = NULL;
+    BaseType_t xIterator;
+
+    if( xSemaphoreTake( pxShadowClient->xOperationDataMutex,
+                        portMAX_DELAY ) == pdPASS )
+    {
+        /* xOperationSlots guarantees that an entry is free. */
+        for( xIterator = 0; xIterator < shadowconfigMAX_CONCURRENT_OPERATIONS; xIterator++ )
+        {
+            if( pxShadowClient->xPendingOperations[ xIterator ].xInUse == pdFALSE )
+            {
+                pxReturn = &( pxShadowClient->xPendingOperations[ xIterator ] );
+                break;
+            }
+        }
+
+        configASSERT( pxReturn != NULL );
+
+        if( pxReturn != NULL )
+        {
+            pxReturn->xInUse = pdTRUE;
+            pxReturn->ulSequence = pxShadowClient->ulNextSequence;
+            pxReturn->xOperationName = pxParams->xOperationName;
+            pxReturn->pcOperationTopic = pxParams->pcOperationTopic;
+            pxReturn->pxOperationParams = pxParams->pxOperationParams;
+            pxReturn->usClientTokenLength = usClientTokenLength;
+
+            if( pcClientToken != NULL )
+            {
+                memcpy( pxReturn->cClientToken, pcClientToken, ( size_t ) usClientTokenLength );
+            }
+            else
+            {
+                prvCreateClientToken( pxReturn->cClientToken, pxReturn->ulSequence );
+            }
+
+            pxReturn->xOperationResult = eShadowUnknown;
+
+            /* Discard a response given to a previous operation after it timed out. */
+            ( void ) xSemaphoreTake( pxReturn->xCallbackSemaphore, 0 );
+
+            pxShadowClient->ulNextSequence++;
+            pxShadowClient->uxPendingOperations++;
+        }
+
+        configASSERT( xSemaphoreGive( pxShadowClient->xOperationDataMutex ) == pdPASS );
+    }
+
+    return pxReturn;
+}
+
+/*-----------------------------------------------------------*/
 
-    if( xReturn == pdPASS )
+static ShadowReturnCode_t prvRemovePendingOperation( ShadowClient_t * const pxShadowClient,
+                                                     PendingOperation_t * const pxOperation,
+                                                     ShadowReturnCode_t xReturn )
+{
+    if( xSemaphoreTake( pxShadowClient->xOperationDataMutex,
+                        portMAX_DELAY ) == pdPASS )
     {
-        pxShadowClient->xOperationResult = xResult;
+        /* The response may have arrived after the wait timed out, in which
+         * case its result (and the buffer of a Get) is still reported. */
+        if( ( xReturn == eShadowTimeout ) &&
+            ( xSemaphoreTake( pxOperation->xCallbackSemaphore, 0 ) == pdPASS ) )
+        {
+            xReturn = pxOperation->xOperationResult;
+        }
+
+        pxOperation->xInUse = pdFALSE;
+        pxShadowClient->uxPendingOperations--;
+
+        configASSERT( xSemaphoreGive( pxShadowClient->xOperationDataMutex ) == pdPASS );
+    }
+    else
+    {
+        Shadow_debug_printf( ( "Error while taking mutex\n" ) );
+        configASSERT( 0 );
+    }
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsOperationPending( ShadowClient_t * const pxShadowClient,
+                                         ShadowOperationName_t xOperationName )
+{
+    BaseType_t xReturn = pdFALSE;
+    BaseType_t xIterator;
 
-        /* For failures, get the code and message. */
-        if( xResult == eShadowFailure )
+    if( xSemaphoreTake( pxShadowClient->xOperationDataMutex,
+                        portMAX_DELAY ) == pdPASS )
+    {
+        for( xIterator = 0; xIterator < shadowconfigMAX_CONCURRENT_OPERATIONS; xIterator++ )
         {
-            pxShadowClient->xOperationResult = prvGetErrorCodeAndMessage( pcData,
-                                                                          ulDataLength,
-                                                                          xShadowClientID,
-                                                                          shadowTOPIC_OPERATION_UPDATE );
+            if( ( pxShadowClient->xPendingOperations[ xIterator ].xInUse == pdTRUE ) &&
+                ( pxShadowClient->xPendingOperations[ xIterator ].xOperationName == xOperationName ) )
+            {
+                xReturn = pdTRUE;
+                break;
+            }
         }
 
-        configASSERT( xSemaphoreGive( pxShadowClient->xCallbackSemaphore ) == pdPASS );
+        configASSERT( xSemaphoreGive( pxShadowClient->xOperationDataMutex ) == pdPASS );
+    }
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCreateClientToken( char * pcClientToken,
+                                  uint32_t ulSequence )
+{
+    static const char cHexDigits[] = "0123456789abcdef";
+    uint32_t ulTicks = ( uint32_t ) xTaskGetTickCount();
+    BaseType_t xIterator;
+
+    /* The tick count makes the token unlikely to match the request of
+     * another device working on the same Thing. */
+    for( xIterator = 0; xIterator < 8; xIterator++ )
+    {
+        pcClientToken[ xIterator ] = cHexDigits[ ( ulTicks >> ( 28 - ( 4 * xIterator ) ) ) & 0xFUL ];
+        pcClientToken[ xIterator + 8 ] = cHexDigits[ ( ulSequence >> ( 28 - ( 4 * xIterator ) ) ) & 0xFUL ];
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvShadowUpdateCallback( BaseType_t xShadowClientID,
+                                     ShadowReturnCode_t xResult,
+                                     PendingOperation_t * const pxOperation,
+                                     const char * const pcData,
+                                     uint32_t ulDataLength )
+{
+    /* The client token was matched when the operation was found. */
+    pxOperation->xOperationResult = xResult;
+
+    /* For failures, get the code and message. */
+    if( xResult == eShadowFailure )
+    {
+        pxOperation->xOperationResult = prvGetErrorCodeAndMessage( pcData,
+                                                                   ulDataLength,
+                                                                   xShadowClientID,
+                                                                   shadowTOPIC_OPERATION_UPDATE );
     }
+
+    configASSERT( xSemaphoreGive( pxOperation->xCallbackSemaphore ) == pdPASS );
 }
 
 /*-----------------------------------------------------------*/
 
 static void prvShadowGetCallback( BaseType_t xShadowClientID,
                                   ShadowReturnCode_t xResult,
-                                  ShadowOperationParams_t * const pxParams,
+                                  PendingOperation_t * const pxOperation,
                                   const char * const pcData,
                                   uint32_t ulDataLength,
                                   MQTTBufferHandle_t xBuffer )
 {
-    ShadowClient_t * pxShadowClient;
+    ShadowOperationParams_t * pxParams;
 
-    pxShadowClient = &( xShadowClients[ xShadowClientID ] );
-    pxShadowClient->xOperationResult = xResult;
+    pxParams = pxOperation->pxOperationParams;
+    pxOperation->xOperationResult = xResult;
 
 /* For successes, fill the user's buffer with the Shadow document. */
     if( xResult == eShadowSuccess )
@@ -1085,37 +1317,35 @@ static void prvShadowGetCallback( BaseType_t xShadowClientID,
 /* For failures , get the code and message. */
     else
     {
-        pxShadowClient->xOperationResult = prvGetErrorCodeAndMessage( pcData,
-                                                                      ulDataLength,
-                                                                      xShadowClientID,
-                                                                      shadowTOPIC_OPERATION_GET );
+        pxOperation->xOperationResult = prvGetErrorCodeAndMessage( pcData,
+                                                                   ulDataLength,
+                                                                   xShadowClientID,
+                                                                   shadowTOPIC_OPERATION_GET );
         pxParams->pcData = NULL;
         pxParams->ulDataLength = 0;
     }
 
-    configASSERT( xSemaphoreGive( pxShadowClient->xCallbackSemaphore ) == pdPASS );
+    configASSERT( xSemaphoreGive( pxOperation->xCallbackSemaphore ) == pdPASS );
 }
 /*-----------------------------------------------------------*/
 
 static void prvShadowDeleteCallback( BaseType_t xShadowClientID,
                                      ShadowReturnCode_t xResult,
+                                     PendingOperation_t * const pxOperation,
                                      const char * const pcData,
                                      uint32_t ulDataLength )
 {
-    ShadowClient_t * pxShadowClient;
-
-    pxShadowClient = &( xShadowClients[ xShadowClientID ] );
-    pxShadowClient->xOperationResult = xResult;
+    pxOperation->xOperationResult = xResult;
 
     if( xResult == eShadowFailure )
     {
-        pxShadowClient->xOperationResult = prvGetErrorCodeAndMessage( pcData,
-                                                                      ulDataLength,
-                                                                      xShadowClientID,
-                                                                      shadowTOPIC_OPERATION_DELETE );
+        pxOperation->xOperationResult = prvGetErrorCodeAndMessage( pcData,
+                                                                   ulDataLength,
+                                                                   xShadowClientID,
+                                                                   shadowTOPIC_OPERATION_DELETE );
     }
 
-    configASSERT( xSemaphoreGive( pxShadowClient->xCallbackSemaphore ) == pdPASS );
+    configASSERT( xSemaphoreGive( pxOperation->xCallbackSemaphore ) == pdPASS );
 }
 /*-----------------------------------------------------------*/
 
@@ -1170,163 +1400,216 @@ static ShadowReturnCode_t prvShadowOperation( ShadowOperationCallParams_t * pxPa
     MQTTAgentPublishParams_t xPublishParams;
     ShadowClient_t * pxShadowClient;
     TimeOutData_t xTimeOutData;
-    ShadowOperationData_t xOperationData;
+    PendingOperation_t * pxOperation = NULL;
     MQTTAgentReturnCode_t xMQTTReturn;
+    uint8_t ucOperationTopic[ shadowTOPIC_BUFFER_LENGTH ];
+    char cRequest[ shadowREQUEST_BUFFER_LENGTH ];
+    const char * pcClientToken = NULL;
+    uint16_t usClientTokenLength = 0;
 
     /* Initialize timeout data. */
     xTimeOutData.xTicksRemaining = pxParams->xTimeoutTicks;
 
-    /* Identify the relevant Shadow Client, then lock that client's operation mutex.
-     * This allows only one operation to be in progress. */
+    /* Identify the relevant Shadow Client, then reserve one of that client's
+     * operation slots. This allows up to shadowconfigMAX_CONCURRENT_OPERATIONS
+     * operations to be in progress. */
     pxShadowClient = &( xShadowClients[ ( pxParams->xShadowClientID ) ] );
 
-    if( xSemaphoreTake( pxShadowClient->xOperationMutex,
-                        xTimeOutData.xTicksRemaining ) == pdPASS )
+    if( pxParams->ulPublishMessageLength == ( uint32_t ) 0 )
     {
-        /* Subscribe to accepted/rejected if necessary. */
-        if( ( BaseType_t ) prvGetSubscribedFlag( pxShadowClient,
-                                                 pxParams->xOperationName ) == pdFALSE )
-        {
-            xReturn = prvShadowSubscribeToAcceptedRejected( pxParams->xShadowClientID,
-                                                            ( pxParams->pxOperationParams )->pcThingName,
-                                                            pxParams->pcOperationAcceptedTopic,
-                                                            pxParams->pcOperationRejectedTopic,
-                                                            &xTimeOutData );
-        }
-        else
-        {
-            xReturn = eShadowSuccess;
-        }
+        /* Get and delete publish a request carrying a client token generated
+         * by prvAddPendingOperation. */
+        usClientTokenLength = shadowGENERATED_TOKEN_LENGTH;
+    }
+    else
+    {
+        /* The response to an update carries the client token of the update
+         * document, if it has one. */
+        pcClientToken = pxParams->pcPublishMessage;
+        usClientTokenLength = SHADOW_JSONGetClientToken( pxParams->pcPublishMessage,
+                                                         pxParams->ulPublishMessageLength,
+                                                         &pcClientToken );
+    }
 
-        if( xReturn == eShadowSuccess )
+    if( usClientTokenLength > ( uint16_t ) shadowconfigMAX_CLIENT_TOKEN_LENGTH )
+    {
+        Shadow_debug_printf( ( "[Shadow %d] Client token of %s is longer than %d.\r\n",
+                               pxParams->xShadowClientID,
+                               pxParams->pcOperationName,
+                               shadowconfigMAX_CLIENT_TOKEN_LENGTH ) );
+    }
+    else if( xSemaphoreTake( pxShadowClient->xOperationSlots,
+                             xTimeOutData.xTicksRemaining ) == pdPASS )
+    {
+        /* The subscriptions are shared by the operations in progress, so they
+         * are only changed while holding the operation mutex. */
+        if( xSemaphoreTake( pxShadowClient->xOperationMutex,
+                            xTimeOutData.xTicksRemaining ) == pdPASS )
         {
-            /* The subscribe to update/accepted and update/rejected succeeded,
-             * so set the appropriate flag. */
-            prvSetSubscribedFlag( pxShadowClient, pxParams->xOperationName, 1 );
-
-            /* This is guarded by xOperationMutex and should never fail. */
-            configASSERT( xSemaphoreTake( pxShadowClient->xCallbackSemaphore,
-                                          xTimeOutData.xTicksRemaining ) == pdPASS );
-
-            /* Fill ucTopicBuffer with the update topic. */
-            xPublishParams.usTopicLength =
-                prvCreateTopic( ( char * ) pxShadowClient->ucTopicBuffer,
-                                shadowTOPIC_BUFFER_LENGTH,
-                                pxParams->pcOperationTopic,
-                                ( pxParams->pxOperationParams )->pcThingName );
-
-            /* Operation parameters. */
-            xPublishParams.pucTopic = pxShadowClient->ucTopicBuffer;
-            xPublishParams.pvData = pxParams->pcPublishMessage;
-            xPublishParams.ulDataLength = pxParams->ulPublishMessageLength;
-            xPublishParams.xQoS = ( pxParams->pxOperationParams )->xQoS;
-
-            /* Data to pass to the callback. */
-            xOperationData.xOperationInProgress = pxParams->xOperationName;
-            xOperationData.pxOperationParams = pxParams->pxOperationParams;
-            pxShadowClient->pxOperationData = &xOperationData;
-
-            xMQTTReturn = MQTT_AGENT_Publish( pxShadowClient->xMQTTClient,
-                                              &xPublishParams,
-                                              xTimeOutData.xTicksRemaining );
-
-            /* Publish to operation topic. */
-            xReturn = prvConvertMQTTReturnCode( xMQTTReturn,
-                                                ( ShadowClientHandle_t ) ( pxParams->xShadowClientID ), /*lint !e923 Safe cast from pointer handle. */
-                                                "Publish to operation topic" );
+            /* Subscribe to accepted/rejected if necessary. */
+            if( ( BaseType_t ) prvGetSubscribedFlag( pxShadowClient,
+                                                     pxParams->xOperationName ) == pdFALSE )
+            {
+                xReturn = prvShadowSubscribeToAcceptedRejected( pxParams->xShadowClientID,
+                                                                ( pxParams->pxOperationParams )->pcThingName,
+                                                                pxParams->pcOperationAcceptedTopic,
+                                                                pxParams->pcOperationRejectedTopic,
+                                                                &xTimeOutData );
+            }
+            else
+            {
+                xReturn = eShadowSuccess;
+            }
 
             if( xReturn == eShadowSuccess )
             {
-                /* Wait for the semaphore to become available again; it should be
-                 * released by the update callback. */
-                if( xSemaphoreTake( pxShadowClient->xCallbackSemaphore,
-                                    xTimeOutData.xTicksRemaining ) != pdPASS )
-                {
-                    Shadow_debug_printf( ( "[Shadow %d] Error while waiting for"
-                                           " %s accepted/rejected callback.\r\n",
-                                           pxParams->xShadowClientID,
-                                           pxParams->pcOperationName ) );
-                    xReturn = eShadowTimeout;
-                }
-                else
+                /* The subscribe to update/accepted and update/rejected succeeded,
+                 * so set the appropriate flag. */
+                prvSetSubscribedFlag( pxShadowClient, pxParams->xOperationName, 1 );
+
+                /* Data to pass to the callback. This must be in place before the
+                 * operation mutex is released, so that another operation
+                 * completing meanwhile does not unsubscribe. */
+                pxOperation = prvAddPendingOperation( pxShadowClient,
+                                                      pxParams,
+                                                      pcClientToken,
+                                                      usClientTokenLength );
+            }
+
+            configASSERT( xSemaphoreGive( pxShadowClient->xOperationMutex ) == pdPASS );
+
+            if( ( pxOperation != NULL ) && ( pcClientToken == NULL ) )
+            {
+                memcpy( cRequest, shadowREQUEST_PREFIX, sizeof( shadowREQUEST_PREFIX ) - ( size_t ) 1 );
+                memcpy( &( cRequest[ sizeof( shadowREQUEST_PREFIX ) - ( size_t ) 1 ] ),
+                        pxOperation->cClientToken,
+                        ( size_t ) shadowGENERATED_TOKEN_LENGTH );
+                memcpy( &( cRequest[ sizeof( shadowREQUEST_PREFIX ) - ( size_t ) 1 + shadowGENERATED_TOKEN_LENGTH ] ),
+                        shadowREQUEST_SUFFIX,
+                        sizeof( shadowREQUEST_SUFFIX ) );
+
+                pxParams->pcPublishMessage = cRequest;
+                pxParams->ulPublishMessageLength = ( uint32_t ) strlen( cRequest );
+            }
+
+            if( pxOperation != NULL )
+            {
+                /* Fill ucOperationTopic with the operation topic. */
+                xPublishParams.usTopicLength =
+                    prvCreateTopic( ( char * ) ucOperationTopic,
+                                    shadowTOPIC_BUFFER_LENGTH,
+                                    pxParams->pcOperationTopic,
+                                    ( pxParams->pxOperationParams )->pcThingName );
+
+                /* Operation parameters. */
+                xPublishParams.pucTopic = ucOperationTopic;
+                xPublishParams.pvData = pxParams->pcPublishMessage;
+                xPublishParams.ulDataLength = pxParams->ulPublishMessageLength;
+                xPublishParams.xQoS = ( pxParams->pxOperationParams )->xQoS;
+
+                xMQTTReturn = MQTT_AGENT_Publish( pxShadowClient->xMQTTClient,
+                                                  &xPublishParams,
+                                                  xTimeOutData.xTicksRemaining );
+
+                /* Publish to operation topic. */
+                xReturn = prvConvertMQTTReturnCode( xMQTTReturn,
+                                                    ( ShadowClientHandle_t ) ( pxParams->xShadowClientID ), /*lint !e923 Safe cast from pointer handle. */
+                                                    "Publish to operation topic" );
+
+                if( xReturn == eShadowSuccess )
                 {
-                    /* The update callback reports its status as xOperationResult. */
-                    xReturn = pxShadowClient->xOperationResult;
+                    /* Wait for the semaphore of the operation to become
+                     * available; it is given by the operation callback. */
+                    if( xSemaphoreTake( pxOperation->xCallbackSemaphore,
+                                        xTimeOutData.xTicksRemaining ) != pdPASS )
+                    {
+                        Shadow_debug_printf( ( "[Shadow %d] Error while waiting for"
+                                               " %s accepted/rejected callback.\r\n",
+                                               pxParams->xShadowClientID,
+                                               pxParams->pcOperationName ) );
+                        xReturn = eShadowTimeout;
+                    }
+                    else
+                    {
+                        /* The operation callback reports its status as xOperationResult. */
+                        xReturn = pxOperation->xOperationResult;
+                    }
                 }
             }
 
-            configASSERT( xSemaphoreGive( pxShadowClient->xCallbackSemaphore ) == pdPASS );
-        }
-
-        /* Unsubscribe. */
-        if( ( pxParams->pxOperationParams )->ucKeepSubscriptions == ( uint8_t ) 0 )
-        {
+            /* Delete this operation's data so that the slot can be reused, then
+             * unsubscribe if no other operation of the same kind is pending. */
             xTimeOutData.xTicksRemaining = configMAX( xTimeOutData.xTicksRemaining,
                                                       pdMS_TO_TICKS( shadowconfigCLEANUP_TIME_MS ) );
 
-            /* If the Shadow client is subscribed to delete/accepted for this
-             * Thing for a user notify callback, do not unsubscribe; that would
-             * break callback notify. */
-            if( pxParams->xOperationName == eShadowOperationDelete )
+            if( xSemaphoreTake( pxShadowClient->xOperationMutex,
+                                portMAX_DELAY ) == pdPASS )
             {
-                ( void ) prvCreateTopic( ( char * ) pxShadowClient->ucTopicBuffer,
-                                         shadowTOPIC_BUFFER_LENGTH,
-                                         shadowTOPIC_DELETE_ACCEPTED,
-                                         pxParams->pxOperationParams->pcThingName );
-
-                /* If there's a callback registered for delete/accepted, only
-                 * unsubscribe from delete/rejected. */
-                if( prvMatchCallbackTopic( pxShadowClient,
-                                           pxShadowClient->ucTopicBuffer,
-                                           ( uint16_t )
-                                           strlen( ( const char * ) pxShadowClient->ucTopicBuffer ),
-                                           NULL ) == NULL )
+                if( pxOperation != NULL )
+                {
+                    xReturn = prvRemovePendingOperation( pxShadowClient, pxOperation, xReturn );
+                }
+
+                /* Unsubscribe. */
+                if( ( ( pxParams->pxOperationParams )->ucKeepSubscriptions == ( uint8_t ) 0 ) &&
+                    ( prvIsOperationPending( pxShadowClient, pxParams->xOperationName ) == pdFALSE ) )
                 {
-                    if( prvShadowUnsubscribeFromAcceptedRejected( pxParams->xShadowClientID,
-                                                                  pxParams->pxOperationParams->pcThingName,
-                                                                  NULL,
-                                                                  pxParams->pcOperationRejectedTopic,
-                                                                  &xTimeOutData ) == eShadowSuccess )
+                    /* If the Shadow client is subscribed to delete/accepted for this
+                     * Thing for a user notify callback, do not unsubscribe; that would
+                     * break callback notify. */
+                    if( pxParams->xOperationName == eShadowOperationDelete )
                     {
-                        prvSetSubscribedFlag( pxShadowClient,
-                                              pxParams->xOperationName,
-                                              0 );
+                        ( void ) prvCreateTopic( ( char * ) pxShadowClient->ucTopicBuffer,
+                                                 shadowTOPIC_BUFFER_LENGTH,
+                                                 shadowTOPIC_DELETE_ACCEPTED,
+                                                 pxParams->pxOperationParams->pcThingName );
+
+                        /* If there's a callback registered for delete/accepted, only
+                         * unsubscribe from delete/rejected. */
+                        if( prvMatchCallbackTopic( pxShadowClient,
+                                                   pxShadowClient->ucTopicBuffer,
+                                                   ( uint16_t )
+                                                   strlen( ( const char * ) pxShadowClient->ucTopicBuffer ),
+                                                   NULL ) == NULL )
+                        {
+                            if( prvShadowUnsubscribeFromAcceptedRejected( pxParams->xShadowClientID,
+                                                                          pxParams->pxOperationParams->pcThingName,
+                                                                          NULL,
+                                                                          pxParams->pcOperationRejectedTopic,
+                                                                          &xTimeOutData ) == eShadowSuccess )
+                            {
+                                prvSetSubscribedFlag( pxShadowClient,
+                                                      pxParams->xOperationName,
+                                                      0 );
+                            }
+                        }
+                    }
+                    else
+                    {
+                        if( prvShadowUnsubscribeFromAcceptedRejected( pxParams->xShadowClientID,
+                                                                      pxParams->pxOperationParams->pcThingName,
+                                                                      pxParams->pcOperationAcceptedTopic,
+                                                                      pxParams->pcOperationRejectedTopic,
+                                                                      &xTimeOutData ) == eShadowSuccess )
+                        {
+                            prvSetSubscribedFlag( pxShadowClient,
+                                                  pxParams->xOperationName,
+                                                  0 );
+                        }
                     }
                 }
+
+                memset( pxShadowClient->ucTopicBuffer, 0, shadowTOPIC_BUFFER_LENGTH );
+                configASSERT( xSemaphoreGive( pxShadowClient->xOperationMutex ) == pdPASS );
             }
             else
             {
-                if( prvShadowUnsubscribeFromAcceptedRejected( pxParams->xShadowClientID,
-                                                              pxParams->pxOperationParams->pcThingName,
-                                                              pxParams->pcOperationAcceptedTopic,
-                                                              pxParams->pcOperationRejectedTopic,
-                                                              &xTimeOutData ) == eShadowSuccess )
-                {
-                    prvSetSubscribedFlag( pxShadowClient,
-                                          pxParams->xOperationName,
-                                          0 );
-                }
+                Shadow_debug_printf( ( "Error while taking mutex\n" ) );
+                configASSERT( 0 );
             }
         }
 
-        /* Delete this operation's data so that the next operation has a clean Shadow
-         * Client, then release the operation mutex. */
-        if( xSemaphoreTake( pxShadowClient->xOperationDataMutex,
-                            portMAX_DELAY ) == pdPASS )
-        {
-            pxShadowClient->pxOperationData = NULL;
-            configASSERT( xSemaphoreGive( pxShadowClient->xOperationDataMutex ) == pdPASS );
-        }
-        else
-        {
-            Shadow_debug_printf( ( "Error while taking mutex\n" ) );
-            configASSERT( 0 );
-        }
-
-        pxShadowClient->xOperationResult = eShadowSuccess;
-        memset( pxShadowClient->ucTopicBuffer, 0, shadowTOPIC_BUFFER_LENGTH );
-        configASSERT( xSemaphoreGive( pxShadowClient->xOperationMutex )
-                      == pdPASS );
+        configASSERT( xSemaphoreGive( pxShadowClient->xOperationSlots ) == pdPASS );
     }
 
     return xReturn;
@@ -1393,7 +1676,7 @@ ShadowReturnCode_t SHADOW_ClientCreate( ShadowClientHandle_t * pxShadowClientHan
                                         const ShadowCreateParams_t * const pxShadowCreateParams )
 {
     ShadowClient_t * pxShadowClient;
-    BaseType_t xShadowClientID;
+    BaseType_t xShadowClientID, xIterator;
     ShadowReturnCode_t xReturn = eShadowFailure;
     MQTTAgentReturnCode_t xMQTTReturn;
 
@@ -1420,10 +1703,17 @@ ShadowReturnCode_t SHADOW_ClientCreate( ShadowClientHandle_t * pxShadowClientHan
         if( xReturn == eShadowSuccess )
         {
             /* Create synchronization mechanisms; these calls should never fail. */
-            pxShadowClient->xCallbackSemaphore = xSemaphoreCreateBinaryStatic( &( pxShadowClient->xCallbackSemaphoreBuffer ) );
+            pxShadowClient->xOperationSlots = xSemaphoreCreateCountingStatic( shadowconfigMAX_CONCURRENT_OPERATIONS,
+                                                                              shadowconfigMAX_CONCURRENT_OPERATIONS,
+                                                                              &( pxShadowClient->xOperationSlotsBuffer ) );
             pxShadowClient->xOperationMutex = xSemaphoreCreateMutexStatic( &( pxShadowClient->xOperationMutexBuffer ) );
             pxShadowClient->xOperationDataMutex = xSemaphoreCreateMutexStatic( &( pxShadowClient->xOperationDataMutexBuffer ) );
-            configASSERT( xSemaphoreGive( pxShadowClient->xCallbackSemaphore ) == pdPASS );
+
+            for( xIterator = 0; xIterator < shadowconfigMAX_CONCURRENT_OPERATIONS; xIterator++ )
+            {
+                pxShadowClient->xPendingOperations[ xIterator ].xCallbackSemaphore =
+                    xSemaphoreCreateBinaryStatic( &( pxShadowClient->xPendingOperations[ xIterator ].xCallbackSemaphoreBuffer ) );
+            }
 
             /* Set the output parameter. */
             *pxShadowClientHandle = ( ShadowClientHandle_t ) xShadowClientID; /*lint !e923 Safe cast from pointer handle. */
@@ -0,0 +1,753 @@
+/*
+ * Amazon FreeRTOS Shadow V1.0.5
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_shadow_cache.c
+ * @brief Local cache of a Thing Shadow document publishing only changed fields.
+ */
+
+/* C library includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* AWS includes. */
+#include "aws_shadow_config.h"
+#include "aws_shadow_config_defaults.h"
+#include "aws_shadow_cache.h"
+#include "aws_shadow_json.h"
+
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+
+/**
+ * @brief The parts of an update document built by a cache.
+ */
+/** @{ */
+    #define shadowcacheDOCUMENT_PREFIX    "{\"state\":{\"reported\":{"
+    #define shadowcacheDOCUMENT_SUFFIX    "}},\"clientToken\":\"cache-"
+    #define shadowcacheDOCUMENT_END       "\"}"
+/** @} */
+
+/**
+ * @brief The paths of the reported and desired fields in the state of a
+ * Shadow document.
+ */
+/** @{ */
+    #define shadowcacheREPORTED_PREFIX    "reported."
+    #define shadowcacheDESIRED_PREFIX     "desired."
+/** @} */
+
+/** The JSON text deleting a field from a Shadow. */
+    #define shadowcacheNULL_VALUE         "null"
+
+    #if shadowconfigENABLE_DEBUG_LOGS == 1
+        #define Shadow_cache_debug_printf( X )    configPRINTF( X )
+    #else
+        #define Shadow_cache_debug_printf( X )
+    #endif
+
+/**
+ * @brief The context passed to prvApplyField while a document is applied.
+ */
+    typedef struct ShadowCacheApplyContext
+    {
+        ShadowCache_t * pxCache;   /**< The cache the document is applied to. */
+        BaseType_t xDelta;         /**< pdTRUE for a delta document. */
+        BaseType_t xCleared;       /**< pdTRUE once the fields replaced by a document have been cleared. */
+        BaseType_t xFieldsDropped; /**< pdTRUE if a field did not fit in the cache. */
+    } ShadowCacheApplyContext_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the field with the given path, or a free entry for it if
+ * xCreate is pdTRUE. Returns NULL if neither is found.
+ */
+    static ShadowCacheField_t * prvFindField( ShadowCacheField_t * const pxFields,
+                                              const char * const pcPath,
+                                              size_t xPathLength,
+                                              BaseType_t xCreate );
+
+/**
+ * @brief Copy the value of the field pcPath of pxFields to pcValue.
+ */
+    static ShadowReturnCode_t prvGetField( ShadowCache_t * const pxCache,
+                                           ShadowCacheField_t * const pxFields,
+                                           const char * const pcPath,
+                                           char * const pcValue,
+                                           size_t xValueLength );
+
+/**
+ * @brief Check if pcPath is made of non-empty keys joined with dots, and can
+ * be written as JSON keys without escaping.
+ */
+    static BaseType_t prvIsValidPath( const char * const pcPath );
+
+/**
+ * @brief Callback of SHADOW_JSONForEachStateField storing a field of an
+ * applied document in the cache.
+ */
+    static void prvApplyField( void * pvContext,
+                               const char * pcPath,
+                               uint16_t usPathLength,
+                               const char * pcValue,
+                               uint16_t usValueLength );
+
+/**
+ * @brief Apply a Shadow document or a delta document to the cache.
+ */
+    static ShadowReturnCode_t prvApplyDocument( ShadowCache_t * const pxCache,
+                                                const char * const pcDocument,
+                                                uint32_t ulDocumentLength,
+                                                BaseType_t xDelta );
+
+/**
+ * @brief Append xLength bytes of pcText to the update document of pxCache.
+ * Does nothing once *pxFits is pdFALSE, and sets it to pdFALSE if the text
+ * does not fit.
+ */
+    static void prvAppend( ShadowCache_t * const pxCache,
+                           const char * const pcText,
+                           size_t xLength,
+                           BaseType_t * const pxFits );
+
+/**
+ * @brief Build the update document of the reported fields changed up to
+ * ulSequence. Returns pdFALSE if the document does not fit.
+ */
+    static BaseType_t prvBuildUpdateDocument( ShadowCache_t * const pxCache,
+                                              uint32_t ulSequence );
+
+/**
+ * @brief Mark the reported fields changed up to ulSequence as acknowledged.
+ */
+    static void prvAcknowledgeChanges( ShadowCache_t * const pxCache,
+                                       uint32_t ulSequence );
+
+/*-----------------------------------------------------------*/
+
+    static ShadowCacheField_t * prvFindField( ShadowCacheField_t * const pxFields,
+                                              const char * const pcPath,
+                                              size_t xPathLength,
+                                              BaseType_t xCreate )
+    {
+        ShadowCacheField_t * pxReturn = NULL;
+        ShadowCacheField_t * pxFree = NULL;
+        uint8_t ucField;
+
+        for( ucField = 0; ucField < ( uint8_t ) shadowconfigCACHE_MAX_FIELDS; ucField++ )
+        {
+            if( pxFields[ ucField ].cPath[ 0 ] == '\0' )
+            {
+                if( pxFree == NULL )
+                {
+                    pxFree = &( pxFields[ ucField ] );
+                }
+            }
+            else if( ( strncmp( pxFields[ ucField ].cPath, pcPath, xPathLength ) == 0 ) &&
+                     ( pxFields[ ucField ].cPath[ xPathLength ] == '\0' ) )
+            {
+                pxReturn = &( pxFields[ ucField ] );
+                break;
+            }
+            else
+            {
+                /* Not this field. */
+            }
+        }
+
+        if( ( pxReturn == NULL ) && ( xCreate == pdTRUE ) && ( pxFree != NULL ) &&
+            ( xPathLength < ( size_t ) shadowconfigCACHE_MAX_PATH_LENGTH ) )
+        {
+            memcpy( pxFree->cPath, pcPath, xPathLength );
+            pxFree->cPath[ xPathLength ] = '\0';
+            pxFree->cValue[ 0 ] = '\0';
+            pxFree->ulChangeSequence = 0;
+            pxReturn = pxFree;
+        }
+
+        return pxReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    static ShadowReturnCode_t prvGetField( ShadowCache_t * const pxCache,
+                                           ShadowCacheField_t * const pxFields,
+                                           const char * const pcPath,
+                                           char * const pcValue,
+                                           size_t xValueLength )
+    {
+        ShadowReturnCode_t xReturn = eShadowFailure;
+        ShadowCacheField_t * pxField;
+        size_t xLength;
+
+        configASSERT( ( pcPath != NULL ) && ( pcValue != NULL ) );
+
+        ( void ) xSemaphoreTake( pxCache->xMutex, portMAX_DELAY );
+
+        pxField = prvFindField( pxFields, pcPath, strlen( pcPath ), pdFALSE );
+
+        if( pxField != NULL )
+        {
+            xLength = strlen( pxField->cValue );
+
+            if( xLength < xValueLength )
+            {
+                memcpy( pcValue, pxField->cValue, xLength + ( size_t ) 1 );
+                xReturn = eShadowSuccess;
+            }
+        }
+
+        ( void ) xSemaphoreGive( pxCache->xMutex );
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    static BaseType_t prvIsValidPath( const char * const pcPath )
+    {
+        BaseType_t xReturn = pdTRUE;
+        size_t xIndex;
+
+        for( xIndex = 0; pcPath[ xIndex ] != '\0'; xIndex++ )
+        {
+            if( ( pcPath[ xIndex ] == '"' ) || ( pcPath[ xIndex ] == '\\' ) ||
+                ( ( pcPath[ xIndex ] == '.' ) && ( ( xIndex == ( size_t ) 0 ) || ( pcPath[ xIndex - ( size_t ) 1 ] == '.' ) ) ) )
+            {
+                xReturn = pdFALSE;
+                break;
+            }
+        }
+
+        /* Reject the empty path, and a path ending with an empty key. */
+        if( ( xIndex == ( size_t ) 0 ) || ( pcPath[ xIndex - ( size_t ) 1 ] == '.' ) )
+        {
+            xReturn = pdFALSE;
+        }
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvApplyField( void * pvContext,
+                               const char * pcPath,
+                               uint16_t usPathLength,
+                               const char * pcValue,
+                               uint16_t usValueLength )
+    {
+        ShadowCacheApplyContext_t * pxContext = ( ShadowCacheApplyContext_t * ) pvContext; /*lint !e9087 Safe cast from context. */
+        ShadowCache_t * pxCache = pxContext->pxCache;
+        ShadowCacheField_t * pxFields = NULL;
+        ShadowCacheField_t * pxField;
+        uint8_t ucField;
+        const size_t xReportedLength = sizeof( shadowcacheREPORTED_PREFIX ) - ( size_t ) 1;
+        const size_t xDesiredLength = sizeof( shadowcacheDESIRED_PREFIX ) - ( size_t ) 1;
+
+        if( pxContext->xCleared == pdFALSE )
+        {
+            pxContext->xCleared = pdTRUE;
+
+            /* A full document replaces the acknowledged state of the cache.
+             * Only the fields it contains are kept, which is known once it is
+             * found to be newer than the cache. */
+            if( pxContext->xDelta == pdFALSE )
+            {
+                for( ucField = 0; ucField < ( uint8_t ) shadowconfigCACHE_MAX_FIELDS; ucField++ )
+                {
+                    if( pxCache->xReported[ ucField ].ulChangeSequence == ( uint32_t ) 0 )
+                    {
+                        pxCache->xReported[ ucField ].cPath[ 0 ] = '\0';
+                    }
+
+                    pxCache->xDesired[ ucField ].cPath[ 0 ] = '\0';
+                }
+            }
+        }
+
+        if( pxContext->xDelta == pdTRUE )
+        {
+            /* The state of a delta document holds desired fields only. */
+            pxFields = pxCache->xDesired;
+        }
+        else if( ( ( size_t ) usPathLength > xReportedLength ) &&
+                 ( strncmp( pcPath, shadowcacheREPORTED_PREFIX, xReportedLength ) == 0 ) )
+        {
+            pxFields = pxCache->xReported;
+            pcPath += xReportedLength;
+            usPathLength -= ( uint16_t ) xReportedLength;
+        }
+        else if( ( ( size_t ) usPathLength > xDesiredLength ) &&
+                 ( strncmp( pcPath, shadowcacheDESIRED_PREFIX, xDesiredLength ) == 0 ) )
+        {
+            pxFields = pxCache->xDesired;
+            pcPath += xDesiredLength;
+            usPathLength -= ( uint16_t ) xDesiredLength;
+        }
+        else
+        {
+            /* Neither reported nor desired. */
+        }
+
+        if( pxFields != NULL )
+        {
+            pxField = prvFindField( pxFields, pcPath, ( size_t ) usPathLength, pdTRUE );
+
+            if( ( pxField == NULL ) || ( ( size_t ) usValueLength >= ( size_t ) shadowconfigCACHE_MAX_VALUE_LENGTH ) )
+            {
+                Shadow_cache_debug_printf( ( "[Shadow Cache]: Field %s does not fit in the cache.\r\n", pcPath ) );
+                pxContext->xFieldsDropped = pdTRUE;
+
+                if( ( pxField != NULL ) && ( pxField->cValue[ 0 ] == '\0' ) )
+                {
+                    /* Release the entry just taken for the field. */
+                    pxField->cPath[ 0 ] = '\0';
+                }
+            }
+            else if( pxField->ulChangeSequence == ( uint32_t ) 0 )
+            {
+                memcpy( pxField->cValue, pcValue, ( size_t ) usValueLength );
+                pxField->cValue[ usValueLength ] = '\0';
+            }
+            else
+            {
+                /* The reported field has changed locally since the last
+                 * update, keep the local value. */
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static ShadowReturnCode_t prvApplyDocument( ShadowCache_t * const pxCache,
+                                                const char * const pcDocument,
+                                                uint32_t ulDocumentLength,
+                                                BaseType_t xDelta )
+    {
+        ShadowCacheApplyContext_t xContext;
+        ShadowReturnCode_t xReturn = eShadowSuccess;
+        int16_t sFields;
+
+        configASSERT( pxCache != NULL );
+        configASSERT( pcDocument != NULL );
+
+        xContext.pxCache = pxCache;
+        xContext.xDelta = xDelta;
+        xContext.xCleared = pdFALSE;
+        xContext.xFieldsDropped = pdFALSE;
+
+        ( void ) xSemaphoreTake( pxCache->xMutex, portMAX_DELAY );
+
+        /* The document is parsed once, its fields are stored as they are
+         * found. */
+        sFields = SHADOW_JSONForEachStateField( pcDocument,
+                                                ulDocumentLength,
+                                                &( pxCache->ulVersion ),
+                                                prvApplyField,
+                                                &xContext );
+
+        ( void ) xSemaphoreGive( pxCache->xMutex );
+
+        if( sFields < 0 )
+        {
+            /* Return the JSON error code. */
+            xReturn = ( ShadowReturnCode_t ) sFields;
+        }
+        else if( xContext.xFieldsDropped == pdTRUE )
+        {
+            xReturn = eShadowFailure;
+        }
+        else
+        {
+            /* All the fields were applied. */
+        }
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvAppend( ShadowCache_t * const pxCache,
+                           const char * const pcText,
+                           size_t xLength,
+                           BaseType_t * const pxFits )
+    {
+        if( *pxFits == pdTRUE )
+        {
+            if( ( ( size_t ) pxCache->ulUpdateDocumentLength + xLength ) <= sizeof( pxCache->cUpdateDocument ) )
+            {
+                memcpy( &( pxCache->cUpdateDocument[ pxCache->ulUpdateDocumentLength ] ), pcText, xLength );
+                pxCache->ulUpdateDocumentLength += ( uint32_t ) xLength;
+            }
+            else
+            {
+                *pxFits = pdFALSE;
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static BaseType_t prvBuildUpdateDocument( ShadowCache_t * const pxCache,
+                                              uint32_t ulSequence )
+    {
+        uint8_t ucOrder[ shadowconfigCACHE_MAX_FIELDS ];
+        uint8_t ucChanged = 0, ucField, ucPosition;
+        const char * pcPath;
+        const char * pcPreviousPath = NULL;
+        size_t xIndex, xSegmentEnd, xCommon, xOpen = 0;
+        char cToken[ 10 ];
+        uint8_t ucTokenLength = 0;
+        BaseType_t xFits = pdTRUE;
+
+        /* Sort the changed fields by path, so that the fields sharing a parent
+         * object follow one another and the object is written once. */
+        for( ucField = 0; ucField < ( uint8_t ) shadowconfigCACHE_MAX_FIELDS; ucField++ )
+        {
+            if( ( pxCache->xReported[ ucField ].cPath[ 0 ] != '\0' ) &&
+                ( pxCache->xReported[ ucField ].ulChangeSequence != ( uint32_t ) 0 ) )
+            {
+                for( ucPosition = ucChanged; ucPosition > ( uint8_t ) 0; ucPosition-- )
+                {
+                    if( strcmp( pxCache->xReported[ ucOrder[ ucPosition - ( uint8_t ) 1 ] ].cPath,
+                                pxCache->xReported[ ucField ].cPath ) < 0 )
+                    {
+                        break;
+                    }
+
+                    ucOrder[ ucPosition ] = ucOrder[ ucPosition - ( uint8_t ) 1 ];
+                }
+
+                ucOrder[ ucPosition ] = ucField;
+                ucChanged++;
+            }
+        }
+
+        pxCache->ulUpdateDocumentLength = 0;
+        prvAppend( pxCache, shadowcacheDOCUMENT_PREFIX, sizeof( shadowcacheDOCUMENT_PREFIX ) - ( size_t ) 1, &xFits );
+
+        for( ucPosition = 0; ucPosition < ucChanged; ucPosition++ )
+        {
+            pcPath = pxCache->xReported[ ucOrder[ ucPosition ] ].cPath;
+            xCommon = 0;
+            xIndex = 0;
+
+            if( pcPreviousPath != NULL )
+            {
+                /* Count the parent objects shared with the previous field. */
+                while( ( pcPath[ xIndex ] != '\0' ) && ( pcPath[ xIndex ] == pcPreviousPath[ xIndex ] ) )
+                {
+                    if( pcPath[ xIndex ] == '.' )
+                    {
+                        xCommon++;
+                    }
+
+                    xIndex++;
+                }
+
+                /* Close the parent objects of the previous field which are not
+                 * shared. */
+                for( ; xOpen > xCommon; xOpen-- )
+                {
+                    prvAppend( pxCache, "}", ( size_t ) 1, &xFits );
+                }
+
+                prvAppend( pxCache, ",", ( size_t ) 1, &xFits );
+
+                /* Move back to the start of the first key not shared. */
+                while( ( xIndex > ( size_t ) 0 ) && ( pcPath[ xIndex - ( size_t ) 1 ] != '.' ) )
+                {
+                    xIndex--;
+                }
+            }
+
+            /* Write the keys not shared, opening an object for all but the
+             * last one. */
+            for( ; ; )
+            {
+                for( xSegmentEnd = xIndex; ( pcPath[ xSegmentEnd ] != '\0' ) && ( pcPath[ xSegmentEnd ] != '.' ); xSegmentEnd++ )
+                {
+                }
+
+                prvAppend( pxCache, "\"", ( size_t ) 1, &xFits );
+                prvAppend( pxCache, &( pcPath[ xIndex ] ), xSegmentEnd - xIndex, &xFits );
+
+                if( pcPath[ xSegmentEnd ] == '\0' )
+                {
+                    prvAppend( pxCache, "\":", ( size_t ) 2, &xFits );
+                    break;
+                }
+
+                prvAppend( pxCache, "\":{", ( size_t ) 3, &xFits );
+                xOpen++;
+                xIndex = xSegmentEnd + ( size_t ) 1;
+            }
+
+            prvAppend( pxCache,
+                       pxCache->xReported[ ucOrder[ ucPosition ] ].cValue,
+                       strlen( pxCache->xReported[ ucOrder[ ucPosition ] ].cValue ),
+                       &xFits );
+            pcPreviousPath = pcPath;
+        }
+
+        for( ; xOpen > ( size_t ) 0; xOpen-- )
+        {
+            prvAppend( pxCache, "}", ( size_t ) 1, &xFits );
+        }
+
+        /* The sequence number of the last change makes the client token
+         * unique to this update. */
+        do
+        {
+            cToken[ sizeof( cToken ) - ( size_t ) 1 - ( size_t ) ucTokenLength ] = ( char ) ( '0' + ( char ) ( ulSequence % ( uint32_t ) 10 ) );
+            ucTokenLength++;
+            ulSequence /= ( uint32_t ) 10;
+        } while( ulSequence > ( uint32_t ) 0 );
+
+        prvAppend( pxCache, shadowcacheDOCUMENT_SUFFIX, sizeof( shadowcacheDOCUMENT_SUFFIX ) - ( size_t ) 1, &xFits );
+        prvAppend( pxCache, &( cToken[ sizeof( cToken ) - ( size_t ) ucTokenLength ] ), ( size_t ) ucTokenLength, &xFits );
+        prvAppend( pxCache, shadowcacheDOCUMENT_END, sizeof( shadowcacheDOCUMENT_END ) - ( size_t ) 1, &xFits );
+
+        return xFits;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvAcknowledgeChanges( ShadowCache_t * const pxCache,
+                                       uint32_t ulSequence )
+    {
+        ShadowCacheField_t * pxField;
+        uint8_t ucField;
+
+        pxCache->xChangesPending = pdFALSE;
+
+        for( ucField = 0; ucField < ( uint8_t ) shadowconfigCACHE_MAX_FIELDS; ucField++ )
+        {
+            pxField = &( pxCache->xReported[ ucField ] );
+
+            if( ( pxField->cPath[ 0 ] != '\0' ) && ( pxField->ulChangeSequence != ( uint32_t ) 0 ) )
+            {
+                /* The fields changed again while the update was in progress
+                 * remain changed. */
+                if( ( int32_t ) ( ulSequence - pxField->ulChangeSequence ) >= 0 )
+                {
+                    pxField->ulChangeSequence = 0;
+
+                    if( strcmp( pxField->cValue, shadowcacheNULL_VALUE ) == 0 )
+                    {
+                        /* The field is deleted from the Shadow. */
+                        pxField->cPath[ 0 ] = '\0';
+                    }
+                }
+                else
+                {
+                    pxCache->xChangesPending = pdTRUE;
+                }
+            }
+        }
+
+        if( pxCache->xChangesPending == pdTRUE )
+        {
+            pxCache->xFirstChangeTime = xTaskGetTickCount();
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheInit( ShadowCache_t * const pxCache,
+                                         ShadowClientHandle_t xShadowClientHandle,
+                                         const char * const pcThingName )
+    {
+        ShadowReturnCode_t xReturn = eShadowSuccess;
+
+        configASSERT( pxCache != NULL );
+        configASSERT( pcThingName != NULL );
+
+        memset( pxCache, 0x00, sizeof( ShadowCache_t ) );
+        pxCache->xShadowClientHandle = xShadowClientHandle;
+        pxCache->pcThingName = pcThingName;
+
+        pxCache->xMutex = xSemaphoreCreateMutexStatic( &( pxCache->xMutexBuffer ) );
+
+        if( pxCache->xMutex == NULL )
+        {
+            xReturn = eShadowFailure;
+        }
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheSetReported( ShadowCache_t * const pxCache,
+                                                const char * const pcPath,
+                                                const char * const pcValue )
+    {
+        ShadowReturnCode_t xReturn = eShadowFailure;
+        ShadowCacheField_t * pxField;
+        size_t xValueLength;
+
+        configASSERT( pxCache != NULL );
+        configASSERT( ( pcPath != NULL ) && ( pcValue != NULL ) );
+
+        xValueLength = strlen( pcValue );
+
+        if( ( prvIsValidPath( pcPath ) == pdTRUE ) &&
+            ( xValueLength > ( size_t ) 0 ) &&
+            ( xValueLength < ( size_t ) shadowconfigCACHE_MAX_VALUE_LENGTH ) )
+        {
+            ( void ) xSemaphoreTake( pxCache->xMutex, portMAX_DELAY );
+
+            pxField = prvFindField( pxCache->xReported, pcPath, strlen( pcPath ), pdTRUE );
+
+            if( pxField != NULL )
+            {
+                /* An unchanged value is not published again. */
+                if( strcmp( pxField->cValue, pcValue ) != 0 )
+                {
+                    memcpy( pxField->cValue, pcValue, xValueLength + ( size_t ) 1 );
+
+                    pxCache->ulChangeSequence++;
+
+                    if( pxCache->ulChangeSequence == ( uint32_t ) 0 )
+                    {
+                        /* 0 means unchanged. */
+                        pxCache->ulChangeSequence++;
+                    }
+
+                    pxField->ulChangeSequence = pxCache->ulChangeSequence;
+
+                    if( pxCache->xChangesPending == pdFALSE )
+                    {
+                        pxCache->xChangesPending = pdTRUE;
+                        pxCache->xFirstChangeTime = xTaskGetTickCount();
+                    }
+                }
+
+                xReturn = eShadowSuccess;
+            }
+            else
+            {
+                Shadow_cache_debug_printf( ( "[Shadow Cache]: No room for field %s.\r\n", pcPath ) );
+            }
+
+            ( void ) xSemaphoreGive( pxCache->xMutex );
+        }
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheGetReported( ShadowCache_t * const pxCache,
+                                                const char * const pcPath,
+                                                char * const pcValue,
+                                                size_t xValueLength )
+    {
+        configASSERT( pxCache != NULL );
+
+        return prvGetField( pxCache, pxCache->xReported, pcPath, pcValue, xValueLength );
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheGetDesired( ShadowCache_t * const pxCache,
+                                               const char * const pcPath,
+                                               char * const pcValue,
+                                               size_t xValueLength )
+    {
+        configASSERT( pxCache != NULL );
+
+        return prvGetField( pxCache, pxCache->xDesired, pcPath, pcValue, xValueLength );
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheApplyDocument( ShadowCache_t * const pxCache,
+                                                  const char * const pcDocument,
+                                                  uint32_t ulDocumentLength )
+    {
+        return prvApplyDocument( pxCache, pcDocument, ulDocumentLength, pdFALSE );
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheApplyDelta( ShadowCache_t * const pxCache,
+                                               const char * const pcDocument,
+                                               uint32_t ulDocumentLength )
+    {
+        return prvApplyDocument( pxCache, pcDocument, ulDocumentLength, pdTRUE );
+    }
+/*-----------------------------------------------------------*/
+
+    ShadowReturnCode_t SHADOW_CacheFlush( ShadowCache_t * const pxCache,
+                                          BaseType_t xForce,
+                                          TickType_t xTimeoutTicks )
+    {
+        ShadowReturnCode_t xReturn = eShadowSuccess;
+        ShadowOperationParams_t xUpdateParams;
+        BaseType_t xPublish = pdFALSE;
+        uint32_t ulSequence = 0;
+
+        configASSERT( pxCache != NULL );
+
+        ( void ) xSemaphoreTake( pxCache->xMutex, portMAX_DELAY );
+
+        if( ( pxCache->xChangesPending == pdTRUE ) &&
+            ( ( xForce == pdTRUE ) ||
+              ( ( xTaskGetTickCount() - pxCache->xFirstChangeTime ) >= pdMS_TO_TICKS( shadowconfigCACHE_COALESCE_MS ) ) ) )
+        {
+            ulSequence = pxCache->ulChangeSequence;
+
+            if( prvBuildUpdateDocument( pxCache, ulSequence ) == pdTRUE )
+            {
+                xPublish = pdTRUE;
+            }
+            else
+            {
+                Shadow_cache_debug_printf( ( "[Shadow Cache]: Update document too long.\r\n" ) );
+                xReturn = eShadowFailure;
+            }
+        }
+
+        ( void ) xSemaphoreGive( pxCache->xMutex );
+
+        if( xPublish == pdTRUE )
+        {
+            /* The cache is not locked while the update is in progress, so the
+             * fields may be changed meanwhile. */
+            memset( &xUpdateParams, 0x00, sizeof( ShadowOperationParams_t ) );
+            xUpdateParams.pcThingName = pxCache->pcThingName;
+            xUpdateParams.pcData = pxCache->cUpdateDocument;
+            xUpdateParams.ulDataLength = pxCache->ulUpdateDocumentLength;
+            xUpdateParams.ucKeepSubscriptions = ( uint8_t ) 1;
+            xUpdateParams.xQoS = eMQTTQoS1;
+
+            xReturn = SHADOW_Update( pxCache->xShadowClientHandle, &xUpdateParams, xTimeoutTicks );
+
+            if( xReturn == eShadowSuccess )
+            {
+                ( void ) xSemaphoreTake( pxCache->xMutex, portMAX_DELAY );
+                prvAcknowledgeChanges( pxCache, ulSequence );
+                ( void ) xSemaphoreGive( pxCache->xMutex );
+            }
+        }
+
+        return xReturn;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* shadowconfigENABLE_DOCUMENT_CACHE */
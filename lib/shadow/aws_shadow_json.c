@@ -33,10 +33,11 @@
 #include <stdlib.h>
 
 /* AWS includes. */
+#include "aws_shadow.h"
 #include "aws_shadow_json.h"
 
-/* Other includes. */
-#include "jsmn.h"
+/* JSON scanner includes. */
+#include "aws_json_scanner.h"
 
 /* Sockets configuration includes. */
 #include "aws_shadow_config.h"
@@ -48,6 +49,16 @@
 #define shadowJSON_ERROR_MESSAGE    "message"
 #define shadowJSON_CLIENT_TOKEN     "clientToken"
 
+/* The top-level JSON keys of a Shadow document holding its state and its
+ * version. */
+#define shadowJSON_STATE            "state"
+#define shadowJSON_VERSION          "version"
+
+/* Maximum length of the path of a state field, and maximum depth of the
+ * objects searched for fields. Fields beyond either limit are skipped. */
+#define shadowJSON_MAX_PATH_LENGTH    ( 128 )
+#define shadowJSON_MAX_DEPTH          ( 8 )
+
 #if shadowconfigENABLE_DEBUG_LOGS == 1
     #define Shadow_json_debug_printf( X )    configPRINTF( X )
 #else
@@ -55,79 +66,59 @@
 #endif
 
 /**
- * @brief Given a JSON key, get its value. Does not work on arrays or objects.  Returns
- * length of value and sets ppcValue to the start of the value.  Returns 0 on
- * error (key-value does not exist).
+ * @brief Converts a scanner error to the Shadow return code of the same
+ * meaning, see aws_shadow.h.
+ */
+static int16_t prvScanError( JSONScanStatus_t xStatus );
+
+/**
+ * @brief Finds the value of a top-level key of a JSON document. Returns the
+ * length of the value and sets ppcValue to the start of the value, without the
+ * quotes of a string. Returns 0 if the key-value does not exist, and a
+ * negative Shadow return code if the document is invalid before it is found.
  */
-static uint16_t prvGetJSONValue( const char ** ppcValue,
-                                 const char * const pcKey,
-                                 const char * const pcDoc,
-                                 jsmntok_t * pxJSMNTokens,
-                                 int16_t sTokensParsed );
+static int16_t prvGetJSONValue( const char ** ppcValue,
+                                const char * const pcKey,
+                                const char * const pcDoc,
+                                uint32_t ulDocLength );
 
 /**
- * @brief Wrapper for jsmn functions. Returns negative values (see jsmn error codes) on
- * error.  Returns the number of tokens parsed on success.
+ * @brief Invokes xCallback for each field of the state object, whose start was
+ * the last element returned by pxScanner, and of the objects nested in it.
+ * Returns the number of fields visited, or a negative Shadow return code.
  */
-static int16_t prvParseJSON( const char * const pcDoc,
-                             uint32_t ulDocLength,
-                             jsmntok_t * pxJSMNTokens );
+static int16_t prvVisitStateFields( JSONScanner_t * pxScanner,
+                                    ShadowJSONFieldCallback_t xCallback,
+                                    void * pvContext );
 
 /*-----------------------------------------------------------*/
 
-BaseType_t SHADOW_JSONDocClientTokenMatch( const char * const pcDoc1,
-                                           uint32_t ulDoc1Length,
-                                           const char * const pcDoc2,
-                                           uint32_t ulDoc2Length )
+uint16_t SHADOW_JSONGetClientToken( const char * const pcDoc,
+                                    uint32_t ulDocLength,
+                                    const char ** ppcClientToken )
 {
-    jsmntok_t pxJSMNTokens[ shadowconfigJSON_JSMN_TOKENS ];
-    BaseType_t xReturn = pdFAIL;
-    uint16_t usClientToken1Length, usClientToken2Length;
-    int16_t sNbTokens;
-    char * pcClientToken1;
-    char * pcClientToken2;
-
-    /* Parse pcDoc1 with jsmn. */
-    sNbTokens = prvParseJSON( pcDoc1, ulDoc1Length, pxJSMNTokens );
+    JSONScanQuery_t xQuery;
+    uint16_t usReturn = 0;
 
-    if( sNbTokens > 0 )
+    if( ( pcDoc != NULL ) && ( ppcClientToken != NULL ) )
     {
-        /* Attempt to find the "clientToken" string in parsed pcDoc1. */
-        usClientToken1Length = prvGetJSONValue( ( const char ** ) &pcClientToken1,
-                                                shadowJSON_CLIENT_TOKEN,
-                                                pcDoc1,
-                                                ( jsmntok_t * ) pxJSMNTokens,
-                                                sNbTokens );
-
-        if( usClientToken1Length > ( uint16_t ) 0 )
+        /* Only the client token among the top-level members is looked up, and
+         * the objects before it, such as the state, are skipped. Keys of the
+         * same name nested in them or quoted in their strings are not mistaken
+         * for it. */
+        memset( &xQuery, 0x00, sizeof( xQuery ) );
+        xQuery.pcPath = shadowJSON_CLIENT_TOKEN;
+
+        if( ( JSON_ScanPaths( pcDoc, ulDocLength, &xQuery, 1 ) == eJSONScanSuccess ) &&
+            ( xQuery.eType == eJSONScanString ) &&
+            ( xQuery.ulValueLength <= ( uint32_t ) UINT16_MAX ) )
         {
-            /* Parse pcDoc2 with jsmn. */
-            sNbTokens = prvParseJSON( pcDoc2, ulDoc2Length, pxJSMNTokens );
-
-            if( sNbTokens > 0 )
-            {
-                /* If "clientToken" was found in pcDoc1, attempt to find "clientToken" in pcDoc2. */
-                usClientToken2Length = prvGetJSONValue( ( const char ** ) &pcClientToken2,
-                                                        shadowJSON_CLIENT_TOKEN,
-                                                        pcDoc2,
-                                                        ( jsmntok_t * ) pxJSMNTokens,
-                                                        sNbTokens );
-
-                /* Compare the client tokens. */
-                if( usClientToken2Length == usClientToken1Length )
-                {
-                    if( strncmp( ( const char * ) pcClientToken1,
-                                 ( const char * ) pcClientToken2,
-                                 ( size_t ) usClientToken1Length ) == 0 )
-                    {
-                        xReturn = pdPASS;
-                    }
-                }
-            }
+            *ppcClientToken = xQuery.pcValue;
+            usReturn = ( uint16_t ) xQuery.ulValueLength;
         }
     }
 
-    return xReturn;
+    return usReturn;
 }
 /*-----------------------------------------------------------*/
 
@@ -136,114 +127,308 @@ int16_t SHADOW_JSONGetErrorCodeAndMessage( const char * const pcErrorJSON,
                                            char ** ppcErrorMessage,
                                            uint16_t * pusErrorMessageLength )
 {
-    jsmntok_t pxJSMNTokens[ shadowconfigJSON_JSMN_TOKENS ];
-    char * pcErrorCode;
+    JSONScanQuery_t xQueries[ 2 ];
+    JSONScanStatus_t xStatus;
     int16_t sReturn = 0;
-    int16_t sTokensParsed;
 
-    sTokensParsed = prvParseJSON( pcErrorJSON, ulErrorJSONLength, pxJSMNTokens );
+    memset( xQueries, 0x00, sizeof( xQueries ) );
+    xQueries[ 0 ].pcPath = shadowJSON_ERROR_CODE;
+    xQueries[ 1 ].pcPath = shadowJSON_ERROR_MESSAGE;
+
+    xStatus = JSON_ScanPaths( pcErrorJSON, ulErrorJSONLength, xQueries, 2 );
 
-    if( sTokensParsed > 0 )
+    if( ( xStatus == eJSONScanSuccess ) || ( xStatus == eJSONScanEnd ) )
     {
         /* Attempt to find the error code. */
-        sReturn = ( int16_t ) prvGetJSONValue( ( const char ** ) &pcErrorCode,
-                                               shadowJSON_ERROR_CODE,
-                                               pcErrorJSON,
-                                               pxJSMNTokens,
-                                               sTokensParsed );
-
-        if( sReturn > 0 )
+        if( ( xQueries[ 0 ].pcValue != NULL ) && ( xQueries[ 0 ].ulValueLength > ( uint32_t ) 0 ) )
         {
             /* Convert the error code to int16_t for return value. */
-            sReturn = ( int16_t ) strtol( pcErrorCode, NULL, 0 );
+            sReturn = ( int16_t ) strtol( xQueries[ 0 ].pcValue, NULL, 0 );
 
             if( ( ppcErrorMessage != NULL ) && ( pusErrorMessageLength != NULL ) )
             {
                 /* Set the pointer to the error message and the error message length. */
-                *pusErrorMessageLength = prvGetJSONValue( ( const char ** ) ppcErrorMessage,
-                                                          shadowJSON_ERROR_MESSAGE,
-                                                          pcErrorJSON,
-                                                          pxJSMNTokens,
-                                                          sTokensParsed );
+                if( xQueries[ 1 ].pcValue != NULL )
+                {
+                    *ppcErrorMessage = ( char * ) xQueries[ 1 ].pcValue;
+                    *pusErrorMessageLength = ( uint16_t ) xQueries[ 1 ].ulValueLength;
+                }
+                else
+                {
+                    *pusErrorMessageLength = 0;
+                }
             }
         }
     }
     else
     {
-        /* On failure, sTokenParsed returns a jsmn error code.  Return this error code. */
-        sReturn = sTokensParsed;
+        /* Return the error code of the scan. */
+        sReturn = prvScanError( xStatus );
     }
 
     return sReturn;
 }
 /*-----------------------------------------------------------*/
 
-static int16_t prvParseJSON( const char * const pcDoc,
-                             uint32_t ulDocLength,
-                             jsmntok_t * pxJSMNTokens )
+int16_t SHADOW_JSONForEachStateField( const char * const pcDoc,
+                                      uint32_t ulDocLength,
+                                      uint32_t * pulVersion,
+                                      ShadowJSONFieldCallback_t xCallback,
+                                      void * pvContext )
 {
-    jsmn_parser xJSMNParser;
-    int16_t sReturn;
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    JSONScanStatus_t xStatus;
+    const char * pcVersion;
+    int16_t sReturn = 0;
+    int16_t sVersionLength;
+    uint32_t ulVersion;
+    BaseType_t xVisit = pdTRUE;
 
-    jsmn_init( &xJSMNParser );
-    sReturn = ( int16_t ) jsmn_parse( &xJSMNParser,
-                                      pcDoc,
-                                      ulDocLength,
-                                      pxJSMNTokens,
-                                      shadowconfigJSON_JSMN_TOKENS );
+    if( pulVersion != NULL )
+    {
+        /* The version is looked up first, so that an outdated document is
+         * not scanned further. */
+        sVersionLength = prvGetJSONValue( &pcVersion, shadowJSON_VERSION, pcDoc, ulDocLength );
 
-    /* Report errors in JSON parsing. */
-    if ( sReturn < 0 ) {
-      Shadow_json_debug_printf( ( "[Shadow JSON]: Error parsing JSON: JSMN error code %d\r\n", sReturn ) );
+        if( sVersionLength < ( int16_t ) 0 )
+        {
+            sReturn = sVersionLength;
+            xVisit = pdFALSE;
+        }
+        else if( sVersionLength > ( int16_t ) 0 )
+        {
+            ulVersion = ( uint32_t ) strtoul( pcVersion, NULL, 10 );
+
+            if( ( *pulVersion != ( uint32_t ) 0 ) && ( ulVersion <= *pulVersion ) )
+            {
+                /* The document is older than the state of the caller, as the
+                 * Shadow service may deliver documents out of order. */
+                Shadow_json_debug_printf( ( "[Shadow JSON]: Skipping document version %u.\r\n", ( unsigned ) ulVersion ) );
+                xVisit = pdFALSE;
+            }
+            else
+            {
+                *pulVersion = ulVersion;
+            }
+        }
+        else
+        {
+            /* A document without version is always visited. */
+        }
+    }
+
+    if( xVisit == pdTRUE )
+    {
+        JSON_ScanInit( &xScanner, pcDoc, ulDocLength );
+        xStatus = JSON_ScanNext( &xScanner, &xElement );
+
+        if( ( xStatus == eJSONScanSuccess ) && ( xElement.eType == eJSONScanObject ) )
+        {
+            /* Find the state among the top-level members, skipping the
+             * others. Keys of the same name nested in the state are not
+             * mistaken for it. */
+            while( ( xStatus = JSON_ScanNext( &xScanner, &xElement ) ) == eJSONScanSuccess )
+            {
+                if( ( xElement.ucDepth == ( uint8_t ) 1 ) &&
+                    ( xElement.eType == eJSONScanObject ) &&
+                    ( xElement.ulKeyLength == ( sizeof( shadowJSON_STATE ) - 1 ) ) &&
+                    ( strncmp( xElement.pcKey, shadowJSON_STATE, xElement.ulKeyLength ) == 0 ) )
+                {
+                    sReturn = prvVisitStateFields( &xScanner, xCallback, pvContext );
+                    break;
+                }
+                else if( ( xElement.eType == eJSONScanObject ) || ( xElement.eType == eJSONScanArray ) )
+                {
+                    xStatus = JSON_ScanSkip( &xScanner, &xElement );
+
+                    if( xStatus != eJSONScanSuccess )
+                    {
+                        break;
+                    }
+                }
+                else
+                {
+                    /* Not the state. */
+                }
+            }
+        }
+
+        if( ( xStatus != eJSONScanSuccess ) && ( xStatus != eJSONScanEnd ) )
+        {
+            sReturn = prvScanError( xStatus );
+        }
     }
 
     return sReturn;
 }
 /*-----------------------------------------------------------*/
 
-static uint16_t prvGetJSONValue( const char ** ppcValue,
-                                 const char * const pcKey,
-                                 const char * const pcDoc,
-                                 jsmntok_t * pxJSMNTokens,
-                                 int16_t sTokensParsed )
+static int16_t prvScanError( JSONScanStatus_t xStatus )
 {
-    jsmntok_t * pxJSMNToken;
-    uint16_t usReturn = 0;
-    int16_t sIterator;
-    uint16_t usCompareLength;
-    BaseType_t xValueFound = pdFALSE;
+    int16_t sReturn;
+
+    if( xStatus == eJSONScanPartial )
+    {
+        sReturn = eShadowJSMNPart;
+    }
+    else if( xStatus == eJSONScanTooDeep )
+    {
+        sReturn = eShadowJSMNNoMem;
+    }
+    else
+    {
+        sReturn = eShadowJSMNInval;
+    }
+
+    Shadow_json_debug_printf( ( "[Shadow JSON]: Error parsing JSON: scanner error %d\r\n", ( int ) xStatus ) );
+
+    return sReturn;
+}
+/*-----------------------------------------------------------*/
+
+static int16_t prvGetJSONValue( const char ** ppcValue,
+                                const char * const pcKey,
+                                const char * const pcDoc,
+                                uint32_t ulDocLength )
+{
+    JSONScanQuery_t xQuery;
+    JSONScanStatus_t xStatus;
+    int16_t sReturn = 0;
 
-    if( ppcValue != NULL )
+    xQuery.pcPath = pcKey;
+    xStatus = JSON_ScanPaths( pcDoc, ulDocLength, &xQuery, 1 );
+
+    if( xStatus == eJSONScanSuccess )
+    {
+        /* Set the pointer to the value and the value's length. */
+        *ppcValue = xQuery.pcValue;
+        sReturn = ( int16_t ) xQuery.ulValueLength;
+    }
+    else if( xStatus != eJSONScanEnd )
     {
-        /* "clientToken" is usually (but not guaranteed to be) the last key in the Shadow JSON document.
-         * Since this function is primarily used to find "clientToken", find "clientToken" faster
-         * by starting from the end. */
-        for( sIterator = ( sTokensParsed - 1 ); sIterator >= 0; sIterator-- )
+        sReturn = prvScanError( xStatus );
+    }
+    else
+    {
+        /* The key-value does not exist. */
+    }
+
+    return sReturn;
+}
+/*-----------------------------------------------------------*/
+
+static int16_t prvVisitStateFields( JSONScanner_t * pxScanner,
+                                    ShadowJSONFieldCallback_t xCallback,
+                                    void * pvContext )
+{
+    JSONScanElement_t xElement;
+    JSONScanStatus_t xStatus;
+    char cPath[ shadowJSON_MAX_PATH_LENGTH ];
+    uint16_t usPathLengths[ shadowJSON_MAX_DEPTH + 1 ];
+    uint16_t usPathLength, usFieldPathLength, usSeparatorLength;
+    uint8_t ucLevel;
+    int16_t sFieldsVisited = 0;
+
+    /* The state object is at depth 1 and has an empty path. */
+    usPathLengths[ 0 ] = 0;
+    cPath[ 0 ] = '\0';
+
+    while( ( xStatus = JSON_ScanNext( pxScanner, &xElement ) ) == eJSONScanSuccess )
+    {
+        if( ( xElement.eType == eJSONScanObjectEnd ) || ( xElement.eType == eJSONScanArrayEnd ) )
         {
-            pxJSMNToken = &( pxJSMNTokens[ sIterator ] );
-            usCompareLength = configMAX( ( ( uint16_t ) pxJSMNToken->end - ( uint16_t ) pxJSMNToken->start ),
-                                         ( ( uint16_t ) strlen( pcKey ) ) );
+            if( xElement.ucDepth == ( uint8_t ) 1 )
+            {
+                /* End of the state. */
+                break;
+            }
+
+            continue;
+        }
 
-            /* Compare pcKey with the keys in the JSON document. */
-            if( ( ( strncmp( pcKey, pcDoc + pxJSMNToken->start, usCompareLength ) ) == 0 ) && ( pxJSMNToken->size == 1 ) )
+        /* The members of the state are at depth 2. */
+        ucLevel = xElement.ucDepth - ( uint8_t ) 2;
+        usPathLength = usPathLengths[ ucLevel ];
+        usSeparatorLength = ( usPathLength > ( uint16_t ) 0 ) ? ( uint16_t ) 1 : ( uint16_t ) 0;
+        usFieldPathLength = usPathLength + usSeparatorLength + ( uint16_t ) xElement.ulKeyLength;
+
+        if( usFieldPathLength >= ( uint16_t ) shadowJSON_MAX_PATH_LENGTH )
+        {
+            Shadow_json_debug_printf( ( "[Shadow JSON]: Skipping field with a path too long.\r\n" ) );
+        }
+        else if( ( xElement.eType == eJSONScanObject ) && ( ucLevel >= ( uint8_t ) shadowJSON_MAX_DEPTH ) )
+        {
+            Shadow_json_debug_printf( ( "[Shadow JSON]: Skipping object nested too deep.\r\n" ) );
+            usFieldPathLength = ( uint16_t ) shadowJSON_MAX_PATH_LENGTH;
+        }
+        else
+        {
+            /* Append the key to the path of the object. */
+            if( usSeparatorLength > ( uint16_t ) 0 )
             {
-                /* The JSON value is the next jsmn token after the key. */
-                pxJSMNToken++;
+                cPath[ usPathLength ] = '.';
+            }
 
-                /* Set the pointer to the value and the value's length. */
-                *ppcValue = ( const char * ) ( pcDoc + pxJSMNToken->start );
-                usReturn = ( uint16_t ) pxJSMNToken->end - ( uint16_t ) pxJSMNToken->start;
-                xValueFound = pdTRUE;
-                break;
+            memcpy( &( cPath[ usPathLength + usSeparatorLength ] ), xElement.pcKey, xElement.ulKeyLength );
+            cPath[ usFieldPathLength ] = '\0';
+        }
+
+        if( usFieldPathLength >= ( uint16_t ) shadowJSON_MAX_PATH_LENGTH )
+        {
+            /* Skip the field. */
+            if( ( xElement.eType == eJSONScanObject ) || ( xElement.eType == eJSONScanArray ) )
+            {
+                xStatus = JSON_ScanSkip( pxScanner, &xElement );
+            }
+        }
+        else if( xElement.eType == eJSONScanObject )
+        {
+            /* The members of the object extend its path. */
+            usPathLengths[ ucLevel + ( uint8_t ) 1 ] = usFieldPathLength;
+        }
+        else
+        {
+            if( xElement.eType == eJSONScanArray )
+            {
+                /* An array is passed as a single field. */
+                xStatus = JSON_ScanSkip( pxScanner, &xElement );
+            }
+            else if( xElement.eType == eJSONScanString )
+            {
+                /* The scanner excludes the quotes from a string, pass them on
+                 * so that the value can be copied as JSON. */
+                xElement.pcValue--;
+                xElement.ulValueLength += ( uint32_t ) 2;
+            }
+            else
+            {
+                /* A primitive is passed as it is. */
+            }
+
+            if( xStatus == eJSONScanSuccess )
+            {
+                xCallback( pvContext,
+                           cPath,
+                           usFieldPathLength,
+                           xElement.pcValue,
+                           ( uint16_t ) xElement.ulValueLength );
+
+                sFieldsVisited++;
             }
         }
+
+        if( xStatus != eJSONScanSuccess )
+        {
+            break;
+        }
     }
 
-    if( xValueFound == pdFALSE )
+    if( xStatus != eJSONScanSuccess )
     {
-        usReturn = 0;
+        sFieldsVisited = prvScanError( xStatus );
     }
 
-    return usReturn;
+    return sFieldsVisited;
 }
 /*-----------------------------------------------------------*/
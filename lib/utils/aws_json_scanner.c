@@ -0,0 +1,643 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_json_scanner.c
+ * @brief Streaming JSON scanner.
+ */
+
+/* C library includes. */
+#include <string.h>
+
+/* JSON scanner includes. */
+#include "aws_json_scanner.h"
+
+/* What the scanner expects next. */
+#define jsonscanSTATE_VALUE          ( 0 ) /* A value: the root, a value after a colon or a value after a comma in an array. */
+#define jsonscanSTATE_FIRST_KEY      ( 1 ) /* A key or the end of the object just started. */
+#define jsonscanSTATE_KEY            ( 2 ) /* A key after a comma. */
+#define jsonscanSTATE_FIRST_VALUE    ( 3 ) /* A value or the end of the array just started. */
+#define jsonscanSTATE_NEXT           ( 4 ) /* A comma or the end of the current object or array. */
+#define jsonscanSTATE_DONE           ( 5 ) /* Nothing, the root value is complete. */
+
+/* Results of the comparison of a query path with the keys leading to an
+ * element. */
+#define jsonscanPATH_NO_MATCH        ( 0 )
+#define jsonscanPATH_EXACT           ( 1 )
+#define jsonscanPATH_PREFIX          ( 2 )
+
+/* The separator of the keys of a query path. */
+#define jsonscanPATH_SEPARATOR       '.'
+
+/**
+ * @brief Non-zero if the character is JSON whitespace.
+ */
+#define jsonscanIS_SPACE( c )    ( ( ( c ) == ' ' ) || ( ( c ) == '\n' ) || ( ( c ) == '\r' ) || ( ( c ) == '\t' ) )
+
+/**
+ * @brief Skips the whitespace at the current position. Returns the character
+ * found there, or '\0' at the end of the document.
+ */
+static char prvSkipSpace( JSONScanner_t * pxScanner );
+
+/**
+ * @brief Finds the end of the string whose opening quote is at *pulIndex, and
+ * sets *pulIndex to its closing quote.
+ */
+static JSONScanStatus_t prvFindStringEnd( const JSONScanner_t * pxScanner,
+                                          uint32_t * pulIndex );
+
+/**
+ * @brief Scans the value at the current position into pxElement.
+ */
+static JSONScanStatus_t prvScanValue( JSONScanner_t * pxScanner,
+                                      JSONScanElement_t * pxElement );
+
+/**
+ * @brief Scans the end of the current object or array, whose closing bracket
+ * is at the current position, into pxElement.
+ */
+static void prvScanContainerEnd( JSONScanner_t * pxScanner,
+                                 JSONScanElement_t * pxElement );
+
+/**
+ * @brief Compares a query path with the keys leading to an element of depth
+ * ucDepth. Returns one of the jsonscanPATH_* values.
+ */
+static uint8_t prvMatchPath( const char * pcPath,
+                             const char * const * ppcKeys,
+                             const uint32_t * pulKeyLengths,
+                             uint8_t ucDepth );
+
+/*-----------------------------------------------------------*/
+
+static char prvSkipSpace( JSONScanner_t * pxScanner )
+{
+    char cChar = '\0';
+
+    while( pxScanner->ulIndex < pxScanner->ulLength )
+    {
+        cChar = pxScanner->pcDoc[ pxScanner->ulIndex ];
+
+        if( jsonscanIS_SPACE( cChar ) )
+        {
+            pxScanner->ulIndex++;
+            cChar = '\0';
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return cChar;
+}
+/*-----------------------------------------------------------*/
+
+static JSONScanStatus_t prvFindStringEnd( const JSONScanner_t * pxScanner,
+                                          uint32_t * pulIndex )
+{
+    JSONScanStatus_t xStatus = eJSONScanPartial;
+    uint32_t ulIndex = *pulIndex + 1;
+    char cChar;
+
+    while( ulIndex < pxScanner->ulLength )
+    {
+        cChar = pxScanner->pcDoc[ ulIndex ];
+
+        if( cChar == '"' )
+        {
+            xStatus = eJSONScanSuccess;
+            break;
+        }
+        else if( cChar == '\\' )
+        {
+            /* Skip the escaped character. */
+            ulIndex += 2;
+        }
+        else if( cChar == '\0' )
+        {
+            /* A NULL terminated document ends in the middle of the string. */
+            break;
+        }
+        else
+        {
+            ulIndex++;
+        }
+    }
+
+    *pulIndex = ulIndex;
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static JSONScanStatus_t prvScanValue( JSONScanner_t * pxScanner,
+                                      JSONScanElement_t * pxElement )
+{
+    JSONScanStatus_t xStatus = eJSONScanSuccess;
+    char cChar = prvSkipSpace( pxScanner );
+    uint32_t ulStart = pxScanner->ulIndex;
+    uint32_t ulEnd;
+
+    pxElement->ucDepth = pxScanner->ucDepth;
+    pxElement->pcValue = &( pxScanner->pcDoc[ ulStart ] );
+
+    if( cChar == '\0' )
+    {
+        xStatus = eJSONScanPartial;
+    }
+    else if( ( cChar == '{' ) || ( cChar == '[' ) )
+    {
+        if( pxScanner->ucDepth >= jsonscanMAX_DEPTH )
+        {
+            xStatus = eJSONScanTooDeep;
+        }
+        else
+        {
+            if( cChar == '{' )
+            {
+                pxElement->eType = eJSONScanObject;
+                pxScanner->ulArrayBits &= ~( 1UL << pxScanner->ucDepth );
+                pxScanner->ucState = jsonscanSTATE_FIRST_KEY;
+            }
+            else
+            {
+                pxElement->eType = eJSONScanArray;
+                pxScanner->ulArrayBits |= ( 1UL << pxScanner->ucDepth );
+                pxScanner->ucState = jsonscanSTATE_FIRST_VALUE;
+            }
+
+            pxElement->ulValueLength = 1;
+            pxScanner->ulStart[ pxScanner->ucDepth ] = ulStart;
+            pxScanner->ucDepth++;
+            pxScanner->ulIndex++;
+        }
+    }
+    else if( cChar == '"' )
+    {
+        ulEnd = ulStart;
+        xStatus = prvFindStringEnd( pxScanner, &ulEnd );
+
+        if( xStatus == eJSONScanSuccess )
+        {
+            pxElement->eType = eJSONScanString;
+            pxElement->pcValue = &( pxScanner->pcDoc[ ulStart + 1 ] );
+            pxElement->ulValueLength = ulEnd - ulStart - 1;
+            pxScanner->ulIndex = ulEnd + 1;
+            pxScanner->ucState = jsonscanSTATE_NEXT;
+        }
+    }
+    else if( ( cChar == '-' ) || ( ( cChar >= '0' ) && ( cChar <= '9' ) ) ||
+             ( cChar == 't' ) || ( cChar == 'f' ) || ( cChar == 'n' ) )
+    {
+        /* Primitives are not checked further; they end at the next delimiter. */
+        ulEnd = ulStart + 1;
+
+        while( ulEnd < pxScanner->ulLength )
+        {
+            cChar = pxScanner->pcDoc[ ulEnd ];
+
+            if( jsonscanIS_SPACE( cChar ) || ( cChar == ',' ) || ( cChar == '}' ) ||
+                ( cChar == ']' ) || ( cChar == ':' ) || ( cChar == '\0' ) )
+            {
+                break;
+            }
+
+            ulEnd++;
+        }
+
+        pxElement->eType = eJSONScanPrimitive;
+        pxElement->ulValueLength = ulEnd - ulStart;
+        pxScanner->ulIndex = ulEnd;
+        pxScanner->ucState = jsonscanSTATE_NEXT;
+    }
+    else
+    {
+        xStatus = eJSONScanInvalid;
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvScanContainerEnd( JSONScanner_t * pxScanner,
+                                 JSONScanElement_t * pxElement )
+{
+    uint32_t ulStart;
+
+    pxScanner->ucDepth--;
+    ulStart = pxScanner->ulStart[ pxScanner->ucDepth ];
+
+    if( ( pxScanner->ulArrayBits & ( 1UL << pxScanner->ucDepth ) ) != 0UL )
+    {
+        pxElement->eType = eJSONScanArrayEnd;
+    }
+    else
+    {
+        pxElement->eType = eJSONScanObjectEnd;
+    }
+
+    pxElement->ucDepth = pxScanner->ucDepth;
+    pxElement->pcKey = NULL;
+    pxElement->ulKeyLength = 0;
+    pxElement->pcValue = &( pxScanner->pcDoc[ ulStart ] );
+    pxElement->ulValueLength = pxScanner->ulIndex + 1 - ulStart;
+
+    pxScanner->ulIndex++;
+    pxScanner->ucState = jsonscanSTATE_NEXT;
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t prvMatchPath( const char * pcPath,
+                             const char * const * ppcKeys,
+                             const uint32_t * pulKeyLengths,
+                             uint8_t ucDepth )
+{
+    uint8_t ucLevel;
+    uint8_t ucResult = jsonscanPATH_EXACT;
+
+    for( ucLevel = 0; ucLevel < ucDepth; ucLevel++ )
+    {
+        /* A value of an array has no key and cannot be on a path. */
+        if( ( ppcKeys[ ucLevel ] == NULL ) ||
+            ( strncmp( pcPath, ppcKeys[ ucLevel ], pulKeyLengths[ ucLevel ] ) != 0 ) )
+        {
+            ucResult = jsonscanPATH_NO_MATCH;
+            break;
+        }
+
+        pcPath += pulKeyLengths[ ucLevel ];
+
+        if( ( ucLevel + 1U ) < ucDepth )
+        {
+            if( *pcPath != jsonscanPATH_SEPARATOR )
+            {
+                ucResult = jsonscanPATH_NO_MATCH;
+                break;
+            }
+
+            pcPath++;
+        }
+    }
+
+    if( ucResult == jsonscanPATH_EXACT )
+    {
+        if( ( ucDepth == 0 ) && ( *pcPath != '\0' ) )
+        {
+            /* Every path but the empty one goes through the root. */
+            ucResult = jsonscanPATH_PREFIX;
+        }
+        else if( *pcPath == jsonscanPATH_SEPARATOR )
+        {
+            ucResult = jsonscanPATH_PREFIX;
+        }
+        else if( *pcPath != '\0' )
+        {
+            ucResult = jsonscanPATH_NO_MATCH;
+        }
+        else
+        {
+            /* The whole path matched. */
+        }
+    }
+
+    return ucResult;
+}
+/*-----------------------------------------------------------*/
+
+void JSON_ScanInit( JSONScanner_t * pxScanner,
+                    const char * pcDoc,
+                    uint32_t ulDocLength )
+{
+    pxScanner->pcDoc = pcDoc;
+    pxScanner->ulLength = ulDocLength;
+    pxScanner->ulIndex = 0;
+    pxScanner->ulArrayBits = 0;
+    pxScanner->ucDepth = 0;
+    pxScanner->ucState = jsonscanSTATE_VALUE;
+}
+/*-----------------------------------------------------------*/
+
+JSONScanStatus_t JSON_ScanNext( JSONScanner_t * pxScanner,
+                                JSONScanElement_t * pxElement )
+{
+    JSONScanStatus_t xStatus = eJSONScanSuccess;
+    uint8_t ucInArray;
+    uint32_t ulKeyEnd;
+    char cChar;
+
+    pxElement->pcKey = NULL;
+    pxElement->ulKeyLength = 0;
+
+    for( ; ; )
+    {
+        cChar = prvSkipSpace( pxScanner );
+        ucInArray = ( pxScanner->ucDepth > 0U ) &&
+                   ( ( pxScanner->ulArrayBits & ( 1UL << ( pxScanner->ucDepth - 1U ) ) ) != 0UL );
+
+        if( ( pxScanner->ucState == jsonscanSTATE_DONE ) ||
+            ( ( pxScanner->ucState == jsonscanSTATE_NEXT ) && ( pxScanner->ucDepth == 0 ) ) )
+        {
+            pxScanner->ucState = jsonscanSTATE_DONE;
+            xStatus = eJSONScanEnd;
+        }
+        else if( cChar == '\0' )
+        {
+            xStatus = eJSONScanPartial;
+        }
+        else if( pxScanner->ucState == jsonscanSTATE_NEXT )
+        {
+            if( cChar == ',' )
+            {
+                pxScanner->ulIndex++;
+                pxScanner->ucState = ( ucInArray != 0 ) ? jsonscanSTATE_VALUE : jsonscanSTATE_KEY;
+
+                /* Scan the following value. */
+                continue;
+            }
+            else if( ( ( cChar == '}' ) && ( ucInArray == 0 ) ) ||
+                     ( ( cChar == ']' ) && ( ucInArray != 0 ) ) )
+            {
+                prvScanContainerEnd( pxScanner, pxElement );
+            }
+            else
+            {
+                xStatus = eJSONScanInvalid;
+            }
+        }
+        else if( ( ( pxScanner->ucState == jsonscanSTATE_FIRST_KEY ) && ( cChar == '}' ) ) ||
+                 ( ( pxScanner->ucState == jsonscanSTATE_FIRST_VALUE ) && ( cChar == ']' ) ) )
+        {
+            /* An empty object or array. */
+            prvScanContainerEnd( pxScanner, pxElement );
+        }
+        else if( ( pxScanner->ucState == jsonscanSTATE_FIRST_KEY ) ||
+                 ( pxScanner->ucState == jsonscanSTATE_KEY ) )
+        {
+            ulKeyEnd = pxScanner->ulIndex;
+
+            if( cChar != '"' )
+            {
+                xStatus = eJSONScanInvalid;
+            }
+            else
+            {
+                xStatus = prvFindStringEnd( pxScanner, &ulKeyEnd );
+            }
+
+            if( xStatus == eJSONScanSuccess )
+            {
+                pxElement->pcKey = &( pxScanner->pcDoc[ pxScanner->ulIndex + 1 ] );
+                pxElement->ulKeyLength = ulKeyEnd - pxScanner->ulIndex - 1;
+                pxScanner->ulIndex = ulKeyEnd + 1;
+                cChar = prvSkipSpace( pxScanner );
+
+                if( cChar == ':' )
+                {
+                    pxScanner->ulIndex++;
+                    xStatus = prvScanValue( pxScanner, pxElement );
+                }
+                else if( cChar == '\0' )
+                {
+                    xStatus = eJSONScanPartial;
+                }
+                else
+                {
+                    xStatus = eJSONScanInvalid;
+                }
+            }
+        }
+        else
+        {
+            xStatus = prvScanValue( pxScanner, pxElement );
+        }
+
+        break;
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+JSONScanStatus_t JSON_ScanSkip( JSONScanner_t * pxScanner,
+                                JSONScanElement_t * pxElement )
+{
+    JSONScanStatus_t xStatus = eJSONScanPartial;
+    uint32_t ulIndex = pxScanner->ulIndex;
+    uint32_t ulNesting = 0;
+    const char * pcKey;
+    uint32_t ulKeyLength;
+    char cChar;
+
+    while( ulIndex < pxScanner->ulLength )
+    {
+        cChar = pxScanner->pcDoc[ ulIndex ];
+
+        if( cChar == '"' )
+        {
+            if( prvFindStringEnd( pxScanner, &ulIndex ) != eJSONScanSuccess )
+            {
+                break;
+            }
+        }
+        else if( ( cChar == '{' ) || ( cChar == '[' ) )
+        {
+            ulNesting++;
+        }
+        else if( ( cChar == '}' ) || ( cChar == ']' ) )
+        {
+            if( ulNesting == 0 )
+            {
+                xStatus = eJSONScanSuccess;
+                break;
+            }
+
+            ulNesting--;
+        }
+        else if( cChar == '\0' )
+        {
+            break;
+        }
+        else
+        {
+            /* Other characters do not change the nesting. */
+        }
+
+        ulIndex++;
+    }
+
+    if( xStatus == eJSONScanSuccess )
+    {
+        pcKey = pxElement->pcKey;
+        ulKeyLength = pxElement->ulKeyLength;
+
+        pxScanner->ulIndex = ulIndex;
+        prvScanContainerEnd( pxScanner, pxElement );
+
+        /* The element stays the start of the skipped object or array. */
+        pxElement->eType = ( pxElement->eType == eJSONScanArrayEnd ) ? eJSONScanArray : eJSONScanObject;
+        pxElement->pcKey = pcKey;
+        pxElement->ulKeyLength = ulKeyLength;
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+JSONScanStatus_t JSON_ScanPaths( const char * pcDoc,
+                                 uint32_t ulDocLength,
+                                 JSONScanQuery_t * pxQueries,
+                                 uint32_t ulQueryCount )
+{
+    JSONScanStatus_t xStatus = eJSONScanSuccess;
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    const char * pcKeys[ jsonscanMAX_DEPTH ];
+    uint32_t ulKeyLengths[ jsonscanMAX_DEPTH ];
+    uint32_t ulFound = 0;
+    uint32_t ulQuery;
+    uint8_t ucDescend;
+    uint8_t ucPending;
+    uint8_t ucMatch;
+
+    for( ulQuery = 0; ulQuery < ulQueryCount; ulQuery++ )
+    {
+        pxQueries[ ulQuery ].pcValue = NULL;
+        pxQueries[ ulQuery ].ulValueLength = 0;
+    }
+
+    JSON_ScanInit( &xScanner, pcDoc, ulDocLength );
+
+    while( ulFound < ulQueryCount )
+    {
+        xStatus = JSON_ScanNext( &xScanner, &xElement );
+
+        if( xStatus != eJSONScanSuccess )
+        {
+            break;
+        }
+
+        if( ( xElement.eType == eJSONScanObjectEnd ) || ( xElement.eType == eJSONScanArrayEnd ) )
+        {
+            /* Complete the queries matching the object or array which ends. */
+            for( ulQuery = 0; ulQuery < ulQueryCount; ulQuery++ )
+            {
+                if( ( pxQueries[ ulQuery ].pcValue == xElement.pcValue ) &&
+                    ( pxQueries[ ulQuery ].ulValueLength == 0 ) )
+                {
+                    pxQueries[ ulQuery ].ulValueLength = xElement.ulValueLength;
+                    ulFound++;
+                }
+            }
+
+            continue;
+        }
+
+        if( xElement.ucDepth > 0 )
+        {
+            pcKeys[ xElement.ucDepth - 1 ] = xElement.pcKey;
+            ulKeyLengths[ xElement.ucDepth - 1 ] = xElement.ulKeyLength;
+        }
+
+        ucDescend = 0;
+        ucPending = 0;
+
+        for( ulQuery = 0; ulQuery < ulQueryCount; ulQuery++ )
+        {
+            if( pxQueries[ ulQuery ].pcValue != NULL )
+            {
+                continue;
+            }
+
+            ucMatch = prvMatchPath( pxQueries[ ulQuery ].pcPath, pcKeys, ulKeyLengths, xElement.ucDepth );
+
+            if( ucMatch == jsonscanPATH_EXACT )
+            {
+                pxQueries[ ulQuery ].eType = xElement.eType;
+                pxQueries[ ulQuery ].pcValue = xElement.pcValue;
+
+                if( ( xElement.eType == eJSONScanObject ) || ( xElement.eType == eJSONScanArray ) )
+                {
+                    /* Completed at the end of the object or array. */
+                    ucPending = 1;
+                }
+                else
+                {
+                    pxQueries[ ulQuery ].ulValueLength = xElement.ulValueLength;
+                    ulFound++;
+                }
+            }
+            else if( ( ucMatch == jsonscanPATH_PREFIX ) && ( xElement.eType == eJSONScanObject ) )
+            {
+                ucDescend = 1;
+            }
+            else
+            {
+                /* The element is not on the path of this query. */
+            }
+        }
+
+        if( ( ucDescend == 0 ) &&
+            ( ( xElement.eType == eJSONScanObject ) || ( xElement.eType == eJSONScanArray ) ) )
+        {
+            xStatus = JSON_ScanSkip( &xScanner, &xElement );
+
+            if( xStatus != eJSONScanSuccess )
+            {
+                break;
+            }
+
+            if( ucPending != 0 )
+            {
+                for( ulQuery = 0; ulQuery < ulQueryCount; ulQuery++ )
+                {
+                    if( ( pxQueries[ ulQuery ].pcValue == xElement.pcValue ) &&
+                        ( pxQueries[ ulQuery ].ulValueLength == 0 ) )
+                    {
+                        pxQueries[ ulQuery ].ulValueLength = xElement.ulValueLength;
+                        ulFound++;
+                    }
+                }
+            }
+        }
+    }
+
+    if( ulFound == ulQueryCount )
+    {
+        xStatus = eJSONScanSuccess;
+    }
+    else if( xStatus == eJSONScanSuccess )
+    {
+        xStatus = eJSONScanEnd;
+    }
+    else
+    {
+        /* Keep the error. */
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,854 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_freertos_tcp_benchmark.c
+ * @brief Throughput and latency benchmarks of FreeRTOS+TCP.
+ *
+ * These tests require the stack to be built with the SimLink network
+ * interface (lib/FreeRTOS-Plus-TCP/source/portable/NetworkInterface/SimLink)
+ * instead of a real network driver.  Every test connects a client socket to a
+ * server socket on the local IP address, so all traffic crosses the emulated
+ * link.  When ipconfigUSE_DHCP is enabled, the time needed to obtain an
+ * address from the DHCP server of the link is measured as well.  With
+ * ipconfigDHCP_FAST_RECONNECT, the application provides the lease hooks
+ * declared in FreeRTOS_DHCP.h.  The results are printed with
+ * configPRINTF so that different TCP window and buffer configurations can be
+ * compared.
+ */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+#include "FreeRTOS_IP_Private.h"
+#include "FreeRTOS_DHCP.h"
+#include "SimLink.h"
+
+/* Test includes. */
+#include "unity_fixture.h"
+#include "unity.h"
+
+/**
+ * @brief Configuration for this test group.
+ */
+#ifndef tcpbenchmarkLATENCY_MS
+    #define tcpbenchmarkLATENCY_MS            ( 10 )
+#endif
+#ifndef tcpbenchmarkBANDWIDTH_BPS
+    #define tcpbenchmarkBANDWIDTH_BPS         ( 10000000UL )
+#endif
+#ifndef tcpbenchmarkLOSS_PPM
+    #define tcpbenchmarkLOSS_PPM              ( 10000UL )
+#endif
+#ifndef tcpbenchmarkREORDER_PPM
+    #define tcpbenchmarkREORDER_PPM           ( 10000UL )
+#endif
+#ifndef tcpbenchmarkSEED
+    #define tcpbenchmarkSEED                  ( 0x5EED5EEDUL )
+#endif
+
+/* Socket buffer and window properties under test. */
+#ifndef tcpbenchmarkTX_BUFFER_SIZE
+    #define tcpbenchmarkTX_BUFFER_SIZE        ( 8 * ipconfigTCP_MSS )
+#endif
+#ifndef tcpbenchmarkTX_WINDOW_SIZE
+    #define tcpbenchmarkTX_WINDOW_SIZE        ( 4 )
+#endif
+#ifndef tcpbenchmarkRX_BUFFER_SIZE
+    #define tcpbenchmarkRX_BUFFER_SIZE        ( 8 * ipconfigTCP_MSS )
+#endif
+#ifndef tcpbenchmarkRX_WINDOW_SIZE
+    #define tcpbenchmarkRX_WINDOW_SIZE        ( 4 )
+#endif
+
+#define tcpbenchmarkBULK_BYTES                ( 256UL * 1024UL )
+#define tcpbenchmarkCONNECTIONS               ( 50 )
+#define tcpbenchmarkRTT_ITERATIONS            ( 100 )
+#define tcpbenchmarkRTT_MESSAGE_SIZE          ( 64 )
+#define tcpbenchmarkUDP_DATAGRAMS             ( 1000 )
+#define tcpbenchmarkUDP_DATAGRAM_SIZE         ( 128 )
+#define tcpbenchmarkCHUNK_SIZE                ( 1024 )
+
+#define tcpbenchmarkBULK_PORT                 ( 5001 )
+#define tcpbenchmarkCONNECT_PORT              ( 5002 )
+#define tcpbenchmarkECHO_PORT                 ( 5003 )
+#define tcpbenchmarkUDP_PORT                  ( 5004 )
+
+#define tcpbenchmarkTIMEOUT                   ( pdMS_TO_TICKS( 20000 ) )
+#define tcpbenchmarkDHCP_ITERATIONS           ( 5 )
+#define tcpbenchmarkSERVER_STACK_SIZE         ( configMINIMAL_STACK_SIZE * 6 )
+
+/**
+ * @brief Work description shared with the server task.
+ */
+typedef struct BenchmarkServer
+{
+    uint16_t usPort;
+    BaseType_t xConnections; /**< Number of connections to accept. */
+    BaseType_t xEcho;        /**< Return the data instead of checking it. */
+    uint32_t ulBytes;        /**< Bytes received and verified. */
+    BaseType_t xCorrupted;   /**< pdTRUE if the payload did not match the pattern. */
+    SemaphoreHandle_t xListening;
+    SemaphoreHandle_t xDone;
+} BenchmarkServer_t;
+
+static uint8_t ucTxBuffer[ tcpbenchmarkCHUNK_SIZE ];
+static uint8_t ucRxBuffer[ tcpbenchmarkCHUNK_SIZE ];
+
+/* When pdTRUE, new sockets are created with FREERTOS_SO_TCP_NODELAY and
+ * without delayed ACK's. */
+static BaseType_t xLowLatency = pdFALSE;
+
+#if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+
+/* When pdTRUE, the server reads with FreeRTOS_recv_loan() from sockets
+ * which have FREERTOS_SO_TCP_RX_LOAN set. */
+    static BaseType_t xRxLoan = pdFALSE;
+#endif
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvPatternByte( uint32_t ulOffset )
+{
+    return ( uint8_t ) ( ( ulOffset * 7UL ) ^ ( ulOffset >> 8 ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetLink( uint32_t ulLatencyMS,
+                        uint32_t ulBandwidthBPS,
+                        uint32_t ulLossPPM,
+                        uint32_t ulReorderPPM )
+{
+    SimLinkParameters_t xParameters;
+
+    memset( &xParameters, 0, sizeof( xParameters ) );
+    xParameters.ulLatencyMS = ulLatencyMS;
+    xParameters.ulBandwidthBPS = ulBandwidthBPS;
+    xParameters.ulLossPPM = ulLossPPM;
+    xParameters.ulReorderPPM = ulReorderPPM;
+    xParameters.ulReorderDelayMS = ulLatencyMS / 2;
+
+    vSimLinkSetParameters( eSimLinkClientToServer, &xParameters );
+    vSimLinkSetParameters( eSimLinkServerToClient, &xParameters );
+    vSimLinkReset( tcpbenchmarkSEED );
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintLinkStatistics( void )
+{
+    SimLinkStatistics_t xStatistics;
+    BaseType_t x;
+
+    for( x = 0; x < ( BaseType_t ) eSimLinkDirections; x++ )
+    {
+        vSimLinkGetStatistics( ( eSimLinkDirection_t ) x, &xStatistics );
+        configPRINTF( ( "    link %s: sent %u delivered %u lost %u overflowed %u reordered %u\r\n",
+                        ( x == ( BaseType_t ) eSimLinkClientToServer ) ? "c->s" : "s->c",
+                        xStatistics.ulFramesSent,
+                        xStatistics.ulFramesDelivered,
+                        xStatistics.ulFramesLost,
+                        xStatistics.ulFramesOverflowed,
+                        xStatistics.ulFramesReordered ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetSocketOptions( Socket_t xSocket )
+{
+    WinProperties_t xWinProperties;
+    BaseType_t xTrue = pdTRUE;
+
+    xWinProperties.lTxBufSize = tcpbenchmarkTX_BUFFER_SIZE;
+    xWinProperties.lTxWinSize = tcpbenchmarkTX_WINDOW_SIZE;
+    xWinProperties.lRxBufSize = tcpbenchmarkRX_BUFFER_SIZE;
+    xWinProperties.lRxWinSize = tcpbenchmarkRX_WINDOW_SIZE;
+
+    ( void ) FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_WIN_PROPERTIES, ( void * ) &xWinProperties, sizeof( xWinProperties ) );
+
+    if( xLowLatency != pdFALSE )
+    {
+        TEST_ASSERT_EQUAL( 0, FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_TCP_NODELAY, &xTrue, sizeof( xTrue ) ) );
+
+        /* Without TCP windowing, ACK's are not delayed per socket. */
+        #if ( ipconfigUSE_TCP_WIN == 1 )
+            {
+                DelayedAckProperties_t xAckProperties;
+
+                xAckProperties.usShortDelayMS = 0;
+                xAckProperties.usLongDelayMS = 0;
+                TEST_ASSERT_EQUAL( 0, FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_TCP_DELAYED_ACK, &xAckProperties, sizeof( xAckProperties ) ) );
+            }
+        #endif
+    }
+
+    #if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+        if( xRxLoan != pdFALSE )
+        {
+            TEST_ASSERT_EQUAL( 0, FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_TCP_RX_LOAN, &xTrue, sizeof( xTrue ) ) );
+        }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void prvGracefulClose( Socket_t xSocket )
+{
+    TickType_t xStart = xTaskGetTickCount();
+
+    ( void ) FreeRTOS_shutdown( xSocket, FREERTOS_SHUT_RDWR );
+
+    /* Wait for the peer to acknowledge the shutdown. */
+    while( ( FreeRTOS_recv( xSocket, ucRxBuffer, sizeof( ucRxBuffer ), 0 ) >= 0 ) &&
+           ( ( xTaskGetTickCount() - xStart ) < tcpbenchmarkTIMEOUT ) )
+    {
+    }
+
+    ( void ) FreeRTOS_closesocket( xSocket );
+}
+/*-----------------------------------------------------------*/
+
+static void prvServerTask( void * pvParameters )
+{
+    BenchmarkServer_t * pxServer = ( BenchmarkServer_t * ) pvParameters;
+    struct freertos_sockaddr xAddress;
+    socklen_t xAddressLength = sizeof( xAddress );
+    TickType_t xTimeout = tcpbenchmarkTIMEOUT;
+    Socket_t xListeningSocket, xConnectedSocket;
+    BaseType_t xConnection, xReceived, x;
+    uint32_t ulOffset = 0;
+    uint8_t ucBuffer[ tcpbenchmarkCHUNK_SIZE ];
+    uint8_t * pucData;
+
+    xListeningSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_STREAM, FREERTOS_IPPROTO_TCP );
+    configASSERT( xListeningSocket != FREERTOS_INVALID_SOCKET );
+
+    ( void ) FreeRTOS_setsockopt( xListeningSocket, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+    prvSetSocketOptions( xListeningSocket );
+
+    xAddress.sin_port = FreeRTOS_htons( pxServer->usPort );
+    xAddress.sin_addr = 0;
+    ( void ) FreeRTOS_bind( xListeningSocket, &xAddress, sizeof( xAddress ) );
+    ( void ) FreeRTOS_listen( xListeningSocket, pxServer->xConnections );
+    xSemaphoreGive( pxServer->xListening );
+
+    for( xConnection = 0; xConnection < pxServer->xConnections; xConnection++ )
+    {
+        xConnectedSocket = FreeRTOS_accept( xListeningSocket, &xAddress, &xAddressLength );
+
+        if( ( xConnectedSocket == NULL ) || ( xConnectedSocket == FREERTOS_INVALID_SOCKET ) )
+        {
+            break;
+        }
+
+        ( void ) FreeRTOS_setsockopt( xConnectedSocket, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+
+        for( ; ; )
+        {
+            #if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+                if( xRxLoan != pdFALSE )
+                {
+                    xReceived = FreeRTOS_recv_loan( xConnectedSocket, &pucData, 0 );
+                }
+                else
+            #endif
+            {
+                xReceived = FreeRTOS_recv( xConnectedSocket, ucBuffer, sizeof( ucBuffer ), 0 );
+                pucData = ucBuffer;
+            }
+
+            if( xReceived <= 0 )
+            {
+                break;
+            }
+
+            if( pxServer->xEcho != pdFALSE )
+            {
+                ( void ) FreeRTOS_send( xConnectedSocket, pucData, ( size_t ) xReceived, 0 );
+            }
+            else
+            {
+                for( x = 0; x < xReceived; x++, ulOffset++ )
+                {
+                    if( pucData[ x ] != prvPatternByte( ulOffset ) )
+                    {
+                        pxServer->xCorrupted = pdTRUE;
+                    }
+                }
+            }
+
+            #if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+                if( xRxLoan != pdFALSE )
+                {
+                    if( FreeRTOS_release_loan( xConnectedSocket, pucData ) != 0 )
+                    {
+                        pxServer->xCorrupted = pdTRUE;
+                    }
+                }
+            #endif
+
+            pxServer->ulBytes += ( uint32_t ) xReceived;
+        }
+
+        prvGracefulClose( xConnectedSocket );
+    }
+
+    ( void ) FreeRTOS_closesocket( xListeningSocket );
+    xSemaphoreGive( pxServer->xDone );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvStartServer( BenchmarkServer_t * pxServer,
+                            uint16_t usPort,
+                            BaseType_t xConnections,
+                            BaseType_t xEcho )
+{
+    BaseType_t xResult;
+
+    memset( pxServer, 0, sizeof( *pxServer ) );
+    pxServer->usPort = usPort;
+    pxServer->xConnections = xConnections;
+    pxServer->xEcho = xEcho;
+    pxServer->xListening = xSemaphoreCreateBinary();
+    pxServer->xDone = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL( pxServer->xListening );
+    TEST_ASSERT_NOT_NULL( pxServer->xDone );
+
+    xResult = xTaskCreate( prvServerTask, "BenchSrv", tcpbenchmarkSERVER_STACK_SIZE, pxServer,
+                           uxTaskPriorityGet( NULL ), NULL );
+    TEST_ASSERT_EQUAL( pdPASS, xResult );
+    TEST_ASSERT_EQUAL( pdTRUE, xSemaphoreTake( pxServer->xListening, tcpbenchmarkTIMEOUT ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvStopServer( BenchmarkServer_t * pxServer )
+{
+    TEST_ASSERT_EQUAL( pdTRUE, xSemaphoreTake( pxServer->xDone, tcpbenchmarkTIMEOUT ) );
+    vSemaphoreDelete( pxServer->xListening );
+    vSemaphoreDelete( pxServer->xDone );
+}
+/*-----------------------------------------------------------*/
+
+static Socket_t prvConnect( uint16_t usPort )
+{
+    struct freertos_sockaddr xAddress;
+    TickType_t xTimeout = tcpbenchmarkTIMEOUT;
+    Socket_t xSocket;
+
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_STREAM, FREERTOS_IPPROTO_TCP );
+    TEST_ASSERT_NOT_EQUAL( FREERTOS_INVALID_SOCKET, xSocket );
+
+    ( void ) FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+    ( void ) FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_SNDTIMEO, &xTimeout, sizeof( xTimeout ) );
+    prvSetSocketOptions( xSocket );
+
+    xAddress.sin_port = FreeRTOS_htons( usPort );
+    xAddress.sin_addr = FreeRTOS_GetIPAddress();
+
+    if( FreeRTOS_connect( xSocket, &xAddress, sizeof( xAddress ) ) != 0 )
+    {
+        ( void ) FreeRTOS_closesocket( xSocket );
+        xSocket = NULL;
+    }
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+static void prvBulkTransfer( const char * pcName )
+{
+    BenchmarkServer_t xServer;
+    Socket_t xSocket;
+    uint32_t ulOffset = 0, ulChunk, ulElapsedMS, ul;
+    BaseType_t xSent;
+    TickType_t xStart;
+
+    prvStartServer( &xServer, tcpbenchmarkBULK_PORT, 1, pdFALSE );
+
+    xStart = xTaskGetTickCount();
+    xSocket = prvConnect( tcpbenchmarkBULK_PORT );
+    TEST_ASSERT_NOT_NULL( xSocket );
+
+    while( ulOffset < tcpbenchmarkBULK_BYTES )
+    {
+        ulChunk = tcpbenchmarkBULK_BYTES - ulOffset;
+
+        if( ulChunk > sizeof( ucTxBuffer ) )
+        {
+            ulChunk = sizeof( ucTxBuffer );
+        }
+
+        for( ul = 0; ul < ulChunk; ul++ )
+        {
+            ucTxBuffer[ ul ] = prvPatternByte( ulOffset + ul );
+        }
+
+        xSent = FreeRTOS_send( xSocket, ucTxBuffer, ulChunk, 0 );
+
+        if( xSent <= 0 )
+        {
+            break;
+        }
+
+        ulOffset += ( uint32_t ) xSent;
+    }
+
+    prvGracefulClose( xSocket );
+    prvStopServer( &xServer );
+    ulElapsedMS = ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    configPRINTF( ( "%s: %u bytes in %u ms, %u kbit/s\r\n", pcName, xServer.ulBytes, ulElapsedMS,
+                    ( ulElapsedMS == 0 ) ? 0 : ( uint32_t ) ( ( ( uint64_t ) xServer.ulBytes * 8ULL ) / ulElapsedMS ) ) );
+    prvPrintLinkStatistics();
+
+    TEST_ASSERT_EQUAL_UINT32( tcpbenchmarkBULK_BYTES, ulOffset );
+    TEST_ASSERT_EQUAL_UINT32( tcpbenchmarkBULK_BYTES, xServer.ulBytes );
+    TEST_ASSERT_FALSE( xServer.xCorrupted );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUDPSenderTask( void * pvParameters )
+{
+    SemaphoreHandle_t xDone = ( SemaphoreHandle_t ) pvParameters;
+    struct freertos_sockaddr xAddress;
+    uint8_t ucDatagram[ tcpbenchmarkUDP_DATAGRAM_SIZE ];
+    Socket_t xSocket;
+    uint32_t ul;
+
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    xAddress.sin_port = FreeRTOS_htons( tcpbenchmarkUDP_PORT );
+    xAddress.sin_addr = FreeRTOS_GetIPAddress();
+
+    for( ul = 0; ul < tcpbenchmarkUDP_DATAGRAMS; ul++ )
+    {
+        memset( ucDatagram, ( int ) ( ul & 0xFFUL ), sizeof( ucDatagram ) );
+        ( void ) FreeRTOS_sendto( xSocket, ucDatagram, sizeof( ucDatagram ), 0, &xAddress, sizeof( xAddress ) );
+    }
+
+    ( void ) FreeRTOS_closesocket( xSocket );
+    xSemaphoreGive( xDone );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvRoundTrip( const char * pcName )
+{
+    BenchmarkServer_t xServer;
+    Socket_t xSocket;
+    BaseType_t xIteration, xReceived, xTotal;
+    TickType_t xStart, xElapsed;
+
+    prvStartServer( &xServer, tcpbenchmarkECHO_PORT, 1, pdTRUE );
+    xSocket = prvConnect( tcpbenchmarkECHO_PORT );
+    TEST_ASSERT_NOT_NULL( xSocket );
+
+    memset( ucTxBuffer, 0xA5, tcpbenchmarkRTT_MESSAGE_SIZE );
+    xStart = xTaskGetTickCount();
+
+    for( xIteration = 0; xIteration < tcpbenchmarkRTT_ITERATIONS; xIteration++ )
+    {
+        TEST_ASSERT_EQUAL( tcpbenchmarkRTT_MESSAGE_SIZE, FreeRTOS_send( xSocket, ucTxBuffer, tcpbenchmarkRTT_MESSAGE_SIZE, 0 ) );
+
+        for( xTotal = 0; xTotal < tcpbenchmarkRTT_MESSAGE_SIZE; xTotal += xReceived )
+        {
+            xReceived = FreeRTOS_recv( xSocket, ucRxBuffer, tcpbenchmarkRTT_MESSAGE_SIZE - xTotal, 0 );
+            TEST_ASSERT_GREATER_THAN( 0, xReceived );
+        }
+    }
+
+    xElapsed = xTaskGetTickCount() - xStart;
+    prvGracefulClose( xSocket );
+    prvStopServer( &xServer );
+
+    configPRINTF( ( "%s: %d messages of %d bytes, average %u us (link latency %u ms each way)\r\n",
+                    pcName, tcpbenchmarkRTT_ITERATIONS, tcpbenchmarkRTT_MESSAGE_SIZE,
+                    ( uint32_t ) ( ( xElapsed * portTICK_PERIOD_MS * 1000UL ) / tcpbenchmarkRTT_ITERATIONS ),
+                    tcpbenchmarkLATENCY_MS ) );
+    prvPrintLinkStatistics();
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigUSE_DHCP != 0 )
+
+/* Simulate a link flap and return the time in ms until the network is up
+ * again with an address from the DHCP server. */
+    static uint32_t prvTimeToIP( void )
+    {
+        TickType_t xStart, xNow;
+
+        xStart = xTaskGetTickCount();
+        FreeRTOS_NetworkDown();
+
+        /* The IP-task marks the network down before DHCP starts. */
+        do
+        {
+            vTaskDelay( 1 );
+            xNow = xTaskGetTickCount();
+        } while( ( FreeRTOS_IsNetworkUp() != pdFALSE ) && ( ( xNow - xStart ) < tcpbenchmarkTIMEOUT ) );
+
+        while( ( FreeRTOS_IsNetworkUp() == pdFALSE ) && ( ( xNow - xStart ) < tcpbenchmarkTIMEOUT ) )
+        {
+            vTaskDelay( 1 );
+            xNow = xTaskGetTickCount();
+        }
+
+        TEST_ASSERT_TRUE( FreeRTOS_IsNetworkUp() );
+
+        return ( uint32_t ) ( ( xNow - xStart ) * portTICK_PERIOD_MS );
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvTimeToIPSeries( const char * pcName )
+    {
+        uint32_t ulMS, ulTotalMS = 0, ulWorstMS = 0;
+        BaseType_t xIteration;
+
+        for( xIteration = 0; xIteration < tcpbenchmarkDHCP_ITERATIONS; xIteration++ )
+        {
+            ulMS = prvTimeToIP();
+            ulTotalMS += ulMS;
+
+            if( ulMS > ulWorstMS )
+            {
+                ulWorstMS = ulMS;
+            }
+        }
+
+        configPRINTF( ( "%s: average %u ms, worst %u ms over %d link flaps (link latency %u ms each way)\r\n",
+                        pcName, ulTotalMS / tcpbenchmarkDHCP_ITERATIONS, ulWorstMS, tcpbenchmarkDHCP_ITERATIONS,
+                        tcpbenchmarkLATENCY_MS ) );
+        configPRINTF( ( "    INIT-REBOOT %s, rapid commit %s, ARP probe %s\r\n",
+                        ( ipconfigDHCP_FAST_RECONNECT != 0 ) ? "on" : "off",
+                        ( ipconfigDHCP_USE_RAPID_COMMIT != 0 ) ? "on" : "off",
+                        ( ipconfigDHCP_ARP_PROBE != 0 ) ? "on" : "off" ) );
+        prvPrintLinkStatistics();
+    }
+#endif /* if ( ipconfigUSE_DHCP != 0 ) */
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Test group definition.
+ */
+TEST_GROUP( Full_FREERTOS_TCP_BENCHMARK );
+
+TEST_SETUP( Full_FREERTOS_TCP_BENCHMARK )
+{
+    xLowLatency = pdFALSE;
+    #if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+        xRxLoan = pdFALSE;
+    #endif
+    prvSetLink( tcpbenchmarkLATENCY_MS, tcpbenchmarkBANDWIDTH_BPS, 0, 0 );
+}
+
+TEST_TEAR_DOWN( Full_FREERTOS_TCP_BENCHMARK )
+{
+    /* Leave an ideal link behind for other test groups. */
+    prvSetLink( 0, 0, 0, 0 );
+}
+
+TEST_GROUP_RUNNER( Full_FREERTOS_TCP_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, BulkThroughput );
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputLossyLink );
+    #if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+        RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputRxLoan );
+        RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputRxLoanLossyLink );
+    #endif
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, ConnectionSetupRate );
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, SmallMessageRoundTrip );
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, SmallMessageRoundTripNoDelay );
+    RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, UDPPacketRate );
+    #if ( ipconfigUSE_DHCP != 0 )
+        RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPReconnect );
+        RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPPoolChanged );
+        RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPRapidCommit );
+        #if ( ipconfigDHCP_ARP_PROBE != 0 )
+            RUN_TEST_CASE( Full_FREERTOS_TCP_BENCHMARK, DHCPAddressInUse );
+        #endif
+    #endif
+}
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, BulkThroughput )
+{
+    prvBulkTransfer( "Bulk TCP" );
+}
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputLossyLink )
+{
+    /* Losses and reordering force retransmissions and out-of-order segments,
+     * the payload must still arrive intact. */
+    prvSetLink( tcpbenchmarkLATENCY_MS, tcpbenchmarkBANDWIDTH_BPS, tcpbenchmarkLOSS_PPM, tcpbenchmarkREORDER_PPM );
+    prvBulkTransfer( "Bulk TCP, lossy link" );
+}
+
+#if ( ipconfigTCP_RX_BUFFER_LOANING != 0 )
+    TEST( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputRxLoan )
+    {
+        /* The server reads the payload from the loaned network buffers. */
+        xRxLoan = pdTRUE;
+        prvBulkTransfer( "Bulk TCP, Rx buffer loaning" );
+    }
+
+    TEST( Full_FREERTOS_TCP_BENCHMARK, BulkThroughputRxLoanLossyLink )
+    {
+        /* Out-of-order segments are stored in the Rx stream, and are copied
+         * into a network buffer before they are loaned. */
+        xRxLoan = pdTRUE;
+        prvSetLink( tcpbenchmarkLATENCY_MS, tcpbenchmarkBANDWIDTH_BPS, tcpbenchmarkLOSS_PPM, tcpbenchmarkREORDER_PPM );
+        prvBulkTransfer( "Bulk TCP, Rx buffer loaning, lossy link" );
+    }
+#endif /* if ( ipconfigTCP_RX_BUFFER_LOANING != 0 ) */
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, ConnectionSetupRate )
+{
+    BenchmarkServer_t xServer;
+    Socket_t xSocket;
+    BaseType_t xConnection;
+    uint32_t ulElapsedMS;
+    TickType_t xStart;
+
+    prvStartServer( &xServer, tcpbenchmarkCONNECT_PORT, tcpbenchmarkCONNECTIONS, pdFALSE );
+    xStart = xTaskGetTickCount();
+
+    for( xConnection = 0; xConnection < tcpbenchmarkCONNECTIONS; xConnection++ )
+    {
+        xSocket = prvConnect( tcpbenchmarkCONNECT_PORT );
+        TEST_ASSERT_NOT_NULL( xSocket );
+        prvGracefulClose( xSocket );
+    }
+
+    prvStopServer( &xServer );
+    ulElapsedMS = ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    configPRINTF( ( "Connection setup: %d connections in %u ms, %u per second\r\n", tcpbenchmarkCONNECTIONS, ulElapsedMS,
+                    ( ulElapsedMS == 0 ) ? 0 : ( uint32_t ) ( ( tcpbenchmarkCONNECTIONS * 1000UL ) / ulElapsedMS ) ) );
+    prvPrintLinkStatistics();
+}
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, SmallMessageRoundTrip )
+{
+    prvRoundTrip( "Small message RTT" );
+}
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, SmallMessageRoundTripNoDelay )
+{
+    /* The same exchange with FREERTOS_SO_TCP_NODELAY set and delayed ACK's
+     * disabled on both ends. */
+    xLowLatency = pdTRUE;
+    prvRoundTrip( "Small message RTT, TCP_NODELAY" );
+}
+
+TEST( Full_FREERTOS_TCP_BENCHMARK, UDPPacketRate )
+{
+    SemaphoreHandle_t xDone;
+    struct freertos_sockaddr xAddress;
+    socklen_t xAddressLength = sizeof( xAddress );
+    TickType_t xTimeout = pdMS_TO_TICKS( 500 ) + pdMS_TO_TICKS( tcpbenchmarkLATENCY_MS );
+    TickType_t xStart, xLast;
+    Socket_t xSocket;
+    uint32_t ulReceived = 0, ulElapsedMS;
+
+    /* No bandwidth limit, this measures the cost per datagram of the stack. */
+    prvSetLink( tcpbenchmarkLATENCY_MS, 0, 0, 0 );
+
+    xDone = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL( xDone );
+
+    xSocket = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_DGRAM, FREERTOS_IPPROTO_UDP );
+    TEST_ASSERT_NOT_EQUAL( FREERTOS_INVALID_SOCKET, xSocket );
+    ( void ) FreeRTOS_setsockopt( xSocket, 0, FREERTOS_SO_RCVTIMEO, &xTimeout, sizeof( xTimeout ) );
+
+    xAddress.sin_port = FreeRTOS_htons( tcpbenchmarkUDP_PORT );
+    xAddress.sin_addr = 0;
+    TEST_ASSERT_EQUAL( 0, FreeRTOS_bind( xSocket, &xAddress, sizeof( xAddress ) ) );
+
+    xStart = xTaskGetTickCount();
+    xLast = xStart;
+    TEST_ASSERT_EQUAL( pdPASS, xTaskCreate( prvUDPSenderTask, "BenchUDP", tcpbenchmarkSERVER_STACK_SIZE, xDone,
+                                            uxTaskPriorityGet( NULL ), NULL ) );
+
+    while( FreeRTOS_recvfrom( xSocket, ucRxBuffer, sizeof( ucRxBuffer ), 0, &xAddress, &xAddressLength ) > 0 )
+    {
+        ulReceived++;
+        xLast = xTaskGetTickCount();
+    }
+
+    TEST_ASSERT_EQUAL( pdTRUE, xSemaphoreTake( xDone, tcpbenchmarkTIMEOUT ) );
+    ( void ) FreeRTOS_closesocket( xSocket );
+    vSemaphoreDelete( xDone );
+
+    ulElapsedMS = ( xLast - xStart ) * portTICK_PERIOD_MS;
+    configPRINTF( ( "UDP (direct send %s): %u of %d datagrams received in %u ms, %u datagrams per second\r\n",
+                    ( ipconfigUDP_DIRECT_SEND != 0 ) ? "on" : "off",
+                    ulReceived, tcpbenchmarkUDP_DATAGRAMS, ulElapsedMS,
+                    ( ulElapsedMS == 0 ) ? 0 : ( uint32_t ) ( ( ulReceived * 1000UL ) / ulElapsedMS ) ) );
+    prvPrintLinkStatistics();
+
+    TEST_ASSERT_GREATER_THAN( 0, ulReceived );
+    TEST_ASSERT_TRUE( ulReceived <= tcpbenchmarkUDP_DATAGRAMS );
+}
+
+#if ( ipconfigUSE_DHCP != 0 )
+    TEST( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPReconnect )
+    {
+        /* The server still knows the lease: with ipconfigDHCP_FAST_RECONNECT
+         * a single REQUEST confirms it, otherwise a full DISCOVER / OFFER /
+         * REQUEST / ACK exchange is needed. */
+        uint32_t ulAddress = FreeRTOS_GetIPAddress();
+
+        prvTimeToIPSeries( "DHCP time to IP, reconnect" );
+        TEST_ASSERT_EQUAL_UINT32( ulAddress, FreeRTOS_GetIPAddress() );
+    }
+
+    TEST( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPPoolChanged )
+    {
+        /* The server hands out a different address: a stored lease is
+         * rejected with a NAK, and the client starts again with a DISCOVER. */
+        SimLinkDHCPServer_t xOriginal, xServer;
+        uint32_t ulMS;
+
+        vSimLinkGetDHCPServer( &xOriginal );
+        memcpy( &xServer, &xOriginal, sizeof( xServer ) );
+
+        xServer.ulOfferedAddress = FreeRTOS_htonl( FreeRTOS_ntohl( xOriginal.ulOfferedAddress ) + 1UL );
+        vSimLinkSetDHCPServer( &xServer );
+        ulMS = prvTimeToIP();
+        TEST_ASSERT_EQUAL_UINT32( xServer.ulOfferedAddress, FreeRTOS_GetIPAddress() );
+
+        /* Move back to the original address, the other tests use it. */
+        vSimLinkSetDHCPServer( &xOriginal );
+        ulMS += prvTimeToIP();
+        TEST_ASSERT_EQUAL_UINT32( xOriginal.ulOfferedAddress, FreeRTOS_GetIPAddress() );
+
+        configPRINTF( ( "DHCP time to IP, address pool changed: average %u ms over 2 link flaps\r\n", ulMS / 2UL ) );
+        prvPrintLinkStatistics();
+    }
+
+    TEST( Full_FREERTOS_TCP_BENCHMARK, DHCPTimeToIPRapidCommit )
+    {
+        /* The server answers a DISCOVER with Rapid Commit directly with an
+         * ACK.  The lease is forgotten before every link flap, so that the
+         * client sends a DISCOVER rather than an INIT-REBOOT request. */
+        SimLinkDHCPServer_t xOriginal, xServer;
+        SimLinkDHCPStatistics_t xBefore, xAfter;
+        uint32_t ulMS, ulTotalMS = 0, ulWorstMS = 0;
+        BaseType_t xIteration;
+
+        vSimLinkGetDHCPServer( &xOriginal );
+        memcpy( &xServer, &xOriginal, sizeof( xServer ) );
+        xServer.xRapidCommit = pdTRUE;
+        vSimLinkSetDHCPServer( &xServer );
+
+        for( xIteration = 0; xIteration < tcpbenchmarkDHCP_ITERATIONS; xIteration++ )
+        {
+            #if ( ipconfigDHCP_FAST_RECONNECT != 0 )
+                vDHCPForgetLease();
+            #endif
+
+            vSimLinkGetDHCPStatistics( &xBefore );
+            ulMS = prvTimeToIP();
+            vSimLinkGetDHCPStatistics( &xAfter );
+            ulTotalMS += ulMS;
+
+            if( ulMS > ulWorstMS )
+            {
+                ulWorstMS = ulMS;
+            }
+
+            #if ( ipconfigDHCP_USE_RAPID_COMMIT != 0 )
+                /* A DISCOVER and an ACK, nothing else. */
+                TEST_ASSERT_EQUAL_UINT32( 1, xAfter.ulDiscovers - xBefore.ulDiscovers );
+                TEST_ASSERT_EQUAL_UINT32( 1, xAfter.ulAcks - xBefore.ulAcks );
+                TEST_ASSERT_EQUAL_UINT32( 0, xAfter.ulRequests - xBefore.ulRequests );
+                TEST_ASSERT_EQUAL_UINT32( 0, xAfter.ulOffers - xBefore.ulOffers );
+            #endif
+        }
+
+        vSimLinkSetDHCPServer( &xOriginal );
+        TEST_ASSERT_EQUAL_UINT32( xOriginal.ulOfferedAddress, FreeRTOS_GetIPAddress() );
+
+        configPRINTF( ( "DHCP time to IP, server supports rapid commit: average %u ms, worst %u ms over %d link flaps\r\n",
+                        ulTotalMS / tcpbenchmarkDHCP_ITERATIONS, ulWorstMS, tcpbenchmarkDHCP_ITERATIONS ) );
+        configPRINTF( ( "    rapid commit %s, %u messages per exchange\r\n",
+                        ( ipconfigDHCP_USE_RAPID_COMMIT != 0 ) ? "on" : "off",
+                        ( xAfter.ulDiscovers + xAfter.ulRequests + xAfter.ulOffers + xAfter.ulAcks ) / tcpbenchmarkDHCP_ITERATIONS ) );
+        prvPrintLinkStatistics();
+    }
+
+    #if ( ipconfigDHCP_ARP_PROBE != 0 )
+        TEST( Full_FREERTOS_TCP_BENCHMARK, DHCPAddressInUse )
+        {
+            /* Another host answers the ARP probe for the offered address, so
+             * the client must decline it instead of using it.  Once the other
+             * host is gone, the next exchange binds the address again. */
+            SimLinkDHCPServer_t xOriginal, xServer;
+            SimLinkDHCPStatistics_t xStatistics;
+            TickType_t xStart;
+
+            vSimLinkGetDHCPServer( &xOriginal );
+            memcpy( &xServer, &xOriginal, sizeof( xServer ) );
+            xServer.ulAddressInUse = xOriginal.ulOfferedAddress;
+            vSimLinkSetDHCPServer( &xServer );
+
+            xStart = xTaskGetTickCount();
+            FreeRTOS_NetworkDown();
+
+            do
+            {
+                vTaskDelay( 1 );
+                vSimLinkGetDHCPStatistics( &xStatistics );
+            } while( ( xStatistics.ulDeclines == 0UL ) && ( ( xTaskGetTickCount() - xStart ) < tcpbenchmarkTIMEOUT ) );
+
+            configPRINTF( ( "DHCP address in use: declined after %u ms\r\n",
+                            ( uint32_t ) ( ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS ) ) );
+
+            vSimLinkSetDHCPServer( &xOriginal );
+            TEST_ASSERT_GREATER_THAN( 0, xStatistics.ulDeclines );
+            TEST_ASSERT_FALSE( FreeRTOS_IsNetworkUp() );
+
+            /* The client starts again with a DISCOVER. */
+            xStart = xTaskGetTickCount();
+
+            while( ( FreeRTOS_IsNetworkUp() == pdFALSE ) && ( ( xTaskGetTickCount() - xStart ) < tcpbenchmarkTIMEOUT ) )
+            {
+                vTaskDelay( 1 );
+            }
+
+            TEST_ASSERT_TRUE( FreeRTOS_IsNetworkUp() );
+            TEST_ASSERT_EQUAL_UINT32( xOriginal.ulOfferedAddress, FreeRTOS_GetIPAddress() );
+            prvPrintLinkStatistics();
+        }
+    #endif /* if ( ipconfigDHCP_ARP_PROBE != 0 ) */
+#endif /* if ( ipconfigUSE_DHCP != 0 ) */
@@ -51,4 +51,37 @@ DocParseErr_t TEST_OTA_prvParseJSONbyModel( const char * pcJSON,
                                             uint32_t ulMsgLen,
                                             JSON_DocModel_t * pxDocModel );
 
+#if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+    void TEST_OTA_prvStreamWindowInit( OTA_FileContext_t * C );
+
+    uint32_t TEST_OTA_prvStreamWindowRequest( OTA_FileContext_t * C,
+                                              TickType_t xNow,
+                                              uint8_t * pucBitmap,
+                                              uint32_t * pulBitmapLen );
+
+    void TEST_OTA_prvStreamWindowReceived( OTA_FileContext_t * C,
+                                           uint32_t ulBlockIndex,
+                                           TickType_t xNow );
+#endif
+
+#if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+    void TEST_OTA_prvSignatureStart( OTA_FileContext_t * C );
+
+    void TEST_OTA_prvSignatureUpdate( OTA_FileContext_t * C,
+                                      uint32_t ulBlockIndex,
+                                      const uint8_t * pucData,
+                                      uint32_t ulBlockSize );
+
+    void TEST_OTA_prvSignatureStop( OTA_FileContext_t * C );
+#endif
+
+#if ( otaconfigENABLE_RESUME == 1 )
+    void TEST_OTA_prvResumeSave( OTA_FileContext_t * C );
+
+    bool_t TEST_OTA_prvResumeLoad( OTA_FileContext_t * C,
+                                   uint32_t ulBitmapLen );
+
+    void TEST_OTA_prvResumeErase( void );
+#endif
+
 #endif /* ifndef _AWS_OTA_AGENT_TEST_ACCESS_DECLARE_H_ */
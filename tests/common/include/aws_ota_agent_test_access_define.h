@@ -68,4 +68,88 @@ DocParseErr_t TEST_OTA_prvParseJSONbyModel( const char * pcJSON,
     return prvParseJSONbyModel( pcJSON, ulMsgLen, pxDocModel );
 }
 
+/*-----------------------------------------------------------*/
+
+#if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+
+    void TEST_OTA_prvStreamWindowInit( OTA_FileContext_t * C )
+    {
+        prvStreamWindowInit( C );
+    }
+
+/*-----------------------------------------------------------*/
+
+    uint32_t TEST_OTA_prvStreamWindowRequest( OTA_FileContext_t * C,
+                                              TickType_t xNow,
+                                              uint8_t * pucBitmap,
+                                              uint32_t * pulBitmapLen )
+    {
+        return prvStreamWindowRequest( C, xNow, pucBitmap, pulBitmapLen );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvStreamWindowReceived( OTA_FileContext_t * C,
+                                           uint32_t ulBlockIndex,
+                                           TickType_t xNow )
+    {
+        prvStreamWindowReceived( C, ulBlockIndex, xNow );
+    }
+
+#endif /* otaconfigENABLE_STREAM_WINDOW */
+
+/*-----------------------------------------------------------*/
+
+#if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+
+    void TEST_OTA_prvSignatureStart( OTA_FileContext_t * C )
+    {
+        prvSignatureStart( C );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvSignatureUpdate( OTA_FileContext_t * C,
+                                      uint32_t ulBlockIndex,
+                                      const uint8_t * pucData,
+                                      uint32_t ulBlockSize )
+    {
+        prvSignatureUpdate( C, ulBlockIndex, pucData, ulBlockSize );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvSignatureStop( OTA_FileContext_t * C )
+    {
+        prvSignatureStop( C );
+    }
+
+#endif /* otaconfigENABLE_STREAMING_SIGNATURE_CHECK */
+
+/*-----------------------------------------------------------*/
+
+#if ( otaconfigENABLE_RESUME == 1 )
+
+    void TEST_OTA_prvResumeSave( OTA_FileContext_t * C )
+    {
+        prvResumeSave( C );
+    }
+
+/*-----------------------------------------------------------*/
+
+    bool_t TEST_OTA_prvResumeLoad( OTA_FileContext_t * C,
+                                   uint32_t ulBitmapLen )
+    {
+        return prvResumeLoad( C, ulBitmapLen );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void TEST_OTA_prvResumeErase( void )
+    {
+        prvResumeErase();
+    }
+
+#endif /* otaconfigENABLE_RESUME */
+
 #endif /* _AWS_OTA_AGENT_TEST_ACCESS_DEFINE_H_ */
@@ -36,6 +36,9 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "aws_mqtt_agent.h"
+#include "aws_mqtt_agent_config.h"
+#include "aws_mqtt_agent_config_defaults.h"
+#include "aws_bufferpool_config.h"
 #include "task.h"
 #include "queue.h"
 #include "event_groups.h"
@@ -51,6 +54,19 @@
 #define mqttagenttestTOPIC_NAME    ( ( const uint8_t * ) "freertos/tests/echo" )
 
 #define mqttagenttestMESSAGE       "Hello from the test."
+
+/* Number of messages published by the asynchronous publish test. */
+#define mqttagenttestASYNC_PUBLISH_COUNT    ( 10 )
+
+/* Number of messages the asynchronous publish test keeps outstanding at once.
+ * Each outstanding QoS1 publish uses one of the mqttconfigMAX_ASYNC_PUBLISHES
+ * operations and holds a buffer of the buffer pool until its PUBACK, and the
+ * MQTT task needs a free buffer to receive the PUBACKs. */
+#if ( mqttconfigMAX_ASYNC_PUBLISHES < ( bufferpoolconfigNUM_BUFFERS - 1 ) )
+    #define mqttagenttestASYNC_PUBLISH_WINDOW    ( mqttconfigMAX_ASYNC_PUBLISHES )
+#else
+    #define mqttagenttestASYNC_PUBLISH_WINDOW    ( bufferpoolconfigNUM_BUFFERS - 1 )
+#endif
 #define mqttagenttestFAILUREPRINTF( x )    vLoggingPrintf x
 
 /* The parameters below are definable so the test can run on most target. */
@@ -224,6 +240,19 @@ static MQTTBool_t prvMQTTCallback( void * pvUserData,
     return eMQTTFalse;
 }
 
+/**
+ * @brief Completion callback of the asynchronous publish operations.
+ */
+static void prvPublishCompletionCallback( void * pvCompletionContext,
+                                          MQTTAgentReturnCode_t xReturnCode )
+{
+    /* Give the semaphore only for the successful operations. */
+    if( xReturnCode == eMQTTAgentSuccess )
+    {
+        xSemaphoreGive( ( SemaphoreHandle_t ) pvCompletionContext );
+    }
+}
+
 /*-----------------------------------------------------------*/
 
 
@@ -367,6 +396,7 @@ TEST_GROUP_RUNNER( Full_MQTT_Agent )
 {
     RUN_TEST_CASE( Full_MQTT_Agent, AFQP_MQTT_Agent_SubscribePublishDefaultPort );
     RUN_TEST_CASE( Full_MQTT_Agent, AFQP_MQTT_Agent_InvalidCredentials );
+    RUN_TEST_CASE( Full_MQTT_Agent, AFQP_MQTT_Agent_PublishAsync );
 }
 TEST_GROUP_RUNNER( Full_MQTT_Agent_Stress_Tests )
 {
@@ -442,6 +472,92 @@ TEST( Full_MQTT_Agent, AFQP_MQTT_Agent_InvalidCredentials )
 }
 /*-----------------------------------------------------------*/
 
+/* Test for keeping several QoS1 messages outstanding with asynchronous publishes. */
+TEST( Full_MQTT_Agent, AFQP_MQTT_Agent_PublishAsync )
+{
+    MQTTAgentReturnCode_t xReturned;
+    StaticSemaphore_t xSemaphoreBuffer;
+    SemaphoreHandle_t xSemaphore;
+    MQTTAgentHandle_t xMQTTHandle = NULL;
+    MQTTAgentPublishParams_t xPublishParameters;
+    BaseType_t xClientCreated = pdFALSE, xClientConnected = pdFALSE;
+    MQTTAgentConnectParams_t xConnectParameters;
+    uint32_t ulPublished = 0, ulCompleted;
+
+    memcpy( &xConnectParameters, &xDefaultConnectParameters, sizeof( MQTTAgentConnectParams_t ) );
+
+    /* Initialize the semaphore as unavailable. */
+    xSemaphore = xSemaphoreCreateCountingStatic( mqttagenttestASYNC_PUBLISH_COUNT, 0, &xSemaphoreBuffer );
+    TEST_ASSERT_NOT_NULL( xSemaphore );
+
+    if( TEST_PROTECT() )
+    {
+        /* Fill in the MQTTAgentConnectParams_t member that is not const. */
+        xConnectParameters.usClientIdLength = ( uint16_t ) strlen(
+            ( char * ) xConnectParameters.pucClientId );
+
+        /* The MQTT client object must be created before it can be used. */
+        xReturned = MQTT_AGENT_Create( &xMQTTHandle );
+        TEST_ASSERT_EQUAL_INT( xReturned, eMQTTAgentSuccess );
+        xClientCreated = pdTRUE;
+
+        /* Connect to the broker. */
+        xReturned = MQTT_AGENT_Connect( xMQTTHandle,
+                                        &xConnectParameters,
+                                        mqttagenttestTIMEOUT );
+        TEST_ASSERT_EQUAL_INT_MESSAGE( xReturned, eMQTTAgentSuccess, "Failed to connect to the MQTT broker with MQTT_AGENT_Connect()." );
+        xClientConnected = pdTRUE;
+
+        /* Setup the publish parameters. They must remain valid until
+         * all the operations complete. */
+        memset( &( xPublishParameters ), 0x00, sizeof( xPublishParameters ) );
+        xPublishParameters.pucTopic = mqttagenttestTOPIC_NAME;
+        xPublishParameters.pvData = mqttagenttestMESSAGE;
+        xPublishParameters.usTopicLength = ( uint16_t ) strlen( ( const char * ) mqttagenttestTOPIC_NAME );
+        xPublishParameters.ulDataLength = ( uint32_t ) strlen( mqttagenttestMESSAGE );
+        xPublishParameters.xQoS = eMQTTQoS1;
+
+        /* Publish the messages without waiting for the PUBACKs, keeping
+         * mqttagenttestASYNC_PUBLISH_WINDOW of them outstanding. A new
+         * message is published each time an operation completes. */
+        for( ulCompleted = 0; ulCompleted < mqttagenttestASYNC_PUBLISH_COUNT; ulCompleted++ )
+        {
+            while( ( ulPublished < mqttagenttestASYNC_PUBLISH_COUNT ) &&
+                   ( ( ulPublished - ulCompleted ) < mqttagenttestASYNC_PUBLISH_WINDOW ) )
+            {
+                xReturned = MQTT_AGENT_PublishAsync( xMQTTHandle,
+                                                     &( xPublishParameters ),
+                                                     prvPublishCompletionCallback,
+                                                     xSemaphore,
+                                                     mqttagenttestTIMEOUT );
+                TEST_ASSERT_EQUAL_INT( xReturned, eMQTTAgentSuccess );
+                ulPublished++;
+            }
+
+            /* Every operation must complete successfully. */
+            if( pdFALSE == xSemaphoreTake( xSemaphore, mqttagenttestTIMEOUT ) )
+            {
+                TEST_FAIL();
+            }
+        }
+    }
+
+    if( xClientConnected == pdTRUE )
+    {
+        xReturned = MQTT_AGENT_Disconnect( xMQTTHandle,
+                                           mqttagenttestTIMEOUT );
+        TEST_ASSERT_EQUAL_INT( xReturned, eMQTTAgentSuccess );
+    }
+
+    if( xClientCreated == pdTRUE )
+    {
+        /* Delete the MQTT client. */
+        xReturned = MQTT_AGENT_Delete( xMQTTHandle );
+        TEST_ASSERT_EQUAL_INT( xReturned, eMQTTAgentSuccess );
+    }
+}
+/*-----------------------------------------------------------*/
+
 /* Test for ping-ponging a message using AWS IoT MQTT broker support for port 443. */
 TEST( Full_MQTT_Agent_ALPN, MQTT_Agent_SubscribePublishAlpn )
 {
@@ -29,6 +29,7 @@
  */
 
 /* Standard includes. */
+#include <stdio.h>
 #include <string.h>
 
 /* Unity framework includes. */
@@ -37,6 +38,8 @@
 /* MQTT Lib includes. */
 #include "aws_mqtt_lib.h"
 #include "aws_mqtt_lib_test_access_declare.h"
+#include "aws_mqtt_inflight_store.h"
+#include "aws_mqtt_offline_spool.h"
 #include "aws_mqtt_agent_config.h"
 
 /* Bufferpool includes. */
@@ -70,15 +73,62 @@
  */
 #define testmqttlibOPERATION_TIMEOUT_TICKS    ( 1000 )
 
+/**
+ * @brief Packet ID of the publish messages sent by the tests.
+ */
+#define testmqttlibPUBLISH_PACKET_ID          ( 10 )
+
+/**
+ * @brief Packet ID of the QoS2 publish message received by the tests.
+ */
+#define testmqttlibRECEIVED_PACKET_ID         ( 20 )
+
+/**
+ * @brief Size of the memory of the in-flight store used by the tests.
+ */
+#define testmqttlibINFLIGHT_STORE_SIZE        ( 128 )
+
+/**
+ * @defgroup OfflineSpool Region of the offline spool used by the tests.
+ *
+ * Every message pushed by prvPushSpoolMessage takes a record of 20 bytes, so
+ * a block holds two of them.
+ */
+/** @{ */
+#define testmqttlibSPOOL_BLOCK_SIZE           ( 64 )
+#define testmqttlibSPOOL_BLOCK_COUNT          ( 4 )
+/** @} */
+
+/**
+ * @brief Length of the streamed publish messages received by the tests.
+ *
+ * Larger than the buffers of the buffer pool used by the tests.
+ */
+#define testmqttlibSTREAMED_PAYLOAD_LENGTH    ( 5000 )
+
+/**
+ * @brief Maximum length of a packet recorded by the send callback.
+ */
+#define testmqttlibMAX_SENT_PACKET_LENGTH     ( 64 )
+
 /**
  * @brief MQTT Control packet types.
  */
 #define mqttCONTROL_CONNACK                   ( ( uint8_t ) 2 << ( uint8_t ) 4 )
+#define mqttCONTROL_PUBLISH                   ( ( uint8_t ) 3 << ( uint8_t ) 4 )
+#define mqttCONTROL_PUBACK                    ( ( uint8_t ) 4 << ( uint8_t ) 4 )
+#define mqttCONTROL_PUBREC                    ( ( uint8_t ) 5 << ( uint8_t ) 4 )
+#define mqttCONTROL_PUBREL                    ( ( uint8_t ) 6 << ( uint8_t ) 4 )
+#define mqttCONTROL_PUBCOMP                   ( ( uint8_t ) 7 << ( uint8_t ) 4 )
 
 /**
  * @brief MQTT Control packet flags.
  */
-#define mqttFLAGS_CONNACK                     ( ( uint8_t ) 0 ) /**< Reserved. */
+#define mqttFLAGS_CONNACK                     ( ( uint8_t ) 0 )   /**< Reserved. */
+#define mqttFLAGS_PUBLISH_DUP                 ( ( uint8_t ) 8 )   /**< DUP flag of a publish message. */
+#define mqttFLAGS_PUBLISH_QOS1                ( ( uint8_t ) 2 )   /**< QoS1 flag of a publish message. */
+#define mqttFLAGS_PUBLISH_QOS2                ( ( uint8_t ) 4 )   /**< QoS2 flag of a publish message. */
+#define mqttFLAGS_PUBREL                      ( ( uint8_t ) 2 )   /**< Reserved. */
 /*-----------------------------------------------------------*/
 
 /**
@@ -90,6 +140,10 @@ typedef struct CallbackCounter
     uint32_t ulConnACK;           /**< Number of times the callback is invoked for CONNACK message. */
     uint32_t ulUnexpectedConnACK; /**< Number of times the callback is invoked for unexpected CONNACK messages. */
     uint32_t ulDisconnect;        /**< Number of times the callback is invoked for disconnect message. */
+    uint32_t ulPubACK;            /**< Number of times the callback is invoked for PUBACK message. */
+    uint32_t ulPubCOMP;           /**< Number of times the callback is invoked for PUBCOMP message. */
+    uint32_t ulPublish;           /**< Number of times the callback is invoked for received publish message. */
+    uint32_t ulPublishChunk;      /**< Number of times the callback is invoked for chunks of received publish messages. */
     uint32_t ulUnidentified;      /**< Number of times the callback is invoked for un-handled events. */
 } CallbackCounter_t;
 /*-----------------------------------------------------------*/
@@ -99,10 +153,59 @@ typedef struct CallbackCounter
  */
 static MQTTContext_t xMQTTContext;
 
+/**
+ * @brief Bit mask of the subscriptions whose publish callback was invoked.
+ *
+ * The callback context of a subscription is its bit in this mask.
+ */
+static uint32_t ulPublishCallbacksInvoked;
+
+/**
+ * @brief The subscription which takes the ownership of the MQTT buffer.
+ */
+static uint32_t ulPublishCallbackOwner;
+
 /**
  * @brief Callback counter used by all the tests.
  */
 static CallbackCounter_t xCallbackCounter;
+
+/**
+ * @brief The last packet passed to the send callback and its length.
+ */
+static uint8_t ucLastSentPacket[ testmqttlibMAX_SENT_PACKET_LENGTH ];
+static uint32_t ulLastSentPacketLength;
+
+/**
+ * @brief Number of times the send callback is invoked.
+ */
+static uint32_t ulSendCallbacksInvoked;
+
+/**
+ * @brief The streamed publish message reassembled from the chunks and the
+ * number of bytes received.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+    static uint8_t ucStreamedPayload[ testmqttlibSTREAMED_PAYLOAD_LENGTH ];
+    static uint32_t ulStreamedPayloadLength;
+#endif
+
+/**
+ * @brief The payload reported with the last PUBACK or PUBCOMP.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    static const void * pvLastAckedPublishData;
+#endif
+
+/**
+ * @brief The topic of the last received publish message and the reason code
+ * reported with the last PUBACK or PUBCOMP.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+    static uint8_t ucLastPublishTopic[ testmqttlibMAX_SENT_PACKET_LENGTH ];
+    static uint16_t usLastPublishTopicLength;
+    static uint8_t ucLastAckReasonCode;
+#endif
 /*-----------------------------------------------------------*/
 
 /**
@@ -129,7 +232,8 @@ static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
  * @brief The send callback registered with the MQTT library.
  *
  * This one mimics a successful send by returning ulDataLength
- * indicating that all the data was transmitted successfully.
+ * indicating that all the data was transmitted successfully. The data
+ * is recorded in ucLastSentPacket.
  *
  * @param[in] pvSendContext The send context as supplied in Init parameters.
  * @param[in] pucData The data to transmit.
@@ -158,6 +262,69 @@ static uint32_t prvSendFailedCallback( void * pvSendContext,
                                        const uint8_t * const pucData,
                                        uint32_t ulDataLength );
 
+/**
+ * @brief The send vectored callback registered with the MQTT library.
+ *
+ * This one mimics a successful send of all the parts. The parts are
+ * recorded one after the other in ucLastSentPacket.
+ *
+ * @param[in] pvSendContext The send context as supplied in Init parameters.
+ * @param[in] pxVectors The parts to transmit.
+ * @param[in] ulVectorCount The number of parts.
+ *
+ * @return The number of bytes actually transmitted.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    static uint32_t prvSendVectoredCallback( void * pvSendContext,
+                                             const MQTTSendVector_t * const pxVectors,
+                                             uint32_t ulVectorCount );
+#endif
+
+/**
+ * @brief The publish callback registered with the subscription manager.
+ *
+ * Records that the subscription with the given context was invoked.
+ *
+ * @param[in] pvPublishCallbackContext The bit of the subscription in
+ * ulPublishCallbacksInvoked.
+ * @param[in] pxPublishData The received publish message.
+ *
+ * @return eMQTTTrue if the subscription is ulPublishCallbackOwner, eMQTTFalse
+ * otherwise.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static MQTTBool_t prvPublishCallback( void * pvPublishCallbackContext,
+                                          const MQTTPublishData_t * const pxPublishData );
+#endif
+
+/**
+ * @brief Stores a subscription whose callback context is the given bit.
+ *
+ * @param[in] pcTopicFilter The topic filter.
+ * @param[in] ulBit The bit of the subscription in ulPublishCallbacksInvoked.
+ *
+ * @return The return value of prvStoreSubscription.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static MQTTBool_t prvStoreTestSubscription( const char * pcTopicFilter,
+                                                uint32_t ulBit );
+#endif
+
+/**
+ * @brief Dispatches a publish message received on the given topic to the
+ * subscriptions.
+ *
+ * @param[in] pcTopic The topic.
+ * @param[out] pxBufferOwnershipTaken The return value of
+ * prvInvokeSubscriptionCallbacks.
+ *
+ * @return The bit mask of the subscriptions whose callback was invoked.
+ */
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static uint32_t prvDispatchTestPublish( const char * pcTopic,
+                                            MQTTBool_t * pxBufferOwnershipTaken );
+#endif
+
 /**
  * @brief Initializes the global callback counter object.
  */
@@ -184,6 +351,100 @@ static MQTTReturnCode_t prvSendMQTTConnect( void );
  * @return The return value of MQTT_ParseReceivedData.
  */
 static MQTTReturnCode_t prvReceiveMQTTConnACK( void );
+
+/**
+ * @brief Sends a publish message by calling MQTT_Publish.
+ *
+ * @param[in] xQos The QoS of the message.
+ *
+ * @return The return value of MQTT_Publish.
+ */
+static MQTTReturnCode_t prvSendMQTTPublish( MQTTQoS_t xQos );
+
+/**
+ * @brief Mimics receiving a PUBACK, PUBREC, PUBREL or PUBCOMP message by
+ * passing it to MQTT_ParseReceivedData.
+ *
+ * @param[in] ucControlByte The first byte of the message.
+ * @param[in] usPacketIdentifier The packet identifier of the message.
+ *
+ * @return The return value of MQTT_ParseReceivedData.
+ */
+static MQTTReturnCode_t prvReceivePublishAck( uint8_t ucControlByte,
+                                              uint16_t usPacketIdentifier );
+
+/**
+ * @brief Mimics receiving a QoS2 publish message with the packet identifier
+ * testmqttlibRECEIVED_PACKET_ID by passing it to MQTT_ParseReceivedData.
+ *
+ * @return The return value of MQTT_ParseReceivedData.
+ */
+static MQTTReturnCode_t prvReceiveQoS2Publish( void );
+
+/**
+ * @brief Checks that the last packet sent is the given acknowledgment.
+ *
+ * @param[in] ucControlByte The expected first byte of the packet.
+ * @param[in] usPacketIdentifier The expected packet identifier.
+ */
+static void prvAssertLastSentAck( uint8_t ucControlByte,
+                                  uint16_t usPacketIdentifier );
+
+/**
+ * @brief Mimics receiving a publish message with a payload of
+ * testmqttlibSTREAMED_PAYLOAD_LENGTH bytes on the topic "a/b", by passing it
+ * to MQTT_ParseReceivedData in three parts.
+ *
+ * @param[in] ucFlags The QoS flags of the message.
+ * @param[in] usPacketIdentifier The packet identifier of the message.
+ * @param[in] ulFirstSplit The length of the first part. It ends in the
+ * middle of the topic for the values lower than 7.
+ * @param[in] ulSecondSplit The offset in the message where the third part
+ * starts.
+ */
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+    static void prvReceiveStreamedPublish( uint8_t ucFlags,
+                                           uint16_t usPacketIdentifier,
+                                           uint32_t ulFirstSplit,
+                                           uint32_t ulSecondSplit );
+#endif
+
+/**
+ * @brief Switches the context to MQTT 5, connects and mimics receiving a
+ * CONNACK which accepts 2 topic aliases.
+ *
+ * @param[in] usReceiveMaximum The Receive Maximum of the broker.
+ */
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+    static void prvConnectMQTT5( uint16_t usReceiveMaximum );
+#endif
+
+/**
+ * @brief Pushes the message with the given index to a spool. The topic is
+ * "t/" followed by the last digit of the index and the data is the index,
+ * twice.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] ulIndex The index of the message.
+ *
+ * @return The result of MQTT_OfflineSpoolPush.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static MQTTBool_t prvPushSpoolMessage( MQTTOfflineSpool_t * pxSpool,
+                                           uint32_t ulIndex );
+#endif
+
+/**
+ * @brief Checks that the oldest message of a spool is the one pushed by
+ * prvPushSpoolMessage with the given index.
+ *
+ * @param[in] pxSpool The spool.
+ * @param[in] ulIndex The index of the message.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static void prvCheckSpoolMessage( MQTTOfflineSpool_t * pxSpool,
+                                      uint32_t ulIndex );
+#endif
 /*-----------------------------------------------------------*/
 
 static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
@@ -213,6 +474,63 @@ static MQTTBool_t prvMQTTEventCallback( void * pvCallbackContext,
 
             break;
 
+        case eMQTTPubACK:
+            xCallbackCounter.ulPubACK += 1;
+
+            #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+                pvLastAckedPublishData = pxParams->u.xMQTTPubACKData.pvPublishData;
+            #endif
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                ucLastAckReasonCode = pxParams->u.xMQTTPubACKData.ucReasonCode;
+            #endif
+
+            break;
+
+        case eMQTTPubCOMP:
+            xCallbackCounter.ulPubCOMP += 1;
+
+            #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+                pvLastAckedPublishData = pxParams->u.xMQTTPubACKData.pvPublishData;
+            #endif
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                ucLastAckReasonCode = pxParams->u.xMQTTPubACKData.ucReasonCode;
+            #endif
+
+            break;
+
+        case eMQTTPublish:
+            xCallbackCounter.ulPublish += 1;
+
+            #if ( mqttconfigENABLE_MQTT5 == 1 )
+                usLastPublishTopicLength = pxParams->u.xPublishData.usTopicLength;
+
+                if( ( usLastPublishTopicLength > ( uint16_t ) 0 ) && ( usLastPublishTopicLength <= sizeof( ucLastPublishTopic ) ) )
+                {
+                    memcpy( ucLastPublishTopic, pxParams->u.xPublishData.pucTopic, usLastPublishTopicLength );
+                }
+            #endif
+
+            break;
+
+            #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+                case eMQTTPublishChunk:
+                    xCallbackCounter.ulPublishChunk += 1;
+
+                    /* The chunks must arrive in order, with the topic. */
+                    TEST_ASSERT_EQUAL_UINT32( ulStreamedPayloadLength, pxParams->u.xPublishChunkData.ulOffset );
+                    TEST_ASSERT_EQUAL_UINT32( testmqttlibSTREAMED_PAYLOAD_LENGTH, pxParams->u.xPublishChunkData.ulTotalDataLength );
+                    TEST_ASSERT_EQUAL_UINT16( 3, pxParams->u.xPublishChunkData.usTopicLength );
+                    TEST_ASSERT_EQUAL_MEMORY( "a/b", pxParams->u.xPublishChunkData.pucTopic, 3 );
+                    TEST_ASSERT_NOT_NULL( pxParams->u.xPublishChunkData.pvData );
+
+                    memcpy( &( ucStreamedPayload[ ulStreamedPayloadLength ] ), pxParams->u.xPublishChunkData.pvData, pxParams->u.xPublishChunkData.ulDataLength );
+                    ulStreamedPayloadLength += pxParams->u.xPublishChunkData.ulDataLength;
+
+                    break;
+            #endif
+
         default:
             xCallbackCounter.ulUnidentified += 1;
 
@@ -232,6 +550,15 @@ static uint32_t prvSendCallback( void * pvSendContext,
     /* Ensure that the correct context was supplied by the library. */
     TEST_ASSERT_EQUAL( pvSendContext, testmqttlibSEND_CONTEXT );
 
+    /* Record the packet for the tests to check. */
+    ulSendCallbacksInvoked += 1;
+    ulLastSentPacketLength = ulDataLength;
+
+    if( ulDataLength <= sizeof( ucLastSentPacket ) )
+    {
+        memcpy( ucLastSentPacket, pucData, ulDataLength );
+    }
+
     /* Mimic that everything was sent successfully. */
     return ulDataLength;
 }
@@ -249,12 +576,101 @@ static uint32_t prvSendFailedCallback( void * pvSendContext,
 }
 /*-----------------------------------------------------------*/
 
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+
+    static uint32_t prvSendVectoredCallback( void * pvSendContext,
+                                             const MQTTSendVector_t * const pxVectors,
+                                             uint32_t ulVectorCount )
+    {
+        uint32_t x;
+
+        /* Ensure that the correct context was supplied by the library. */
+        TEST_ASSERT_EQUAL( pvSendContext, testmqttlibSEND_CONTEXT );
+
+        /* Record the parts as one packet for the tests to check. */
+        ulSendCallbacksInvoked += 1;
+        ulLastSentPacketLength = 0;
+
+        for( x = 0; x < ulVectorCount; x++ )
+        {
+            if( ( ulLastSentPacketLength + pxVectors[ x ].ulDataLength ) <= sizeof( ucLastSentPacket ) )
+            {
+                memcpy( &( ucLastSentPacket[ ulLastSentPacketLength ] ), pxVectors[ x ].pucData, pxVectors[ x ].ulDataLength );
+            }
+
+            ulLastSentPacketLength += pxVectors[ x ].ulDataLength;
+        }
+
+        /* Mimic that everything was sent successfully. */
+        return ulLastSentPacketLength;
+    }
+
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static MQTTBool_t prvPublishCallback( void * pvPublishCallbackContext,
+                                          const MQTTPublishData_t * const pxPublishData )
+    {
+        uint32_t ulBit = ( uint32_t ) ( size_t ) pvPublishCallbackContext;
+
+        ( void ) pxPublishData;
+
+        /* Every subscription must be invoked at most once. */
+        TEST_ASSERT_EQUAL_UINT32( 0, ulPublishCallbacksInvoked & ulBit );
+        ulPublishCallbacksInvoked |= ulBit;
+
+        return ( ulBit == ulPublishCallbackOwner ) ? eMQTTTrue : eMQTTFalse;
+    }
+#endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static MQTTBool_t prvStoreTestSubscription( const char * pcTopicFilter,
+                                                uint32_t ulBit )
+    {
+        return Test_prvStoreSubscription( &( xMQTTContext ),
+                                          ( const uint8_t * ) pcTopicFilter,
+                                          ( uint16_t ) strlen( pcTopicFilter ),
+                                          ( void * ) ( size_t ) ulBit,
+                                          prvPublishCallback );
+    }
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+    static uint32_t prvDispatchTestPublish( const char * pcTopic,
+                                            MQTTBool_t * pxBufferOwnershipTaken )
+    {
+        MQTTPublishData_t xPublishData;
+        MQTTBool_t xCallbackInvoked;
+
+        memset( &( xPublishData ), 0x00, sizeof( xPublishData ) );
+        xPublishData.pucTopic = ( const uint8_t * ) pcTopic;
+        xPublishData.usTopicLength = ( uint16_t ) strlen( pcTopic );
+
+        ulPublishCallbacksInvoked = 0;
+        *pxBufferOwnershipTaken = Test_prvInvokeSubscriptionCallbacks( &( xMQTTContext ), &( xPublishData ), &( xCallbackInvoked ) );
+
+        /* The library must report whether any callback was invoked. */
+        TEST_ASSERT_EQUAL( ( ulPublishCallbacksInvoked != 0 ) ? eMQTTTrue : eMQTTFalse, xCallbackInvoked );
+
+        return ulPublishCallbacksInvoked;
+    }
+#endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+/*-----------------------------------------------------------*/
+
 static void prvInitializeCallbackCounter( void )
 {
     xCallbackCounter.ulConnACK = 0;
     xCallbackCounter.ulUnexpectedConnACK = 0;
     xCallbackCounter.ulDisconnect = 0;
+    xCallbackCounter.ulPubACK = 0;
+    xCallbackCounter.ulPubCOMP = 0;
+    xCallbackCounter.ulPublish = 0;
+    xCallbackCounter.ulPublishChunk = 0;
     xCallbackCounter.ulUnidentified = 0;
+    ulSendCallbacksInvoked = 0;
 }
 /*-----------------------------------------------------------*/
 
@@ -271,6 +687,15 @@ static MQTTReturnCode_t prvInitializeMQTTContext( void )
     xInitParams.pxGetTicksFxn = NULL;
     xInitParams.xBufferPoolInterface.pxGetBufferFxn = BUFFERPOOL_GetFreeBuffer;
     xInitParams.xBufferPoolInterface.pxReturnBufferFxn = BUFFERPOOL_ReturnBuffer;
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        xInitParams.pxInflightStore = NULL;
+    #endif
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        xInitParams.pxMQTTSendVectoredFxn = NULL;
+    #endif
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        xInitParams.xProtocolVersion = eMQTTProtocolVersion311;
+    #endif
 
     /* Initialize MQTT context. */
     xReturnCode = MQTT_Init( &( xMQTTContext ), &( xInitParams ) );
@@ -295,6 +720,7 @@ static MQTTReturnCode_t prvSendMQTTConnect( void )
     xConnectParams.ulKeepAliveActualIntervalTicks = mqttconfigKEEP_ALIVE_ACTUAL_INTERVAL_TICKS;
     xConnectParams.ulPingRequestTimeoutTicks = mqttconfigKEEP_ALIVE_TIMEOUT_TICKS;
     xConnectParams.ulTimeoutTicks = testmqttlibOPERATION_TIMEOUT_TICKS;
+    xConnectParams.xPersistentSession = eMQTTFalse;
 
     /* Send MQTT Connect. */
     xReturnCode = MQTT_Connect( &( xMQTTContext ), &( xConnectParams ) );
@@ -323,6 +749,179 @@ static MQTTReturnCode_t prvReceiveMQTTConnACK( void )
 }
 /*-----------------------------------------------------------*/
 
+static MQTTReturnCode_t prvSendMQTTPublish( MQTTQoS_t xQos )
+{
+    MQTTPublishParams_t xPublishParams;
+    static const char cPayload[] = "payload";
+
+    /* Setup publish parameters. */
+    xPublishParams.pucTopic = ( const uint8_t * ) "a/b";
+    xPublishParams.usTopicLength = ( uint16_t ) ( strlen( ( const char * ) xPublishParams.pucTopic ) );
+    xPublishParams.xQos = xQos;
+    xPublishParams.pvData = cPayload;
+    xPublishParams.ulDataLength = ( uint32_t ) strlen( cPayload );
+    xPublishParams.usPacketIdentifier = ( uint16_t ) testmqttlibPUBLISH_PACKET_ID;
+    xPublishParams.ulTimeoutTicks = testmqttlibOPERATION_TIMEOUT_TICKS;
+
+    /* Send MQTT Publish. */
+    return MQTT_Publish( &( xMQTTContext ), &( xPublishParams ) );
+}
+/*-----------------------------------------------------------*/
+
+static MQTTReturnCode_t prvReceivePublishAck( uint8_t ucControlByte,
+                                              uint16_t usPacketIdentifier )
+{
+    uint8_t ucAckMessage[ 4 ];
+
+    ucAckMessage[ 0 ] = ucControlByte;                       /* Fixed header control packet type. */
+    ucAckMessage[ 1 ] = 2;                                   /* Fixed header remaining length - always 2. */
+    ucAckMessage[ 2 ] = ( uint8_t ) ( usPacketIdentifier >> 8 ); /* Packet identifier MSB. */
+    ucAckMessage[ 3 ] = ( uint8_t ) ( usPacketIdentifier );      /* Packet identifier LSB. */
+
+    return MQTT_ParseReceivedData( &( xMQTTContext ), ucAckMessage, sizeof( ucAckMessage ) );
+}
+/*-----------------------------------------------------------*/
+
+static MQTTReturnCode_t prvReceiveQoS2Publish( void )
+{
+    static const uint8_t ucPublishMessage[] =
+    {
+        mqttCONTROL_PUBLISH | mqttFLAGS_PUBLISH_QOS2, /* Fixed header control packet type. */
+        8,                                            /* Fixed header remaining length. */
+        0, 3, 'a', '/', 'b',                          /* Topic. */
+        0, testmqttlibRECEIVED_PACKET_ID,             /* Packet identifier. */
+        'x'                                           /* Payload. */
+    };
+
+    return MQTT_ParseReceivedData( &( xMQTTContext ), ucPublishMessage, sizeof( ucPublishMessage ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvAssertLastSentAck( uint8_t ucControlByte,
+                                  uint16_t usPacketIdentifier )
+{
+    TEST_ASSERT_EQUAL_UINT32( 4, ulLastSentPacketLength );
+    TEST_ASSERT_EQUAL_UINT8( ucControlByte, ucLastSentPacket[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT8( 2, ucLastSentPacket[ 1 ] );
+    TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) ( usPacketIdentifier >> 8 ), ucLastSentPacket[ 2 ] );
+    TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) ( usPacketIdentifier ), ucLastSentPacket[ 3 ] );
+}
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+
+    static void prvReceiveStreamedPublish( uint8_t ucFlags,
+                                           uint16_t usPacketIdentifier,
+                                           uint32_t ulFirstSplit,
+                                           uint32_t ulSecondSplit )
+    {
+        static uint8_t ucPublishMessage[ 11 + testmqttlibSTREAMED_PAYLOAD_LENGTH ];
+        uint32_t x, ulLength = 0, ulRemainingLength;
+
+        ulRemainingLength = 5 + ( ( ucFlags != 0 ) ? 2 : 0 ) + testmqttlibSTREAMED_PAYLOAD_LENGTH;
+
+        ucPublishMessage[ ulLength++ ] = mqttCONTROL_PUBLISH | ucFlags;                  /* Fixed header control packet type. */
+        ucPublishMessage[ ulLength++ ] = ( uint8_t ) ( ( ulRemainingLength & 0x7F ) | 0x80 ); /* Fixed header remaining length. */
+        ucPublishMessage[ ulLength++ ] = ( uint8_t ) ( ulRemainingLength >> 7 );
+        ucPublishMessage[ ulLength++ ] = 0;                                              /* Topic. */
+        ucPublishMessage[ ulLength++ ] = 3;
+        ucPublishMessage[ ulLength++ ] = 'a';
+        ucPublishMessage[ ulLength++ ] = '/';
+        ucPublishMessage[ ulLength++ ] = 'b';
+
+        if( ucFlags != 0 )
+        {
+            ucPublishMessage[ ulLength++ ] = ( uint8_t ) ( usPacketIdentifier >> 8 ); /* Packet identifier. */
+            ucPublishMessage[ ulLength++ ] = ( uint8_t ) ( usPacketIdentifier );
+        }
+
+        for( x = 0; x < testmqttlibSTREAMED_PAYLOAD_LENGTH; x++ )
+        {
+            ucPublishMessage[ ulLength++ ] = ( uint8_t ) ( x * 7 ); /* Payload. */
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), ucPublishMessage, ulFirstSplit ) );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), &( ucPublishMessage[ ulFirstSplit ] ), ulSecondSplit - ulFirstSplit ) );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), &( ucPublishMessage[ ulSecondSplit ] ), ulLength - ulSecondSplit ) );
+    }
+
+#endif /* mqttconfigENABLE_STREAMING_RECEIVE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_MQTT5 == 1 )
+
+    static void prvConnectMQTT5( uint16_t usReceiveMaximum )
+    {
+        uint8_t ucConnACKMessage[] =
+        {
+            mqttCONTROL_CONNACK | mqttFLAGS_CONNACK, /* Fixed header control packet type. */
+            9,                                       /* Fixed header remaining length. */
+            0,                                       /* Bit 0 is SP - Session Present. */
+            0,                                       /* Reason code. */
+            6,                                       /* Properties length. */
+            0x21, 0, 0,                              /* Receive Maximum. */
+            0x22, 0, 2                               /* Topic Alias Maximum. */
+        };
+
+        ucConnACKMessage[ 6 ] = ( uint8_t ) ( usReceiveMaximum >> 8 );
+        ucConnACKMessage[ 7 ] = ( uint8_t ) ( usReceiveMaximum );
+
+        xMQTTContext.xProtocolVersion = eMQTTProtocolVersion5;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), ucConnACKMessage, sizeof( ucConnACKMessage ) ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulConnACK );
+        TEST_ASSERT_EQUAL( eMQTTConnected, xMQTTContext.xConnectionState );
+    }
+
+#endif /* mqttconfigENABLE_MQTT5 */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static MQTTBool_t prvPushSpoolMessage( MQTTOfflineSpool_t * pxSpool,
+                                           uint32_t ulIndex )
+    {
+        uint8_t ucTopic[ 3 ] = { 't', '/', '0' };
+        uint32_t ulData[ 2 ] = { ulIndex, ulIndex };
+        MQTTPublishParams_t xPublishParams;
+
+        ucTopic[ 2 ] = ( uint8_t ) ( '0' + ( ulIndex % 10 ) );
+
+        xPublishParams.pucTopic = ucTopic;
+        xPublishParams.usTopicLength = ( uint16_t ) sizeof( ucTopic );
+        xPublishParams.xQos = ( MQTTQoS_t ) ( ulIndex % 3 );
+        xPublishParams.pvData = ulData;
+        xPublishParams.ulDataLength = ( uint32_t ) sizeof( ulData );
+
+        return MQTT_OfflineSpoolPush( pxSpool, &( xPublishParams ) );
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+
+    static void prvCheckSpoolMessage( MQTTOfflineSpool_t * pxSpool,
+                                      uint32_t ulIndex )
+    {
+        uint8_t ucBuffer[ 32 ];
+        uint32_t ulData[ 2 ];
+        MQTTPublishParams_t xPublishParams;
+
+        TEST_ASSERT_EQUAL( eMQTTTrue, MQTT_OfflineSpoolPeek( pxSpool, ucBuffer, sizeof( ucBuffer ), &( xPublishParams ) ) );
+        TEST_ASSERT_EQUAL_UINT16( 3, xPublishParams.usTopicLength );
+        TEST_ASSERT_EQUAL_UINT8( '0' + ( ulIndex % 10 ), xPublishParams.pucTopic[ 2 ] );
+        TEST_ASSERT_EQUAL( ( MQTTQoS_t ) ( ulIndex % 3 ), xPublishParams.xQos );
+        TEST_ASSERT_EQUAL_UINT32( sizeof( ulData ), xPublishParams.ulDataLength );
+
+        memcpy( ulData, xPublishParams.pvData, sizeof( ulData ) );
+        TEST_ASSERT_EQUAL_UINT32( ulIndex, ulData[ 0 ] );
+        TEST_ASSERT_EQUAL_UINT32( ulIndex, ulData[ 1 ] );
+    }
+
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
 /* Define Test Group. */
 TEST_GROUP( Full_MQTT );
 /*-----------------------------------------------------------*/
@@ -366,6 +965,12 @@ TEST_GROUP_RUNNER( Full_MQTT )
     RUN_TEST_CASE( Full_MQTT, AFQP_prvDoesTopicMatchTopicFilter_MatchCases );
     RUN_TEST_CASE( Full_MQTT, AFQP_prvDoesTopicMatchTopicFilter_NotMatchCases );
 
+    /* Subscription manager tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_SubscriptionManager_DispatchCases );
+    RUN_TEST_CASE( Full_MQTT, AFQP_SubscriptionManager_BufferOwnershipTaken );
+    RUN_TEST_CASE( Full_MQTT, AFQP_SubscriptionManager_RemoveAndReplace );
+    RUN_TEST_CASE( Full_MQTT, AFQP_SubscriptionManager_PoolExhausted );
+
     /* MQTT_Init tests. */
     RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Init_HappyCase );
     RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Init_NULLParams );
@@ -381,6 +986,36 @@ TEST_GROUP_RUNNER( Full_MQTT )
     RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Connect_SecondConnectWhileAlreadyConnected );
     RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Connect_SecondConnectWhileWaitingForConnACK );
     RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Connect_NetworkSendFailed );
+
+    /* QoS2 tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Publish_QoS2HappyCase );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_Publish_QoS2DuplicatePUBREC );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_ReceivePublish_QoS2Duplicate );
+
+    /* In-flight store tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_InflightStore_ResendOnReconnect );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_InflightStore_QoS2ResendsPUBREL );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_InflightRingStore_WrapAndReattach );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_InflightFlashStore_RemoveOutOfOrderAndRecover );
+
+    /* Zero-copy publish tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_PublishZeroCopy_SameBytesAsPublish );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_PublishZeroCopy_WithoutSendVectored );
+
+    /* Streaming receive tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_ReceivePublish_StreamedInChunks );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_ReceivePublish_StreamedQoS2Duplicate );
+
+    /* MQTT 5 tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT5_Connect_SendsProperties );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT5_Publish_ReusesTopicAlias );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT5_ReceivePublish_ResolvesTopicAlias );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT5_Publish_ReceiveMaximumExceeded );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT5_Publish_RefusedPUBREC );
+
+    /* Offline spool tests. */
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_OfflineSpool_WrapAndRecover );
+    RUN_TEST_CASE( Full_MQTT, AFQP_MQTT_OfflineSpool_SkipsTornRecord );
 }
 /*-----------------------------------------------------------*/
 
@@ -698,6 +1333,162 @@ TEST( Full_MQTT, AFQP_prvDoesTopicMatchTopicFilter_NotMatchCases )
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Publish messages are dispatched to all the subscriptions whose topic
+ * filter matches the topic.
+ */
+TEST( Full_MQTT, AFQP_SubscriptionManager_DispatchCases )
+{
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+        MQTTBool_t xBufferOwnershipTaken;
+
+        ulPublishCallbackOwner = 0;
+
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/iot/shadow", 0x01 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/+/shadow", 0x02 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/#", 0x04 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/iot/+", 0x08 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "+/iot/shadow/#", 0x10 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/thing", 0x20 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/+", 0x40 ) );
+
+        /* Exact and wild-card matches. */
+        TEST_ASSERT_EQUAL_HEX32( 0x1F, prvDispatchTestPublish( "aws/iot/shadow", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL( eMQTTFalse, xBufferOwnershipTaken );
+
+        /* "aws/#" also matches "aws" but "aws/+" does not. */
+        TEST_ASSERT_EQUAL_HEX32( 0x04, prvDispatchTestPublish( "aws", &( xBufferOwnershipTaken ) ) );
+
+        /* "aws/+" matches the empty level of "aws/". */
+        TEST_ASSERT_EQUAL_HEX32( 0x44, prvDispatchTestPublish( "aws/", &( xBufferOwnershipTaken ) ) );
+
+        /* '+' matches exactly one level. */
+        TEST_ASSERT_EQUAL_HEX32( 0x64, prvDispatchTestPublish( "aws/thing", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL_HEX32( 0x0C, prvDispatchTestPublish( "aws/iot/update", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL_HEX32( 0x14, prvDispatchTestPublish( "aws/iot/shadow/get", &( xBufferOwnershipTaken ) ) );
+
+        /* Topics which do not match any subscription. */
+        TEST_ASSERT_EQUAL_HEX32( 0x00, prvDispatchTestPublish( "iot", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL_HEX32( 0x00, prvDispatchTestPublish( "AWS/thing", &( xBufferOwnershipTaken ) ) );
+
+        /* A '+' level on its own matches any first level. */
+        TEST_ASSERT_EQUAL_HEX32( 0x10, prvDispatchTestPublish( "iot/iot/shadow", &( xBufferOwnershipTaken ) ) );
+    #endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief No more callbacks are invoked once one of them takes the ownership of
+ * the MQTT buffer.
+ */
+TEST( Full_MQTT, AFQP_SubscriptionManager_BufferOwnershipTaken )
+{
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+        MQTTBool_t xBufferOwnershipTaken;
+
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/iot/shadow", 0x01 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "aws/#", 0x02 ) );
+
+        /* The exact match is invoked first. */
+        ulPublishCallbackOwner = 0x01;
+        TEST_ASSERT_EQUAL_HEX32( 0x01, prvDispatchTestPublish( "aws/iot/shadow", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, xBufferOwnershipTaken );
+
+        ulPublishCallbackOwner = 0x02;
+        TEST_ASSERT_EQUAL_HEX32( 0x03, prvDispatchTestPublish( "aws/iot/shadow", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, xBufferOwnershipTaken );
+    #endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Removing subscriptions returns their levels to the pools, and
+ * subscribing to the same topic filter again replaces the subscription.
+ */
+TEST( Full_MQTT, AFQP_SubscriptionManager_RemoveAndReplace )
+{
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+        MQTTBool_t xBufferOwnershipTaken;
+        static const char * const pcTopicFilters[] = { "a/b/c", "a/b/d", "a/+/c", "a/#", "b/b/b" };
+        uint32_t x;
+
+        ulPublishCallbackOwner = 0;
+
+        for( x = 0; x < sizeof( pcTopicFilters ) / sizeof( pcTopicFilters[ 0 ] ); x++ )
+        {
+            TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( pcTopicFilters[ x ], ( uint32_t ) 1 << x ) );
+        }
+
+        /* Subscribing again replaces the callback context. */
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvStoreTestSubscription( "a/b/c", 0x80 ) );
+        TEST_ASSERT_EQUAL_UINT32( 5, xMQTTContext.xSubscriptionManager.ulInUseSubscriptions );
+        TEST_ASSERT_EQUAL_HEX32( 0x8C, prvDispatchTestPublish( "a/b/c", &( xBufferOwnershipTaken ) ) );
+
+        /* Removing one subscription leaves the ones sharing its levels. */
+        Test_prvRemoveSubscription( &( xMQTTContext ), ( const uint8_t * ) "a/b/c", ( uint16_t ) strlen( "a/b/c" ) );
+        TEST_ASSERT_EQUAL_HEX32( 0x0C, prvDispatchTestPublish( "a/b/c", &( xBufferOwnershipTaken ) ) );
+        TEST_ASSERT_EQUAL_HEX32( 0x0A, prvDispatchTestPublish( "a/b/d", &( xBufferOwnershipTaken ) ) );
+
+        /* Removing a topic filter which is not subscribed does nothing. */
+        Test_prvRemoveSubscription( &( xMQTTContext ), ( const uint8_t * ) "a/b", ( uint16_t ) strlen( "a/b" ) );
+        TEST_ASSERT_EQUAL_UINT32( 4, xMQTTContext.xSubscriptionManager.ulInUseSubscriptions );
+
+        for( x = 1; x < sizeof( pcTopicFilters ) / sizeof( pcTopicFilters[ 0 ] ); x++ )
+        {
+            Test_prvRemoveSubscription( &( xMQTTContext ), ( const uint8_t * ) pcTopicFilters[ x ], ( uint16_t ) strlen( pcTopicFilters[ x ] ) );
+        }
+
+        /* All the levels and names are released. */
+        TEST_ASSERT_EQUAL_UINT32( 0, xMQTTContext.xSubscriptionManager.ulInUseSubscriptions );
+        TEST_ASSERT_EQUAL_UINT16( 0, xMQTTContext.xSubscriptionManager.usStringPoolUsed );
+        TEST_ASSERT_EQUAL_HEX16( 0xFFFF, xMQTTContext.xSubscriptionManager.usRootPlusChild );
+        TEST_ASSERT_EQUAL_HEX16( 0xFFFF, xMQTTContext.xSubscriptionManager.usRootHashChild );
+        TEST_ASSERT_EQUAL_HEX32( 0x00, prvDispatchTestPublish( "a/b/d", &( xBufferOwnershipTaken ) ) );
+    #endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A subscription which does not fit in the pools is rejected without
+ * affecting the stored ones.
+ */
+TEST( Full_MQTT, AFQP_SubscriptionManager_PoolExhausted )
+{
+    #if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 )
+        MQTTBool_t xBufferOwnershipTaken;
+        char cTopicFilter[ 32 ];
+        uint32_t x;
+        uint16_t usStringPoolUsed;
+
+        ulPublishCallbackOwner = 0;
+
+        /* Every topic filter takes three levels of its own. */
+        for( x = 0; x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES; x++ )
+        {
+            ( void ) snprintf( cTopicFilter, sizeof( cTopicFilter ), "dev%u/cmd/+", ( unsigned ) x );
+            usStringPoolUsed = xMQTTContext.xSubscriptionManager.usStringPoolUsed;
+
+            if( prvStoreTestSubscription( cTopicFilter, 0x01 ) == eMQTTFalse )
+            {
+                break;
+            }
+        }
+
+        /* The pools hold at least the configured number of subscriptions. */
+        TEST_ASSERT_TRUE( x >= ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS );
+        TEST_ASSERT_TRUE( x < ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES );
+        TEST_ASSERT_EQUAL_UINT32( x, xMQTTContext.xSubscriptionManager.ulInUseSubscriptions );
+
+        /* The levels added for the rejected topic filter are released. */
+        TEST_ASSERT_EQUAL_UINT16( usStringPoolUsed, xMQTTContext.xSubscriptionManager.usStringPoolUsed );
+        TEST_ASSERT_EQUAL_HEX32( 0x00, prvDispatchTestPublish( cTopicFilter, &( xBufferOwnershipTaken ) ) );
+
+        /* The stored subscriptions still work. */
+        TEST_ASSERT_EQUAL_HEX32( 0x01, prvDispatchTestPublish( "dev0/cmd/reboot", &( xBufferOwnershipTaken ) ) );
+    #endif /* if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
 /**
  * @brief MQTT context initialization happy case.
  */
@@ -728,6 +1519,15 @@ TEST( Full_MQTT, AFQP_MQTT_Init_NULLParams )
     xInitParams.pxGetTicksFxn = NULL;
     xInitParams.xBufferPoolInterface.pxGetBufferFxn = BUFFERPOOL_GetFreeBuffer;
     xInitParams.xBufferPoolInterface.pxReturnBufferFxn = BUFFERPOOL_ReturnBuffer;
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        xInitParams.pxInflightStore = NULL;
+    #endif
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        xInitParams.pxMQTTSendVectoredFxn = NULL;
+    #endif
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        xInitParams.xProtocolVersion = eMQTTProtocolVersion311;
+    #endif
 
     if( TEST_PROTECT() )
     {
@@ -1075,3 +1875,777 @@ TEST( Full_MQTT, AFQP_MQTT_Connect_NetworkSendFailed )
     TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulUnidentified );
 }
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief QoS2 publish - PUBREC is answered with PUBREL and PUBCOMP completes
+ * the operation.
+ */
+TEST( Full_MQTT, AFQP_MQTT_Publish_QoS2HappyCase )
+{
+    /* Connect. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+    /* Publish a QoS2 message. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS2 ) );
+    TEST_ASSERT_EQUAL_UINT8( mqttCONTROL_PUBLISH | mqttFLAGS_PUBLISH_QOS2, ucLastSentPacket[ 0 ] );
+
+    /* PUBREC must be answered with PUBREL. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+    prvAssertLastSentAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibPUBLISH_PACKET_ID );
+    TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulPubCOMP );
+
+    /* PUBCOMP completes the publish operation. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBCOMP, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+
+    /* A second PUBCOMP is unexpected. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBCOMP, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+
+    /* The connection must be intact. */
+    TEST_ASSERT_EQUAL( eMQTTConnected, xMQTTContext.xConnectionState );
+    TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulDisconnect );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief QoS2 publish - A re-transmitted PUBREC is answered with the same
+ * PUBREL and PUBREC is ignored for QoS1 messages.
+ */
+TEST( Full_MQTT, AFQP_MQTT_Publish_QoS2DuplicatePUBREC )
+{
+    /* Connect. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+    /* PUBREC for a QoS1 message is unexpected and not answered. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS1 ) );
+    ulLastSentPacketLength = 0;
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, ulLastSentPacketLength );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubACK );
+
+    /* Every PUBREC for a QoS2 message is answered with PUBREL. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS2 ) );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+    prvAssertLastSentAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibPUBLISH_PACKET_ID );
+    ulLastSentPacketLength = 0;
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+    prvAssertLastSentAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibPUBLISH_PACKET_ID );
+
+    /* PUBACK does not complete a QoS2 publish. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubACK );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBCOMP, testmqttlibPUBLISH_PACKET_ID ) );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief QoS2 publish received - A re-transmission is acknowledged but not
+ * delivered again until the broker releases the message.
+ */
+TEST( Full_MQTT, AFQP_MQTT_ReceivePublish_QoS2Duplicate )
+{
+    /* Connect. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+    /* The message is delivered and acknowledged with PUBREC. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveQoS2Publish() );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPublish );
+    prvAssertLastSentAck( mqttCONTROL_PUBREC, testmqttlibRECEIVED_PACKET_ID );
+
+    /* The re-transmission is only acknowledged. */
+    ulLastSentPacketLength = 0;
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveQoS2Publish() );
+    TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPublish );
+    prvAssertLastSentAck( mqttCONTROL_PUBREC, testmqttlibRECEIVED_PACKET_ID );
+
+    /* PUBREL is answered with PUBCOMP, even when repeated. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibRECEIVED_PACKET_ID ) );
+    prvAssertLastSentAck( mqttCONTROL_PUBCOMP, testmqttlibRECEIVED_PACKET_ID );
+    ulLastSentPacketLength = 0;
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibRECEIVED_PACKET_ID ) );
+    prvAssertLastSentAck( mqttCONTROL_PUBCOMP, testmqttlibRECEIVED_PACKET_ID );
+
+    /* Once released, the packet identifier can be used for a new message. */
+    TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveQoS2Publish() );
+    TEST_ASSERT_EQUAL( 2, xCallbackCounter.ulPublish );
+
+    /* No other callback must have been invoked. */
+    TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulUnidentified );
+    TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulDisconnect );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief In-flight store - A QoS1 message not acknowledged before the
+ * connection is lost is re-transmitted as duplicate on the next connection.
+ */
+TEST( Full_MQTT, AFQP_MQTT_InflightStore_ResendOnReconnect )
+{
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        static uint8_t ucStorage[ testmqttlibINFLIGHT_STORE_SIZE ];
+        MQTTInflightRingStore_t xStore;
+        uint16_t usPacketIdentifier;
+        const uint8_t * pucPacket;
+        uint32_t ulPacketLength;
+
+        memset( ucStorage, 0x00, sizeof( ucStorage ) );
+        xMQTTContext.pxInflightStore = MQTT_InflightRingStoreInit( &( xStore ), ucStorage, sizeof( ucStorage ), testmqttlibOPERATION_TIMEOUT_TICKS );
+
+        /* Connect and publish a QoS1 message. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS1 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, xStore.xInterface.pxGetFxn( &( xStore ), 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+        TEST_ASSERT_EQUAL_UINT16( testmqttlibPUBLISH_PACKET_ID, usPacketIdentifier );
+
+        /* Lose the connection and connect again. */
+        Test_prvResetMQTTContext( &( xMQTTContext ) );
+        ulLastSentPacketLength = 0;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+        /* The message must have been re-transmitted as duplicate. */
+        TEST_ASSERT_EQUAL_UINT32( ulPacketLength, ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL_UINT8( pucPacket[ 0 ] | mqttFLAGS_PUBLISH_DUP, ucLastSentPacket[ 0 ] );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( &( pucPacket[ 1 ] ), &( ucLastSentPacket[ 1 ] ), ulPacketLength - 1 );
+
+        /* PUBACK removes it from the store. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubACK );
+        TEST_ASSERT_EQUAL( eMQTTFalse, xStore.xInterface.pxGetFxn( &( xStore ), 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+    #endif /* if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief In-flight store - Once PUBREC is received, the PUBREL replaces the
+ * QoS2 message in the store and is re-transmitted on the next connection.
+ */
+TEST( Full_MQTT, AFQP_MQTT_InflightStore_QoS2ResendsPUBREL )
+{
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        static uint8_t ucStorage[ testmqttlibINFLIGHT_STORE_SIZE ];
+        MQTTInflightRingStore_t xStore;
+        uint16_t usPacketIdentifier;
+        const uint8_t * pucPacket;
+        uint32_t ulPacketLength;
+
+        memset( ucStorage, 0x00, sizeof( ucStorage ) );
+        xMQTTContext.pxInflightStore = MQTT_InflightRingStoreInit( &( xStore ), ucStorage, sizeof( ucStorage ), testmqttlibOPERATION_TIMEOUT_TICKS );
+
+        /* Connect, publish a QoS2 message and receive PUBREC. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS2 ) );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+
+        /* Only the PUBREL must be in the store. */
+        TEST_ASSERT_EQUAL( eMQTTTrue, xStore.xInterface.pxGetFxn( &( xStore ), 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+        TEST_ASSERT_EQUAL_UINT32( 4, ulPacketLength );
+        TEST_ASSERT_EQUAL_UINT8( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, pucPacket[ 0 ] );
+        TEST_ASSERT_EQUAL( eMQTTFalse, xStore.xInterface.pxGetFxn( &( xStore ), 1, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+
+        /* Lose the connection and connect again - the PUBREL is
+         * re-transmitted as it is. */
+        Test_prvResetMQTTContext( &( xMQTTContext ) );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+        prvAssertLastSentAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibPUBLISH_PACKET_ID );
+
+        /* PUBCOMP completes the exchange and empties the store. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBCOMP, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+        TEST_ASSERT_EQUAL( eMQTTFalse, xStore.xInterface.pxGetFxn( &( xStore ), 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+    #endif /* if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief In-flight ring store - Records wrap around the end of the memory,
+ * a full store rejects new packets and the packets survive a re-init.
+ */
+TEST( Full_MQTT, AFQP_MQTT_InflightRingStore_WrapAndReattach )
+{
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 )
+        static uint8_t ucStorage[ testmqttlibINFLIGHT_STORE_SIZE ];
+        uint8_t ucPacket[ 30 ];
+        MQTTInflightRingStore_t xStore;
+        const MQTTInflightStoreInterface_t * pxInterface;
+        uint16_t usPacketIdentifier, x;
+        const uint8_t * pucPacket;
+        uint32_t ulPacketLength;
+
+        memset( ucStorage, 0xFF, sizeof( ucStorage ) );
+        pxInterface = MQTT_InflightRingStoreInit( &( xStore ), ucStorage, sizeof( ucStorage ), testmqttlibOPERATION_TIMEOUT_TICKS );
+
+        /* Fill the store - every packet takes 40 bytes. */
+        for( x = 1; x <= 10; x++ )
+        {
+            memset( ucPacket, ( int ) x, sizeof( ucPacket ) );
+
+            if( pxInterface->pxPutFxn( pxInterface->pvStoreContext, x, ucPacket, sizeof( ucPacket ) ) == eMQTTFalse )
+            {
+                break;
+            }
+        }
+
+        TEST_ASSERT_TRUE( x > 1 );
+        TEST_ASSERT_TRUE( x <= 10 );
+
+        /* Remove the oldest packet to make room at the start for one
+         * more, which therefore wraps around. */
+        pxInterface->pxRemoveFxn( pxInterface->pvStoreContext, 1 );
+        memset( ucPacket, ( int ) x, sizeof( ucPacket ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxPutFxn( pxInterface->pvStoreContext, x, ucPacket, sizeof( ucPacket ) ) );
+
+        /* Re-initializing keeps the packets, in the order they were stored. */
+        pxInterface = MQTT_InflightRingStoreInit( &( xStore ), ucStorage, sizeof( ucStorage ), testmqttlibOPERATION_TIMEOUT_TICKS );
+
+        for( usPacketIdentifier = 2; usPacketIdentifier <= x; usPacketIdentifier++ )
+        {
+            uint16_t usStoredPacketIdentifier;
+
+            TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxGetFxn( pxInterface->pvStoreContext,
+                                                                 ( uint32_t ) usPacketIdentifier - 2,
+                                                                 &( usStoredPacketIdentifier ),
+                                                                 &( pucPacket ),
+                                                                 &( ulPacketLength ) ) );
+            TEST_ASSERT_EQUAL_UINT16( usPacketIdentifier, usStoredPacketIdentifier );
+            TEST_ASSERT_EQUAL_UINT32( sizeof( ucPacket ), ulPacketLength );
+            TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) usPacketIdentifier, pucPacket[ ulPacketLength - 1 ] );
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, ( uint32_t ) x - 1, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+
+        /* Removing all the packets empties the store. */
+        for( usPacketIdentifier = 2; usPacketIdentifier <= x; usPacketIdentifier++ )
+        {
+            pxInterface->pxRemoveFxn( pxInterface->pvStoreContext, usPacketIdentifier );
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+    #endif /* if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief In-flight flash store - Packets are removed out of order, a full
+ * store rejects new packets until the oldest block is freed, a packet
+ * replaces the one stored with the same identifier and the packets survive
+ * a re-init in the order they were stored.
+ */
+TEST( Full_MQTT, AFQP_MQTT_InflightFlashStore_RemoveOutOfOrderAndRecover )
+{
+    #if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        static uint32_t ulMemory[ ( testmqttlibSPOOL_BLOCK_SIZE * testmqttlibSPOOL_BLOCK_COUNT ) / 4 ];
+        static const uint16_t usExpectedOrder[] = { 3, 4, 6, 7, 8, 9, 5 };
+        uint8_t ucPacket[ 20 ];
+        uint8_t ucBuffer[ testmqttlibSPOOL_BLOCK_SIZE ];
+        MQTTOfflineRamFlash_t xRamFlash;
+        MQTTInflightFlashStore_t xStore;
+        const MQTTOfflineFlashInterface_t * pxFlash;
+        const MQTTInflightStoreInterface_t * pxInterface;
+        uint16_t usPacketIdentifier;
+        const uint8_t * pucPacket;
+        uint32_t ulPacketLength, ulIndex;
+
+        memset( ulMemory, 0xFF, sizeof( ulMemory ) );
+        pxFlash = MQTT_OfflineRamFlashInit( &( xRamFlash ), ( uint8_t * ) ulMemory, testmqttlibSPOOL_BLOCK_SIZE, testmqttlibSPOOL_BLOCK_COUNT );
+        pxInterface = MQTT_InflightFlashStoreInit( &( xStore ), pxFlash, ucBuffer, sizeof( ucBuffer ), testmqttlibOPERATION_TIMEOUT_TICKS );
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+
+        /* Fill the store - two packets per block. */
+        for( usPacketIdentifier = 1; usPacketIdentifier <= ( 2 * testmqttlibSPOOL_BLOCK_COUNT ); usPacketIdentifier++ )
+        {
+            memset( ucPacket, ( int ) usPacketIdentifier, sizeof( ucPacket ) );
+            TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxPutFxn( pxInterface->pvStoreContext, usPacketIdentifier, ucPacket, sizeof( ucPacket ) ) );
+        }
+
+        memset( ucPacket, 9, sizeof( ucPacket ) );
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxPutFxn( pxInterface->pvStoreContext, 9, ucPacket, sizeof( ucPacket ) ) );
+
+        /* Removing a packet after the oldest one frees no block. */
+        pxInterface->pxRemoveFxn( pxInterface->pvStoreContext, 2 );
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxPutFxn( pxInterface->pvStoreContext, 9, ucPacket, sizeof( ucPacket ) ) );
+
+        /* Removing the oldest one frees its block. */
+        pxInterface->pxRemoveFxn( pxInterface->pvStoreContext, 1 );
+        TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxPutFxn( pxInterface->pvStoreContext, 9, ucPacket, sizeof( ucPacket ) ) );
+
+        /* A shorter packet, like a PUBREL, replaces the stored PUBLISH. */
+        memset( ucPacket, 0x55, sizeof( ucPacket ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxPutFxn( pxInterface->pvStoreContext, 5, ucPacket, 4 ) );
+
+        /* Re-initializing keeps the packets, in the order they were stored,
+         * and not the removed or replaced ones. */
+        pxInterface = MQTT_InflightFlashStoreInit( &( xStore ), pxFlash, ucBuffer, sizeof( ucBuffer ), testmqttlibOPERATION_TIMEOUT_TICKS );
+
+        for( ulIndex = 0; ulIndex < ( sizeof( usExpectedOrder ) / sizeof( usExpectedOrder[ 0 ] ) ); ulIndex++ )
+        {
+            TEST_ASSERT_EQUAL( eMQTTTrue, pxInterface->pxGetFxn( pxInterface->pvStoreContext,
+                                                                 ulIndex,
+                                                                 &( usPacketIdentifier ),
+                                                                 &( pucPacket ),
+                                                                 &( ulPacketLength ) ) );
+            TEST_ASSERT_EQUAL_UINT16( usExpectedOrder[ ulIndex ], usPacketIdentifier );
+
+            if( usPacketIdentifier == 5 )
+            {
+                TEST_ASSERT_EQUAL_UINT32( 4, ulPacketLength );
+                TEST_ASSERT_EQUAL_UINT8( 0x55, pucPacket[ ulPacketLength - 1 ] );
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL_UINT32( sizeof( ucPacket ), ulPacketLength );
+                TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) usPacketIdentifier, pucPacket[ ulPacketLength - 1 ] );
+            }
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, ulIndex, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+
+        /* Removing all the packets empties the store, also after a re-init. */
+        for( ulIndex = 0; ulIndex < ( sizeof( usExpectedOrder ) / sizeof( usExpectedOrder[ 0 ] ) ); ulIndex++ )
+        {
+            pxInterface->pxRemoveFxn( pxInterface->pvStoreContext, usExpectedOrder[ ulIndex ] );
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+        pxInterface = MQTT_InflightFlashStoreInit( &( xStore ), pxFlash, ucBuffer, sizeof( ucBuffer ), testmqttlibOPERATION_TIMEOUT_TICKS );
+        TEST_ASSERT_EQUAL( eMQTTFalse, pxInterface->pxGetFxn( pxInterface->pvStoreContext, 0, &( usPacketIdentifier ), &( pucPacket ), &( ulPacketLength ) ) );
+    #endif /* if ( mqttconfigENABLE_INFLIGHT_STORE == 1 ) && ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Zero-copy publish - The broker receives the same message as with
+ * MQTT_Publish and the payload is handed back with the PUBACK.
+ */
+TEST( Full_MQTT, AFQP_MQTT_PublishZeroCopy_SameBytesAsPublish )
+{
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        MQTTPublishParams_t xPublishParams;
+        uint8_t ucCopiedPacket[ testmqttlibMAX_SENT_PACKET_LENGTH ];
+        uint32_t ulCopiedPacketLength;
+        static const char cPayload[] = "payload";
+
+        /* Connect. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+        /* Publish a QoS1 message the usual way and remember it. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS1 ) );
+        ulCopiedPacketLength = ulLastSentPacketLength;
+        memcpy( ucCopiedPacket, ucLastSentPacket, ulCopiedPacketLength );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_NULL( pvLastAckedPublishData );
+
+        /* Publish the same message without copying the payload. */
+        xMQTTContext.pxMQTTSendVectoredFxn = &( prvSendVectoredCallback );
+        xPublishParams.pucTopic = ( const uint8_t * ) "a/b";
+        xPublishParams.usTopicLength = ( uint16_t ) ( strlen( ( const char * ) xPublishParams.pucTopic ) );
+        xPublishParams.xQos = eMQTTQoS1;
+        xPublishParams.pvData = cPayload;
+        xPublishParams.ulDataLength = ( uint32_t ) strlen( cPayload );
+        xPublishParams.usPacketIdentifier = ( uint16_t ) testmqttlibPUBLISH_PACKET_ID;
+        xPublishParams.ulTimeoutTicks = testmqttlibOPERATION_TIMEOUT_TICKS;
+        ulSendCallbacksInvoked = 0;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_PublishZeroCopy( &( xMQTTContext ), &( xPublishParams ) ) );
+
+        /* It must be sent at once and be identical. */
+        TEST_ASSERT_EQUAL( 1, ulSendCallbacksInvoked );
+        TEST_ASSERT_EQUAL_UINT32( ulCopiedPacketLength, ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucCopiedPacket, ucLastSentPacket, ulCopiedPacketLength );
+
+        /* The PUBACK hands the payload back. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_EQUAL( 2, xCallbackCounter.ulPubACK );
+        TEST_ASSERT_EQUAL_PTR( cPayload, pvLastAckedPublishData );
+    #endif /* if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Zero-copy publish - Without a send vectored function, the header
+ * and the payload are sent separately and the payload is not sent if the
+ * header could not be.
+ */
+TEST( Full_MQTT, AFQP_MQTT_PublishZeroCopy_WithoutSendVectored )
+{
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        MQTTPublishParams_t xPublishParams;
+        static const char cPayload[] = "payload";
+
+        /* Connect. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+        /* Publish a QoS2 message without copying the payload. */
+        xPublishParams.pucTopic = ( const uint8_t * ) "a/b";
+        xPublishParams.usTopicLength = ( uint16_t ) ( strlen( ( const char * ) xPublishParams.pucTopic ) );
+        xPublishParams.xQos = eMQTTQoS2;
+        xPublishParams.pvData = cPayload;
+        xPublishParams.ulDataLength = ( uint32_t ) strlen( cPayload );
+        xPublishParams.usPacketIdentifier = ( uint16_t ) testmqttlibPUBLISH_PACKET_ID;
+        xPublishParams.ulTimeoutTicks = testmqttlibOPERATION_TIMEOUT_TICKS;
+        ulSendCallbacksInvoked = 0;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_PublishZeroCopy( &( xMQTTContext ), &( xPublishParams ) ) );
+
+        /* The payload is sent last, straight from the memory of the user. */
+        TEST_ASSERT_EQUAL( 2, ulSendCallbacksInvoked );
+        TEST_ASSERT_EQUAL_UINT32( strlen( cPayload ), ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( cPayload, ucLastSentPacket, ulLastSentPacketLength );
+
+        /* The payload is handed back only when the exchange is complete. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREC, testmqttlibPUBLISH_PACKET_ID ) );
+        prvAssertLastSentAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibPUBLISH_PACKET_ID );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBCOMP, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+        TEST_ASSERT_EQUAL_PTR( cPayload, pvLastAckedPublishData );
+
+        /* A failed header send fails the publish without sending the payload. */
+        xMQTTContext.pxMQTTSendFxn = &( prvSendFailedCallback );
+        ulSendCallbacksInvoked = 0;
+        TEST_ASSERT_EQUAL( eMQTTSendFailed, MQTT_PublishZeroCopy( &( xMQTTContext ), &( xPublishParams ) ) );
+        TEST_ASSERT_EQUAL( 0, ulSendCallbacksInvoked );
+    #endif /* if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Streaming receive - A publish message larger than the buffers is
+ * passed in chunks as it arrives and acknowledged once complete.
+ */
+TEST( Full_MQTT, AFQP_MQTT_ReceivePublish_StreamedInChunks )
+{
+    #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+        uint32_t x;
+
+        /* Connect. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+        /* Receive a QoS1 message split in the middle of the topic. */
+        ulStreamedPayloadLength = 0;
+        ulLastSentPacketLength = 0;
+        prvReceiveStreamedPublish( mqttFLAGS_PUBLISH_QOS1, testmqttlibRECEIVED_PACKET_ID, 5, 3000 );
+
+        /* Topic first, then one chunk per part of the message. */
+        TEST_ASSERT_EQUAL( 0, xCallbackCounter.ulPublish );
+        TEST_ASSERT_EQUAL( 3, xCallbackCounter.ulPublishChunk );
+        TEST_ASSERT_EQUAL_UINT32( testmqttlibSTREAMED_PAYLOAD_LENGTH, ulStreamedPayloadLength );
+
+        for( x = 0; x < testmqttlibSTREAMED_PAYLOAD_LENGTH; x++ )
+        {
+            TEST_ASSERT_EQUAL_UINT8( ( uint8_t ) ( x * 7 ), ucStreamedPayload[ x ] );
+        }
+
+        prvAssertLastSentAck( mqttCONTROL_PUBACK, testmqttlibRECEIVED_PACKET_ID );
+
+        /* The next message is received as usual. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveQoS2Publish() );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPublish );
+        TEST_ASSERT_EQUAL( eMQTTConnected, xMQTTContext.xConnectionState );
+    #endif /* if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Streaming receive - A re-transmission of a streamed QoS2 message
+ * is acknowledged but not passed again, unless the first transmission was
+ * interrupted.
+ */
+TEST( Full_MQTT, AFQP_MQTT_ReceivePublish_StreamedQoS2Duplicate )
+{
+    #if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 )
+        /* Connect. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceiveMQTTConnACK() );
+
+        /* Receive a QoS2 message whose header ends in the first part. */
+        ulStreamedPayloadLength = 0;
+        prvReceiveStreamedPublish( mqttFLAGS_PUBLISH_QOS2, testmqttlibRECEIVED_PACKET_ID, 20, 4000 );
+        TEST_ASSERT_EQUAL( 4, xCallbackCounter.ulPublishChunk );
+        TEST_ASSERT_EQUAL_UINT32( testmqttlibSTREAMED_PAYLOAD_LENGTH, ulStreamedPayloadLength );
+        prvAssertLastSentAck( mqttCONTROL_PUBREC, testmqttlibRECEIVED_PACKET_ID );
+
+        /* The re-transmission is only acknowledged. */
+        ulLastSentPacketLength = 0;
+        prvReceiveStreamedPublish( mqttFLAGS_PUBLISH_QOS2 | mqttFLAGS_PUBLISH_DUP, testmqttlibRECEIVED_PACKET_ID, 20, 4000 );
+        TEST_ASSERT_EQUAL( 4, xCallbackCounter.ulPublishChunk );
+        prvAssertLastSentAck( mqttCONTROL_PUBREC, testmqttlibRECEIVED_PACKET_ID );
+
+        /* Once released, the same packet identifier is a new message. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBREL | mqttFLAGS_PUBREL, testmqttlibRECEIVED_PACKET_ID ) );
+        ulStreamedPayloadLength = 0;
+        prvReceiveStreamedPublish( mqttFLAGS_PUBLISH_QOS2, testmqttlibRECEIVED_PACKET_ID, 20, 4000 );
+        TEST_ASSERT_EQUAL( 8, xCallbackCounter.ulPublishChunk );
+        TEST_ASSERT_EQUAL_UINT32( testmqttlibSTREAMED_PAYLOAD_LENGTH, ulStreamedPayloadLength );
+    #endif /* if ( mqttconfigENABLE_STREAMING_RECEIVE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT 5 - The CONNECT message carries the protocol level 5 and the
+ * Receive Maximum and Topic Alias Maximum properties of the client.
+ */
+TEST( Full_MQTT, AFQP_MQTT5_Connect_SendsProperties )
+{
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        static const uint8_t ucProperties[] =
+        {
+            6,                                                                              /* Properties length. */
+            0x21, 0, mqttconfigMAX_QOS2_RECEIVED_PUBLISHES,                                 /* Receive Maximum. */
+            0x22, ( uint8_t ) ( mqttconfigTOPIC_ALIAS_MAXIMUM >> 8 ), mqttconfigTOPIC_ALIAS_MAXIMUM /* Topic Alias Maximum. */
+        };
+
+        xMQTTContext.xProtocolVersion = eMQTTProtocolVersion5;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTConnect() );
+
+        /* Fixed header, protocol name, level, flags and keep alive, then
+         * the properties before the client identifier. */
+        TEST_ASSERT_EQUAL_UINT8( 5, ucLastSentPacket[ 8 ] );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucProperties, &( ucLastSentPacket[ 12 ] ), sizeof( ucProperties ) );
+        TEST_ASSERT_EQUAL_MEMORY( "client_id", &( ucLastSentPacket[ 12 + sizeof( ucProperties ) + 2 ] ), 9 );
+    #endif /* if ( mqttconfigENABLE_MQTT5 == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT 5 - The first publish message on a topic assigns a topic alias
+ * and the next ones send the alias in place of the topic.
+ */
+TEST( Full_MQTT, AFQP_MQTT5_Publish_ReusesTopicAlias )
+{
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        static const uint8_t ucFirstPublish[] =
+        {
+            mqttCONTROL_PUBLISH, 16, 0, 3, 'a', '/', 'b', 3, 0x23, 0, 1,
+            'p', 'a', 'y', 'l', 'o', 'a', 'd'
+        };
+        static const uint8_t ucNextPublish[] =
+        {
+            mqttCONTROL_PUBLISH, 13, 0, 0, 3, 0x23, 0, 1,
+            'p', 'a', 'y', 'l', 'o', 'a', 'd'
+        };
+
+        prvConnectMQTT5( 10 );
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS0 ) );
+        TEST_ASSERT_EQUAL_UINT32( sizeof( ucFirstPublish ), ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucFirstPublish, ucLastSentPacket, sizeof( ucFirstPublish ) );
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS0 ) );
+        TEST_ASSERT_EQUAL_UINT32( sizeof( ucNextPublish ), ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucNextPublish, ucLastSentPacket, sizeof( ucNextPublish ) );
+    #endif /* if ( mqttconfigENABLE_MQTT5 == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT 5 - A publish message received with a topic alias and no topic
+ * is passed with the topic the broker assigned to the alias before.
+ */
+TEST( Full_MQTT, AFQP_MQTT5_ReceivePublish_ResolvesTopicAlias )
+{
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        static const uint8_t ucFirstPublish[] =
+        {
+            mqttCONTROL_PUBLISH, 10, 0, 3, 'a', '/', 'b', 3, 0x23, 0, 1, 'x'
+        };
+        static const uint8_t ucNextPublish[] =
+        {
+            mqttCONTROL_PUBLISH, 7, 0, 0, 3, 0x23, 0, 1, 'y'
+        };
+        static const uint8_t ucUnknownAlias[] =
+        {
+            mqttCONTROL_PUBLISH, 7, 0, 0, 3, 0x23, 0, 2, 'z'
+        };
+
+        prvConnectMQTT5( 10 );
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), ucFirstPublish, sizeof( ucFirstPublish ) ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPublish );
+
+        usLastPublishTopicLength = 0;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), ucNextPublish, sizeof( ucNextPublish ) ) );
+        TEST_ASSERT_EQUAL( 2, xCallbackCounter.ulPublish );
+        TEST_ASSERT_EQUAL_UINT16( 3, usLastPublishTopicLength );
+        TEST_ASSERT_EQUAL_MEMORY( "a/b", ucLastPublishTopic, 3 );
+
+        /* An alias the broker never assigned is a protocol error. */
+        ( void ) MQTT_ParseReceivedData( &( xMQTTContext ), ucUnknownAlias, sizeof( ucUnknownAlias ) );
+        TEST_ASSERT_EQUAL( 2, xCallbackCounter.ulPublish );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulDisconnect );
+    #endif /* if ( mqttconfigENABLE_MQTT5 == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT 5 - No more QoS1 and QoS2 publish messages than the Receive
+ * Maximum of the broker are in flight at a time.
+ */
+TEST( Full_MQTT, AFQP_MQTT5_Publish_ReceiveMaximumExceeded )
+{
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        prvConnectMQTT5( 1 );
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS1 ) );
+        TEST_ASSERT_EQUAL( eMQTTReceiveMaximumExceeded, prvSendMQTTPublish( eMQTTQoS1 ) );
+
+        /* QoS0 messages are not limited. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS0 ) );
+
+        /* The PUBACK makes room for the next one. */
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvReceivePublishAck( mqttCONTROL_PUBACK, testmqttlibPUBLISH_PACKET_ID ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubACK );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS1 ) );
+    #endif /* if ( mqttconfigENABLE_MQTT5 == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT 5 - A PUBREC with a failure reason code completes the QoS2
+ * publish message without a PUBREL and reports the reason code.
+ */
+TEST( Full_MQTT, AFQP_MQTT5_Publish_RefusedPUBREC )
+{
+    #if ( mqttconfigENABLE_MQTT5 == 1 )
+        static const uint8_t ucRefusedPUBREC[] =
+        {
+            mqttCONTROL_PUBREC, 3, 0, testmqttlibPUBLISH_PACKET_ID, 0x87 /* Not authorized. */
+        };
+
+        prvConnectMQTT5( 10 );
+        TEST_ASSERT_EQUAL( eMQTTSuccess, prvSendMQTTPublish( eMQTTQoS2 ) );
+
+        ulLastSentPacketLength = 0;
+        TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_ParseReceivedData( &( xMQTTContext ), ucRefusedPUBREC, sizeof( ucRefusedPUBREC ) ) );
+        TEST_ASSERT_EQUAL( 1, xCallbackCounter.ulPubCOMP );
+        TEST_ASSERT_EQUAL_UINT8( 0x87, ucLastAckReasonCode );
+        TEST_ASSERT_EQUAL_UINT32( 0, ulLastSentPacketLength );
+        TEST_ASSERT_EQUAL( eMQTTConnected, xMQTTContext.xConnectionState );
+    #endif /* if ( mqttconfigENABLE_MQTT5 == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Offline spool - A full spool rejects new messages, the blocks are
+ * reused once their messages are removed and the messages survive a re-init
+ * in the order they were pushed.
+ */
+TEST( Full_MQTT, AFQP_MQTT_OfflineSpool_WrapAndRecover )
+{
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        static uint32_t ulMemory[ ( testmqttlibSPOOL_BLOCK_SIZE * testmqttlibSPOOL_BLOCK_COUNT ) / 4 ];
+        MQTTOfflineRamFlash_t xRamFlash;
+        MQTTOfflineSpool_t xSpool;
+        const MQTTOfflineFlashInterface_t * pxFlash;
+        MQTTPublishParams_t xPublishParams;
+        uint8_t ucBuffer[ 32 ];
+        uint32_t ulIndex;
+
+        memset( ulMemory, 0xFF, sizeof( ulMemory ) );
+        pxFlash = MQTT_OfflineRamFlashInit( &( xRamFlash ), ( uint8_t * ) ulMemory, testmqttlibSPOOL_BLOCK_SIZE, testmqttlibSPOOL_BLOCK_COUNT );
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+        TEST_ASSERT_EQUAL_UINT32( 0, xSpool.ulMessages );
+        TEST_ASSERT_EQUAL( eMQTTFalse, MQTT_OfflineSpoolPeek( &( xSpool ), ucBuffer, sizeof( ucBuffer ), &( xPublishParams ) ) );
+
+        /* Fill the spool - two messages per block. */
+        for( ulIndex = 0; prvPushSpoolMessage( &( xSpool ), ulIndex ) == eMQTTTrue; ulIndex++ )
+        {
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( 2 * testmqttlibSPOOL_BLOCK_COUNT, ulIndex );
+        TEST_ASSERT_EQUAL_UINT32( ulIndex, xSpool.ulMessages );
+        TEST_ASSERT_EQUAL_UINT32( ulIndex * 11, xSpool.ulBytes );
+
+        /* Removing the messages of the first block makes room for two more,
+         * which therefore wrap around. */
+        prvCheckSpoolMessage( &( xSpool ), 0 );
+        MQTT_OfflineSpoolPop( &( xSpool ) );
+        TEST_ASSERT_EQUAL( eMQTTFalse, prvPushSpoolMessage( &( xSpool ), ulIndex ) );
+        prvCheckSpoolMessage( &( xSpool ), 1 );
+        MQTT_OfflineSpoolPop( &( xSpool ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), ulIndex ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), ulIndex + 1 ) );
+        TEST_ASSERT_EQUAL( eMQTTFalse, prvPushSpoolMessage( &( xSpool ), ulIndex + 2 ) );
+
+        /* Re-initializing keeps the messages, in the order they were pushed. */
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+        TEST_ASSERT_EQUAL_UINT32( 2 * testmqttlibSPOOL_BLOCK_COUNT, xSpool.ulMessages );
+
+        for( ulIndex = 2; ulIndex < ( 2 * testmqttlibSPOOL_BLOCK_COUNT ) + 2; ulIndex++ )
+        {
+            prvCheckSpoolMessage( &( xSpool ), ulIndex );
+            MQTT_OfflineSpoolPop( &( xSpool ) );
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( 0, xSpool.ulMessages );
+        TEST_ASSERT_EQUAL_UINT32( 0, xSpool.ulBytes );
+        TEST_ASSERT_EQUAL( eMQTTFalse, MQTT_OfflineSpoolPeek( &( xSpool ), ucBuffer, sizeof( ucBuffer ), &( xPublishParams ) ) );
+
+        /* The removed messages are not recovered. */
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+        TEST_ASSERT_EQUAL_UINT32( 0, xSpool.ulMessages );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), ulIndex ) );
+        prvCheckSpoolMessage( &( xSpool ), ulIndex );
+    #endif /* if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Offline spool - A message whose record was not completely written
+ * before a reset is not recovered, and a message larger than a block is
+ * rejected.
+ */
+TEST( Full_MQTT, AFQP_MQTT_OfflineSpool_SkipsTornRecord )
+{
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        static uint32_t ulMemory[ ( testmqttlibSPOOL_BLOCK_SIZE * testmqttlibSPOOL_BLOCK_COUNT ) / 4 ];
+        static uint8_t ucLargeData[ testmqttlibSPOOL_BLOCK_SIZE ];
+        MQTTOfflineRamFlash_t xRamFlash;
+        MQTTOfflineSpool_t xSpool;
+        const MQTTOfflineFlashInterface_t * pxFlash;
+        MQTTPublishParams_t xPublishParams;
+
+        memset( ulMemory, 0xFF, sizeof( ulMemory ) );
+        pxFlash = MQTT_OfflineRamFlashInit( &( xRamFlash ), ( uint8_t * ) ulMemory, testmqttlibSPOOL_BLOCK_SIZE, testmqttlibSPOOL_BLOCK_COUNT );
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), 0 ) );
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), 1 ) );
+
+        /* Mimic a reset before the state of the second record - after the
+         * 8 bytes of the block header and the 20 bytes of the first record -
+         * was written. */
+        ( ( uint8_t * ) ulMemory )[ 28 ] = 0xFF;
+
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+        TEST_ASSERT_EQUAL_UINT32( 1, xSpool.ulMessages );
+
+        /* The next message is written after the torn record. */
+        TEST_ASSERT_EQUAL( eMQTTTrue, prvPushSpoolMessage( &( xSpool ), 2 ) );
+        prvCheckSpoolMessage( &( xSpool ), 0 );
+        MQTT_OfflineSpoolPop( &( xSpool ) );
+        prvCheckSpoolMessage( &( xSpool ), 2 );
+
+        /* A message must fit in a block with the headers. */
+        xPublishParams.pucTopic = ( const uint8_t * ) "t";
+        xPublishParams.usTopicLength = 1;
+        xPublishParams.xQos = eMQTTQoS1;
+        xPublishParams.pvData = ucLargeData;
+        xPublishParams.ulDataLength = testmqttlibSPOOL_BLOCK_SIZE - 16;
+        TEST_ASSERT_EQUAL( eMQTTFalse, MQTT_OfflineSpoolPush( &( xSpool ), &( xPublishParams ) ) );
+
+        xPublishParams.usTopicLength = 0;
+        TEST_ASSERT_EQUAL( eMQTTTrue, MQTT_OfflineSpoolPush( &( xSpool ), &( xPublishParams ) ) );
+        TEST_ASSERT_EQUAL_UINT32( 2, xSpool.ulMessages );
+    #endif /* if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,597 @@
+/*
+ * Amazon FreeRTOS MQTT AFQP V1.1.4
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_mqtt_lib_benchmark.c
+ * @brief Benchmarks of the publish dispatch, of the publish and of the
+ * offline spool of the MQTT Core Library.
+ *
+ * The dispatch benchmark measures the time needed to find the subscriptions
+ * matching the topic of a received publish message with a growing number of
+ * subscriptions, and compares it with a linear scan which matches the topic
+ * against every topic filter, as the subscription manager used to do. The
+ * numbers of subscriptions above mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS
+ * are skipped, as the pools of the subscription manager are sized from it, so
+ * it should be set to mqttbenchmarkMAX_SUBSCRIPTIONS in aws_mqtt_config.h.
+ *
+ * The publish benchmark measures the time needed to send a publish message
+ * with MQTT_Publish, which copies the payload into a buffer from the buffer
+ * pool, and with MQTT_PublishZeroCopy, which does not. Payloads larger than
+ * the buffers of the buffer pool can only be sent with the latter. It needs
+ * mqttconfigENABLE_ZERO_COPY_PUBLISH to be set to 1 in aws_mqtt_config.h.
+ *
+ * The offline spool benchmark measures the time needed to push a publish
+ * message into the spool and to remove it again, over a RAM region and, if
+ * mqttbenchmarkSPOOL_FILE_NAME is defined, over a file region. The spool is
+ * filled and emptied repeatedly, so that every block is erased and reused. It
+ * needs mqttconfigENABLE_OFFLINE_QUEUE to be set to 1 in aws_mqtt_config.h.
+ *
+ * The results are printed with configPRINTF.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* MQTT Lib includes. */
+#include "aws_mqtt_lib.h"
+#include "aws_mqtt_lib_test_access_declare.h"
+#include "aws_mqtt_offline_spool.h"
+
+/* Bufferpool includes. */
+#include "aws_bufferpool.h"
+
+/**
+ * @brief Largest number of subscriptions dispatched to.
+ *
+ * The benchmark runs with 16, 64 and this number of subscriptions.
+ */
+#ifndef mqttbenchmarkMAX_SUBSCRIPTIONS
+    #define mqttbenchmarkMAX_SUBSCRIPTIONS    ( 256 )
+#endif
+
+/**
+ * @brief Number of publish messages dispatched in each measurement.
+ */
+#ifndef mqttbenchmarkDISPATCHES
+    #define mqttbenchmarkDISPATCHES           ( 20000UL )
+#endif
+
+/**
+ * @brief Maximum length of the generated topics and topic filters.
+ */
+#define mqttbenchmarkTOPIC_LENGTH             ( 48 )
+
+/**
+ * @brief Number of distinct topics published to.
+ */
+#define mqttbenchmarkTOPICS                   ( 64 )
+
+/**
+ * @brief Number of publish messages sent in each measurement.
+ */
+#ifndef mqttbenchmarkPUBLISHES
+    #define mqttbenchmarkPUBLISHES            ( 20000UL )
+#endif
+
+/**
+ * @brief Payload length which fits in a buffer of the buffer pool.
+ */
+#define mqttbenchmarkSMALL_PAYLOAD_LENGTH     ( 1024UL )
+
+/**
+ * @brief Largest payload length sent.
+ */
+#define mqttbenchmarkMAX_PAYLOAD_LENGTH       ( 65536UL )
+
+/**
+ * @brief Number of publish messages pushed into and removed from the spool in
+ * each measurement.
+ */
+#ifndef mqttbenchmarkSPOOL_MESSAGES
+    #define mqttbenchmarkSPOOL_MESSAGES       ( 20000UL )
+#endif
+
+/**
+ * @brief Size of a block of the spool region.
+ */
+#define mqttbenchmarkSPOOL_BLOCK_SIZE         ( 4096UL )
+
+/**
+ * @brief Number of blocks of the spool region.
+ */
+#define mqttbenchmarkSPOOL_BLOCK_COUNT        ( 16UL )
+
+/**
+ * @brief Payload length of the publish messages pushed into the spool.
+ */
+#define mqttbenchmarkSPOOL_PAYLOAD_LENGTH     ( 64UL )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief MQTT context holding the subscriptions.
+ */
+static MQTTContext_t xBenchmarkContext;
+
+/**
+ * @brief The topic filters, in the order they are subscribed to.
+ */
+static char cTopicFilters[ mqttbenchmarkMAX_SUBSCRIPTIONS ][ mqttbenchmarkTOPIC_LENGTH ];
+
+/**
+ * @brief The topics published to.
+ */
+static char cTopics[ mqttbenchmarkTOPICS ][ mqttbenchmarkTOPIC_LENGTH ];
+
+/**
+ * @brief Number of publish callbacks invoked during a measurement.
+ */
+static uint32_t ulMatches;
+
+/**
+ * @brief The payload of the publish messages sent.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    static uint8_t ucPayload[ mqttbenchmarkMAX_PAYLOAD_LENGTH ];
+#endif
+
+/**
+ * @brief The memory of the RAM region of the spool.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static uint32_t ulSpoolMemory[ ( mqttbenchmarkSPOOL_BLOCK_SIZE * mqttbenchmarkSPOOL_BLOCK_COUNT ) / sizeof( uint32_t ) ];
+#endif
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The send callback registered with the MQTT library, which mimics a
+ * successful send.
+ */
+static uint32_t prvSendCallback( void * pvSendContext,
+                                 const uint8_t * const pucData,
+                                 uint32_t ulDataLength )
+{
+    ( void ) pvSendContext;
+    ( void ) pucData;
+
+    return ulDataLength;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The MQTT event callback registered with the MQTT library.
+ */
+static MQTTBool_t prvEventCallback( void * pvCallbackContext,
+                                    const MQTTEventCallbackParams_t * const pxParams )
+{
+    ( void ) pvCallbackContext;
+    ( void ) pxParams;
+
+    return eMQTTFalse;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The publish callback of all the subscriptions, which counts the
+ * matches and leaves the buffer to the library.
+ */
+static MQTTBool_t prvPublishCallback( void * pvPublishCallbackContext,
+                                      const MQTTPublishData_t * const pxPublishData )
+{
+    ( void ) pvPublishCallbackContext;
+    ( void ) pxPublishData;
+
+    ulMatches++;
+
+    return eMQTTFalse;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generates the topic filters and the topics.
+ *
+ * Every device has a command topic, a shadow topic with a '+' level, a jobs
+ * topic with a '#' level, and an events topic with a '+' level in the middle,
+ * so that both exact and wild-card matches are exercised.
+ */
+static void prvGenerateTopics( void )
+{
+    uint32_t x;
+
+    for( x = 0; x < ( uint32_t ) mqttbenchmarkMAX_SUBSCRIPTIONS; x++ )
+    {
+        switch( x % 4UL )
+        {
+            case 0:
+                ( void ) snprintf( cTopicFilters[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/cmd", ( unsigned ) ( x / 4UL ) );
+                break;
+
+            case 1:
+                ( void ) snprintf( cTopicFilters[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/shadow/+", ( unsigned ) ( x / 4UL ) );
+                break;
+
+            case 2:
+                ( void ) snprintf( cTopicFilters[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/jobs/#", ( unsigned ) ( x / 4UL ) );
+                break;
+
+            default:
+                ( void ) snprintf( cTopicFilters[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/+/dev%u/events", ( unsigned ) ( x / 4UL ) );
+                break;
+        }
+    }
+
+    for( x = 0; x < ( uint32_t ) mqttbenchmarkTOPICS; x++ )
+    {
+        switch( x % 4UL )
+        {
+            case 0:
+                ( void ) snprintf( cTopics[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/cmd", ( unsigned ) x );
+                break;
+
+            case 1:
+                ( void ) snprintf( cTopics[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/shadow/update", ( unsigned ) x );
+                break;
+
+            case 2:
+                ( void ) snprintf( cTopics[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/dev%u/jobs/notify/next", ( unsigned ) x );
+                break;
+
+            default:
+                ( void ) snprintf( cTopics[ x ], mqttbenchmarkTOPIC_LENGTH, "bench/site/dev%u/events", ( unsigned ) x );
+                break;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Counts the nodes left in the free list of the subscription manager.
+ */
+static uint32_t prvCountFreeNodes( void )
+{
+    uint32_t ulFreeNodes = 0;
+    uint16_t usNode = xBenchmarkContext.xSubscriptionManager.usFreeNodes;
+
+    while( usNode != ( uint16_t ) 0xFFFF )
+    {
+        ulFreeNodes++;
+        usNode = xBenchmarkContext.xSubscriptionManager.xNodes[ usNode ].usNext;
+    }
+
+    return ulFreeNodes;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Dispatches mqttbenchmarkDISPATCHES publish messages through the
+ * subscription manager, and the same number through a linear scan over the
+ * first ulSubscriptions topic filters.
+ */
+static void prvDispatchBenchmark( uint32_t ulSubscriptions )
+{
+    MQTTPublishData_t xPublishData;
+    MQTTBool_t xCallbackInvoked;
+    TickType_t xStart;
+    uint32_t x, y, ulTrieMS, ulLinearMS, ulTrieMatches;
+
+    /* Start from an empty subscription manager. */
+    Test_prvResetMQTTContext( &( xBenchmarkContext ) );
+
+    for( x = 0; x < ulSubscriptions; x++ )
+    {
+        TEST_ASSERT_EQUAL_MESSAGE( eMQTTTrue,
+                                   Test_prvStoreSubscription( &( xBenchmarkContext ),
+                                                              ( const uint8_t * ) cTopicFilters[ x ],
+                                                              ( uint16_t ) strlen( cTopicFilters[ x ] ),
+                                                              NULL,
+                                                              prvPublishCallback ),
+                                   "Increase mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES or mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE." );
+    }
+
+    memset( &( xPublishData ), 0x00, sizeof( xPublishData ) );
+
+    /* Dispatch through the topic trie. */
+    ulMatches = 0;
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < mqttbenchmarkDISPATCHES; x++ )
+    {
+        xPublishData.pucTopic = ( const uint8_t * ) cTopics[ x % ( uint32_t ) mqttbenchmarkTOPICS ];
+        xPublishData.usTopicLength = ( uint16_t ) strlen( cTopics[ x % ( uint32_t ) mqttbenchmarkTOPICS ] );
+        ( void ) Test_prvInvokeSubscriptionCallbacks( &( xBenchmarkContext ), &( xPublishData ), &( xCallbackInvoked ) );
+    }
+
+    ulTrieMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+    ulTrieMatches = ulMatches;
+
+    /* Dispatch by matching the topic against every topic filter. */
+    ulMatches = 0;
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < mqttbenchmarkDISPATCHES; x++ )
+    {
+        xPublishData.pucTopic = ( const uint8_t * ) cTopics[ x % ( uint32_t ) mqttbenchmarkTOPICS ];
+        xPublishData.usTopicLength = ( uint16_t ) strlen( cTopics[ x % ( uint32_t ) mqttbenchmarkTOPICS ] );
+
+        for( y = 0; y < ulSubscriptions; y++ )
+        {
+            if( Test_prvDoesTopicMatchTopicFilter( xPublishData.pucTopic,
+                                                   xPublishData.usTopicLength,
+                                                   ( const uint8_t * ) cTopicFilters[ y ],
+                                                   ( uint16_t ) strlen( cTopicFilters[ y ] ) ) == eMQTTTrue )
+            {
+                ( void ) prvPublishCallback( NULL, &( xPublishData ) );
+            }
+        }
+    }
+
+    ulLinearMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    /* Both must find the same subscriptions. */
+    TEST_ASSERT_EQUAL_UINT32( ulMatches, ulTrieMatches );
+
+    configPRINTF( ( "Dispatch with %u subscriptions: topic trie %u ns, linear scan %u ns per message (%u matches)\r\n",
+                    ulSubscriptions,
+                    ( uint32_t ) ( ( ( uint64_t ) ulTrieMS * 1000000ULL ) / mqttbenchmarkDISPATCHES ),
+                    ( uint32_t ) ( ( ( uint64_t ) ulLinearMS * 1000000ULL ) / mqttbenchmarkDISPATCHES ),
+                    ulTrieMatches ) );
+    configPRINTF( ( "    %u of %u nodes free, %u of %u string pool bytes used\r\n",
+                    prvCountFreeNodes(),
+                    ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_TOPIC_NODES,
+                    ( uint32_t ) xBenchmarkContext.xSubscriptionManager.usStringPoolUsed,
+                    ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_STRING_POOL_SIZE ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Sends mqttbenchmarkPUBLISHES QoS0 publish messages with the given
+ * payload length, with MQTT_PublishZeroCopy or else with MQTT_Publish.
+ *
+ * @return The time taken in milliseconds.
+ */
+#if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+    static uint32_t prvPublishBenchmark( uint32_t ulPayloadLength,
+                                         MQTTBool_t xZeroCopy )
+    {
+        MQTTPublishParams_t xPublishParams;
+        MQTTReturnCode_t xReturnCode = eMQTTSuccess;
+        TickType_t xStart;
+        uint32_t x;
+
+        memset( &( xPublishParams ), 0x00, sizeof( xPublishParams ) );
+        xPublishParams.pucTopic = ( const uint8_t * ) cTopics[ 0 ];
+        xPublishParams.usTopicLength = ( uint16_t ) strlen( cTopics[ 0 ] );
+        xPublishParams.xQos = eMQTTQoS0;
+        xPublishParams.pvData = ucPayload;
+        xPublishParams.ulDataLength = ulPayloadLength;
+
+        xStart = xTaskGetTickCount();
+
+        for( x = 0; ( x < mqttbenchmarkPUBLISHES ) && ( xReturnCode == eMQTTSuccess ); x++ )
+        {
+            if( xZeroCopy == eMQTTTrue )
+            {
+                xReturnCode = MQTT_PublishZeroCopy( &( xBenchmarkContext ), &( xPublishParams ) );
+            }
+            else
+            {
+                xReturnCode = MQTT_Publish( &( xBenchmarkContext ), &( xPublishParams ) );
+            }
+        }
+
+        TEST_ASSERT_EQUAL( eMQTTSuccess, xReturnCode );
+
+        return ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+    }
+#endif /* mqttconfigENABLE_ZERO_COPY_PUBLISH */
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Pushes mqttbenchmarkSPOOL_MESSAGES publish messages into a spool
+ * over the given region and removes them again, filling and emptying the
+ * spool as many times as needed.
+ *
+ * @return The time taken in milliseconds.
+ */
+#if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+    static uint32_t prvSpoolBenchmark( const MQTTOfflineFlashInterface_t * pxFlash )
+    {
+        MQTTOfflineSpool_t xSpool;
+        MQTTPublishParams_t xPublishParams, xPeekedParams;
+        uint8_t ucData[ mqttbenchmarkSPOOL_PAYLOAD_LENGTH ];
+        uint8_t ucBuffer[ mqttbenchmarkTOPIC_LENGTH + mqttbenchmarkSPOOL_PAYLOAD_LENGTH ];
+        TickType_t xStart;
+        uint32_t ulPushed = 0, ulRemoved = 0;
+
+        /* Start from an empty spool, whatever the region held before. */
+        MQTT_OfflineSpoolInit( &( xSpool ), pxFlash );
+
+        while( xSpool.ulMessages > 0UL )
+        {
+            MQTT_OfflineSpoolPop( &( xSpool ) );
+        }
+
+        memset( ucData, 0xA5, sizeof( ucData ) );
+        memset( &( xPublishParams ), 0x00, sizeof( xPublishParams ) );
+        xPublishParams.pucTopic = ( const uint8_t * ) cTopics[ 0 ];
+        xPublishParams.usTopicLength = ( uint16_t ) strlen( cTopics[ 0 ] );
+        xPublishParams.xQos = eMQTTQoS1;
+        xPublishParams.pvData = ucData;
+        xPublishParams.ulDataLength = mqttbenchmarkSPOOL_PAYLOAD_LENGTH;
+
+        xStart = xTaskGetTickCount();
+
+        while( ulRemoved < mqttbenchmarkSPOOL_MESSAGES )
+        {
+            while( ( ulPushed < mqttbenchmarkSPOOL_MESSAGES ) &&
+                   ( MQTT_OfflineSpoolPush( &( xSpool ), &( xPublishParams ) ) == eMQTTTrue ) )
+            {
+                ulPushed++;
+            }
+
+            TEST_ASSERT_TRUE( xSpool.ulMessages > 0UL );
+
+            while( xSpool.ulMessages > 0UL )
+            {
+                TEST_ASSERT_EQUAL( eMQTTTrue, MQTT_OfflineSpoolPeek( &( xSpool ), ucBuffer, sizeof( ucBuffer ), &( xPeekedParams ) ) );
+                MQTT_OfflineSpoolPop( &( xSpool ) );
+                ulRemoved++;
+            }
+        }
+
+        return ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+    }
+#endif /* mqttconfigENABLE_OFFLINE_QUEUE */
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_MQTT_BENCHMARK );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_MQTT_BENCHMARK )
+{
+    MQTTInitParams_t xInitParams;
+
+    memset( &( xInitParams ), 0x00, sizeof( xInitParams ) );
+    xInitParams.pxCallback = prvEventCallback;
+    xInitParams.pxMQTTSendFxn = prvSendCallback;
+    xInitParams.xBufferPoolInterface.pxGetBufferFxn = BUFFERPOOL_GetFreeBuffer;
+    xInitParams.xBufferPoolInterface.pxReturnBufferFxn = BUFFERPOOL_ReturnBuffer;
+
+    TEST_ASSERT_EQUAL( eMQTTSuccess, MQTT_Init( &( xBenchmarkContext ), &( xInitParams ) ) );
+
+    prvGenerateTopics();
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_MQTT_BENCHMARK )
+{
+    Test_prvResetMQTTContext( &( xBenchmarkContext ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_MQTT_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_MQTT_BENCHMARK, PublishDispatch );
+    RUN_TEST_CASE( Full_MQTT_BENCHMARK, PublishZeroCopy );
+    RUN_TEST_CASE( Full_MQTT_BENCHMARK, OfflineSpool );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_MQTT_BENCHMARK, PublishDispatch )
+{
+    const uint32_t ulSubscriptions[] = { 16, 64, mqttbenchmarkMAX_SUBSCRIPTIONS };
+    uint32_t x;
+
+    for( x = 0; x < ( sizeof( ulSubscriptions ) / sizeof( ulSubscriptions[ 0 ] ) ); x++ )
+    {
+        if( ulSubscriptions[ x ] <= ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS )
+        {
+            prvDispatchBenchmark( ulSubscriptions[ x ] );
+        }
+        else
+        {
+            configPRINTF( ( "Dispatch with %u subscriptions skipped, mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS is %u\r\n",
+                            ulSubscriptions[ x ],
+                            ( uint32_t ) mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_MQTT_BENCHMARK, PublishZeroCopy )
+{
+    #if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 )
+        uint32_t ulCopyMS, ulZeroCopyMS, ulPayloadLength;
+
+        /* Publish does not need a broker, the sent data is dropped. */
+        xBenchmarkContext.xConnectionState = eMQTTConnected;
+
+        ulCopyMS = prvPublishBenchmark( mqttbenchmarkSMALL_PAYLOAD_LENGTH, eMQTTFalse );
+        ulZeroCopyMS = prvPublishBenchmark( mqttbenchmarkSMALL_PAYLOAD_LENGTH, eMQTTTrue );
+
+        configPRINTF( ( "Publish of %u bytes: copy %u ns, zero-copy %u ns per message\r\n",
+                        ( uint32_t ) mqttbenchmarkSMALL_PAYLOAD_LENGTH,
+                        ( uint32_t ) ( ( ( uint64_t ) ulCopyMS * 1000000ULL ) / mqttbenchmarkPUBLISHES ),
+                        ( uint32_t ) ( ( ( uint64_t ) ulZeroCopyMS * 1000000ULL ) / mqttbenchmarkPUBLISHES ) ) );
+
+        /* Larger payloads do not fit in a buffer of the buffer pool. */
+        for( ulPayloadLength = 8192UL; ulPayloadLength <= mqttbenchmarkMAX_PAYLOAD_LENGTH; ulPayloadLength *= 8UL )
+        {
+            ulZeroCopyMS = prvPublishBenchmark( ulPayloadLength, eMQTTTrue );
+
+            configPRINTF( ( "Publish of %u bytes: zero-copy %u ns per message\r\n",
+                            ulPayloadLength,
+                            ( uint32_t ) ( ( ( uint64_t ) ulZeroCopyMS * 1000000ULL ) / mqttbenchmarkPUBLISHES ) ) );
+        }
+    #endif /* if ( mqttconfigENABLE_ZERO_COPY_PUBLISH == 1 ) */
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_MQTT_BENCHMARK, OfflineSpool )
+{
+    #if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 )
+        MQTTOfflineRamFlash_t xRamFlash;
+        uint32_t ulSpoolMS;
+
+        #ifdef mqttbenchmarkSPOOL_FILE_NAME
+            MQTTOfflineFileFlash_t xFileFlash;
+            const MQTTOfflineFlashInterface_t * pxFileFlash;
+        #endif
+
+        memset( ulSpoolMemory, 0xFF, sizeof( ulSpoolMemory ) );
+        ulSpoolMS = prvSpoolBenchmark( MQTT_OfflineRamFlashInit( &( xRamFlash ),
+                                                                 ( uint8_t * ) ulSpoolMemory,
+                                                                 mqttbenchmarkSPOOL_BLOCK_SIZE,
+                                                                 mqttbenchmarkSPOOL_BLOCK_COUNT ) );
+
+        configPRINTF( ( "Offline spool of %u bytes in RAM: %u ns per message pushed and removed\r\n",
+                        ( uint32_t ) mqttbenchmarkSPOOL_PAYLOAD_LENGTH,
+                        ( uint32_t ) ( ( ( uint64_t ) ulSpoolMS * 1000000ULL ) / mqttbenchmarkSPOOL_MESSAGES ) ) );
+
+        #ifdef mqttbenchmarkSPOOL_FILE_NAME
+            pxFileFlash = MQTT_OfflineFileFlashOpen( &( xFileFlash ),
+                                                     mqttbenchmarkSPOOL_FILE_NAME,
+                                                     mqttbenchmarkSPOOL_BLOCK_SIZE,
+                                                     mqttbenchmarkSPOOL_BLOCK_COUNT );
+            TEST_ASSERT_NOT_NULL( pxFileFlash );
+
+            ulSpoolMS = prvSpoolBenchmark( pxFileFlash );
+            MQTT_OfflineFileFlashClose( &( xFileFlash ) );
+
+            configPRINTF( ( "Offline spool of %u bytes in file %s: %u ns per message pushed and removed\r\n",
+                            ( uint32_t ) mqttbenchmarkSPOOL_PAYLOAD_LENGTH,
+                            mqttbenchmarkSPOOL_FILE_NAME,
+                            ( uint32_t ) ( ( ( uint64_t ) ulSpoolMS * 1000000ULL ) / mqttbenchmarkSPOOL_MESSAGES ) ) );
+        #endif /* mqttbenchmarkSPOOL_FILE_NAME */
+    #endif /* if ( mqttconfigENABLE_OFFLINE_QUEUE == 1 ) */
+}
+/*-----------------------------------------------------------*/
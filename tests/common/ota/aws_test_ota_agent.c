@@ -37,6 +37,9 @@
 #include "aws_ota_agent.h"
 #include "aws_clientcredential.h"
 #include "aws_ota_agent_internal.h"
+#include "aws_ota_pal.h"
+#include "aws_ota_cbor_internal.h"
+#include "cbor.h"
 
 /* MQTT includes. */
 #include "aws_mqtt_agent.h"
@@ -176,6 +179,12 @@ TEST_GROUP_RUNNER( Full_OTA_AGENT )
     RUN_TEST_CASE( Full_OTA_AGENT, OTA_SetImageState_InvalidParams );
     RUN_TEST_CASE( Full_OTA_AGENT, prvParseJobDocFromJSONandPrvOTA_Close );
     RUN_TEST_CASE( Full_OTA_AGENT, prvParseJSONbyModel_Errors );
+    #if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+        RUN_TEST_CASE( Full_OTA_AGENT, prvSignatureUpdate_ReorderBlocks );
+    #endif
+    #if ( otaconfigENABLE_RESUME == 1 )
+        RUN_TEST_CASE( Full_OTA_AGENT, prvResumeLoad_AfterAgentKilled );
+    #endif
 }
 
 TEST( Full_OTA_AGENT, OTA_SetImageState_InvalidParams )
@@ -373,3 +382,247 @@ TEST( Full_OTA_AGENT, prvParseJSONbyModel_Errors )
     /* Shut down the OTA Agent. */
     ( void ) OTA_AgentShutdown( pdMS_TO_TICKS( otatestSHUTDOWN_WAIT ) );
 }
+
+#if ( otaconfigENABLE_STREAMING_SIGNATURE_CHECK == 1 )
+    TEST( Full_OTA_AGENT, prvSignatureUpdate_ReorderBlocks )
+    {
+        static uint8_t ucBlock[ OTA_FILE_BLOCK_SIZE ];
+        OTA_FileContext_t xContext;
+        uint32_t ulBlock;
+
+        memset( &xContext, 0, sizeof( xContext ) );
+        xContext.ulFileSize = ( 4UL * otaconfigSIGNATURE_REORDER_BLOCKS * OTA_FILE_BLOCK_SIZE ) - 1UL;
+
+        TEST_OTA_prvSignatureStart( &xContext );
+        TEST_ASSERT_NOT_NULL( xContext.pvSigVerifyContext );
+
+        if( TEST_PROTECT() )
+        {
+            /* A block received ahead of the next one to hash waits for it. */
+            TEST_OTA_prvSignatureUpdate( &xContext, 1UL, ucBlock, OTA_FILE_BLOCK_SIZE );
+            TEST_ASSERT_EQUAL_UINT32( 0UL, xContext.ulHashedBlocks );
+            TEST_OTA_prvSignatureUpdate( &xContext, 0UL, ucBlock, OTA_FILE_BLOCK_SIZE );
+            TEST_ASSERT_EQUAL_UINT32( 2UL, xContext.ulHashedBlocks );
+            TEST_ASSERT_EQUAL_UINT32( 0UL, xContext.ulReorderMask );
+
+            /* As many blocks as the reorder buffer holds can be kept. */
+            for( ulBlock = 3UL; ulBlock <= ( 2UL + otaconfigSIGNATURE_REORDER_BLOCKS ); ulBlock++ )
+            {
+                TEST_OTA_prvSignatureUpdate( &xContext, ulBlock, ucBlock, OTA_FILE_BLOCK_SIZE );
+            }
+
+            TEST_ASSERT_EQUAL_UINT32( 2UL, xContext.ulHashedBlocks );
+            TEST_OTA_prvSignatureUpdate( &xContext, 2UL, ucBlock, OTA_FILE_BLOCK_SIZE );
+            TEST_ASSERT_EQUAL_UINT32( 3UL + otaconfigSIGNATURE_REORDER_BLOCKS, xContext.ulHashedBlocks );
+            TEST_ASSERT_EQUAL_UINT32( 0UL, xContext.ulReorderMask );
+
+            /* A block further ahead stops the hashing. */
+            ulBlock = xContext.ulHashedBlocks + otaconfigSIGNATURE_REORDER_BLOCKS + 1UL;
+            TEST_OTA_prvSignatureUpdate( &xContext, ulBlock, ucBlock, OTA_FILE_BLOCK_SIZE );
+            TEST_ASSERT_NULL( xContext.pvSigVerifyContext );
+            TEST_ASSERT_NULL( xContext.pucReorderBuffer );
+        }
+
+        TEST_OTA_prvSignatureStop( &xContext );
+    }
+#endif /* otaconfigENABLE_STREAMING_SIGNATURE_CHECK */
+
+#if ( otaconfigENABLE_RESUME == 1 )
+
+/**
+ * @brief Number of blocks of the test file.
+ */
+    #define otatestNUM_BLOCKS    ( ( otatestFILE_SIZE + ( OTA_FILE_BLOCK_SIZE - 1UL ) ) / OTA_FILE_BLOCK_SIZE )
+
+/**
+ * @brief Length of the block bitmap of the test file.
+ */
+    #define otatestBITMAP_LEN    ( ( otatestNUM_BLOCKS + ( BITS_PER_BYTE - 1UL ) ) / BITS_PER_BYTE )
+
+/**
+ * @brief Start receiving the file of the test job, with all its blocks missing, as the
+ * OTA agent does when it receives the job.
+ */
+    static OTA_FileContext_t * prvStartResumeTestFile( void )
+    {
+        OTA_FileContext_t * pxUpdateFile = TEST_OTA_prvParseJobDoc( otatestLASER_JSON, sizeof( otatestLASER_JSON ) );
+
+        if( pxUpdateFile != NULL )
+        {
+            pxUpdateFile->pucRxBlockBitmap = ( uint8_t * ) pvPortMalloc( otatestBITMAP_LEN );
+
+            if( pxUpdateFile->pucRxBlockBitmap != NULL )
+            {
+                memset( pxUpdateFile->pucRxBlockBitmap, 0xff, otatestBITMAP_LEN );
+
+                if( ( otatestNUM_BLOCKS % BITS_PER_BYTE ) != 0UL )
+                {
+                    pxUpdateFile->pucRxBlockBitmap[ otatestBITMAP_LEN - 1UL ] = ( uint8_t ) ( ( 1UL << ( otatestNUM_BLOCKS % BITS_PER_BYTE ) ) - 1UL );
+                }
+
+                pxUpdateFile->ulBlocksRemaining = otatestNUM_BLOCKS;
+            }
+        }
+
+        return pxUpdateFile;
+    }
+
+/**
+ * @brief Ingest a block of the test file, in a stream data message as the OTA service
+ * sends it.
+ */
+    static IngestResult_t prvIngestResumeTestBlock( OTA_FileContext_t * pxUpdateFile,
+                                                    uint32_t ulBlockIndex )
+    {
+        static uint8_t ucBlock[ OTA_FILE_BLOCK_SIZE ];
+        static uint8_t ucMessage[ OTA_FILE_BLOCK_SIZE + 64 ];
+        CborEncoder xEncoder, xMapEncoder;
+        CborError xCborResult;
+        OTA_Err_t xCloseResult;
+
+        memset( ucBlock, ( int ) ulBlockIndex, sizeof( ucBlock ) );
+
+        cbor_encoder_init( &xEncoder, ucMessage, sizeof( ucMessage ), 0 );
+        xCborResult = cbor_encoder_create_map( &xEncoder, &xMapEncoder, 4 );
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_FILEID_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, otatestFILE_ID );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKID_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, ulBlockIndex );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKSIZE_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, sizeof( ucBlock ) );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKPAYLOAD_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_byte_string( &xMapEncoder, ucBlock, sizeof( ucBlock ) );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encoder_close_container_checked( &xEncoder, &xMapEncoder );
+        }
+
+        TEST_ASSERT_EQUAL( CborNoError, xCborResult );
+
+        return TEST_OTA_prvIngestDataBlock( pxUpdateFile,
+                                            ( const char * ) ucMessage,
+                                            cbor_encoder_get_buffer_size( &xEncoder, ucMessage ),
+                                            &xCloseResult );
+    }
+
+/**
+ * @brief Restart the OTA agent, which forgets the active job as a reset does.
+ */
+    static void prvRestartResumeTestAgent( void )
+    {
+        TEST_ASSERT_EQUAL_INT( eOTA_AgentState_NotReady, OTA_AgentShutdown( pdMS_TO_TICKS( otatestSHUTDOWN_WAIT ) ) );
+        TEST_ASSERT_EQUAL_INT( eOTA_AgentState_Ready, OTA_AgentInit( xMQTTClientHandle,
+                                                                     ( const uint8_t * ) clientcredentialIOT_THING_NAME,
+                                                                     vOTACompleteCallback,
+                                                                     pdMS_TO_TICKS( otatestAGENT_INIT_WAIT ) ) );
+    }
+
+    TEST( Full_OTA_AGENT, prvResumeLoad_AfterAgentKilled )
+    {
+        OTA_State_t eOtaStatus;
+        OTA_FileContext_t * pxUpdateFile = NULL;
+        uint32_t ulReceived = otaconfigRESUME_SAVE_BLOCKS + ( otaconfigRESUME_SAVE_BLOCKS / 2UL );
+        uint32_t ulBlock;
+
+        /* The test receives some blocks after the first save, and not the last block. */
+        TEST_ASSERT_TRUE( ulReceived < otatestNUM_BLOCKS );
+
+        eOtaStatus = OTA_AgentInit(
+            xMQTTClientHandle,
+            ( const uint8_t * ) clientcredentialIOT_THING_NAME,
+            vOTACompleteCallback,
+            pdMS_TO_TICKS( otatestAGENT_INIT_WAIT ) );
+        TEST_ASSERT_EQUAL_INT( eOTA_AgentState_Ready, eOtaStatus );
+
+        TEST_OTA_prvResumeErase();
+
+        if( TEST_PROTECT() )
+        {
+            /* Nothing is resumed without a saved state, so the file is created. */
+            pxUpdateFile = prvStartResumeTestFile();
+            TEST_ASSERT_NOT_NULL( pxUpdateFile );
+            TEST_ASSERT_NOT_NULL( pxUpdateFile->pucRxBlockBitmap );
+            TEST_ASSERT_FALSE( TEST_OTA_prvResumeLoad( pxUpdateFile, otatestBITMAP_LEN ) );
+            TEST_ASSERT_EQUAL_UINT32( kOTA_Err_None, prvPAL_CreateFileForRx( pxUpdateFile ) );
+
+            for( ulBlock = 0UL; ulBlock < ulReceived; ulBlock++ )
+            {
+                TEST_ASSERT_EQUAL_INT( eIngest_Result_Accepted_Continue, prvIngestResumeTestBlock( pxUpdateFile, ulBlock ) );
+            }
+
+            /* Kill the agent mid-transfer: the context is lost without the download being
+             * aborted, and the blocks received since the last save are not saved. */
+            TEST_OTA_prvOTA_Close( pxUpdateFile );
+            prvRestartResumeTestAgent();
+
+            /* After the restart, the same job resumes the download from the last save. */
+            pxUpdateFile = prvStartResumeTestFile();
+            TEST_ASSERT_NOT_NULL( pxUpdateFile );
+            TEST_ASSERT_NOT_NULL( pxUpdateFile->pucRxBlockBitmap );
+            TEST_ASSERT_TRUE( TEST_OTA_prvResumeLoad( pxUpdateFile, otatestBITMAP_LEN ) );
+            TEST_ASSERT_NOT_NULL( pxUpdateFile->pucFile );
+            TEST_ASSERT_EQUAL_UINT32( otatestNUM_BLOCKS - otaconfigRESUME_SAVE_BLOCKS, pxUpdateFile->ulBlocksRemaining );
+
+            /* Only the missing blocks are received again. */
+            TEST_ASSERT_EQUAL_INT( eIngest_Result_Duplicate_Continue, prvIngestResumeTestBlock( pxUpdateFile, 0UL ) );
+            TEST_ASSERT_EQUAL_INT( eIngest_Result_Duplicate_Continue, prvIngestResumeTestBlock( pxUpdateFile, otaconfigRESUME_SAVE_BLOCKS - 1UL ) );
+            TEST_ASSERT_EQUAL_INT( eIngest_Result_Accepted_Continue, prvIngestResumeTestBlock( pxUpdateFile, otaconfigRESUME_SAVE_BLOCKS ) );
+            TEST_OTA_prvOTA_Close( pxUpdateFile );
+            prvRestartResumeTestAgent();
+
+            /* The saved state doesn't resume the download of another file, and is erased. */
+            pxUpdateFile = prvStartResumeTestFile();
+            TEST_ASSERT_NOT_NULL( pxUpdateFile );
+            TEST_ASSERT_NOT_NULL( pxUpdateFile->pucRxBlockBitmap );
+            pxUpdateFile->ulServerFileID++;
+            TEST_ASSERT_FALSE( TEST_OTA_prvResumeLoad( pxUpdateFile, otatestBITMAP_LEN ) );
+            pxUpdateFile->ulServerFileID--;
+            TEST_ASSERT_FALSE( TEST_OTA_prvResumeLoad( pxUpdateFile, otatestBITMAP_LEN ) );
+            TEST_ASSERT_EQUAL_UINT32( otatestNUM_BLOCKS, pxUpdateFile->ulBlocksRemaining );
+        }
+
+        if( pxUpdateFile != NULL )
+        {
+            TEST_OTA_prvOTA_Close( pxUpdateFile );
+            pxUpdateFile = NULL;
+        }
+
+        TEST_OTA_prvResumeErase();
+
+        eOtaStatus = OTA_AgentShutdown( pdMS_TO_TICKS( otatestSHUTDOWN_WAIT ) );
+        TEST_ASSERT_EQUAL_INT( eOTA_AgentState_NotReady, eOtaStatus );
+    }
+#endif /* otaconfigENABLE_RESUME */
@@ -0,0 +1,752 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_ota_agent_benchmark.c
+ * @brief End-to-end benchmark of the OTA agent receiving a file.
+ *
+ * The OTA agent task receives a job and then the file of the job through the
+ * MQTT agent, as it does from AWS IoT. It writes the file through the OTA PAL
+ * of the device. Once the last block is received, the PAL closes the file and
+ * checks its signature, and the agent reports the job completed.
+ *
+ * The test task is the stand-in for the jobs and stream services. It is
+ * connected to the same MQTT broker as the agent, with a client of its own. It
+ * publishes the job document of each transfer on the job notification topic.
+ * It answers each stream request with the data messages of the blocks
+ * requested, in order. It does not send some of the messages and sends some of
+ * them twice, as an MQTT broker does when it loses a message or sends a QoS 1
+ * message again. Every block may be lost, the last one included, and the agent
+ * requests the missing blocks again once its request timer expires. The
+ * stand-in encodes the data messages of every block before the transfers. It
+ * signs the file with otabenchmarkAGENT_SIGNER_KEY_FILE, the private key of
+ * otatestpalCERTIFICATE_FILE.
+ *
+ * The benchmark needs a broker which delivers the messages of the stand-in to
+ * the agent, such as the loopback broker of the Linux test runner.
+ *
+ * The benchmark reports the blocks received per second, from the first stream
+ * request of a transfer to the completion of its job, and the number of stream
+ * requests. It also reports the data messages sent more than once, as a
+ * percentage of the blocks of the file. Last, it reports the CPU time spent
+ * for each data message sent. This time is measured with clock(), so it
+ * includes all the threads of the process: the agent, the PAL, the MQTT broker
+ * and the stand-in. The results are printed with configPRINTF.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* Credential includes. */
+#include "aws_clientcredential.h"
+
+/* MQTT includes. */
+#include "aws_mqtt_agent.h"
+
+/* OTA includes. */
+#include "aws_ota_agent.h"
+#include "aws_ota_agent_internal.h"
+#include "aws_ota_cbor.h"
+#include "aws_ota_cbor_internal.h"
+#include "aws_test_ota_config.h"
+
+/* CBOR includes. */
+#include "cbor.h"
+
+/* mbed TLS includes. */
+#include "mbedtls/base64.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+/**
+ * @brief Size of the file received. The last block is shorter than the
+ * others.
+ *
+ * @note Must be at most 1024 blocks, the largest file the OTA agent receives.
+ * The file and the data messages of every block are kept in RAM.
+ */
+#ifndef otabenchmarkAGENT_FILE_SIZE
+    #define otabenchmarkAGENT_FILE_SIZE         ( ( 128UL * 1024UL ) - 300UL )
+#endif
+
+/**
+ * @brief Path of the file received.
+ */
+#ifndef otabenchmarkAGENT_FILE_PATH
+    #define otabenchmarkAGENT_FILE_PATH         "ota_benchmark.bin"
+#endif
+
+/**
+ * @brief Path of the PEM private key of otatestpalCERTIFICATE_FILE, which
+ * signs the file received.
+ */
+#ifndef otabenchmarkAGENT_SIGNER_KEY_FILE
+    #define otabenchmarkAGENT_SIGNER_KEY_FILE   "ecdsa-sha256-signer.key.pem"
+#endif
+
+/**
+ * @brief Number of times the file is received for each loss rate, to measure
+ * the time taken.
+ */
+#ifndef otabenchmarkAGENT_REPEAT
+    #define otabenchmarkAGENT_REPEAT            ( 4UL )
+#endif
+
+/**
+ * @brief Milliseconds the stand-in waits for a stream request or the end of
+ * the job before the transfer is given up.
+ */
+#define otabenchmarkAGENT_WAIT_MS               ( 10000UL )
+
+/**
+ * @brief Milliseconds to wait for the OTA agent to start and to shut down.
+ */
+#define otabenchmarkAGENT_INIT_WAIT_MS          ( 10000UL )
+
+/**
+ * @brief ID of the file in the stream.
+ */
+#define otabenchmarkAGENT_FILE_ID               ( 0 )
+
+/**
+ * @brief Number of blocks of the file received.
+ */
+#define otabenchmarkAGENT_BLOCKS                ( ( otabenchmarkAGENT_FILE_SIZE + ( OTA_FILE_BLOCK_SIZE - 1UL ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE )
+
+/**
+ * @brief Size of the block bitmap of the file received.
+ */
+#define otabenchmarkAGENT_BITMAP_SIZE           ( ( otabenchmarkAGENT_BLOCKS + ( BITS_PER_BYTE - 1UL ) ) >> LOG2_BITS_PER_BYTE )
+
+/**
+ * @brief Size of the buffer each data message is encoded in.
+ */
+#define otabenchmarkAGENT_MESSAGE_SIZE          ( OTA_FILE_BLOCK_SIZE + 64UL )
+
+/**
+ * @brief Size of the buffer a stream request is copied to.
+ */
+#define otabenchmarkAGENT_REQUEST_SIZE          ( 512UL )
+
+/**
+ * @brief Number of events the stand-in may have to process.
+ */
+#define otabenchmarkAGENT_EVENT_QUEUE_LENGTH    ( 4UL )
+
+/**
+ * @brief Size of the buffers of the job document, of the topics and of the
+ * signature.
+ */
+#define otabenchmarkAGENT_JOB_SIZE              ( 1024UL )
+#define otabenchmarkAGENT_TOPIC_SIZE            ( 256UL )
+#define otabenchmarkAGENT_SIGNATURE_SIZE        ( 256UL )
+#define otabenchmarkAGENT_KEY_SIZE              ( 2048UL )
+
+/**
+ * @brief Topic filter of the stream requests of any Thing, for any stream.
+ */
+#define otabenchmarkAGENT_REQUEST_TOPIC_FILTER  "$aws/things/+/streams/+/get/cbor"
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Type of an event processed by the stand-in.
+ */
+typedef enum AgentEventType
+{
+    eAgentEventRequest, /**< The OTA agent sent a stream request. */
+    eAgentEventJobDone  /**< The OTA agent completed the job. */
+} AgentEventType_t;
+
+/**
+ * @brief An event processed by the stand-in.
+ */
+typedef struct AgentEvent
+{
+    AgentEventType_t eType;                             /**< Type of the event. */
+    OTA_JobEvent_t eJobEvent;                           /**< Result of the job completed. */
+    uint32_t ulRequestSize;                             /**< Size of the stream request. */
+    uint8_t ucRequest[ otabenchmarkAGENT_REQUEST_SIZE ]; /**< The stream request. */
+} AgentEvent_t;
+
+/**
+ * @brief The results of the transfers for a loss rate.
+ */
+typedef struct AgentResult
+{
+    TickType_t xDuration;  /**< Time taken to receive the file the given number of times. */
+    clock_t xCPUTime;      /**< CPU time spent by the process during the transfers. */
+    uint32_t ulRequests;   /**< Number of stream requests received. */
+    uint32_t ulSent;       /**< Number of data messages sent. */
+} AgentResult_t;
+
+/**
+ * @brief The MQTT clients of the OTA agent and of the stand-in.
+ */
+static MQTTAgentHandle_t xAgentClient = NULL;
+static MQTTAgentHandle_t xCloudClient = NULL;
+
+/**
+ * @brief The events of the stand-in, sent by the callbacks of its stream
+ * requests subscription and of the OTA agent. The MQTT agent API can't be
+ * called from a callback, so the stand-in answers in the test task.
+ */
+static QueueHandle_t xEventQueue = NULL;
+
+/**
+ * @brief The file received, its signature encoded in base 64, and the data
+ * messages of its blocks.
+ */
+static uint8_t * pucFile;
+static char cSignature[ otabenchmarkAGENT_SIGNATURE_SIZE ];
+static uint8_t * pucMessages;
+static uint32_t ulMessageLengths[ otabenchmarkAGENT_BLOCKS ];
+
+/**
+ * @brief Name of the stream of the current transfer. Each transfer has a
+ * stream of its own, so the messages of a completed transfer which are still
+ * delivered aren't received as blocks of the next one.
+ */
+static char cStreamName[ 32 ];
+
+/**
+ * @brief State of the pseudo random numbers deciding which messages are lost
+ * or delivered twice, and of those used to sign the file.
+ */
+static uint32_t ulRandom;
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns the next pseudo random number, from 0 to 32767.
+ */
+static uint32_t prvRandom( void )
+{
+    ulRandom = ( ulRandom * 1103515245UL ) + 12345UL;
+
+    return ( ulRandom >> 16 ) & 0x7fffUL;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Random number generator of the signature. The signature only needs
+ * to be valid, not secure.
+ */
+static int prvSignatureRandom( void * pvContext,
+                               unsigned char * pucOutput,
+                               size_t xLength )
+{
+    size_t x;
+
+    ( void ) pvContext;
+
+    for( x = 0; x < xLength; x++ )
+    {
+        pucOutput[ x ] = ( unsigned char ) prvRandom();
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Signs the file with the private key of the code signing certificate,
+ * as the signature of a job document.
+ */
+static void prvSignFile( void )
+{
+    static uint8_t ucKey[ otabenchmarkAGENT_KEY_SIZE ];
+    uint8_t ucHash[ 32 ];
+    uint8_t ucDER[ MBEDTLS_ECDSA_MAX_LEN ];
+    size_t xKeySize, xDERSize = 0, xSignatureSize = 0;
+    mbedtls_pk_context xKey;
+    FILE * pxKeyFile;
+    int lResult;
+
+    pxKeyFile = fopen( otabenchmarkAGENT_SIGNER_KEY_FILE, "rb" );
+    TEST_ASSERT_NOT_NULL_MESSAGE( pxKeyFile, "Unable to open otabenchmarkAGENT_SIGNER_KEY_FILE." );
+    xKeySize = fread( ucKey, 1, sizeof( ucKey ) - 1U, pxKeyFile );
+    ( void ) fclose( pxKeyFile );
+
+    /* A PEM key is parsed with its terminating zero. */
+    ucKey[ xKeySize ] = 0U;
+
+    mbedtls_pk_init( &xKey );
+    lResult = mbedtls_pk_parse_key( &xKey, ucKey, xKeySize + 1U, NULL, 0 );
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_sha256_ret( pucFile, otabenchmarkAGENT_FILE_SIZE, ucHash, 0 );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_pk_sign( &xKey, MBEDTLS_MD_SHA256, ucHash, sizeof( ucHash ), ucDER, &xDERSize, prvSignatureRandom, NULL );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_base64_encode( ( unsigned char * ) cSignature, sizeof( cSignature ), &xSignatureSize, ucDER, xDERSize );
+    }
+
+    mbedtls_pk_free( &xKey );
+    TEST_ASSERT_EQUAL_INT_MESSAGE( 0, lResult, "Unable to sign the file." );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generates the file, signs it, and encodes the data message of each of
+ * its blocks, as the stream service sends it.
+ */
+static void prvEncodeMessages( void )
+{
+    CborEncoder xEncoder, xMapEncoder;
+    CborError xCborResult;
+    uint32_t ulBlock, ulByte, ulBlockSize;
+    uint8_t * pucMessage;
+
+    for( ulByte = 0; ulByte < otabenchmarkAGENT_FILE_SIZE; ulByte++ )
+    {
+        pucFile[ ulByte ] = ( uint8_t ) prvRandom();
+    }
+
+    prvSignFile();
+
+    for( ulBlock = 0; ulBlock < otabenchmarkAGENT_BLOCKS; ulBlock++ )
+    {
+        ulBlockSize = otabenchmarkAGENT_FILE_SIZE - ( ulBlock << otaconfigLOG2_FILE_BLOCK_SIZE );
+
+        if( ulBlockSize > OTA_FILE_BLOCK_SIZE )
+        {
+            ulBlockSize = OTA_FILE_BLOCK_SIZE;
+        }
+
+        pucMessage = &pucMessages[ ulBlock * otabenchmarkAGENT_MESSAGE_SIZE ];
+        cbor_encoder_init( &xEncoder, pucMessage, otabenchmarkAGENT_MESSAGE_SIZE, 0 );
+        xCborResult = cbor_encoder_create_map( &xEncoder, &xMapEncoder, 4 );
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_FILEID_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, otabenchmarkAGENT_FILE_ID );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKID_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, ulBlock );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKSIZE_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_int( &xMapEncoder, ulBlockSize );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_text_stringz( &xMapEncoder, OTA_CBOR_BLOCKPAYLOAD_KEY );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encode_byte_string( &xMapEncoder, &pucFile[ ulBlock << otaconfigLOG2_FILE_BLOCK_SIZE ], ulBlockSize );
+        }
+
+        if( CborNoError == xCborResult )
+        {
+            xCborResult = cbor_encoder_close_container_checked( &xEncoder, &xMapEncoder );
+        }
+
+        TEST_ASSERT_EQUAL( CborNoError, xCborResult );
+        ulMessageLengths[ ulBlock ] = ( uint32_t ) cbor_encoder_get_buffer_size( &xEncoder, pucMessage );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Callback of the stream requests subscription of the stand-in. Passes
+ * the requests to the test task.
+ */
+static MQTTBool_t prvRequestCallback( void * pvCallbackContext,
+                                      const MQTTPublishData_t * const pxPublishData )
+{
+    AgentEvent_t xEvent;
+
+    ( void ) pvCallbackContext;
+
+    if( pxPublishData->ulDataLength <= sizeof( xEvent.ucRequest ) )
+    {
+        xEvent.eType = eAgentEventRequest;
+        xEvent.ulRequestSize = pxPublishData->ulDataLength;
+        memcpy( xEvent.ucRequest, pxPublishData->pvData, pxPublishData->ulDataLength );
+
+        /* A request the stand-in has no room for is lost. */
+        ( void ) xQueueSendToBack( xEventQueue, &xEvent, 0 );
+    }
+
+    /* The buffer is returned to the MQTT agent. */
+    return eMQTTFalse;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Job complete callback of the OTA agent. Passes the result of the job
+ * to the test task. The new image isn't activated.
+ */
+static void prvJobCompleteCallback( OTA_JobEvent_t eEvent )
+{
+    AgentEvent_t xEvent;
+
+    xEvent.eType = eAgentEventJobDone;
+    xEvent.eJobEvent = eEvent;
+    xEvent.ulRequestSize = 0;
+
+    ( void ) xQueueSendToBack( xEventQueue, &xEvent, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publishes a message from the stand-in.
+ */
+static void prvCloudPublish( const char * pcTopic,
+                             const void * pvData,
+                             uint32_t ulDataLength,
+                             MQTTQoS_t xQoS )
+{
+    MQTTAgentPublishParams_t xPublishParams;
+
+    memset( &xPublishParams, 0x00, sizeof( xPublishParams ) );
+    xPublishParams.pucTopic = ( const uint8_t * ) pcTopic;
+    xPublishParams.usTopicLength = ( uint16_t ) strlen( pcTopic );
+    xPublishParams.xQoS = xQoS;
+    xPublishParams.pvData = pvData;
+    xPublishParams.ulDataLength = ulDataLength;
+
+    TEST_ASSERT_EQUAL_INT( eMQTTAgentSuccess, MQTT_AGENT_Publish( xCloudClient, &xPublishParams, pdMS_TO_TICKS( otabenchmarkAGENT_WAIT_MS ) ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publishes the job document of a transfer, as the jobs service
+ * notifies the next job.
+ */
+static void prvPublishJob( uint32_t ulJob )
+{
+    static char cJob[ otabenchmarkAGENT_JOB_SIZE ];
+    char cTopic[ otabenchmarkAGENT_TOPIC_SIZE ];
+    int lLength;
+
+    ( void ) snprintf( cStreamName, sizeof( cStreamName ), "benchmark%u", ( unsigned ) ulJob );
+
+    lLength = snprintf( cJob,
+                        sizeof( cJob ),
+                        "{\"clientToken\":\"rdy\",\"execution\":{\"jobId\":\"benchmark%u\",\"status\":\"QUEUED\",\"jobDocument\":{\"afr_ota\":{"
+                        "\"streamname\":\"%s\",\"files\":[{\"filepath\":\"%s\",\"filesize\":%u,\"fileid\":%d,\"certfile\":\"%s\",\"%s\":\"%s\"}]}}}}",
+                        ( unsigned ) ulJob,
+                        cStreamName,
+                        otabenchmarkAGENT_FILE_PATH,
+                        ( unsigned ) otabenchmarkAGENT_FILE_SIZE,
+                        otabenchmarkAGENT_FILE_ID,
+                        otatestpalCERTIFICATE_FILE,
+                        cOTA_JSON_FileSignatureKey,
+                        cSignature );
+    TEST_ASSERT_TRUE( ( lLength > 0 ) && ( lLength < ( int ) sizeof( cJob ) ) );
+
+    ( void ) snprintf( cTopic, sizeof( cTopic ), "$aws/things/%s/jobs/notify-next", clientcredentialIOT_THING_NAME );
+    prvCloudPublish( cTopic, cJob, ( uint32_t ) lLength, eMQTTQoS1 );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Serves a stream request as the stand-in for the stream service: sends
+ * the data messages of the blocks requested, losing some of them and
+ * delivering some of them twice.
+ */
+static void prvServeRequest( const uint8_t * pucRequest,
+                             size_t xRequestSize,
+                             uint32_t ulLossPermille,
+                             AgentResult_t * pxResult )
+{
+    uint8_t ucBitmap[ otabenchmarkAGENT_BITMAP_SIZE + OTA_WINDOW_BITMAP_SIZE ];
+    size_t xBitmapSize = sizeof( ucBitmap );
+    char cTopic[ otabenchmarkAGENT_TOPIC_SIZE ];
+    CborParser xParser;
+    CborValue xMap, xValue;
+    int lFileId = -1, lOffset = -1;
+    uint32_t ulBit, ulBlock;
+
+    TEST_ASSERT_EQUAL( CborNoError, cbor_parser_init( pucRequest, xRequestSize, 0, &xParser, &xMap ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_map_find_value( &xMap, OTA_CBOR_FILEID_KEY, &xValue ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_get_int( &xValue, &lFileId ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_map_find_value( &xMap, OTA_CBOR_BLOCKOFFSET_KEY, &xValue ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_get_int( &xValue, &lOffset ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_map_find_value( &xMap, OTA_CBOR_BLOCKBITMAP_KEY, &xValue ) );
+    TEST_ASSERT_EQUAL( CborNoError, cbor_value_copy_byte_string( &xValue, ucBitmap, &xBitmapSize, NULL ) );
+    TEST_ASSERT_EQUAL_INT( otabenchmarkAGENT_FILE_ID, lFileId );
+    TEST_ASSERT_TRUE( lOffset >= 0 );
+
+    ( void ) snprintf( cTopic, sizeof( cTopic ), "$aws/things/%s/streams/%s/data/cbor", clientcredentialIOT_THING_NAME, cStreamName );
+
+    for( ulBit = 0; ulBit < ( xBitmapSize * BITS_PER_BYTE ); ulBit++ )
+    {
+        ulBlock = ( uint32_t ) lOffset + ulBit;
+
+        if( ( ulBlock < otabenchmarkAGENT_BLOCKS ) &&
+            ( ( ucBitmap[ ulBit >> LOG2_BITS_PER_BYTE ] & ( 1U << ( ulBit % BITS_PER_BYTE ) ) ) != 0U ) &&
+            ( ( prvRandom() % 1000UL ) >= ulLossPermille ) )
+        {
+            prvCloudPublish( cTopic, &pucMessages[ ulBlock * otabenchmarkAGENT_MESSAGE_SIZE ], ulMessageLengths[ ulBlock ], eMQTTQoS0 );
+            pxResult->ulSent++;
+
+            /* The broker delivers a message twice as often as it loses one. */
+            if( ( prvRandom() % 1000UL ) < ulLossPermille )
+            {
+                prvCloudPublish( cTopic, &pucMessages[ ulBlock * otabenchmarkAGENT_MESSAGE_SIZE ], ulMessageLengths[ ulBlock ], eMQTTQoS0 );
+                pxResult->ulSent++;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Sends the file to the OTA agent the given number of times, with the
+ * given proportion of the data messages lost.
+ */
+static void prvAgentBenchmark( uint32_t ulLossPermille,
+                               AgentResult_t * pxResult )
+{
+    static AgentEvent_t xEvent;
+    static uint32_t ulJob = 0;
+    TickType_t xStart = 0;
+    clock_t xCPUStart = 0;
+    BaseType_t xDone;
+    uint32_t ulRun, ulFirstRequest;
+
+    memset( pxResult, 0x00, sizeof( AgentResult_t ) );
+    ulRandom = 1;
+
+    for( ulRun = 0; ulRun < otabenchmarkAGENT_REPEAT; ulRun++ )
+    {
+        ulFirstRequest = pxResult->ulRequests;
+        xDone = pdFALSE;
+
+        prvPublishJob( ulJob++ );
+
+        while( xDone == pdFALSE )
+        {
+            TEST_ASSERT_EQUAL_MESSAGE( pdPASS,
+                                       xQueueReceive( xEventQueue, &xEvent, pdMS_TO_TICKS( otabenchmarkAGENT_WAIT_MS ) ),
+                                       "The transfer did not complete." );
+
+            if( xEvent.eType == eAgentEventRequest )
+            {
+                /* The transfer starts with its first request. */
+                if( pxResult->ulRequests == ulFirstRequest )
+                {
+                    xStart = xTaskGetTickCount();
+                    xCPUStart = clock();
+                }
+
+                pxResult->ulRequests++;
+                prvServeRequest( xEvent.ucRequest, xEvent.ulRequestSize, ulLossPermille, pxResult );
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL_INT_MESSAGE( eOTA_JobEvent_Activate, xEvent.eJobEvent, "The file was not received." );
+                TEST_ASSERT_TRUE( pxResult->ulRequests > ulFirstRequest );
+
+                pxResult->xDuration += xTaskGetTickCount() - xStart;
+                pxResult->xCPUTime += clock() - xCPUStart;
+                xDone = pdTRUE;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Creates an MQTT client connected to the broker.
+ */
+static MQTTAgentHandle_t prvConnect( const char * pcClientId )
+{
+    MQTTAgentHandle_t xClient = NULL;
+    MQTTAgentConnectParams_t xConnectParams;
+
+    TEST_ASSERT_EQUAL_INT( eMQTTAgentSuccess, MQTT_AGENT_Create( &xClient ) );
+
+    memset( &xConnectParams, 0x00, sizeof( xConnectParams ) );
+    xConnectParams.pucClientId = ( const uint8_t * ) pcClientId;
+    xConnectParams.usClientIdLength = ( uint16_t ) strlen( pcClientId );
+    xConnectParams.pcURL = clientcredentialMQTT_BROKER_ENDPOINT;
+    xConnectParams.usPort = clientcredentialMQTT_BROKER_PORT;
+    xConnectParams.xFlags = mqttagentREQUIRE_TLS;
+
+    if( MQTT_AGENT_Connect( xClient, &xConnectParams, pdMS_TO_TICKS( otabenchmarkAGENT_INIT_WAIT_MS ) ) != eMQTTAgentSuccess )
+    {
+        ( void ) MQTT_AGENT_Delete( xClient );
+        xClient = NULL;
+    }
+
+    TEST_ASSERT_NOT_NULL_MESSAGE( xClient, "Failed to connect to the MQTT broker." );
+
+    return xClient;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Disconnects and deletes an MQTT client.
+ */
+static void prvDisconnect( MQTTAgentHandle_t xClient )
+{
+    if( xClient != NULL )
+    {
+        ( void ) MQTT_AGENT_Disconnect( xClient, pdMS_TO_TICKS( otabenchmarkAGENT_INIT_WAIT_MS ) );
+        ( void ) MQTT_AGENT_Delete( xClient );
+    }
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_OTA_AGENT_BENCHMARK );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_OTA_AGENT_BENCHMARK )
+{
+    static StaticQueue_t xStaticQueue;
+    static uint8_t ucQueueStorage[ otabenchmarkAGENT_EVENT_QUEUE_LENGTH * sizeof( AgentEvent_t ) ];
+    MQTTAgentSubscribeParams_t xSubscribeParams;
+
+    pucFile = ( uint8_t * ) pvPortMalloc( otabenchmarkAGENT_FILE_SIZE );
+    TEST_ASSERT_NOT_NULL( pucFile );
+    pucMessages = ( uint8_t * ) pvPortMalloc( otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_MESSAGE_SIZE );
+    TEST_ASSERT_NOT_NULL( pucMessages );
+
+    xEventQueue = xQueueCreateStatic( otabenchmarkAGENT_EVENT_QUEUE_LENGTH, sizeof( AgentEvent_t ), ucQueueStorage, &xStaticQueue );
+    TEST_ASSERT_NOT_NULL( xEventQueue );
+
+    /* The stand-in receives the stream requests of the agent. */
+    xCloudClient = prvConnect( "OTABenchmarkCloud" );
+
+    memset( &xSubscribeParams, 0x00, sizeof( xSubscribeParams ) );
+    xSubscribeParams.pucTopic = ( const uint8_t * ) otabenchmarkAGENT_REQUEST_TOPIC_FILTER;
+    xSubscribeParams.usTopicLength = ( uint16_t ) strlen( otabenchmarkAGENT_REQUEST_TOPIC_FILTER );
+    xSubscribeParams.xQoS = eMQTTQoS0;
+    xSubscribeParams.pxPublishCallback = prvRequestCallback;
+    xSubscribeParams.pvPublishCallbackContext = NULL;
+    TEST_ASSERT_EQUAL_INT( eMQTTAgentSuccess, MQTT_AGENT_Subscribe( xCloudClient, &xSubscribeParams, pdMS_TO_TICKS( otabenchmarkAGENT_INIT_WAIT_MS ) ) );
+
+    xAgentClient = prvConnect( clientcredentialIOT_THING_NAME );
+
+    TEST_ASSERT_EQUAL_INT( eOTA_AgentState_Ready,
+                           OTA_AgentInit( xAgentClient,
+                                          ( const uint8_t * ) clientcredentialIOT_THING_NAME,
+                                          prvJobCompleteCallback,
+                                          pdMS_TO_TICKS( otabenchmarkAGENT_INIT_WAIT_MS ) ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_OTA_AGENT_BENCHMARK )
+{
+    /* A failed transfer is aborted when the agent shuts down. */
+    TEST_ASSERT_EQUAL_INT( eOTA_AgentState_NotReady, OTA_AgentShutdown( pdMS_TO_TICKS( otabenchmarkAGENT_INIT_WAIT_MS ) ) );
+
+    prvDisconnect( xAgentClient );
+    xAgentClient = NULL;
+    prvDisconnect( xCloudClient );
+    xCloudClient = NULL;
+
+    ( void ) remove( otabenchmarkAGENT_FILE_PATH );
+
+    vPortFree( pucMessages );
+    pucMessages = NULL;
+    vPortFree( pucFile );
+    pucFile = NULL;
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_OTA_AGENT_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_OTA_AGENT_BENCHMARK, AgentThroughput );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_AGENT_BENCHMARK, AgentThroughput )
+{
+    static const uint32_t ulLossPermille[] = { 0, 10, 50 };
+    AgentResult_t xResult;
+    uint32_t x, ulMS;
+
+    prvEncodeMessages();
+
+    configPRINTF( ( "File of %u blocks of %u bytes received %u times by the OTA agent:\r\n",
+                    ( uint32_t ) otabenchmarkAGENT_BLOCKS,
+                    ( uint32_t ) OTA_FILE_BLOCK_SIZE,
+                    ( uint32_t ) otabenchmarkAGENT_REPEAT ) );
+
+    for( x = 0; x < ( sizeof( ulLossPermille ) / sizeof( ulLossPermille[ 0 ] ) ); x++ )
+    {
+        prvAgentBenchmark( ulLossPermille[ x ], &xResult );
+
+        ulMS = ( uint32_t ) xResult.xDuration * portTICK_PERIOD_MS;
+
+        if( ulMS == 0U )
+        {
+            ulMS = 1U;
+        }
+
+        configPRINTF( ( "    %u.%u%% of the messages lost and %u.%u%% delivered twice: %u blocks/s, %u requests, %u.%u%% of the blocks sent again, %u us of CPU per message sent\r\n",
+                        ulLossPermille[ x ] / 10UL,
+                        ulLossPermille[ x ] % 10UL,
+                        ulLossPermille[ x ] / 10UL,
+                        ulLossPermille[ x ] % 10UL,
+                        ( uint32_t ) ( ( ( uint64_t ) otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_REPEAT * 1000ULL ) / ulMS ),
+                        xResult.ulRequests,
+                        ( uint32_t ) ( ( ( xResult.ulSent - ( otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_REPEAT ) ) * 100UL ) / ( otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_REPEAT ) ),
+                        ( uint32_t ) ( ( ( xResult.ulSent - ( otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_REPEAT ) ) * 1000UL ) / ( otabenchmarkAGENT_BLOCKS * otabenchmarkAGENT_REPEAT ) ) % 10UL,
+                        ( uint32_t ) ( ( ( uint64_t ) xResult.xCPUTime * 1000000ULL ) / ( ( uint64_t ) CLOCKS_PER_SEC * xResult.ulSent ) ) ) );
+    }
+}
+/*-----------------------------------------------------------*/
@@ -500,7 +500,7 @@ TEST( Full_OTA_CBOR, CborOtaApi )
     int lFileSize = 0;
     int lBlockIndex = 0;
     int lBlockSize = 0;
-    uint8_t * pucPayload = NULL;
+    const uint8_t * pucPayload = NULL;
     size_t xPayloadSize = 0;
 
     /* Test OTA_CBOR_Encode_GetStreamRequestMessage( ). */
@@ -545,11 +545,21 @@ TEST( Full_OTA_CBOR, CborOtaApi )
         &xPayloadSize );
     TEST_ASSERT_TRUE( xResult );
 
-    if( NULL != pucPayload )
-    {
-        vPortFree( pucPayload );
-        pucPayload = NULL;
-    }
+    /* The payload is decoded in place. */
+    TEST_ASSERT_EQUAL( sizeof( ucBlockPayload ), xPayloadSize );
+    TEST_ASSERT_TRUE( ( pucPayload > ucCborWork ) && ( ( pucPayload + xPayloadSize ) <= ( ucCborWork + xEncodedSize ) ) );
+    TEST_ASSERT_EQUAL_MEMORY( ucBlockPayload, pucPayload, xPayloadSize );
+
+    /* A payload running past the end of the message is rejected. */
+    xResult = OTA_CBOR_Decode_GetStreamResponseMessage(
+        ucCborWork,
+        xEncodedSize - 1,
+        &lFileId,
+        &lBlockIndex,
+        &lBlockSize,
+        &pucPayload,
+        &xPayloadSize );
+    TEST_ASSERT_FALSE( xResult );
 }
 
 TEST( Full_OTA_CBOR, CborOtaAgentIngest )
@@ -676,7 +686,7 @@ TEST( Full_OTA_CBOR, CborOtaServerFiles )
     int lFileSize = 0;
     int lBlockIndex = 0;
     int lBlockSize = 0;
-    uint8_t * pucPayload = NULL;
+    const uint8_t * pucPayload = NULL;
     size_t xPayloadSize = 0;
     char pcChunkFileName[ MAX_PATH ];
     uint32_t ulBitmap = CBOR_TEST_BITMAP_VALUE;
@@ -706,12 +716,6 @@ TEST( Full_OTA_CBOR, CborOtaServerFiles )
             &xBufferSize );
         TEST_ASSERT_TRUE( xResultBool );
 
-        /* Free the previous chunk buffer. */
-        if( NULL != pucPayload )
-        {
-            vPortFree( pucPayload );
-        }
-
         /* Parse the chunk message. */
         xResultBool = OTA_CBOR_Decode_GetStreamResponseMessage(
             pucInFile,
@@ -737,9 +741,4 @@ TEST( Full_OTA_CBOR, CborOtaServerFiles )
     {
         vPortFree( pucInFile );
     }
-
-    if( NULL != pucPayload )
-    {
-        vPortFree( pucPayload );
-    }
 }
@@ -0,0 +1,377 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_ota_compress_benchmark.c
+ * @brief Benchmark of compressed OTA updates against uncompressed ones.
+ *
+ * The benchmark compresses a firmware-like image, then decompresses it by OTA
+ * blocks as the OTA agent does, and measures the time taken. The time of an
+ * update is the time to send the file on links of different rates, plus the
+ * time to decompress it for a compressed update. Both updates write the same
+ * image to flash, which takes the same time and is not counted. The memory an
+ * update needs beyond the blocks is the decompression state, allocated during
+ * a compressed update.
+ *
+ * The image is compressed by a simple compressor of the benchmark, so the
+ * compression ratio of tools/ota_compress is slightly better.
+ *
+ * The results are printed with configPRINTF.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* OTA includes. */
+#include "aws_ota_agent.h"
+#include "aws_ota_agent_internal.h"
+#include "aws_ota_decompress.h"
+
+/**
+ * @brief Size of the image updated.
+ */
+#ifndef otabenchmarkIMAGE_SIZE
+    #define otabenchmarkIMAGE_SIZE              ( 64UL * 1024UL )
+#endif
+
+/**
+ * @brief Number of times the image is decompressed to measure the time taken.
+ */
+#ifndef otabenchmarkDECOMPRESS_REPEAT
+    #define otabenchmarkDECOMPRESS_REPEAT       ( 20UL )
+#endif
+
+/**
+ * @brief Window and lookahead sizes the image is compressed with, as powers
+ * of 2.
+ */
+#define otabenchmarkWINDOW_BITS                 ( otaconfigDECOMPRESS_WINDOW_BITS )
+#define otabenchmarkLOOKAHEAD_BITS              ( 4U )
+
+/**
+ * @brief Largest size of the compressed image: 9 bits per byte at worst.
+ */
+#define otabenchmarkMAX_COMPRESSED_SIZE         ( OTA_DECOMPRESS_HEADER_SIZE + ( ( otabenchmarkIMAGE_SIZE * 9UL ) / 8UL ) + 1UL )
+
+/**
+ * @brief Number of earlier positions tried for each back reference, and size
+ * of the hash table of the positions.
+ */
+#define otabenchmarkMAX_CANDIDATES              ( 32U )
+#define otabenchmarkHASH_SIZE                   ( 4096U )
+#define otabenchmarkNO_POSITION                 ( 0xFFFFFFFFUL )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The image, compressed and decompressed.
+ */
+static uint8_t ucImage[ otabenchmarkIMAGE_SIZE ];
+static uint8_t ucCompressed[ otabenchmarkMAX_COMPRESSED_SIZE ];
+static uint8_t ucDecompressed[ otabenchmarkIMAGE_SIZE ];
+
+/**
+ * @brief The last position of each hash, and the previous position of each
+ * position of the window with the same hash, for the compressor.
+ */
+static uint32_t ulHashHeads[ otabenchmarkHASH_SIZE ];
+static uint32_t ulHashChains[ 1UL << otabenchmarkWINDOW_BITS ];
+
+/**
+ * @brief The bits of the compressed image not written yet.
+ */
+static uint32_t ulCompressedLength;
+static uint32_t ulPendingBits;
+static uint8_t ucPendingCount;
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Makes a firmware-like image: short patterns repeated in a random
+ * order, like code, followed by erased flash.
+ */
+static void prvMakeImage( void )
+{
+    uint8_t ucPatterns[ 64 ][ 12 ];
+    uint8_t ucLengths[ 64 ];
+    uint32_t ulRandom = 1UL;
+    uint32_t ulIndex, ulPattern, ulByte;
+
+    for( ulPattern = 0U; ulPattern < 64U; ulPattern++ )
+    {
+        ulRandom = ( ulRandom * 1103515245UL ) + 12345UL;
+        ucLengths[ ulPattern ] = ( uint8_t ) ( 2U + ( ( ulRandom >> 16 ) % 11U ) );
+
+        for( ulByte = 0U; ulByte < 12U; ulByte++ )
+        {
+            ulRandom = ( ulRandom * 1103515245UL ) + 12345UL;
+            ucPatterns[ ulPattern ][ ulByte ] = ( uint8_t ) ( ulRandom >> 16 );
+        }
+    }
+
+    ulIndex = 0U;
+
+    while( ulIndex < ( otabenchmarkIMAGE_SIZE - ( otabenchmarkIMAGE_SIZE / 16UL ) ) )
+    {
+        ulRandom = ( ulRandom * 1103515245UL ) + 12345UL;
+        ulPattern = ( ulRandom >> 16 ) % 64U;
+
+        for( ulByte = 0U; ( ulByte < ucLengths[ ulPattern ] ) && ( ulIndex < otabenchmarkIMAGE_SIZE ); ulByte++ )
+        {
+            ucImage[ ulIndex++ ] = ucPatterns[ ulPattern ][ ulByte ];
+        }
+    }
+
+    memset( &ucImage[ ulIndex ], 0xFF, otabenchmarkIMAGE_SIZE - ulIndex );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Appends bits to the compressed image, most significant first.
+ */
+static void prvPutBits( uint32_t ulValue,
+                        uint8_t ucCount )
+{
+    while( ucCount > 0U )
+    {
+        ucCount--;
+        ulPendingBits = ( ulPendingBits << 1 ) | ( ( ulValue >> ucCount ) & 1UL );
+        ucPendingCount++;
+
+        if( ucPendingCount == 8U )
+        {
+            ucCompressed[ ulCompressedLength++ ] = ( uint8_t ) ulPendingBits;
+            ucPendingCount = 0U;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns the hash of the 3 bytes at a position of the image.
+ */
+static uint32_t prvHash( uint32_t ulPosition )
+{
+    return ( ( ( uint32_t ) ucImage[ ulPosition ] << 4 ) ^
+             ( ( uint32_t ) ucImage[ ulPosition + 1U ] << 2 ) ^
+             ucImage[ ulPosition + 2U ] ) % otabenchmarkHASH_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Compresses the image, taking the longest back reference found at
+ * each position.
+ */
+static void prvCompressImage( void )
+{
+    uint32_t ulWindow = 1UL << otabenchmarkWINDOW_BITS;
+    uint32_t ulMaxLength = 1UL << otabenchmarkLOOKAHEAD_BITS;
+    uint32_t ulPosition = 0U, ulCandidate, ulLength, ulBestLength, ulBestOffset, ulTries, ulLimit, ulIndexed;
+
+    memcpy( ucCompressed, "AFH1", 4 );
+    ucCompressed[ 4 ] = ( uint8_t ) otabenchmarkIMAGE_SIZE;
+    ucCompressed[ 5 ] = ( uint8_t ) ( otabenchmarkIMAGE_SIZE >> 8 );
+    ucCompressed[ 6 ] = ( uint8_t ) ( otabenchmarkIMAGE_SIZE >> 16 );
+    ucCompressed[ 7 ] = ( uint8_t ) ( otabenchmarkIMAGE_SIZE >> 24 );
+    ucCompressed[ 8 ] = ( uint8_t ) otabenchmarkWINDOW_BITS;
+    ucCompressed[ 9 ] = ( uint8_t ) otabenchmarkLOOKAHEAD_BITS;
+    ucCompressed[ 10 ] = 0U;
+    ucCompressed[ 11 ] = 0U;
+    ulCompressedLength = OTA_DECOMPRESS_HEADER_SIZE;
+    ulPendingBits = 0U;
+    ucPendingCount = 0U;
+    memset( ulHashHeads, 0xFF, sizeof( ulHashHeads ) );
+
+    while( ulPosition < otabenchmarkIMAGE_SIZE )
+    {
+        ulBestLength = 0U;
+        ulBestOffset = 0U;
+        ulLimit = ( ( otabenchmarkIMAGE_SIZE - ulPosition ) < ulMaxLength ) ? ( otabenchmarkIMAGE_SIZE - ulPosition ) : ulMaxLength;
+
+        if( ulLimit >= 3U )
+        {
+            ulCandidate = ulHashHeads[ prvHash( ulPosition ) ];
+
+            for( ulTries = 0U;
+                 ( ulTries < otabenchmarkMAX_CANDIDATES ) && ( ulCandidate != otabenchmarkNO_POSITION ) && ( ( ulPosition - ulCandidate ) <= ulWindow );
+                 ulTries++ )
+            {
+                for( ulLength = 0U; ( ulLength < ulLimit ) && ( ucImage[ ulCandidate + ulLength ] == ucImage[ ulPosition + ulLength ] ); ulLength++ )
+                {
+                }
+
+                if( ulLength > ulBestLength )
+                {
+                    ulBestLength = ulLength;
+                    ulBestOffset = ulPosition - ulCandidate;
+                }
+
+                ulCandidate = ulHashChains[ ulCandidate % ulWindow ];
+            }
+        }
+
+        /* A back reference of 15 bits only pays off from 2 bytes. */
+        if( ulBestLength < 2U )
+        {
+            ulBestLength = 1U;
+            prvPutBits( 1U, 1U );
+            prvPutBits( ucImage[ ulPosition ], 8U );
+        }
+        else
+        {
+            prvPutBits( 0U, 1U );
+            prvPutBits( ulBestOffset - 1U, otabenchmarkWINDOW_BITS );
+            prvPutBits( ulBestLength - 1U, otabenchmarkLOOKAHEAD_BITS );
+        }
+
+        for( ulIndexed = ulPosition; ( ulIndexed < ( ulPosition + ulBestLength ) ) && ( ( ulIndexed + 3U ) <= otabenchmarkIMAGE_SIZE ); ulIndexed++ )
+        {
+            ulHashChains[ ulIndexed % ulWindow ] = ulHashHeads[ prvHash( ulIndexed ) ];
+            ulHashHeads[ prvHash( ulIndexed ) ] = ulIndexed;
+        }
+
+        ulPosition += ulBestLength;
+    }
+
+    if( ucPendingCount > 0U )
+    {
+        prvPutBits( 0U, ( uint8_t ) ( 8U - ucPendingCount ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Writes the decompressed image, as the PAL writes the file.
+ */
+static int32_t prvWrite( void * pvContext,
+                         uint32_t ulOffset,
+                         const uint8_t * pucData,
+                         uint32_t ulLength )
+{
+    ( void ) pvContext;
+
+    memcpy( &ucDecompressed[ ulOffset ], pucData, ulLength );
+
+    return ( int32_t ) ulLength;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decompresses the image by OTA blocks.
+ */
+static void prvDecompressImage( OTA_Decompress_t * pxDecompress )
+{
+    uint32_t ulOffset, ulBlock;
+
+    OTA_DecompressInit( pxDecompress, prvWrite, NULL );
+
+    for( ulOffset = 0U; ulOffset < ulCompressedLength; ulOffset += ulBlock )
+    {
+        ulBlock = ( ( ulCompressedLength - ulOffset ) < OTA_FILE_BLOCK_SIZE ) ? ( ulCompressedLength - ulOffset ) : OTA_FILE_BLOCK_SIZE;
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, OTA_DecompressApply( pxDecompress, &ucCompressed[ ulOffset ], ulBlock ) );
+    }
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, OTA_DecompressFinish( pxDecompress ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_OTA_COMPRESS_BENCHMARK );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_OTA_COMPRESS_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_OTA_COMPRESS_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_OTA_COMPRESS_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_OTA_COMPRESS_BENCHMARK, UpdateTime );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_COMPRESS_BENCHMARK, UpdateTime )
+{
+    /* Link rates in bytes per second: NB-IoT, LTE-M and Wi-Fi. */
+    static const uint32_t ulLinkRates[] = { 2UL * 1024UL, 20UL * 1024UL, 500UL * 1024UL };
+    static const char * const pcLinkNames[] = { "NB-IoT", "LTE-M", "Wi-Fi" };
+    OTA_Decompress_t * pxDecompress;
+    TickType_t xStart;
+    uint32_t x, ulDecompressUS, ulPlainMS, ulCompressedMS;
+
+    prvMakeImage();
+    prvCompressImage();
+
+    /* The decompression state is allocated as the OTA agent does. */
+    pxDecompress = ( OTA_Decompress_t * ) pvPortMalloc( sizeof( OTA_Decompress_t ) );
+    TEST_ASSERT_NOT_NULL( pxDecompress );
+
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < otabenchmarkDECOMPRESS_REPEAT; x++ )
+    {
+        prvDecompressImage( pxDecompress );
+    }
+
+    ulDecompressUS = ( uint32_t ) ( ( ( uint64_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS * 1000ULL ) / otabenchmarkDECOMPRESS_REPEAT );
+    vPortFree( pxDecompress );
+
+    TEST_ASSERT_EQUAL_UINT8_ARRAY( ucImage, ucDecompressed, otabenchmarkIMAGE_SIZE );
+
+    configPRINTF( ( "Image of %u bytes compressed to %u bytes (%u%%), decompressed in %u us by blocks of %u bytes\r\n",
+                    ( uint32_t ) otabenchmarkIMAGE_SIZE,
+                    ulCompressedLength,
+                    ( uint32_t ) ( ( ( uint64_t ) ulCompressedLength * 100ULL ) / otabenchmarkIMAGE_SIZE ),
+                    ulDecompressUS,
+                    ( uint32_t ) OTA_FILE_BLOCK_SIZE ) );
+    configPRINTF( ( "    RAM beyond the blocks: uncompressed 0 bytes, compressed %u bytes (window of %u bytes)\r\n",
+                    ( uint32_t ) sizeof( OTA_Decompress_t ),
+                    ( uint32_t ) ( 1UL << otabenchmarkWINDOW_BITS ) ) );
+
+    for( x = 0; x < ( sizeof( ulLinkRates ) / sizeof( ulLinkRates[ 0 ] ) ); x++ )
+    {
+        ulPlainMS = ( uint32_t ) ( ( ( uint64_t ) otabenchmarkIMAGE_SIZE * 1000ULL ) / ulLinkRates[ x ] );
+        ulCompressedMS = ( uint32_t ) ( ( ( uint64_t ) ulCompressedLength * 1000ULL ) / ulLinkRates[ x ] ) + ( ulDecompressUS / 1000UL );
+
+        configPRINTF( ( "    %s at %u KB/s: uncompressed %u ms, compressed %u ms\r\n",
+                        pcLinkNames[ x ],
+                        ulLinkRates[ x ] / 1024UL,
+                        ulPlainMS,
+                        ulCompressedMS ) );
+    }
+
+    /* A firmware-like image compresses. */
+    TEST_ASSERT_TRUE( ulCompressedLength < otabenchmarkIMAGE_SIZE );
+}
+/*-----------------------------------------------------------*/
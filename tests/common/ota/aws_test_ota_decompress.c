@@ -0,0 +1,353 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_ota_decompress.c
+ * @brief Tests of the streaming decompression of compressed OTA files.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* OTA decompression includes. */
+#include "aws_ota_decompress.h"
+
+/* Size of the test file, and of the largest compressed file of the tests. */
+#define otadecompresstestFILE_SIZE      ( 1500U )
+#define otadecompresstestMAX_STREAM     ( 64U )
+
+/* Window size of the compressed test file. */
+#define otadecompresstestWINDOW_BITS    ( 8U )
+
+/**
+ * @brief The file of prvMakeFile compressed with tools/ota_compress, with a
+ * window of 2^8 bytes and a lookahead of 2^4 bytes, so that the tool and the
+ * device agree on the format.
+ */
+static const uint8_t ucToolStream[] =
+{
+    0x41, 0x46, 0x48, 0x31, 0xdc, 0x05, 0x00, 0x00, 0x08, 0x04, 0x00, 0x00,
+    0x80, 0x55, 0x28, 0x32, 0x0b, 0x15, 0xb2, 0xdf, 0x63, 0xb5, 0xdc, 0xe4,
+    0x16, 0x1b, 0x95, 0x96, 0x41, 0x64, 0xb2, 0xd8, 0xed, 0xf6, 0xdb, 0x85,
+    0xca, 0xcb, 0x73, 0xb9, 0xd9, 0x6c, 0x92, 0x0b, 0x0d, 0xce, 0x41, 0x74,
+    0xb4, 0x59, 0x6f, 0x21, 0x84, 0xb9, 0x59, 0x6c, 0x76, 0x5b, 0x4d, 0xda,
+    0xcb, 0x64, 0x97, 0x48, 0x29, 0xf5, 0x4a, 0x0c, 0x18, 0x63, 0xe3, 0x1f,
+    0x18, 0xf9, 0x8c, 0xe1, 0xa3, 0x1f, 0x18, 0xf8, 0xc7, 0xcc, 0x67, 0x13,
+    0x18, 0xf8, 0xc7, 0xc6, 0x3e, 0x63, 0x38, 0xd0, 0xc7, 0xc6, 0x3e, 0x31,
+    0xf0, 0xc1, 0xc8, 0x46, 0x3e, 0x31, 0xf1, 0x8f, 0x98, 0xce, 0x4e, 0x31,
+    0xf1, 0x8f, 0x8c, 0x7c, 0xc6, 0x72, 0xe1, 0x8f, 0x8c, 0x7c, 0x63, 0xe6,
+    0x33, 0x9a, 0x8c, 0x7c, 0x63, 0xe3, 0x1f, 0x31, 0x9c, 0xec, 0x63, 0xe3,
+    0x1f, 0x18, 0xf9, 0x8c, 0xe8, 0x43, 0x1f, 0x18, 0xf8, 0xc7, 0xcc, 0x67,
+    0x48, 0x18, 0xf8, 0xc7, 0xc6, 0x3e, 0x63, 0x3a, 0x78, 0xc7, 0xc6, 0x3e,
+    0x31, 0xf0, 0xc1, 0xd5, 0x86, 0x3e, 0x31, 0xf1, 0x8f, 0x98, 0xce, 0xb8,
+    0x31, 0xf1, 0x8f, 0x8c, 0x7c, 0xc6, 0x76, 0x31, 0x8f, 0x8c, 0x7c, 0x63,
+    0xe6, 0x33, 0xb5, 0x0c, 0x7c, 0x63, 0xe3, 0x1f, 0x31, 0x9d, 0xc0, 0x63,
+    0xe3, 0x1f, 0x18, 0xf9, 0x8c, 0xee, 0xe3, 0x1f, 0x18, 0xf8, 0xc7, 0xcc,
+    0x67, 0x7d, 0x18, 0xf8, 0xc7, 0xc6, 0x3e, 0x63, 0x3c, 0x20, 0xc7, 0xc6,
+    0x3e, 0x31, 0xf3, 0x19, 0xe2, 0xc6, 0x3e, 0x31, 0xf1, 0x8f, 0x98, 0xcf,
+    0x22, 0x31, 0xf1, 0x8f, 0x8c, 0x7c, 0xc6, 0x79, 0x81, 0x8f, 0x8c, 0x7c,
+    0x63, 0xe6, 0x33, 0xcf, 0x8c, 0x7c, 0x63, 0xe3, 0x1f, 0x31, 0x9e, 0x94,
+    0x63, 0xe3, 0x1f, 0x18, 0xf9, 0x8c, 0xf5, 0x83, 0x1f, 0x18, 0xf8, 0xc7,
+    0xcc, 0x67, 0xb2, 0x18, 0xf8, 0xc7, 0xc6, 0x3e, 0x63, 0x3d, 0xc8, 0xc7,
+    0x80
+};
+
+/**
+ * @brief The test file.
+ */
+static uint8_t ucFile[ otadecompresstestFILE_SIZE ];
+
+/**
+ * @brief The decompressed file, and the size of the largest write.
+ */
+static uint8_t ucWritten[ otadecompresstestFILE_SIZE ];
+static uint32_t ulWrittenLength;
+static uint32_t ulLargestWrite;
+
+/**
+ * @brief A compressed file made by the test.
+ */
+static uint8_t ucStream[ otadecompresstestMAX_STREAM ];
+static uint32_t ulStreamLength;
+
+/**
+ * @brief Makes the write callback fail when set.
+ */
+static BaseType_t xFailWrite;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Makes the test file: text, with a changed byte every 53 bytes.
+ */
+static void prvMakeFile( void )
+{
+    static const char cText[] = "OTA blocks are decompressed as they are received. ";
+    uint32_t ulIndex;
+
+    for( ulIndex = 0U; ulIndex < otadecompresstestFILE_SIZE; ulIndex++ )
+    {
+        ucFile[ ulIndex ] = ( ( ulIndex % 53U ) == 0U ) ? ( uint8_t ) ( ulIndex >> 3 ) :
+                            ( uint8_t ) cText[ ulIndex % ( sizeof( cText ) - 1U ) ];
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Writes the decompressed file, checking that it is written in order.
+ */
+static int32_t prvWrite( void * pvContext,
+                         uint32_t ulOffset,
+                         const uint8_t * pucData,
+                         uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( ucWritten, pvContext );
+    TEST_ASSERT_EQUAL_UINT32( ulWrittenLength, ulOffset );
+    TEST_ASSERT_TRUE( ulLength <= ( otadecompresstestFILE_SIZE - ulOffset ) );
+
+    if( xFailWrite == pdFALSE )
+    {
+        memcpy( &ucWritten[ ulOffset ], pucData, ulLength );
+        ulWrittenLength += ulLength;
+        ulLargestWrite = ( ulLength > ulLargestWrite ) ? ulLength : ulLargestWrite;
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Starts a compressed file with its header.
+ */
+static void prvPutHeader( uint32_t ulSize,
+                          uint8_t ucWindowBits,
+                          uint8_t ucLookaheadBits )
+{
+    memcpy( ucStream, "AFH1", 4 );
+    ucStream[ 4 ] = ( uint8_t ) ulSize;
+    ucStream[ 5 ] = ( uint8_t ) ( ulSize >> 8 );
+    ucStream[ 6 ] = ( uint8_t ) ( ulSize >> 16 );
+    ucStream[ 7 ] = ( uint8_t ) ( ulSize >> 24 );
+    ucStream[ 8 ] = ucWindowBits;
+    ucStream[ 9 ] = ucLookaheadBits;
+    ucStream[ 10 ] = 0U;
+    ucStream[ 11 ] = 0U;
+    ulStreamLength = OTA_DECOMPRESS_HEADER_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decompresses a compressed file by chunks of ulChunkSize bytes.
+ *
+ * @return The error which stopped the decompression, or the result of
+ * OTA_DecompressFinish.
+ */
+static OTA_DecompressErr_t prvDecompress( const uint8_t * pucStream,
+                                          uint32_t ulLength,
+                                          uint32_t ulChunkSize )
+{
+    static OTA_Decompress_t xDecompress;
+    OTA_DecompressErr_t eErr = eOTA_DecompressErr_None;
+    uint32_t ulOffset = 0U;
+    uint32_t ulChunk;
+
+    memset( ucWritten, 0, sizeof( ucWritten ) );
+    ulWrittenLength = 0U;
+    ulLargestWrite = 0U;
+    OTA_DecompressInit( &xDecompress, prvWrite, ucWritten );
+
+    while( ( eErr == eOTA_DecompressErr_None ) && ( ulOffset < ulLength ) )
+    {
+        ulChunk = ( ( ulLength - ulOffset ) < ulChunkSize ) ? ( ulLength - ulOffset ) : ulChunkSize;
+        eErr = OTA_DecompressApply( &xDecompress, &pucStream[ ulOffset ], ulChunk );
+        ulOffset += ulChunk;
+    }
+
+    if( eErr == eOTA_DecompressErr_None )
+    {
+        eErr = OTA_DecompressFinish( &xDecompress );
+    }
+
+    if( eErr == eOTA_DecompressErr_None )
+    {
+        TEST_ASSERT_EQUAL_UINT32( ulWrittenLength, OTA_DecompressSize( &xDecompress ) );
+    }
+
+    return eErr;
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_OTA_DECOMPRESS );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_OTA_DECOMPRESS )
+{
+    prvMakeFile();
+    xFailWrite = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_OTA_DECOMPRESS )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_OTA_DECOMPRESS )
+{
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, DecompressToolFile );
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, DecompressOverlappingReference );
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, DecompressReferenceBeforeStart );
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, DecompressEmptyFile );
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, RejectMalformedStream );
+    RUN_TEST_CASE( Full_OTA_DECOMPRESS, ReportWriteFailure );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, DecompressToolFile )
+{
+    static const uint32_t ulChunkSizes[] = { 1U, 5U, 64U, 1024U, sizeof( ucToolStream ) };
+    uint32_t ulIndex;
+
+    /* The chunk boundaries fall anywhere in the bits of the stream. */
+    for( ulIndex = 0U; ulIndex < ( sizeof( ulChunkSizes ) / sizeof( ulChunkSizes[ 0 ] ) ); ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( ucToolStream, sizeof( ucToolStream ), ulChunkSizes[ ulIndex ] ) );
+        TEST_ASSERT_EQUAL_UINT32( otadecompresstestFILE_SIZE, ulWrittenLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucFile, ucWritten, otadecompresstestFILE_SIZE );
+
+        /* The file is written a window at a time. */
+        TEST_ASSERT_EQUAL_UINT32( 1UL << otadecompresstestWINDOW_BITS, ulLargestWrite );
+    }
+
+    /* The text compresses to a fraction of its size. */
+    TEST_ASSERT_TRUE( sizeof( ucToolStream ) < ( otadecompresstestFILE_SIZE / 4U ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, DecompressOverlappingReference )
+{
+    /* A literal 'a', then a back reference of offset 1 and length 3. */
+    prvPutHeader( 4U, 4U, 3U );
+    ucStream[ ulStreamLength++ ] = 0xB0U;
+    ucStream[ ulStreamLength++ ] = 0x81U;
+    ucStream[ ulStreamLength++ ] = 0x00U;
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( ucStream, ulStreamLength, 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 4U, ulWrittenLength );
+    TEST_ASSERT_EQUAL_MEMORY( "aaaa", ucWritten, 4 );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, DecompressReferenceBeforeStart )
+{
+    /* A back reference of offset 16 and length 2, before any byte. */
+    prvPutHeader( 2U, 4U, 3U );
+    ucStream[ ulStreamLength++ ] = 0x79U;
+    memset( ucWritten, 0xFF, sizeof( ucWritten ) );
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( ucStream, ulStreamLength, 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 2U, ulWrittenLength );
+    TEST_ASSERT_EQUAL_UINT8( 0U, ucWritten[ 0 ] );
+    TEST_ASSERT_EQUAL_UINT8( 0U, ucWritten[ 1 ] );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, DecompressEmptyFile )
+{
+    prvPutHeader( 0U, otaconfigDECOMPRESS_WINDOW_BITS, 3U );
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_None, prvDecompress( ucStream, ulStreamLength, 5U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulWrittenLength );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, RejectMalformedStream )
+{
+    uint8_t ucCopy[ sizeof( ucToolStream ) + 1U ];
+    uint32_t ulLength;
+
+    memcpy( ucCopy, ucToolStream, sizeof( ucToolStream ) );
+
+    /* Every truncation of the stream is incomplete. */
+    for( ulLength = 0U; ulLength < sizeof( ucToolStream ); ulLength += 23U )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucCopy, ulLength, 16U ) );
+    }
+
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucCopy, sizeof( ucToolStream ) - 1U, 16U ) );
+
+    /* Data after the end of the file. */
+    ucCopy[ sizeof( ucToolStream ) ] = 0U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucCopy, sizeof( ucCopy ), 16U ) );
+
+    /* Not a compressed file. */
+    ucCopy[ 3 ] = '2';
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucCopy, sizeof( ucToolStream ), 16U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulWrittenLength );
+
+    /* A window larger than the device supports, or out of bounds sizes. */
+    #if ( otaconfigDECOMPRESS_WINDOW_BITS < 15 )
+        prvPutHeader( 1U, otaconfigDECOMPRESS_WINDOW_BITS + 1U, 3U );
+        TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+    #endif
+    prvPutHeader( 1U, 3U, 2U );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+    prvPutHeader( 1U, 8U, 8U );
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+
+    /* Reserved bytes set. */
+    prvPutHeader( 1U, 8U, 4U );
+    ucStream[ 11 ] = 1U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+
+    /* A back reference of length 4 in a file of 2. */
+    prvPutHeader( 2U, 4U, 3U );
+    ucStream[ ulStreamLength++ ] = 0x03U;
+    ucStream[ ulStreamLength++ ] = 0xC0U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+
+    /* Padding which is not zero. */
+    prvPutHeader( 1U, 4U, 3U );
+    ucStream[ ulStreamLength++ ] = 0xB0U;
+    ucStream[ ulStreamLength++ ] = 0x81U;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_BadStream, prvDecompress( ucStream, ulStreamLength, 16U ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DECOMPRESS, ReportWriteFailure )
+{
+    xFailWrite = pdTRUE;
+    TEST_ASSERT_EQUAL( eOTA_DecompressErr_WriteFailed, prvDecompress( ucToolStream, sizeof( ucToolStream ), 64U ) );
+}
+/*-----------------------------------------------------------*/
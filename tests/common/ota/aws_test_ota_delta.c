@@ -0,0 +1,474 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_ota_delta.c
+ * @brief Tests of the streaming application of OTA delta patches.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* OTA delta includes. */
+#include "aws_ota_delta.h"
+
+/* Sizes of the test images. */
+#define otadeltatestOLD_SIZE          ( 2048U )
+#define otadeltatestNEW_SIZE          ( 2212U )
+#define otadeltatestMAX_PATCH_SIZE    ( 4096U )
+
+/**
+ * @brief A patch created with tools/ota_delta from the images of
+ * prvMakeImages, so that the host tool and the device agree on the format.
+ */
+static const uint8_t ucToolPatch[] =
+{
+    0x41, 0x46, 0x44, 0x31, 0xa4, 0x08, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0xc7, 0xbb, 0x05, 0x40, 0x00, 0x60, 0x01, 0x01, 0x60,
+    0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60,
+    0x01, 0x01, 0x60, 0x01, 0x01, 0x14, 0x00, 0x00, 0x07, 0x0e, 0x15, 0x1c,
+    0x23, 0x2a, 0x31, 0x38, 0x3f, 0x46, 0x4d, 0x54, 0x5b, 0x62, 0x69, 0x70,
+    0x77, 0x7e, 0x85, 0x8c, 0x93, 0x9a, 0xa1, 0xa8, 0xaf, 0xb6, 0xbd, 0xc4,
+    0xcb, 0xd2, 0xd9, 0xe0, 0xe7, 0xee, 0xf5, 0xfc, 0x03, 0x0a, 0x11, 0x18,
+    0x1f, 0x26, 0x2d, 0x34, 0x3b, 0x42, 0x49, 0x50, 0x57, 0x5e, 0x65, 0x6c,
+    0x73, 0x7a, 0x81, 0x88, 0x8f, 0x96, 0x9d, 0xa4, 0xab, 0xb2, 0xb9, 0xa0,
+    0x06, 0x00, 0xc8, 0x01, 0x0c, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01,
+    0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01,
+    0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x0b, 0x00, 0xc0, 0x03, 0x00,
+    0xff, 0x1f, 0x55, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60, 0x01, 0x01, 0x60,
+    0x01, 0x01, 0x47, 0x00, 0xc8, 0x01, 0x00, 0x00, 0xc8, 0x01, 0x00
+};
+
+/**
+ * @brief The active image and the new file.
+ */
+static uint8_t ucOldImage[ otadeltatestOLD_SIZE ];
+static uint8_t ucNewImage[ otadeltatestNEW_SIZE ];
+
+/**
+ * @brief The new file written by the patch.
+ */
+static uint8_t ucWritten[ otadeltatestNEW_SIZE ];
+static uint32_t ulWrittenLength;
+
+/**
+ * @brief The patch under test.
+ */
+static uint8_t ucPatch[ otadeltatestMAX_PATCH_SIZE ];
+static uint32_t ulPatchLength;
+
+/**
+ * @brief Makes the callbacks fail when set.
+ */
+static BaseType_t xFailRead;
+static BaseType_t xFailWrite;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Makes the active image, pseudo-random, and the new file, a new version
+ * of it with changed bytes, inserted, deleted and repeated sections.
+ */
+static void prvMakeImages( void )
+{
+    uint32_t ulSeed = 1U;
+    uint32_t ulIndex;
+    uint32_t ulLength = 0U;
+
+    for( ulIndex = 0U; ulIndex < otadeltatestOLD_SIZE; ulIndex++ )
+    {
+        ulSeed = ( ulSeed * 1103515245UL ) + 12345UL;
+        ucOldImage[ ulIndex ] = ( uint8_t ) ( ulSeed >> 16 );
+    }
+
+    memcpy( &ucNewImage[ ulLength ], &ucOldImage[ 0 ], 700U );
+    ulLength += 700U;
+
+    for( ulIndex = 0U; ulIndex < 64U; ulIndex++ )
+    {
+        ucNewImage[ ulLength++ ] = ( uint8_t ) ( ulIndex * 7U );
+    }
+
+    memcpy( &ucNewImage[ ulLength ], &ucOldImage[ 700 ], 800U );
+    ulLength += 800U;
+    memcpy( &ucNewImage[ ulLength ], &ucOldImage[ 1600 ], 448U );
+    ulLength += 448U;
+
+    for( ulIndex = 0U; ulIndex < ulLength; ulIndex += 97U )
+    {
+        ucNewImage[ ulIndex ]++;
+    }
+
+    memcpy( &ucNewImage[ ulLength ], &ucOldImage[ 0 ], 200U );
+    ulLength += 200U;
+
+    TEST_ASSERT_EQUAL_UINT32( otadeltatestNEW_SIZE, ulLength );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reads the active image.
+ */
+static int32_t prvReadOld( void * pvContext,
+                           uint32_t ulOffset,
+                           uint8_t * pucBuffer,
+                           uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( ucOldImage, pvContext );
+
+    if( ( xFailRead == pdFALSE ) &&
+        ( ulOffset <= otadeltatestOLD_SIZE ) &&
+        ( ulLength <= ( otadeltatestOLD_SIZE - ulOffset ) ) )
+    {
+        memcpy( pucBuffer, &ucOldImage[ ulOffset ], ulLength );
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Writes the new file, checking that it is written in order through
+ * the buffer.
+ */
+static int32_t prvWriteNew( void * pvContext,
+                            uint32_t ulOffset,
+                            const uint8_t * pucData,
+                            uint32_t ulLength )
+{
+    int32_t lResult = -1;
+
+    TEST_ASSERT_EQUAL_PTR( ucOldImage, pvContext );
+    TEST_ASSERT_EQUAL_UINT32( ulWrittenLength, ulOffset );
+    TEST_ASSERT_TRUE( ulLength <= otaconfigDELTA_BUFFER_SIZE );
+    TEST_ASSERT_TRUE( ulLength <= ( otadeltatestNEW_SIZE - ulOffset ) );
+
+    if( xFailWrite == pdFALSE )
+    {
+        memcpy( &ucWritten[ ulOffset ], pucData, ulLength );
+        ulWrittenLength += ulLength;
+        lResult = ( int32_t ) ulLength;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Appends a varint to the patch.
+ */
+static void prvPutVarint( uint32_t ulValue )
+{
+    while( ulValue >= 0x80U )
+    {
+        ucPatch[ ulPatchLength++ ] = ( uint8_t ) ( ulValue | 0x80U );
+        ulValue >>= 7;
+    }
+
+    ucPatch[ ulPatchLength++ ] = ( uint8_t ) ulValue;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Starts a patch with its header.
+ */
+static void prvPutHeader( uint32_t ulNewSize,
+                          uint32_t ulOldSize )
+{
+    uint32_t ulIndex;
+
+    memcpy( ucPatch, "AFD1", 4 );
+    ulPatchLength = 4U;
+
+    for( ulIndex = 0U; ulIndex < 4U; ulIndex++ )
+    {
+        ucPatch[ ulPatchLength++ ] = ( uint8_t ) ( ulNewSize >> ( 8U * ulIndex ) );
+    }
+
+    for( ulIndex = 0U; ulIndex < 4U; ulIndex++ )
+    {
+        ucPatch[ ulPatchLength++ ] = ( uint8_t ) ( ulOldSize >> ( 8U * ulIndex ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Appends a record to the patch, making the ulDiffLength bytes of the
+ * new file at ulNewOffset from the bytes of the active image at ulOldOffset,
+ * followed by ulExtraLength bytes of the new file.
+ */
+static void prvPutRecord( uint32_t ulOldOffset,
+                          uint32_t ulNewOffset,
+                          uint32_t ulDiffLength,
+                          uint32_t ulExtraLength,
+                          int32_t lSeek )
+{
+    uint32_t ulIndex = 0U;
+    uint32_t ulEqual;
+    uint32_t ulChanged;
+
+    prvPutVarint( ulDiffLength );
+    prvPutVarint( ulExtraLength );
+    prvPutVarint( ( lSeek >= 0 ) ? ( ( uint32_t ) lSeek << 1 ) : ( ( ( uint32_t ) -lSeek << 1 ) - 1U ) );
+
+    while( ulIndex < ulDiffLength )
+    {
+        for( ulEqual = 0U;
+             ( ( ulIndex + ulEqual ) < ulDiffLength ) &&
+             ( ucOldImage[ ulOldOffset + ulIndex + ulEqual ] == ucNewImage[ ulNewOffset + ulIndex + ulEqual ] );
+             ulEqual++ )
+        {
+        }
+
+        ulIndex += ulEqual;
+
+        for( ulChanged = 0U;
+             ( ( ulIndex + ulChanged ) < ulDiffLength ) &&
+             ( ucOldImage[ ulOldOffset + ulIndex + ulChanged ] != ucNewImage[ ulNewOffset + ulIndex + ulChanged ] );
+             ulChanged++ )
+        {
+        }
+
+        prvPutVarint( ulEqual );
+        prvPutVarint( ulChanged );
+
+        for( ; ulChanged > 0U; ulChanged--, ulIndex++ )
+        {
+            ucPatch[ ulPatchLength++ ] = ( uint8_t ) ( ucNewImage[ ulNewOffset + ulIndex ] - ucOldImage[ ulOldOffset + ulIndex ] );
+        }
+    }
+
+    memcpy( &ucPatch[ ulPatchLength ], &ucNewImage[ ulNewOffset + ulDiffLength ], ulExtraLength );
+    ulPatchLength += ulExtraLength;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Applies a patch by chunks of ulChunkSize bytes.
+ *
+ * @return The error which stopped the patch, or the result of OTA_DeltaFinish.
+ */
+static OTA_DeltaErr_t prvApply( const uint8_t * pucPatch,
+                                uint32_t ulLength,
+                                uint32_t ulChunkSize )
+{
+    OTA_Delta_t xDelta;
+    OTA_DeltaErr_t eErr = eOTA_DeltaErr_None;
+    uint32_t ulOffset = 0U;
+    uint32_t ulChunk;
+
+    memset( ucWritten, 0, sizeof( ucWritten ) );
+    ulWrittenLength = 0U;
+    OTA_DeltaInit( &xDelta, prvReadOld, prvWriteNew, ucOldImage );
+
+    while( ( eErr == eOTA_DeltaErr_None ) && ( ulOffset < ulLength ) )
+    {
+        ulChunk = ( ( ulLength - ulOffset ) < ulChunkSize ) ? ( ulLength - ulOffset ) : ulChunkSize;
+        eErr = OTA_DeltaApply( &xDelta, &pucPatch[ ulOffset ], ulChunk );
+        ulOffset += ulChunk;
+    }
+
+    if( eErr == eOTA_DeltaErr_None )
+    {
+        eErr = OTA_DeltaFinish( &xDelta );
+    }
+
+    if( eErr == eOTA_DeltaErr_None )
+    {
+        TEST_ASSERT_EQUAL_UINT32( ulWrittenLength, OTA_DeltaNewSize( &xDelta ) );
+    }
+
+    return eErr;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Creates a patch of the test images, moving back in the active image
+ * for the repeated section at the end.
+ */
+static void prvMakePatch( void )
+{
+    prvPutHeader( otadeltatestNEW_SIZE, otadeltatestOLD_SIZE );
+    /* The start, then the inserted bytes. */
+    prvPutRecord( 0U, 0U, 700U, 64U, 0 );
+    /* The section after the insertion, skipping the deleted bytes. */
+    prvPutRecord( 700U, 764U, 800U, 0U, 100 );
+    /* The section after the deletion, then back to the start of the image. */
+    prvPutRecord( 1600U, 1564U, 448U, 0U, -2048 );
+    /* The repeated section. */
+    prvPutRecord( 0U, 2012U, 200U, 0U, 0 );
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_OTA_DELTA );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_OTA_DELTA )
+{
+    prvMakeImages();
+    xFailRead = pdFALSE;
+    xFailWrite = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_OTA_DELTA )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_OTA_DELTA )
+{
+    RUN_TEST_CASE( Full_OTA_DELTA, ApplyReconstructsNewFile );
+    RUN_TEST_CASE( Full_OTA_DELTA, ApplyToolPatch );
+    RUN_TEST_CASE( Full_OTA_DELTA, ApplyEmptyNewFile );
+    RUN_TEST_CASE( Full_OTA_DELTA, RejectMalformedPatch );
+    RUN_TEST_CASE( Full_OTA_DELTA, RejectPatchOutsideActiveImage );
+    RUN_TEST_CASE( Full_OTA_DELTA, ReportCallbackFailures );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, ApplyReconstructsNewFile )
+{
+    static const uint32_t ulChunkSizes[] = { 1U, 3U, 64U, 1024U, otadeltatestMAX_PATCH_SIZE };
+    uint32_t ulIndex;
+
+    prvMakePatch();
+
+    /* The chunk boundaries fall anywhere in the records. */
+    for( ulIndex = 0U; ulIndex < ( sizeof( ulChunkSizes ) / sizeof( ulChunkSizes[ 0 ] ) ); ulIndex++ )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApply( ucPatch, ulPatchLength, ulChunkSizes[ ulIndex ] ) );
+        TEST_ASSERT_EQUAL_UINT32( otadeltatestNEW_SIZE, ulWrittenLength );
+        TEST_ASSERT_EQUAL_UINT8_ARRAY( ucNewImage, ucWritten, otadeltatestNEW_SIZE );
+    }
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, ApplyToolPatch )
+{
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApply( ucToolPatch, sizeof( ucToolPatch ), 7U ) );
+    TEST_ASSERT_EQUAL_UINT32( otadeltatestNEW_SIZE, ulWrittenLength );
+    TEST_ASSERT_EQUAL_UINT8_ARRAY( ucNewImage, ucWritten, otadeltatestNEW_SIZE );
+
+    /* A few changes cost a small fraction of the file. */
+    TEST_ASSERT_TRUE( sizeof( ucToolPatch ) < ( otadeltatestNEW_SIZE / 8U ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, ApplyEmptyNewFile )
+{
+    prvPutHeader( 0U, otadeltatestOLD_SIZE );
+
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_None, prvApply( ucPatch, ulPatchLength, 5U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulWrittenLength );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, RejectMalformedPatch )
+{
+    uint32_t ulLength;
+
+    prvMakePatch();
+
+    /* Every truncation of the patch is incomplete. */
+    for( ulLength = 0U; ulLength < ulPatchLength; ulLength += 37U )
+    {
+        TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulLength, 16U ) );
+    }
+
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength - 1U, 16U ) );
+
+    /* Data after the end of the new file. */
+    ucPatch[ ulPatchLength ] = 0U;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength + 1U, 16U ) );
+
+    /* Not a patch. */
+    ucPatch[ 3 ] = '2';
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, ulWrittenLength );
+
+    /* A varint longer than 32 bits. */
+    prvPutHeader( otadeltatestNEW_SIZE, otadeltatestOLD_SIZE );
+    memset( &ucPatch[ ulPatchLength ], 0xFF, 5 );
+    ucPatch[ ulPatchLength + 5U ] = 0x01U;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength + 6U, 16U ) );
+
+    /* A record longer than the new file. */
+    prvPutHeader( 10U, otadeltatestOLD_SIZE );
+    prvPutVarint( 8U );
+    prvPutVarint( 3U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+
+    /* A diff pair making no progress. */
+    prvPutHeader( 10U, otadeltatestOLD_SIZE );
+    prvPutVarint( 10U );
+    prvPutVarint( 0U );
+    prvPutVarint( 0U );
+    prvPutVarint( 0U );
+    prvPutVarint( 0U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, RejectPatchOutsideActiveImage )
+{
+    /* Diff bytes past the end of the active image. */
+    prvPutHeader( 100U, 50U );
+    prvPutVarint( 60U );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+
+    /* A seek before the start of the active image. */
+    prvPutHeader( otadeltatestNEW_SIZE, otadeltatestOLD_SIZE );
+    prvPutRecord( 0U, 0U, 100U, 0U, -101 );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+
+    /* A seek past the end of the active image. */
+    prvPutHeader( otadeltatestNEW_SIZE, otadeltatestOLD_SIZE );
+    prvPutRecord( 0U, 0U, 100U, 0U, ( int32_t ) otadeltatestOLD_SIZE - 99 );
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_BadPatch, prvApply( ucPatch, ulPatchLength, 16U ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_DELTA, ReportCallbackFailures )
+{
+    prvMakePatch();
+
+    xFailRead = pdTRUE;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_ReadFailed, prvApply( ucPatch, ulPatchLength, 64U ) );
+
+    xFailRead = pdFALSE;
+    xFailWrite = pdTRUE;
+    TEST_ASSERT_EQUAL( eOTA_DeltaErr_WriteFailed, prvApply( ucPatch, ulPatchLength, 64U ) );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,415 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_ota_stream_benchmark.c
+ * @brief Benchmark of the OTA stream requests.
+ *
+ * The benchmark measures the time needed to receive a file from a simulated
+ * stream service, which stands in for the MQTT broker and the stream service
+ * so that the results do not depend on the network. It runs on a simulated
+ * clock: a request reaches the service after the link delay, the service then
+ * sends the requested blocks one after the other, and each block reaches the
+ * device after the link delay, unless it is lost. The device writes the blocks
+ * one at a time, and drops the blocks arriving while otabenchmarkRX_QUEUE_LENGTH
+ * blocks are already waiting, as the OTA agent does when its message queue or
+ * the MQTT buffers are full.
+ *
+ * The device either asks for every missing block in each request, only asking
+ * again after otaconfigFILE_REQUEST_WAIT_MS without any block received, or, if
+ * otaconfigENABLE_STREAM_WINDOW is set to 1 in aws_ota_agent_config.h, uses the
+ * stream request window of the OTA agent.
+ *
+ * The results are printed with configPRINTF.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* OTA includes. */
+#include "aws_ota_agent.h"
+#include "aws_ota_cbor.h"
+#include "aws_ota_agent_test_access_declare.h"
+
+/**
+ * @brief Size of the file received.
+ *
+ * @note Must be at most 8 * OTA_MAX_BLOCK_BITMAP_SIZE blocks.
+ */
+#ifndef otabenchmarkFILE_SIZE
+    #define otabenchmarkFILE_SIZE           ( 256UL * 1024UL )
+#endif
+
+/**
+ * @brief Time taken by a message to cross the link in each direction.
+ */
+#ifndef otabenchmarkLINK_DELAY_MS
+    #define otabenchmarkLINK_DELAY_MS       ( 40UL )
+#endif
+
+/**
+ * @brief Time taken by the stream service to send a block on the link.
+ */
+#ifndef otabenchmarkBLOCK_SEND_MS
+    #define otabenchmarkBLOCK_SEND_MS       ( 2UL )
+#endif
+
+/**
+ * @brief Time taken by the device to write a block.
+ */
+#ifndef otabenchmarkBLOCK_WRITE_MS
+    #define otabenchmarkBLOCK_WRITE_MS      ( 3UL )
+#endif
+
+/**
+ * @brief Number of received blocks which may wait to be written.
+ */
+#ifndef otabenchmarkRX_QUEUE_LENGTH
+    #define otabenchmarkRX_QUEUE_LENGTH     ( 6UL )
+#endif
+
+/**
+ * @brief Simulated time after which a transfer is given up.
+ */
+#define otabenchmarkMAX_TIME_MS             ( 3600000UL )
+
+/**
+ * @brief Number of blocks of the file received.
+ */
+#define otabenchmarkBLOCKS                  ( ( otabenchmarkFILE_SIZE + ( OTA_FILE_BLOCK_SIZE - 1UL ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE )
+
+/**
+ * @brief Size of the block bitmap of the file received.
+ */
+#define otabenchmarkBITMAP_SIZE             ( ( otabenchmarkBLOCKS + ( BITS_PER_BYTE - 1UL ) ) >> LOG2_BITS_PER_BYTE )
+
+/**
+ * @brief Number of blocks which may be on the link at the same time.
+ */
+#define otabenchmarkMAX_IN_FLIGHT           ( 2UL * otabenchmarkBLOCKS )
+
+/**
+ * @brief Size of the buffer the stream requests are encoded in.
+ */
+#define otabenchmarkREQUEST_SIZE            ( 512UL )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The results of a simulated transfer.
+ */
+typedef struct StreamResult
+{
+    TickType_t xDuration;    /**< Time taken to receive and write the whole file. */
+    uint32_t ulRequests;     /**< Number of stream requests sent. */
+    uint32_t ulRequestBytes; /**< Total size of the stream requests sent. */
+    uint32_t ulBlocksSent;   /**< Number of blocks sent by the stream service. */
+    uint32_t ulDuplicates;   /**< Number of blocks received more than once. */
+    uint32_t ulDropped;      /**< Number of blocks dropped by the device. */
+} StreamResult_t;
+
+/**
+ * @brief The file context of the transfer.
+ */
+static OTA_FileContext_t xContext;
+
+/**
+ * @brief The block bitmap of the transfer.
+ */
+static uint8_t ucRxBlockBitmap[ otabenchmarkBITMAP_SIZE ];
+
+/**
+ * @brief The blocks on the link, in the order they arrive, with their arrival
+ * times.
+ */
+static uint32_t ulInFlightBlocks[ otabenchmarkMAX_IN_FLIGHT ];
+static TickType_t xInFlightArrivals[ otabenchmarkMAX_IN_FLIGHT ];
+static uint32_t ulInFlightHead, ulInFlightCount;
+
+/**
+ * @brief Time at which the link is free to send the next block.
+ */
+static TickType_t xLinkFree;
+
+/**
+ * @brief State of the pseudo random numbers deciding which blocks are lost.
+ */
+static uint32_t ulRandom;
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Sends a stream request to the simulated stream service, which sends
+ * the requested blocks after the link delay.
+ */
+static void prvSendRequest( BaseType_t xWindowed,
+                            TickType_t xNow,
+                            uint32_t ulLossPermille,
+                            StreamResult_t * pxResult )
+{
+    uint8_t ucBitmap[ otabenchmarkBITMAP_SIZE + OTA_WINDOW_BITMAP_SIZE ];
+    uint8_t ucRequest[ otabenchmarkREQUEST_SIZE ];
+    size_t xRequestSize = 0;
+    uint32_t ulOffset = 0, ulBitmapLength = otabenchmarkBITMAP_SIZE, ulBit, ulBlock;
+
+    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+        if( xWindowed == pdTRUE )
+        {
+            ulOffset = TEST_OTA_prvStreamWindowRequest( &xContext, xNow, ucBitmap, &ulBitmapLength );
+        }
+        else
+    #endif
+    {
+        memcpy( ucBitmap, ucRxBlockBitmap, otabenchmarkBITMAP_SIZE );
+    }
+
+    TEST_ASSERT_EQUAL( pdTRUE, OTA_CBOR_Encode_GetStreamRequestMessage( ucRequest,
+                                                                        sizeof( ucRequest ),
+                                                                        &xRequestSize,
+                                                                        "rdy",
+                                                                        0,
+                                                                        ( int32_t ) OTA_FILE_BLOCK_SIZE,
+                                                                        ( int32_t ) ulOffset,
+                                                                        ucBitmap,
+                                                                        ulBitmapLength ) );
+    pxResult->ulRequests++;
+    pxResult->ulRequestBytes += ( uint32_t ) xRequestSize;
+
+    for( ulBit = 0; ulBit < ( ulBitmapLength * BITS_PER_BYTE ); ulBit++ )
+    {
+        ulBlock = ulOffset + ulBit;
+
+        if( ( ulBlock < otabenchmarkBLOCKS ) &&
+            ( ( ucBitmap[ ulBit >> LOG2_BITS_PER_BYTE ] & ( 1U << ( ulBit % BITS_PER_BYTE ) ) ) != 0U ) )
+        {
+            if( xLinkFree < ( xNow + pdMS_TO_TICKS( otabenchmarkLINK_DELAY_MS ) ) )
+            {
+                xLinkFree = xNow + pdMS_TO_TICKS( otabenchmarkLINK_DELAY_MS );
+            }
+
+            xLinkFree += pdMS_TO_TICKS( otabenchmarkBLOCK_SEND_MS );
+            pxResult->ulBlocksSent++;
+
+            ulRandom = ( ulRandom * 1103515245UL ) + 12345UL;
+
+            if( ( ( ( ulRandom >> 16 ) % 1000UL ) >= ulLossPermille ) && ( ulInFlightCount < otabenchmarkMAX_IN_FLIGHT ) )
+            {
+                ulInFlightBlocks[ ( ulInFlightHead + ulInFlightCount ) % otabenchmarkMAX_IN_FLIGHT ] = ulBlock;
+                xInFlightArrivals[ ( ulInFlightHead + ulInFlightCount ) % otabenchmarkMAX_IN_FLIGHT ] = xLinkFree + pdMS_TO_TICKS( otabenchmarkLINK_DELAY_MS );
+                ulInFlightCount++;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns the time to wait for blocks before sending a stream request
+ * again.
+ */
+static TickType_t prvRequestWait( BaseType_t xWindowed )
+{
+    TickType_t xWait = pdMS_TO_TICKS( otaconfigFILE_REQUEST_WAIT_MS );
+
+    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+        if( xWindowed == pdTRUE )
+        {
+            xWait = xContext.xWindowTimeout;
+        }
+    #endif
+
+    return xWait;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receives the file from the simulated stream service, with the given
+ * proportion of blocks lost on the link.
+ */
+static void prvStreamBenchmark( BaseType_t xWindowed,
+                                uint32_t ulLossPermille,
+                                StreamResult_t * pxResult )
+{
+    TickType_t xNow = 0, xTimerExpiry, xDeviceFree = 0;
+    uint32_t ulBlock;
+    uint8_t ucBitMask;
+
+    memset( pxResult, 0x00, sizeof( StreamResult_t ) );
+    memset( &xContext, 0x00, sizeof( xContext ) );
+    memset( ucRxBlockBitmap, ( int ) 0xff, sizeof( ucRxBlockBitmap ) );
+
+    for( ulBlock = otabenchmarkBLOCKS; ulBlock < ( otabenchmarkBITMAP_SIZE * BITS_PER_BYTE ); ulBlock++ )
+    {
+        ucRxBlockBitmap[ ulBlock >> LOG2_BITS_PER_BYTE ] &= ~( uint8_t ) ( 1U << ( ulBlock % BITS_PER_BYTE ) );
+    }
+
+    xContext.ulFileSize = otabenchmarkFILE_SIZE;
+    xContext.ulBlocksRemaining = otabenchmarkBLOCKS;
+    xContext.pucRxBlockBitmap = ucRxBlockBitmap;
+    ulInFlightHead = 0;
+    ulInFlightCount = 0;
+    xLinkFree = 0;
+    ulRandom = 1;
+
+    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+        if( xWindowed == pdTRUE )
+        {
+            /* The OTA agent sends the first window as soon as the job is received. */
+            TEST_OTA_prvStreamWindowInit( &xContext );
+            prvSendRequest( xWindowed, xNow, ulLossPermille, pxResult );
+        }
+    #endif
+
+    /* Otherwise the first request is sent when the request timer expires. */
+    xTimerExpiry = xNow + prvRequestWait( xWindowed );
+
+    while( ( xContext.ulBlocksRemaining > 0U ) && ( xNow < pdMS_TO_TICKS( otabenchmarkMAX_TIME_MS ) ) )
+    {
+        if( ( ulInFlightCount > 0U ) && ( xInFlightArrivals[ ulInFlightHead ] <= xTimerExpiry ) )
+        {
+            xNow = xInFlightArrivals[ ulInFlightHead ];
+            ulBlock = ulInFlightBlocks[ ulInFlightHead ];
+            ulInFlightHead = ( ulInFlightHead + 1U ) % otabenchmarkMAX_IN_FLIGHT;
+            ulInFlightCount--;
+
+            if( xDeviceFree > ( xNow + pdMS_TO_TICKS( otabenchmarkRX_QUEUE_LENGTH * otabenchmarkBLOCK_WRITE_MS ) ) )
+            {
+                pxResult->ulDropped++;
+            }
+            else
+            {
+                xDeviceFree = ( ( xDeviceFree > xNow ) ? xDeviceFree : xNow ) + pdMS_TO_TICKS( otabenchmarkBLOCK_WRITE_MS );
+                ucBitMask = ( uint8_t ) ( 1U << ( ulBlock % BITS_PER_BYTE ) );
+
+                if( ( ucRxBlockBitmap[ ulBlock >> LOG2_BITS_PER_BYTE ] & ucBitMask ) != 0U )
+                {
+                    ucRxBlockBitmap[ ulBlock >> LOG2_BITS_PER_BYTE ] &= ~ucBitMask;
+                    xContext.ulBlocksRemaining--;
+
+                    #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                        if( xWindowed == pdTRUE )
+                        {
+                            TEST_OTA_prvStreamWindowReceived( &xContext, ulBlock, xNow );
+                        }
+                    #endif
+                }
+                else
+                {
+                    pxResult->ulDuplicates++;
+                }
+
+                /* Every block received restarts the request timer. */
+                xTimerExpiry = xNow + prvRequestWait( xWindowed );
+
+                #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+                    if( ( xWindowed == pdTRUE ) && ( xContext.ulBlocksRemaining > 0U ) && ( xContext.ulWindowOutstanding == 0U ) )
+                    {
+                        prvSendRequest( xWindowed, xNow, ulLossPermille, pxResult );
+                        xTimerExpiry = xNow + prvRequestWait( xWindowed );
+                    }
+                #endif
+            }
+        }
+        else
+        {
+            xNow = xTimerExpiry;
+            prvSendRequest( xWindowed, xNow, ulLossPermille, pxResult );
+            xTimerExpiry = xNow + prvRequestWait( xWindowed );
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE( 0, xContext.ulBlocksRemaining, "The transfer did not complete." );
+
+    pxResult->xDuration = ( xDeviceFree > xNow ) ? xDeviceFree : xNow;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Prints the results of a simulated transfer.
+ */
+static void prvPrintResult( const char * pcMode,
+                            const StreamResult_t * pxResult )
+{
+    uint32_t ulMS = ( uint32_t ) pxResult->xDuration * portTICK_PERIOD_MS;
+
+    configPRINTF( ( "    %s: %u ms (%u KB/s), %u requests of %u bytes, %u blocks sent, %u duplicates, %u dropped\r\n",
+                    pcMode,
+                    ulMS,
+                    ( uint32_t ) ( ( ( uint64_t ) otabenchmarkFILE_SIZE * 1000ULL ) / ( ( uint64_t ) ( ulMS + 1U ) * 1024ULL ) ),
+                    pxResult->ulRequests,
+                    pxResult->ulRequestBytes / pxResult->ulRequests,
+                    pxResult->ulBlocksSent,
+                    pxResult->ulDuplicates,
+                    pxResult->ulDropped ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_OTA_STREAM_BENCHMARK );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_OTA_STREAM_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_OTA_STREAM_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_OTA_STREAM_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_OTA_STREAM_BENCHMARK, StreamThroughput );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_OTA_STREAM_BENCHMARK, StreamThroughput )
+{
+    static const uint32_t ulLossPermille[] = { 0, 10, 50 };
+    StreamResult_t xResult;
+    uint32_t x;
+
+    for( x = 0; x < ( sizeof( ulLossPermille ) / sizeof( ulLossPermille[ 0 ] ) ); x++ )
+    {
+        configPRINTF( ( "Stream of %u blocks of %u bytes with %u.%u%% of the blocks lost:\r\n",
+                        ( uint32_t ) otabenchmarkBLOCKS,
+                        ( uint32_t ) OTA_FILE_BLOCK_SIZE,
+                        ulLossPermille[ x ] / 10UL,
+                        ulLossPermille[ x ] % 10UL ) );
+
+        prvStreamBenchmark( pdFALSE, ulLossPermille[ x ], &xResult );
+        prvPrintResult( "whole bitmap requests", &xResult );
+
+        #if ( otaconfigENABLE_STREAM_WINDOW == 1 )
+            prvStreamBenchmark( pdTRUE, ulLossPermille[ x ], &xResult );
+            prvPrintResult( "windowed requests", &xResult );
+        #endif
+    }
+}
+/*-----------------------------------------------------------*/
@@ -38,6 +38,7 @@
 /* AWS includes. */
 #include "aws_clientcredential.h"
 #include "aws_shadow.h"
+#include "aws_shadow_cache.h"
 
 /* Unity framework includes. */
 #include "unity_fixture.h"
@@ -55,9 +56,31 @@ static char pcUpdateBuffer[ shadowBUFFER_LENGTH ];
 /* Delay between test loops. */
 #define shadowtestLOOP_DELAY    ( ( TickType_t ) 150 / portTICK_PERIOD_MS )
 
+/* Number of tasks updating the shadow document concurrently, and number of
+ * updates made by each task. */
+#define shadowtestCONCURRENT_TASKS           ( 4 )
+#define shadowtestUPDATES_PER_TASK           ( 5 )
+#define shadowtestCONCURRENT_STACK_SIZE      ( configMINIMAL_STACK_SIZE * 4 )
+#define shadowtestCONCURRENT_TASK_PRIORITY   ( tskIDLE_PRIORITY + 1 )
+
 /* notification from callbacks to task*/
 static SemaphoreHandle_t xShadowUpdateSemaphore;
 
+/* Parameters of the tasks updating the shadow document concurrently. */
+typedef struct ShadowTestUpdateTask
+{
+    ShadowClientHandle_t xShadowClientHandle;
+    BaseType_t xTaskNumber;
+    BaseType_t xFailures;
+    SemaphoreHandle_t xDoneSemaphore;
+} ShadowTestUpdateTask_t;
+
+/* Makes shadowtestUPDATES_PER_TASK updates, each with its own client token. */
+static void prvMakeUpdates( ShadowTestUpdateTask_t * pxTask );
+
+/* Task calling prvMakeUpdates. */
+static void prvUpdateTask( void * pvParameters );
+
 /* Generate initial shadow document */
 static uint32_t prvGenerateShadowJSON( void );
 
@@ -98,6 +121,13 @@ TEST_GROUP_RUNNER( Full_Shadow )
     RUN_TEST_CASE( Full_Shadow, CreateShadowDocument );
     RUN_TEST_CASE( Full_Shadow, DeleteShadowDocument );
     RUN_TEST_CASE( Full_Shadow, UpdateCallback );
+    RUN_TEST_CASE( Full_Shadow, ConcurrentUpdates );
+    #if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+        RUN_TEST_CASE( Full_Shadow, DocumentCache );
+        RUN_TEST_CASE( Full_Shadow, DocumentCacheApplyDelta );
+        RUN_TEST_CASE( Full_Shadow, DocumentCacheNestedUpdate );
+        RUN_TEST_CASE( Full_Shadow, DocumentCacheCoalesce );
+    #endif
 }
 
 /* Generate initial shadow document */
@@ -167,6 +197,51 @@ BaseType_t prvTestDeleteCallback( const char * const pcThingName,
     return pdFALSE;
 }
 
+static void prvMakeUpdates( ShadowTestUpdateTask_t * pxTask )
+{
+    ShadowOperationParams_t xOperationParams;
+    char cUpdateDocument[ 128 ];
+    BaseType_t xUpdate;
+
+    xOperationParams.pcThingName = shadowTHING_NAME;
+    xOperationParams.xQoS = eMQTTQoS1;
+    xOperationParams.pcData = cUpdateDocument;
+    xOperationParams.ucKeepSubscriptions = pdTRUE;
+
+    for( xUpdate = 0; xUpdate < shadowtestUPDATES_PER_TASK; xUpdate++ )
+    {
+        /* The client token routes the response to this task. */
+        xOperationParams.ulDataLength = ( uint32_t ) snprintf( cUpdateDocument, sizeof( cUpdateDocument ),
+                                                               "{"
+                                                               "\"state\":{"
+                                                               "\"reported\":{"
+                                                               "\"task%d\":%d"
+                                                               "}"
+                                                               "},"
+                                                               "\"clientToken\": \"" shadowCLIENT_TOKEN "-%d-%d\""
+                                                               "}",
+                                                               ( int ) pxTask->xTaskNumber, ( int ) xUpdate,
+                                                               ( int ) pxTask->xTaskNumber, ( int ) xUpdate );
+
+        if( SHADOW_Update( pxTask->xShadowClientHandle,
+                           &xOperationParams,
+                           shadowTIMEOUT ) != eShadowSuccess )
+        {
+            pxTask->xFailures++;
+        }
+    }
+}
+
+static void prvUpdateTask( void * pvParameters )
+{
+    ShadowTestUpdateTask_t * pxTask = ( ShadowTestUpdateTask_t * ) pvParameters;
+
+    prvMakeUpdates( pxTask );
+
+    ( void ) xSemaphoreGive( pxTask->xDoneSemaphore );
+    vTaskDelete( NULL );
+}
+
 /* helper functions for setting MQTT params. */
 void TEST_SHADOW_Connect_Helper( MQTTAgentConnectParams_t * xConnectParams,
                                  ShadowClientHandle_t * pxShadowClientHandle )
@@ -527,3 +602,360 @@ TEST( Full_Shadow, UpdateCallback )
         vSemaphoreDelete( xShadowUpdateSemaphore );
     }
 }
+
+/* Test for several shadow updates in progress on the same shadow client.*/
+TEST( Full_Shadow, ConcurrentUpdates )
+{
+    /*Init required params and shadow library for test.*/
+    ShadowClientHandle_t xShadowClientHandle;
+    BaseType_t xClientCreated = pdFALSE;
+    MQTTAgentConnectParams_t xConnectParams;
+    ShadowCreateParams_t xCreateParams;
+    ShadowReturnCode_t xReturn;
+    ShadowTestUpdateTask_t xTasks[ shadowtestCONCURRENT_TASKS ];
+    SemaphoreHandle_t xDoneSemaphore = NULL;
+    TickType_t xStart, xSequentialTicks, xConcurrentTicks;
+    BaseType_t xTask;
+
+    if( TEST_PROTECT() )
+    {
+        xDoneSemaphore = xSemaphoreCreateCounting( shadowtestCONCURRENT_TASKS, 0 );
+        TEST_ASSERT_TRUE( xDoneSemaphore != NULL );
+
+        xCreateParams.xMQTTClientType = eDedicatedMQTTClient;
+        xReturn = SHADOW_ClientCreate( &xShadowClientHandle, &xCreateParams );
+        TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+        xClientCreated = pdTRUE;
+
+        memset( &xConnectParams, 0x00, sizeof( xConnectParams ) );
+        TEST_SHADOW_Connect_Helper( &xConnectParams, &xShadowClientHandle );
+        xReturn = SHADOW_ClientConnect( xShadowClientHandle,
+                                        &xConnectParams,
+                                        shadowTIMEOUT );
+
+        TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+
+        for( xTask = 0; xTask < shadowtestCONCURRENT_TASKS; xTask++ )
+        {
+            xTasks[ xTask ].xShadowClientHandle = xShadowClientHandle;
+            xTasks[ xTask ].xTaskNumber = xTask;
+            xTasks[ xTask ].xFailures = 0;
+            xTasks[ xTask ].xDoneSemaphore = xDoneSemaphore;
+        }
+
+        /* Make all the updates one after the other, which is what a single
+         * in-progress operation per shadow client allows. The subscriptions
+         * made by the first update are kept for the others. */
+        xStart = xTaskGetTickCount();
+
+        for( xTask = 0; xTask < shadowtestCONCURRENT_TASKS; xTask++ )
+        {
+            prvMakeUpdates( &( xTasks[ xTask ] ) );
+        }
+
+        xSequentialTicks = xTaskGetTickCount() - xStart;
+
+        /* Make the same updates from concurrent tasks. */
+        xStart = xTaskGetTickCount();
+
+        for( xTask = 0; xTask < shadowtestCONCURRENT_TASKS; xTask++ )
+        {
+            TEST_ASSERT_EQUAL_MESSAGE( pdPASS,
+                                       xTaskCreate( prvUpdateTask,
+                                                    "ShadowUpdate",
+                                                    shadowtestCONCURRENT_STACK_SIZE,
+                                                    &( xTasks[ xTask ] ),
+                                                    shadowtestCONCURRENT_TASK_PRIORITY,
+                                                    NULL ),
+                                       "Task creation failed" );
+        }
+
+        for( xTask = 0; xTask < shadowtestCONCURRENT_TASKS; xTask++ )
+        {
+            TEST_ASSERT_EQUAL( pdTRUE, xSemaphoreTake( xDoneSemaphore, shadowTIMEOUT * shadowtestUPDATES_PER_TASK ) );
+        }
+
+        xConcurrentTicks = xTaskGetTickCount() - xStart;
+
+        for( xTask = 0; xTask < shadowtestCONCURRENT_TASKS; xTask++ )
+        {
+            TEST_ASSERT_EQUAL( 0, xTasks[ xTask ].xFailures );
+        }
+
+        configPRINTF( ( "%d shadow updates: %u ms one at a time, %u ms from %d tasks\r\n",
+                        shadowtestCONCURRENT_TASKS * shadowtestUPDATES_PER_TASK,
+                        ( unsigned ) ( xSequentialTicks * portTICK_PERIOD_MS ),
+                        ( unsigned ) ( xConcurrentTicks * portTICK_PERIOD_MS ),
+                        shadowtestCONCURRENT_TASKS ) );
+
+        xReturn = SHADOW_ClientDisconnect( xShadowClientHandle );
+        TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+    }
+    else
+    {
+        TEST_FAIL();
+    }
+
+    if( xClientCreated )
+    {
+        /* delete shadow client before returning.*/
+        xReturn = SHADOW_ClientDelete( xShadowClientHandle );
+        TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+    }
+
+    if( xDoneSemaphore != NULL )
+    {
+        vSemaphoreDelete( xDoneSemaphore );
+    }
+}
+
+#if ( shadowconfigENABLE_DOCUMENT_CACHE == 1 )
+
+/* Test for the shadow document cache, which publishes changed fields only. */
+    TEST( Full_Shadow, DocumentCache )
+    {
+        /*Init required params and shadow library for test.*/
+        ShadowClientHandle_t xShadowClientHandle;
+        BaseType_t xClientCreated = pdFALSE;
+        MQTTAgentConnectParams_t xConnectParams;
+        ShadowCreateParams_t xCreateParams;
+        ShadowReturnCode_t xReturn;
+        ShadowOperationParams_t xOperationParams;
+        static ShadowCache_t xCache;
+        char cValue[ 16 ];
+        const char cExpectedUpdate[] = "{\"state\":{\"reported\":{\"cache\":{\"level\":2}}},\"clientToken\":\"cache-3\"}";
+
+        if( TEST_PROTECT() )
+        {
+            xCreateParams.xMQTTClientType = eDedicatedMQTTClient;
+            xReturn = SHADOW_ClientCreate( &xShadowClientHandle, &xCreateParams );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+            xClientCreated = pdTRUE;
+
+            memset( &xConnectParams, 0x00, sizeof( xConnectParams ) );
+            TEST_SHADOW_Connect_Helper( &xConnectParams, &xShadowClientHandle );
+            xReturn = SHADOW_ClientConnect( xShadowClientHandle,
+                                            &xConnectParams,
+                                            shadowTIMEOUT );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+
+            memset( &xOperationParams, 0x00, sizeof( xOperationParams ) );
+            xOperationParams.pcThingName = shadowTHING_NAME;
+            xOperationParams.xQoS = eMQTTQoS1;
+            xOperationParams.ucKeepSubscriptions = pdTRUE;
+            xReturn = SHADOW_Delete( xShadowClientHandle,
+                                     &xOperationParams,
+                                     shadowTIMEOUT );
+            TEST_ASSERT_TRUE( ( xReturn == eShadowSuccess ) || ( xReturn == eShadowRejectedNotFound ) );
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheInit( &xCache, xShadowClientHandle, shadowTHING_NAME ) );
+
+            /* Both fields are new, so both are published. */
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "cache.color", "\"red\"" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "cache.level", "1" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheFlush( &xCache, pdTRUE, shadowTIMEOUT ) );
+
+            /* Only the level changes, so only the level is published. */
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "cache.color", "\"red\"" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "cache.level", "2" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheFlush( &xCache, pdTRUE, shadowTIMEOUT ) );
+            TEST_ASSERT_EQUAL( sizeof( cExpectedUpdate ) - 1, xCache.ulUpdateDocumentLength );
+            TEST_ASSERT_EQUAL_MEMORY( cExpectedUpdate, xCache.cUpdateDocument, xCache.ulUpdateDocumentLength );
+
+            /* Load the shadow document into a new cache. */
+            xReturn = SHADOW_Get( xShadowClientHandle,
+                                  &xOperationParams,
+                                  shadowTIMEOUT );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheInit( &xCache, xShadowClientHandle, shadowTHING_NAME ) );
+            xReturn = SHADOW_CacheApplyDocument( &xCache, xOperationParams.pcData, xOperationParams.ulDataLength );
+            ( void ) SHADOW_ReturnMQTTBuffer( xShadowClientHandle, xOperationParams.xBuffer );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetReported( &xCache, "cache.color", cValue, sizeof( cValue ) ) );
+            TEST_ASSERT_EQUAL_STRING( "\"red\"", cValue );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetReported( &xCache, "cache.level", cValue, sizeof( cValue ) ) );
+            TEST_ASSERT_EQUAL_STRING( "2", cValue );
+
+            /* Nothing changed since the document was loaded. */
+            TEST_ASSERT_EQUAL( pdFALSE, xCache.xChangesPending );
+
+            xReturn = SHADOW_ClientDisconnect( xShadowClientHandle );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+        }
+        else
+        {
+            TEST_FAIL();
+        }
+
+        if( xClientCreated )
+        {
+            /* delete shadow client before returning.*/
+            xReturn = SHADOW_ClientDelete( xShadowClientHandle );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+        }
+    }
+
+/* Test for the delta and document versions of the shadow document cache,
+ * without a connection. */
+    TEST( Full_Shadow, DocumentCacheApplyDelta )
+    {
+        static ShadowCache_t xCache;
+        char cValue[ 16 ];
+        const char cDocument[] = "{\"state\":{\"reported\":{\"light\":{\"color\":\"red\"}},"
+                                 "\"desired\":{\"light\":{\"color\":\"blue\"},\"fan\":1}},\"version\":5}";
+        const char cDelta[] = "{\"version\":7,\"state\":{\"light\":{\"color\":\"green\"}}}";
+        const char cStaleDelta[] = "{\"version\":6,\"state\":{\"light\":{\"color\":\"white\"}}}";
+        const char cStaleDocument[] = "{\"state\":{\"desired\":{\"light\":{\"color\":\"white\"}}},\"version\":7}";
+        const char cNewDocument[] = "{\"state\":{\"reported\":{\"light\":{\"color\":\"red\"}},"
+                                    "\"desired\":{\"light\":{\"color\":\"green\"}}},\"version\":8}";
+        const char cInvalidDelta[] = "{\"version\":9,\"state\":{\"light\":";
+
+        /* The cache does not publish anything, so it needs no client. */
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheInit( &xCache, NULL, shadowTHING_NAME ) );
+
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheApplyDocument( &xCache, cDocument, sizeof( cDocument ) - 1 ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetReported( &xCache, "light.color", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "\"red\"", cValue );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetDesired( &xCache, "light.color", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "\"blue\"", cValue );
+        TEST_ASSERT_EQUAL( pdFALSE, xCache.xChangesPending );
+
+        /* A delta changes the desired fields it contains only. */
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheApplyDelta( &xCache, cDelta, sizeof( cDelta ) - 1 ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetDesired( &xCache, "light.color", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "\"green\"", cValue );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetDesired( &xCache, "fan", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "1", cValue );
+
+        /* A delta or a document older than the last one applied, as
+         * delivered out of order, is dropped. */
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheApplyDelta( &xCache, cStaleDelta, sizeof( cStaleDelta ) - 1 ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheApplyDocument( &xCache, cStaleDocument, sizeof( cStaleDocument ) - 1 ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetDesired( &xCache, "light.color", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "\"green\"", cValue );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetDesired( &xCache, "fan", cValue, sizeof( cValue ) ) );
+
+        /* A newer document replaces the desired fields, but not a reported
+         * field changed since the last update. */
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "light.color", "\"yellow\"" ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheApplyDocument( &xCache, cNewDocument, sizeof( cNewDocument ) - 1 ) );
+        TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheGetReported( &xCache, "light.color", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL_STRING( "\"yellow\"", cValue );
+        TEST_ASSERT_EQUAL( eShadowFailure, SHADOW_CacheGetDesired( &xCache, "fan", cValue, sizeof( cValue ) ) );
+        TEST_ASSERT_EQUAL( pdTRUE, xCache.xChangesPending );
+
+        /* A delta which is not valid JSON returns the JSON error. */
+        TEST_ASSERT_TRUE( SHADOW_CacheApplyDelta( &xCache, cInvalidDelta, sizeof( cInvalidDelta ) - 1 ) < 0 );
+    }
+
+/* Test for the update document built for nested fields by the shadow document
+ * cache, without a connection. The update is built, then fails as the client
+ * is not connected. */
+    TEST( Full_Shadow, DocumentCacheNestedUpdate )
+    {
+        ShadowClientHandle_t xShadowClientHandle;
+        BaseType_t xClientCreated = pdFALSE;
+        ShadowCreateParams_t xCreateParams;
+        ShadowReturnCode_t xReturn;
+        static ShadowCache_t xCache;
+        const char cExpectedUpdate[] = "{\"state\":{\"reported\":{\"light\":{\"color\":\"red\",\"level\":3},"
+                                       "\"lightning\":false,\"power\":true,\"sensor\":{\"temp\":{\"max\":30}}}},"
+                                       "\"clientToken\":\"cache-5\"}";
+
+        if( TEST_PROTECT() )
+        {
+            xCreateParams.xMQTTClientType = eDedicatedMQTTClient;
+            xReturn = SHADOW_ClientCreate( &xShadowClientHandle, &xCreateParams );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+            xClientCreated = pdTRUE;
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheInit( &xCache, xShadowClientHandle, shadowTHING_NAME ) );
+
+            /* The fields are set out of order, and "lightning" shares the
+             * first characters of "light" but not the object. */
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "sensor.temp.max", "30" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "light.level", "3" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "power", "true" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "lightning", "false" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "light.color", "\"red\"" ) );
+
+            /* Setting a field to its value is not a change. */
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "power", "true" ) );
+
+            /* Invalid paths are rejected. */
+            TEST_ASSERT_EQUAL( eShadowFailure, SHADOW_CacheSetReported( &xCache, "light..color", "1" ) );
+            TEST_ASSERT_EQUAL( eShadowFailure, SHADOW_CacheSetReported( &xCache, "light.", "1" ) );
+
+            xReturn = SHADOW_CacheFlush( &xCache, pdTRUE, shadowTIMEOUT );
+            TEST_ASSERT_NOT_EQUAL( eShadowSuccess, xReturn );
+            TEST_ASSERT_EQUAL( sizeof( cExpectedUpdate ) - 1, xCache.ulUpdateDocumentLength );
+            TEST_ASSERT_EQUAL_MEMORY( cExpectedUpdate, xCache.cUpdateDocument, xCache.ulUpdateDocumentLength );
+
+            /* The fields of the failed update remain changed. */
+            TEST_ASSERT_EQUAL( pdTRUE, xCache.xChangesPending );
+        }
+        else
+        {
+            TEST_FAIL();
+        }
+
+        if( xClientCreated )
+        {
+            xReturn = SHADOW_ClientDelete( xShadowClientHandle );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+        }
+    }
+
+/* Test for the coalescing of the changes made to the shadow document cache,
+ * without a connection. */
+    TEST( Full_Shadow, DocumentCacheCoalesce )
+    {
+        ShadowClientHandle_t xShadowClientHandle;
+        BaseType_t xClientCreated = pdFALSE;
+        ShadowCreateParams_t xCreateParams;
+        ShadowReturnCode_t xReturn;
+        static ShadowCache_t xCache;
+        const char cExpectedUpdate[] = "{\"state\":{\"reported\":{\"door\":\"open\",\"level\":2}},\"clientToken\":\"cache-3\"}";
+
+        if( TEST_PROTECT() )
+        {
+            xCreateParams.xMQTTClientType = eDedicatedMQTTClient;
+            xReturn = SHADOW_ClientCreate( &xShadowClientHandle, &xCreateParams );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+            xClientCreated = pdTRUE;
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheInit( &xCache, xShadowClientHandle, shadowTHING_NAME ) );
+
+            /* Within the coalescing time, nothing is published. */
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "level", "1" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheFlush( &xCache, pdFALSE, shadowTIMEOUT ) );
+            TEST_ASSERT_EQUAL( 0, xCache.ulUpdateDocumentLength );
+
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "door", "\"open\"" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheSetReported( &xCache, "level", "2" ) );
+            TEST_ASSERT_EQUAL( eShadowSuccess, SHADOW_CacheFlush( &xCache, pdFALSE, shadowTIMEOUT ) );
+            TEST_ASSERT_EQUAL( 0, xCache.ulUpdateDocumentLength );
+
+            /* Once it has elapsed since the first change, all the changes are
+             * published in one update, with their last values. */
+            vTaskDelay( pdMS_TO_TICKS( shadowconfigCACHE_COALESCE_MS ) + 1 );
+            xReturn = SHADOW_CacheFlush( &xCache, pdFALSE, shadowTIMEOUT );
+            TEST_ASSERT_NOT_EQUAL( eShadowSuccess, xReturn );
+            TEST_ASSERT_EQUAL( sizeof( cExpectedUpdate ) - 1, xCache.ulUpdateDocumentLength );
+            TEST_ASSERT_EQUAL_MEMORY( cExpectedUpdate, xCache.cUpdateDocument, xCache.ulUpdateDocumentLength );
+        }
+        else
+        {
+            TEST_FAIL();
+        }
+
+        if( xClientCreated )
+        {
+            xReturn = SHADOW_ClientDelete( xShadowClientHandle );
+            TEST_ASSERT_EQUAL( eShadowSuccess, xReturn );
+        }
+    }
+
+#endif /* shadowconfigENABLE_DOCUMENT_CACHE */
@@ -91,6 +91,18 @@ static void RunTests( void )
         RUN_TEST_GROUP( Full_MQTT );
     #endif
 
+    #if ( testrunnerFULL_MQTT_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_MQTT_BENCHMARK );
+    #endif
+
+    #if ( testrunnerFULL_JSON_SCANNER_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_JSON_SCANNER );
+    #endif
+
+    #if ( testrunnerFULL_JSON_SCANNER_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_JSON_SCANNER_BENCHMARK );
+    #endif
+
     #if ( testrunnerFULL_MQTT_STRESS_TEST_ENABLED == 1 )
         RUN_TEST_GROUP( Full_MQTT_Agent_Stress_Tests );
     #endif
@@ -115,6 +127,26 @@ static void RunTests( void )
         RUN_TEST_GROUP( Full_OTA_PAL );
     #endif
 
+    #if ( testrunnerFULL_OTA_STREAM_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_OTA_STREAM_BENCHMARK );
+    #endif
+
+    #if ( testrunnerFULL_OTA_DELTA_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_OTA_DELTA );
+    #endif
+
+    #if ( testrunnerFULL_OTA_DECOMPRESS_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_OTA_DECOMPRESS );
+    #endif
+
+    #if ( testrunnerFULL_OTA_COMPRESS_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_OTA_COMPRESS_BENCHMARK );
+    #endif
+
+    #if ( testrunnerFULL_OTA_AGENT_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_OTA_AGENT_BENCHMARK );
+    #endif
+
     #if ( testrunnerFULL_PKCS11_ENABLED == 1 )
         RUN_TEST_GROUP( Full_PKCS11_CryptoOperation );
         RUN_TEST_GROUP( Full_PKCS11_GeneralPurpose );
@@ -151,6 +183,10 @@ static void RunTests( void )
         RUN_TEST_GROUP( Full_FREERTOS_TCP );
     #endif
 
+    #if ( testrunnerFULL_FREERTOS_TCP_BENCHMARK_ENABLED == 1 )
+        RUN_TEST_GROUP( Full_FREERTOS_TCP_BENCHMARK );
+    #endif
+
     #if ( testrunnerOTA_END_TO_END_ENABLED == 1 )
         extern void vStartOTAUpdateDemoTask( void );
         vStartOTAUpdateDemoTask();
@@ -0,0 +1,309 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_json_scanner.c
+ * @brief Tests of the streaming JSON scanner.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* JSON scanner includes. */
+#include "aws_json_scanner.h"
+
+/**
+ * @brief A Shadow update accepted document.
+ */
+static const char cUpdateDocument[] =
+    "{\"state\":{\"reported\":{\"light\":{\"color\":\"red\",\"level\":[1,2]}},\"desired\":null},"
+    "\"metadata\":{\"reported\":{\"light\":{\"color\":{\"timestamp\":1530000000}}}},"
+    "\"version\":17,\"timestamp\":1530000001,\"clientToken\":\"token-\\\"1\\\"\"}";
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Checks the next element of a scan.
+ */
+static void prvCheckNext( JSONScanner_t * pxScanner,
+                          JSONScanType_t eType,
+                          uint8_t ucDepth,
+                          const char * pcKey,
+                          const char * pcValue )
+{
+    JSONScanElement_t xElement;
+
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanNext( pxScanner, &xElement ) );
+    TEST_ASSERT_EQUAL( eType, xElement.eType );
+    TEST_ASSERT_EQUAL( ucDepth, xElement.ucDepth );
+
+    if( pcKey == NULL )
+    {
+        TEST_ASSERT_NULL( xElement.pcKey );
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL( strlen( pcKey ), xElement.ulKeyLength );
+        TEST_ASSERT_EQUAL_INT( 0, strncmp( pcKey, xElement.pcKey, xElement.ulKeyLength ) );
+    }
+
+    TEST_ASSERT_EQUAL( strlen( pcValue ), xElement.ulValueLength );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( pcValue, xElement.pcValue, xElement.ulValueLength ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns the status at which the scan of a document stops.
+ */
+static JSONScanStatus_t prvScanAll( const char * pcDoc,
+                                    uint32_t ulDocLength )
+{
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    JSONScanStatus_t xStatus;
+
+    JSON_ScanInit( &xScanner, pcDoc, ulDocLength );
+
+    do
+    {
+        xStatus = JSON_ScanNext( &xScanner, &xElement );
+    } while( xStatus == eJSONScanSuccess );
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_JSON_SCANNER );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_JSON_SCANNER )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_JSON_SCANNER )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_JSON_SCANNER )
+{
+    RUN_TEST_CASE( Full_JSON_SCANNER, ScanElements );
+    RUN_TEST_CASE( Full_JSON_SCANNER, ScanSkip );
+    RUN_TEST_CASE( Full_JSON_SCANNER, ScanErrors );
+    RUN_TEST_CASE( Full_JSON_SCANNER, ScanPaths );
+    RUN_TEST_CASE( Full_JSON_SCANNER, ScanPathsStopsEarly );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER, ScanElements )
+{
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    static const char cDoc[] = " { \"a\" : [ 1 , \"x\\\"y\" , { } , [ ] ] , \"b\":true,\"c\":{\"d\":-2.5e3} }";
+
+    JSON_ScanInit( &xScanner, cDoc, sizeof( cDoc ) - 1 );
+
+    prvCheckNext( &xScanner, eJSONScanObject, 0, NULL, "{" );
+    prvCheckNext( &xScanner, eJSONScanArray, 1, "a", "[" );
+    prvCheckNext( &xScanner, eJSONScanPrimitive, 2, NULL, "1" );
+    prvCheckNext( &xScanner, eJSONScanString, 2, NULL, "x\\\"y" );
+    prvCheckNext( &xScanner, eJSONScanObject, 2, NULL, "{" );
+    prvCheckNext( &xScanner, eJSONScanObjectEnd, 2, NULL, "{ }" );
+    prvCheckNext( &xScanner, eJSONScanArray, 2, NULL, "[" );
+    prvCheckNext( &xScanner, eJSONScanArrayEnd, 2, NULL, "[ ]" );
+    prvCheckNext( &xScanner, eJSONScanArrayEnd, 1, NULL, "[ 1 , \"x\\\"y\" , { } , [ ] ]" );
+    prvCheckNext( &xScanner, eJSONScanPrimitive, 1, "b", "true" );
+    prvCheckNext( &xScanner, eJSONScanObject, 1, "c", "{" );
+    prvCheckNext( &xScanner, eJSONScanPrimitive, 2, "d", "-2.5e3" );
+    prvCheckNext( &xScanner, eJSONScanObjectEnd, 1, NULL, "{\"d\":-2.5e3}" );
+    prvCheckNext( &xScanner, eJSONScanObjectEnd, 0, NULL, &( cDoc[ 1 ] ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanEnd, JSON_ScanNext( &xScanner, &xElement ) );
+    TEST_ASSERT_EQUAL( eJSONScanEnd, JSON_ScanNext( &xScanner, &xElement ) );
+
+    /* The document also ends at a NULL character, as when its length includes
+     * the terminator, and the text following the root value is ignored. */
+    TEST_ASSERT_EQUAL( eJSONScanEnd, prvScanAll( cUpdateDocument, sizeof( cUpdateDocument ) ) );
+    TEST_ASSERT_EQUAL( eJSONScanEnd, prvScanAll( "{}xyz", 5 ) );
+    TEST_ASSERT_EQUAL( eJSONScanEnd, prvScanAll( "42", 2 ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER, ScanSkip )
+{
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    static const char cDoc[] = "{\"a\":{\"b\":[\"}]\",{}],\"c\":1},\"d\":2}";
+
+    JSON_ScanInit( &xScanner, cDoc, sizeof( cDoc ) - 1 );
+
+    prvCheckNext( &xScanner, eJSONScanObject, 0, NULL, "{" );
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanNext( &xScanner, &xElement ) );
+    TEST_ASSERT_EQUAL( eJSONScanObject, xElement.eType );
+
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanSkip( &xScanner, &xElement ) );
+    TEST_ASSERT_EQUAL( eJSONScanObject, xElement.eType );
+    TEST_ASSERT_EQUAL( 1, xElement.ucDepth );
+    TEST_ASSERT_EQUAL( 1, xElement.ulKeyLength );
+    TEST_ASSERT_EQUAL_INT( 'a', xElement.pcKey[ 0 ] );
+    TEST_ASSERT_EQUAL( strlen( "{\"b\":[\"}]\",{}],\"c\":1}" ), xElement.ulValueLength );
+    TEST_ASSERT_EQUAL_PTR( &( cDoc[ 5 ] ), xElement.pcValue );
+
+    prvCheckNext( &xScanner, eJSONScanPrimitive, 1, "d", "2" );
+    prvCheckNext( &xScanner, eJSONScanObjectEnd, 0, NULL, cDoc );
+
+    /* An unterminated object cannot be skipped. */
+    JSON_ScanInit( &xScanner, cDoc, 12 );
+    prvCheckNext( &xScanner, eJSONScanObject, 0, NULL, "{" );
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanNext( &xScanner, &xElement ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, JSON_ScanSkip( &xScanner, &xElement ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER, ScanErrors )
+{
+    char cDeep[ ( jsonscanMAX_DEPTH + 1 ) * 2 ];
+    uint32_t ulIndex;
+
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( "", 0 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( "  ", 2 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( "{\"a\":1", 6 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( "{\"a\":\"xy", 8 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( "{\"a\"", 4 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, prvScanAll( cUpdateDocument, 40 ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "{a:1}", 5 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "{\"a\" 1}", 7 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "{\"a\":1]", 7 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "[1}", 3 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "[1 2]", 5 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "{\"a\":,}", 7 ) );
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, prvScanAll( "x", 1 ) );
+
+    /* Nesting up to the maximum depth is accepted. */
+    for( ulIndex = 0; ulIndex < jsonscanMAX_DEPTH; ulIndex++ )
+    {
+        cDeep[ ulIndex ] = '[';
+        cDeep[ ( 2 * jsonscanMAX_DEPTH ) - ulIndex - 1 ] = ']';
+    }
+
+    TEST_ASSERT_EQUAL( eJSONScanEnd, prvScanAll( cDeep, 2 * jsonscanMAX_DEPTH ) );
+
+    /* One more level is not. */
+    memmove( &( cDeep[ 1 ] ), cDeep, 2 * jsonscanMAX_DEPTH );
+    cDeep[ 0 ] = '[';
+    cDeep[ ( 2 * jsonscanMAX_DEPTH ) + 1 ] = ']';
+    TEST_ASSERT_EQUAL( eJSONScanTooDeep, prvScanAll( cDeep, sizeof( cDeep ) ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER, ScanPaths )
+{
+    JSONScanQuery_t xQueries[ 6 ];
+
+    memset( xQueries, 0x00, sizeof( xQueries ) );
+    xQueries[ 0 ].pcPath = "clientToken";
+    xQueries[ 1 ].pcPath = "state.reported.light.color";
+    xQueries[ 2 ].pcPath = "state.reported.light.level";
+    xQueries[ 3 ].pcPath = "version";
+    xQueries[ 4 ].pcPath = "state.reported";
+    xQueries[ 5 ].pcPath = "state.desired";
+
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanPaths( cUpdateDocument, sizeof( cUpdateDocument ) - 1, xQueries, 6 ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanString, xQueries[ 0 ].eType );
+    TEST_ASSERT_EQUAL( strlen( "token-\\\"1\\\"" ), xQueries[ 0 ].ulValueLength );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "token-\\\"1\\\"", xQueries[ 0 ].pcValue, xQueries[ 0 ].ulValueLength ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanString, xQueries[ 1 ].eType );
+    TEST_ASSERT_EQUAL( 3, xQueries[ 1 ].ulValueLength );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "red", xQueries[ 1 ].pcValue, 3 ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanArray, xQueries[ 2 ].eType );
+    TEST_ASSERT_EQUAL( 5, xQueries[ 2 ].ulValueLength );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "[1,2]", xQueries[ 2 ].pcValue, 5 ) );
+
+    TEST_ASSERT_EQUAL( eJSONScanPrimitive, xQueries[ 3 ].eType );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "17", xQueries[ 3 ].pcValue, xQueries[ 3 ].ulValueLength ) );
+
+    /* An object is found whole, even when other paths go through it. */
+    TEST_ASSERT_EQUAL( eJSONScanObject, xQueries[ 4 ].eType );
+    TEST_ASSERT_EQUAL( strlen( "{\"light\":{\"color\":\"red\",\"level\":[1,2]}}" ), xQueries[ 4 ].ulValueLength );
+    TEST_ASSERT_EQUAL_INT( '{', xQueries[ 4 ].pcValue[ 0 ] );
+
+    TEST_ASSERT_EQUAL( eJSONScanPrimitive, xQueries[ 5 ].eType );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "null", xQueries[ 5 ].pcValue, xQueries[ 5 ].ulValueLength ) );
+
+    /* Paths which are prefixes of keys, or go through arrays or values, are
+     * not found. */
+    memset( xQueries, 0x00, sizeof( xQueries ) );
+    xQueries[ 0 ].pcPath = "client";
+    xQueries[ 1 ].pcPath = "state.reported.light.level.0";
+    xQueries[ 2 ].pcPath = "version.x";
+    xQueries[ 3 ].pcPath = "timestamp";
+
+    TEST_ASSERT_EQUAL( eJSONScanEnd, JSON_ScanPaths( cUpdateDocument, sizeof( cUpdateDocument ) - 1, xQueries, 4 ) );
+    TEST_ASSERT_NULL( xQueries[ 0 ].pcValue );
+    TEST_ASSERT_NULL( xQueries[ 1 ].pcValue );
+    TEST_ASSERT_NULL( xQueries[ 2 ].pcValue );
+    TEST_ASSERT_EQUAL_INT( 0, strncmp( "1530000001", xQueries[ 3 ].pcValue, xQueries[ 3 ].ulValueLength ) );
+
+    /* The first of duplicate keys is kept. */
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanPaths( "{\"timestamp\":1,\"timestamp\":2}", 30, &( xQueries[ 3 ] ), 1 ) );
+    TEST_ASSERT_EQUAL_INT( '1', xQueries[ 3 ].pcValue[ 0 ] );
+
+    /* Errors met before all the values are found are returned. */
+    TEST_ASSERT_EQUAL( eJSONScanInvalid, JSON_ScanPaths( "{\"a\":1,\"timestamp\" 2}", 22, &( xQueries[ 3 ] ), 1 ) );
+    TEST_ASSERT_EQUAL( eJSONScanPartial, JSON_ScanPaths( "{\"a\":{\"timestamp\":2}", 20, &( xQueries[ 3 ] ), 1 ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER, ScanPathsStopsEarly )
+{
+    JSONScanQuery_t xQuery;
+    static const char cDoc[] = "{\"version\":3,\"state\":{\"x\":[}}}";
+
+    /* The invalid text following the version is never scanned. */
+    memset( &xQuery, 0x00, sizeof( xQuery ) );
+    xQuery.pcPath = "version";
+
+    TEST_ASSERT_EQUAL( eJSONScanSuccess, JSON_ScanPaths( cDoc, sizeof( cDoc ) - 1, &xQuery, 1 ) );
+    TEST_ASSERT_EQUAL_INT( '3', xQuery.pcValue[ 0 ] );
+    TEST_ASSERT_EQUAL( 1, xQuery.ulValueLength );
+
+    /* There is no limit on the number of values skipped. */
+    TEST_ASSERT_EQUAL( eJSONScanSuccess,
+                       JSON_ScanPaths( "{\"a\":[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20],\"version\":4}",
+                                       71, &xQuery, 1 ) );
+    TEST_ASSERT_EQUAL_INT( '4', xQuery.pcValue[ 0 ] );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,282 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_test_json_scanner_benchmark.c
+ * @brief Benchmarks of the streaming JSON scanner against jsmn.
+ *
+ * The lookup benchmark measures the time needed to find the version and the
+ * client token of Shadow documents, as the Shadow Client does for every
+ * response, by parsing the whole document into jsmn tokens and searching them,
+ * and with JSON_ScanPaths, which stops once both are found.
+ *
+ * The walk benchmark measures the time needed to visit every value of an OTA
+ * job document, as the OTA agent does, by parsing it into jsmn tokens and
+ * with JSON_ScanNext. It also prints the memory each of them needs.
+ *
+ * The results are printed with configPRINTF.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Unity framework includes. */
+#include "unity_fixture.h"
+
+/* JSON includes. */
+#include "aws_json_scanner.h"
+#include "jsmn.h"
+
+/**
+ * @brief Number of documents scanned in each measurement.
+ */
+#ifndef jsonbenchmarkDOCUMENTS
+    #define jsonbenchmarkDOCUMENTS    ( 20000UL )
+#endif
+
+/**
+ * @brief Number of jsmn tokens the documents are parsed into.
+ */
+#define jsonbenchmarkJSMN_TOKENS      ( 128 )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A Shadow get accepted document, with the metadata of every field.
+ */
+static const char cGetAcceptedDocument[] =
+    "{\"state\":{\"desired\":{\"light\":{\"color\":\"green\",\"level\":80},\"fan\":{\"speed\":3}},"
+    "\"reported\":{\"light\":{\"color\":\"red\",\"level\":55,\"modes\":[\"on\",\"off\",\"dim\"]},"
+    "\"fan\":{\"speed\":1,\"rpm\":1200},\"firmware\":\"1.4.2\",\"uptime\":86400},"
+    "\"delta\":{\"light\":{\"color\":\"green\",\"level\":80},\"fan\":{\"speed\":3}}},"
+    "\"metadata\":{\"desired\":{\"light\":{\"color\":{\"timestamp\":1530000100},\"level\":{\"timestamp\":1530000100}},"
+    "\"fan\":{\"speed\":{\"timestamp\":1530000200}}},"
+    "\"reported\":{\"light\":{\"color\":{\"timestamp\":1530000000},\"level\":{\"timestamp\":1530000000},"
+    "\"modes\":[{\"timestamp\":1530000000},{\"timestamp\":1530000000},{\"timestamp\":1530000000}]},"
+    "\"fan\":{\"speed\":{\"timestamp\":1530000000},\"rpm\":{\"timestamp\":1530000000}},"
+    "\"firmware\":{\"timestamp\":1520000000},\"uptime\":{\"timestamp\":1530000000}}},"
+    "\"version\":42,\"timestamp\":1530000300,\"clientToken\":\"f7a1c2d3e4b5a697\"}";
+
+/**
+ * @brief A Shadow delta document.
+ */
+static const char cDeltaDocument[] =
+    "{\"version\":43,\"timestamp\":1530000400,"
+    "\"state\":{\"light\":{\"color\":\"green\",\"level\":80},\"fan\":{\"speed\":3}},"
+    "\"metadata\":{\"light\":{\"color\":{\"timestamp\":1530000100},\"level\":{\"timestamp\":1530000100}},"
+    "\"fan\":{\"speed\":{\"timestamp\":1530000200}}},"
+    "\"clientToken\":\"f7a1c2d3e4b5a698\"}";
+
+/**
+ * @brief An OTA job document.
+ */
+static const char cJobDocument[] =
+    "{\"clientToken\":\"mytoken\",\"timestamp\":1508445004,\"execution\":{\"jobId\":\"15\",\"status\":\"QUEUED\","
+    "\"queuedAt\":1507697924,\"lastUpdatedAt\":1507697924,\"versionNumber\":1,\"executionNumber\":1,"
+    "\"jobDocument\":{\"afr_ota\": {\"streamname\": \"1\",\"files\": [{\"filepath\": \"payload.bin\","
+    "\"version\":\"1.0.0.0\",\"filesize\": 90860,\"fileid\": 0,\"attr\": 3,\"certfile\":\"rsasigner.crt\", "
+    "\"sig-sha256-rsa\":\"OHj5sNjxqMNK3WNEwbyfs/PeSSS1kzLkAQ4MSu0yKNFoGxJrUKuIWhjQbQiPlXcDtXlSXE8ydAwoxnnw5lcwpJsbXxD1"
+    "K1PwZJoc/3mv5XHXbvvEoFr4yA0rhY4tyrMDBesEtOVrW0yI4mM4Lde5OtdIxo8sjTSPGXo2Ejuhn+LDRD3gKdb1gtPpoJ/YBQmYKXHFQ5QW58GO"
+    "SlB9prq5v+MloVCATjmzb9tu4msScXYYy41ikEhK2eyfl7/vpc2vMNX6uhyyeZhku9namI4OZmsp72tLL4D4pFt4/nDWYSAo8sQAwns1RNY+j52"
+    "KfvgvKKN3u6G3suFyVQoxWJu3aA==\"}]}}}}";
+
+/**
+ * @brief The jsmn tokens the documents are parsed into.
+ */
+static jsmntok_t xTokens[ jsonbenchmarkJSMN_TOKENS ];
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parses a document into jsmn tokens and returns the value of a key of
+ * the root object, or NULL, as the Shadow Client used to.
+ */
+static const char * prvJSMNGetValue( const char * pcDoc,
+                                     int32_t lTokenCount,
+                                     const char * pcKey,
+                                     uint32_t * pulValueLength )
+{
+    const char * pcValue = NULL;
+    uint32_t ulKeyLength = ( uint32_t ) strlen( pcKey );
+    int32_t x;
+
+    for( x = 1; x < ( lTokenCount - 1 ); x++ )
+    {
+        if( ( xTokens[ x ].type == JSMN_STRING ) &&
+            ( xTokens[ x ].size == 1 ) &&
+            ( ( uint32_t ) ( xTokens[ x ].end - xTokens[ x ].start ) == ulKeyLength ) &&
+            ( strncmp( pcDoc + xTokens[ x ].start, pcKey, ulKeyLength ) == 0 ) )
+        {
+            pcValue = pcDoc + xTokens[ x + 1 ].start;
+            *pulValueLength = ( uint32_t ) ( xTokens[ x + 1 ].end - xTokens[ x + 1 ].start );
+            break;
+        }
+    }
+
+    return pcValue;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Looks up the version and the client token of a Shadow document
+ * jsonbenchmarkDOCUMENTS times with jsmn, and as many times with
+ * JSON_ScanPaths.
+ */
+static void prvLookupBenchmark( const char * pcName,
+                                const char * pcDoc,
+                                uint32_t ulDocLength )
+{
+    jsmn_parser xParser;
+    JSONScanQuery_t xQueries[ 2 ];
+    const char * pcVersion = NULL;
+    const char * pcClientToken = NULL;
+    uint32_t ulVersionLength = 0, ulClientTokenLength = 0;
+    TickType_t xStart;
+    uint32_t x, ulJSMNMS, ulScanMS;
+    int32_t lTokenCount = 0;
+
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < jsonbenchmarkDOCUMENTS; x++ )
+    {
+        jsmn_init( &xParser );
+        lTokenCount = ( int32_t ) jsmn_parse( &xParser, pcDoc, ( size_t ) ulDocLength, xTokens, jsonbenchmarkJSMN_TOKENS );
+        pcVersion = prvJSMNGetValue( pcDoc, lTokenCount, "version", &ulVersionLength );
+        pcClientToken = prvJSMNGetValue( pcDoc, lTokenCount, "clientToken", &ulClientTokenLength );
+    }
+
+    ulJSMNMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    TEST_ASSERT_GREATER_THAN( 0, lTokenCount );
+    TEST_ASSERT_NOT_NULL( pcVersion );
+    TEST_ASSERT_NOT_NULL( pcClientToken );
+
+    memset( xQueries, 0x00, sizeof( xQueries ) );
+    xQueries[ 0 ].pcPath = "version";
+    xQueries[ 1 ].pcPath = "clientToken";
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < jsonbenchmarkDOCUMENTS; x++ )
+    {
+        ( void ) JSON_ScanPaths( pcDoc, ulDocLength, xQueries, 2 );
+    }
+
+    ulScanMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    /* Both must find the same values. */
+    TEST_ASSERT_EQUAL_PTR( pcVersion, xQueries[ 0 ].pcValue );
+    TEST_ASSERT_EQUAL_UINT32( ulVersionLength, xQueries[ 0 ].ulValueLength );
+    TEST_ASSERT_EQUAL_PTR( pcClientToken, xQueries[ 1 ].pcValue );
+    TEST_ASSERT_EQUAL_UINT32( ulClientTokenLength, xQueries[ 1 ].ulValueLength );
+
+    configPRINTF( ( "Lookup in %s of %u bytes (%u tokens): jsmn %u ns, scanner %u ns per document\r\n",
+                    pcName,
+                    ulDocLength,
+                    ( uint32_t ) lTokenCount,
+                    ( uint32_t ) ( ( ( uint64_t ) ulJSMNMS * 1000000ULL ) / jsonbenchmarkDOCUMENTS ),
+                    ( uint32_t ) ( ( ( uint64_t ) ulScanMS * 1000000ULL ) / jsonbenchmarkDOCUMENTS ) ) );
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP( Full_JSON_SCANNER_BENCHMARK );
+/*-----------------------------------------------------------*/
+
+TEST_SETUP( Full_JSON_SCANNER_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_TEAR_DOWN( Full_JSON_SCANNER_BENCHMARK )
+{
+}
+/*-----------------------------------------------------------*/
+
+TEST_GROUP_RUNNER( Full_JSON_SCANNER_BENCHMARK )
+{
+    RUN_TEST_CASE( Full_JSON_SCANNER_BENCHMARK, ShadowLookup );
+    RUN_TEST_CASE( Full_JSON_SCANNER_BENCHMARK, JobDocumentWalk );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER_BENCHMARK, ShadowLookup )
+{
+    prvLookupBenchmark( "get accepted document", cGetAcceptedDocument, sizeof( cGetAcceptedDocument ) - 1UL );
+    prvLookupBenchmark( "delta document", cDeltaDocument, sizeof( cDeltaDocument ) - 1UL );
+}
+/*-----------------------------------------------------------*/
+
+TEST( Full_JSON_SCANNER_BENCHMARK, JobDocumentWalk )
+{
+    jsmn_parser xParser;
+    JSONScanner_t xScanner;
+    JSONScanElement_t xElement;
+    JSONScanStatus_t xStatus = eJSONScanSuccess;
+    TickType_t xStart;
+    uint32_t x, ulJSMNMS, ulScanMS, ulElements = 0;
+    int32_t lTokenCount = 0;
+
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < jsonbenchmarkDOCUMENTS; x++ )
+    {
+        jsmn_init( &xParser );
+        lTokenCount = ( int32_t ) jsmn_parse( &xParser, cJobDocument, sizeof( cJobDocument ) - 1UL, xTokens, jsonbenchmarkJSMN_TOKENS );
+    }
+
+    ulJSMNMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    TEST_ASSERT_GREATER_THAN( 0, lTokenCount );
+
+    xStart = xTaskGetTickCount();
+
+    for( x = 0; x < jsonbenchmarkDOCUMENTS; x++ )
+    {
+        JSON_ScanInit( &xScanner, cJobDocument, sizeof( cJobDocument ) - 1UL );
+        ulElements = 0;
+
+        do
+        {
+            xStatus = JSON_ScanNext( &xScanner, &xElement );
+            ulElements++;
+        } while( xStatus == eJSONScanSuccess );
+    }
+
+    ulScanMS = ( uint32_t ) ( xTaskGetTickCount() - xStart ) * portTICK_PERIOD_MS;
+
+    TEST_ASSERT_EQUAL( eJSONScanEnd, xStatus );
+
+    configPRINTF( ( "Walk of a job document of %u bytes: jsmn %u ns per document into %u tokens of %u bytes\r\n",
+                    ( uint32_t ) ( sizeof( cJobDocument ) - 1UL ),
+                    ( uint32_t ) ( ( ( uint64_t ) ulJSMNMS * 1000000ULL ) / jsonbenchmarkDOCUMENTS ),
+                    ( uint32_t ) lTokenCount,
+                    ( uint32_t ) ( ( uint32_t ) lTokenCount * sizeof( jsmntok_t ) ) ) );
+    configPRINTF( ( "    scanner %u ns per document into %u elements with a scan state of %u bytes\r\n",
+                    ( uint32_t ) ( ( ( uint64_t ) ulScanMS * 1000000ULL ) / jsonbenchmarkDOCUMENTS ),
+                    ulElements - 1U,
+                    ( uint32_t ) sizeof( JSONScanner_t ) ) );
+}
+/*-----------------------------------------------------------*/
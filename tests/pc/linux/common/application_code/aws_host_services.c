@@ -0,0 +1,1495 @@
+/*
+ * Amazon FreeRTOS
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file aws_host_services.c
+ * @brief Kernel and MQTT agent services of the Linux test runner.
+ *
+ * The test runner does not run the FreeRTOS kernel. This file provides the
+ * services the libraries under test use, on top of POSIX threads:
+ * - Each task is a thread, but only one task runs at a time, as on a single
+ *   core. The ready task of the highest priority runs, and the ready tasks of
+ *   the same priority take turns. A task runs until it blocks, deletes itself
+ *   or makes a task of a higher priority ready. There is no tick interrupt, so
+ *   the time-outs are only checked when a task is scheduled.
+ * - Critical sections only check their nesting, as no other task runs while a
+ *   task is in one.
+ * - Queues, event groups and delays block the calling task.
+ * - Timers expire in a timer service task.
+ * - Memory is allocated from the C library heap.
+ * - The MQTT clients are connected to a loopback broker. A message published
+ *   is delivered by an MQTT task to the matching subscriptions of the clients
+ *   connected. Like a TCP connection holds back the broker, the MQTT task waits
+ *   while hostMQTT_RECEIVE_BUFFERS messages were taken by the subscribers and
+ *   not returned yet.
+ *
+ * The process ends with the result of the tests once no task can run any more,
+ * normally when the test runner task deleted itself.
+ */
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "timers.h"
+#include "event_groups.h"
+
+/* MQTT agent include. */
+#include "aws_mqtt_agent.h"
+
+/* Unity includes. */
+#include "unity.h"
+
+#if ( mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT != 1 )
+    #error "The loopback broker delivers the messages to the callbacks of the subscriptions."
+#endif
+
+/**
+ * @brief Number of messages delivered by the MQTT task which the subscribers
+ * may hold at the same time.
+ *
+ * Must be less than the number of messages a subscriber queues, or the
+ * messages it cannot queue are lost. The OTA agent queues 6.
+ */
+#define hostMQTT_RECEIVE_BUFFERS     ( 4U )
+
+/**
+ * @brief Priority of the MQTT task, above the tasks using the MQTT agent.
+ */
+#define hostMQTT_TASK_PRIORITY       ( configMAX_PRIORITIES - 3 )
+
+/**
+ * @brief Maximum number of subscriptions a message is delivered to.
+ */
+#define hostMQTT_MAX_DELIVERIES      ( 8U )
+
+/**
+ * @brief State of a task.
+ */
+typedef enum HostTaskState
+{
+    eHostTaskReady,   /**< The task runs or waits for its turn. */
+    eHostTaskBlocked, /**< The task waits for a change of an object or for its time-out. */
+    eHostTaskDeleted  /**< The task is deleted, its thread exits. */
+} HostTaskState_t;
+
+/**
+ * @brief A task, run by a thread.
+ */
+typedef struct HostTask
+{
+    struct HostTask * pxNext;   /**< Next task in the list of the tasks. */
+    pthread_t xThread;          /**< The thread running the task. */
+    TaskFunction_t pxTaskCode;  /**< The function of the task. */
+    void * pvParameters;        /**< The parameter of the function of the task. */
+    UBaseType_t uxPriority;     /**< Priority of the task. */
+    HostTaskState_t eState;     /**< State of the task. */
+    uint32_t ulReadyOrder;      /**< Order in which the task became ready. The ready tasks of a priority run in this order. */
+    const void * pvBlockedOn;   /**< Object the blocked task waits for a change of, NULL if it only waits for its time-out. */
+    BaseType_t xHasTimeout;     /**< pdTRUE if the blocked task waits at most until xTimeout. */
+    TickType_t xTimeout;        /**< Tick count at which the blocked task stops waiting. */
+    BaseType_t xIsServiceTask;  /**< pdTRUE for the timer and MQTT tasks, which do not keep the process running. */
+} HostTask_t;
+
+/**
+ * @brief A queue, stored in the StaticQueue_t given on creation.
+ */
+typedef struct HostQueue
+{
+    uint8_t * pucStorage;   /**< Storage of the items, uxLength items of uxItemSize bytes. */
+    UBaseType_t uxLength;   /**< Maximum number of items in the queue. */
+    UBaseType_t uxItemSize; /**< Size of an item, in bytes. */
+    UBaseType_t uxHead;     /**< Index of the oldest item. */
+    UBaseType_t uxCount;    /**< Number of items in the queue. */
+} HostQueue_t;
+
+/**
+ * @brief A timer.
+ */
+typedef struct HostTimer
+{
+    struct HostTimer * pxNext;                   /**< Next timer in the list of the timers. */
+    TimerCallbackFunction_t pxCallbackFunction; /**< Function called when the timer expires. */
+    void * pvTimerID;                            /**< ID of the timer. */
+    TickType_t xPeriod;                          /**< Period of the timer, in ticks. */
+    TickType_t xExpiryTime;                      /**< Tick count at which the active timer expires. */
+    BaseType_t xAutoReload;                      /**< pdTRUE if the timer is started again when it expires. */
+    BaseType_t xActive;                          /**< pdTRUE if the timer is started. */
+    BaseType_t xStaticallyAllocated;             /**< pdTRUE if the timer was created by xTimerCreateStatic(). */
+} HostTimer_t;
+
+/**
+ * @brief An event group.
+ */
+typedef struct HostEventGroup
+{
+    EventBits_t uxEventBits; /**< The bits set in the group. */
+} HostEventGroup_t;
+
+/**
+ * @brief A subscription of an MQTT client. The topic filter follows the
+ * structure.
+ */
+typedef struct HostMQTTSubscription
+{
+    struct HostMQTTSubscription * pxNext;      /**< Next subscription of the client. */
+    MQTTPublishCallback_t pxPublishCallback;   /**< Callback of the subscription. */
+    void * pvPublishCallbackContext;           /**< Context passed to the callback. */
+    uint16_t usTopicFilterLength;              /**< Length of the topic filter. */
+} HostMQTTSubscription_t;
+
+/**
+ * @brief An MQTT client.
+ */
+typedef struct HostMQTTClient
+{
+    struct HostMQTTClient * pxNext;           /**< Next client in the list of the clients. */
+    BaseType_t xConnected;                    /**< pdTRUE if the client is connected to the broker. */
+    HostMQTTSubscription_t * pxSubscriptions; /**< The subscriptions of the client. */
+} HostMQTTClient_t;
+
+/**
+ * @brief A message published, or delivered to a client. The topic and the data
+ * follow the structure.
+ */
+typedef struct HostMQTTMessage
+{
+    struct HostMQTTMessage * pxNext; /**< Next message published, in the order they are delivered. */
+    MQTTQoS_t xQoS;                  /**< QoS of the message. */
+    uint16_t usTopicLength;          /**< Length of the topic. */
+    uint32_t ulDataLength;           /**< Length of the data. */
+} HostMQTTMessage_t;
+
+/**
+ * @brief A subscription a message is delivered to.
+ */
+typedef struct HostMQTTDelivery
+{
+    HostMQTTClient_t * pxClient;             /**< The client subscribed. */
+    MQTTPublishCallback_t pxPublishCallback; /**< Callback of the subscription. */
+    void * pvPublishCallbackContext;         /**< Context passed to the callback. */
+} HostMQTTDelivery_t;
+
+/* The handles are the structures above, which must fit in the buffers given
+ * for static creation. */
+#define hostASSERT_FITS( xType, xStaticType )    typedef char xType ## _fits[ ( sizeof( xType ) <= sizeof( xStaticType ) ) ? 1 : -1 ]
+hostASSERT_FITS( HostQueue_t, StaticQueue_t );
+hostASSERT_FITS( HostTimer_t, StaticTimer_t );
+
+/* Protects the kernel state while the tasks hand over the CPU. */
+static pthread_mutex_t xKernelMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signaled when another task is scheduled. */
+static pthread_cond_t xTaskSwitched = PTHREAD_COND_INITIALIZER;
+
+/* The tasks not deleted, the one running, and the number of them which are
+ * not service tasks. */
+static HostTask_t * pxTasks = NULL;
+static HostTask_t * pxCurrentTask = NULL;
+static UBaseType_t uxApplicationTasks = 0;
+
+/* Counts the tasks made ready, to order them. */
+static uint32_t ulReadyCounter = 0;
+
+/* Nesting of the critical sections, only tracked to catch unbalanced exits. */
+static UBaseType_t uxCriticalNesting = 0;
+
+/* The timers created. The timer service task waits for a change of the list
+ * when a timer is commanded. */
+static HostTimer_t * pxTimers = NULL;
+
+/* The MQTT clients created, the messages published and not delivered yet, and
+ * the number of messages delivered the subscribers did not return. */
+static HostMQTTClient_t * pxMQTTClients = NULL;
+static HostMQTTMessage_t * pxMQTTMessagesHead = NULL;
+static HostMQTTMessage_t * pxMQTTMessagesTail = NULL;
+static UBaseType_t uxMQTTBuffersInUse = 0;
+static HostTask_t * pxMQTTTask = NULL;
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns pdTRUE if the tick count xTime is reached at xNow.
+ */
+static BaseType_t prvTimeReached( TickType_t xTime,
+                                  TickType_t xNow )
+{
+    return ( ( TickType_t ) ( xNow - xTime ) < ( portMAX_DELAY >> 1 ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Makes a task ready to run, after the tasks of its priority already
+ * ready.
+ */
+static void prvMakeReady( HostTask_t * pxTask )
+{
+    pxTask->eState = eHostTaskReady;
+    pxTask->pvBlockedOn = NULL;
+    pxTask->xHasTimeout = pdFALSE;
+    pxTask->ulReadyOrder = ulReadyCounter++;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Selects the next task to run, waiting for a time-out if no task is
+ * ready. Ends the process if no task can run any more.
+ */
+static HostTask_t * prvSelectTask( void )
+{
+    HostTask_t * pxTask;
+    HostTask_t * pxSelected = NULL;
+    BaseType_t xHasTimeout;
+    TickType_t xNow, xTimeout = 0;
+    struct timespec xSleep;
+
+    while( pxSelected == NULL )
+    {
+        xNow = xTaskGetTickCount();
+        xHasTimeout = pdFALSE;
+
+        for( pxTask = pxTasks; pxTask != NULL; pxTask = pxTask->pxNext )
+        {
+            if( ( pxTask->eState == eHostTaskBlocked ) && ( pxTask->xHasTimeout == pdTRUE ) )
+            {
+                if( prvTimeReached( pxTask->xTimeout, xNow ) == pdTRUE )
+                {
+                    prvMakeReady( pxTask );
+                }
+                else if( ( xHasTimeout == pdFALSE ) || ( prvTimeReached( pxTask->xTimeout, xTimeout ) == pdTRUE ) )
+                {
+                    xTimeout = pxTask->xTimeout;
+                    xHasTimeout = pdTRUE;
+                }
+            }
+
+            if( ( pxTask->eState == eHostTaskReady ) &&
+                ( ( pxSelected == NULL ) ||
+                  ( pxTask->uxPriority > pxSelected->uxPriority ) ||
+                  ( ( pxTask->uxPriority == pxSelected->uxPriority ) &&
+                    ( ( int32_t ) ( pxTask->ulReadyOrder - pxSelected->ulReadyOrder ) < 0 ) ) ) )
+            {
+                pxSelected = pxTask;
+            }
+        }
+
+        if( pxSelected != NULL )
+        {
+            /* Run the selected task. */
+        }
+        else if( xHasTimeout == pdTRUE )
+        {
+            /* Nothing else runs until the first time-out, so the CPU is idle. */
+            xTimeout = ( TickType_t ) ( xTimeout - xNow ) * portTICK_PERIOD_MS;
+            xSleep.tv_sec = ( time_t ) ( xTimeout / 1000U );
+            xSleep.tv_nsec = ( long ) ( xTimeout % 1000U ) * 1000000L;
+            ( void ) nanosleep( &xSleep, NULL );
+        }
+        else if( uxApplicationTasks == 0U )
+        {
+            /* The tests are done. */
+            exit( ( Unity.TestFailures == 0U ) ? EXIT_SUCCESS : EXIT_FAILURE );
+        }
+        else
+        {
+            configPRINTF( ( "ERROR: All the tasks wait forever.\r\n" ) );
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    return pxSelected;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Waits for the turn of a task. Called with the kernel mutex held.
+ */
+static void prvWaitForTurn( HostTask_t * pxTask )
+{
+    while( pxCurrentTask != pxTask )
+    {
+        ( void ) pthread_cond_wait( &xTaskSwitched, &xKernelMutex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Runs the next task, once the state of the current one is updated.
+ * Returns once the current task runs again. Called with the kernel mutex held.
+ */
+static void prvSchedule( void )
+{
+    HostTask_t * const pxSelf = pxCurrentTask;
+
+    pxCurrentTask = prvSelectTask();
+
+    if( pxCurrentTask != pxSelf )
+    {
+        ( void ) pthread_cond_broadcast( &xTaskSwitched );
+        prvWaitForTurn( pxSelf );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Blocks the current task until an object changes or a number of ticks
+ * elapse. The object is NULL if the task only waits for the time-out, and the
+ * task waits forever if xTicksToWait is portMAX_DELAY. Called with the kernel
+ * mutex held.
+ */
+static void prvBlock( const void * pvObject,
+                      TickType_t xTicksToWait )
+{
+    HostTask_t * const pxSelf = pxCurrentTask;
+
+    pxSelf->eState = eHostTaskBlocked;
+    pxSelf->pvBlockedOn = pvObject;
+
+    if( xTicksToWait != portMAX_DELAY )
+    {
+        pxSelf->xHasTimeout = pdTRUE;
+        pxSelf->xTimeout = xTaskGetTickCount() + xTicksToWait;
+    }
+
+    prvSchedule();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns the number of ticks left to wait, or 0 once the time-out
+ * started at xTimeOutStart expired. Called with the kernel mutex held.
+ */
+static TickType_t prvTicksLeft( TickType_t xTimeOutStart,
+                                TickType_t xTicksToWait )
+{
+    TickType_t xElapsed = xTaskGetTickCount() - xTimeOutStart;
+
+    if( xTicksToWait == portMAX_DELAY )
+    {
+        xElapsed = 0;
+    }
+    else if( xElapsed >= xTicksToWait )
+    {
+        xElapsed = xTicksToWait;
+    }
+    else
+    {
+        /* Some ticks are left. */
+    }
+
+    return xTicksToWait - xElapsed;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Makes ready the tasks waiting for a change of an object, and runs
+ * them if they have a higher priority than the current task. Called with the
+ * kernel mutex held.
+ */
+static void prvNotify( const void * pvObject )
+{
+    HostTask_t * pxTask;
+    BaseType_t xPreempt = pdFALSE;
+
+    for( pxTask = pxTasks; pxTask != NULL; pxTask = pxTask->pxNext )
+    {
+        if( ( pxTask->eState == eHostTaskBlocked ) && ( pxTask->pvBlockedOn == pvObject ) )
+        {
+            prvMakeReady( pxTask );
+
+            if( pxTask->uxPriority > pxCurrentTask->uxPriority )
+            {
+                xPreempt = pdTRUE;
+            }
+        }
+    }
+
+    if( xPreempt == pdTRUE )
+    {
+        prvSchedule();
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The thread of a task.
+ */
+static void * prvTaskThread( void * pvTask )
+{
+    HostTask_t * const pxTask = ( HostTask_t * ) pvTask;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+    prvWaitForTurn( pxTask );
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    pxTask->pxTaskCode( pxTask->pvParameters );
+
+    /* The tasks must not return, delete the task if it does. */
+    vTaskDelete( NULL );
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Creates a task, ready to run. Called with the kernel mutex held.
+ */
+static HostTask_t * prvCreateTask( TaskFunction_t pxTaskCode,
+                                   void * const pvParameters,
+                                   UBaseType_t uxPriority,
+                                   BaseType_t xIsServiceTask )
+{
+    HostTask_t * pxTask = ( HostTask_t * ) pvPortMalloc( sizeof( HostTask_t ) );
+    pthread_attr_t xAttributes;
+
+    if( pxTask != NULL )
+    {
+        memset( pxTask, 0x00, sizeof( HostTask_t ) );
+        pxTask->pxTaskCode = pxTaskCode;
+        pxTask->pvParameters = pvParameters;
+        pxTask->uxPriority = ( uxPriority < configMAX_PRIORITIES ) ? uxPriority : ( configMAX_PRIORITIES - 1U );
+        pxTask->xIsServiceTask = xIsServiceTask;
+        prvMakeReady( pxTask );
+
+        ( void ) pthread_attr_init( &xAttributes );
+        ( void ) pthread_attr_setdetachstate( &xAttributes, PTHREAD_CREATE_DETACHED );
+
+        if( pthread_create( &pxTask->xThread, &xAttributes, prvTaskThread, pxTask ) == 0 )
+        {
+            pxTask->pxNext = pxTasks;
+            pxTasks = pxTask;
+
+            if( xIsServiceTask == pdFALSE )
+            {
+                uxApplicationTasks++;
+            }
+        }
+        else
+        {
+            vPortFree( pxTask );
+            pxTask = NULL;
+        }
+
+        ( void ) pthread_attr_destroy( &xAttributes );
+    }
+
+    return pxTask;
+}
+/*-----------------------------------------------------------*/
+
+void * pvPortMalloc( size_t xWantedSize )
+{
+    return malloc( xWantedSize );
+}
+/*-----------------------------------------------------------*/
+
+void vPortFree( void * pv )
+{
+    free( pv );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    configASSERT( uxCriticalNesting > 0U );
+    uxCriticalNesting--;
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    /* Let the other ready tasks of the same priority run first. */
+    prvMakeReady( pxCurrentTask );
+    prvSchedule();
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+}
+/*-----------------------------------------------------------*/
+
+TickType_t xTaskGetTickCount( void )
+{
+    static struct timespec xStart;
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    /* The tick count starts at 0 when it is first read. */
+    if( ( xStart.tv_sec == 0 ) && ( xStart.tv_nsec == 0 ) )
+    {
+        xStart = xNow;
+    }
+
+    return ( TickType_t ) ( ( ( ( uint64_t ) ( xNow.tv_sec - xStart.tv_sec ) * 1000ULL ) +
+                              ( ( int64_t ) xNow.tv_nsec - xStart.tv_nsec ) / 1000000LL ) /
+                            portTICK_PERIOD_MS );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    if( xTicksToDelay > 0U )
+    {
+        prvBlock( NULL, xTicksToDelay );
+    }
+    else
+    {
+        prvMakeReady( pxCurrentTask );
+        prvSchedule();
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const configSTACK_DEPTH_TYPE usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    HostTask_t * pxTask;
+    BaseType_t xReturn = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+
+    /* The threads have the default stack size of the host. */
+    ( void ) pcName;
+    ( void ) usStackDepth;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    pxTask = prvCreateTask( pxTaskCode, pvParameters, uxPriority & ~portPRIVILEGE_BIT, pdFALSE );
+
+    if( pxTask != NULL )
+    {
+        if( pxCreatedTask != NULL )
+        {
+            *pxCreatedTask = ( TaskHandle_t ) pxTask;
+        }
+
+        /* Run the new task now if it has a higher priority, once the scheduler is started. */
+        if( ( pxCurrentTask != NULL ) && ( pxTask->uxPriority > pxCurrentTask->uxPriority ) )
+        {
+            prvSchedule();
+        }
+
+        xReturn = pdPASS;
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDelete( TaskHandle_t xTaskToDelete )
+{
+    HostTask_t * pxTask;
+    HostTask_t ** ppxLink;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    /* Only the tasks deleting themselves are supported. */
+    pxTask = pxCurrentTask;
+    configASSERT( ( xTaskToDelete == NULL ) || ( xTaskToDelete == ( TaskHandle_t ) pxTask ) );
+
+    for( ppxLink = &pxTasks; *ppxLink != pxTask; ppxLink = &( *ppxLink )->pxNext )
+    {
+    }
+
+    *ppxLink = pxTask->pxNext;
+    pxTask->eState = eHostTaskDeleted;
+
+    if( pxTask->xIsServiceTask == pdFALSE )
+    {
+        uxApplicationTasks--;
+    }
+
+    /* Run the next task, which ends the process if no task is left. */
+    pxCurrentTask = prvSelectTask();
+    ( void ) pthread_cond_broadcast( &xTaskSwitched );
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    vPortFree( pxTask );
+    pthread_exit( NULL );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The timer service task. Calls the callbacks of the timers as they
+ * expire.
+ */
+static void prvTimerTask( void * pvParameters )
+{
+    HostTimer_t * pxTimer;
+    HostTimer_t * pxExpired;
+    TickType_t xNow, xTicksToWait;
+
+    ( void ) pvParameters;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    for( ; ; )
+    {
+        xNow = xTaskGetTickCount();
+        xTicksToWait = portMAX_DELAY;
+        pxExpired = NULL;
+
+        for( pxTimer = pxTimers; ( pxTimer != NULL ) && ( pxExpired == NULL ); pxTimer = pxTimer->pxNext )
+        {
+            if( pxTimer->xActive == pdTRUE )
+            {
+                if( prvTimeReached( pxTimer->xExpiryTime, xNow ) == pdTRUE )
+                {
+                    pxExpired = pxTimer;
+                }
+                else if( ( TickType_t ) ( pxTimer->xExpiryTime - xNow ) < xTicksToWait )
+                {
+                    xTicksToWait = pxTimer->xExpiryTime - xNow;
+                }
+                else
+                {
+                    /* Another timer expires first. */
+                }
+            }
+        }
+
+        if( pxExpired != NULL )
+        {
+            if( pxExpired->xAutoReload == pdTRUE )
+            {
+                pxExpired->xExpiryTime += pxExpired->xPeriod;
+            }
+            else
+            {
+                pxExpired->xActive = pdFALSE;
+            }
+
+            /* The callback may command or delete the timer. */
+            ( void ) pthread_mutex_unlock( &xKernelMutex );
+            pxExpired->pxCallbackFunction( ( TimerHandle_t ) pxExpired );
+            ( void ) pthread_mutex_lock( &xKernelMutex );
+        }
+        else
+        {
+            prvBlock( &pxTimers, xTicksToWait );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vTaskStartScheduler( void )
+{
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    ( void ) prvCreateTask( prvTimerTask, NULL, configTIMER_TASK_PRIORITY, pdTRUE );
+
+    pxCurrentTask = prvSelectTask();
+    ( void ) pthread_cond_broadcast( &xTaskSwitched );
+
+    /* The thread calling the scheduler is not a task, it never runs again. */
+    for( ; ; )
+    {
+        ( void ) pthread_cond_wait( &xTaskSwitched, &xKernelMutex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+QueueHandle_t xQueueGenericCreateStatic( const UBaseType_t uxQueueLength,
+                                         const UBaseType_t uxItemSize,
+                                         uint8_t * pucQueueStorage,
+                                         StaticQueue_t * pxStaticQueue,
+                                         const uint8_t ucQueueType )
+{
+    HostQueue_t * pxQueue = ( HostQueue_t * ) pxStaticQueue;
+
+    ( void ) ucQueueType;
+
+    pxQueue->pucStorage = pucQueueStorage;
+    pxQueue->uxLength = uxQueueLength;
+    pxQueue->uxItemSize = uxItemSize;
+    pxQueue->uxHead = 0;
+    pxQueue->uxCount = 0;
+
+    return ( QueueHandle_t ) pxQueue;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueGenericSend( QueueHandle_t xQueue,
+                              const void * const pvItemToQueue,
+                              TickType_t xTicksToWait,
+                              const BaseType_t xCopyPosition )
+{
+    HostQueue_t * pxQueue = ( HostQueue_t * ) xQueue;
+    const TickType_t xTimeOutStart = xTaskGetTickCount();
+    TickType_t xTicksLeft = xTicksToWait;
+    UBaseType_t uxIndex;
+    BaseType_t xReturn = errQUEUE_FULL;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    while( ( pxQueue->uxCount == pxQueue->uxLength ) && ( xTicksLeft > 0U ) )
+    {
+        prvBlock( pxQueue, xTicksLeft );
+        xTicksLeft = prvTicksLeft( xTimeOutStart, xTicksToWait );
+    }
+
+    if( pxQueue->uxCount < pxQueue->uxLength )
+    {
+        if( xCopyPosition == queueSEND_TO_FRONT )
+        {
+            pxQueue->uxHead = ( pxQueue->uxHead + pxQueue->uxLength - 1U ) % pxQueue->uxLength;
+            uxIndex = pxQueue->uxHead;
+        }
+        else
+        {
+            uxIndex = ( pxQueue->uxHead + pxQueue->uxCount ) % pxQueue->uxLength;
+        }
+
+        memcpy( &pxQueue->pucStorage[ uxIndex * pxQueue->uxItemSize ], pvItemToQueue, pxQueue->uxItemSize );
+        pxQueue->uxCount++;
+        xReturn = pdPASS;
+
+        prvNotify( pxQueue );
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * const pvBuffer,
+                          TickType_t xTicksToWait )
+{
+    HostQueue_t * pxQueue = ( HostQueue_t * ) xQueue;
+    const TickType_t xTimeOutStart = xTaskGetTickCount();
+    TickType_t xTicksLeft = xTicksToWait;
+    BaseType_t xReturn = errQUEUE_EMPTY;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    while( ( pxQueue->uxCount == 0U ) && ( xTicksLeft > 0U ) )
+    {
+        prvBlock( pxQueue, xTicksLeft );
+        xTicksLeft = prvTicksLeft( xTimeOutStart, xTicksToWait );
+    }
+
+    if( pxQueue->uxCount > 0U )
+    {
+        memcpy( pvBuffer, &pxQueue->pucStorage[ pxQueue->uxHead * pxQueue->uxItemSize ], pxQueue->uxItemSize );
+        pxQueue->uxHead = ( pxQueue->uxHead + 1U ) % pxQueue->uxLength;
+        pxQueue->uxCount--;
+        xReturn = pdPASS;
+
+        prvNotify( pxQueue );
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Initializes a timer and adds it to the list of the timers.
+ */
+static TimerHandle_t prvInitialiseTimer( HostTimer_t * pxTimer,
+                                         const TickType_t xTimerPeriodInTicks,
+                                         const UBaseType_t uxAutoReload,
+                                         void * const pvTimerID,
+                                         TimerCallbackFunction_t pxCallbackFunction,
+                                         BaseType_t xStaticallyAllocated )
+{
+    pxTimer->pxCallbackFunction = pxCallbackFunction;
+    pxTimer->pvTimerID = pvTimerID;
+    pxTimer->xPeriod = xTimerPeriodInTicks;
+    pxTimer->xExpiryTime = 0;
+    pxTimer->xAutoReload = ( uxAutoReload != 0U ) ? pdTRUE : pdFALSE;
+    pxTimer->xActive = pdFALSE;
+    pxTimer->xStaticallyAllocated = xStaticallyAllocated;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+    pxTimer->pxNext = pxTimers;
+    pxTimers = pxTimer;
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return ( TimerHandle_t ) pxTimer;
+}
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreate( const char * const pcTimerName,
+                            const TickType_t xTimerPeriodInTicks,
+                            const UBaseType_t uxAutoReload,
+                            void * const pvTimerID,
+                            TimerCallbackFunction_t pxCallbackFunction )
+{
+    HostTimer_t * pxTimer = ( HostTimer_t * ) pvPortMalloc( sizeof( HostTimer_t ) );
+    TimerHandle_t xTimer = NULL;
+
+    ( void ) pcTimerName;
+
+    if( pxTimer != NULL )
+    {
+        xTimer = prvInitialiseTimer( pxTimer, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction, pdFALSE );
+    }
+
+    return xTimer;
+}
+/*-----------------------------------------------------------*/
+
+TimerHandle_t xTimerCreateStatic( const char * const pcTimerName,
+                                  const TickType_t xTimerPeriodInTicks,
+                                  const UBaseType_t uxAutoReload,
+                                  void * const pvTimerID,
+                                  TimerCallbackFunction_t pxCallbackFunction,
+                                  StaticTimer_t * pxTimerBuffer )
+{
+    ( void ) pcTimerName;
+
+    return prvInitialiseTimer( ( HostTimer_t * ) pxTimerBuffer, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction, pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+void * pvTimerGetTimerID( const TimerHandle_t xTimer )
+{
+    return ( ( HostTimer_t * ) xTimer )->pvTimerID;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerGenericCommand( TimerHandle_t xTimer,
+                                 const BaseType_t xCommandID,
+                                 const TickType_t xOptionalValue,
+                                 BaseType_t * const pxHigherPriorityTaskWoken,
+                                 const TickType_t xTicksToWait )
+{
+    HostTimer_t * pxTimer = ( HostTimer_t * ) xTimer;
+    HostTimer_t ** ppxLink;
+
+    /* The commands are carried out at once, so there is no queue to wait for. */
+    ( void ) pxHigherPriorityTaskWoken;
+    ( void ) xTicksToWait;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    switch( xCommandID )
+    {
+        case tmrCOMMAND_START_DONT_TRACE:
+        case tmrCOMMAND_START:
+        case tmrCOMMAND_RESET:
+        case tmrCOMMAND_START_FROM_ISR:
+        case tmrCOMMAND_RESET_FROM_ISR:
+            /* The optional value is the tick count at which the timer was commanded. */
+            pxTimer->xExpiryTime = xOptionalValue + pxTimer->xPeriod;
+            pxTimer->xActive = pdTRUE;
+            break;
+
+        case tmrCOMMAND_STOP:
+        case tmrCOMMAND_STOP_FROM_ISR:
+            pxTimer->xActive = pdFALSE;
+            break;
+
+        case tmrCOMMAND_CHANGE_PERIOD:
+        case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR:
+            pxTimer->xPeriod = xOptionalValue;
+            pxTimer->xExpiryTime = xTaskGetTickCount() + xOptionalValue;
+            pxTimer->xActive = pdTRUE;
+            break;
+
+        case tmrCOMMAND_DELETE:
+
+            for( ppxLink = &pxTimers; *ppxLink != pxTimer; ppxLink = &( *ppxLink )->pxNext )
+            {
+            }
+
+            *ppxLink = pxTimer->pxNext;
+
+            if( pxTimer->xStaticallyAllocated == pdFALSE )
+            {
+                vPortFree( pxTimer );
+            }
+
+            break;
+
+        default:
+            /* The callbacks are not executed on command. */
+            break;
+    }
+
+    /* Let the timer service task update the time it waits for. */
+    prvNotify( &pxTimers );
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+EventGroupHandle_t xEventGroupCreate( void )
+{
+    HostEventGroup_t * pxEventGroup = ( HostEventGroup_t * ) pvPortMalloc( sizeof( HostEventGroup_t ) );
+
+    if( pxEventGroup != NULL )
+    {
+        pxEventGroup->uxEventBits = 0;
+    }
+
+    return ( EventGroupHandle_t ) pxEventGroup;
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupSetBits( EventGroupHandle_t xEventGroup,
+                                const EventBits_t uxBitsToSet )
+{
+    HostEventGroup_t * pxEventGroup = ( HostEventGroup_t * ) xEventGroup;
+    EventBits_t uxReturn;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    pxEventGroup->uxEventBits |= uxBitsToSet;
+    uxReturn = pxEventGroup->uxEventBits;
+    prvNotify( pxEventGroup );
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return uxReturn;
+}
+/*-----------------------------------------------------------*/
+
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t xEventGroup,
+                                 const EventBits_t uxBitsToWaitFor,
+                                 const BaseType_t xClearOnExit,
+                                 const BaseType_t xWaitForAllBits,
+                                 TickType_t xTicksToWait )
+{
+    HostEventGroup_t * pxEventGroup = ( HostEventGroup_t * ) xEventGroup;
+    const TickType_t xTimeOutStart = xTaskGetTickCount();
+    TickType_t xTicksLeft = xTicksToWait;
+    EventBits_t uxReturn;
+    BaseType_t xWaitConditionMet = pdFALSE;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    for( ; ; )
+    {
+        uxReturn = pxEventGroup->uxEventBits;
+
+        if( xWaitForAllBits == pdFALSE )
+        {
+            xWaitConditionMet = ( ( uxReturn & uxBitsToWaitFor ) != 0U ) ? pdTRUE : pdFALSE;
+        }
+        else
+        {
+            xWaitConditionMet = ( ( uxReturn & uxBitsToWaitFor ) == uxBitsToWaitFor ) ? pdTRUE : pdFALSE;
+        }
+
+        if( ( xWaitConditionMet == pdTRUE ) || ( xTicksLeft == 0U ) )
+        {
+            break;
+        }
+
+        prvBlock( pxEventGroup, xTicksLeft );
+        xTicksLeft = prvTicksLeft( xTimeOutStart, xTicksToWait );
+    }
+
+    if( ( xWaitConditionMet == pdTRUE ) && ( xClearOnExit != pdFALSE ) )
+    {
+        pxEventGroup->uxEventBits &= ~uxBitsToWaitFor;
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return uxReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vEventGroupDelete( EventGroupHandle_t xEventGroup )
+{
+    vPortFree( xEventGroup );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns pdTRUE if a topic matches a topic filter, with the '+' and
+ * '#' wildcards.
+ */
+static BaseType_t prvTopicMatches( const uint8_t * pucTopicFilter,
+                                   uint16_t usTopicFilterLength,
+                                   const uint8_t * pucTopic,
+                                   uint16_t usTopicLength )
+{
+    uint16_t usFilterIndex = 0, usTopicIndex = 0;
+    BaseType_t xMatch = pdTRUE;
+
+    while( ( usFilterIndex < usTopicFilterLength ) && ( xMatch == pdTRUE ) )
+    {
+        if( pucTopicFilter[ usFilterIndex ] == ( uint8_t ) '#' )
+        {
+            /* Matches the rest of the topic. */
+            usTopicIndex = usTopicLength;
+            usFilterIndex = usTopicFilterLength;
+        }
+        else if( pucTopicFilter[ usFilterIndex ] == ( uint8_t ) '+' )
+        {
+            /* Matches a level of the topic. */
+            while( ( usTopicIndex < usTopicLength ) && ( pucTopic[ usTopicIndex ] != ( uint8_t ) '/' ) )
+            {
+                usTopicIndex++;
+            }
+
+            usFilterIndex++;
+        }
+        else if( ( usTopicIndex < usTopicLength ) && ( pucTopic[ usTopicIndex ] == pucTopicFilter[ usFilterIndex ] ) )
+        {
+            usTopicIndex++;
+            usFilterIndex++;
+        }
+        else
+        {
+            xMatch = pdFALSE;
+        }
+    }
+
+    return ( ( xMatch == pdTRUE ) && ( usTopicIndex == usTopicLength ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Delivers a message to the subscriptions of a client, in a new buffer,
+ * until a callback takes the buffer. Frees the buffer if no callback takes it.
+ */
+static void prvDeliverMessage( const HostMQTTMessage_t * pxMessage,
+                               const HostMQTTDelivery_t * pxDeliveries,
+                               size_t xDeliveryCount )
+{
+    const size_t xMessageSize = sizeof( HostMQTTMessage_t ) + pxMessage->usTopicLength + pxMessage->ulDataLength;
+    HostMQTTMessage_t * pxBuffer;
+    MQTTPublishData_t xPublishData;
+    MQTTBool_t xTakeOwnership = eMQTTFalse;
+    size_t x;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    /* Wait for a subscriber to return a buffer. */
+    while( uxMQTTBuffersInUse >= hostMQTT_RECEIVE_BUFFERS )
+    {
+        prvBlock( &uxMQTTBuffersInUse, portMAX_DELAY );
+    }
+
+    uxMQTTBuffersInUse++;
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    pxBuffer = ( HostMQTTMessage_t * ) pvPortMalloc( xMessageSize );
+    configASSERT( pxBuffer != NULL );
+    memcpy( pxBuffer, pxMessage, xMessageSize );
+
+    memset( &xPublishData, 0x00, sizeof( xPublishData ) );
+    xPublishData.xQos = pxBuffer->xQoS;
+    xPublishData.pucTopic = ( const uint8_t * ) &pxBuffer[ 1 ];
+    xPublishData.usTopicLength = pxBuffer->usTopicLength;
+    xPublishData.pvData = &xPublishData.pucTopic[ pxBuffer->usTopicLength ];
+    xPublishData.ulDataLength = pxBuffer->ulDataLength;
+    xPublishData.xBuffer = ( MQTTBufferHandle_t ) pxBuffer;
+
+    for( x = 0; ( x < xDeliveryCount ) && ( xTakeOwnership == eMQTTFalse ); x++ )
+    {
+        xTakeOwnership = pxDeliveries[ x ].pxPublishCallback( pxDeliveries[ x ].pvPublishCallbackContext, &xPublishData );
+    }
+
+    if( xTakeOwnership == eMQTTFalse )
+    {
+        ( void ) MQTT_AGENT_ReturnBuffer( NULL, ( MQTTBufferHandle_t ) pxBuffer );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The MQTT task of the loopback broker. Delivers the messages published
+ * to the clients subscribed, in order.
+ */
+static void prvMQTTTask( void * pvParameters )
+{
+    HostMQTTDelivery_t xDeliveries[ hostMQTT_MAX_DELIVERIES ];
+    HostMQTTMessage_t * pxMessage;
+    HostMQTTClient_t * pxClient;
+    HostMQTTSubscription_t * pxSubscription;
+    size_t xDeliveryCount, xFirst, x;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) pthread_mutex_lock( &xKernelMutex );
+
+        while( pxMQTTMessagesHead == NULL )
+        {
+            prvBlock( &pxMQTTMessagesHead, portMAX_DELAY );
+        }
+
+        pxMessage = pxMQTTMessagesHead;
+        pxMQTTMessagesHead = pxMessage->pxNext;
+
+        if( pxMQTTMessagesHead == NULL )
+        {
+            pxMQTTMessagesTail = NULL;
+        }
+
+        /* Find the subscriptions before calling any callback, as the
+         * subscriptions may change while a callback blocks. */
+        xDeliveryCount = 0;
+
+        for( pxClient = pxMQTTClients; pxClient != NULL; pxClient = pxClient->pxNext )
+        {
+            for( pxSubscription = pxClient->pxSubscriptions;
+                 ( pxClient->xConnected == pdTRUE ) && ( pxSubscription != NULL ) && ( xDeliveryCount < hostMQTT_MAX_DELIVERIES );
+                 pxSubscription = pxSubscription->pxNext )
+            {
+                if( prvTopicMatches( ( const uint8_t * ) &pxSubscription[ 1 ],
+                                     pxSubscription->usTopicFilterLength,
+                                     ( const uint8_t * ) &pxMessage[ 1 ],
+                                     pxMessage->usTopicLength ) == pdTRUE )
+                {
+                    xDeliveries[ xDeliveryCount ].pxClient = pxClient;
+                    xDeliveries[ xDeliveryCount ].pxPublishCallback = pxSubscription->pxPublishCallback;
+                    xDeliveries[ xDeliveryCount ].pvPublishCallbackContext = pxSubscription->pvPublishCallbackContext;
+                    xDeliveryCount++;
+                }
+            }
+        }
+
+        ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+        /* Each client subscribed receives the message once. */
+        for( xFirst = 0; xFirst < xDeliveryCount; xFirst = x )
+        {
+            for( x = xFirst; ( x < xDeliveryCount ) && ( xDeliveries[ x ].pxClient == xDeliveries[ xFirst ].pxClient ); x++ )
+            {
+            }
+
+            prvDeliverMessage( pxMessage, &xDeliveries[ xFirst ], x - xFirst );
+        }
+
+        vPortFree( pxMessage );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Returns pdTRUE if the MQTT task calls the function, from a callback.
+ */
+static BaseType_t prvCalledFromCallback( void )
+{
+    return ( ( pxMQTTTask != NULL ) && ( pxCurrentTask == pxMQTTTask ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Create( MQTTAgentHandle_t * const pxMQTTHandle )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) pvPortMalloc( sizeof( HostMQTTClient_t ) );
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentFailure;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    if( pxMQTTTask == NULL )
+    {
+        pxMQTTTask = prvCreateTask( prvMQTTTask, NULL, hostMQTT_TASK_PRIORITY, pdTRUE );
+    }
+
+    if( ( pxClient != NULL ) && ( pxMQTTTask != NULL ) )
+    {
+        memset( pxClient, 0x00, sizeof( HostMQTTClient_t ) );
+        pxClient->pxNext = pxMQTTClients;
+        pxMQTTClients = pxClient;
+
+        *pxMQTTHandle = ( MQTTAgentHandle_t ) pxClient;
+        xReturn = eMQTTAgentSuccess;
+    }
+    else
+    {
+        vPortFree( pxClient );
+    }
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Delete( MQTTAgentHandle_t xMQTTHandle )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    HostMQTTClient_t ** ppxLink;
+    HostMQTTSubscription_t * pxSubscription;
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    for( ppxLink = &pxMQTTClients; *ppxLink != pxClient; ppxLink = &( *ppxLink )->pxNext )
+    {
+    }
+
+    *ppxLink = pxClient->pxNext;
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    while( pxClient->pxSubscriptions != NULL )
+    {
+        pxSubscription = pxClient->pxSubscriptions;
+        pxClient->pxSubscriptions = pxSubscription->pxNext;
+        vPortFree( pxSubscription );
+    }
+
+    vPortFree( pxClient );
+
+    return eMQTTAgentSuccess;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Connect( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentConnectParams_t * const pxConnectParams,
+                                          TickType_t xTimeoutTicks )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentAPICalledFromCallback;
+
+    /* Every client connects to the loopback broker. */
+    ( void ) pxConnectParams;
+    ( void ) xTimeoutTicks;
+
+    if( prvCalledFromCallback() == pdFALSE )
+    {
+        pxClient->xConnected = pdTRUE;
+        xReturn = eMQTTAgentSuccess;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Disconnect( MQTTAgentHandle_t xMQTTHandle,
+                                             TickType_t xTimeoutTicks )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentAPICalledFromCallback;
+
+    ( void ) xTimeoutTicks;
+
+    if( prvCalledFromCallback() == pdFALSE )
+    {
+        pxClient->xConnected = pdFALSE;
+        xReturn = eMQTTAgentSuccess;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Subscribe( MQTTAgentHandle_t xMQTTHandle,
+                                            const MQTTAgentSubscribeParams_t * const pxSubscribeParams,
+                                            TickType_t xTimeoutTicks )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    HostMQTTSubscription_t * pxSubscription;
+    HostMQTTSubscription_t ** ppxLink;
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentFailure;
+
+    ( void ) xTimeoutTicks;
+
+    if( prvCalledFromCallback() == pdTRUE )
+    {
+        xReturn = eMQTTAgentAPICalledFromCallback;
+    }
+    else if( pxClient->xConnected == pdTRUE )
+    {
+        pxSubscription = ( HostMQTTSubscription_t * ) pvPortMalloc( sizeof( HostMQTTSubscription_t ) + pxSubscribeParams->usTopicLength );
+
+        if( pxSubscription != NULL )
+        {
+            pxSubscription->pxNext = NULL;
+            pxSubscription->pxPublishCallback = pxSubscribeParams->pxPublishCallback;
+            pxSubscription->pvPublishCallbackContext = pxSubscribeParams->pvPublishCallbackContext;
+            pxSubscription->usTopicFilterLength = pxSubscribeParams->usTopicLength;
+            memcpy( &pxSubscription[ 1 ], pxSubscribeParams->pucTopic, pxSubscribeParams->usTopicLength );
+
+            /* The callbacks are called in the order of the subscriptions. */
+            ( void ) pthread_mutex_lock( &xKernelMutex );
+
+            for( ppxLink = &pxClient->pxSubscriptions; *ppxLink != NULL; ppxLink = &( *ppxLink )->pxNext )
+            {
+            }
+
+            *ppxLink = pxSubscription;
+
+            ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+            xReturn = eMQTTAgentSuccess;
+        }
+    }
+    else
+    {
+        /* The client is not connected. */
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Unsubscribe( MQTTAgentHandle_t xMQTTHandle,
+                                              const MQTTAgentUnsubscribeParams_t * const pxUnsubscribeParams,
+                                              TickType_t xTimeoutTicks )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    HostMQTTSubscription_t * pxSubscription = NULL;
+    HostMQTTSubscription_t ** ppxLink;
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentFailure;
+
+    ( void ) xTimeoutTicks;
+
+    if( prvCalledFromCallback() == pdTRUE )
+    {
+        xReturn = eMQTTAgentAPICalledFromCallback;
+    }
+    else if( pxClient->xConnected == pdTRUE )
+    {
+        ( void ) pthread_mutex_lock( &xKernelMutex );
+
+        for( ppxLink = &pxClient->pxSubscriptions; ( *ppxLink != NULL ) && ( pxSubscription == NULL ); )
+        {
+            if( ( ( *ppxLink )->usTopicFilterLength == pxUnsubscribeParams->usTopicLength ) &&
+                ( memcmp( &( *ppxLink )[ 1 ], pxUnsubscribeParams->pucTopic, pxUnsubscribeParams->usTopicLength ) == 0 ) )
+            {
+                pxSubscription = *ppxLink;
+                *ppxLink = pxSubscription->pxNext;
+            }
+            else
+            {
+                ppxLink = &( *ppxLink )->pxNext;
+            }
+        }
+
+        ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+        /* As a broker does, accept to unsubscribe from a topic filter not subscribed to. */
+        vPortFree( pxSubscription );
+        xReturn = eMQTTAgentSuccess;
+    }
+    else
+    {
+        /* The client is not connected. */
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_Publish( MQTTAgentHandle_t xMQTTHandle,
+                                          const MQTTAgentPublishParams_t * const pxPublishParams,
+                                          TickType_t xTimeoutTicks )
+{
+    HostMQTTClient_t * pxClient = ( HostMQTTClient_t * ) xMQTTHandle;
+    HostMQTTMessage_t * pxMessage;
+    MQTTAgentReturnCode_t xReturn = eMQTTAgentFailure;
+
+    ( void ) xTimeoutTicks;
+
+    if( prvCalledFromCallback() == pdTRUE )
+    {
+        xReturn = eMQTTAgentAPICalledFromCallback;
+    }
+    else if( pxClient->xConnected == pdTRUE )
+    {
+        pxMessage = ( HostMQTTMessage_t * ) pvPortMalloc( sizeof( HostMQTTMessage_t ) + pxPublishParams->usTopicLength + pxPublishParams->ulDataLength );
+
+        if( pxMessage != NULL )
+        {
+            pxMessage->pxNext = NULL;
+            pxMessage->xQoS = pxPublishParams->xQoS;
+            pxMessage->usTopicLength = pxPublishParams->usTopicLength;
+            pxMessage->ulDataLength = pxPublishParams->ulDataLength;
+            memcpy( &pxMessage[ 1 ], pxPublishParams->pucTopic, pxPublishParams->usTopicLength );
+            memcpy( ( uint8_t * ) &pxMessage[ 1 ] + pxPublishParams->usTopicLength, pxPublishParams->pvData, pxPublishParams->ulDataLength );
+
+            /* The broker acknowledges the message once it is queued. */
+            ( void ) pthread_mutex_lock( &xKernelMutex );
+
+            if( pxMQTTMessagesTail == NULL )
+            {
+                pxMQTTMessagesHead = pxMessage;
+            }
+            else
+            {
+                pxMQTTMessagesTail->pxNext = pxMessage;
+            }
+
+            pxMQTTMessagesTail = pxMessage;
+            prvNotify( &pxMQTTMessagesHead );
+
+            ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+            xReturn = eMQTTAgentSuccess;
+        }
+    }
+    else
+    {
+        /* The client is not connected. */
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+MQTTAgentReturnCode_t MQTT_AGENT_ReturnBuffer( MQTTAgentHandle_t xMQTTHandle,
+                                               MQTTBufferHandle_t xBufferHandle )
+{
+    ( void ) xMQTTHandle;
+
+    vPortFree( xBufferHandle );
+
+    ( void ) pthread_mutex_lock( &xKernelMutex );
+
+    uxMQTTBuffersInUse--;
+    prvNotify( &uxMQTTBuffersInUse );
+
+    ( void ) pthread_mutex_unlock( &xKernelMutex );
+
+    return eMQTTAgentSuccess;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,75 @@
+/*
+ * Amazon FreeRTOS V1.1.4
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdarg.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Test runner includes. */
+#include "aws_test_runner.h"
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    /* The test runner deletes its task once the tests are done, which ends
+     * the process with their result, see prvSelectTask() in
+     * aws_host_services.c. */
+    ( void ) xTaskCreate( TEST_RUNNER_RunTests_task,
+                          "TestRunner",
+                          configMINIMAL_STACK_SIZE * 16,
+                          NULL,
+                          tskIDLE_PRIORITY,
+                          NULL );
+
+    vTaskStartScheduler();
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list xArgs;
+
+    va_start( xArgs, pcFormat );
+    ( void ) vprintf( pcFormat, xArgs );
+    va_end( xArgs );
+
+    ( void ) fflush( stdout );
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingPrint( const char * pcMessage )
+{
+    ( void ) fputs( pcMessage, stdout );
+    ( void ) fflush( stdout );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,55 @@
+/*
+ * Amazon FreeRTOS V1.1.4
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+#ifndef AWS_TEST_RUNNER_CONFIG_H
+#define AWS_TEST_RUNNER_CONFIG_H
+
+/* Uncomment this line if you want to run AFQP tests only. */
+/* #define testrunnerAFQP_ENABLED */
+
+#define testrunnerUNSUPPORTED          0
+
+/* Unsupported tests. The Linux test runner has no network interface. */
+#define testrunnerFULL_WIFI_ENABLED    testrunnerUNSUPPORTED
+#define testrunnerFULL_TCP_ENABLED     testrunnerUNSUPPORTED
+
+
+/* Supported tests. 0 = Disabled, 1 = Enabled */
+#define testrunnerFULL_MQTT_ENABLED                  1
+#define testrunnerFULL_JSON_SCANNER_ENABLED          1
+#define testrunnerFULL_OTA_DELTA_ENABLED             1
+#define testrunnerFULL_OTA_DECOMPRESS_ENABLED        1
+
+/* The MQTT library benchmark includes the offline spool file benchmark,
+ * which keeps its region in mqttbenchmarkSPOOL_FILE_NAME. */
+#define testrunnerFULL_MQTT_BENCHMARK_ENABLED        1
+
+/* The OTA agent benchmark sends a file to the OTA agent through the loopback
+ * MQTT broker of application_code/aws_host_services.c, see
+ * aws_test_ota_agent_benchmark.c. */
+#define testrunnerFULL_OTA_AGENT_BENCHMARK_ENABLED    1
+
+#endif /* AWS_TEST_RUNNER_CONFIG_H */
@@ -83,11 +83,21 @@
  */
 #define mqttconfigMAX_BROKERS                  ( 4 )
 
+/**
+ * @brief Service each client with its own MQTT task.
+ */
+#define mqttconfigTASK_PER_BROKER              ( 1 )
+
 /**
  * @brief Maximum number of parallel operations per client.
  */
 #define mqttconfigMAX_PARALLEL_OPS             ( 5 )
 
+/**
+ * @brief Maximum number of asynchronous publish operations in progress.
+ */
+#define mqttconfigMAX_ASYNC_PUBLISHES          ( 16 )
+
 /**
  * @brief Time in milliseconds after which the TCP send operation should timeout.
  */
@@ -98,6 +108,14 @@
  */
 #define mqttconfigRX_BUFFER_SIZE               ( 1024 + 128 )
 
+/**
+ * @brief Length of the buffer in which the outgoing packets are gathered.
+ *
+ * Exercised by the asynchronous publish test, whose messages are queued back
+ * to back.
+ */
+#define mqttconfigTX_BATCH_SIZE                ( 1024 )
+
 /**
  * @brief The maximum time in ticks for which the MQTT task is permitted to block.
  */
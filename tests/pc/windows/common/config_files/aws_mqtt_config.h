@@ -60,4 +60,51 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #define mqttconfigENABLE_SUBSCRIPTION_MANAGEMENT    ( 1 )
 
+/**
+ * @brief Size the subscription manager pools for 256 subscriptions.
+ *
+ * Needed by the publish dispatch benchmark.
+ */
+#define mqttconfigSUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS    ( 256 )
+
+/**
+ * @brief Enable the in-flight message store.
+ *
+ * Needed by the in-flight store tests.
+ */
+#define mqttconfigENABLE_INFLIGHT_STORE             ( 1 )
+
+/**
+ * @brief Enable the zero-copy publish.
+ *
+ * Needed by the zero-copy publish tests.
+ */
+#define mqttconfigENABLE_ZERO_COPY_PUBLISH          ( 1 )
+
+/**
+ * @brief Enable the streaming receive.
+ *
+ * Needed by the streaming receive tests.
+ */
+#define mqttconfigENABLE_STREAMING_RECEIVE          ( 1 )
+
+/**
+ * @brief Enable MQTT 5.
+ *
+ * Needed by the MQTT 5 tests.
+ */
+#define mqttconfigENABLE_MQTT5                      ( 1 )
+
+/**
+ * @brief Enable the offline publish queue.
+ *
+ * Needed by the offline spool tests.
+ */
+#define mqttconfigENABLE_OFFLINE_QUEUE              ( 1 )
+
+/**
+ * @brief File holding the region of the offline spool benchmark.
+ */
+#define mqttbenchmarkSPOOL_FILE_NAME                "aws_mqtt_offline_spool.bin"
+
 #endif /* _AWS_MQTT_CONFIG_H_ */
@@ -90,4 +90,9 @@
  */
 #define shadowconfigCLEANUP_TIME_MS              ( 5000UL )
 
+/**
+ * @brief Enable the local Shadow document cache.
+ */
+#define shadowconfigENABLE_DOCUMENT_CACHE        ( 1 )
+
 #endif /* _AWS_SHADOW_CONFIG_H_ */
@@ -50,6 +50,7 @@
 #define testrunnerFULL_PKCS11_ENABLED              0
 #define testrunnerFULL_POSIX_ENABLED               0
 #define testrunnerFULL_SHADOW_ENABLED              0
+#define testrunnerFULL_JSON_SCANNER_ENABLED        0
 #define testrunnerFULL_TCP_ENABLED                 1
 #define testrunnerFULL_TLS_ENABLED                 0
 #define testrunnerFULL_MEMORYLEAK_ENABLED          0
@@ -58,6 +59,43 @@
 #define testrunnerFULL_OTA_PAL_ENABLED             0
 #define testrunnerOTA_END_TO_END_ENABLED           0
 
+/* The FreeRTOS+TCP benchmarks need the SimLink network interface instead of
+ * the WinPCap one, see aws_test_freertos_tcp_benchmark.c. Building the test
+ * project with /p:TestNetworkInterface=SimLink replaces the network interface
+ * and enables them. */
+#ifndef testrunnerFULL_FREERTOS_TCP_BENCHMARK_ENABLED
+    #define testrunnerFULL_FREERTOS_TCP_BENCHMARK_ENABLED    0
+#endif
+
+/* The MQTT publish dispatch benchmark needs room for hundreds of
+ * subscriptions, see aws_test_mqtt_lib_benchmark.c. */
+#define testrunnerFULL_MQTT_BENCHMARK_ENABLED            0
+
+/* The JSON scanner benchmark compares the scanner with jsmn, see
+ * aws_test_json_scanner_benchmark.c. */
+#define testrunnerFULL_JSON_SCANNER_BENCHMARK_ENABLED    0
+
+/* The OTA stream benchmark only compares windowed block requests with whole
+ * bitmap requests when otaconfigENABLE_STREAM_WINDOW is 1, see
+ * aws_test_ota_stream_benchmark.c. */
+#define testrunnerFULL_OTA_STREAM_BENCHMARK_ENABLED      0
+
+/* The OTA delta tests only need aws_ota_delta.c, which applies patches
+ * whether or not otaconfigENABLE_DELTA_UPDATE is 1. */
+#define testrunnerFULL_OTA_DELTA_ENABLED                 0
+
+/* The OTA decompression tests only need aws_ota_decompress.c, and the
+ * compression benchmark compares compressed updates with uncompressed ones,
+ * see aws_test_ota_compress_benchmark.c. */
+#define testrunnerFULL_OTA_DECOMPRESS_ENABLED            0
+#define testrunnerFULL_OTA_COMPRESS_BENCHMARK_ENABLED    0
+
+/* The OTA agent benchmark sends a file to the OTA agent through the MQTT
+ * broker, from a stand-in for the jobs and stream services, which needs a
+ * broker delivering its messages to the agent, see
+ * aws_test_ota_agent_benchmark.c. */
+#define testrunnerFULL_OTA_AGENT_BENCHMARK_ENABLED       0
+
 /* On systems using FreeRTOS+TCP (such as this one) the TCP segments must be
  * cleaned up before running the memory leak check. */
 #if ( testrunnerFULL_MEMORYLEAK_ENABLED == 1 )
@@ -0,0 +1,213 @@
+#!/usr/bin/python
+
+"""Compresses and decompresses the files of OTA compressed updates.
+
+The files are compressed as heatshrink streams, which the device decompresses
+as they are received with a small window. Their format is documented in
+lib/include/private/aws_ota_decompress.h.
+"""
+
+import argparse
+import struct
+import sys
+
+
+MAGIC = b'AFH1'
+HEADER = struct.Struct('<4sIBBH')
+
+# Window and lookahead sizes, as powers of 2. The window must not be larger
+# than otaconfigDECOMPRESS_WINDOW_BITS on the devices.
+DEFAULT_WINDOW_BITS = 10
+DEFAULT_LOOKAHEAD_BITS = 4
+MIN_WINDOW_BITS = 4
+MAX_WINDOW_BITS = 15
+MIN_LOOKAHEAD_BITS = 3
+
+# Length of the byte strings indexed to find back references.
+HASH_LENGTH = 3
+
+# Number of earlier positions tried for each back reference.
+MAX_CANDIDATES = 64
+
+
+class StreamError(Exception):
+    """Raised when a compressed file is malformed."""
+
+
+def _check_sizes(window_bits, lookahead_bits):
+    if not MIN_WINDOW_BITS <= window_bits <= MAX_WINDOW_BITS:
+        raise ValueError('The window bits must be from {} to {}.'.format(MIN_WINDOW_BITS, MAX_WINDOW_BITS))
+    if not MIN_LOOKAHEAD_BITS <= lookahead_bits < window_bits:
+        raise ValueError('The lookahead bits must be from {} to the window bits.'.format(MIN_LOOKAHEAD_BITS))
+
+
+class _BitWriter(object):
+
+    def __init__(self, out):
+        self.out = out
+        self.byte = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        for shift in range(bits - 1, -1, -1):
+            self.byte = (self.byte << 1) | ((value >> shift) & 1)
+            self.count += 1
+            if self.count == 8:
+                self.out.append(self.byte)
+                self.byte = 0
+                self.count = 0
+
+    def finish(self):
+        if self.count:
+            self.out.append(self.byte << (8 - self.count))
+
+
+def _longest_match(data, pos, candidates, window, max_length):
+    best_length = 0
+    best_offset = 0
+    limit = min(max_length, len(data) - pos)
+    for candidate in reversed(candidates[-MAX_CANDIDATES:]):
+        if pos - candidate > window:
+            break
+        length = 0
+        # The reference may overlap the bytes it makes, as they are copied one by one.
+        while length < limit and data[candidate + length] == data[pos + length]:
+            length += 1
+        if length > best_length:
+            best_length = length
+            best_offset = pos - candidate
+            if length == limit:
+                break
+    return best_length, best_offset
+
+
+def compress(data, window_bits=DEFAULT_WINDOW_BITS, lookahead_bits=DEFAULT_LOOKAHEAD_BITS):
+    """Returns the compressed file of data."""
+    _check_sizes(window_bits, lookahead_bits)
+    data = bytearray(data)
+    out = bytearray(HEADER.pack(MAGIC, len(data), window_bits, lookahead_bits, 0))
+    bits = _BitWriter(out)
+    window = 1 << window_bits
+    max_length = 1 << lookahead_bits
+    # A back reference only pays off if it is shorter than the literals it replaces.
+    min_length = (1 + window_bits + lookahead_bits) // 9 + 1
+    positions = {}
+    pos = 0
+    while pos < len(data):
+        key = bytes(data[pos:pos + HASH_LENGTH])
+        candidates = positions.get(key, [])
+        length, offset = _longest_match(data, pos, candidates, window, max_length)
+        if length < min_length:
+            length = 1
+            bits.write(1, 1)
+            bits.write(data[pos], 8)
+        else:
+            bits.write(0, 1)
+            bits.write(offset - 1, window_bits)
+            bits.write(length - 1, lookahead_bits)
+        for indexed in range(pos, pos + length):
+            chain = positions.setdefault(bytes(data[indexed:indexed + HASH_LENGTH]), [])
+            chain.append(indexed)
+            if len(chain) > 2 * MAX_CANDIDATES:
+                del chain[:MAX_CANDIDATES]
+        pos += length
+    bits.finish()
+    return bytes(out)
+
+
+def decompress(stream):
+    """Returns the file decompressed from a compressed file, as the device
+    decompresses it."""
+    stream = bytearray(stream)
+    if len(stream) < HEADER.size:
+        raise StreamError('The compressed file ends early.')
+    magic, size, window_bits, lookahead_bits, reserved = HEADER.unpack(bytes(stream[:HEADER.size]))
+    if magic != MAGIC:
+        raise StreamError('Not a compressed file.')
+    try:
+        _check_sizes(window_bits, lookahead_bits)
+    except ValueError as error:
+        raise StreamError(str(error))
+    if reserved:
+        raise StreamError('The header has non-zero reserved bytes.')
+
+    state = {'pos': HEADER.size * 8}
+
+    def read(count):
+        if state['pos'] + count > len(stream) * 8:
+            raise StreamError('The compressed file ends early.')
+        value = 0
+        for _ in range(count):
+            pos = state['pos']
+            value = (value << 1) | ((stream[pos >> 3] >> (7 - (pos & 7))) & 1)
+            state['pos'] = pos + 1
+        return value
+
+    out = bytearray()
+    while len(out) < size:
+        if read(1):
+            out.append(read(8))
+        else:
+            offset = read(window_bits) + 1
+            length = read(lookahead_bits) + 1
+            if length > size - len(out):
+                raise StreamError('A back reference goes past the end of the file.')
+            for _ in range(length):
+                # The bytes before the start of the file are zeros.
+                out.append(out[len(out) - offset] if offset <= len(out) else 0)
+    padding = len(stream) * 8 - state['pos']
+    if padding >= 8 or read(padding):
+        raise StreamError('The compressed file goes on after the file is complete.')
+    return bytes(out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Compress or decompress the files of OTA compressed updates.')
+    commands = parser.add_subparsers(dest='command')
+    compress_parser = commands.add_parser('compress', help='compress INPUT into OUTPUT')
+    compress_parser.add_argument('-w', '--window-bits', type=int, default=DEFAULT_WINDOW_BITS,
+                                 help='window size as a power of 2, at most otaconfigDECOMPRESS_WINDOW_BITS '
+                                      '(default: %(default)s)')
+    compress_parser.add_argument('-l', '--lookahead-bits', type=int, default=DEFAULT_LOOKAHEAD_BITS,
+                                 help='lookahead size as a power of 2 (default: %(default)s)')
+    compress_parser.add_argument('input')
+    compress_parser.add_argument('output')
+    decompress_parser = commands.add_parser('decompress', help='decompress INPUT, as the device would, into OUTPUT')
+    decompress_parser.add_argument('input')
+    decompress_parser.add_argument('output')
+    args = parser.parse_args(argv)
+
+    if args.command == 'compress':
+        with open(args.input, 'rb') as f:
+            data = f.read()
+        try:
+            stream = compress(data, args.window_bits, args.lookahead_bits)
+        except ValueError as error:
+            sys.stderr.write('Error: {}\n'.format(error))
+            return 1
+        # Check the compressed file before it is sent to devices.
+        if decompress(stream) != data:
+            sys.stderr.write('Error: the compressed file does not decompress into the input.\n')
+            return 1
+        with open(args.output, 'wb') as f:
+            f.write(stream)
+        print('{}: {} bytes, {:.1f}% of the input.'.format(args.output, len(stream),
+                                                          100.0 * len(stream) / max(len(data), 1)))
+    elif args.command == 'decompress':
+        with open(args.input, 'rb') as f:
+            stream = f.read()
+        try:
+            data = decompress(stream)
+        except StreamError as error:
+            sys.stderr.write('Error: {}\n'.format(error))
+            return 1
+        with open(args.output, 'wb') as f:
+            f.write(data)
+    else:
+        parser.print_help()
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
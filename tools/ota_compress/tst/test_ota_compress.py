@@ -0,0 +1,122 @@
+#!/usr/bin/python
+
+import os
+import sys
+my_path = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.dirname(my_path))
+
+import random
+import struct
+import pytest
+import src.ota_compress as ota_compress
+
+
+def random_bytes(rng, length):
+    return bytes(bytearray(rng.randint(0, 255) for _ in range(length)))
+
+
+def firmware_like(rng, length):
+    """Returns data with repeated short patterns, like code."""
+    patterns = [random_bytes(rng, rng.randint(2, 12)) for _ in range(64)]
+    out = bytearray()
+    while len(out) < length:
+        out.extend(rng.choice(patterns))
+    return bytes(out[:length])
+
+
+def header(size, window_bits=8, lookahead_bits=4):
+    return ota_compress.HEADER.pack(ota_compress.MAGIC, size, window_bits, lookahead_bits, 0)
+
+
+round_trip_params = [
+    (b'', 10, 4),
+    (b'a', 10, 4),
+    (b'abababababababababab', 4, 3),
+    (b'\x00' * 1000, 8, 4),
+    (b'\xff' * 70000, 10, 4),
+    (b'The quick brown fox jumps over the lazy dog. ' * 40, 11, 5),
+]
+@pytest.mark.parametrize('data, window_bits, lookahead_bits', round_trip_params)
+def test_round_trip(data, window_bits, lookahead_bits):
+    stream = ota_compress.compress(data, window_bits, lookahead_bits)
+    assert ota_compress.decompress(stream) == data
+
+
+@pytest.mark.parametrize('seed', range(4))
+def test_round_trip_firmware_like(seed):
+    rng = random.Random(seed)
+    data = firmware_like(rng, 65536)
+    stream = ota_compress.compress(data)
+    assert ota_compress.decompress(stream) == data
+    assert len(stream) < len(data) // 2
+
+
+def test_random_data_grows_by_one_bit_per_byte():
+    data = random_bytes(random.Random(1), 8192)
+    stream = ota_compress.compress(data)
+    assert ota_compress.decompress(stream) == data
+    assert len(stream) <= ota_compress.HEADER.size + (len(data) * 9 + 7) // 8
+
+
+def test_window_is_respected():
+    # The repeat is further away than a window of 2^8 bytes, but not of 2^10.
+    rng = random.Random(2)
+    block = random_bytes(rng, 300)
+    data = block + block
+    assert len(ota_compress.compress(data, 8, 4)) > len(ota_compress.compress(data, 10, 4)) + 100
+
+
+def test_literal_and_back_reference_bits():
+    # A literal 'a', then a back reference of offset 1 and length 3.
+    stream = ota_compress.compress(b'aaaa', 4, 3)
+    assert stream[ota_compress.HEADER.size:] == bytes(bytearray([0xB0, 0x81, 0x00]))
+
+
+def test_back_reference_before_start_reads_zeros():
+    # Offset 16, length 2, before any byte.
+    stream = header(2, 4, 3) + bytes(bytearray([0x79]))
+    assert ota_compress.decompress(stream) == b'\x00\x00'
+
+
+bad_sizes_params = [(3, 2), (16, 4), (8, 8), (8, 2)]
+@pytest.mark.parametrize('window_bits, lookahead_bits', bad_sizes_params)
+def test_bad_sizes(window_bits, lookahead_bits):
+    with pytest.raises(ValueError):
+        ota_compress.compress(b'data', window_bits, lookahead_bits)
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(header(0, window_bits, lookahead_bits))
+
+
+def test_bad_streams():
+    stream = ota_compress.compress(b'The quick brown fox jumps over the lazy dog. ' * 4)
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(b'AFD1' + stream[4:])
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(stream[:-1])
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(stream + b'\x00')
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(stream[:ota_compress.HEADER.size - 1])
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(stream[:-2] + struct.pack('<H', 0) + stream[-2:])
+    # A back reference of 4 bytes in a file of 2.
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(header(2, 4, 3) + bytes(bytearray([0x03, 0xC0])))
+    # Non-zero padding.
+    with pytest.raises(ota_compress.StreamError):
+        ota_compress.decompress(header(1, 4, 3) + bytes(bytearray([0xB0, 0x01])))
+
+
+def test_cli(tmpdir):
+    data = b'The quick brown fox jumps over the lazy dog. ' * 40
+    original = tmpdir.join('original.bin')
+    original.write_binary(data)
+    compressed = tmpdir.join('compressed.bin')
+    decompressed = tmpdir.join('decompressed.bin')
+    assert ota_compress.main(['compress', '-w', '9', str(original), str(compressed)]) == 0
+    assert compressed.read_binary()[8] == 9
+    assert ota_compress.main(['decompress', str(compressed), str(decompressed)]) == 0
+    assert decompressed.read_binary() == data
+    assert ota_compress.main(['compress', '-w', '20', str(original), str(compressed)]) == 1
+    original.write_binary(b'not compressed')
+    assert ota_compress.main(['decompress', str(original), str(decompressed)]) == 1
@@ -0,0 +1,308 @@
+#!/usr/bin/python
+
+"""Creates and applies the delta patches of OTA delta updates.
+
+A patch describes a new firmware image in terms of the image running on the
+device, so that only the differences are sent. Its format is documented in
+lib/include/private/aws_ota_delta.h. The device applies it as it is received.
+"""
+
+import argparse
+import struct
+import sys
+
+
+MAGIC = b'AFD1'
+HEADER = struct.Struct('<4sII')
+
+# Length of the byte strings indexed in the old image to find matches.
+SEED_LENGTH = 8
+
+# Distance between the indexed positions of the old image. Any match of at
+# least SEED_LENGTH + SEED_STRIDE - 1 bytes is found.
+SEED_STRIDE = 4
+
+# Minimum number of bytes a match must have to be used.
+MIN_MATCH = 16
+
+
+class PatchError(Exception):
+    """Raised when a patch is malformed or does not fit the old image."""
+
+
+def _write_varint(out, value):
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def _zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def _index(old):
+    """Maps the seeds of the old image to their first position."""
+    index = {}
+    for pos in range(0, len(old) - SEED_LENGTH + 1, SEED_STRIDE):
+        index.setdefault(old[pos:pos + SEED_LENGTH], pos)
+    return index
+
+
+def _extend_forward(old, new, old_pos, new_pos):
+    """Returns the length of the approximate match starting at both positions.
+
+    As in bsdiff, the match is extended as long as more than half of its bytes
+    are equal, and cut where that is best.
+    """
+    best_length = 0
+    best_score = 0
+    equal = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    for i in range(limit):
+        if old[old_pos + i] == new[new_pos + i]:
+            equal += 1
+        score = 2 * equal - (i + 1)
+        if score > best_score:
+            best_score = score
+            best_length = i + 1
+        elif score < best_score - 2 * MIN_MATCH:
+            break
+    return best_length
+
+
+def _extend_backward(old, new, old_pos, new_pos, new_limit):
+    """Returns the length of the approximate match ending before both
+    positions, not going back further than new_limit in the new image."""
+    best_length = 0
+    best_score = 0
+    equal = 0
+    limit = min(old_pos, new_pos - new_limit)
+    for i in range(1, limit + 1):
+        if old[old_pos - i] == new[new_pos - i]:
+            equal += 1
+        score = 2 * equal - i
+        if score > best_score:
+            best_score = score
+            best_length = i
+        elif score < best_score - 2 * MIN_MATCH:
+            break
+    return best_length
+
+
+def _find_matches(old, new):
+    """Returns the (new_pos, old_pos, length) approximate matches, in order
+    and without overlap in the new image."""
+    old = bytearray(old)
+    new = bytearray(new)
+    index = _index(bytes(old))
+    new_bytes = bytes(new)
+    matches = []
+    covered = 0
+    last_delta = None
+    pos = 0
+    while pos + SEED_LENGTH <= len(new):
+        old_pos = None
+        # Keep following the previous alignment when it still matches, which
+        # is the common case of code shifted by an insertion.
+        if last_delta is not None and 0 <= pos + last_delta <= len(old) - SEED_LENGTH and \
+                old[pos + last_delta:pos + last_delta + SEED_LENGTH] == new[pos:pos + SEED_LENGTH]:
+            old_pos = pos + last_delta
+        else:
+            found = index.get(new_bytes[pos:pos + SEED_LENGTH])
+            if found is not None:
+                old_pos = found
+        if old_pos is None:
+            pos += 1
+            continue
+        back = _extend_backward(old, new, old_pos, pos, covered)
+        length = back + _extend_forward(old, new, old_pos, pos)
+        if length < MIN_MATCH:
+            pos += 1
+            continue
+        matches.append((pos - back, old_pos - back, length))
+        last_delta = old_pos - pos
+        covered = pos - back + length
+        pos = covered
+    return matches
+
+
+def _diff_pairs(old, new, old_pos, new_pos, length):
+    """Yields the (equal, changed) pairs of the diff data of a match.
+
+    Runs of fewer than 4 equal bytes between differences are sent as
+    differences of 0, which is cheaper than starting a new pair.
+    """
+    i = 0
+    while i < length:
+        equal = 0
+        while i + equal < length and old[old_pos + i + equal] == new[new_pos + i + equal]:
+            equal += 1
+        start = i + equal
+        end = start
+        run = 0
+        for k in range(start, length):
+            if old[old_pos + k] == new[new_pos + k]:
+                run += 1
+                if run == 4:
+                    break
+            else:
+                run = 0
+                end = k + 1
+        yield equal, end - start
+        i = end
+
+
+def create(old, new):
+    """Returns the patch which turns old into new."""
+    out = bytearray(HEADER.pack(MAGIC, len(new), len(old)))
+    matches = _find_matches(old, new)
+    old = bytearray(old)
+    new = bytearray(new)
+
+    # Each record holds the diff bytes of a match, then the extra bytes up to
+    # the next match and the seek to it. The first one has no diff bytes.
+    spans = []
+    diff = (0, 0, 0)
+    for (match_new, match_old, length) in matches:
+        spans.append(diff + (match_new, match_old))
+        diff = (match_new, match_old, length)
+    spans.append(diff + (len(new), diff[1] + diff[2]))
+
+    for (diff_new, diff_old, diff_length, next_new, next_old) in spans:
+        extra_start = diff_new + diff_length
+        extra_length = next_new - extra_start
+        seek = next_old - (diff_old + diff_length)
+        if diff_length == 0 and extra_length == 0 and seek == 0:
+            continue
+        _write_varint(out, diff_length)
+        _write_varint(out, extra_length)
+        _write_varint(out, _zigzag(seek))
+        i = 0
+        for (equal, changed) in _diff_pairs(old, new, diff_old, diff_new, diff_length):
+            _write_varint(out, equal)
+            _write_varint(out, changed)
+            i += equal
+            for j in range(i, i + changed):
+                out.append((new[diff_new + j] - old[diff_old + j]) & 0xFF)
+            i += changed
+        out.extend(new[extra_start:next_new])
+    return bytes(out)
+
+
+class _Reader(object):
+
+    def __init__(self, data):
+        self.data = bytearray(data)
+        self.pos = 0
+
+    def take(self, length):
+        if length > len(self.data) - self.pos:
+            raise PatchError('The patch ends early.')
+        chunk = self.data[self.pos:self.pos + length]
+        self.pos += length
+        return chunk
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.take(1)[0]
+            if shift == 28 and byte & 0xF0:
+                raise PatchError('A varint does not fit in 32 bits.')
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value
+            shift += 7
+
+
+def apply(old, patch):
+    """Returns the new image made from old by the patch."""
+    old = bytearray(old)
+    reader = _Reader(patch)
+    magic, new_size, old_size = HEADER.unpack(bytes(reader.take(HEADER.size)))
+    if magic != MAGIC:
+        raise PatchError('Not a delta patch.')
+    if old_size != len(old):
+        raise PatchError('The patch is for an image of {} bytes, not {}.'.format(old_size, len(old)))
+    new = bytearray()
+    old_pos = 0
+    while len(new) < new_size:
+        diff_length = reader.varint()
+        extra_length = reader.varint()
+        seek = reader.varint()
+        seek = -((seek >> 1) + 1) if seek & 1 else seek >> 1
+        if diff_length > new_size - len(new) or diff_length > old_size - old_pos or \
+                extra_length > new_size - len(new) - diff_length:
+            raise PatchError('A record does not fit in the images.')
+        end = old_pos + diff_length
+        while old_pos < end:
+            equal = reader.varint()
+            changed = reader.varint()
+            if (equal == 0 and changed == 0) or equal + changed > end - old_pos:
+                raise PatchError('A diff pair does not fit in its record.')
+            new.extend(old[old_pos:old_pos + equal])
+            old_pos += equal
+            for change in reader.take(changed):
+                new.append((old[old_pos] + change) & 0xFF)
+                old_pos += 1
+        new.extend(reader.take(extra_length))
+        old_pos += seek
+        if not 0 <= old_pos <= old_size:
+            raise PatchError('A seek goes out of the old image.')
+    if reader.pos != len(reader.data):
+        raise PatchError('The patch goes on after the new image is complete.')
+    return bytes(new)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Create or apply OTA delta patches.')
+    commands = parser.add_subparsers(dest='command')
+    create_parser = commands.add_parser('create', help='create the patch turning OLD into NEW')
+    create_parser.add_argument('old')
+    create_parser.add_argument('new')
+    create_parser.add_argument('patch')
+    apply_parser = commands.add_parser('apply', help='apply PATCH to OLD, as the device would, into NEW')
+    apply_parser.add_argument('old')
+    apply_parser.add_argument('patch')
+    apply_parser.add_argument('new')
+    args = parser.parse_args(argv)
+
+    if args.command == 'create':
+        with open(args.old, 'rb') as f:
+            old = f.read()
+        with open(args.new, 'rb') as f:
+            new = f.read()
+        patch = create(old, new)
+        # Check the patch before it is sent to devices.
+        if apply(old, patch) != new:
+            sys.stderr.write('Error: the patch does not reconstruct the new image.\n')
+            return 1
+        with open(args.patch, 'wb') as f:
+            f.write(patch)
+        print('{}: {} bytes, {:.1f}% of the new image.'.format(args.patch, len(patch),
+                                                              100.0 * len(patch) / max(len(new), 1)))
+    elif args.command == 'apply':
+        with open(args.old, 'rb') as f:
+            old = f.read()
+        with open(args.patch, 'rb') as f:
+            patch = f.read()
+        try:
+            new = apply(old, patch)
+        except PatchError as error:
+            sys.stderr.write('Error: {}\n'.format(error))
+            return 1
+        with open(args.new, 'wb') as f:
+            f.write(new)
+    else:
+        parser.print_help()
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
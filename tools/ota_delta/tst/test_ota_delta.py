@@ -0,0 +1,124 @@
+#!/usr/bin/python
+
+import os
+import sys
+my_path = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.dirname(my_path))
+
+import random
+import pytest
+import src.ota_delta as ota_delta
+
+
+def random_bytes(rng, length):
+    return bytes(bytearray(rng.randint(0, 255) for _ in range(length)))
+
+
+def firmware_like(rng, length):
+    """Returns data with repeated short patterns, like code."""
+    patterns = [random_bytes(rng, rng.randint(2, 12)) for _ in range(64)]
+    out = bytearray()
+    while len(out) < length:
+        out.extend(rng.choice(patterns))
+    return bytes(out[:length])
+
+
+def edit(rng, old):
+    """Returns old with changed bytes, an insertion, a deletion and a moved
+    section, as a new firmware version would have."""
+    new = bytearray(old)
+    for _ in range(len(new) // 500 + 1):
+        pos = rng.randrange(len(new))
+        new[pos] = (new[pos] + rng.randint(1, 255)) & 0xFF
+    pos = rng.randrange(len(new))
+    new[pos:pos] = random_bytes(rng, 300)
+    pos = rng.randrange(len(new) - 200)
+    del new[pos:pos + 200]
+    pos = rng.randrange(len(new) - 1000)
+    section = new[pos:pos + 1000]
+    del new[pos:pos + 1000]
+    new.extend(section)
+    return bytes(new)
+
+
+edit_params = [(seed, length) for seed in range(4) for length in (4096, 65536)]
+@pytest.mark.parametrize('seed, length', edit_params)
+def test_round_trip_edited(seed, length):
+    rng = random.Random(seed)
+    old = firmware_like(rng, length)
+    new = edit(rng, old)
+    patch = ota_delta.create(old, new)
+    assert ota_delta.apply(old, patch) == new
+    # A few edits cost a small fraction of the image.
+    assert len(patch) < len(new) // 4
+
+
+round_trip_params = [
+    (b'', b''),
+    (b'', b'new image'),
+    (b'old image', b''),
+    (b'same image, same bytes', b'same image, same bytes'),
+]
+@pytest.mark.parametrize('old, new', round_trip_params)
+def test_round_trip_edge_cases(old, new):
+    assert ota_delta.apply(old, ota_delta.create(old, new)) == new
+
+
+def test_round_trip_unrelated():
+    rng = random.Random(10)
+    old = random_bytes(rng, 5000)
+    new = random_bytes(rng, 7000)
+    patch = ota_delta.create(old, new)
+    assert ota_delta.apply(old, patch) == new
+    assert len(patch) < len(new) + 32
+
+
+def test_round_trip_appended():
+    rng = random.Random(11)
+    old = firmware_like(rng, 20000)
+    new = old + random_bytes(rng, 100)
+    patch = ota_delta.create(old, new)
+    assert ota_delta.apply(old, patch) == new
+    assert len(patch) < 200
+
+
+def test_apply_rejects_other_image():
+    rng = random.Random(12)
+    old = firmware_like(rng, 4096)
+    patch = ota_delta.create(old, edit(rng, old))
+    with pytest.raises(ota_delta.PatchError):
+        ota_delta.apply(old[:-1], patch)
+
+
+def test_apply_rejects_truncated_patch():
+    rng = random.Random(13)
+    old = firmware_like(rng, 4096)
+    patch = ota_delta.create(old, edit(rng, old))
+    for length in (0, 11, 12, len(patch) // 2, len(patch) - 1):
+        with pytest.raises(ota_delta.PatchError):
+            ota_delta.apply(old, patch[:length])
+
+
+def test_apply_rejects_trailing_data():
+    old = b'old image'
+    patch = ota_delta.create(old, b'new image')
+    with pytest.raises(ota_delta.PatchError):
+        ota_delta.apply(old, patch + b'\0')
+
+
+def test_command_line(tmpdir):
+    rng = random.Random(14)
+    old = firmware_like(rng, 8192)
+    new = edit(rng, old)
+    old_path = str(tmpdir.join('old.bin'))
+    new_path = str(tmpdir.join('new.bin'))
+    patch_path = str(tmpdir.join('patch.bin'))
+    out_path = str(tmpdir.join('out.bin'))
+    with open(old_path, 'wb') as f:
+        f.write(old)
+    with open(new_path, 'wb') as f:
+        f.write(new)
+    assert ota_delta.main(['create', old_path, new_path, patch_path]) == 0
+    assert ota_delta.main(['apply', old_path, patch_path, out_path]) == 0
+    with open(out_path, 'rb') as f:
+        assert f.read() == new